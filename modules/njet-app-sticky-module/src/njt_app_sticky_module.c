@@ -17,15 +17,25 @@
 #define APP_STICKY_DATA_CNT  	4
 #define APP_STICKY_MAX_ZONE  	30
 #define APP_STICKY_EXPIRE_INT 	600
+#define APP_STICKY_PACK_MAX  	0xffff
+#define APP_STICKY_RESYNC_DIV 	4
+#define APP_STICKY_PEER_UNSET 	((njt_uint_t) -1)
+
+/* key(255) + up_name(255) + zone + msgpack headers and age */
+#define APP_STICKY_REC_MAX   	(255 + 255 + APP_STICKY_MAX_ZONE + 20)
 
 
 typedef struct
 {
     u_char					color;
     u_char 					len;
+	u_char 					dirty;		//changed since last gossip sync
 	//todo: optimize ,only store addr_text ptr here, to save space
 	njt_str_t 				up_name;	//i.e. 127.0.0.1:8000
+	njt_uint_t 				peer_id;	//APP_STICKY_PEER_UNSET if learnt by gossip
+	uint32_t 				name_hash;	//crc32 of up_name, guards against stale peer_id
 	njt_msec_t 				last_seen;
+	njt_msec_t 				last_sync;
 	njt_queue_t            	queue;
     u_char 					data[1];
 } njt_app_sticky_rb_node_t;
@@ -46,16 +56,29 @@ typedef struct {
 } njt_app_sticky_ctx_t;
 
 
+typedef struct {
+	njt_uint_t 						id;
+	uint32_t 						name_hash;
+	njt_http_upstream_rr_peer_t 	*peer;
+} njt_app_sticky_peer_index_t;
+
 typedef struct {
     njt_str_t 				var;		//header name , or cookie_name
 	njt_msec_t 				ttl;		//default 10mins ,600
 	njt_str_t 				zone_name;
 	njt_app_sticky_ctx_t 	*ctx;
 	unsigned  				is_cookie:1;
+
+	//per worker peer index, sorted by id, rebuilt when peers->update_id changes
+	njt_app_sticky_peer_index_t	*index;
+	njt_uint_t 				nindex;
+	njt_pool_t 				*index_pool;	//sub pool of the cycle, one per index
+	njt_uint_t 				update_id;
 } njt_app_sticky_srv_conf_t;
 
 typedef struct {
 	njt_str_t  					up_name;
+	njt_uint_t 					peer_id;
 	njt_app_sticky_ctx_t 		*ctx;
 	njt_http_request_t 			*request;
 	njt_int_t 					(*old_proc)(njt_http_request_t *r);
@@ -75,9 +98,15 @@ typedef struct {
 static njt_array_t *sticky_ctxes = NULL;
 
 
-static njt_int_t njt_app_sticky_update_node(njt_app_sticky_ctx_t *ctx, njt_str_t key, njt_str_t value, 	njt_msec_t ttl);
+static njt_int_t njt_app_sticky_update_node(njt_app_sticky_ctx_t *ctx, njt_str_t key, njt_str_t value,
+	njt_uint_t peer_id, njt_msec_t ttl, njt_flag_t local);
 
-static void app_sticky_sync_data( njt_app_sticky_ctx_t* ctx, njt_str_t* zone, njt_str_t* target, njt_str_t* target_pid, njt_msec_t interval);
+static void app_sticky_sync_data( njt_app_sticky_ctx_t* ctx, njt_str_t* zone, njt_str_t* target, njt_str_t* target_pid,
+	njt_msec_t interval, njt_flag_t delta);
+
+static njt_http_upstream_rr_peer_t *njt_app_sticky_find_peer(njt_app_sticky_srv_conf_t *ascf,
+	njt_http_upstream_rr_peers_t *peers, njt_uint_t id, uint32_t name_hash, njt_str_t *name);
+static void njt_app_sticky_delete_node(njt_app_sticky_ctx_t *ctx, njt_str_t *key, uint32_t hash);
 
 static njt_int_t      njt_app_sticky_init_worker(njt_cycle_t *cycle);
 
@@ -239,13 +268,17 @@ static njt_int_t njt_app_sticky_get_peer(njt_peer_connection_t *pc, void *data){
 	njt_rbtree_node_t *node;
 	njt_app_sticky_rb_node_t *lc;
 	njt_app_sticky_req_ctx_t *req_ctx;
+	njt_uint_t peer_id;
+	uint32_t name_hash;
+	njt_str_t up_name;
+	u_char name_buf[NJT_SOCKADDR_STRLEN];
 
 	njt_uint_t i;
 	njt_app_sticky_ctx_t *ctx = NULL;
 	njt_app_sticky_peer_data_t * aspd=(njt_app_sticky_peer_data_t*)data;
 
 	if(aspd == NULL){
-		njt_log_error(NJT_LOG_DEBUG, aspd->request->connection->log, 0, "no app_sticky key, use rr");
+		njt_log_error(NJT_LOG_DEBUG, pc->log, 0, "no app_sticky key, use rr");
 		goto use_rr;
 	}
 
@@ -257,77 +290,101 @@ static njt_int_t njt_app_sticky_get_peer(njt_peer_connection_t *pc, void *data){
 	}
 
 	uint32_t hash = njt_crc32_short(aspd->key.data, aspd->key.len);
+
+	//tips: copy out what we need, the node may be expired once the mutex is released
     njt_shmtx_lock(&ctx->shpool->mutex);
     node = njt_app_sticky_lookup(&ctx->sh->rbtree, &aspd->key, hash);
-    njt_shmtx_unlock(&ctx->shpool->mutex);
 	if (node==NULL) {
+    	njt_shmtx_unlock(&ctx->shpool->mutex);
 		njt_log_error(NJT_LOG_DEBUG, aspd->request->connection->log, 0, "no peer found for %V, use rr",&aspd->key);
 		goto use_rr;
 	}
 
 	lc = (njt_app_sticky_rb_node_t *)&node->color;
+	peer_id = lc->peer_id;
+	name_hash = lc->name_hash;
+	up_name.len = 0;
+	up_name.data = name_buf;
+	if (lc->up_name.len <= NJT_SOCKADDR_STRLEN) {
+		up_name.len = lc->up_name.len;
+		njt_memcpy(name_buf, lc->up_name.data, lc->up_name.len);
+	}
+    njt_shmtx_unlock(&ctx->shpool->mutex);
+
 	peers =  aspd->rrp.peers;
-    njt_http_upstream_rr_peers_wlock(peers);
+    njt_http_upstream_rr_peers_rlock(peers);
 
-	for (peer = peers->peer, i = 0;
-         peer;
-         peer = peer->next, i++)
-    {
-		if ( (lc->up_name.len == peer->name.len)  &&  memcmp(lc->up_name.data,peer->name.data,lc->up_name.len)==0 ) {
-			if (!peer->down) {
-				//todo: other logic like max failure, etc.
-				pc->sockaddr = peer->sockaddr;
-    			pc->socklen = peer->socklen;
-    			pc->name = &peer->name;
+	peer = njt_app_sticky_find_peer(aspd->srv_conf, peers, peer_id, name_hash, &up_name);
+	if (peer == NULL) {
+		njt_http_upstream_rr_peers_unlock(peers);
+		njt_log_error(NJT_LOG_DEBUG, aspd->request->connection->log, 0, "cached upsteam:%V not in upstream, use rr", &up_name);
+		goto use_rr;
+	}
 
-				req_ctx=(njt_app_sticky_req_ctx_t *)njt_palloc(aspd->request->pool,sizeof (njt_app_sticky_req_ctx_t));
-				req_ctx->up_name.data=njt_pstrdup(aspd->request->pool,&peer->name);
-				req_ctx->up_name.len = peer->name.len;
+	if (peer->down) {
+		njt_http_upstream_rr_peers_unlock(peers);
+		njt_app_sticky_delete_node(ctx, &aspd->key, hash);
+		njt_log_error(NJT_LOG_DEBUG, aspd->request->connection->log, 0, "cached upsteam:%V is down, fallback to rr", &up_name);
+		goto use_rr;
+	}
 
-				req_ctx->ctx = ctx;
-				req_ctx->request = aspd->request;
+	//todo: other logic like max failure, etc.
+	pc->sockaddr = peer->sockaddr;
+	pc->socklen = peer->socklen;
+	pc->name = &peer->name;
 
-				req_ctx->old_proc = aspd->old_proc;
-				
-				req_ctx->request->upstream->process_header = njt_app_sticky_header_filter;
+	njt_http_upstream_rr_peer_lock(peers, peer);
+	peer->conns++;
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+	peer->requests++;
+#endif
+	njt_http_upstream_rr_peer_unlock(peers, peer);
 
-				req_ctx->srv_conf = aspd->srv_conf;
+	req_ctx=(njt_app_sticky_req_ctx_t *)njt_palloc(aspd->request->pool,sizeof (njt_app_sticky_req_ctx_t));
+	req_ctx->up_name.data=njt_pstrdup(aspd->request->pool,&peer->name);
+	req_ctx->up_name.len = peer->name.len;
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+	req_ctx->peer_id = peer->id;
+#else
+	req_ctx->peer_id = APP_STICKY_PEER_UNSET;
+#endif
 
-				njt_http_set_ctx(aspd->request,req_ctx,njt_app_sticky_module);
+	req_ctx->ctx = ctx;
+	req_ctx->request = aspd->request;
 
-				njt_log_error(NJT_LOG_DEBUG, aspd->request->connection->log, 0, "app_sticky choose cached upsteam:%V",
-					&peer->name);
-				
-				//important: sync with rrp, so it can be freed properly
-				aspd->rrp.current = peer;
+	req_ctx->old_proc = aspd->old_proc;
 
-				njt_http_upstream_rr_peers_unlock(peers);
+	req_ctx->request->upstream->process_header = njt_app_sticky_header_filter;
 
-				return NJT_OK;
-			} else {
-    			njt_shmtx_lock(&ctx->shpool->mutex);
-				njt_rbtree_delete(&ctx->sh->rbtree, node);
-				//todo: do we need remove
-				njt_queue_remove(&lc->queue);
+	req_ctx->srv_conf = aspd->srv_conf;
 
-				njt_slab_free_locked(ctx->shpool,lc->up_name.data);
-				njt_slab_free_locked(ctx->shpool, node);
+	njt_http_set_ctx(aspd->request,req_ctx,njt_app_sticky_module);
+
+	njt_log_error(NJT_LOG_DEBUG, aspd->request->connection->log, 0, "app_sticky choose cached upsteam:%V",
+		&peer->name);
+
+	//important: sync with rrp, so it can be freed properly
+	aspd->rrp.current = peer;
 
-    			njt_shmtx_unlock(&ctx->shpool->mutex);
-				njt_log_error(NJT_LOG_DEBUG, aspd->request->connection->log, 0, "cached upsteam:%V is down, fallback to rr",	&peer->name);
-				goto use_rr;
-			}
-		}
-	}
 	njt_http_upstream_rr_peers_unlock(peers);
 
+	return NJT_OK;
+
 	use_rr:
 	i= njt_http_upstream_get_round_robin_peer(pc, data);
+	if (aspd == NULL || i != NJT_OK) {
+		return i;
+	}
 	
 	req_ctx=(njt_app_sticky_req_ctx_t *)njt_palloc(aspd->request->pool,sizeof (njt_app_sticky_req_ctx_t));
 
 	req_ctx->up_name.data=njt_pstrdup(aspd->request->pool,&aspd->rrp.current->name);
 	req_ctx->up_name.len = aspd->rrp.current->name.len;
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+	req_ctx->peer_id = aspd->rrp.current->id;
+#else
+	req_ctx->peer_id = APP_STICKY_PEER_UNSET;
+#endif
 	req_ctx->ctx = ctx;
 	req_ctx->request = aspd->request;
 
@@ -341,6 +398,161 @@ static njt_int_t njt_app_sticky_get_peer(njt_peer_connection_t *pc, void *data){
 		
 	return i;
 }
+
+static int njt_app_sticky_cmp_index(const void *one, const void *two)
+{
+	njt_app_sticky_peer_index_t *first, *second;
+
+	first = (njt_app_sticky_peer_index_t *) one;
+	second = (njt_app_sticky_peer_index_t *) two;
+
+	if (first->id == second->id) {
+		return 0;
+	}
+
+	return (first->id < second->id) ? -1 : 1;
+}
+
+//called with peers read locked, the index lives in worker memory
+static njt_int_t njt_app_sticky_update_index(njt_app_sticky_srv_conf_t *ascf,
+	njt_http_upstream_rr_peers_t *peers)
+{
+	njt_uint_t 						n;
+	njt_pool_t 						*pool;
+	njt_http_upstream_rr_peer_t 	*peer;
+	njt_app_sticky_peer_index_t 	*index;
+
+#if (NJT_HTTP_UPSTREAM_ZONE)
+	if (ascf->index != NULL && ascf->update_id == peers->update_id) {
+		return NJT_OK;
+	}
+#else
+	if (ascf->index != NULL) {
+		return NJT_OK;
+	}
+#endif
+
+	if (ascf->index_pool != NULL) {
+		njt_destroy_pool(ascf->index_pool);
+		ascf->index_pool = NULL;
+		ascf->index = NULL;
+		ascf->nindex = 0;
+	}
+
+	n = 0;
+	for (peer = peers->peer; peer; peer = peer->next) {
+		n++;
+	}
+
+	//the previous index goes with its pool, the last one with the cycle
+	pool = njt_create_pool(NJT_MIN_POOL_SIZE, njt_cycle->log);
+	if (pool == NULL) {
+		return NJT_ERROR;
+	}
+
+	if (njt_sub_pool(njt_cycle->pool, pool) != NJT_OK) {
+		njt_destroy_pool(pool);
+		return NJT_ERROR;
+	}
+
+	index = njt_palloc(pool, sizeof(njt_app_sticky_peer_index_t) * (n ? n : 1));
+	if (index == NULL) {
+		njt_destroy_pool(pool);
+		return NJT_ERROR;
+	}
+
+	n = 0;
+	for (peer = peers->peer; peer; peer = peer->next) {
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+		index[n].id = peer->id;
+#else
+		index[n].id = APP_STICKY_PEER_UNSET;
+#endif
+		index[n].name_hash = njt_crc32_short(peer->name.data, peer->name.len);
+		index[n].peer = peer;
+		n++;
+	}
+
+	njt_qsort(index, n, sizeof(njt_app_sticky_peer_index_t), njt_app_sticky_cmp_index);
+
+	ascf->index_pool = pool;
+	ascf->index = index;
+	ascf->nindex = n;
+#if (NJT_HTTP_UPSTREAM_ZONE)
+	ascf->update_id = peers->update_id;
+#endif
+
+	return NJT_OK;
+}
+
+static njt_http_upstream_rr_peer_t *njt_app_sticky_find_peer(njt_app_sticky_srv_conf_t *ascf,
+	njt_http_upstream_rr_peers_t *peers, njt_uint_t id, uint32_t name_hash, njt_str_t *name)
+{
+	njt_uint_t 						i, lo, hi, mid;
+	njt_app_sticky_peer_index_t 	*index;
+
+	if (njt_app_sticky_update_index(ascf, peers) != NJT_OK) {
+		return NULL;
+	}
+
+	index = ascf->index;
+
+	if (id != APP_STICKY_PEER_UNSET) {
+		lo = 0;
+		hi = ascf->nindex;
+
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+
+			if (index[mid].id < id) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+
+		//tips: ids are reused after a reload, so the name hash must match as well
+		if (lo < ascf->nindex && index[lo].id == id
+			&& index[lo].name_hash == name_hash)
+		{
+			return index[lo].peer;
+		}
+	}
+
+	//the record was learnt by gossip or the id is stale, resolve by name
+	for (i = 0; i < ascf->nindex; i++) {
+		if (index[i].name_hash == name_hash
+			&& index[i].peer->name.len == name->len
+			&& njt_memcmp(index[i].peer->name.data, name->data, name->len) == 0)
+		{
+			return index[i].peer;
+		}
+	}
+
+	return NULL;
+}
+
+static void njt_app_sticky_delete_node(njt_app_sticky_ctx_t *ctx, njt_str_t *key, uint32_t hash)
+{
+	njt_rbtree_node_t 			*node;
+	njt_app_sticky_rb_node_t 	*lc;
+
+	njt_shmtx_lock(&ctx->shpool->mutex);
+
+	node = njt_app_sticky_lookup(&ctx->sh->rbtree, key, hash);
+	if (node != NULL) {
+		lc = (njt_app_sticky_rb_node_t *)&node->color;
+
+		njt_rbtree_delete(&ctx->sh->rbtree, node);
+		njt_queue_remove(&lc->queue);
+
+		njt_slab_free_locked(ctx->shpool, lc->up_name.data);
+		njt_slab_free_locked(ctx->shpool, node);
+	}
+
+	njt_shmtx_unlock(&ctx->shpool->mutex);
+}
+
 static char *njt_app_sticky_cmd(njt_conf_t *cf, njt_command_t *cmd,
     void *conf) {
 	njt_http_upstream_srv_conf_t  	*uscf;
@@ -652,12 +864,25 @@ static void app_sticky_expire_node(njt_app_sticky_ctx_t* ctx, njt_msec_t before_
 			"app sticky clean expire session, up_name:%V  last_seen:%d",
 			&lr->up_name, lr->last_seen);
         njt_rbtree_delete(&ctx->sh->rbtree, node);
+		njt_slab_free_locked(ctx->shpool, lr->up_name.data);
         njt_slab_free_locked(ctx->shpool, node);
 	}
    	njt_shmtx_unlock(&ctx->shpool->mutex);
 }
 
-static void app_sticky_sync_data( njt_app_sticky_ctx_t* ctx, njt_str_t* zone, njt_str_t* target, njt_str_t* target_pid, njt_msec_t interval)
+static void app_sticky_set_pack_cnt(char *buf, uint32_t cnt)
+{
+	//tips: the pack header is always encoded as array16, so it can be patched in place
+	mp_store_u16(mp_store_u8(buf, 0xdc), cnt);
+}
+
+/*
+ * with delta set only records that changed or are due for a refresh
+ * (so that remote copies do not expire) are sent, otherwise every
+ * record seen in the interval is sent, e.g. when a node comes online
+ */
+static void app_sticky_sync_data( njt_app_sticky_ctx_t* ctx, njt_str_t* zone, njt_str_t* target, njt_str_t* target_pid,
+	njt_msec_t interval, njt_flag_t delta)
 {
 	size_t 					buf_size=0;
 	char 					*buf=NULL, *head=NULL;
@@ -665,11 +890,18 @@ static void app_sticky_sync_data( njt_app_sticky_ctx_t* ctx, njt_str_t* zone, nj
 	njt_queue_t 			*q;
 	size_t        			tmp_zone_len;
 	njt_msec_t  			checkpoint_stamp = njt_current_msec;
+	njt_msec_t  			resync = ctx->ttl / APP_STICKY_RESYNC_DIV;
+
+	tmp_zone_len = zone->len;
+	if(zone->len > APP_STICKY_MAX_ZONE){
+		tmp_zone_len = APP_STICKY_MAX_ZONE;
+	}
 
     njt_shmtx_lock(&ctx->shpool->mutex);
 	if (njt_queue_empty(&ctx->sh->queue) ) {
     	njt_shmtx_unlock(&ctx->shpool->mutex);
-		 return;
+		app_sticky_expire_node(ctx, checkpoint_stamp - ctx->ttl);
+		return;
 	}
 	for (q = njt_queue_head(&ctx->sh->queue);
      			q != njt_queue_sentinel(&ctx->sh->queue);
@@ -679,12 +911,17 @@ static void app_sticky_sync_data( njt_app_sticky_ctx_t* ctx, njt_str_t* zone, nj
 		lr = njt_queue_data(q, njt_app_sticky_rb_node_t, queue);	
 		njt_msec_t ttl = checkpoint_stamp - lr->last_seen;
 
-		//todo: 
+		//the queue is ordered by last_seen, nothing older was touched
 		if ( ttl > interval) break;
-		//todo: check tail for remove
+
+		if (delta && !lr->dirty && checkpoint_stamp - lr->last_sync < resync) {
+			continue;
+		}
+
+		lr->dirty = 0;
+		lr->last_sync = checkpoint_stamp;
+
 		if (head == NULL ) {
-			int pack_cnt=1;
-			char *pack_head;
 			buf=njt_gossip_app_get_msg_buf(GOSSIP_APP_APP_STICKY, *target, *target_pid, &buf_size);
 			if (buf_size<=0 || buf ==NULL) {
 				njt_log_error(NJT_LOG_ERR,ctx->log,0,"apply buffer failed");
@@ -692,8 +929,8 @@ static void app_sticky_sync_data( njt_app_sticky_ctx_t* ctx, njt_str_t* zone, nj
 				return;
 			}
 
-			pack_head=buf;
-			head= mp_encode_array(pack_head,pack_cnt);
+			head= mp_encode_array(buf, APP_STICKY_PACK_MAX);
+			buf_size = buf_size - (head - buf);
 		} 
 		msg_cnt++;
 		int arr_cnt = APP_STICKY_DATA_CNT;
@@ -708,31 +945,20 @@ static void app_sticky_sync_data( njt_app_sticky_ctx_t* ctx, njt_str_t* zone, nj
 			tail = mp_encode_str(tail,(char *)lr->up_name.data,lr->up_name.len);	//backend name like 127.0.0.1:8080
 		}
 		
-		tmp_zone_len = zone->len;
-		if(zone->len > APP_STICKY_MAX_ZONE){
-			tmp_zone_len = APP_STICKY_MAX_ZONE;
-		}
 		tail= mp_encode_str(tail,(char *)zone->data, tmp_zone_len);	//zone name
-		tail= mp_encode_uint(tail, njt_current_msec - lr->last_seen);	
- 
-		// njt_str_t tmpkey;
-		// tmpkey.data = lr->data;
-		// tmpkey.len = lr->len;
-		// njt_log_error(NJT_LOG_DEBUG, ctx->log, 0," send data msg_index:%d key:%V val:%V zone:%V ttl:%M",
-		// 	msg_cnt, &tmpkey, &lr->up_name, zone, njt_current_msec - lr->last_seen);
-
+		tail= mp_encode_uint(tail, checkpoint_stamp - lr->last_seen);	
 
 		buf_size  = buf_size - (tail - head);
 		head = tail;
-		if (msg_cnt == 15 || buf_size < 255 + 20 + APP_STICKY_MAX_ZONE + 10) {
+
+		//tips: fill the datagram up to the gossip buffer size
+		if (buf_size < APP_STICKY_REC_MAX) {
 			njt_gossip_app_close_msg_buf(tail);
-			//if (msg_cnt>=10) {
-				mp_encode_array(buf, msg_cnt);
-				njt_log_error(NJT_LOG_DEBUG,ctx->log,0," large sync pack:%d",msg_cnt);
-				njt_gossip_send_app_msg_buf();
-				msg_cnt= 0;
-				head=NULL;
-			//}
+			app_sticky_set_pack_cnt(buf, msg_cnt);
+			njt_log_error(NJT_LOG_DEBUG,ctx->log,0," large sync pack:%d",msg_cnt);
+			njt_gossip_send_app_msg_buf();
+			msg_cnt= 0;
+			head=NULL;
 		}
 	}
 	njt_shmtx_unlock(&ctx->shpool->mutex);
@@ -740,7 +966,7 @@ static void app_sticky_sync_data( njt_app_sticky_ctx_t* ctx, njt_str_t* zone, nj
 		njt_gossip_app_close_msg_buf(head);
 	}
 	if (msg_cnt >0) {
-		mp_encode_array(buf,msg_cnt);
+		app_sticky_set_pack_cnt(buf, msg_cnt);
 		njt_log_error(NJT_LOG_DEBUG,ctx->log,0,"sync pack:%d",msg_cnt);
 		njt_gossip_send_app_msg_buf();
 	}
@@ -768,7 +994,7 @@ static void app_sticky_sync(njt_event_t *ev)
 				continue;
 			}
 		
-			app_sticky_sync_data(zone_ctxes[i]->ctx, &zone_ctxes[i]->zone_name, &target, &target_pid, APP_STICKY_SYNC_INT);
+			app_sticky_sync_data(zone_ctxes[i]->ctx, &zone_ctxes[i]->zone_name, &target, &target_pid, APP_STICKY_SYNC_INT, 1);
 		}
 	}
 }
@@ -830,7 +1056,7 @@ static int njt_app_sticky_recv_data(const char* msg, void* data)
 		}
 
 		// aa = false;
-		njt_app_sticky_update_node(ctx, key, val, ttl);
+		njt_app_sticky_update_node(ctx, key, val, APP_STICKY_PEER_UNSET, ttl, 0);
 	}
 	return NJT_OK;
 }
@@ -861,7 +1087,7 @@ static int  njt_app_sticky_on_node_on(njt_str_t* node, njt_str_t* node_pid, void
 			"node:%V online zone:%V, begin sync sticky session,%d",
 			node, &zone_ctxes[i]->zone_name, ascf->ttl);
 	
-		app_sticky_sync_data(zone_ctxes[i]->ctx, &zone_ctxes[i]->zone_name, node, node_pid, ascf->ttl);
+		app_sticky_sync_data(zone_ctxes[i]->ctx, &zone_ctxes[i]->zone_name, node, node_pid, ascf->ttl, 0);
 	}
 
 	return NJT_OK;
@@ -952,10 +1178,16 @@ static njt_int_t njt_app_sticky_init_worker(njt_cycle_t *cycle)
     return NJT_OK;
 }
 
-static njt_int_t njt_app_sticky_update_node(njt_app_sticky_ctx_t *ctx, njt_str_t key, njt_str_t value, njt_msec_t ttl)
+/*
+ * local is set when the record comes from a response of this node,
+ * such records are marked dirty to be sent by the next delta sync
+ */
+static njt_int_t njt_app_sticky_update_node(njt_app_sticky_ctx_t *ctx, njt_str_t key, njt_str_t value,
+	njt_uint_t peer_id, njt_msec_t ttl, njt_flag_t local)
 {
   	njt_app_sticky_rb_node_t *lr;
 	njt_rbtree_node_t *node;
+	u_char *up_name;
 
 	if (ttl > ctx->ttl) return  NJT_OK;	
 
@@ -971,16 +1203,33 @@ static njt_int_t njt_app_sticky_update_node(njt_app_sticky_ctx_t *ctx, njt_str_t
 
 			lr->last_seen = njt_current_msec - ttl;
 
-			njt_slab_free_locked(ctx->shpool, lr->up_name.data);
+			if (lr->up_name.len != value.len
+				|| njt_memcmp(lr->up_name.data, value.data, value.len) != 0)
+			{
+				up_name = njt_slab_alloc_locked(ctx->shpool, value.len);
+				if (up_name == NULL) {
+					njt_log_error(NJT_LOG_CRIT,ctx->log,0, "malloc failed in app_sticky init tree, pos1");
+					njt_shmtx_unlock(&ctx->shpool->mutex);
+					return NJT_ERROR;
+				}
+
+				njt_slab_free_locked(ctx->shpool, lr->up_name.data);
+
+				lr->up_name.data = up_name;
+				lr->up_name.len = value.len;
+				memcpy(lr->up_name.data, value.data, value.len);
+
+				lr->name_hash = njt_crc32_short(value.data, value.len);
+				lr->peer_id = peer_id;
+				lr->dirty = local ? 1 : 0;
 
-			lr->up_name.data = njt_slab_alloc_locked(ctx->shpool, value.len);
-			if (lr->up_name.data == NULL) {
-				njt_log_error(NJT_LOG_CRIT,ctx->log,0, "malloc failed in app_sticky init tree, pos1");
-				njt_shmtx_unlock(&ctx->shpool->mutex);
-				return NJT_ERROR;
-			} 			
-			lr->up_name.len = value.len;
-			memcpy(lr->up_name.data, value.data, value.len);
+			} else if (peer_id != APP_STICKY_PEER_UNSET) {
+				lr->peer_id = peer_id;
+			}
+
+			if (!local) {
+				lr->last_sync = njt_current_msec;
+			}
 
 			njt_queue_remove(&lr->queue);
 			//todo:  this queue should sort
@@ -993,7 +1242,7 @@ static njt_int_t njt_app_sticky_update_node(njt_app_sticky_ctx_t *ctx, njt_str_t
 
 	uint32_t n = offsetof(njt_rbtree_node_t, color)
         + offsetof(njt_app_sticky_rb_node_t, data)
-        + value.len;
+        + key.len;
 
    	node = njt_slab_alloc_locked(ctx->shpool, n);
 	if (node == NULL) {
@@ -1006,10 +1255,15 @@ static njt_int_t njt_app_sticky_update_node(njt_app_sticky_ctx_t *ctx, njt_str_t
     lr = (njt_app_sticky_rb_node_t *) &node->color;
     lr->len = (u_short) key.len;
 	lr->last_seen = njt_current_msec - ttl;
+	lr->last_sync = local ? 0 : njt_current_msec;
+	lr->dirty = local ? 1 : 0;
+	lr->peer_id = peer_id;
+	lr->name_hash = njt_crc32_short(value.data, value.len);
 
 	lr->up_name.data = njt_slab_alloc_locked(ctx->shpool, value.len);
 	if (lr->up_name.data == NULL) {
        	njt_log_error(NJT_LOG_CRIT,ctx->log,0, "malloc failed in app_sticky init tree, pos3");
+		njt_slab_free_locked(ctx->shpool, node);
     	njt_shmtx_unlock(&ctx->shpool->mutex);
 		return NJT_ERROR;
    	} 	
@@ -1047,14 +1301,14 @@ njt_app_sticky_header_filter(njt_http_request_t *r)
 		njt_table_elt_t* header_val = njt_app_sticky_search_header(r,ascf->var.data,ascf->var.len,1);
 		if (header_val !=NULL ) {
 			njt_log_error(NJT_LOG_DEBUG,r->connection->log,0,"found header, will update in rb %V:%V", &header_val->value,&req_ctx->up_name);
-			njt_app_sticky_update_node(req_ctx->ctx, header_val->value, req_ctx->up_name,1);
+			njt_app_sticky_update_node(req_ctx->ctx, header_val->value, req_ctx->up_name, req_ctx->peer_id, 1, 1);
 		} else njt_log_error(NJT_LOG_INFO,r->connection->log,0,"no %V in backend header", &ascf->var);
 	} else {
 		njt_str_t cookie_value;
 		if (njt_http_parse_multi_header_lines(r, r->upstream->headers_in.set_cookie, &ascf->var, &cookie_value) 
 			!= NULL) {
 			njt_log_error(NJT_LOG_DEBUG,r->connection->log,0,"found cookie, will update in rb %V:%V", &cookie_value,&req_ctx->up_name);
-			njt_app_sticky_update_node(req_ctx->ctx, cookie_value, req_ctx->up_name,1);
+			njt_app_sticky_update_node(req_ctx->ctx, cookie_value, req_ctx->up_name, req_ctx->peer_id, 1, 1);
 		} else njt_log_error(NJT_LOG_INFO,r->connection->log,0,"no cookie %V in backend header", &ascf->var);
 	}
 
@@ -12,9 +12,23 @@
 
 #include "njt_gossip_module.h"
 
+#if (NJT_ZLIB)
+#include <zlib.h>
+#endif
+
 // #include "msgpack.h"
 
 #define  GOSSIP_HEARTBEAT_INT 10000
+//sent msg bufs kept for reuse
+#define  GOSSIP_FREE_BUFS 32
+
+typedef struct {
+	uint64_t		packets;
+	uint64_t		bytes;
+	uint64_t		errors;
+	uint64_t		bundles;
+	uint64_t		raw_bytes;
+} njt_gossip_tx_stat_t;
 
 
 
@@ -41,12 +55,21 @@ static njt_int_t njt_gossip_build_member_msg(njt_uint_t msg_type, njt_str_t *tar
 static int	njt_gossip_syn_data_request(njt_str_t *node, njt_str_t *pid);
 static njt_int_t add_self_to_memberslist();
 
+static njt_chain_t *njt_gossip_alloc_msg_buf(njt_gossip_udp_ctx_t *ctx);
+static void njt_gossip_flush(njt_gossip_udp_ctx_t *ctx);
+static void njt_gossip_flush_handler(njt_event_t *ev);
+static int njt_gossip_proc_msg(njt_stream_session_t *s, njt_log_t *log,
+		njt_str_t *n_name, njt_str_t *n_pid, const char *r, uint32_t cnt,
+		njt_flag_t bundled);
+static void njt_gossip_send_nack(njt_str_t *node, njt_str_t *pid,
+		uint32_t app_magic, uint32_t from, uint32_t to);
+
 
 extern njt_module_t  njt_mqconf_module;
 
 static njt_command_t njt_gossip_commands[] = {
       {njt_string("gossip"),
-      NJT_STREAM_SRV_CONF|NJT_CONF_TAKE123,
+      NJT_STREAM_SRV_CONF|NJT_CONF_1MORE,
       njt_stream_gossip_cmd,
       NJT_STREAM_SRV_CONF_OFFSET,
       0,
@@ -99,6 +122,9 @@ static void *njt_gossip_create_srv_conf(njt_conf_t *cf)
 	conf->nodeclean_timeout = NJT_CONF_UNSET_MSEC;
 	conf->sockaddr = NULL;
 	conf->req_ctx = NULL;
+	conf->batch = NJT_CONF_UNSET_MSEC;
+	conf->compress = NJT_CONF_UNSET;
+	conf->anti_entropy = NJT_CONF_UNSET;
 
     return conf;
 }
@@ -137,6 +163,9 @@ njt_stream_gossip_cmd(njt_conf_t *cf, njt_command_t *cmd, void *conf)
 
 	gscf->heartbeat_timeout = GOSSIP_HEARTBEAT_INT;
 	gscf->nodeclean_timeout = 2 * gscf->heartbeat_timeout;
+	gscf->batch = 0;
+	gscf->compress = 0;
+	gscf->anti_entropy = 0;
 	
 	cscf=njt_stream_conf_get_module_srv_conf(cf,njt_stream_core_module);
 	cmcf=njt_stream_conf_get_module_main_conf(cf,njt_stream_core_module);
@@ -232,20 +261,49 @@ njt_stream_gossip_cmd(njt_conf_t *cf, njt_command_t *cmd, void *conf)
 				gscf->nodeclean_timeout = 2 * GOSSIP_HEARTBEAT_INT;
 				// return NJT_CONF_ERROR;
 			}
+		} else if (njt_strncmp(value[i].data, "batch=", 6) == 0){
+			tmp_str.data = value[i].data + 6;
+			tmp_str.len = value[i].len - 6;
+			gscf->batch = njt_parse_time(&tmp_str, 0);
+			if (gscf->batch == (njt_msec_t) NJT_ERROR) {
+				njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+					" gossip, invalid batch:\"%V\"", &tmp_str);
+				return NJT_CONF_ERROR;
+			}
+		} else if (njt_strcmp(value[i].data, "compress=on") == 0){
+#if (NJT_ZLIB)
+			gscf->compress = 1;
+#else
+			njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+				" gossip compress requires zlib");
+			return NJT_CONF_ERROR;
+#endif
+		} else if (njt_strcmp(value[i].data, "compress=off") == 0){
+			gscf->compress = 0;
+		} else if (njt_strcmp(value[i].data, "anti_entropy=on") == 0){
+			gscf->anti_entropy = 1;
+		} else if (njt_strcmp(value[i].data, "anti_entropy=off") == 0){
+			gscf->anti_entropy = 0;
 		} else {
 			njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
-				"invalid gossip param \"%V\", format is zone={zone_name}:{size}M [heartbeat_timeout={timeout}] [nodeclean_timeout={timeout}]", &value[i]);
+				"invalid gossip param \"%V\", format is zone={zone_name}:{size}M [heartbeat_timeout={timeout}] [nodeclean_timeout={timeout}] [batch={time}] [compress=on|off] [anti_entropy=on|off]", &value[i]);
 			return NJT_CONF_ERROR;
 		}
 	}
 
+	if(gscf->batch >= gscf->heartbeat_timeout){
+		njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+			" gossip batch should less than heartbeat_timeout");
+		return NJT_CONF_ERROR;
+	}
+
 	if(gscf->nodeclean_timeout < (2 * gscf->heartbeat_timeout)){
 		gscf->nodeclean_timeout = 2 * gscf->heartbeat_timeout;
 	}
 
 	if(!has_zone){
 		njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
-			"invalid gossip param, format is zone={zone_name}:{size}M [heartbeat_timeout={timeout}] [nodeclean_timeout={timeout}]");
+			"invalid gossip param, format is zone={zone_name}:{size}M [heartbeat_timeout={timeout}] [nodeclean_timeout={timeout}] [batch={time}] [compress=on|off] [anti_entropy=on|off]");
 		return NJT_CONF_ERROR;
 	}
 
@@ -282,7 +340,7 @@ static njt_int_t njt_gossip_init_zone(njt_shm_zone_t *shm_zone, void *data)
         return NJT_OK;
     }
 
-    ctx->sh = njt_slab_alloc(ctx->shpool, sizeof(njt_gossip_shctx_t));
+    ctx->sh = njt_slab_calloc(ctx->shpool, sizeof(njt_gossip_shctx_t));
     if (ctx->sh == NULL) {
         return NJT_ERROR;
     }
@@ -398,7 +456,7 @@ static void njt_gossip_upd_member(njt_stream_session_t *s, njt_uint_t state, njt
 				}
 			}
 			if (p_member==NULL) {
-				p_member=njt_slab_alloc_locked(shared_ctx->shpool, sizeof(njt_gossip_member_list_t));
+				p_member=njt_slab_calloc_locked(shared_ctx->shpool, sizeof(njt_gossip_member_list_t));
 				p_member->next =NULL;
 
 				p_member->node_name.data = njt_slab_alloc_locked(shared_ctx->shpool,node_name->len);
@@ -504,40 +562,479 @@ static int	njt_gossip_syn_data_request(njt_str_t *node, njt_str_t *pid)
 }
 
 
+static njt_gossip_app_stat_t *
+njt_gossip_app_stat_locked(njt_gossip_shctx_t *sh, uint32_t app_magic)
+{
+	njt_uint_t 						i;
+
+	for (i = 0; i < sh->napps; i++) {
+		if (sh->apps[i].app_magic == app_magic) {
+			return &sh->apps[i];
+		}
+	}
+
+	if (sh->napps == GOSSIP_APP_MAX) {
+		return NULL;
+	}
+
+	sh->apps[sh->napps].app_magic = app_magic;
+
+	return &sh->apps[sh->napps++];
+}
+
+
+static njt_gossip_peer_seq_t *
+njt_gossip_peer_seq_locked(njt_gossip_shctx_t *sh, njt_str_t *node, njt_str_t *pid,
+	uint32_t app_magic)
+{
+	njt_uint_t 						i;
+	njt_gossip_member_list_t 		*p_member;
+
+	if (sh->members == NULL) {
+		return NULL;
+	}
+
+	for (p_member = sh->members->next; p_member; p_member = p_member->next) {
+		if (p_member->node_name.len == node->len
+			&& memcmp(p_member->node_name.data, node->data, node->len) == 0
+			&& p_member->pid.len == pid->len
+			&& memcmp(p_member->pid.data, pid->data, pid->len) == 0)
+		{
+			break;
+		}
+	}
+
+	//tips: seq is tracked after the first heartbeat of the node,
+	// what is sent before is got by syn
+	if (p_member == NULL) {
+		return NULL;
+	}
+
+	for (i = 0; i < GOSSIP_APP_MAX; i++) {
+		if (p_member->seqs[i].app_magic == app_magic) {
+			return &p_member->seqs[i];
+		}
+
+		if (p_member->seqs[i].app_magic == 0) {
+			p_member->seqs[i].app_magic = app_magic;
+			return &p_member->seqs[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * move the window to seq, the skipped seqs are returned as lost
+ * return the count of lost seqs
+ */
+static uint32_t
+njt_gossip_seq_advance(njt_gossip_peer_seq_t *ps, uint32_t seq,
+	uint32_t *from, uint32_t *to)
+{
+	uint32_t 						shift;
+
+	shift = seq - ps->last;
+	*from = ps->last + 1;
+	*to = seq - 1;
+
+	ps->window = (shift >= 64) ? 0 : (ps->window << shift);
+	ps->last = seq;
+
+	return shift - 1;
+}
+
+
+/*
+ * check the seq of an app msg, return NJT_DECLINED if it is received already
+ */
+static njt_int_t
+njt_gossip_check_seq(njt_str_t *node, njt_str_t *pid, uint32_t app_magic,
+	uint32_t seq, size_t len)
+{
+	njt_gossip_req_ctx_t  			*shared_ctx;
+	njt_gossip_peer_seq_t 			*ps;
+	njt_gossip_app_stat_t 			*st;
+	uint32_t 						 off, from, to, lost;
+	njt_int_t 						 rc;
+
+	shared_ctx = gossip_udp_ctx->req_ctx;
+	rc = NJT_OK;
+	lost = 0;
+	from = 0;
+	to = 0;
+
+	njt_shmtx_lock(&shared_ctx->shpool->mutex);
+
+	ps = seq ? njt_gossip_peer_seq_locked(shared_ctx->sh, node, pid, app_magic) : NULL;
+	if (ps == NULL) {
+		/* void */
+
+	} else if (ps->last == 0) {
+		ps->last = seq;
+		ps->window = 1;
+
+	} else if (seq > ps->last) {
+		lost = njt_gossip_seq_advance(ps, seq, &from, &to);
+		ps->window |= 1;
+
+	} else {
+		off = ps->last - seq;
+		if (off >= 64 || (ps->window & ((uint64_t) 1 << off))) {
+			rc = NJT_DECLINED;
+		} else {
+			ps->window |= (uint64_t) 1 << off;
+		}
+	}
+
+	st = njt_gossip_app_stat_locked(shared_ctx->sh, app_magic);
+	if (st) {
+		if (rc == NJT_DECLINED) {
+			st->rx_dups++;
+		} else {
+			st->rx_msgs++;
+			st->rx_bytes += len;
+		}
+
+		st->rx_lost += lost;
+		if (lost && gossip_udp_ctx->anti_entropy) {
+			st->nacks_sent++;
+		}
+	}
+
+	njt_shmtx_unlock(&shared_ctx->shpool->mutex);
+
+	if (lost) {
+		njt_gossip_send_nack(node, pid, app_magic, from, to);
+	}
+
+	return rc;
+}
+
+
+/*
+ * digest of heartbeat is [app_magic, last seq, ...], it finds the tail
+ * msgs lost, which the seq of next msgs can not find
+ */
+static void
+njt_gossip_proc_digest(njt_str_t *node, njt_str_t *pid, const char *r)
+{
+	njt_gossip_req_ctx_t  			*shared_ctx;
+	njt_gossip_peer_seq_t 			*ps;
+	njt_gossip_app_stat_t 			*st;
+	uint32_t 						 i, n, app_magic, seq, from, to;
+
+	shared_ctx = gossip_udp_ctx->req_ctx;
+	to = 0;
+	n = mp_decode_array(&r) / 2;
+
+	for (i = 0; i < n; i++) {
+		if (mp_typeof(*r) != MP_UINT) {
+			return;
+		}
+		app_magic = mp_decode_uint(&r);
+
+		if (mp_typeof(*r) != MP_UINT) {
+			return;
+		}
+		seq = mp_decode_uint(&r);
+
+		from = 0;
+		njt_shmtx_lock(&shared_ctx->shpool->mutex);
+
+		ps = njt_gossip_peer_seq_locked(shared_ctx->sh, node, pid, app_magic);
+		if (ps && ps->last == 0) {
+			ps->last = seq;
+			ps->window = (uint64_t) -1;
+
+		} else if (ps && seq > ps->last) {
+			njt_gossip_seq_advance(ps, seq, &from, &to);
+			to = seq;
+
+			st = njt_gossip_app_stat_locked(shared_ctx->sh, app_magic);
+			if (st) {
+				st->rx_lost += to - from + 1;
+				if (gossip_udp_ctx->anti_entropy) {
+					st->nacks_sent++;
+				}
+			}
+		}
+
+		njt_shmtx_unlock(&shared_ctx->shpool->mutex);
+
+		if (from) {
+			njt_gossip_send_nack(node, pid, app_magic, from, to);
+		}
+	}
+}
+
+
+static void
+njt_gossip_send_nack(njt_str_t *node, njt_str_t *pid, uint32_t app_magic,
+	uint32_t from, uint32_t to)
+{
+	size_t 						 len;
+	char 						*w;
+
+	if (gossip_udp_ctx == NULL || !gossip_udp_ctx->anti_entropy) {
+		return;
+	}
+
+	njt_log_error(NJT_LOG_INFO, gossip_udp_ctx->log, 0,
+		" gossip nack node:%V pid:%V app:%uD seq:%uD-%uD", node, pid, app_magic, from, to);
+
+	w = njt_gossip_app_get_msg_buf(GOSSIP_NACK, *node, *pid, &len);
+	if (w == NULL) {
+		return;
+	}
+
+	w = mp_encode_array(w, 3);
+	w = mp_encode_uint(w, app_magic);
+	w = mp_encode_uint(w, from);
+	w = mp_encode_uint(w, to);
+	njt_gossip_app_close_msg_buf(w);
+
+	njt_gossip_send_handler(gossip_udp_ctx->udp->write);
+}
+
+
+/*
+ * resend the msgs asked by a nack from the ring, if some are evicted,
+ * the node_handler of the app is called to syn all data to the node
+ */
+static void
+njt_gossip_proc_nack(njt_str_t *node, njt_str_t *pid, const char *r, njt_log_t *log)
+{
+	njt_gossip_req_ctx_t  			*shared_ctx;
+	njt_gossip_ring_slot_t 			*slot;
+	njt_gossip_app_stat_t 			*st;
+	gossip_app_msg_handle_t 		*app_handle;
+	njt_chain_t 					*cl;
+	njt_uint_t 						 i, found;
+	uint32_t 						 app_magic, from, to, seq;
+	njt_flag_t 						 missing;
+
+	if (mp_typeof(*r) != MP_ARRAY || mp_decode_array(&r) < 3) {
+		return;
+	}
+
+	app_magic = mp_decode_uint(&r);
+	from = mp_decode_uint(&r);
+	to = mp_decode_uint(&r);
+	if (from == 0 || to < from) {
+		return;
+	}
+
+	missing = 0;
+	if (to - from >= GOSSIP_RING_SIZE) {
+		from = to - GOSSIP_RING_SIZE + 1;
+		missing = 1;
+	}
+
+	shared_ctx = gossip_udp_ctx->req_ctx;
+	njt_shmtx_lock(&shared_ctx->shpool->mutex);
+
+	st = njt_gossip_app_stat_locked(shared_ctx->sh, app_magic);
+
+	for (seq = from; seq <= to && seq != 0; seq++) {
+		found = 0;
+
+		for (i = 0; shared_ctx->sh->ring && i < GOSSIP_RING_SIZE; i++) {
+			slot = &shared_ctx->sh->ring[i];
+			if (slot->app_magic != app_magic || slot->seq != seq) {
+				continue;
+			}
+
+			found = 1;
+			if (njt_current_msec - slot->sent < GOSSIP_RETRANS_GAP) {
+				break;
+			}
+
+			cl = njt_gossip_alloc_msg_buf(gossip_udp_ctx);
+			if (cl == NULL) {
+				break;
+			}
+
+			slot->sent = njt_current_msec;
+			cl->buf->last = njt_cpymem(cl->buf->pos, slot->data, slot->len);
+			cl->next = gossip_udp_ctx->requests;
+			gossip_udp_ctx->requests = cl;
+
+			if (st) {
+				st->retransmits++;
+			}
+			break;
+		}
+
+		if (!found) {
+			missing = 1;
+		}
+	}
+
+	if (st) {
+		st->nacks_recv++;
+		if (missing) {
+			st->full_syncs++;
+		}
+	}
+
+	njt_shmtx_unlock(&shared_ctx->shpool->mutex);
+
+	if (missing && gossip_app_handle_fac) {
+		njt_log_error(NJT_LOG_INFO, log, 0,
+			" gossip app:%uD msgs evicted, syn all to node:%V pid:%V", app_magic, node, pid);
+
+		app_handle = gossip_app_handle_fac->elts;
+		for (i = 0; i < gossip_app_handle_fac->nelts; i++) {
+			if (app_handle[i].app_magic == app_magic && app_handle[i].node_handler) {
+				app_handle[i].node_handler(node, pid, app_handle[i].data);
+			}
+		}
+	}
+
+	njt_gossip_send_handler(gossip_udp_ctx->udp->write);
+}
+
+
+static void
+njt_gossip_proc_bundle(njt_stream_session_t *s, njt_log_t *log,
+	njt_str_t *n_name, njt_str_t *n_pid, const char *r)
+{
+	uint32_t 						 i, j, n, cnt;
+	const char 						*next;
+
+	if (mp_typeof(*r) != MP_ARRAY) {
+		njt_log_error(NJT_LOG_WARN, log, 0, " invalid gossip bundle");
+		return;
+	}
+
+	n = mp_decode_array(&r);
+	for (i = 0; i < n; i++) {
+		if (mp_typeof(*r) != MP_ARRAY) {
+			njt_log_error(NJT_LOG_WARN, log, 0, " invalid msg in gossip bundle");
+			return;
+		}
+
+		cnt = mp_decode_array(&r);
+		next = r;
+		for (j = 0; j < cnt; j++) {
+			mp_next(&next);
+		}
+
+		if (cnt >= 4) {
+			njt_gossip_proc_msg(s, log, n_name, n_pid, r, cnt, 1);
+		}
+
+		r = next;
+	}
+}
+
+
+#if (NJT_ZLIB)
+
+static void
+njt_gossip_proc_zbundle(njt_stream_session_t *s, njt_log_t *log,
+	njt_str_t *n_name, njt_str_t *n_pid, const char *r)
+{
+	static u_char 					 raw[GOSSIP_BUNDLE_RAW_MAX];
+	uint32_t 						 len;
+	uLongf 							 raw_len, size;
+	const char 						*data, *chk;
+
+	if (mp_typeof(*r) != MP_ARRAY || mp_decode_array(&r) < 2
+		|| mp_typeof(*r) != MP_UINT)
+	{
+		goto invalid;
+	}
+
+	size = mp_decode_uint(&r);
+	if (size > GOSSIP_BUNDLE_RAW_MAX || mp_typeof(*r) != MP_BIN) {
+		goto invalid;
+	}
+
+	data = mp_decode_bin(&r, &len);
+	raw_len = GOSSIP_BUNDLE_RAW_MAX;
+	if (uncompress(raw, &raw_len, (const Bytef *) data, len) != Z_OK
+		|| raw_len != size)
+	{
+		goto invalid;
+	}
+
+	chk = (const char *) raw;
+	if (mp_check(&chk, (const char *) raw + raw_len) != 0) {
+		goto invalid;
+	}
+
+	njt_gossip_proc_bundle(s, log, n_name, n_pid, (const char *) raw);
+	return;
+
+invalid:
+
+	njt_log_error(NJT_LOG_WARN, log, 0, " invalid gossip compressed bundle");
+}
+
+#endif
+
+
 static int njt_gossip_proc_package(const u_char *begin,const u_char* end, njt_log_t *log, njt_stream_session_t *s)
 {
 	njt_gossip_srv_conf_t 	*gscf=njt_stream_get_module_srv_conf(s,njt_gossip_module);
+	njt_gossip_req_ctx_t 	*shared_ctx;
 	uint32_t 				arr_cnt ,len;
-	uint32_t  				magic, msg_type;
-	njt_str_t 				c_name, n_name, n_pid, target_name;
-	// njt_str_t				target_pid;
-	njt_msec_t 				uptime;
+	uint32_t  				magic;
+	njt_str_t 				c_name, n_name, n_pid;
+	const char 				*chk;
 
-	if(gscf == NULL){
+	if(gscf == NULL || gossip_udp_ctx == NULL){
 		njt_log_error(NJT_LOG_NOTICE, njt_cycle->log, 0, 
 			" in proc packet, has no gossip module config");
 
 		return NJT_OK;
 	}
 
+	shared_ctx = gossip_udp_ctx->req_ctx;
 
 	const char *r = (const char*)begin;
+
+	//tips: check the whole package once, then no bound check is needed when decode
+	chk = r;
+	if (begin == end || mp_typeof(*r) != MP_ARRAY || mp_check(&chk, (const char *)end) != 0) {
+		njt_log_error(NJT_LOG_WARN, log, 0, "invalid package, not msgpack array");
+		njt_shmtx_lock(&shared_ctx->shpool->mutex);
+		shared_ctx->sh->rx_invalid++;
+		njt_shmtx_unlock(&shared_ctx->shpool->mutex);
+		return NJT_OK;
+	}
+
 	arr_cnt = mp_decode_array(&r);
 	if (arr_cnt<8) {
 		njt_log_error(NJT_LOG_WARN, log, 0, "invalid package,array size should large than 8,got :%d", arr_cnt);
 		return NJT_OK;
 	}
+	if (mp_typeof(*r) != MP_UINT) {
+		njt_log_error(NJT_LOG_WARN, log, 0, " not gossip package");
+		return NJT_OK;
+	}
 	magic = mp_decode_uint(&r);
 	if ( magic != GOSSIP_MAGIC ) {
 		njt_log_error(NJT_LOG_WARN, log, 0, " not gossip package,:%d", magic);
 		return NJT_OK;
 	}
+	if (mp_typeof(*r) != MP_STR) {
+		njt_log_error(NJT_LOG_WARN, log, 0, " invalid gossip package");
+		return NJT_OK;
+	}
 	c_name.data = (u_char *)mp_decode_str(&r, &len);
 	c_name.len=len;
 	if ( c_name.len!= gscf->cluster_name->len || memcmp(c_name.data, gscf->cluster_name->data, c_name.len)!=0)  {
 		njt_log_error(NJT_LOG_INFO, log, 0, " not matched cluster :%V", &c_name);
 		return NJT_OK;
 	}
+	if (mp_typeof(*r) != MP_STR) {
+		njt_log_error(NJT_LOG_WARN, log, 0, " invalid gossip package");
+		return NJT_OK;
+	}
 	n_name.data = (u_char *)mp_decode_str(&r, &len);
 	n_name.len=len;
 
@@ -547,16 +1044,49 @@ static int njt_gossip_proc_package(const u_char *begin,const u_char* end, njt_lo
 		return NJT_OK;
 	}
 
+	if (mp_typeof(*r) != MP_STR) {
+		njt_log_error(NJT_LOG_WARN, log, 0, " invalid gossip package");
+		return NJT_OK;
+	}
 	n_pid.data = (u_char *)mp_decode_str(&r, &len);
 	n_pid.len=len;
 
+	njt_shmtx_lock(&shared_ctx->shpool->mutex);
+	shared_ctx->sh->rx_packets++;
+	shared_ctx->sh->rx_bytes += end - begin;
+	njt_shmtx_unlock(&shared_ctx->shpool->mutex);
+
+	return njt_gossip_proc_msg(s, log, &n_name, &n_pid, r, arr_cnt - 4, 0);
+}
+
+
+/*
+ * r points to the target of a msg, cnt is the count of the left fields:
+ * target, target_pid, msg_type, payload and the optional seq (or digest)
+ */
+static int njt_gossip_proc_msg(njt_stream_session_t *s, njt_log_t *log,
+		njt_str_t *n_name, njt_str_t *n_pid, const char *r, uint32_t cnt,
+		njt_flag_t bundled)
+{
+	njt_gossip_srv_conf_t 	*gscf=njt_stream_get_module_srv_conf(s,njt_gossip_module);
+	uint32_t 				len;
+	uint32_t  				msg_type;
+	njt_str_t 				target_name;
+	// njt_str_t				target_pid;
+	njt_msec_t 				uptime;
+	const char 				*trailer, *end;
+
+	if (mp_typeof(*r) != MP_STR) {
+		njt_log_error(NJT_LOG_WARN, log, 0, " invalid gossip msg");
+		return NJT_OK;
+	}
 	target_name.data = (u_char *)mp_decode_str(&r, &len);
 	target_name.len=len;
 
 	//target pid now just add ,no use
 	// target_pid.data = (u_char *)mp_decode_str(&r, &len);
 	// target_pid.len=len;
-	mp_decode_str(&r, &len);
+	mp_next(&r);
 
 	// njt_log_error(NJT_LOG_INFO, log, 0, "target name:%V pid_name:%V",&target_name, &target_pid);
 	if ( target_name.len==3 && memcmp(target_name.data, "all", 3)==0){
@@ -573,40 +1103,57 @@ static int njt_gossip_proc_package(const u_char *begin,const u_char* end, njt_lo
 		}
 	}
 
+	if (mp_typeof(*r) != MP_UINT) {
+		njt_log_error(NJT_LOG_WARN, log, 0, " invalid gossip msg type");
+		return NJT_OK;
+	}
 	msg_type = mp_decode_uint(&r);
+
+	//tips: msg from the node with batch or anti_entropy has a trailer after payload
+	trailer = NULL;
+	end = r;
+	mp_next(&end);
+	if (cnt >= 5) {
+		trailer = end;
+	}
+
 	switch ( msg_type) {
 		case GOSSIP_ON: 
 			uptime=mp_decode_uint(&r);
-			njt_log_error(NJT_LOG_INFO, log, 0, "node:%V pid:%V msg_type:online uptime %d", &n_name, &n_pid, uptime);
-			njt_gossip_upd_member(s,msg_type,uptime,&n_name, &n_pid);
+			njt_log_error(NJT_LOG_INFO, log, 0, "node:%V pid:%V msg_type:online uptime %d", n_name, n_pid, uptime);
+			njt_gossip_upd_member(s,msg_type,uptime,n_name, n_pid);
 			njt_gossip_reply_status();
 			//todo: call online hook of modules
 		break;
 		case GOSSIP_OFF: 
 			uptime=mp_decode_uint(&r);
-			njt_log_error(NJT_LOG_INFO, log, 0, "node:%V pid:%V msg_type:offline uptime:%d", &n_name, &n_pid, uptime);
-			njt_gossip_upd_member(s,GOSSIP_OFF,uptime,&n_name, &n_pid);
+			njt_log_error(NJT_LOG_INFO, log, 0, "node:%V pid:%V msg_type:offline uptime:%d", n_name, n_pid, uptime);
+			njt_gossip_upd_member(s,GOSSIP_OFF,uptime,n_name, n_pid);
 			//todo: call offline hook of modules
 		break;
 		case GOSSIP_HEARTBEAT: 
 			uptime=mp_decode_uint(&r);
-			njt_log_error(NJT_LOG_DEBUG, log, 0, "node:%V pid:%V msg_type:heartbeat uptime:%d", &n_name, &n_pid, uptime);
-			njt_gossip_upd_member(s,GOSSIP_HEARTBEAT,uptime,&n_name, &n_pid);
+			njt_log_error(NJT_LOG_DEBUG, log, 0, "node:%V pid:%V msg_type:heartbeat uptime:%d", n_name, n_pid, uptime);
+			njt_gossip_upd_member(s,GOSSIP_HEARTBEAT,uptime,n_name, n_pid);
 			
 			if(gossip_udp_ctx->need_syn){ 
-				njt_gossip_upd_syn_state(&n_name, &n_pid);
+				njt_gossip_upd_syn_state(n_name, n_pid);
 				gossip_udp_ctx->need_syn = false;
 			}
 
+			if (trailer && mp_typeof(*trailer) == MP_ARRAY) {
+				njt_gossip_proc_digest(n_name, n_pid, trailer);
+			}
+
 		break;
 		case GOSSIP_MSG_SYN:
 			uptime=mp_decode_uint(&r);
-			njt_log_error(NJT_LOG_DEBUG, log, 0, "node:%V pid:%V msg_type:syn_msg uptime:%d", &n_name, &n_pid, uptime);
+			njt_log_error(NJT_LOG_DEBUG, log, 0, "node:%V pid:%V msg_type:syn_msg uptime:%d", n_name, n_pid, uptime);
 			if (target_name.len==gscf->node_name->len && memcmp(target_name.data, gscf->node_name->data, target_name.len)==0)
 			{
 				njt_log_error(NJT_LOG_INFO, log, 0, 
 					" I syn data, I'snode:%V onlinenode:%V onlinenode'spid:%V", 
-					gscf->node_name, &n_name, &n_pid);
+					gscf->node_name, n_name, n_pid);
 					
 				uint32_t i;
 				if (gossip_app_handle_fac) {
@@ -614,16 +1161,46 @@ static int njt_gossip_proc_package(const u_char *begin,const u_char* end, njt_lo
 					for (i=0;i<gossip_app_handle_fac->nelts;i++) {
 						if (  app_handle[i].node_handler)  {
 							njt_log_error(NJT_LOG_DEBUG,log,0,"invoke node startup handler:%d",app_handle[i].app_magic);
-							app_handle[i].node_handler(&n_name, &n_pid, app_handle[i].data);
+							app_handle[i].node_handler(n_name, n_pid, app_handle[i].data);
 						}
 					}
 				}
 			}
 		break;
+		case GOSSIP_NACK:
+			njt_gossip_proc_nack(n_name, n_pid, r, log);
+		break;
+		case GOSSIP_BUNDLE:
+		case GOSSIP_BUNDLE_Z:
+			if (bundled) {
+				njt_log_error(NJT_LOG_WARN, log, 0, "bundle in bundle, ignore");
+				break;
+			}
+
+			if (msg_type == GOSSIP_BUNDLE) {
+				njt_gossip_proc_bundle(s, log, n_name, n_pid, r);
+				break;
+			}
+
+#if (NJT_ZLIB)
+			njt_gossip_proc_zbundle(s, log, n_name, n_pid, r);
+#else
+			njt_log_error(NJT_LOG_WARN, log, 0, "compressed bundle, but no zlib");
+#endif
+		break;
 		default:
-			njt_log_error(NJT_LOG_DEBUG, log, 0, "node:%V pid:%V msg_type:%d", &n_name, &n_pid, msg_type);
+			njt_log_error(NJT_LOG_DEBUG, log, 0, "node:%V pid:%V msg_type:%d", n_name, n_pid, msg_type);
 			{
 				uint32_t i;
+
+				if (njt_gossip_check_seq(n_name, n_pid, msg_type,
+						(trailer && mp_typeof(*trailer) == MP_UINT) ? mp_decode_uint(&trailer) : 0,
+						end - r) == NJT_DECLINED)
+				{
+					njt_log_error(NJT_LOG_DEBUG, log, 0, "gossip_app %d msg received already", msg_type);
+					return NJT_OK;
+				}
+
 				if(gossip_app_handle_fac){
 					gossip_app_msg_handle_t *app_handle = gossip_app_handle_fac->elts;
 					for (i=0;i<gossip_app_handle_fac->nelts;i++) {
@@ -667,10 +1244,11 @@ static void gossip_read_handler(njt_event_t *ev)
 
 	if (s->received) {
     	njt_log_error(NJT_LOG_DEBUG, c->log,0, "preread data:%d",s->received);
-		njt_memcpy(buf, c->buffer->pos, s->received);
+		n = njt_min(s->received, 2048);
+		njt_memcpy(buf, c->buffer->pos, n);
         c->buffer->pos = c->buffer->last;
 		s->received = 0;
-		njt_gossip_proc_package(buf,buf+s->received,c->log, s);
+		njt_gossip_proc_package(buf,buf+n,c->log, s);
     }
 	while (ev->ready) {
         n = c->recv(c, buf, 2048);
@@ -712,7 +1290,14 @@ static char *njt_gossip_merge_srv_conf(njt_conf_t *cf, void *parent,void *child)
 		p->sockaddr=c->sockaddr;
 		p->socklen=c->socklen;
 		p->req_ctx=c->req_ctx;
+		p->batch=c->batch;
+		p->compress=c->compress;
+		p->anti_entropy=c->anti_entropy;
 	}
+
+    njt_conf_merge_msec_value(p->batch, c->batch, 0);
+    njt_conf_merge_value(p->compress, c->compress, 0);
+    njt_conf_merge_value(p->anti_entropy, c->anti_entropy, 0);
 	return NJT_OK;
 }
 
@@ -771,6 +1356,17 @@ static njt_int_t gossip_start(njt_cycle_t *cycle)
 	gossip_udp_ctx->heartbeat_timeout = gscf->heartbeat_timeout;
 	gossip_udp_ctx->nodeclean_timeout = gscf->nodeclean_timeout;
 
+	gossip_udp_ctx->batch = gscf->batch;
+	gossip_udp_ctx->compress = gscf->compress;
+	gossip_udp_ctx->anti_entropy = gscf->anti_entropy;
+	if (gscf->batch || gscf->compress) {
+		gossip_udp_ctx->bundle = njt_palloc(cycle->pool, GOSSIP_MTU);
+		gossip_udp_ctx->zraw = njt_palloc(cycle->pool, GOSSIP_BUNDLE_RAW_MAX);
+		if (gossip_udp_ctx->bundle == NULL || gossip_udp_ctx->zraw == NULL) {
+			return NJT_ERROR;
+		}
+	}
+
 	gossip_udp_ctx->pid = NULL;
 	gossip_udp_ctx->req_ctx = gscf->req_ctx;
 
@@ -869,7 +1465,7 @@ static njt_int_t add_self_to_memberslist()
 	if(p_member == NULL){
 		njt_log_error(NJT_LOG_INFO, njt_cycle->log, 0, " gossip add_self_to_memberslist work[%d] pid:[%V]",
 			njt_worker, gossip_udp_ctx->pid);
-		p_member = njt_slab_alloc_locked(shared_ctx->shpool, sizeof(njt_gossip_member_list_t));
+		p_member = njt_slab_calloc_locked(shared_ctx->shpool, sizeof(njt_gossip_member_list_t));
 		p_member->next = NULL;
 
 		p_member->node_name.data = njt_slab_alloc_locked(shared_ctx->shpool, gossip_udp_ctx->node_name->len);
@@ -940,22 +1536,19 @@ char* njt_gossip_app_get_msg_buf(uint32_t msg_type, njt_str_t target, njt_str_t
 	}
 
 
-	if (ctx->requests==NULL) {
-		ctx->requests = njt_alloc_chain_link(ctx->pool);
-		ctx->requests->next = NULL;
-	} else {
-		chain_head= njt_alloc_chain_link(ctx->pool);
-		chain_head->next = ctx->requests;
-		ctx->requests = chain_head;
+	chain_head = njt_gossip_alloc_msg_buf(ctx);
+	if (chain_head == NULL) {
+		return NULL;
 	}
+
+	chain_head->next = ctx->requests;
+	ctx->requests = chain_head;
 	
 	//get work0 pid
 	if(ctx->pid == NULL){
 		njt_get_work0_pid();
 	}
 
-	ctx->requests->buf = njt_create_temp_buf(ctx->pool, 1400);
-	
     head = (char *)ctx->requests->buf->pos;
 	w=head;
 	w=mp_encode_array(w, 8);
@@ -967,10 +1560,441 @@ char* njt_gossip_app_get_msg_buf(uint32_t msg_type, njt_str_t target, njt_str_t
 	w = mp_encode_str(w,(const char*)target_pid.data,target_pid.len);
 	w = mp_encode_uint(w, msg_type);
 		
-	*len=ctx->requests->buf->end - (u_char*)w;
+	*len=ctx->requests->buf->end - (u_char*)w - GOSSIP_TRAILER_MAX;
+
+	return w;
+}
+
+
+/*
+ * a msg buf is a chain link, a buf and GOSSIP_MTU bytes in one block,
+ * sent ones are kept in ctx->free for reuse
+ */
+static njt_chain_t *
+njt_gossip_alloc_msg_buf(njt_gossip_udp_ctx_t *ctx)
+{
+	njt_chain_t 				*cl;
+	njt_buf_t 					*b;
+
+	if (ctx->free) {
+		cl = ctx->free;
+		ctx->free = cl->next;
+		ctx->nfree--;
+
+		cl->next = NULL;
+		cl->buf->last = cl->buf->pos;
+		return cl;
+	}
+
+	cl = njt_alloc(sizeof(njt_chain_t) + sizeof(njt_buf_t) + GOSSIP_MTU, ctx->log);
+	if (cl == NULL) {
+		return NULL;
+	}
+
+	b = (njt_buf_t *) (cl + 1);
+	njt_memzero(b, sizeof(njt_buf_t));
+	b->start = (u_char *) (b + 1);
+	b->pos = b->start;
+	b->last = b->start;
+	b->end = b->start + GOSSIP_MTU;
+	b->temporary = 1;
+
+	cl->buf = b;
+	cl->next = NULL;
+
+	return cl;
+}
+
+
+static void
+njt_gossip_free_msg_bufs(njt_gossip_udp_ctx_t *ctx, njt_chain_t *cl)
+{
+	njt_chain_t 				*ln;
+
+	while (cl) {
+		ln = cl->next;
+
+		if (ctx->nfree < GOSSIP_FREE_BUFS) {
+			cl->next = ctx->free;
+			ctx->free = cl;
+			ctx->nfree++;
+		} else {
+			njt_free(cl);
+		}
+
+		cl = ln;
+	}
+}
+
+
+/*
+ * r points to the first field after the pid, cnt is the array size of msg
+ */
+static const char *
+njt_gossip_msg_body(njt_buf_t *b, uint32_t *cnt)
+{
+	const char 					*r;
+
+	r = (const char *) b->pos;
+	*cnt = mp_decode_array(&r);
+	mp_next(&r);	//magic
+	mp_next(&r);	//cluster
+	mp_next(&r);	//node
+	mp_next(&r);	//pid
+
+	return r;
+}
+
+
+/*
+ * app msgs are stamped with a seq and kept in ring for retransmit,
+ * heartbeat is stamped with the digest of last seqs of all apps
+ */
+static void
+njt_gossip_stamp_msg_locked(njt_gossip_udp_ctx_t *ctx, njt_buf_t *b)
+{
+	njt_gossip_shctx_t 			*sh;
+	njt_gossip_app_stat_t 		*st;
+	njt_gossip_ring_slot_t 		*slot;
+	njt_uint_t 					 i, n;
+	uint32_t 					 cnt, msg_type;
+	const char 					*r;
+	char 						*w;
+
+	sh = ctx->req_ctx->sh;
+	r = njt_gossip_msg_body(b, &cnt);
+
+	//tips: msg is stamped already, it is a retransmit
+	if (cnt != 8) {
+		return;
+	}
+
+	mp_next(&r);	//target
+	mp_next(&r);	//target pid
+	msg_type = mp_decode_uint(&r);
+
+	switch (msg_type) {
+	case GOSSIP_ON:
+	case GOSSIP_OFF:
+	case GOSSIP_MSG_SYN:
+	case GOSSIP_NACK:
+		return;
+
+	case GOSSIP_HEARTBEAT:
+		if (!ctx->anti_entropy) {
+			return;
+		}
+
+		for (i = 0, n = 0; i < sh->napps; i++) {
+			if (sh->apps[i].seq) {
+				n++;
+			}
+		}
+
+		if ((size_t) (b->end - b->last) < 5 + n * 10) {
+			return;
+		}
+
+		w = mp_encode_array((char *) b->last, 2 * n);
+		for (i = 0; i < sh->napps; i++) {
+			if (sh->apps[i].seq) {
+				w = mp_encode_uint(w, sh->apps[i].app_magic);
+				w = mp_encode_uint(w, sh->apps[i].seq);
+			}
+		}
+		b->last = (u_char *) w;
+		mp_encode_array((char *) b->pos, 9);
+		return;
+
+	default:
+		st = njt_gossip_app_stat_locked(sh, msg_type);
+		if (st == NULL) {
+			return;
+		}
+
+		st->tx_msgs++;
+		st->tx_bytes += b->last - b->pos;
+
+		if (!ctx->anti_entropy) {
+			return;
+		}
+
+		if (++st->seq == 0) {
+			st->seq = 1;
+		}
+
+		b->last = (u_char *) mp_encode_uint((char *) b->last, st->seq);
+		mp_encode_array((char *) b->pos, 9);
+
+		if (sh->ring == NULL) {
+			sh->ring = njt_slab_calloc_locked(ctx->req_ctx->shpool,
+					sizeof(njt_gossip_ring_slot_t) * GOSSIP_RING_SIZE);
+			if (sh->ring == NULL) {
+				njt_log_error(NJT_LOG_WARN, ctx->log, 0,
+					" gossip zone too small for retransmit ring, nack is answered by syn");
+				return;
+			}
+		}
+
+		slot = &sh->ring[sh->ring_next++ % GOSSIP_RING_SIZE];
+		slot->app_magic = msg_type;
+		slot->seq = st->seq;
+		slot->sent = njt_current_msec;
+		slot->len = b->last - b->pos;
+		njt_memcpy(slot->data, b->pos, slot->len);
+	}
+}
+
+
+static void
+njt_gossip_send_packet(njt_gossip_udp_ctx_t *ctx, u_char *data, size_t len,
+	njt_gossip_tx_stat_t *stat)
+{
+	ssize_t 					 n;
+
+	n = njt_udp_send(ctx->udp, data, len);
+	if (n != (ssize_t) len) {
+		//tips: udp is best effort, the lost is found by seq
+		njt_log_error(NJT_LOG_DEBUG, ctx->log, 0, " gossip send failed:%z", n);
+		ctx->udp->write->ready = 1;
+		stat->errors++;
+		return;
+	}
+
+	stat->packets++;
+	stat->bytes += len;
+}
+
+
+static char *
+njt_gossip_bundle_head(njt_gossip_udp_ctx_t *ctx, uint32_t msg_type)
+{
+	char 						*w;
+
+	w = (char *) ctx->bundle;
+	w = mp_encode_array(w, 8);
+	w = mp_encode_uint(w, GOSSIP_MAGIC);
+	w = mp_encode_str(w,(const char*)ctx->cluster_name->data,ctx->cluster_name->len);
+	w = mp_encode_str(w,(const char*)ctx->node_name->data,ctx->node_name->len);
+	w = mp_encode_str(w,(const char*)ctx->pid->data,ctx->pid->len);
+	w = mp_encode_str(w, "all", 3);
+	w = mp_encode_str(w, "0", 1);
+	w = mp_encode_uint(w, msg_type);
 
 	return w;
 }
+
+
+/*
+ * copy msgs from cl into [p, last) as an array of bundled msgs,
+ * return the next msg not copied
+ */
+static njt_chain_t *
+njt_gossip_bundle_msgs(njt_chain_t *cl, u_char *p, u_char *last, u_char **end,
+	uint32_t *n, size_t *raw)
+{
+	u_char 						*items;
+	const char 					*body;
+	uint32_t 					 cnt;
+	size_t 						 len;
+
+	items = p;
+	p += 3;
+	*n = 0;
+
+	for ( /* void */ ; cl && *n < 0xffff; cl = cl->next) {
+		body = njt_gossip_msg_body(cl->buf, &cnt);
+		len = cl->buf->last - (u_char *) body;
+
+		if ((size_t) (last - p) < 1 + len) {
+			break;
+		}
+
+		p = (u_char *) mp_encode_array((char *) p, cnt - 4);
+		p = njt_cpymem(p, body, len);
+
+		(*n)++;
+		*raw += cl->buf->last - cl->buf->pos;
+	}
+
+	//tips: array16 is used always, size is set after the msgs are copied
+	items[0] = 0xdc;
+	items[1] = (u_char) (*n >> 8);
+	items[2] = (u_char) *n;
+	*end = p;
+
+	return cl;
+}
+
+
+static njt_chain_t *
+njt_gossip_send_bundle(njt_gossip_udp_ctx_t *ctx, njt_chain_t *cl,
+	njt_gossip_tx_stat_t *stat)
+{
+	njt_chain_t 				*next;
+	u_char 						*p, *end;
+	uint32_t 					 n;
+	size_t 						 raw;
+
+	raw = 0;
+	p = (u_char *) njt_gossip_bundle_head(ctx, GOSSIP_BUNDLE);
+	next = njt_gossip_bundle_msgs(cl, p, ctx->bundle + GOSSIP_MTU, &end, &n, &raw);
+
+	//tips: a single msg is sent as is
+	if (n <= 1) {
+		njt_gossip_send_packet(ctx, cl->buf->pos, cl->buf->last - cl->buf->pos, stat);
+		return cl->next;
+	}
+
+	njt_gossip_send_packet(ctx, ctx->bundle, end - ctx->bundle, stat);
+	stat->bundles++;
+	stat->raw_bytes += raw;
+
+	return next;
+}
+
+
+#if (NJT_ZLIB)
+
+static njt_chain_t *
+njt_gossip_send_zbundle(njt_gossip_udp_ctx_t *ctx, njt_chain_t *cl,
+	njt_gossip_tx_stat_t *stat)
+{
+	njt_chain_t 				*next;
+	u_char 						*p, *end;
+	uint32_t 					 n;
+	size_t 						 raw, limit, room;
+	uLongf 						 zlen;
+	int 						 rc;
+
+	p = (u_char *) njt_gossip_bundle_head(ctx, GOSSIP_BUNDLE_Z);
+
+	room = ctx->bundle + GOSSIP_MTU - p - 1 - 5 - 5;
+	limit = GOSSIP_BUNDLE_RAW_MAX;
+
+	for ( ;; ) {
+		raw = 0;
+		next = njt_gossip_bundle_msgs(cl, ctx->zraw, ctx->zraw + limit, &end, &n, &raw);
+		if (n == 0) {
+			njt_gossip_send_packet(ctx, cl->buf->pos, cl->buf->last - cl->buf->pos, stat);
+			return cl->next;
+		}
+
+		zlen = room;
+		rc = compress2(p + 1 + 5 + 5, &zlen, ctx->zraw, end - ctx->zraw, 1);
+		if (rc == Z_OK) {
+			break;
+		}
+
+		//tips: not fit in a packet, bundle less msgs
+		if (rc != Z_BUF_ERROR || n == 1) {
+			return njt_gossip_send_bundle(ctx, cl, stat);
+		}
+
+		limit = (end - ctx->zraw) / 2;
+	}
+
+	if (zlen >= (uLongf) (end - ctx->zraw)) {
+		return njt_gossip_send_bundle(ctx, cl, stat);
+	}
+
+	//tips: data is compressed in place, so the head has fixed size:
+	// array(2), uint32 raw len and bin32 head
+	p = (u_char *) mp_encode_array((char *) p, 2);
+	*p++ = 0xce;
+	p = (u_char *) mp_store_u32((char *) p, end - ctx->zraw);
+	*p++ = 0xc6;
+	p = (u_char *) mp_store_u32((char *) p, zlen);
+
+	njt_gossip_send_packet(ctx, ctx->bundle, p + zlen - ctx->bundle, stat);
+	stat->bundles++;
+	stat->raw_bytes += raw;
+
+	return next;
+}
+
+#endif
+
+
+static void
+njt_gossip_flush(njt_gossip_udp_ctx_t *ctx)
+{
+	njt_gossip_req_ctx_t  		*shared_ctx;
+	njt_gossip_tx_stat_t 		 stat;
+	njt_chain_t 				*cl, *ln, *chain;
+
+	if (ctx->flush_ev.timer_set) {
+		njt_del_timer(&ctx->flush_ev);
+	}
+
+	if (ctx->requests == NULL) {
+		return;
+	}
+
+	//requests is lifo, reverse it so msgs are sent in order
+	chain = NULL;
+	for (cl = ctx->requests; cl; cl = ln) {
+		ln = cl->next;
+		cl->next = chain;
+		chain = cl;
+	}
+	ctx->requests = NULL;
+
+	shared_ctx = ctx->req_ctx;
+
+	njt_shmtx_lock(&shared_ctx->shpool->mutex);
+	for (cl = chain; cl; cl = cl->next) {
+		njt_gossip_stamp_msg_locked(ctx, cl->buf);
+	}
+	njt_shmtx_unlock(&shared_ctx->shpool->mutex);
+
+	njt_memzero(&stat, sizeof(njt_gossip_tx_stat_t));
+
+	cl = chain;
+	while (cl) {
+		if (ctx->batch == 0 && !ctx->compress) {
+			njt_gossip_send_packet(ctx, cl->buf->pos, cl->buf->last - cl->buf->pos, &stat);
+			cl = cl->next;
+			continue;
+		}
+
+#if (NJT_ZLIB)
+		if (ctx->compress) {
+			cl = njt_gossip_send_zbundle(ctx, cl, &stat);
+			continue;
+		}
+#endif
+
+		cl = njt_gossip_send_bundle(ctx, cl, &stat);
+	}
+
+	njt_shmtx_lock(&shared_ctx->shpool->mutex);
+	shared_ctx->sh->tx_packets += stat.packets;
+	shared_ctx->sh->tx_bytes += stat.bytes;
+	shared_ctx->sh->tx_errors += stat.errors;
+	shared_ctx->sh->tx_bundles += stat.bundles;
+	shared_ctx->sh->tx_raw_bytes += stat.raw_bytes;
+	njt_shmtx_unlock(&shared_ctx->shpool->mutex);
+
+	njt_gossip_free_msg_bufs(ctx, chain);
+}
+
+
+static void
+njt_gossip_flush_handler(njt_event_t *ev)
+{
+	njt_connection_t 			*c;
+
+	c = ev->data;
+	njt_gossip_flush((njt_gossip_udp_ctx_t *) c->data);
+}
+
+
+njt_gossip_req_ctx_t *
+njt_gossip_get_req_ctx(void)
+{
+	return gossip_udp_ctx ? gossip_udp_ctx->req_ctx : NULL;
+}
 static njt_int_t njt_gossip_connect(njt_gossip_udp_ctx_t *ctx)
 {
     njt_socket_t 		s;
@@ -1053,6 +2077,11 @@ static njt_int_t njt_gossip_connect(njt_gossip_udp_ctx_t *ctx)
 	wev->cancelable = 1;
     wev->handler = njt_gossip_send_handler;
 
+	ctx->flush_ev.handler = njt_gossip_flush_handler;
+	ctx->flush_ev.data = c;
+	ctx->flush_ev.log = ctx->log;
+	ctx->flush_ev.cancelable = 1;
+
     return NJT_OK;
 
 failed:
@@ -1067,8 +2096,6 @@ static void njt_gossip_send_handler(njt_event_t *ev)
 {
     njt_connection_t 			*c;
     njt_gossip_udp_ctx_t 		*ctx;
-	njt_chain_t 				*chain, *ln, *cl , *chain_head;
-
     c = ev->data;
     ctx = (njt_gossip_udp_ctx_t *)c->data;
 
@@ -1080,24 +2107,14 @@ static void njt_gossip_send_handler(njt_event_t *ev)
 	}
 
 	if (ctx->requests ) {
-		chain_head = ctx->requests;
-		chain = njt_send_chain(ctx->udp,chain_head, 0);
-		//tips: assume chain is null when sent completely
-		//todo: may send partical if chain is too long
-		for (cl = chain_head; cl && cl != chain; /* void */)
-        {
-            ln = cl;
-            cl = cl->next;
-            njt_free_chain(ctx->pool, ln);
-        }
-		ctx->requests=NULL;
-
-		if  (chain == NJT_CHAIN_ERROR)
-        {
-            njt_log_error(NJT_LOG_ERR, ctx->log, 0, "send chain error:");
-            return;
-        } else 
-            njt_log_error(NJT_LOG_DEBUG, ctx->log, 0, "send chain ok: %p", chain);
+		//tips: with batch, msgs of all apps in the time are sent by flush_ev
+		if (ctx->batch && !njt_exiting) {
+			if (!ctx->flush_ev.timer_set) {
+				njt_add_timer(&ctx->flush_ev, ctx->batch);
+			}
+		} else {
+			njt_gossip_flush(ctx);
+		}
 	}
 
 	if (ev->timedout && !njt_exiting)
@@ -1180,7 +2197,10 @@ static void   gossip_stop(njt_cycle_t *cycle)
 		njt_str_t target_pid = njt_string("0");
 		njt_gossip_build_member_msg(GOSSIP_OFF, &target_node, &target_pid, 0);
 		njt_log_error(NJT_LOG_INFO,cycle->log,0,"node stop, broad offline msg");
-		njt_gossip_send_handler(gossip_udp_ctx->udp->write);
+	}
+
+	if (gossip_udp_ctx) {
+		njt_gossip_flush(gossip_udp_ctx);
 	}
 }
 int  njt_gossip_reg_app_handler( gossip_app_pt app_msg_handler, gossip_app_node_pt app_node_handler, uint32_t app_magic, void* data)
@@ -20,6 +20,26 @@
 #define GOSSIP_HEARTBEAT 0xE4880F7B
 //crc of msgsync
 #define GOSSIP_MSG_SYN 0xEF7CCE4F
+//crc of nack
+#define GOSSIP_NACK 0x27187E8F
+//crc of bundle
+#define GOSSIP_BUNDLE 0xA57B32FD
+//crc of bundlez
+#define GOSSIP_BUNDLE_Z 0xA17B823C
+
+//max datagram size, every msg buf has this size
+#define GOSSIP_MTU 1400
+//tips: room kept at the end of every msg buf for the seq (or the digest of
+// heartbeat) stamped when flushing, apps never see it
+#define GOSSIP_TRAILER_MAX 16
+//max raw size of a compressed bundle
+#define GOSSIP_BUNDLE_RAW_MAX 8192
+//max apps which can be tracked by seq and metrics
+#define GOSSIP_APP_MAX 16
+//sent app msgs kept for retransmit
+#define GOSSIP_RING_SIZE 128
+//same msg is not retransmitted again in this time, for nack from many nodes
+#define GOSSIP_RETRANS_GAP 100
 
 //todo:
 
@@ -56,6 +76,14 @@ enum node_state {
 
 
 
+//recv state of an app msg stream from a node
+typedef struct {
+	uint32_t						app_magic;
+	uint32_t						last;		//highest seq received
+	uint64_t						window;		//bit n set: seq (last - n) received
+} njt_gossip_peer_seq_t;
+
+
 typedef struct njt_gossip_member_list_s
 {
     struct njt_gossip_member_list_s *next;
@@ -66,6 +94,7 @@ typedef struct njt_gossip_member_list_s
     njt_msec_t  					uptime;
 	uint32_t  						state;
 	bool 							need_syn;
+	njt_gossip_peer_seq_t			seqs[GOSSIP_APP_MAX];
 } njt_gossip_member_list_t;
 
 struct gossip_app_msg_handle_s {
@@ -77,9 +106,53 @@ struct gossip_app_msg_handle_s {
 typedef struct gossip_app_msg_handle_s  gossip_app_msg_handle_t;
 
 
+typedef struct
+{
+	uint32_t					app_magic;
+	uint32_t					seq;			//last seq stamped by this node
+	uint64_t					tx_msgs;
+	uint64_t					tx_bytes;
+	uint64_t					rx_msgs;
+	uint64_t					rx_bytes;
+	uint64_t					rx_dups;		//dropped, already received
+	uint64_t					rx_lost;		//gaps found by seq or digest
+	uint64_t					nacks_sent;
+	uint64_t					nacks_recv;
+	uint64_t					retransmits;
+	uint64_t					full_syncs;		//nack answered by node_handler
+} njt_gossip_app_stat_t;
+
+
+typedef struct
+{
+	uint32_t					app_magic;
+	uint32_t					seq;
+	njt_msec_t					sent;
+	size_t						len;
+	u_char						data[GOSSIP_MTU];
+} njt_gossip_ring_slot_t;
+
+
 typedef struct
 {
     njt_gossip_member_list_t *members;
+
+	njt_gossip_app_stat_t	  apps[GOSSIP_APP_MAX];
+	njt_uint_t				  napps;
+
+	//datagrams on the wire
+	uint64_t				  tx_packets;
+	uint64_t				  tx_bytes;
+	uint64_t				  tx_errors;
+	uint64_t				  rx_packets;
+	uint64_t				  rx_bytes;
+	uint64_t				  rx_invalid;
+	//bundles and the msg bytes before bundling and compressing
+	uint64_t				  tx_bundles;
+	uint64_t				  tx_raw_bytes;
+
+	njt_gossip_ring_slot_t	 *ring;
+	njt_uint_t				  ring_next;
 } njt_gossip_shctx_t;
 
 
@@ -112,6 +185,17 @@ struct njt_gossip_udp_ctx_s
 	socklen_t 					 socklen;
 
 	njt_chain_t                 *requests;
+	njt_chain_t                 *free;		//sent msg bufs, reused
+	njt_uint_t                   nfree;
+
+	//tips: with batch, msgs of all apps are queued and flushed together
+	// by flush_ev as bundles
+	njt_msec_t					 batch;
+	njt_flag_t					 compress;
+	njt_flag_t					 anti_entropy;
+	njt_event_t					 flush_ev;
+	u_char						*bundle;
+	u_char						*zraw;
 
 	njt_pool_t                  *pool;
     njt_log_t                   *log;
@@ -139,8 +223,15 @@ typedef struct
 	//nodeclean timeout, should > heartbeat timeout, default 2*heartbeat
 	njt_msec_t                   nodeclean_timeout;
 	njt_event_t                  nc_timer;
+
+	//msgs coalesce time, 0 means send at once
+	njt_msec_t                   batch;
+	njt_flag_t                   compress;
+	njt_flag_t                   anti_entropy;
 } njt_gossip_srv_conf_t;
 
+njt_gossip_req_ctx_t *njt_gossip_get_req_ctx(void);
+
 //this should be done in init process
 
 
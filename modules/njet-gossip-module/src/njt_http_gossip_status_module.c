@@ -0,0 +1,197 @@
+
+/*
+ * Copyright (C) 2021-2023 TMLake(Beijing) Technology Co., Ltd.
+ */
+
+#include <njt_config.h>
+#include <njt_core.h>
+#include <njt_http.h>
+
+#include "njt_gossip_module.h"
+
+
+static char *njt_http_gossip_status(njt_conf_t *cf, njt_command_t *cmd, void *conf);
+static njt_int_t njt_http_gossip_status_handler(njt_http_request_t *r);
+
+
+static njt_command_t njt_http_gossip_status_commands[] = {
+    { njt_string("gossip_status"),
+      NJT_HTTP_LOC_CONF|NJT_CONF_NOARGS,
+      njt_http_gossip_status,
+      0,
+      0,
+      NULL },
+    njt_null_command
+};
+
+
+static njt_http_module_t njt_http_gossip_status_module_ctx = {
+    NULL,                                   /* preconfiguration */
+    NULL,                                   /* postconfiguration */
+
+    NULL,                                   /* create main configuration */
+    NULL,                                   /* init main configuration */
+
+    NULL,                                   /* create server configuration */
+    NULL,                                   /* merge server configuration */
+
+    NULL,                                   /* create location configuration */
+    NULL                                    /* merge location configuration */
+};
+
+
+njt_module_t njt_http_gossip_status_module = {
+    NJT_MODULE_V1,
+    &njt_http_gossip_status_module_ctx,     /* module context */
+    njt_http_gossip_status_commands,        /* module directives */
+    NJT_HTTP_MODULE,                        /* module type */
+    NULL,                                   /* init master */
+    NULL,                                   /* init module */
+    NULL,                                   /* init process */
+    NULL,                                   /* init thread */
+    NULL,                                   /* exit thread */
+    NULL,                                   /* exit process */
+    NULL,                                   /* exit master */
+    NJT_MODULE_V1_PADDING
+};
+
+
+static char *
+njt_http_gossip_status(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_core_loc_conf_t  *clcf;
+
+    clcf = njt_http_conf_get_module_loc_conf(cf, njt_http_core_module);
+    clcf->handler = njt_http_gossip_status_handler;
+
+    return NJT_CONF_OK;
+}
+
+
+static u_char *
+njt_http_gossip_status_apps(u_char *p, njt_gossip_shctx_t *sh)
+{
+    njt_uint_t              i;
+    njt_gossip_app_stat_t  *st;
+
+    p = njt_sprintf(p, "\"apps\":[");
+
+    for (i = 0; i < sh->napps; i++) {
+        st = &sh->apps[i];
+        p = njt_sprintf(p, "%s{\"app_magic\":%uD,\"seq\":%uD,"
+                        "\"tx_msgs\":%uL,\"tx_bytes\":%uL,"
+                        "\"rx_msgs\":%uL,\"rx_bytes\":%uL,"
+                        "\"rx_dups\":%uL,\"rx_lost\":%uL,"
+                        "\"nacks_sent\":%uL,\"nacks_recv\":%uL,"
+                        "\"retransmits\":%uL,\"full_syncs\":%uL}",
+                        i ? "," : "", st->app_magic, st->seq,
+                        st->tx_msgs, st->tx_bytes, st->rx_msgs, st->rx_bytes,
+                        st->rx_dups, st->rx_lost, st->nacks_sent,
+                        st->nacks_recv, st->retransmits, st->full_syncs);
+    }
+
+    return njt_sprintf(p, "]");
+}
+
+
+static njt_int_t
+njt_http_gossip_status_handler(njt_http_request_t *r)
+{
+    size_t                     len;
+    u_char                    *p;
+    njt_int_t                  rc;
+    njt_buf_t                 *b;
+    njt_chain_t                out;
+    njt_gossip_shctx_t        *sh;
+    njt_gossip_req_ctx_t      *ctx;
+    njt_gossip_member_list_t  *m;
+    njt_str_t                  type = njt_string("application/json");
+
+    if (!(r->method & (NJT_HTTP_GET|NJT_HTTP_HEAD))) {
+        return NJT_HTTP_NOT_ALLOWED;
+    }
+
+    rc = njt_http_discard_request_body(r);
+    if (rc != NJT_OK) {
+        return rc;
+    }
+
+    ctx = njt_gossip_get_req_ctx();
+    if (ctx == NULL || ctx->sh == NULL) {
+        return NJT_HTTP_NOT_FOUND;
+    }
+
+    sh = ctx->sh;
+
+    njt_shmtx_lock(&ctx->shpool->mutex);
+
+    len = sizeof("{\"packets\":{\"tx\":,\"tx_bytes\":,\"tx_errors\":,"
+                 "\"rx\":,\"rx_bytes\":,\"rx_invalid\":},"
+                 "\"bundles\":{\"tx\":,\"raw_bytes\":},\"apps\":[],"
+                 "\"members\":[]}") + 8 * NJT_INT64_LEN
+          + sh->napps * (sizeof("{\"app_magic\":,\"seq\":,\"tx_msgs\":,"
+                                "\"tx_bytes\":,\"rx_msgs\":,\"rx_bytes\":,"
+                                "\"rx_dups\":,\"rx_lost\":,\"nacks_sent\":,"
+                                "\"nacks_recv\":,\"retransmits\":,"
+                                "\"full_syncs\":},")
+                         + 12 * NJT_INT64_LEN);
+
+    for (m = sh->members ? sh->members->next : NULL; m; m = m->next) {
+        len += sizeof("{\"node\":\"\",\"pid\":\"\",\"uptime\":,\"last_seen\":},")
+               + 2 * NJT_INT64_LEN
+               + m->node_name.len
+               + njt_escape_json(NULL, m->node_name.data, m->node_name.len)
+               + m->pid.len
+               + njt_escape_json(NULL, m->pid.data, m->pid.len);
+    }
+
+    b = njt_create_temp_buf(r->pool, len);
+    if (b == NULL) {
+        njt_shmtx_unlock(&ctx->shpool->mutex);
+        return NJT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    p = njt_sprintf(b->last, "{\"packets\":{\"tx\":%uL,\"tx_bytes\":%uL,"
+                    "\"tx_errors\":%uL,\"rx\":%uL,\"rx_bytes\":%uL,"
+                    "\"rx_invalid\":%uL},\"bundles\":{\"tx\":%uL,"
+                    "\"raw_bytes\":%uL},",
+                    sh->tx_packets, sh->tx_bytes, sh->tx_errors,
+                    sh->rx_packets, sh->rx_bytes, sh->rx_invalid,
+                    sh->tx_bundles, sh->tx_raw_bytes);
+
+    p = njt_http_gossip_status_apps(p, sh);
+
+    p = njt_sprintf(p, ",\"members\":[");
+
+    for (m = sh->members ? sh->members->next : NULL; m; m = m->next) {
+        p = njt_sprintf(p, "{\"node\":\"");
+        p = (u_char *) njt_escape_json(p, m->node_name.data, m->node_name.len);
+        p = njt_sprintf(p, "\",\"pid\":\"");
+        p = (u_char *) njt_escape_json(p, m->pid.data, m->pid.len);
+        p = njt_sprintf(p, "\",\"uptime\":%M,\"last_seen\":%M}%s",
+                        m->uptime, njt_current_msec - m->last_seen,
+                        m->next ? "," : "");
+    }
+
+    njt_shmtx_unlock(&ctx->shpool->mutex);
+
+    p = njt_sprintf(p, "]}");
+    b->last = p;
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    r->headers_out.status = NJT_HTTP_OK;
+    r->headers_out.content_type_len = type.len;
+    r->headers_out.content_type = type;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    rc = njt_http_send_header(r);
+    if (rc == NJT_ERROR || rc > NJT_OK || r->header_only) {
+        return rc;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    return njt_http_output_filter(r, &out);
+}
@@ -20,6 +20,16 @@
 
 #define GOSSIP_APP_CLUSTER_LIMIT_CONN  0x57B7D7DA
 
+#define CLUSTER_LIMIT_CONN_SYNC_VER     1
+//worst case size of one encoded (id, conn) pair
+#define CLUSTER_LIMIT_CONN_PAIR_SIZE    (9 + 3)
+
+typedef struct
+{
+    uint64_t                        id;
+    u_short                         conn;
+} njt_http_cluster_limit_conn_pair_t;
+
 extern njt_module_t  njt_mqconf_module;
 
 static njt_array_t *clconn_ctxes = NULL;
@@ -42,6 +52,8 @@ static char *njt_http_cluster_limit_conn(njt_conf_t *cf, njt_command_t *cmd,
 static njt_int_t njt_http_cluster_limit_conn_add_variables(njt_conf_t *cf);
 static njt_int_t njt_http_cluster_limit_conn_init(njt_conf_t *cf);
 
+static void njt_http_cluster_limit_conn_send_compact(njt_http_cluster_limit_conn_ctx_t *ctx,
+                                                     njt_str_t *zone, njt_str_t *target, njt_str_t *target_pid);
 static void njt_http_udp_send_handler(njt_http_cluster_limit_conn_ctx_t* ctx,
             njt_str_t* zone, njt_str_t* target, njt_str_t* target_pid);
 
@@ -73,7 +85,8 @@ static njt_conf_num_bounds_t njt_http_cluster_limit_conn_status_bounds = {
     
 static njt_command_t njt_http_cluster_limit_conn_commands[] = {
     {njt_string("cluster_limit_conn"),
-     NJT_HTTP_MAIN_CONF | NJT_HTTP_SRV_CONF | NJT_HTTP_LOC_CONF | NJT_CONF_TAKE3,
+     NJT_HTTP_MAIN_CONF | NJT_HTTP_SRV_CONF | NJT_HTTP_LOC_CONF | NJT_CONF_TAKE3
+         | NJT_CONF_TAKE4,
      njt_http_cluster_limit_conn,
      NJT_HTTP_LOC_CONF_OFFSET,
      0,
@@ -172,19 +185,23 @@ static void njt_http_cluster_limit_conn_sync(njt_event_t *ev)
 				continue;
 			}
 		
+            if (zone_ctxes[i]->compact) {
+                njt_http_cluster_limit_conn_send_compact(zone_ctxes[i], &zone_ctxes[i]->zone_name, &target, &target_pid);
+                continue;
+            }
+
             njt_http_udp_send_handler(zone_ctxes[i], &zone_ctxes[i]->zone_name, &target, &target_pid);
 		}
 	}
 }
 
 
-static void njt_cluster_limit_conn_update_conn(njt_str_t key_in, int other_conn, njt_http_cluster_limit_conn_ctx_t *ctx, njt_str_t sibling_node)
+static void njt_cluster_limit_conn_update_conn(njt_str_t key_in, uint32_t hash, int other_conn, njt_http_cluster_limit_conn_ctx_t *ctx, njt_str_t sibling_node)
 {
     size_t                              n, i;
     njt_rbtree_node_t                   *node;
     njt_http_cluster_limit_conn_node_t  *lc;
     njt_http_limit_sibling_t            *v;
-    njt_uint_t                          hash;
 
     // if (ctx->shpool == NULL)
     // {
@@ -192,7 +209,6 @@ static void njt_cluster_limit_conn_update_conn(njt_str_t key_in, int other_conn,
     //     ctx->shpool = (njt_slab_pool_t *)ctx->shm_zone->shm.addr;
     //     ctx->sh = ctx->shpool->data;
     // }
-    hash = njt_crc32_short(key_in.data, key_in.len);
     njt_shmtx_lock(&ctx->shpool->mutex);
     node = njt_http_cluster_limit_conn_lookup(&ctx->sh->rbtree, &key_in, hash);
     if (node == NULL)
@@ -264,10 +280,60 @@ static void njt_cluster_limit_conn_update_conn(njt_str_t key_in, int other_conn,
         njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
             " cluster_limit_conn overflow in array, found:%d, receive:%d,%V",
             lc->conn, other_conn, &sibling_node);
+        njt_shmtx_unlock(&ctx->shpool->mutex);
     }
 }
 
 
+static int njt_cluster_limit_conn_recv_compact(const char *r, njt_http_cluster_limit_conn_ctx_t *ctx,
+    njt_str_t sibling_node)
+{
+    uint32_t                        len, arr_cnt, i;
+    uint64_t                        id;
+    njt_uint_t                      conn;
+    njt_str_t                       key, key_in;
+
+    key.data = (u_char *)mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 3 || njt_memcmp(key.data, "ver", key.len) != 0
+        || mp_decode_uint(&r) != CLUSTER_LIMIT_CONN_SYNC_VER)
+    {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster_limit_conn unknown compact version");
+        return NJT_ERROR;
+    }
+
+    if (!ctx->compact)
+    {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+            " cluster_limit_conn compact data for zone:%V without sync=compact", &ctx->zone_name);
+        return NJT_ERROR;
+    }
+
+    key.data = (u_char *)mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 3 || njt_memcmp(key.data, "ids", key.len) != 0)
+    {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster_limit_conn not ids:%V", &key);
+        return NJT_ERROR;
+    }
+
+    arr_cnt = mp_decode_array(&r);
+
+    key_in.data = (u_char *)&id;
+    key_in.len = sizeof(uint64_t);
+
+    for (i = 0; i + 1 < arr_cnt; i += 2)
+    {
+        id = mp_decode_uint(&r);
+        conn = mp_decode_uint(&r);
+
+        njt_cluster_limit_conn_update_conn(key_in, (uint32_t)id, conn, ctx, sibling_node);
+    }
+
+    return NJT_OK;
+}
+
+
 static int njt_cluster_limit_conn_recv_data(const char* msg, void* data)
 {
     njt_http_cluster_limit_conn_ctx_t               *ctx;
@@ -277,7 +343,7 @@ static int njt_cluster_limit_conn_recv_data(const char* msg, void* data)
     njt_str_t                       sibling_node;
 
     uint32_t size = mp_decode_map(&r);
-    if (size != 3)
+    if (size != 3 && size != 4)
     {
         //todo
         njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
@@ -322,6 +388,11 @@ static int njt_cluster_limit_conn_recv_data(const char* msg, void* data)
         return NJT_ERROR;
     }
 
+    if (size == 4)
+    {
+        return njt_cluster_limit_conn_recv_compact(r, ctx, sibling_node);
+    }
+
     arr_cnt = mp_decode_array(&r);
     for (size = 0; size < arr_cnt; size++)
     {
@@ -346,7 +417,8 @@ static int njt_cluster_limit_conn_recv_data(const char* msg, void* data)
         }
 
         current_conn = mp_decode_uint(&r);
-        njt_cluster_limit_conn_update_conn(key_in, current_conn, ctx, sibling_node);
+        njt_cluster_limit_conn_update_conn(key_in, njt_crc32_short(key_in.data, key_in.len),
+                                           current_conn, ctx, sibling_node);
     }
 
 	return NJT_OK;
@@ -566,6 +638,118 @@ void njt_http_udp_send_handler(njt_http_cluster_limit_conn_ctx_t *ctx, njt_str_t
     return;
 }
 
+
+/*  compact encode format
+ *  { "node": node,
+ *    "zone": zone,
+ *    "ver": 1,
+ *    "ids": [ id, conn, id, conn, ... ]
+ *  }
+ * */
+static void
+njt_http_cluster_limit_conn_send_compact(njt_http_cluster_limit_conn_ctx_t *ctx,
+    njt_str_t *zone, njt_str_t *target, njt_str_t *target_pid)
+{
+    njt_array_t                 out_arr;
+    njt_uint_t                  idx, cnt;
+    njt_msec_t                  now = njt_current_msec;
+    sync_queue_t                *client;
+    char                        *buf, *tail, *end, *replace_cnt;
+    size_t                      buf_size;
+    njt_http_cluster_limit_conn_pair_t  *item;
+
+    ctx->pool->log = njt_cycle->log;
+    njt_reset_pool(ctx->pool);
+
+    if (njt_array_init(&out_arr, ctx->pool, 256, sizeof(njt_http_cluster_limit_conn_pair_t))
+        != NJT_OK)
+    {
+        return;
+    }
+
+    //tips: copy out only the 64 bits id and the counter, not the whole item
+    njt_shmtx_lock(&ctx->shpool->mutex);
+
+    for (client = ctx->sh->clients; client != NULL; client = client->next)
+    {
+        if (client == client->next)
+        {
+            njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                " cluster_limit_conn client:%p,%p", client, client->next);
+            break;
+        }
+
+        if (now - client->q_item.last_changed >= SYNC_INT)
+        {
+            continue;
+        }
+
+        item = njt_array_push(&out_arr);
+        if (item == NULL)
+        {
+            break;
+        }
+
+        njt_memcpy(&item->id, client->q_item.sibling_item.data, sizeof(uint64_t));
+        item->conn = client->q_item.sibling_item.conn;
+
+        client->q_item.last_changed = now;
+    }
+
+    njt_shmtx_unlock(&ctx->shpool->mutex);
+
+    item = out_arr.elts;
+    for (idx = 0; idx < out_arr.nelts; /* void */)
+    {
+        buf_size = 0;
+        buf = njt_gossip_app_get_msg_buf(GOSSIP_APP_CLUSTER_LIMIT_CONN, *target, *target_pid, &buf_size);
+        if (buf_size <= 0 || buf == NULL)
+        {
+            njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster_limit_conn apply buffer failed");
+            return;
+        }
+
+        end = buf + buf_size;
+
+        tail = mp_encode_map(buf, 4);
+
+        tail = mp_encode_str(tail, "node", 4);
+        tail = mp_encode_bin(tail, (const char *)ctx->node_name->data, ctx->node_name->len);
+
+        tail = mp_encode_str(tail, "zone", 4);
+        tail = mp_encode_bin(tail, (const char *)zone->data, zone->len);
+
+        tail = mp_encode_str(tail, "ver", 3);
+        tail = mp_encode_uint(tail, CLUSTER_LIMIT_CONN_SYNC_VER);
+
+        tail = mp_encode_str(tail, "ids", 3);
+
+        //tips: reserve an array16 header, the count is filled when the packet is full
+        replace_cnt = tail;
+        tail += 3;
+        cnt = 0;
+
+        while (idx < out_arr.nelts && end - tail >= CLUSTER_LIMIT_CONN_PAIR_SIZE)
+        {
+            tail = mp_encode_uint(tail, item[idx].id);
+            tail = mp_encode_uint(tail, item[idx].conn);
+            cnt += 2;
+            idx++;
+        }
+
+        mp_store_u16(mp_store_u8(replace_cnt, 0xdc), cnt);
+        njt_gossip_app_close_msg_buf(tail);
+        njt_gossip_send_app_msg_buf();
+
+        if (cnt == 0)
+        {
+            njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                          " cluster_limit_conn no room for ids in packet");
+            break;
+        }
+    }
+}
+
 //end
 static njt_int_t
 njt_http_cluster_limit_conn_handler(njt_http_request_t *r)
@@ -583,6 +767,7 @@ njt_http_cluster_limit_conn_handler(njt_http_request_t *r)
     njt_http_cluster_limit_conn_cleanup_t *lccln;
     sync_queue_t *client;
     njt_msec_t now = njt_current_msec;
+    uint64_t id;
 
     if (r->main->limit_conn_status)
     {
@@ -620,7 +805,19 @@ njt_http_cluster_limit_conn_handler(njt_http_request_t *r)
 
         r->main->limit_conn_status = NJT_HTTP_CLUSTER_LIMIT_CONN_PASSED;
 
-        hash = njt_crc32_short(key.data, key.len);
+        if (ctx->compact)
+        {
+            //tips: compact zone stores a 64 bits key id instead of the key
+            id = ((uint64_t)njt_murmur_hash2(key.data, key.len) << 32)
+                 | njt_crc32_short(key.data, key.len);
+            key.data = (u_char *)&id;
+            key.len = sizeof(uint64_t);
+            hash = (uint32_t)id;
+        }
+        else
+        {
+            hash = njt_crc32_short(key.data, key.len);
+        }
 
         njt_shmtx_lock(&ctx->shpool->mutex);
 
@@ -985,6 +1182,15 @@ njt_http_cluster_limit_conn_init_zone(njt_shm_zone_t *shm_zone, void *data)
             return NJT_ERROR;
         }
 
+        if (ctx->compact != octx->compact)
+        {
+            njt_log_error(NJT_LOG_EMERG, shm_zone->shm.log, 0,
+                          "limit_conn_zone \"%V\" cannot change "
+                          "the \"sync\" mode on reload",
+                          &shm_zone->shm.name);
+            return NJT_ERROR;
+        }
+
         ctx->sh = octx->sh;
         ctx->shpool = octx->shpool;
 
@@ -1212,8 +1418,20 @@ njt_http_cluster_limit_conn(njt_conf_t *cf, njt_command_t *cmd, void *conf)
                 return NJT_CONF_ERROR;
             }
 
+            continue;
+        }else if (njt_strcmp(value[i].data, "sync=compact") == 0)
+        {
+            ctx->compact = 1;
+            continue;
+        }else if (njt_strcmp(value[i].data, "sync=full") == 0)
+        {
+            ctx->compact = 0;
             continue;
         }
+
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NJT_CONF_ERROR;
     }
 
     if (shm_name.len == 0)
@@ -74,6 +74,7 @@ typedef struct
     njt_str_t                           *node_name;
     njt_pool_t                          *pool;
     //end
+    njt_flag_t                          compact;
 
 } njt_http_cluster_limit_conn_ctx_t;
 
@@ -23,6 +23,18 @@
 
 #define GOSSIP_APP_CLUSTER_LIMIT_REQ  0xCE988BDE
 
+#define CLUSTER_LIMIT_REQ_SYNC_VER      1
+//max dirty keys drained from one zone on every sync tick
+#define CLUSTER_LIMIT_REQ_SYNC_BATCH    4096
+//worst case size of one encoded (id, delta) pair
+#define CLUSTER_LIMIT_REQ_PAIR_SIZE     (9 + 5)
+
+typedef struct
+{
+    uint64_t                        id;
+    uint32_t                        delta;
+} njt_http_cluster_limit_req_delta_t;
+
 extern njt_module_t  njt_mqconf_module;
 
 static njt_array_t *clreq_ctxes = NULL;
@@ -47,6 +59,8 @@ static int njt_cluster_limit_req_recv_data(const char* msg, void* data);
 static void *njt_http_cluster_limit_req_create_main_conf(njt_conf_t *cf);
 
 static void njt_http_udp_send_handler(njt_http_cluster_limit_req_ctx_t *ctx, njt_str_t* zone, njt_str_t* target, njt_str_t* target_pid);
+static void njt_http_cluster_limit_req_send_compact(njt_http_cluster_limit_req_ctx_t *ctx,
+                                                    njt_str_t *zone, njt_str_t *target, njt_str_t *target_pid);
 //end
 
 static njt_conf_enum_t njt_http_cluster_limit_req_log_levels[] = {
@@ -62,7 +76,8 @@ static njt_conf_num_bounds_t njt_http_cluster_limit_req_status_bounds = {
 static njt_command_t njt_http_cluster_limit_req_commands[] = {
 
     {njt_string("cluster_limit_req"),
-     NJT_HTTP_MAIN_CONF | NJT_HTTP_SRV_CONF | NJT_HTTP_LOC_CONF | NJT_CONF_TAKE3,
+     NJT_HTTP_MAIN_CONF | NJT_HTTP_SRV_CONF | NJT_HTTP_LOC_CONF | NJT_CONF_TAKE3
+         | NJT_CONF_TAKE4 | NJT_CONF_TAKE5,
      njt_http_cluster_limit_req,
      NJT_HTTP_LOC_CONF_OFFSET,
      0,
@@ -233,6 +248,134 @@ static njt_str_t njt_http_cluster_limit_req_status[] = {
 
 
 
+static njt_inline uint64_t
+njt_http_cluster_limit_req_key_id(njt_str_t *key)
+{
+    //tips: compact sync identifies keys by a 64 bits hash instead of the key itself
+    return ((uint64_t) njt_murmur_hash2(key->data, key->len) << 32)
+           | njt_crc32_short(key->data, key->len);
+}
+
+
+static njt_inline njt_uint_t
+njt_http_cluster_limit_req_cms_index(uint64_t id, njt_uint_t d)
+{
+    uint32_t h1, h2;
+
+    h1 = (uint32_t) id;
+    h2 = (uint32_t) (id >> 32) | 1;
+
+    return (h1 + d * h2) & (CLUSTER_LIMIT_REQ_CMS_WIDTH - 1);
+}
+
+
+static void
+njt_http_cluster_limit_req_cms_add(njt_http_cluster_limit_req_shctx_t *sh,
+    uint64_t id, uint64_t ctf)
+{
+    njt_uint_t                          d, idx;
+    njt_http_cluster_limit_req_cms_t   *cms;
+
+    cms = &sh->cms[0];
+
+    if (cms->frame != ctf) {
+        njt_memzero(cms->rows, sizeof(cms->rows));
+        cms->frame = ctf;
+    }
+
+    for (d = 0; d < CLUSTER_LIMIT_REQ_CMS_DEPTH; d++) {
+        idx = njt_http_cluster_limit_req_cms_index(id, d);
+        if (cms->rows[d][idx] < 0xffff) {
+            cms->rows[d][idx]++;
+        }
+    }
+
+    sh->cms_changed = 1;
+}
+
+
+static njt_uint_t
+njt_http_cluster_limit_req_cms_estimate(njt_http_cluster_limit_req_shctx_t *sh,
+    njt_http_cluster_limit_req_node_t *lc, uint64_t id, uint64_t ctf)
+{
+    njt_uint_t                          s, i, d, min, total;
+    njt_http_limit_req_sibling_t       *v;
+    njt_http_cluster_limit_req_cms_t   *cms;
+
+    total = 0;
+
+    for (s = 1; s <= SIBLING_MAX; s++) {
+        cms = &sh->cms[s];
+        if (cms->len == 0) {
+            break;
+        }
+
+        if (cms->frame != ctf) {
+            continue;
+        }
+
+        //tips: exact value of a heavy key is already counted in siblings
+        for (i = 0; i < SIBLING_MAX; i++) {
+            v = &lc->sibling[i];
+            if (v->sibling_item.len == 0) {
+                break;
+            }
+
+            if (v->last_changed == ctf && v->sibling_item.len == cms->len
+                && njt_memcmp(v->sibling_item.data, cms->node, cms->len) == 0)
+            {
+                break;
+            }
+        }
+
+        if (i < SIBLING_MAX && v->sibling_item.len != 0) {
+            continue;
+        }
+
+        min = 0xffff;
+        for (d = 0; d < CLUSTER_LIMIT_REQ_CMS_DEPTH; d++) {
+            min = njt_min(min, cms->rows[d][njt_http_cluster_limit_req_cms_index(id, d)]);
+        }
+
+        total += min;
+    }
+
+    return total;
+}
+
+
+static void
+njt_http_cluster_limit_req_mark_dirty(njt_http_cluster_limit_req_ctx_t *ctx,
+    limit_req_sync_queue_t *client, uint64_t ctf)
+{
+    client->frame = ctf;
+
+    if (client->dirty) {
+        return;
+    }
+
+    //tips: light keys are only synced by the count-min sketch
+    if (ctx->heavy && client->q_item.sibling_item.conn < ctx->heavy) {
+        return;
+    }
+
+    client->dirty = 1;
+    client->dirty_next = ctx->sh->dirty;
+    ctx->sh->dirty = client;
+}
+
+
+static void
+njt_http_cluster_limit_req_init_client(limit_req_sync_queue_t *client)
+{
+    client->dirty_next = NULL;
+    client->frame = 0;
+    client->synced_frame = 0;
+    client->synced = 0;
+    client->dirty = 0;
+}
+
+
 void njt_http_udp_send_handler(njt_http_cluster_limit_req_ctx_t *ctx, njt_str_t* zone, njt_str_t* target, njt_str_t* target_pid)
 {
     njt_array_t                 out_arr;
@@ -369,6 +512,182 @@ void njt_http_udp_send_handler(njt_http_cluster_limit_req_ctx_t *ctx, njt_str_t*
 }
 
 
+/*  compact encode format
+ *  { "node": node,
+ *    "zone": zone,
+ *    "ver": 1,
+ *    "ids": [ id, delta, id, delta, ... ]
+ *  }
+ *
+ *  the count-min sketch of light keys is sent one row per packet:
+ *  { "node": node, "zone": zone, "ver": 1, "cms": [ row, bin ] }
+ * */
+static char *
+njt_http_cluster_limit_req_compact_head(njt_http_cluster_limit_req_ctx_t *ctx,
+    njt_str_t *zone, njt_str_t *target, njt_str_t *target_pid, char **end)
+{
+    char                        *buf, *tail;
+    size_t                      buf_size = 0;
+
+    buf = njt_gossip_app_get_msg_buf(GOSSIP_APP_CLUSTER_LIMIT_REQ, *target, *target_pid, &buf_size);
+    if (buf_size <= 0 || buf == NULL) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster limit req apply buffer failed");
+        return NULL;
+    }
+
+    *end = buf + buf_size;
+
+    tail = mp_encode_map(buf, 4);
+
+    tail = mp_encode_str(tail, "node", 4);
+    tail = mp_encode_bin(tail, (const char *)ctx->node_name->data, ctx->node_name->len);
+
+    tail = mp_encode_str(tail, "zone", 4);
+    tail = mp_encode_bin(tail, (const char *)zone->data, zone->len);
+
+    tail = mp_encode_str(tail, "ver", 3);
+    tail = mp_encode_uint(tail, CLUSTER_LIMIT_REQ_SYNC_VER);
+
+    return tail;
+}
+
+
+static void
+njt_http_cluster_limit_req_send_compact(njt_http_cluster_limit_req_ctx_t *ctx,
+    njt_str_t *zone, njt_str_t *target, njt_str_t *target_pid)
+{
+    njt_array_t                 out_arr;
+    njt_uint_t                  idx, d, w, cnt;
+    uint64_t                    ctf;
+    uint16_t                    *rows = NULL;
+    char                        *tail, *end, *replace_cnt;
+    limit_req_sync_queue_t      *client;
+    njt_http_cluster_limit_req_delta_t  *item;
+    njt_http_cluster_limit_req_shctx_t  *sh = ctx->sh;
+    struct timeval              tv;
+
+    ctx->pool->log = njt_cycle->log;
+    njt_reset_pool(ctx->pool);
+
+    if (njt_array_init(&out_arr, ctx->pool, 256, sizeof(njt_http_cluster_limit_req_delta_t))
+        != NJT_OK)
+    {
+        return;
+    }
+
+    njt_gettimeofday(&tv);
+    ctf = tv.tv_sec;
+
+    //tips: only walk keys changed since last tick, and at most one batch of them
+    njt_shmtx_lock(&ctx->shpool->mutex);
+
+    while (sh->dirty != NULL && out_arr.nelts < CLUSTER_LIMIT_REQ_SYNC_BATCH) {
+        client = sh->dirty;
+        sh->dirty = client->dirty_next;
+        client->dirty_next = NULL;
+        client->dirty = 0;
+
+        item = njt_array_push(&out_arr);
+        if (item == NULL) {
+            break;
+        }
+
+        njt_memcpy(&item->id, client->q_item.sibling_item.data, sizeof(uint64_t));
+
+        //tips: delta from the last value sent in the same time frame
+        if (client->frame == client->synced_frame
+            && client->q_item.sibling_item.conn >= client->synced)
+        {
+            item->delta = client->q_item.sibling_item.conn - client->synced;
+        } else {
+            item->delta = client->q_item.sibling_item.conn;
+        }
+
+        client->synced = client->q_item.sibling_item.conn;
+        client->synced_frame = client->frame;
+
+        if (item->delta == 0) {
+            out_arr.nelts--;
+        }
+    }
+
+    if (ctx->heavy && sh->cms_changed && sh->cms[0].frame == ctf) {
+        rows = njt_pnalloc(ctx->pool, sizeof(sh->cms[0].rows));
+        if (rows != NULL) {
+            njt_memcpy(rows, sh->cms[0].rows, sizeof(sh->cms[0].rows));
+            sh->cms_changed = 0;
+        }
+    }
+
+    njt_shmtx_unlock(&ctx->shpool->mutex);
+
+    item = out_arr.elts;
+    for (idx = 0; idx < out_arr.nelts; /* void */) {
+        tail = njt_http_cluster_limit_req_compact_head(ctx, zone, target, target_pid, &end);
+        if (tail == NULL) {
+            return;
+        }
+
+        tail = mp_encode_str(tail, "ids", 3);
+
+        //tips: reserve an array16 header, the count is filled when the packet is full
+        replace_cnt = tail;
+        tail += 3;
+        cnt = 0;
+
+        while (idx < out_arr.nelts && end - tail >= CLUSTER_LIMIT_REQ_PAIR_SIZE) {
+            tail = mp_encode_uint(tail, item[idx].id);
+            tail = mp_encode_uint(tail, item[idx].delta);
+            cnt += 2;
+            idx++;
+        }
+
+        mp_store_u16(mp_store_u8(replace_cnt, 0xdc), cnt);
+        njt_gossip_app_close_msg_buf(tail);
+        njt_gossip_send_app_msg_buf();
+
+        if (cnt == 0) {
+            njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                          " cluster limit req no room for ids in packet");
+            break;
+        }
+    }
+
+    if (rows == NULL) {
+        return;
+    }
+
+    for (d = 0; d < CLUSTER_LIMIT_REQ_CMS_DEPTH; d++) {
+        tail = njt_http_cluster_limit_req_compact_head(ctx, zone, target, target_pid, &end);
+        if (tail == NULL) {
+            return;
+        }
+
+        if ((size_t) (end - tail) < 16 + CLUSTER_LIMIT_REQ_CMS_WIDTH * sizeof(uint16_t)) {
+            njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                          " cluster limit req sketch row does not fit in packet");
+            tail = mp_encode_str(tail, "ids", 3);
+            tail = mp_encode_array(tail, 0);
+            njt_gossip_app_close_msg_buf(tail);
+            njt_gossip_send_app_msg_buf();
+            return;
+        }
+
+        tail = mp_encode_str(tail, "cms", 3);
+        tail = mp_encode_array(tail, 2);
+        tail = mp_encode_uint(tail, d);
+        tail = mp_encode_binl(tail, CLUSTER_LIMIT_REQ_CMS_WIDTH * sizeof(uint16_t));
+
+        for (w = 0; w < CLUSTER_LIMIT_REQ_CMS_WIDTH; w++) {
+            tail = mp_store_u16(tail, rows[d * CLUSTER_LIMIT_REQ_CMS_WIDTH + w]);
+        }
+
+        njt_gossip_app_close_msg_buf(tail);
+        njt_gossip_send_app_msg_buf();
+    }
+}
+
+
 static void njt_http_cluster_limit_req_sync(njt_event_t *ev)
 {
 	njt_http_cluster_limit_req_ctx_t		**zone_ctxes = NULL;
@@ -390,6 +709,11 @@ static void njt_http_cluster_limit_req_sync(njt_event_t *ev)
 				continue;
 			}
 		
+            if (zone_ctxes[i]->compact) {
+                njt_http_cluster_limit_req_send_compact(zone_ctxes[i], &zone_ctxes[i]->zone_name, &target, &target_pid);
+                continue;
+            }
+
             njt_http_udp_send_handler(zone_ctxes[i], &zone_ctxes[i]->zone_name, &target, &target_pid);
 		}
 	}
@@ -411,6 +735,7 @@ njt_http_cluster_limit_req_handler(njt_http_request_t *r)
     njt_http_cluster_limit_req_limit_t *limits;
     limit_req_sync_queue_t *client;
     time_t now = njt_current_msec;
+    uint64_t id = 0;
 
     if (r->main->limit_req_status)
     {
@@ -449,7 +774,18 @@ njt_http_cluster_limit_req_handler(njt_http_request_t *r)
 
         r->main->limit_req_status = NJT_HTTP_LIMIT_CLUSTER_REQ_PASSED;
 
-        hash = njt_crc32_short(key.data, key.len);
+        if (ctx->compact)
+        {
+            //tips: compact zone stores the key id instead of the key
+            id = njt_http_cluster_limit_req_key_id(&key);
+            key.data = (u_char *)&id;
+            key.len = sizeof(uint64_t);
+            hash = (uint32_t)id;
+        }
+        else
+        {
+            hash = njt_crc32_short(key.data, key.len);
+        }
 
         njt_shmtx_lock(&ctx->shpool->mutex);
 
@@ -494,6 +830,7 @@ njt_http_cluster_limit_req_handler(njt_http_request_t *r)
             client->q_item.sibling_item.len = key.len;
             client->q_item.sibling_item.conn = 1;
             client->q_item.last_changed = now;
+            njt_http_cluster_limit_req_init_client(client);
 
             client->prev = NULL;
             client->next = NULL;
@@ -519,6 +856,16 @@ njt_http_cluster_limit_req_handler(njt_http_request_t *r)
             njt_memcpy(lc->data, key.data, key.len);
 
             njt_rbtree_insert(&ctx->sh->rbtree, node);
+
+            if (ctx->compact)
+            {
+                njt_http_cluster_limit_req_mark_dirty(ctx, client, ctf);
+            }
+
+            if (ctx->heavy)
+            {
+                njt_http_cluster_limit_req_cms_add(ctx->sh, id, ctf);
+            }
         }
         else
         {
@@ -567,6 +914,12 @@ njt_http_cluster_limit_req_handler(njt_http_request_t *r)
                 cluster_req = 0;
             }
 
+            if (ctx->heavy)
+            {
+                //tips: light keys of siblings are only known by their sketch
+                cluster_req += njt_http_cluster_limit_req_cms_estimate(ctx->sh, lc, id, ctf);
+            }
+
             if (cluster_req + lc->overflow >= limits[i].conn)
             {
 
@@ -585,6 +938,7 @@ njt_http_cluster_limit_req_handler(njt_http_request_t *r)
                 }
 
                 r->main->limit_req_status = NJT_HTTP_LIMIT_CLUSTER_REQ_REJECTED;
+                r->main->limit_rejected = 1;
 
                 return lccf->status_code;
             }
@@ -598,6 +952,7 @@ njt_http_cluster_limit_req_handler(njt_http_request_t *r)
                 client->q_item.sibling_item.len = key.len;
                 client->q_item.sibling_item.conn = lc->conn;
                 client->q_item.last_changed = now;
+                njt_http_cluster_limit_req_init_client(client);
 
                 client->prev = NULL;
                 if (ctx->sh->clients == NULL)
@@ -619,6 +974,16 @@ njt_http_cluster_limit_req_handler(njt_http_request_t *r)
                 lc->snap->q_item.sibling_item.conn = lc->conn;
                 lc->snap->q_item.last_changed = now;
             }
+
+            if (ctx->compact)
+            {
+                njt_http_cluster_limit_req_mark_dirty(ctx, lc->snap, ctf);
+            }
+
+            if (ctx->heavy)
+            {
+                njt_http_cluster_limit_req_cms_add(ctx->sh, id, ctf);
+            }
         }
 
         njt_shmtx_unlock(&ctx->shpool->mutex);
@@ -723,7 +1088,9 @@ njt_http_cluster_limit_req_cleanup(njt_http_cluster_limit_req_ctx_t *ctx)
     while (client != NULL)
     {
         //try to remove node 2 time frames ago
-        if ((njt_current_msec - client->q_item.last_changed) / 1000 > 2)
+        //tips: dirty one is still linked in the compact sync list
+        if ((njt_current_msec - client->q_item.last_changed) / 1000 > 2
+            && !client->dirty)
         {
             limit_req_sync_queue_t *to_be_removed = client;
             client = client->next;
@@ -753,6 +1120,33 @@ njt_http_cluster_limit_req_cleanup(njt_http_cluster_limit_req_ctx_t *ctx)
     }
 }
 
+static njt_int_t
+njt_http_cluster_limit_req_init_cms(njt_http_cluster_limit_req_ctx_t *ctx,
+    njt_shm_zone_t *shm_zone)
+{
+    size_t                              size;
+
+    if (ctx->heavy == 0 || ctx->sh->cms != NULL)
+    {
+        return NJT_OK;
+    }
+
+    size = sizeof(njt_http_cluster_limit_req_cms_t) * (SIBLING_MAX + 1);
+
+    ctx->sh->cms = njt_slab_calloc(ctx->shpool, size);
+    if (ctx->sh->cms == NULL)
+    {
+        njt_log_error(NJT_LOG_EMERG, shm_zone->shm.log, 0,
+                      "cluster_limit_req_zone \"%V\" is too small for "
+                      "\"heavy\", at least %uz bytes more are needed",
+                      &shm_zone->shm.name, size);
+        return NJT_ERROR;
+    }
+
+    return NJT_OK;
+}
+
+
 static njt_int_t
 njt_http_cluster_limit_req_init_zone(njt_shm_zone_t *shm_zone, void *data)
 {
@@ -776,10 +1170,19 @@ njt_http_cluster_limit_req_init_zone(njt_shm_zone_t *shm_zone, void *data)
             return NJT_ERROR;
         }
 
+        if (ctx->compact != octx->compact)
+        {
+            njt_log_error(NJT_LOG_EMERG, shm_zone->shm.log, 0,
+                          "cluster_limit_req_zone \"%V\" cannot change "
+                          "the \"sync\" mode on reload",
+                          &shm_zone->shm.name);
+            return NJT_ERROR;
+        }
+
         ctx->sh = octx->sh;
         ctx->shpool = octx->shpool;
 
-        return NJT_OK;
+        return njt_http_cluster_limit_req_init_cms(ctx, shm_zone);
     }
 
     ctx->shpool = (njt_slab_pool_t *)shm_zone->shm.addr;
@@ -788,7 +1191,7 @@ njt_http_cluster_limit_req_init_zone(njt_shm_zone_t *shm_zone, void *data)
     {
         ctx->sh = ctx->shpool->data;
 
-        return NJT_OK;
+        return njt_http_cluster_limit_req_init_cms(ctx, shm_zone);
     }
 
     ctx->sh = njt_slab_alloc(ctx->shpool, sizeof(njt_http_cluster_limit_req_shctx_t));
@@ -798,6 +1201,10 @@ njt_http_cluster_limit_req_init_zone(njt_shm_zone_t *shm_zone, void *data)
     }
 
     ctx->shpool->data = ctx->sh;
+    ctx->sh->clients = NULL;
+    ctx->sh->dirty = NULL;
+    ctx->sh->cms = NULL;
+    ctx->sh->cms_changed = 0;
 
     njt_rbtree_init(&ctx->sh->rbtree, &ctx->sh->sentinel,
                     njt_http_cluster_limit_req_rbtree_insert_value);
@@ -813,7 +1220,7 @@ njt_http_cluster_limit_req_init_zone(njt_shm_zone_t *shm_zone, void *data)
     njt_sprintf(ctx->shpool->log_ctx, " in cluster_limit_req_zone \"%V\"%Z",
                 &shm_zone->shm.name);
 
-    return NJT_OK;
+    return njt_http_cluster_limit_req_init_cms(ctx, shm_zone);
 }
 
 static njt_int_t
@@ -886,6 +1293,7 @@ njt_http_cluster_limit_req(njt_conf_t *cf, njt_command_t *cmd, void *conf)
 {
     njt_http_cluster_limit_req_limit_t *limit, *limits;
     njt_int_t                           n = 0;
+    njt_int_t                           heavy = NJT_CONF_UNSET;
     u_char                              *p;
     ssize_t                             size;
     njt_str_t                           *value, shm_name, s;
@@ -984,7 +1392,42 @@ njt_http_cluster_limit_req(njt_conf_t *cf, njt_command_t *cmd, void *conf)
             }
 
             continue;
+        }else if (njt_strcmp(value[i].data, "sync=compact") == 0)
+        {
+            ctx->compact = 1;
+            continue;
+        }else if (njt_strcmp(value[i].data, "sync=full") == 0)
+        {
+            ctx->compact = 0;
+            continue;
+        }else if (njt_strncmp(value[i].data, "heavy=", 6) == 0)
+        {
+            heavy = njt_atoi(value[i].data + 6, value[i].len - 6);
+            if (heavy <= 0 || heavy > 65535)
+            {
+                njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                                "invalid heavy threshold \"%V\"", &value[i]);
+                return NJT_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NJT_CONF_ERROR;
+    }
+
+    if (heavy != NJT_CONF_UNSET)
+    {
+        if (!ctx->compact)
+        {
+            njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                               "\"heavy\" requires \"sync=compact\"");
+            return NJT_CONF_ERROR;
         }
+
+        ctx->heavy = heavy;
     }
 
     if (shm_name.len == 0)
@@ -1151,26 +1594,14 @@ njt_limit_req_sync_lookup(njt_rbtree_t *rbtree, njt_str_t *key, uint32_t hash)
 }
 
 
-static void njt_cluster_limit_req_update_req(njt_str_t key_in, int other_req, njt_http_cluster_limit_req_ctx_t *ctx, njt_str_t sibling_node)
+static void njt_cluster_limit_req_update_req_locked(njt_str_t key_in, uint32_t hash, njt_uint_t other_req,
+    njt_flag_t delta, njt_http_cluster_limit_req_ctx_t *ctx, njt_str_t sibling_node, uint64_t ctf)
 {
     size_t n, i;
     njt_rbtree_node_t *node;
     njt_http_cluster_limit_req_node_t *lc;
     njt_http_limit_req_sibling_t *v;
-    
-    njt_uint_t hash;
 
-    // if (ctx->shpool == NULL)
-    // {
-    //     //important: dont need init ,http_limit_reqection has init it
-    //     ctx->shpool = (njt_slab_pool_t *)ctx->shm_zone->shm.addr;
-    //     ctx->sh = ctx->shpool->data;
-    // }
-    hash = njt_crc32_short(key_in.data, key_in.len);
-    njt_shmtx_lock(&ctx->shpool->mutex);
-    struct timeval tv;
-    njt_gettimeofday(&tv);
-    uint64_t ctf = tv.tv_sec;
     node = njt_limit_req_sync_lookup(&ctx->sh->rbtree, &key_in, hash);
     if (node == NULL)
     {
@@ -1179,7 +1610,6 @@ static void njt_cluster_limit_req_update_req(njt_str_t key_in, int other_req, nj
         if (node == NULL)
         {
             //todo:
-            njt_shmtx_unlock(&ctx->shpool->mutex);
             return;
         }
         lc = (njt_http_cluster_limit_req_node_t *)&node->color;
@@ -1190,7 +1620,7 @@ static void njt_cluster_limit_req_update_req(njt_str_t key_in, int other_req, nj
         }
 
         v = &lc->sibling[0];
-        v->sibling_item.conn = other_req;
+        v->sibling_item.conn = njt_min(other_req, 0xffff);
         v->sibling_item.len = sibling_node.len;
         v->last_changed = ctf;
         njt_memcpy(v->sibling_item.data, sibling_node.data, sibling_node.len);
@@ -1199,10 +1629,11 @@ static void njt_cluster_limit_req_update_req(njt_str_t key_in, int other_req, nj
         node->key = hash;
         lc->len = (u_char)key_in.len;
         lc->conn = 0;
+        lc->overflow = 0;
+        lc->timeframe = ctf;
 
         njt_memcpy(lc->data, key_in.data, key_in.len);
         njt_rbtree_insert(&ctx->sh->rbtree, node);
-        njt_shmtx_unlock(&ctx->shpool->mutex);
     }
     else
     {
@@ -1212,25 +1643,32 @@ static void njt_cluster_limit_req_update_req(njt_str_t key_in, int other_req, nj
             v = &lc->sibling[i];
             if (v->sibling_item.len == 0)
             {
-                v->sibling_item.conn = other_req;
+                v->sibling_item.conn = njt_min(other_req, 0xffff);
                 v->sibling_item.len = sibling_node.len;
                 v->last_changed = ctf;
                 memcpy(v->sibling_item.data, sibling_node.data, sibling_node.len);
-                njt_shmtx_unlock(&ctx->shpool->mutex);
                 return;
             }
             else
             {
                 if (sibling_node.len == v->sibling_item.len && njt_memcmp(v->sibling_item.data, sibling_node.data, sibling_node.len) == 0)
                 {
-
                     //found ,so update;
-                    if (other_req > v->sibling_item.conn)
+                    if (delta)
+                    {
+                        //tips: compact sync sends increments within a time frame
+                        if (v->last_changed == ctf)
+                        {
+                            other_req += v->sibling_item.conn;
+                        }
+                        v->sibling_item.conn = njt_min(other_req, 0xffff);
+                        v->last_changed = ctf;
+                    }
+                    else if (other_req > v->sibling_item.conn)
                     {
                         v->sibling_item.conn = other_req;
                         v->last_changed = ctf;
                     }
-                    njt_shmtx_unlock(&ctx->shpool->mutex);
                     return;
                 }
             }
@@ -1243,6 +1681,155 @@ static void njt_cluster_limit_req_update_req(njt_str_t key_in, int other_req, nj
 }
 
 
+static void njt_cluster_limit_req_update_req(njt_str_t key_in, int other_req, njt_http_cluster_limit_req_ctx_t *ctx, njt_str_t sibling_node)
+{
+    uint32_t hash;
+    struct timeval tv;
+
+    hash = njt_crc32_short(key_in.data, key_in.len);
+    njt_gettimeofday(&tv);
+
+    njt_shmtx_lock(&ctx->shpool->mutex);
+    njt_cluster_limit_req_update_req_locked(key_in, hash, other_req, 0, ctx, sibling_node, tv.tv_sec);
+    njt_shmtx_unlock(&ctx->shpool->mutex);
+}
+
+
+static void njt_cluster_limit_req_update_cms_locked(njt_http_cluster_limit_req_ctx_t *ctx,
+    njt_str_t sibling_node, njt_uint_t row, const char *data, uint64_t ctf)
+{
+    njt_uint_t                          s, w;
+    njt_http_cluster_limit_req_cms_t   *cms;
+
+    if (sibling_node.len > sizeof(ctx->sh->cms[0].node))
+    {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+            "cluster limit req sketch node name too long, receive:%V", &sibling_node);
+        return;
+    }
+
+    for (s = 1; s <= SIBLING_MAX; s++)
+    {
+        cms = &ctx->sh->cms[s];
+        if (cms->len == 0)
+        {
+            njt_memcpy(cms->node, sibling_node.data, sibling_node.len);
+            cms->len = sibling_node.len;
+            cms->frame = 0;
+            break;
+        }
+
+        if (cms->len == sibling_node.len && njt_memcmp(cms->node, sibling_node.data, sibling_node.len) == 0)
+        {
+            break;
+        }
+    }
+
+    if (s > SIBLING_MAX)
+    {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+            "cluster limit req sketch overflow in array, receive:%V", &sibling_node);
+        return;
+    }
+
+    //tips: rows of a previous time frame must not be mixed with the new ones
+    if (cms->frame != ctf)
+    {
+        njt_memzero(cms->rows, sizeof(cms->rows));
+        cms->frame = ctf;
+    }
+
+    for (w = 0; w < CLUSTER_LIMIT_REQ_CMS_WIDTH; w++)
+    {
+        cms->rows[row][w] = mp_load_u16(&data);
+    }
+}
+
+
+static int njt_cluster_limit_req_recv_compact(const char *r, njt_http_cluster_limit_req_ctx_t *ctx,
+    njt_str_t sibling_node)
+{
+    uint32_t                        len, arr_cnt, i;
+    uint64_t                        id, ctf;
+    njt_uint_t                      row, delta;
+    njt_str_t                       key, key_in;
+    const char                      *data;
+    struct timeval                  tv;
+
+    key.data = (u_char *)mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 3 || njt_memcmp(key.data, "ver", key.len) != 0
+        || mp_decode_uint(&r) != CLUSTER_LIMIT_REQ_SYNC_VER)
+    {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster limit req unknown compact version");
+        return NJT_ERROR;
+    }
+
+    if (!ctx->compact)
+    {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+            " cluster limit req compact data for zone:%V without sync=compact", &ctx->zone_name);
+        return NJT_ERROR;
+    }
+
+    key.data = (u_char *)mp_decode_str(&r, &len);
+    key.len = len;
+
+    njt_gettimeofday(&tv);
+    ctf = tv.tv_sec;
+
+    if (key.len == 3 && njt_memcmp(key.data, "cms", key.len) == 0)
+    {
+        if (mp_decode_array(&r) != 2)
+        {
+            return NJT_ERROR;
+        }
+
+        row = mp_decode_uint(&r);
+        data = mp_decode_bin(&r, &len);
+
+        //tips: ignore sketch from a node with another sketch size
+        if (ctx->heavy == 0 || row >= CLUSTER_LIMIT_REQ_CMS_DEPTH
+            || len != CLUSTER_LIMIT_REQ_CMS_WIDTH * sizeof(uint16_t))
+        {
+            return NJT_OK;
+        }
+
+        njt_shmtx_lock(&ctx->shpool->mutex);
+        njt_cluster_limit_req_update_cms_locked(ctx, sibling_node, row, data, ctf);
+        njt_shmtx_unlock(&ctx->shpool->mutex);
+
+        return NJT_OK;
+    }
+
+    if (key.len != 3 || njt_memcmp(key.data, "ids", key.len) != 0)
+    {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster limit req not ids:%V", &key);
+        return NJT_ERROR;
+    }
+
+    arr_cnt = mp_decode_array(&r);
+
+    key_in.data = (u_char *)&id;
+    key_in.len = sizeof(uint64_t);
+
+    //tips: one lock for the whole packet
+    njt_shmtx_lock(&ctx->shpool->mutex);
+
+    for (i = 0; i + 1 < arr_cnt; i += 2)
+    {
+        id = mp_decode_uint(&r);
+        delta = mp_decode_uint(&r);
+
+        njt_cluster_limit_req_update_req_locked(key_in, (uint32_t)id, delta, 1, ctx, sibling_node, ctf);
+    }
+
+    njt_shmtx_unlock(&ctx->shpool->mutex);
+
+    return NJT_OK;
+}
+
+
 static int njt_cluster_limit_req_recv_data(const char* msg, void* data)
 {
     njt_http_cluster_limit_req_ctx_t               *ctx;
@@ -1252,7 +1839,7 @@ static int njt_cluster_limit_req_recv_data(const char* msg, void* data)
     njt_str_t                       sibling_node;
 
     uint32_t size = mp_decode_map(&r);
-    if (size != 3)
+    if (size != 3 && size != 4)
     {
         //todo
         njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster limit req udp decode failed, maybe not for us", size);
@@ -1295,6 +1882,11 @@ static int njt_cluster_limit_req_recv_data(const char* msg, void* data)
         return NJT_ERROR;
     }
 
+    if (size == 4)
+    {
+        return njt_cluster_limit_req_recv_compact(r, ctx, sibling_node);
+    }
+
     arr_cnt = mp_decode_array(&r);
     for (size = 0; size < arr_cnt; size++)
     {
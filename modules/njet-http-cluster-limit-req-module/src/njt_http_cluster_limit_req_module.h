@@ -16,6 +16,10 @@
 #define SIBLING_MAX 10
 #define NODE_VALID_TIMEOUT 1000
 
+/* count-min sketch used by compact sync to aggregate light keys */
+#define CLUSTER_LIMIT_REQ_CMS_DEPTH 4
+#define CLUSTER_LIMIT_REQ_CMS_WIDTH 512
+
 typedef struct
 {
     u_short                 conn;
@@ -36,6 +40,12 @@ typedef struct sync_queue_s
     struct sync_queue_s             *next;
     struct sync_queue_s             *prev;
     njt_rbtree_node_t               *node;
+    //compact sync: pending list and last value sent
+    struct sync_queue_s             *dirty_next;
+    uint64_t                        frame;
+    uint64_t                        synced_frame;
+    u_short                         synced;
+    u_char                          dirty;
 } limit_req_sync_queue_t;
 
 typedef struct
@@ -57,11 +67,23 @@ typedef struct
     njt_str_t                       key;
 } njt_http_cluster_limit_req_cleanup_t;
 
+typedef struct
+{
+    uint64_t                        frame;
+    size_t                          len;
+    u_char                          node[256];
+    uint16_t                        rows[CLUSTER_LIMIT_REQ_CMS_DEPTH][CLUSTER_LIMIT_REQ_CMS_WIDTH];
+} njt_http_cluster_limit_req_cms_t;
+
 typedef struct
 {
     njt_rbtree_t                    rbtree;
     njt_rbtree_node_t               sentinel;
     limit_req_sync_queue_t          *clients;
+    limit_req_sync_queue_t          *dirty;
+    //cms[0] is local, the others are received from siblings
+    njt_http_cluster_limit_req_cms_t    *cms;
+    njt_uint_t                      cms_changed;
 } njt_http_cluster_limit_req_shctx_t;
 
 typedef struct
@@ -76,6 +98,8 @@ typedef struct
     njt_str_t                           *node_name;
     njt_pool_t                          *pool;
     //end
+    njt_flag_t                          compact;
+    njt_uint_t                          heavy;
 
 } njt_http_cluster_limit_req_ctx_t;
 
@@ -0,0 +1,1771 @@
+
+/*
+ * Copyright (C) 2021-2023 TMLake(Beijing) Technology Co., Ltd.
+ */
+
+#include <njt_config.h>
+#include <njt_core.h>
+#include <njt_http.h>
+#include <msgpuck.h>
+#include <njt_mqconf_module.h>
+#include "njt_gossip.h"
+#include "njt_http_cluster_quota_module.h"
+
+
+#define SYNC_INT 100
+
+#define GOSSIP_APP_CLUSTER_QUOTA        0x3A9C51E7
+
+#define CLUSTER_QUOTA_SYNC_VER          1
+//worst case size of one encoded (id, requests, bytes) triple
+#define CLUSTER_QUOTA_TRIPLE_SIZE       (9 + 9 + 9)
+//slots probed from the home slot of a bucket
+#define CLUSTER_QUOTA_MAX_PROBE         16
+//an idle and refilled bucket may be reused after this time
+#define CLUSTER_QUOTA_STALE             (10 * 1000000000ULL)
+
+typedef struct {
+    uint64_t                            id;
+    uint64_t                            requests;
+    uint64_t                            bytes;
+} njt_http_cluster_quota_delta_t;
+
+typedef struct {
+    njt_http_cluster_quota_slot_t      *slot;
+    njt_http_cluster_quota_rule_t      *rule;
+} njt_http_cluster_quota_hit_t;
+
+typedef struct {
+    njt_uint_t                          n;
+    njt_http_cluster_quota_hit_t        hits[NJT_HTTP_CLUSTER_QUOTA_LEVELS];
+    uint64_t                            bytes_interval[NJT_HTTP_CLUSTER_QUOTA_LEVELS];
+    uint64_t                            bytes_period[NJT_HTTP_CLUSTER_QUOTA_LEVELS];
+} njt_http_cluster_quota_req_ctx_t;
+
+
+extern njt_module_t  njt_mqconf_module;
+
+static njt_str_t njt_http_cluster_quota_levels[] = {
+    njt_string("tenant"),
+    njt_string("key"),
+    njt_string("endpoint")
+};
+
+
+static void *njt_http_cluster_quota_create_main_conf(njt_conf_t *cf);
+static void *njt_http_cluster_quota_create_conf(njt_conf_t *cf);
+static char *njt_http_cluster_quota_merge_conf(njt_conf_t *cf, void *parent,
+    void *child);
+static char *njt_http_cluster_quota_zone(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf);
+static char *njt_http_cluster_quota_rule(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf);
+static char *njt_http_cluster_quota(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf);
+static char *njt_http_cluster_quota_usage(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf);
+static njt_int_t njt_http_cluster_quota_init(njt_conf_t *cf);
+static njt_int_t njt_http_cluster_quota_init_process(njt_cycle_t *cycle);
+
+static njt_http_cluster_quota_rules_t *njt_http_cluster_quota_rules_create(
+    njt_log_t *log);
+static char *njt_http_cluster_quota_rules_add(
+    njt_http_cluster_quota_rules_t *rules,
+    njt_http_cluster_quota_rule_spec_t *spec);
+static njt_int_t njt_http_cluster_quota_update(njt_http_cluster_quota_ctx_t *ctx,
+    njt_http_cluster_quota_rule_spec_t *specs, njt_uint_t n, njt_str_t *err);
+static void njt_http_cluster_quota_sync(njt_event_t *ev);
+static int njt_http_cluster_quota_recv_data(const char *msg, void *data);
+
+
+static njt_conf_num_bounds_t  njt_http_cluster_quota_status_bounds = {
+    njt_conf_check_num_bounds, 400, 599
+};
+
+
+static njt_command_t  njt_http_cluster_quota_commands[] = {
+
+    { njt_string("cluster_quota_zone"),
+      NJT_HTTP_MAIN_CONF|NJT_CONF_TAKE12,
+      njt_http_cluster_quota_zone,
+      NJT_HTTP_MAIN_CONF_OFFSET,
+      0,
+      NULL },
+
+    { njt_string("cluster_quota_rule"),
+      NJT_HTTP_MAIN_CONF|NJT_CONF_2MORE,
+      njt_http_cluster_quota_rule,
+      NJT_HTTP_MAIN_CONF_OFFSET,
+      0,
+      NULL },
+
+    { njt_string("cluster_quota"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_1MORE,
+      njt_http_cluster_quota,
+      NJT_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { njt_string("cluster_quota_status"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_TAKE1,
+      njt_conf_set_num_slot,
+      NJT_HTTP_LOC_CONF_OFFSET,
+      offsetof(njt_http_cluster_quota_conf_t, status_code),
+      &njt_http_cluster_quota_status_bounds },
+
+    { njt_string("cluster_quota_usage"),
+      NJT_HTTP_LOC_CONF|NJT_CONF_NOARGS,
+      njt_http_cluster_quota_usage,
+      0,
+      0,
+      NULL },
+
+      njt_null_command
+};
+
+
+static njt_http_module_t  njt_http_cluster_quota_module_ctx = {
+    NULL,                                    /* preconfiguration */
+    njt_http_cluster_quota_init,             /* postconfiguration */
+
+    njt_http_cluster_quota_create_main_conf, /* create main configuration */
+    NULL,                                    /* init main configuration */
+
+    NULL,                                    /* create server configuration */
+    NULL,                                    /* merge server configuration */
+
+    njt_http_cluster_quota_create_conf,      /* create location configuration */
+    njt_http_cluster_quota_merge_conf        /* merge location configuration */
+};
+
+
+njt_module_t  njt_http_cluster_quota_module = {
+    NJT_MODULE_V1,
+    &njt_http_cluster_quota_module_ctx,      /* module context */
+    njt_http_cluster_quota_commands,         /* module directives */
+    NJT_HTTP_MODULE,                         /* module type */
+    NULL,                                    /* init master */
+    NULL,                                    /* init module */
+    njt_http_cluster_quota_init_process,     /* init process */
+    NULL,                                    /* init thread */
+    NULL,                                    /* exit thread */
+    NULL,                                    /* exit process */
+    NULL,                                    /* exit master */
+    NJT_MODULE_V1_PADDING
+};
+
+
+static njt_inline uint64_t
+njt_http_cluster_quota_now(void)
+{
+    struct timespec  ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static njt_inline uint64_t
+njt_http_cluster_quota_id(u_char *path, size_t len)
+{
+    uint64_t  id;
+
+    //tips: buckets are identified on the wire by a 64 bits hash of the path
+    id = ((uint64_t) njt_murmur_hash2(path, len) << 32)
+         | njt_crc32_short(path, len);
+
+    return id ? id : 1;
+}
+
+
+static njt_inline uint64_t
+njt_http_cluster_quota_cost(uint64_t n, uint64_t interval)
+{
+    return (uint64_t) ((double) n * interval / 1000);
+}
+
+
+/*
+ * GCRA: the bucket is empty when the theoretical arrival time is a whole
+ * period ahead of now, so the burst is the full quota of the period
+ */
+static njt_int_t
+njt_http_cluster_quota_take(njt_atomic_t *tat, uint64_t cost, uint64_t period,
+    uint64_t now)
+{
+    njt_atomic_uint_t  old, set;
+
+    for ( ;; ) {
+        old = *tat;
+        set = (old > now ? old : now) + cost;
+
+        if (set > now + period) {
+            return NJT_BUSY;
+        }
+
+        if (njt_atomic_cmp_set(tat, old, set)) {
+            return NJT_OK;
+        }
+    }
+}
+
+
+static void
+njt_http_cluster_quota_charge(njt_atomic_t *tat, uint64_t cost, uint64_t period,
+    uint64_t now)
+{
+    njt_atomic_uint_t  old, set;
+
+    do {
+        old = *tat;
+        set = (old > now ? old : now) + cost;
+
+        //tips: post-paid and remote usage may overdraw by one more period at most
+        if (set > now + 2 * period) {
+            set = now + 2 * period;
+        }
+
+        if (set <= old) {
+            return;
+        }
+
+    } while (!njt_atomic_cmp_set(tat, old, set));
+}
+
+
+static njt_inline njt_uint_t
+njt_http_cluster_quota_stale(njt_http_cluster_quota_slot_t *slot, uint64_t now)
+{
+    return slot->req_tat <= now && slot->bytes_tat <= now
+           && slot->req_pending == 0 && slot->bytes_pending == 0
+           && slot->req_backlog == 0 && slot->bytes_backlog == 0
+           && slot->last + CLUSTER_QUOTA_STALE < now;
+}
+
+
+static njt_http_cluster_quota_slot_t *
+njt_http_cluster_quota_probe(njt_http_cluster_quota_shctx_t *sh, uint64_t id,
+    uint64_t now, njt_http_cluster_quota_slot_t **stale)
+{
+    njt_uint_t                      i, n;
+    njt_http_cluster_quota_slot_t  *slot;
+
+    for (n = 0, i = id & sh->mask;
+         n < CLUSTER_QUOTA_MAX_PROBE;
+         n++, i = (i + 1) & sh->mask)
+    {
+        slot = &sh->slots[i];
+
+        if (slot->id == id) {
+            return slot;
+        }
+
+        if (slot->id == 0) {
+            if (stale == NULL) {
+                return NULL;
+            }
+
+            //tips: another id may take the free slot without the lock
+            if (njt_atomic_cmp_set(&slot->id, 0, id)) {
+                slot->last = now;
+                (void) njt_atomic_fetch_add(&sh->used, 1);
+                return slot;
+            }
+
+            if (slot->id == id) {
+                return slot;
+            }
+
+            continue;
+        }
+
+        if (stale && *stale == NULL
+            && njt_http_cluster_quota_stale(slot, now))
+        {
+            *stale = slot;
+        }
+    }
+
+    return NULL;
+}
+
+
+static njt_http_cluster_quota_slot_t *
+njt_http_cluster_quota_slot(njt_http_cluster_quota_ctx_t *ctx, uint64_t id,
+    uint64_t now)
+{
+    njt_atomic_t                   *lock;
+    njt_atomic_uint_t               old;
+    njt_http_cluster_quota_slot_t  *slot, *stale;
+    njt_http_cluster_quota_shctx_t *sh;
+
+    sh = ctx->sh;
+
+    slot = njt_http_cluster_quota_probe(sh, id, now, NULL);
+    if (slot) {
+        return slot;
+    }
+
+    /*
+     * a miss is probed again under the lock of the id, so two workers
+     * never add the same bucket; the hits above take no lock
+     */
+    lock = &sh->lock[id % NJT_HTTP_CLUSTER_QUOTA_LOCKS];
+
+    njt_spinlock(lock, 1, 2048);
+
+    stale = NULL;
+
+    slot = njt_http_cluster_quota_probe(sh, id, now, &stale);
+    if (slot || stale == NULL) {
+        goto done;
+    }
+
+    /*
+     * slots are never emptied, so a bucket can only be found in its probe
+     * sequence before the first free slot; an idle one is taken over instead
+     */
+    old = stale->id;
+
+    if (!njt_http_cluster_quota_stale(stale, now)
+        || !njt_atomic_cmp_set(&stale->id, old, id))
+    {
+        goto done;
+    }
+
+    stale->req_tat = 0;
+    stale->bytes_tat = 0;
+    stale->req_interval = 0;
+    stale->bytes_interval = 0;
+    stale->req_period = 0;
+    stale->bytes_period = 0;
+    stale->last = now;
+
+    slot = stale;
+
+done:
+
+    njt_unlock(lock);
+
+    if (slot == NULL) {
+        (void) njt_atomic_fetch_add(&sh->overflow, 1);
+    }
+
+    return slot;
+}
+
+
+static void
+njt_http_cluster_quota_publish(njt_http_cluster_quota_slot_t *slot,
+    njt_http_cluster_quota_rule_t *rule, uint64_t now)
+{
+    njt_atomic_uint_t  backlog;
+
+    //tips: the intervals let a worker charge sibling usage without the rules
+    if (slot->req_interval != rule->req_interval) {
+        slot->req_interval = rule->req_interval;
+        slot->req_period = rule->req_period;
+    }
+
+    if (slot->bytes_interval != rule->bytes_interval) {
+        slot->bytes_interval = rule->bytes_interval;
+        slot->bytes_period = rule->bytes_period;
+    }
+
+    slot->last = now;
+
+    backlog = slot->req_backlog;
+    if (backlog && rule->req_interval) {
+        (void) njt_atomic_fetch_add(&slot->req_backlog, -(njt_atomic_int_t) backlog);
+        njt_http_cluster_quota_charge(&slot->req_tat,
+            njt_http_cluster_quota_cost(backlog, rule->req_interval),
+            rule->req_period, now);
+    }
+
+    backlog = slot->bytes_backlog;
+    if (backlog && rule->bytes_interval) {
+        (void) njt_atomic_fetch_add(&slot->bytes_backlog, -(njt_atomic_int_t) backlog);
+        njt_http_cluster_quota_charge(&slot->bytes_tat,
+            njt_http_cluster_quota_cost(backlog, rule->bytes_interval),
+            rule->bytes_period, now);
+    }
+}
+
+
+static njt_http_cluster_quota_rule_t *
+njt_http_cluster_quota_find_rule(njt_http_cluster_quota_rules_t *rules,
+    njt_uint_t level, njt_str_t *value)
+{
+    njt_str_node_t  *sn;
+
+    sn = njt_str_rbtree_lookup(&rules->tree[level], value,
+                               njt_crc32_long(value->data, value->len));
+    if (sn != NULL) {
+        return (njt_http_cluster_quota_rule_t *) sn;
+    }
+
+    return rules->any[level];
+}
+
+
+static njt_int_t
+njt_http_cluster_quota_handler(njt_http_request_t *r)
+{
+    u_char                            *path, *p;
+    size_t                             len[NJT_HTTP_CLUSTER_QUOTA_LEVELS];
+    uint64_t                           now;
+    njt_str_t                          value[NJT_HTTP_CLUSTER_QUOTA_LEVELS];
+    njt_uint_t                         i, l;
+    njt_http_cluster_quota_ctx_t      *ctx;
+    njt_http_cluster_quota_hit_t      *hit;
+    njt_http_cluster_quota_conf_t     *qcf;
+    njt_http_cluster_quota_rule_t     *rule;
+    njt_http_cluster_quota_rules_t    *rules;
+    njt_http_cluster_quota_req_ctx_t  *rctx;
+
+    if (r->main != r) {
+        return NJT_DECLINED;
+    }
+
+    qcf = njt_http_get_module_loc_conf(r, njt_http_cluster_quota_module);
+    ctx = qcf->ctx;
+
+    if (ctx == NULL || ctx->sh == NULL
+        || njt_http_get_module_ctx(r, njt_http_cluster_quota_module) != NULL)
+    {
+        return NJT_DECLINED;
+    }
+
+    rules = ctx->rules;
+    if (rules->rules.nelts == 0) {
+        return NJT_DECLINED;
+    }
+
+    if (njt_http_complex_value(r, qcf->tenant, &value[0]) != NJT_OK) {
+        return NJT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    if (value[0].len == 0) {
+        return NJT_DECLINED;
+    }
+
+    njt_str_null(&value[1]);
+    njt_str_null(&value[2]);
+
+    if (qcf->key
+        && njt_http_complex_value(r, qcf->key, &value[1]) != NJT_OK)
+    {
+        return NJT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    if (qcf->endpoint
+        && njt_http_complex_value(r, qcf->endpoint, &value[2]) != NJT_OK)
+    {
+        return NJT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    //tips: the path of a level is its value prefixed by the parent levels
+    path = njt_pnalloc(r->pool, value[0].len + value[1].len + value[2].len + 2);
+    if (path == NULL) {
+        return NJT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    p = njt_cpymem(path, value[0].data, value[0].len);
+    len[0] = p - path;
+    *p++ = '\0';
+    p = njt_cpymem(p, value[1].data, value[1].len);
+    len[1] = p - path;
+    *p++ = '\0';
+    p = njt_cpymem(p, value[2].data, value[2].len);
+    len[2] = p - path;
+
+    rctx = njt_pcalloc(r->pool, sizeof(njt_http_cluster_quota_req_ctx_t));
+    if (rctx == NULL) {
+        return NJT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    now = njt_http_cluster_quota_now();
+
+    for (l = 0; l < NJT_HTTP_CLUSTER_QUOTA_LEVELS; l++) {
+        if (value[l].len == 0) {
+            continue;
+        }
+
+        rule = njt_http_cluster_quota_find_rule(rules, l, &value[l]);
+        if (rule == NULL) {
+            continue;
+        }
+
+        hit = &rctx->hits[rctx->n];
+
+        hit->slot = njt_http_cluster_quota_slot(ctx,
+                        njt_http_cluster_quota_id(path, len[l]), now);
+        if (hit->slot == NULL) {
+            njt_log_error(NJT_LOG_WARN, r->connection->log, 0,
+                          "cluster quota zone \"%V\" is full, "
+                          "%V \"%V\" is not limited",
+                          &ctx->zone_name, &rule->scope, &value[l]);
+            continue;
+        }
+
+        hit->rule = rule;
+        njt_http_cluster_quota_publish(hit->slot, rule, now);
+
+        rctx->bytes_interval[rctx->n] = rule->bytes_interval;
+        rctx->bytes_period[rctx->n] = rule->bytes_period;
+        rctx->n++;
+    }
+
+    for (i = 0; i < rctx->n; i++) {
+        hit = &rctx->hits[i];
+
+        if (hit->rule->bytes_interval
+            && hit->slot->bytes_tat > now + hit->rule->bytes_period)
+        {
+            goto rejected;
+        }
+    }
+
+    for (i = 0; i < rctx->n; i++) {
+        hit = &rctx->hits[i];
+
+        if (hit->rule->req_interval == 0) {
+            continue;
+        }
+
+        if (njt_http_cluster_quota_take(&hit->slot->req_tat,
+                njt_http_cluster_quota_cost(1, hit->rule->req_interval),
+                hit->rule->req_period, now)
+            != NJT_OK)
+        {
+            //tips: give back what the upper levels already took
+            while (i-- > 0) {
+                hit = &rctx->hits[i];
+
+                if (hit->rule->req_interval) {
+                    (void) njt_atomic_fetch_add(&hit->slot->req_tat,
+                        -(njt_atomic_int_t) njt_http_cluster_quota_cost(1,
+                                                     hit->rule->req_interval));
+                }
+            }
+
+            goto rejected;
+        }
+    }
+
+    for (i = 0; i < rctx->n; i++) {
+        (void) njt_atomic_fetch_add(&rctx->hits[i].slot->req_pending, 1);
+    }
+
+    (void) njt_atomic_fetch_add(&ctx->sh->passed, 1);
+
+    njt_http_set_ctx(r, rctx, njt_http_cluster_quota_module);
+
+    return NJT_DECLINED;
+
+rejected:
+
+    (void) njt_atomic_fetch_add(&ctx->sh->rejected, 1);
+
+    njt_log_error(NJT_LOG_INFO, r->connection->log, 0,
+                  "cluster quota exceeded in zone \"%V\", %V \"%V\"",
+                  &ctx->zone_name, &hit->rule->scope, &value[hit->rule->level]);
+
+    return qcf->status_code;
+}
+
+
+static njt_int_t
+njt_http_cluster_quota_log_handler(njt_http_request_t *r)
+{
+    uint64_t                           now, bytes;
+    njt_uint_t                         i;
+    njt_http_cluster_quota_slot_t     *slot;
+    njt_http_cluster_quota_req_ctx_t  *rctx;
+
+    rctx = njt_http_get_module_ctx(r, njt_http_cluster_quota_module);
+    if (rctx == NULL || rctx->n == 0) {
+        return NJT_OK;
+    }
+
+    bytes = r->connection->sent + r->request_length;
+    if (bytes == 0) {
+        return NJT_OK;
+    }
+
+    now = njt_http_cluster_quota_now();
+
+    for (i = 0; i < rctx->n; i++) {
+        slot = rctx->hits[i].slot;
+
+        (void) njt_atomic_fetch_add(&slot->bytes_pending, bytes);
+
+        if (rctx->bytes_interval[i]) {
+            njt_http_cluster_quota_charge(&slot->bytes_tat,
+                njt_http_cluster_quota_cost(bytes, rctx->bytes_interval[i]),
+                rctx->bytes_period[i], now);
+        }
+    }
+
+    return NJT_OK;
+}
+
+
+/*
+ *  unused usage of every bucket is sent to the siblings:
+ *  { "node": node, "zone": zone, "ver": 1, "q": [ id, requests, bytes, ... ] }
+ * */
+static void
+njt_http_cluster_quota_send(njt_http_cluster_quota_ctx_t *ctx)
+{
+    char                            *buf, *tail, *end, *replace_cnt;
+    size_t                           buf_size;
+    njt_uint_t                       i, idx, cnt;
+    njt_array_t                      out;
+    njt_atomic_uint_t                req, bytes;
+    njt_http_cluster_quota_slot_t   *slot;
+    njt_http_cluster_quota_delta_t  *item;
+    njt_http_cluster_quota_shctx_t  *sh = ctx->sh;
+    njt_str_t                        target = njt_string("all");
+    njt_str_t                        target_pid = njt_string("0");
+
+    ctx->pool->log = njt_cycle->log;
+    njt_reset_pool(ctx->pool);
+
+    if (njt_array_init(&out, ctx->pool, 256,
+                       sizeof(njt_http_cluster_quota_delta_t))
+        != NJT_OK)
+    {
+        return;
+    }
+
+    for (i = 0; i <= sh->mask; i++) {
+        slot = &sh->slots[i];
+
+        if (slot->id == 0) {
+            continue;
+        }
+
+        req = slot->req_pending;
+        bytes = slot->bytes_pending;
+
+        if (req == 0 && bytes == 0) {
+            continue;
+        }
+
+        item = njt_array_push(&out);
+        if (item == NULL) {
+            break;
+        }
+
+        (void) njt_atomic_fetch_add(&slot->req_pending, -(njt_atomic_int_t) req);
+        (void) njt_atomic_fetch_add(&slot->bytes_pending, -(njt_atomic_int_t) bytes);
+
+        item->id = slot->id;
+        item->requests = req;
+        item->bytes = bytes;
+    }
+
+    item = out.elts;
+
+    for (idx = 0; idx < out.nelts; /* void */) {
+        buf_size = 0;
+        buf = njt_gossip_app_get_msg_buf(GOSSIP_APP_CLUSTER_QUOTA, target,
+                                         target_pid, &buf_size);
+        if (buf == NULL || buf_size == 0) {
+            njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                          " cluster quota apply buffer failed");
+            return;
+        }
+
+        end = buf + buf_size;
+
+        tail = mp_encode_map(buf, 4);
+
+        tail = mp_encode_str(tail, "node", 4);
+        tail = mp_encode_bin(tail, (const char *) ctx->node_name->data,
+                             ctx->node_name->len);
+
+        tail = mp_encode_str(tail, "zone", 4);
+        tail = mp_encode_bin(tail, (const char *) ctx->zone_name.data,
+                             ctx->zone_name.len);
+
+        tail = mp_encode_str(tail, "ver", 3);
+        tail = mp_encode_uint(tail, CLUSTER_QUOTA_SYNC_VER);
+
+        tail = mp_encode_str(tail, "q", 1);
+
+        //tips: reserve an array16 header, the count is filled when the packet is full
+        replace_cnt = tail;
+        tail += 3;
+        cnt = 0;
+
+        while (idx < out.nelts && end - tail >= CLUSTER_QUOTA_TRIPLE_SIZE) {
+            tail = mp_encode_uint(tail, item[idx].id);
+            tail = mp_encode_uint(tail, item[idx].requests);
+            tail = mp_encode_uint(tail, item[idx].bytes);
+            cnt += 3;
+            idx++;
+        }
+
+        mp_store_u16(mp_store_u8(replace_cnt, 0xdc), cnt);
+        njt_gossip_app_close_msg_buf(tail);
+        njt_gossip_send_app_msg_buf();
+
+        if (cnt == 0) {
+            njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                          " cluster quota no room for buckets in packet");
+            return;
+        }
+    }
+}
+
+
+static void
+njt_http_cluster_quota_sync(njt_event_t *ev)
+{
+    njt_uint_t                           i;
+    njt_http_cluster_quota_ctx_t       **ctxes;
+    njt_http_cluster_quota_main_conf_t  *qmcf = ev->data;
+
+    if (njt_exiting) {
+        return;
+    }
+
+    njt_add_timer(ev, SYNC_INT);
+
+    ctxes = qmcf->zones.elts;
+    for (i = 0; i < qmcf->zones.nelts; i++) {
+        if (ctxes[i]->sh == NULL || ctxes[i]->node_name == NULL
+            || njt_current_msec < ctxes[i]->next_sync)
+        {
+            continue;
+        }
+
+        ctxes[i]->next_sync = njt_current_msec + ctxes[i]->sync;
+        njt_http_cluster_quota_send(ctxes[i]);
+    }
+}
+
+
+static void
+njt_http_cluster_quota_apply(njt_http_cluster_quota_ctx_t *ctx, uint64_t id,
+    uint64_t req, uint64_t bytes, uint64_t now)
+{
+    njt_http_cluster_quota_slot_t  *slot;
+
+    slot = njt_http_cluster_quota_slot(ctx, id, now);
+    if (slot == NULL) {
+        return;
+    }
+
+    if (req) {
+        if (slot->req_interval) {
+            njt_http_cluster_quota_charge(&slot->req_tat,
+                njt_http_cluster_quota_cost(req, slot->req_interval),
+                slot->req_period, now);
+        } else {
+            (void) njt_atomic_fetch_add(&slot->req_backlog, req);
+        }
+    }
+
+    if (bytes) {
+        if (slot->bytes_interval) {
+            njt_http_cluster_quota_charge(&slot->bytes_tat,
+                njt_http_cluster_quota_cost(bytes, slot->bytes_interval),
+                slot->bytes_period, now);
+        } else {
+            (void) njt_atomic_fetch_add(&slot->bytes_backlog, bytes);
+        }
+    }
+}
+
+
+static int
+njt_http_cluster_quota_recv_data(const char *msg, void *data)
+{
+    uint32_t                             size, len, cnt, i;
+    uint64_t                             id, req, bytes, now;
+    njt_str_t                            key, node, zone;
+    njt_uint_t                           n;
+    const char                          *r = msg;
+    njt_http_cluster_quota_ctx_t        *ctx, **ctxes;
+    njt_http_cluster_quota_main_conf_t  *qmcf = data;
+
+    size = mp_decode_map(&r);
+    if (size != 4) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                      " cluster quota decode failed, maybe not for us");
+        return NJT_ERROR;
+    }
+
+    key.data = (u_char *) mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 4 || njt_memcmp(key.data, "node", 4) != 0) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                      " cluster quota key is not node:%V", &key);
+        return NJT_ERROR;
+    }
+
+    node.data = (u_char *) mp_decode_bin(&r, &len);
+    node.len = len;
+
+    key.data = (u_char *) mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 4 || njt_memcmp(key.data, "zone", 4) != 0) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                      " cluster quota key is not zone:%V", &key);
+        return NJT_ERROR;
+    }
+
+    zone.data = (u_char *) mp_decode_bin(&r, &len);
+    zone.len = len;
+
+    ctx = NULL;
+    ctxes = qmcf->zones.elts;
+
+    for (n = 0; n < qmcf->zones.nelts; n++) {
+        if (ctxes[n]->zone_name.len == zone.len
+            && njt_strncmp(ctxes[n]->zone_name.data, zone.data, zone.len) == 0)
+        {
+            ctx = ctxes[n];
+            break;
+        }
+    }
+
+    if (ctx == NULL || ctx->sh == NULL || ctx->node_name == NULL) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                      " cluster quota not found zone:%V", &zone);
+        return NJT_ERROR;
+    }
+
+    if (node.len == ctx->node_name->len
+        && njt_memcmp(node.data, ctx->node_name->data, node.len) == 0)
+    {
+        //from own, so drop it
+        return NJT_ERROR;
+    }
+
+    key.data = (u_char *) mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 3 || njt_memcmp(key.data, "ver", 3) != 0
+        || mp_decode_uint(&r) != CLUSTER_QUOTA_SYNC_VER)
+    {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                      " cluster quota unknown version");
+        return NJT_ERROR;
+    }
+
+    key.data = (u_char *) mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 1 || key.data[0] != 'q') {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+                      " cluster quota not q:%V", &key);
+        return NJT_ERROR;
+    }
+
+    cnt = mp_decode_array(&r);
+    now = njt_http_cluster_quota_now();
+
+    for (i = 0; i + 2 < cnt; i += 3) {
+        id = mp_decode_uint(&r);
+        req = mp_decode_uint(&r);
+        bytes = mp_decode_uint(&r);
+
+        njt_http_cluster_quota_apply(ctx, id, req, bytes, now);
+    }
+
+    (void) njt_atomic_fetch_add(&ctx->sh->remote, cnt / 3);
+
+    return NJT_OK;
+}
+
+
+static int
+njt_http_cluster_quota_on_node_on(njt_str_t *node, njt_str_t *node_pid,
+    void *data)
+{
+    //nothing todo
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_cluster_quota_init_process(njt_cycle_t *cycle)
+{
+    njt_event_t                         *ev;
+    njt_http_cluster_quota_main_conf_t  *qmcf;
+
+    if (njt_process != NJT_PROCESS_WORKER) {
+        return NJT_OK;
+    }
+
+    qmcf = njt_http_cycle_get_module_main_conf(cycle,
+                                               njt_http_cluster_quota_module);
+    if (qmcf == NULL || qmcf->zones.nelts == 0) {
+        return NJT_OK;
+    }
+
+    njt_gossip_reg_app_handler(njt_http_cluster_quota_recv_data,
+                               njt_http_cluster_quota_on_node_on,
+                               GOSSIP_APP_CLUSTER_QUOTA, qmcf);
+
+    //only the first worker do broadcast job
+    if (njt_worker != 0) {
+        return NJT_OK;
+    }
+
+    ev = njt_pcalloc(cycle->pool, sizeof(njt_event_t));
+    if (ev == NULL) {
+        return NJT_ERROR;
+    }
+
+    ev->log = &cycle->new_log;
+    ev->cancelable = 1;
+    ev->handler = njt_http_cluster_quota_sync;
+    ev->data = qmcf;
+    njt_add_timer(ev, SYNC_INT);
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_cluster_quota_parse_rate(njt_str_t *value, njt_uint_t bytes,
+    uint64_t *interval, uint64_t *period)
+{
+    u_char     *p, *last;
+    off_t       n;
+    uint64_t    seconds;
+    njt_str_t   s;
+
+    *interval = 0;
+    *period = 0;
+
+    if (value->len == 0) {
+        return NJT_OK;
+    }
+
+    last = value->data + value->len;
+
+    p = njt_strlchr(value->data, last, '/');
+    if (p == NULL || p + 2 != last) {
+        return NJT_ERROR;
+    }
+
+    s.data = value->data;
+    s.len = p - value->data;
+
+    if (!bytes && s.len && s.data[s.len - 1] == 'r') {
+        s.len--;
+    }
+
+    n = bytes ? njt_parse_offset(&s) : njt_atoof(s.data, s.len);
+    if (n <= 0) {
+        return NJT_ERROR;
+    }
+
+    switch (p[1]) {
+    case 's':
+        seconds = 1;
+        break;
+    case 'm':
+        seconds = 60;
+        break;
+    case 'h':
+        seconds = 60 * 60;
+        break;
+    case 'd':
+        seconds = 24 * 60 * 60;
+        break;
+    default:
+        return NJT_ERROR;
+    }
+
+    *period = seconds * 1000000000;
+    *interval = seconds * 1000000000000ULL / (uint64_t) n;
+
+    if (*interval == 0) {
+        *interval = 1;
+    }
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_cluster_quota_rules_cleanup(void *data)
+{
+    njt_http_cluster_quota_ctx_t  *ctx = data;
+
+    if (ctx->rules != NULL) {
+        njt_destroy_pool(ctx->rules->pool);
+        ctx->rules = NULL;
+    }
+
+    if (ctx->pool != NULL) {
+        njt_destroy_pool(ctx->pool);
+        ctx->pool = NULL;
+    }
+}
+
+
+static njt_http_cluster_quota_rules_t *
+njt_http_cluster_quota_rules_create(njt_log_t *log)
+{
+    njt_uint_t                       l;
+    njt_pool_t                      *pool;
+    njt_http_cluster_quota_rules_t  *rules;
+
+    pool = njt_create_pool(NJT_DEFAULT_POOL_SIZE, log);
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    rules = njt_pcalloc(pool, sizeof(njt_http_cluster_quota_rules_t));
+    if (rules == NULL) {
+        goto failed;
+    }
+
+    rules->pool = pool;
+
+    for (l = 0; l < NJT_HTTP_CLUSTER_QUOTA_LEVELS; l++) {
+        njt_rbtree_init(&rules->tree[l], &rules->sentinel[l],
+                        njt_str_rbtree_insert_value);
+    }
+
+    if (njt_array_init(&rules->rules, pool, 8,
+                       sizeof(njt_http_cluster_quota_rule_t *))
+        != NJT_OK)
+    {
+        goto failed;
+    }
+
+    return rules;
+
+failed:
+
+    njt_destroy_pool(pool);
+
+    return NULL;
+}
+
+
+static char *
+njt_http_cluster_quota_rules_add(njt_http_cluster_quota_rules_t *rules,
+    njt_http_cluster_quota_rule_spec_t *spec)
+{
+    njt_uint_t                      l;
+    njt_http_cluster_quota_rule_t  *rule, **rulep;
+
+    for (l = 0; l < NJT_HTTP_CLUSTER_QUOTA_LEVELS; l++) {
+        if (spec->scope.len == njt_http_cluster_quota_levels[l].len
+            && njt_strncmp(spec->scope.data, njt_http_cluster_quota_levels[l].data,
+                           spec->scope.len) == 0)
+        {
+            break;
+        }
+    }
+
+    if (l == NJT_HTTP_CLUSTER_QUOTA_LEVELS) {
+        return "invalid scope, must be \"tenant\", \"key\" or \"endpoint\"";
+    }
+
+    if (spec->match.len == 0) {
+        return "empty match";
+    }
+
+    if (spec->requests.len == 0 && spec->bytes.len == 0) {
+        return "neither requests nor bytes is set";
+    }
+
+    if (spec->match.len == 1 && spec->match.data[0] == '*') {
+        if (rules->any[l] != NULL) {
+            return "duplicate rule";
+        }
+
+    } else if (njt_str_rbtree_lookup(&rules->tree[l], &spec->match,
+                   njt_crc32_long(spec->match.data, spec->match.len))
+               != NULL)
+    {
+        return "duplicate rule";
+    }
+
+    rule = njt_pcalloc(rules->pool, sizeof(njt_http_cluster_quota_rule_t));
+    if (rule == NULL) {
+        return "no memory";
+    }
+
+    if (njt_http_cluster_quota_parse_rate(&spec->requests, 0,
+                                          &rule->req_interval,
+                                          &rule->req_period)
+        != NJT_OK)
+    {
+        return "invalid requests, must be like \"1000/m\"";
+    }
+
+    if (njt_http_cluster_quota_parse_rate(&spec->bytes, 1,
+                                          &rule->bytes_interval,
+                                          &rule->bytes_period)
+        != NJT_OK)
+    {
+        return "invalid bytes, must be like \"10g/d\"";
+    }
+
+    rule->level = l;
+    rule->scope = njt_http_cluster_quota_levels[l];
+
+    rule->sn.str.data = njt_pstrdup(rules->pool, &spec->match);
+    rule->requests.data = njt_pstrdup(rules->pool, &spec->requests);
+    rule->bytes.data = njt_pstrdup(rules->pool, &spec->bytes);
+
+    if (rule->sn.str.data == NULL
+        || (spec->requests.len && rule->requests.data == NULL)
+        || (spec->bytes.len && rule->bytes.data == NULL))
+    {
+        return "no memory";
+    }
+
+    rule->sn.str.len = spec->match.len;
+    rule->requests.len = spec->requests.len;
+    rule->bytes.len = spec->bytes.len;
+
+    rulep = njt_array_push(&rules->rules);
+    if (rulep == NULL) {
+        return "no memory";
+    }
+
+    *rulep = rule;
+
+    if (spec->match.len == 1 && spec->match.data[0] == '*') {
+        rules->any[l] = rule;
+        return NULL;
+    }
+
+    rule->sn.node.key = njt_crc32_long(rule->sn.str.data, rule->sn.str.len);
+    njt_rbtree_insert(&rules->tree[l], &rule->sn.node);
+
+    return NULL;
+}
+
+
+static njt_int_t
+njt_http_cluster_quota_update(njt_http_cluster_quota_ctx_t *ctx,
+    njt_http_cluster_quota_rule_spec_t *specs, njt_uint_t n, njt_str_t *err)
+{
+    char                            *rv;
+    u_char                          *p;
+    njt_uint_t                       i;
+    njt_http_cluster_quota_rules_t  *rules;
+
+    rules = njt_http_cluster_quota_rules_create(njt_cycle->log);
+    if (rules == NULL) {
+        p = njt_snprintf(err->data, err->len, "cluster quota zone \"%V\": "
+                         "no memory", &ctx->zone_name);
+        err->len = p - err->data;
+        return NJT_ERROR;
+    }
+
+    for (i = 0; i < n; i++) {
+        rv = njt_http_cluster_quota_rules_add(rules, &specs[i]);
+        if (rv == NULL) {
+            continue;
+        }
+
+        p = njt_snprintf(err->data, err->len, "cluster quota zone \"%V\" "
+                         "%V \"%V\": %s", &ctx->zone_name, &specs[i].scope,
+                         &specs[i].match, rv);
+        err->len = p - err->data;
+
+        njt_destroy_pool(rules->pool);
+        return NJT_ERROR;
+    }
+
+    //tips: requests keep slots, not rules, so the old set can go right away
+    njt_destroy_pool(ctx->rules->pool);
+    ctx->rules = rules;
+
+    njt_log_error(NJT_LOG_INFO, njt_cycle->log, 0,
+                  "cluster quota zone \"%V\" updated with %ui rules",
+                  &ctx->zone_name, n);
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_cluster_quota_init_zone(njt_shm_zone_t *shm_zone, void *data)
+{
+    njt_http_cluster_quota_ctx_t  *octx = data;
+
+    size_t                         len;
+    njt_uint_t                     n;
+    njt_http_cluster_quota_ctx_t  *ctx;
+
+    ctx = shm_zone->data;
+
+    if (octx) {
+        ctx->sh = octx->sh;
+        ctx->shpool = octx->shpool;
+
+        return NJT_OK;
+    }
+
+    ctx->shpool = (njt_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        ctx->sh = ctx->shpool->data;
+
+        return NJT_OK;
+    }
+
+    ctx->sh = njt_slab_calloc(ctx->shpool, sizeof(njt_http_cluster_quota_shctx_t));
+    if (ctx->sh == NULL) {
+        return NJT_ERROR;
+    }
+
+    ctx->shpool->data = ctx->sh;
+
+    //tips: a power of two of slots taking at most half of the zone
+    n = shm_zone->shm.size / 2 / sizeof(njt_http_cluster_quota_slot_t);
+    while (n & (n - 1)) {
+        n &= n - 1;
+    }
+
+    ctx->sh->slots = njt_slab_calloc(ctx->shpool,
+                                     n * sizeof(njt_http_cluster_quota_slot_t));
+    if (ctx->sh->slots == NULL) {
+        return NJT_ERROR;
+    }
+
+    ctx->sh->mask = n - 1;
+
+    len = sizeof(" in cluster_quota_zone \"\"") + shm_zone->shm.name.len;
+
+    ctx->shpool->log_ctx = njt_slab_alloc(ctx->shpool, len);
+    if (ctx->shpool->log_ctx == NULL) {
+        return NJT_ERROR;
+    }
+
+    njt_sprintf(ctx->shpool->log_ctx, " in cluster_quota_zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    return NJT_OK;
+}
+
+
+static njt_http_cluster_quota_ctx_t *
+njt_http_cluster_quota_get_ctx(njt_http_cluster_quota_main_conf_t *qmcf,
+    njt_str_t *name)
+{
+    njt_uint_t                      i;
+    njt_http_cluster_quota_ctx_t  **ctxes;
+
+    ctxes = qmcf->zones.elts;
+
+    for (i = 0; i < qmcf->zones.nelts; i++) {
+        if (ctxes[i]->zone_name.len == name->len
+            && njt_strncmp(ctxes[i]->zone_name.data, name->data, name->len) == 0)
+        {
+            return ctxes[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+static char *
+njt_http_cluster_quota_zone(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_cluster_quota_main_conf_t  *qmcf = conf;
+
+    u_char                         *p;
+    ssize_t                         size;
+    njt_str_t                      *value, name, s;
+    njt_msec_t                      sync;
+    njt_shm_zone_t                 *shm_zone;
+    njt_mqconf_conf_t              *mqconf;
+    njt_pool_cleanup_t             *cln;
+    njt_http_cluster_quota_ctx_t   *ctx, **ctxp;
+
+#if (NJT_PTR_SIZE < 8)
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                       "\"%V\" requires a 64 bits platform", &cmd->name);
+    return NJT_CONF_ERROR;
+#endif
+
+    value = cf->args->elts;
+
+    p = (u_char *) njt_strchr(value[1].data, ':');
+    if (p == NULL || p == value[1].data) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    name.data = value[1].data;
+    name.len = p - value[1].data;
+
+    s.data = p + 1;
+    s.len = value[1].data + value[1].len - s.data;
+
+    size = njt_parse_size(&s);
+    if (size == NJT_ERROR) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    if (size < (ssize_t) (8 * njt_pagesize)) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "zone \"%V\" is too small", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    sync = 1000;
+
+    if (cf->args->nelts == 3) {
+        if (njt_strncmp(value[2].data, "sync=", 5) != 0) {
+            njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NJT_CONF_ERROR;
+        }
+
+        s.data = value[2].data + 5;
+        s.len = value[2].len - 5;
+
+        sync = njt_parse_time(&s, 0);
+        if (sync == (njt_msec_t) NJT_ERROR || sync < SYNC_INT) {
+            njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                               "invalid sync interval \"%V\"", &value[2]);
+            return NJT_CONF_ERROR;
+        }
+    }
+
+    if (njt_http_cluster_quota_get_ctx(qmcf, &name) != NULL) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "duplicate zone \"%V\"", &name);
+        return NJT_CONF_ERROR;
+    }
+
+    ctx = njt_pcalloc(cf->pool, sizeof(njt_http_cluster_quota_ctx_t));
+    if (ctx == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    ctx->zone_name = name;
+    ctx->sync = sync;
+
+    mqconf = (njt_mqconf_conf_t *) njt_get_conf(cf->cycle->conf_ctx,
+                                                njt_mqconf_module);
+    if (mqconf && mqconf->cluster_name.data && mqconf->node_name.data) {
+        ctx->node_name = &mqconf->node_name;
+
+    } else {
+        njt_conf_log_error(NJT_LOG_WARN, cf, 0,
+                           "cluster_name or node_name is not set, "
+                           "quota zone \"%V\" is not synced", &name);
+    }
+
+    ctx->rules = njt_http_cluster_quota_rules_create(cf->log);
+    if (ctx->rules == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    ctx->pool = njt_create_pool(NJT_DEFAULT_POOL_SIZE, cf->log);
+    if (ctx->pool == NULL) {
+        njt_destroy_pool(ctx->rules->pool);
+        return NJT_CONF_ERROR;
+    }
+
+    cln = njt_pool_cleanup_add(cf->pool, 0);
+    if (cln == NULL) {
+        njt_http_cluster_quota_rules_cleanup(ctx);
+        return NJT_CONF_ERROR;
+    }
+
+    cln->handler = njt_http_cluster_quota_rules_cleanup;
+    cln->data = ctx;
+
+    shm_zone = njt_shared_memory_add(cf, &name, size,
+                                     &njt_http_cluster_quota_module);
+    if (shm_zone == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    if (shm_zone->data) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "zone \"%V\" is already used", &name);
+        return NJT_CONF_ERROR;
+    }
+
+    shm_zone->init = njt_http_cluster_quota_init_zone;
+    shm_zone->data = ctx;
+    ctx->shm_zone = shm_zone;
+
+    ctxp = njt_array_push(&qmcf->zones);
+    if (ctxp == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    *ctxp = ctx;
+
+    return NJT_CONF_OK;
+}
+
+
+static char *
+njt_http_cluster_quota_rule(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_cluster_quota_main_conf_t  *qmcf = conf;
+
+    char                                *rv;
+    njt_str_t                           *value, zone;
+    njt_uint_t                           i;
+    njt_http_cluster_quota_ctx_t        *ctx;
+    njt_http_cluster_quota_rule_spec_t   spec;
+
+    value = cf->args->elts;
+
+    njt_memzero(&spec, sizeof(njt_http_cluster_quota_rule_spec_t));
+    njt_str_null(&zone);
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (njt_strncmp(value[i].data, "zone=", 5) == 0) {
+            zone.data = value[i].data + 5;
+            zone.len = value[i].len - 5;
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "scope=", 6) == 0) {
+            spec.scope.data = value[i].data + 6;
+            spec.scope.len = value[i].len - 6;
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "match=", 6) == 0) {
+            spec.match.data = value[i].data + 6;
+            spec.match.len = value[i].len - 6;
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "requests=", 9) == 0) {
+            spec.requests.data = value[i].data + 9;
+            spec.requests.len = value[i].len - 9;
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "bytes=", 6) == 0) {
+            spec.bytes.data = value[i].data + 6;
+            spec.bytes.len = value[i].len - 6;
+            continue;
+        }
+
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NJT_CONF_ERROR;
+    }
+
+    ctx = njt_http_cluster_quota_get_ctx(qmcf, &zone);
+    if (ctx == NULL) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "unknown cluster_quota_zone \"%V\"", &zone);
+        return NJT_CONF_ERROR;
+    }
+
+    rv = njt_http_cluster_quota_rules_add(ctx->rules, &spec);
+    if (rv != NULL) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "%s", rv);
+        return NJT_CONF_ERROR;
+    }
+
+    return NJT_CONF_OK;
+}
+
+
+static char *
+njt_http_cluster_quota(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_cluster_quota_conf_t  *qcf = conf;
+
+    njt_str_t                           *value, zone, s;
+    njt_uint_t                           i;
+    njt_http_complex_value_t           **cv;
+    njt_http_compile_complex_value_t     ccv;
+    njt_http_cluster_quota_main_conf_t  *qmcf;
+
+    if (qcf->ctx != NJT_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (cf->args->nelts == 2 && njt_strcmp(value[1].data, "off") == 0) {
+        qcf->ctx = NULL;
+        return NJT_CONF_OK;
+    }
+
+    qmcf = njt_http_conf_get_module_main_conf(cf, njt_http_cluster_quota_module);
+
+    njt_str_null(&zone);
+    qcf->tenant = NULL;
+    qcf->key = NULL;
+    qcf->endpoint = NULL;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (njt_strncmp(value[i].data, "zone=", 5) == 0) {
+            zone.data = value[i].data + 5;
+            zone.len = value[i].len - 5;
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "tenant=", 7) == 0) {
+            cv = &qcf->tenant;
+            s.data = value[i].data + 7;
+            s.len = value[i].len - 7;
+
+        } else if (njt_strncmp(value[i].data, "key=", 4) == 0) {
+            cv = &qcf->key;
+            s.data = value[i].data + 4;
+            s.len = value[i].len - 4;
+
+        } else if (njt_strncmp(value[i].data, "endpoint=", 9) == 0) {
+            cv = &qcf->endpoint;
+            s.data = value[i].data + 9;
+            s.len = value[i].len - 9;
+
+        } else {
+            njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[i]);
+            return NJT_CONF_ERROR;
+        }
+
+        *cv = njt_palloc(cf->pool, sizeof(njt_http_complex_value_t));
+        if (*cv == NULL) {
+            return NJT_CONF_ERROR;
+        }
+
+        njt_memzero(&ccv, sizeof(njt_http_compile_complex_value_t));
+
+        ccv.cf = cf;
+        ccv.value = &s;
+        ccv.complex_value = *cv;
+
+        if (njt_http_compile_complex_value(&ccv) != NJT_OK) {
+            return NJT_CONF_ERROR;
+        }
+    }
+
+    if (qcf->tenant == NULL) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "\"%V\" must have \"tenant\" parameter",
+                           &cmd->name);
+        return NJT_CONF_ERROR;
+    }
+
+    qcf->ctx = njt_http_cluster_quota_get_ctx(qmcf, &zone);
+    if (qcf->ctx == NULL) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "unknown cluster_quota_zone \"%V\"", &zone);
+        return NJT_CONF_ERROR;
+    }
+
+    return NJT_CONF_OK;
+}
+
+
+static njt_int_t
+njt_http_cluster_quota_usage_handler(njt_http_request_t *r)
+{
+    size_t                               len;
+    u_char                              *p;
+    njt_int_t                            rc;
+    njt_buf_t                           *b;
+    njt_uint_t                           i;
+    njt_chain_t                          out;
+    njt_http_cluster_quota_ctx_t       **ctxes, *ctx;
+    njt_http_cluster_quota_shctx_t      *sh;
+    njt_http_cluster_quota_main_conf_t  *qmcf;
+    njt_str_t                            type = njt_string("application/json");
+
+    if (!(r->method & (NJT_HTTP_GET|NJT_HTTP_HEAD))) {
+        return NJT_HTTP_NOT_ALLOWED;
+    }
+
+    rc = njt_http_discard_request_body(r);
+    if (rc != NJT_OK) {
+        return rc;
+    }
+
+    qmcf = njt_http_get_module_main_conf(r, njt_http_cluster_quota_module);
+    ctxes = qmcf->zones.elts;
+
+    len = sizeof("{\"zones\":[]}");
+
+    for (i = 0; i < qmcf->zones.nelts; i++) {
+        len += sizeof("{\"zone\":\"\",\"synced\":false,\"rules\":,\"slots\":,"
+                      "\"used\":,\"overflow\":,\"passed\":,\"rejected\":,"
+                      "\"remote\":},") + 7 * NJT_ATOMIC_T_LEN
+               + ctxes[i]->zone_name.len
+               + njt_escape_json(NULL, ctxes[i]->zone_name.data,
+                                 ctxes[i]->zone_name.len);
+    }
+
+    b = njt_create_temp_buf(r->pool, len);
+    if (b == NULL) {
+        return NJT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    p = njt_sprintf(b->last, "{\"zones\":[");
+
+    for (i = 0; i < qmcf->zones.nelts; i++) {
+        ctx = ctxes[i];
+        sh = ctx->sh;
+
+        p = njt_sprintf(p, "%s{\"zone\":\"", i ? "," : "");
+        p = (u_char *) njt_escape_json(p, ctx->zone_name.data,
+                                       ctx->zone_name.len);
+        p = njt_sprintf(p, "\",\"synced\":%s,\"rules\":%ui,\"slots\":%ui,"
+                        "\"used\":%uA,\"overflow\":%uA,\"passed\":%uA,"
+                        "\"rejected\":%uA,\"remote\":%uA}",
+                        ctx->node_name ? "true" : "false",
+                        ctx->rules->rules.nelts, sh->mask + 1, sh->used,
+                        sh->overflow, sh->passed, sh->rejected, sh->remote);
+    }
+
+    p = njt_sprintf(p, "]}");
+
+    b->last = p;
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    r->headers_out.status = NJT_HTTP_OK;
+    r->headers_out.content_type_len = type.len;
+    r->headers_out.content_type = type;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    rc = njt_http_send_header(r);
+    if (rc == NJT_ERROR || rc > NJT_OK || r->header_only) {
+        return rc;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    return njt_http_output_filter(r, &out);
+}
+
+
+static char *
+njt_http_cluster_quota_usage(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_core_loc_conf_t  *clcf;
+
+    clcf = njt_http_conf_get_module_loc_conf(cf, njt_http_core_module);
+    clcf->handler = njt_http_cluster_quota_usage_handler;
+
+    return NJT_CONF_OK;
+}
+
+
+static void *
+njt_http_cluster_quota_create_main_conf(njt_conf_t *cf)
+{
+    njt_http_cluster_quota_main_conf_t  *conf;
+
+    conf = njt_pcalloc(cf->pool, sizeof(njt_http_cluster_quota_main_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    if (njt_array_init(&conf->zones, cf->pool, 2,
+                       sizeof(njt_http_cluster_quota_ctx_t *))
+        != NJT_OK)
+    {
+        return NULL;
+    }
+
+    conf->update = njt_http_cluster_quota_update;
+
+    return conf;
+}
+
+
+static void *
+njt_http_cluster_quota_create_conf(njt_conf_t *cf)
+{
+    njt_http_cluster_quota_conf_t  *conf;
+
+    conf = njt_pcalloc(cf->pool, sizeof(njt_http_cluster_quota_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by njt_pcalloc():
+     *
+     *     conf->tenant = NULL;
+     *     conf->key = NULL;
+     *     conf->endpoint = NULL;
+     */
+
+    conf->ctx = NJT_CONF_UNSET_PTR;
+    conf->status_code = NJT_CONF_UNSET_UINT;
+
+    return conf;
+}
+
+
+static char *
+njt_http_cluster_quota_merge_conf(njt_conf_t *cf, void *parent, void *child)
+{
+    njt_http_cluster_quota_conf_t  *prev = parent;
+    njt_http_cluster_quota_conf_t  *conf = child;
+
+    if (conf->ctx == NJT_CONF_UNSET_PTR) {
+        conf->ctx = prev->ctx;
+        conf->tenant = prev->tenant;
+        conf->key = prev->key;
+        conf->endpoint = prev->endpoint;
+    }
+
+    if (conf->ctx == NJT_CONF_UNSET_PTR) {
+        conf->ctx = NULL;
+    }
+
+    njt_conf_merge_uint_value(conf->status_code, prev->status_code,
+                              NJT_HTTP_TOO_MANY_REQUESTS);
+
+    return NJT_CONF_OK;
+}
+
+
+static njt_int_t
+njt_http_cluster_quota_init(njt_conf_t *cf)
+{
+    njt_http_handler_pt        *h;
+    njt_http_core_main_conf_t  *cmcf;
+
+    cmcf = njt_http_conf_get_module_main_conf(cf, njt_http_core_module);
+
+    h = njt_array_push(&cmcf->phases[NJT_HTTP_PREACCESS_PHASE].handlers);
+    if (h == NULL) {
+        return NJT_ERROR;
+    }
+
+    *h = njt_http_cluster_quota_handler;
+
+    h = njt_array_push(&cmcf->phases[NJT_HTTP_LOG_PHASE].handlers);
+    if (h == NULL) {
+        return NJT_ERROR;
+    }
+
+    *h = njt_http_cluster_quota_log_handler;
+
+    return NJT_OK;
+}
@@ -0,0 +1,115 @@
+
+/*
+ * Copyright (C) 2021-2023 TMLake(Beijing) Technology Co., Ltd.
+ */
+
+#ifndef NJT_HTTP_CLUSTER_QUOTA_H_
+#define NJT_HTTP_CLUSTER_QUOTA_H_
+
+#include <njt_config.h>
+#include <njt_core.h>
+#include <njt_http.h>
+
+
+#define NJT_HTTP_CLUSTER_QUOTA_TENANT     0
+#define NJT_HTTP_CLUSTER_QUOTA_KEY        1
+#define NJT_HTTP_CLUSTER_QUOTA_ENDPOINT   2
+#define NJT_HTTP_CLUSTER_QUOTA_LEVELS     3
+#define NJT_HTTP_CLUSTER_QUOTA_LOCKS      64
+
+
+/*
+ * one token bucket per (tenant), (tenant, key) and (tenant, key, endpoint)
+ * path; every field is updated with atomics only, times are in nanoseconds
+ * of the monotonic clock and intervals in picoseconds per unit
+ */
+typedef struct {
+    njt_atomic_t                        id;
+    njt_atomic_t                        req_tat;
+    njt_atomic_t                        bytes_tat;
+    njt_atomic_t                        req_interval;
+    njt_atomic_t                        bytes_interval;
+    njt_atomic_t                        req_period;
+    njt_atomic_t                        bytes_period;
+    //usage not yet sent to the siblings
+    njt_atomic_t                        req_pending;
+    njt_atomic_t                        bytes_pending;
+    //sibling usage received before a local request published the intervals
+    njt_atomic_t                        req_backlog;
+    njt_atomic_t                        bytes_backlog;
+    njt_atomic_t                        last;
+} njt_http_cluster_quota_slot_t;
+
+typedef struct {
+    njt_http_cluster_quota_slot_t      *slots;
+    njt_uint_t                          mask;
+    njt_atomic_t                        used;
+    njt_atomic_t                        overflow;
+    njt_atomic_t                        passed;
+    njt_atomic_t                        rejected;
+    njt_atomic_t                        remote;
+    //a miss takes the lock of the id, so a bucket is never added twice
+    njt_atomic_t                        lock[NJT_HTTP_CLUSTER_QUOTA_LOCKS];
+} njt_http_cluster_quota_shctx_t;
+
+typedef struct {
+    njt_str_t                           scope;
+    njt_str_t                           match;
+    njt_str_t                           requests;
+    njt_str_t                           bytes;
+} njt_http_cluster_quota_rule_spec_t;
+
+typedef struct {
+    njt_str_node_t                      sn;
+    njt_uint_t                          level;
+    njt_str_t                           scope;
+    njt_str_t                           requests;
+    njt_str_t                           bytes;
+    uint64_t                            req_interval;
+    uint64_t                            req_period;
+    uint64_t                            bytes_interval;
+    uint64_t                            bytes_period;
+} njt_http_cluster_quota_rule_t;
+
+typedef struct {
+    njt_pool_t                         *pool;
+    njt_rbtree_t                        tree[NJT_HTTP_CLUSTER_QUOTA_LEVELS];
+    njt_rbtree_node_t                   sentinel[NJT_HTTP_CLUSTER_QUOTA_LEVELS];
+    //rules matching "*"
+    njt_http_cluster_quota_rule_t      *any[NJT_HTTP_CLUSTER_QUOTA_LEVELS];
+    njt_array_t                         rules;
+} njt_http_cluster_quota_rules_t;
+
+typedef struct {
+    njt_http_cluster_quota_shctx_t     *sh;
+    njt_slab_pool_t                    *shpool;
+    njt_shm_zone_t                     *shm_zone;
+    njt_str_t                           zone_name;
+    njt_str_t                          *node_name;
+    njt_msec_t                          sync;
+    njt_msec_t                          next_sync;
+    njt_pool_t                         *pool;
+    //process local, replaced as a whole by the dynamic limit api
+    njt_http_cluster_quota_rules_t     *rules;
+} njt_http_cluster_quota_ctx_t;
+
+typedef struct {
+    njt_http_cluster_quota_ctx_t       *ctx;
+    njt_http_complex_value_t           *tenant;
+    njt_http_complex_value_t           *key;
+    njt_http_complex_value_t           *endpoint;
+    njt_uint_t                          status_code;
+} njt_http_cluster_quota_conf_t;
+
+typedef njt_int_t (*njt_http_cluster_quota_update_pt)(
+    njt_http_cluster_quota_ctx_t *ctx, njt_http_cluster_quota_rule_spec_t *specs,
+    njt_uint_t n, njt_str_t *err);
+
+typedef struct {
+    njt_array_t                         zones;
+    //used by njet-http-dyn-limit-module, which finds this module by name
+    njt_http_cluster_quota_update_pt    update;
+} njt_http_cluster_quota_main_conf_t;
+
+
+#endif /* NJT_HTTP_CLUSTER_QUOTA_H_ */
@@ -0,0 +1,1025 @@
+/*
+ * Copyright (C) 2021-2023 TMLake(Beijing) Technology Co., Ltd.
+ */
+
+#include <njt_config.h>
+#include <njt_core.h>
+#include <njt_http.h>
+#include <msgpuck.h>
+#include <njt_mqconf_module.h>
+#include "njt_gossip.h"
+
+
+#define GOSSIP_APP_CLUSTER_SSL_SESSION      0x5C1A7E93
+
+#define CLUSTER_SSL_SESSION_SYNC_VER        2
+//period of the check for a new rotation period or a reloaded secret
+#define CLUSTER_SSL_SESSION_TIMER           1000
+//tickets encrypted at most this many periods ago are accepted
+#define CLUSTER_SSL_SESSION_MAX_PREVIOUS    16
+#define CLUSTER_SSL_SESSION_SECRET_SIZE     32
+#define CLUSTER_SSL_SESSION_MAX_SECRET_FILE 4096
+#define CLUSTER_SSL_SESSION_IV_LEN          12
+#define CLUSTER_SSL_SESSION_TAG_LEN         16
+//zone name, id and expire of a sealed session
+#define CLUSTER_SSL_SESSION_MAX_HEADER      512
+
+
+/*
+ * every node derives the ticket key of a rotation period from the
+ * configured cluster secret, so all nodes use the same current, previous
+ * and next keys without exchanging them; gossip is not authenticated, so
+ * the secret is never sent, a secret replaced on reload still decrypts
+ * tickets until prev_until
+ */
+typedef struct {
+    njt_atomic_t                            generation;
+    time_t                                  prev_until;
+    u_char                                  secret[CLUSTER_SSL_SESSION_SECRET_SIZE];
+    u_char                                  prev[CLUSTER_SSL_SESSION_SECRET_SIZE];
+} njt_http_cluster_ssl_session_shctx_t;
+
+typedef struct {
+    njt_http_cluster_ssl_session_shctx_t   *sh;
+    njt_slab_pool_t                        *shpool;
+    njt_shm_zone_t                         *shm_zone;
+
+    //ticket keys are off when 0
+    time_t                                  rotate;
+    njt_uint_t                              previous;
+    njt_str_t                               secret_file;
+    u_char                                  secret[CLUSTER_SSL_SESSION_SECRET_SIZE];
+    //seals replicated sessions, derived from the secret
+    u_char                                  session_key[CLUSTER_SSL_SESSION_SECRET_SIZE];
+
+    njt_flag_t                              session_cache;
+    njt_str_t                              *node_name;
+
+    //per process keys, shared by all ssl contexts
+    njt_array_t                            *keys;
+    time_t                                  epoch;
+    njt_atomic_uint_t                       generation;
+    njt_event_t                             timer;
+} njt_http_cluster_ssl_session_main_conf_t;
+
+
+extern njt_module_t njt_mqconf_module;
+
+static void *njt_http_cluster_ssl_session_create_main_conf(njt_conf_t *cf);
+static njt_int_t njt_http_cluster_ssl_session_init(njt_conf_t *cf);
+static njt_int_t njt_http_cluster_ssl_session_init_worker(njt_cycle_t *cycle);
+static char *njt_http_cluster_ssl_ticket_keys(njt_conf_t *cf,
+    njt_command_t *cmd, void *conf);
+static njt_int_t njt_http_cluster_ssl_session_read_secret(njt_conf_t *cf,
+    njt_str_t *name, u_char *secret);
+static njt_int_t njt_http_cluster_ssl_session_init_zone(
+    njt_shm_zone_t *shm_zone, void *data);
+static void njt_http_cluster_ssl_session_set_secret(
+    njt_http_cluster_ssl_session_main_conf_t *cmcf, u_char *secret);
+static njt_int_t njt_http_cluster_ssl_session_derive_key(u_char *secret,
+    time_t epoch, njt_ssl_ticket_key_t *key);
+static njt_int_t njt_http_cluster_ssl_session_update_keys(
+    njt_http_cluster_ssl_session_main_conf_t *cmcf, njt_log_t *log);
+static void njt_http_cluster_ssl_session_timer(njt_event_t *ev);
+static void njt_http_cluster_ssl_session_export(njt_shm_zone_t *shm_zone,
+    u_char *id, size_t id_len, u_char *buf, size_t len, time_t timeout);
+static int njt_http_cluster_ssl_session_recv_data(const char *msg,
+    void *data);
+
+
+static njt_command_t njt_http_cluster_ssl_session_commands[] = {
+
+    { njt_string("cluster_ssl_ticket_keys"),
+      NJT_HTTP_MAIN_CONF|NJT_CONF_TAKE12,
+      njt_http_cluster_ssl_ticket_keys,
+      NJT_HTTP_MAIN_CONF_OFFSET,
+      0,
+      NULL },
+
+    { njt_string("cluster_ssl_session_cache"),
+      NJT_HTTP_MAIN_CONF|NJT_CONF_FLAG,
+      njt_conf_set_flag_slot,
+      NJT_HTTP_MAIN_CONF_OFFSET,
+      offsetof(njt_http_cluster_ssl_session_main_conf_t, session_cache),
+      NULL },
+
+      njt_null_command
+};
+
+
+static njt_http_module_t njt_http_cluster_ssl_session_module_ctx = {
+    NULL,                                           /* preconfiguration */
+    njt_http_cluster_ssl_session_init,              /* postconfiguration */
+
+    njt_http_cluster_ssl_session_create_main_conf,  /* create main configuration */
+    NULL,                                           /* init main configuration */
+
+    NULL,                                           /* create server configuration */
+    NULL,                                           /* merge server configuration */
+
+    NULL,                                           /* create location configuration */
+    NULL                                            /* merge location configuration */
+};
+
+
+njt_module_t njt_http_cluster_ssl_session_module = {
+    NJT_MODULE_V1,
+    &njt_http_cluster_ssl_session_module_ctx,       /* module context */
+    njt_http_cluster_ssl_session_commands,          /* module directives */
+    NJT_HTTP_MODULE,                                /* module type */
+    NULL,                                           /* init master */
+    NULL,                                           /* init module */
+    njt_http_cluster_ssl_session_init_worker,       /* init process */
+    NULL,                                           /* init thread */
+    NULL,                                           /* exit thread */
+    NULL,                                           /* exit process */
+    NULL,                                           /* exit master */
+    NJT_MODULE_V1_PADDING
+};
+
+
+static void *
+njt_http_cluster_ssl_session_create_main_conf(njt_conf_t *cf)
+{
+    njt_http_cluster_ssl_session_main_conf_t *cmcf;
+
+    cmcf = njt_pcalloc(cf->pool, sizeof(njt_http_cluster_ssl_session_main_conf_t));
+    if (cmcf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by njt_pcalloc():
+     *
+     *     cmcf->rotate = 0;
+     *     cmcf->secret_file = { 0, NULL };
+     *     cmcf->node_name = NULL;
+     *     cmcf->keys = NULL;
+     */
+
+    cmcf->session_cache = NJT_CONF_UNSET;
+
+    return cmcf;
+}
+
+
+static char *
+njt_http_cluster_ssl_ticket_keys(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_cluster_ssl_session_main_conf_t *cmcf = conf;
+    njt_str_t *value, s, name = njt_string("cluster_ssl_ticket_keys");
+    njt_uint_t i;
+    unsigned int len;
+    njt_shm_zone_t *shm_zone;
+
+    if (cmcf->rotate) {
+        return "is duplicate";
+    }
+
+    cmcf->rotate = 3600;
+
+    value = cf->args->elts;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+        if (njt_strncmp(value[i].data, "rotate=", 7) == 0) {
+            s.data = value[i].data + 7;
+            s.len = value[i].len - 7;
+
+            cmcf->rotate = njt_parse_time(&s, 1);
+            if (cmcf->rotate == (time_t) NJT_ERROR || cmcf->rotate < 60) {
+                njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid rotate \"%V\", at least 60s", &value[i]);
+                return NJT_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "secret=", 7) == 0) {
+            cmcf->secret_file.data = value[i].data + 7;
+            cmcf->secret_file.len = value[i].len - 7;
+
+            if (njt_http_cluster_ssl_session_read_secret(cf, &cmcf->secret_file, cmcf->secret) != NJT_OK) {
+                return NJT_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid parameter \"%V\"", &value[i]);
+        return NJT_CONF_ERROR;
+    }
+
+    if (cmcf->secret_file.len == 0) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "\"secret\" parameter is required, "
+            "all nodes of the cluster must use the same secret file");
+        return NJT_CONF_ERROR;
+    }
+
+    if (HMAC(EVP_sha256(), cmcf->secret, CLUSTER_SSL_SESSION_SECRET_SIZE,
+             (u_char *) "njet session key", sizeof("njet session key") - 1, cmcf->session_key, &len) == NULL)
+    {
+        njt_ssl_error(NJT_LOG_EMERG, cf->log, 0, "HMAC() failed");
+        return NJT_CONF_ERROR;
+    }
+
+    shm_zone = njt_shared_memory_add(cf, &name, 8 * njt_pagesize, &njt_http_cluster_ssl_session_module);
+    if (shm_zone == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    shm_zone->init = njt_http_cluster_ssl_session_init_zone;
+    shm_zone->data = cmcf;
+    cmcf->shm_zone = shm_zone;
+
+    return NJT_CONF_OK;
+}
+
+
+// the secret is the sha256 of the file, so it may be of any length from 32 bytes
+static njt_int_t
+njt_http_cluster_ssl_session_read_secret(njt_conf_t *cf, njt_str_t *name, u_char *secret)
+{
+    u_char buf[CLUSTER_SSL_SESSION_MAX_SECRET_FILE];
+    size_t size;
+    ssize_t n;
+    njt_int_t rc;
+    njt_file_t file;
+    unsigned int len;
+    njt_file_info_t fi;
+
+    if (njt_conf_full_name(cf->cycle, name, 1) != NJT_OK) {
+        return NJT_ERROR;
+    }
+
+    njt_memzero(&file, sizeof(njt_file_t));
+    file.name = *name;
+    file.log = cf->log;
+
+    file.fd = njt_open_file(file.name.data, NJT_FILE_RDONLY, NJT_FILE_OPEN, 0);
+    if (file.fd == NJT_INVALID_FILE) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, njt_errno, njt_open_file_n " \"%V\" failed", &file.name);
+        return NJT_ERROR;
+    }
+
+    rc = NJT_ERROR;
+
+    if (njt_fd_info(file.fd, &fi) == NJT_FILE_ERROR) {
+        njt_conf_log_error(NJT_LOG_CRIT, cf, njt_errno, njt_fd_info_n " \"%V\" failed", &file.name);
+        goto done;
+    }
+
+    size = njt_file_size(&fi);
+
+    if (size < CLUSTER_SSL_SESSION_SECRET_SIZE || size > CLUSTER_SSL_SESSION_MAX_SECRET_FILE) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "\"%V\" must be from %d to %d bytes", &file.name,
+            CLUSTER_SSL_SESSION_SECRET_SIZE, CLUSTER_SSL_SESSION_MAX_SECRET_FILE);
+        goto done;
+    }
+
+    n = njt_read_file(&file, buf, size, 0);
+
+    if (n == NJT_ERROR || (size_t) n != size) {
+        njt_conf_log_error(NJT_LOG_CRIT, cf, njt_errno, njt_read_file_n " \"%V\" failed", &file.name);
+        goto done;
+    }
+
+    if (EVP_Digest(buf, size, secret, &len, EVP_sha256(), NULL) != 1) {
+        njt_ssl_error(NJT_LOG_EMERG, cf->log, 0, "EVP_Digest() failed");
+        goto done;
+    }
+
+    rc = NJT_OK;
+
+done:
+
+    njt_explicit_memzero(buf, sizeof(buf));
+
+    if (njt_close_file(file.fd) == NJT_FILE_ERROR) {
+        njt_log_error(NJT_LOG_ALERT, cf->log, njt_errno, njt_close_file_n " \"%V\" failed", &file.name);
+    }
+
+    return rc;
+}
+
+
+static njt_int_t
+njt_http_cluster_ssl_session_init_zone(njt_shm_zone_t *shm_zone, void *data)
+{
+    njt_http_cluster_ssl_session_main_conf_t *ocmcf = data;
+    njt_http_cluster_ssl_session_main_conf_t *cmcf;
+
+    cmcf = shm_zone->data;
+
+    if (ocmcf) {
+        cmcf->sh = ocmcf->sh;
+        cmcf->shpool = ocmcf->shpool;
+
+        goto done;
+    }
+
+    cmcf->shpool = (njt_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        cmcf->sh = cmcf->shpool->data;
+
+        goto done;
+    }
+
+    cmcf->sh = njt_slab_calloc(cmcf->shpool, sizeof(njt_http_cluster_ssl_session_shctx_t));
+    if (cmcf->sh == NULL) {
+        return NJT_ERROR;
+    }
+
+    cmcf->shpool->data = cmcf->sh;
+
+    njt_memcpy(cmcf->sh->secret, cmcf->secret, CLUSTER_SSL_SESSION_SECRET_SIZE);
+
+    return NJT_OK;
+
+done:
+
+    /* a changed secret replaces the one in use on reload */
+
+    if (njt_memcmp(cmcf->sh->secret, cmcf->secret, CLUSTER_SSL_SESSION_SECRET_SIZE) != 0) {
+        njt_http_cluster_ssl_session_set_secret(cmcf, cmcf->secret);
+    }
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_cluster_ssl_session_set_secret(njt_http_cluster_ssl_session_main_conf_t *cmcf, u_char *secret)
+{
+    njt_http_cluster_ssl_session_shctx_t *sh = cmcf->sh;
+
+    njt_shmtx_lock(&cmcf->shpool->mutex);
+
+    njt_memcpy(sh->prev, sh->secret, CLUSTER_SSL_SESSION_SECRET_SIZE);
+    sh->prev_until = njt_time() + cmcf->rotate * (cmcf->previous + 1);
+
+    njt_memcpy(sh->secret, secret, CLUSTER_SSL_SESSION_SECRET_SIZE);
+
+    njt_shmtx_unlock(&cmcf->shpool->mutex);
+
+    (void) njt_atomic_fetch_add(&sh->generation, 1);
+}
+
+
+/*
+ * the 80 bytes key of a period are
+ * HMAC-SHA256(secret, "njet ticket key" | epoch | counter), counter 1..3
+ */
+static njt_int_t
+njt_http_cluster_ssl_session_derive_key(u_char *secret, time_t epoch, njt_ssl_ticket_key_t *key)
+{
+    u_char msg[sizeof("njet ticket key") - 1 + 8 + 1], *p;
+    u_char out[3 * 32];
+    uint64_t e;
+    njt_uint_t i;
+    unsigned int len;
+
+    p = njt_cpymem(msg, "njet ticket key", sizeof("njet ticket key") - 1);
+
+    e = (uint64_t) epoch;
+    for (i = 0; i < 8; i++) {
+        *p++ = (u_char) (e >> (56 - 8 * i));
+    }
+
+    for (i = 0; i < 3; i++) {
+        *p = (u_char) (i + 1);
+
+        if (HMAC(EVP_sha256(), secret, CLUSTER_SSL_SESSION_SECRET_SIZE, msg, sizeof(msg),
+                 out + 32 * i, &len) == NULL)
+        {
+            njt_explicit_memzero(out, sizeof(out));
+            return NJT_ERROR;
+        }
+
+        p = msg + sizeof(msg) - 1;
+    }
+
+    key->size = 80;
+    key->shared = 0;
+    //non-default keys renew the ticket
+    key->expire = 1;
+    njt_memcpy(key->name, out, 16);
+    njt_memcpy(key->hmac_key, out + 16, 32);
+    njt_memcpy(key->aes_key, out + 48, 32);
+
+    njt_explicit_memzero(out, sizeof(out));
+
+    return NJT_OK;
+}
+
+
+/*
+ * keys: the current period, the previous ones, the next one for
+ * nodes with a clock ahead, then the same of a replaced secret
+ */
+static njt_int_t
+njt_http_cluster_ssl_session_update_keys(njt_http_cluster_ssl_session_main_conf_t *cmcf, njt_log_t *log)
+{
+    time_t now, epoch, prev_until;
+    njt_uint_t i, n, generation;
+    njt_ssl_ticket_key_t *key;
+    u_char secret[CLUSTER_SSL_SESSION_SECRET_SIZE];
+    u_char prev[CLUSTER_SSL_SESSION_SECRET_SIZE];
+
+    now = njt_time();
+    epoch = now / cmcf->rotate;
+    generation = cmcf->sh->generation;
+
+    if (epoch == cmcf->epoch && generation == cmcf->generation) {
+        return NJT_DECLINED;
+    }
+
+    njt_shmtx_lock(&cmcf->shpool->mutex);
+
+    njt_memcpy(secret, cmcf->sh->secret, CLUSTER_SSL_SESSION_SECRET_SIZE);
+    njt_memcpy(prev, cmcf->sh->prev, CLUSTER_SSL_SESSION_SECRET_SIZE);
+    prev_until = cmcf->sh->prev_until;
+
+    njt_shmtx_unlock(&cmcf->shpool->mutex);
+
+    key = cmcf->keys->elts;
+    n = 0;
+
+    for (i = 0; i <= cmcf->previous; i++) {
+        if (njt_http_cluster_ssl_session_derive_key(secret, epoch - i, &key[n++]) != NJT_OK) {
+            goto failed;
+        }
+    }
+
+    if (njt_http_cluster_ssl_session_derive_key(secret, epoch + 1, &key[n++]) != NJT_OK) {
+        goto failed;
+    }
+
+    if (prev_until > now) {
+        for (i = 0; i <= cmcf->previous; i++) {
+            if (njt_http_cluster_ssl_session_derive_key(prev, epoch - i, &key[n++]) != NJT_OK) {
+                goto failed;
+            }
+        }
+    }
+
+    //tips: the array never grows, so the ssl contexts keep a valid pointer
+    cmcf->keys->nelts = n;
+
+    njt_log_debug3(NJT_LOG_DEBUG_EVENT, log, 0,
+                   "cluster ssl ticket key: \"%*xs\", %ui keys",
+                   (size_t) 16, key[0].name, n);
+
+    cmcf->epoch = epoch;
+    cmcf->generation = generation;
+
+    njt_explicit_memzero(secret, CLUSTER_SSL_SESSION_SECRET_SIZE);
+    njt_explicit_memzero(prev, CLUSTER_SSL_SESSION_SECRET_SIZE);
+
+    return NJT_OK;
+
+failed:
+
+    njt_ssl_error(NJT_LOG_ALERT, log, 0, "HMAC() failed");
+
+    njt_explicit_memzero(secret, CLUSTER_SSL_SESSION_SECRET_SIZE);
+    njt_explicit_memzero(prev, CLUSTER_SSL_SESSION_SECRET_SIZE);
+
+    return NJT_ERROR;
+}
+
+
+static void
+njt_http_cluster_ssl_session_keys_cleanup(void *data)
+{
+    njt_array_t *keys = data;
+
+    njt_explicit_memzero(keys->elts, keys->nalloc * sizeof(njt_ssl_ticket_key_t));
+}
+
+
+/*
+ * servers with ssl_session_tickets on and no ssl_session_ticket_key
+ * encrypt tickets with the keys of the cluster
+ */
+static njt_int_t
+njt_http_cluster_ssl_session_init(njt_conf_t *cf)
+{
+    u_char buf[80];
+    time_t timeout;
+    njt_uint_t s, nssl;
+    njt_pool_cleanup_t *cln;
+    njt_ssl_ticket_key_t *key;
+    njt_mqconf_conf_t *mqconf;
+    njt_http_ssl_srv_conf_t *sscf;
+    njt_http_core_srv_conf_t **cscfp;
+    njt_http_core_main_conf_t *cmcf_core;
+    njt_http_cluster_ssl_session_main_conf_t *cmcf;
+
+    cmcf = njt_http_conf_get_module_main_conf(cf, njt_http_cluster_ssl_session_module);
+
+    njt_conf_init_value(cmcf->session_cache, 0);
+
+    if (cmcf->session_cache) {
+        //sessions are sealed with a key derived from the cluster secret
+        if (cmcf->secret_file.len == 0) {
+            njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                "\"cluster_ssl_session_cache\" requires \"cluster_ssl_ticket_keys\" with \"secret\"");
+            return NJT_ERROR;
+        }
+
+        mqconf = (njt_mqconf_conf_t *) njt_get_conf(cf->cycle->conf_ctx, njt_mqconf_module);
+        if (mqconf && mqconf->cluster_name.data && mqconf->node_name.data) {
+            cmcf->node_name = &mqconf->node_name;
+
+        } else {
+            njt_conf_log_error(NJT_LOG_WARN, cf, 0,
+                "cluster_name or node_name is not set, ssl sessions are not synced");
+        }
+    }
+
+    if (cmcf->rotate == 0) {
+        return NJT_OK;
+    }
+
+    cmcf_core = njt_http_conf_get_module_main_conf(cf, njt_http_core_module);
+    cscfp = cmcf_core->servers.elts;
+
+    timeout = 0;
+    nssl = 0;
+
+    for (s = 0; s < cmcf_core->servers.nelts; s++) {
+        sscf = cscfp[s]->ctx->srv_conf[njt_http_ssl_module.ctx_index];
+
+        if (sscf->ssl.ctx == NULL || !sscf->session_tickets || sscf->session_ticket_keys) {
+            continue;
+        }
+
+        timeout = njt_max(timeout, sscf->session_timeout);
+        nssl++;
+    }
+
+    if (nssl == 0) {
+        return NJT_OK;
+    }
+
+    cmcf->previous = (timeout + cmcf->rotate - 1) / cmcf->rotate;
+
+    if (cmcf->previous == 0) {
+        cmcf->previous = 1;
+
+    } else if (cmcf->previous > CLUSTER_SSL_SESSION_MAX_PREVIOUS) {
+        njt_conf_log_error(NJT_LOG_WARN, cf, 0,
+            "ssl_session_timeout is more than %d rotate periods of cluster_ssl_ticket_keys, "
+            "older tickets are not accepted", CLUSTER_SSL_SESSION_MAX_PREVIOUS);
+        cmcf->previous = CLUSTER_SSL_SESSION_MAX_PREVIOUS;
+    }
+
+    cmcf->keys = njt_array_create(cf->pool, 2 * (cmcf->previous + 1) + 1, sizeof(njt_ssl_ticket_key_t));
+    if (cmcf->keys == NULL) {
+        return NJT_ERROR;
+    }
+
+    cln = njt_pool_cleanup_add(cf->pool, 0);
+    if (cln == NULL) {
+        return NJT_ERROR;
+    }
+
+    cln->handler = njt_http_cluster_ssl_session_keys_cleanup;
+    cln->data = cmcf->keys;
+
+    /* a random key until the zone is ready in the worker */
+
+    key = njt_array_push(cmcf->keys);
+    if (key == NULL) {
+        return NJT_ERROR;
+    }
+
+    if (RAND_bytes(buf, 80) != 1) {
+        njt_ssl_error(NJT_LOG_EMERG, cf->log, 0, "RAND_bytes() failed");
+        return NJT_ERROR;
+    }
+
+    key->size = 80;
+    key->shared = 0;
+    key->expire = 1;
+    njt_memcpy(key->name, buf, 16);
+    njt_memcpy(key->hmac_key, buf + 16, 32);
+    njt_memcpy(key->aes_key, buf + 48, 32);
+
+    njt_explicit_memzero(buf, 80);
+
+    for (s = 0; s < cmcf_core->servers.nelts; s++) {
+        sscf = cscfp[s]->ctx->srv_conf[njt_http_ssl_module.ctx_index];
+
+        if (sscf->ssl.ctx == NULL || !sscf->session_tickets || sscf->session_ticket_keys) {
+            continue;
+        }
+
+        switch (njt_ssl_session_ticket_keys_set(&sscf->ssl, cmcf->keys)) {
+        case NJT_OK:
+            break;
+
+        case NJT_DECLINED:
+            njt_conf_log_error(NJT_LOG_WARN, cf, 0,
+                "\"cluster_ssl_ticket_keys\" ignored, not supported");
+            return NJT_OK;
+
+        default:
+            return NJT_ERROR;
+        }
+    }
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_cluster_ssl_session_init_worker(njt_cycle_t *cycle)
+{
+    njt_http_cluster_ssl_session_main_conf_t *cmcf;
+
+    if (njt_process != NJT_PROCESS_WORKER) {
+        return NJT_OK;
+    }
+
+    cmcf = njt_http_cycle_get_module_main_conf(cycle, njt_http_cluster_ssl_session_module);
+    if (cmcf == NULL) {
+        return NJT_OK;
+    }
+
+    if (cmcf->keys) {
+        if (njt_http_cluster_ssl_session_update_keys(cmcf, cycle->log) == NJT_ERROR) {
+            return NJT_ERROR;
+        }
+
+        cmcf->timer.handler = njt_http_cluster_ssl_session_timer;
+        cmcf->timer.data = cmcf;
+        cmcf->timer.log = cycle->log;
+        cmcf->timer.cancelable = 1;
+
+        njt_add_timer(&cmcf->timer, CLUSTER_SSL_SESSION_TIMER);
+    }
+
+    if (cmcf->node_name == NULL) {
+        return NJT_OK;
+    }
+
+    njt_ssl_session_export = njt_http_cluster_ssl_session_export;
+
+    njt_gossip_reg_app_handler(njt_http_cluster_ssl_session_recv_data, NULL,
+        GOSSIP_APP_CLUSTER_SSL_SESSION, cmcf);
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_cluster_ssl_session_timer(njt_event_t *ev)
+{
+    njt_http_cluster_ssl_session_main_conf_t *cmcf = ev->data;
+
+    if (njt_exiting) {
+        return;
+    }
+
+    (void) njt_http_cluster_ssl_session_update_keys(cmcf, ev->log);
+
+    njt_add_timer(ev, CLUSTER_SSL_SESSION_TIMER);
+}
+
+
+/*
+ *  { "node": node, "ver": 2, "s": [ sealed ] }
+ *
+ * sealed is iv | AES-256-GCM([ zone, id, expire, session ]) | tag, with
+ * the node name as aad: sessions carry master secrets, and gossip is
+ * not authenticated
+ */
+static char *
+njt_http_cluster_ssl_session_msg_head(njt_http_cluster_ssl_session_main_conf_t *cmcf, njt_str_t *target,
+    njt_str_t *target_pid, char **end)
+{
+    char *buf, *tail;
+    size_t buf_size;
+
+    buf_size = 0;
+    buf = njt_gossip_app_get_msg_buf(GOSSIP_APP_CLUSTER_SSL_SESSION, *target, *target_pid, &buf_size);
+    if (buf == NULL || buf_size == 0) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster ssl session apply buffer failed");
+        return NULL;
+    }
+
+    *end = buf + buf_size;
+
+    tail = mp_encode_map(buf, 3);
+
+    tail = mp_encode_str(tail, "node", 4);
+    tail = mp_encode_bin(tail, (const char *) cmcf->node_name->data, cmcf->node_name->len);
+
+    tail = mp_encode_str(tail, "ver", 3);
+    tail = mp_encode_uint(tail, CLUSTER_SSL_SESSION_SYNC_VER);
+
+    return tail;
+}
+
+
+/*
+ * encrypts len bytes after the iv in place and appends the tag
+ */
+static njt_int_t
+njt_http_cluster_ssl_session_seal(njt_http_cluster_ssl_session_main_conf_t *cmcf, u_char *iv, size_t len)
+{
+    int n;
+    u_char *p;
+    EVP_CIPHER_CTX *ctx;
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL) {
+        return NJT_ERROR;
+    }
+
+    p = iv + CLUSTER_SSL_SESSION_IV_LEN;
+
+    if (RAND_bytes(iv, CLUSTER_SSL_SESSION_IV_LEN) != 1
+        || EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, cmcf->session_key, iv) != 1
+        || EVP_EncryptUpdate(ctx, NULL, &n, cmcf->node_name->data, cmcf->node_name->len) != 1
+        || EVP_EncryptUpdate(ctx, p, &n, p, len) != 1
+        || EVP_EncryptFinal_ex(ctx, p + n, &n) != 1
+        || EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, CLUSTER_SSL_SESSION_TAG_LEN, p + len) != 1)
+    {
+        EVP_CIPHER_CTX_free(ctx);
+        return NJT_ERROR;
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+
+    return NJT_OK;
+}
+
+
+/*
+ * decrypts a sealed session of a node into out, only if the tag matches
+ */
+static njt_int_t
+njt_http_cluster_ssl_session_open(njt_http_cluster_ssl_session_main_conf_t *cmcf, njt_str_t *node,
+    u_char *in, size_t len, u_char *out)
+{
+    int n;
+    u_char *p;
+    EVP_CIPHER_CTX *ctx;
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL) {
+        return NJT_ERROR;
+    }
+
+    p = in + CLUSTER_SSL_SESSION_IV_LEN;
+    len -= CLUSTER_SSL_SESSION_IV_LEN + CLUSTER_SSL_SESSION_TAG_LEN;
+
+    if (EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, cmcf->session_key, in) != 1
+        || EVP_DecryptUpdate(ctx, NULL, &n, node->data, node->len) != 1
+        || EVP_DecryptUpdate(ctx, out, &n, p, len) != 1
+        || EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, CLUSTER_SSL_SESSION_TAG_LEN, p + len) != 1
+        || EVP_DecryptFinal_ex(ctx, out + n, &n) != 1)
+    {
+        EVP_CIPHER_CTX_free(ctx);
+        return NJT_ERROR;
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_cluster_ssl_session_export(njt_shm_zone_t *shm_zone, u_char *id, size_t id_len, u_char *buf, size_t len,
+    time_t timeout)
+{
+    char *tail, *end, *p, *q;
+    time_t expire;
+    uint32_t plen;
+    njt_str_t target = njt_string("all");
+    njt_str_t target_pid = njt_string("0");
+    njt_http_cluster_ssl_session_main_conf_t *cmcf;
+
+    cmcf = njt_http_cycle_get_module_main_conf(njt_cycle, njt_http_cluster_ssl_session_module);
+    if (cmcf == NULL || cmcf->node_name == NULL || !cmcf->session_cache) {
+        return;
+    }
+
+    tail = njt_http_cluster_ssl_session_msg_head(cmcf, &target, &target_pid, &end);
+    if (tail == NULL) {
+        return;
+    }
+
+    tail = mp_encode_str(tail, "s", 1);
+
+    //an absolute time, so a replayed message can not revive an expired session
+    expire = njt_time() + timeout;
+
+    plen = mp_sizeof_array(4) + mp_sizeof_str(shm_zone->shm.name.len) + mp_sizeof_bin(id_len)
+           + mp_sizeof_uint(expire) + mp_sizeof_bin(len);
+
+    if (plen > NJT_SSL_MAX_SESSION_SIZE + CLUSTER_SSL_SESSION_MAX_HEADER
+        || (size_t) (end - tail) < 1 + mp_sizeof_bin(CLUSTER_SSL_SESSION_IV_LEN + plen
+                                                     + CLUSTER_SSL_SESSION_TAG_LEN))
+    {
+        //tips: too big for a packet, the session stays on this node
+        njt_log_debug1(NJT_LOG_DEBUG_EVENT, njt_cycle->log, 0,
+                       "cluster ssl session of %uz bytes not synced", len);
+        tail = mp_encode_array(tail, 0);
+
+    } else {
+        p = mp_encode_array(tail, 1);
+        p = mp_encode_binl(p, CLUSTER_SSL_SESSION_IV_LEN + plen + CLUSTER_SSL_SESSION_TAG_LEN);
+
+        q = p + CLUSTER_SSL_SESSION_IV_LEN;
+        q = mp_encode_array(q, 4);
+        q = mp_encode_str(q, (const char *) shm_zone->shm.name.data, shm_zone->shm.name.len);
+        q = mp_encode_bin(q, (const char *) id, id_len);
+        q = mp_encode_uint(q, expire);
+        q = mp_encode_bin(q, (const char *) buf, len);
+
+        if (njt_http_cluster_ssl_session_seal(cmcf, (u_char *) p, plen) == NJT_OK) {
+            tail = q + CLUSTER_SSL_SESSION_TAG_LEN;
+
+        } else {
+            njt_ssl_error(NJT_LOG_ALERT, njt_cycle->log, 0, "cluster ssl session seal failed");
+            njt_explicit_memzero(p, plen + CLUSTER_SSL_SESSION_IV_LEN);
+            tail = mp_encode_array(tail, 0);
+        }
+    }
+
+    njt_gossip_app_close_msg_buf(tail);
+    njt_gossip_send_app_msg_buf();
+}
+
+
+static void
+njt_http_cluster_ssl_session_import(njt_http_cluster_ssl_session_main_conf_t *cmcf, njt_str_t *node,
+    const char **r, uint32_t cnt)
+{
+    u_char *id, *buf, *sealed;
+    uint32_t len, id_len, sealed_len;
+    uint64_t expire;
+    njt_str_t name;
+    njt_list_part_t *part;
+    njt_shm_zone_t *shm_zone;
+    njt_uint_t i;
+    const char *p, *end;
+    u_char plain[NJT_SSL_MAX_SESSION_SIZE + CLUSTER_SSL_SESSION_MAX_HEADER];
+
+    if (cnt != 1 || mp_typeof(**r) != MP_BIN) {
+        for (i = 0; i < cnt; i++) {
+            mp_next(r);
+        }
+
+        return;
+    }
+
+    sealed = (u_char *) mp_decode_bin(r, &sealed_len);
+
+    if (sealed_len < CLUSTER_SSL_SESSION_IV_LEN + CLUSTER_SSL_SESSION_TAG_LEN
+        || sealed_len - CLUSTER_SSL_SESSION_IV_LEN - CLUSTER_SSL_SESSION_TAG_LEN > sizeof(plain))
+    {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster ssl session of node:%V invalid size", node);
+        return;
+    }
+
+    len = sealed_len - CLUSTER_SSL_SESSION_IV_LEN - CLUSTER_SSL_SESSION_TAG_LEN;
+
+    if (njt_http_cluster_ssl_session_open(cmcf, node, sealed, sealed_len, plain) != NJT_OK) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+            " cluster ssl session of node:%V not authenticated, check the secret", node);
+        return;
+    }
+
+    p = (const char *) plain;
+    end = p + len;
+
+    if (mp_check(&p, end) != 0 || p != end) {
+        goto invalid;
+    }
+
+    p = (const char *) plain;
+
+    if (mp_typeof(*p) != MP_ARRAY || mp_decode_array(&p) != 4
+        || mp_typeof(*p) != MP_STR)
+    {
+        goto invalid;
+    }
+
+    name.data = (u_char *) mp_decode_str(&p, &len);
+    name.len = len;
+
+    if (mp_typeof(*p) != MP_BIN) {
+        goto invalid;
+    }
+
+    id = (u_char *) mp_decode_bin(&p, &id_len);
+
+    if (mp_typeof(*p) != MP_UINT) {
+        goto invalid;
+    }
+
+    expire = mp_decode_uint(&p);
+
+    if (mp_typeof(*p) != MP_BIN) {
+        goto invalid;
+    }
+
+    buf = (u_char *) mp_decode_bin(&p, &len);
+
+    if ((time_t) expire <= njt_time()) {
+        goto done;
+    }
+
+    part = (njt_list_part_t *) &njt_cycle->shared_memory.part;
+    shm_zone = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                goto done;
+            }
+
+            part = part->next;
+            shm_zone = part->elts;
+            i = 0;
+        }
+
+        if (shm_zone[i].init == njt_ssl_session_cache_init
+            && shm_zone[i].shm.name.len == name.len
+            && njt_strncmp(shm_zone[i].shm.name.data, name.data, name.len) == 0)
+        {
+            break;
+        }
+    }
+
+    (void) njt_ssl_session_cache_add(&shm_zone[i], id, id_len, buf, len, (time_t) expire, njt_cycle->log);
+
+done:
+
+    njt_explicit_memzero(plain, sizeof(plain));
+    return;
+
+invalid:
+
+    njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster ssl session of node:%V decode failed", node);
+    njt_explicit_memzero(plain, sizeof(plain));
+}
+
+
+static int
+njt_http_cluster_ssl_session_recv_data(const char *msg, void *data)
+{
+    uint32_t size, len, cnt;
+    njt_str_t key, node;
+    const char *r = msg;
+    njt_http_cluster_ssl_session_main_conf_t *cmcf = data;
+
+    size = mp_decode_map(&r);
+    if (size != 3) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster ssl session decode failed, maybe not for us");
+        return NJT_ERROR;
+    }
+
+    key.data = (u_char *) mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 4 || njt_memcmp(key.data, "node", 4) != 0) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster ssl session key is not node:%V", &key);
+        return NJT_ERROR;
+    }
+
+    node.data = (u_char *) mp_decode_bin(&r, &len);
+    node.len = len;
+
+    if (node.len == cmcf->node_name->len && njt_memcmp(node.data, cmcf->node_name->data, node.len) == 0) {
+        //from own, so drop it
+        return NJT_ERROR;
+    }
+
+    key.data = (u_char *) mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 3 || njt_memcmp(key.data, "ver", 3) != 0 || mp_decode_uint(&r) != CLUSTER_SSL_SESSION_SYNC_VER) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster ssl session unknown version");
+        return NJT_ERROR;
+    }
+
+    key.data = (u_char *) mp_decode_str(&r, &len);
+    key.len = len;
+
+    if (key.len != 1 || key.data[0] != 's') {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " cluster ssl session unknown key:%V", &key);
+        return NJT_ERROR;
+    }
+
+    cnt = mp_decode_array(&r);
+
+    njt_http_cluster_ssl_session_import(cmcf, &node, &r, cnt);
+
+    return NJT_OK;
+}
@@ -8,12 +8,555 @@
 #include <njt_http_util.h>
 #include <njt_http_dyn_module.h>
 #include <njt_rpc_result_util.h>
+#include <msgpuck.h>
+#include <njt_mqconf_module.h>
+#include "njt_gossip.h"
 #include "njt_http_dyn_bwlist_parser.h"
 
+
+#define GOSSIP_APP_DYN_BWLIST           0x6B1D2F4C
+
+#define DYN_BWLIST_BAN_SYNC_VER         1
+//worst case size of one encoded (addr, ttl) pair
+#define DYN_BWLIST_BAN_PAIR_SIZE        (2 + 16 + 9)
+//slots probed from the home slot of an address
+#define DYN_BWLIST_BAN_MAX_PROBE        16
+//an expired entry without recent strikes may be reused after this time
+#define DYN_BWLIST_BAN_STALE            60000
+//spinlocks serializing the inserts, chosen by address
+#define DYN_BWLIST_BAN_LOCKS            64
+
+
+/*
+ * one entry per client address, bans and strikes expire by time only;
+ * every field is updated with atomics, times are njt_current_msec
+ */
+typedef struct {
+    njt_atomic_t                        id;
+    njt_atomic_t                        ban_until;
+    njt_atomic_t                        window_start;
+    njt_atomic_t                        strikes;
+    njt_atomic_t                        last;
+    njt_uint_t                          len;
+    u_char                              addr[16];
+} njt_http_dyn_bwlist_ban_slot_t;
+
+typedef struct {
+    njt_http_dyn_bwlist_ban_slot_t     *slots;
+    njt_uint_t                          mask;
+    njt_atomic_t                        used;
+    njt_atomic_t                        overflow;
+    njt_atomic_t                        banned;
+    njt_atomic_t                        blocked;
+    njt_atomic_t                        remote;
+    njt_atomic_t                        lock[DYN_BWLIST_BAN_LOCKS];
+} njt_http_dyn_bwlist_ban_shctx_t;
+
+typedef struct {
+    njt_http_dyn_bwlist_ban_shctx_t    *sh;
+    njt_slab_pool_t                    *shpool;
+    njt_shm_zone_t                     *shm_zone;
+    njt_flag_t                          sync;
+    njt_str_t                          *node_name;
+} njt_http_dyn_bwlist_main_conf_t;
+
+typedef struct {
+    njt_flag_t                          ban;
+    njt_uint_t                          ban_status;
+    //strikes, 0 is off
+    njt_uint_t                          threshold;
+    njt_msec_t                          window;
+    njt_msec_t                          ban_time;
+} njt_http_dyn_bwlist_loc_conf_t;
+
+typedef struct {
+    size_t                              len;
+    u_char                              addr[16];
+    njt_msec_t                          ttl;
+} njt_http_dyn_bwlist_ban_t;
+
+
 extern njt_module_t njt_http_access_module;
+extern njt_module_t njt_mqconf_module;
+extern njt_module_t njt_http_dyn_bwlist_module;
+
+static void njt_http_dyn_bwlist_ban_send(njt_http_dyn_bwlist_main_conf_t *bmcf,
+    njt_http_dyn_bwlist_ban_t *bans, njt_uint_t n, njt_str_t *target,
+    njt_str_t *target_pid);
 
 njt_str_t dyn_bwlist_update_srv_err_msg = njt_string("{\"code\":500,\"msg\":\"server error\"}");
 
+static njt_int_t njt_http_dyn_bwlist_ban_key(struct sockaddr *sa, u_char *addr, size_t *len)
+{
+    struct sockaddr_in *sin;
+#if (NJT_HAVE_INET6)
+    struct sockaddr_in6 *sin6;
+#endif
+
+    switch (sa->sa_family) {
+    case AF_INET:
+        sin = (struct sockaddr_in *) sa;
+        njt_memcpy(addr, &sin->sin_addr, 4);
+        *len = 4;
+        return NJT_OK;
+
+#if (NJT_HAVE_INET6)
+    case AF_INET6:
+        sin6 = (struct sockaddr_in6 *) sa;
+        // ipv4 clients of a dual stack listen are banned by their ipv4 address
+        if (IN6_IS_ADDR_V4MAPPED(&sin6->sin6_addr)) {
+            njt_memcpy(addr, &sin6->sin6_addr.s6_addr[12], 4);
+            *len = 4;
+        } else {
+            njt_memcpy(addr, sin6->sin6_addr.s6_addr, 16);
+            *len = 16;
+        }
+        return NJT_OK;
+#endif
+    }
+
+    return NJT_DECLINED;
+}
+
+static njt_inline uint64_t njt_http_dyn_bwlist_ban_id(u_char *addr, size_t len)
+{
+    uint64_t id;
+
+    id = ((uint64_t) njt_murmur_hash2(addr, len) << 32) | njt_crc32_short(addr, len);
+
+    return id ? id : 1;
+}
+
+static njt_inline njt_uint_t njt_http_dyn_bwlist_ban_stale(njt_http_dyn_bwlist_ban_slot_t *slot, njt_msec_t now)
+{
+    return slot->ban_until <= now && slot->last + DYN_BWLIST_BAN_STALE <= now;
+}
+
+// lookup only, the request path never writes the table of a clean client
+static njt_http_dyn_bwlist_ban_slot_t *njt_http_dyn_bwlist_ban_lookup(njt_http_dyn_bwlist_ban_shctx_t *sh, uint64_t id)
+{
+    njt_uint_t i, n;
+    njt_http_dyn_bwlist_ban_slot_t *slot;
+
+    for (n = 0, i = id & sh->mask; n < DYN_BWLIST_BAN_MAX_PROBE; n++, i = (i + 1) & sh->mask) {
+        slot = &sh->slots[i];
+
+        if (slot->id == id) {
+            return slot;
+        }
+
+        if (slot->id == 0) {
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static njt_http_dyn_bwlist_ban_slot_t *njt_http_dyn_bwlist_ban_slot(njt_http_dyn_bwlist_ban_shctx_t *sh, uint64_t id,
+    u_char *addr, size_t len, njt_msec_t now)
+{
+    njt_uint_t i, n;
+    njt_atomic_t *lock;
+    njt_atomic_uint_t old;
+    njt_http_dyn_bwlist_ban_slot_t *slot, *stale;
+
+    slot = njt_http_dyn_bwlist_ban_lookup(sh, id);
+    if (slot != NULL) {
+        return slot;
+    }
+
+    // a miss probes again under the lock of the address, so it is never added twice
+    lock = &sh->lock[id % DYN_BWLIST_BAN_LOCKS];
+
+    njt_spinlock(lock, 1, 2048);
+
+    stale = NULL;
+
+    for (n = 0, i = id & sh->mask; n < DYN_BWLIST_BAN_MAX_PROBE; n++, i = (i + 1) & sh->mask) {
+        slot = &sh->slots[i];
+
+        if (slot->id == id) {
+            goto done;
+        }
+
+        if (slot->id == 0) {
+            // tips: another address may take the free slot without the lock
+            if (njt_atomic_cmp_set(&slot->id, 0, id)) {
+                njt_memcpy(slot->addr, addr, len);
+                slot->len = len;
+                slot->last = now;
+                (void) njt_atomic_fetch_add(&sh->used, 1);
+                goto done;
+            }
+
+            if (slot->id == id) {
+                goto done;
+            }
+
+            continue;
+        }
+
+        if (stale == NULL && njt_http_dyn_bwlist_ban_stale(slot, now)) {
+            stale = slot;
+        }
+    }
+
+    slot = NULL;
+
+    if (stale == NULL) {
+        goto done;
+    }
+
+    // slots are never emptied, an expired entry is taken over instead
+    old = stale->id;
+
+    if (!njt_http_dyn_bwlist_ban_stale(stale, now) || !njt_atomic_cmp_set(&stale->id, old, id)) {
+        goto done;
+    }
+
+    stale->ban_until = 0;
+    stale->window_start = 0;
+    stale->strikes = 0;
+    njt_memcpy(stale->addr, addr, len);
+    stale->len = len;
+    stale->last = now;
+
+    slot = stale;
+
+done:
+
+    njt_unlock(lock);
+
+    if (slot == NULL) {
+        (void) njt_atomic_fetch_add(&sh->overflow, 1);
+    }
+
+    return slot;
+}
+
+/*
+ * ttl 0 lifts the ban, a ban from the api replaces the old one and
+ * a ban from a sibling only extends it
+ */
+static njt_int_t njt_http_dyn_bwlist_ban_set(njt_http_dyn_bwlist_main_conf_t *bmcf, u_char *addr, size_t len,
+    njt_msec_t ttl, njt_flag_t extend)
+{
+    njt_msec_t now;
+    njt_atomic_uint_t old, until;
+    njt_http_dyn_bwlist_ban_slot_t *slot;
+
+    now = njt_current_msec;
+
+    slot = njt_http_dyn_bwlist_ban_slot(bmcf->sh, njt_http_dyn_bwlist_ban_id(addr, len), addr, len, now);
+    if (slot == NULL) {
+        return NJT_ERROR;
+    }
+
+    slot->last = now;
+
+    if (ttl == 0) {
+        slot->ban_until = 0;
+        slot->strikes = 0;
+        return NJT_OK;
+    }
+
+    until = now + ttl;
+
+    if (!extend) {
+        slot->ban_until = until;
+        return NJT_OK;
+    }
+
+    do {
+        old = slot->ban_until;
+        if (old >= until) {
+            return NJT_OK;
+        }
+    } while (!njt_atomic_cmp_set(&slot->ban_until, old, until));
+
+    return NJT_OK;
+}
+
+static njt_int_t njt_http_dyn_bwlist_ban_handler(njt_http_request_t *r)
+{
+    u_char addr[16];
+    size_t len;
+    njt_http_dyn_bwlist_loc_conf_t *blcf;
+    njt_http_dyn_bwlist_main_conf_t *bmcf;
+    njt_http_dyn_bwlist_ban_slot_t *slot;
+
+    blcf = njt_http_get_module_loc_conf(r, njt_http_dyn_bwlist_module);
+    if (!blcf->ban) {
+        return NJT_DECLINED;
+    }
+
+    bmcf = njt_http_get_module_main_conf(r, njt_http_dyn_bwlist_module);
+    if (bmcf->sh == NULL) {
+        return NJT_DECLINED;
+    }
+
+    if (njt_http_dyn_bwlist_ban_key(r->connection->sockaddr, addr, &len) != NJT_OK) {
+        return NJT_DECLINED;
+    }
+
+    slot = njt_http_dyn_bwlist_ban_lookup(bmcf->sh, njt_http_dyn_bwlist_ban_id(addr, len));
+    if (slot == NULL || slot->ban_until <= njt_current_msec) {
+        return NJT_DECLINED;
+    }
+
+    (void) njt_atomic_fetch_add(&bmcf->sh->blocked, 1);
+
+    njt_log_error(NJT_LOG_INFO, r->connection->log, 0, "access forbidden by dyn_bwlist ban");
+
+    return blcf->ban_status;
+}
+
+// counts the rejections of limit_req and cluster_limit_req of a client
+static njt_int_t njt_http_dyn_bwlist_strike_handler(njt_http_request_t *r)
+{
+    u_char addr[16];
+    size_t len;
+    njt_msec_t now;
+    njt_atomic_uint_t old, start;
+    njt_http_dyn_bwlist_ban_t ban;
+    njt_http_dyn_bwlist_loc_conf_t *blcf;
+    njt_http_dyn_bwlist_main_conf_t *bmcf;
+    njt_http_dyn_bwlist_ban_slot_t *slot;
+    njt_str_t target = njt_string("all");
+    njt_str_t target_pid = njt_string("0");
+
+    if (!r->main->limit_rejected) {
+        return NJT_OK;
+    }
+
+    blcf = njt_http_get_module_loc_conf(r, njt_http_dyn_bwlist_module);
+    if (blcf->threshold == 0) {
+        return NJT_OK;
+    }
+
+    bmcf = njt_http_get_module_main_conf(r, njt_http_dyn_bwlist_module);
+    if (bmcf->sh == NULL) {
+        return NJT_OK;
+    }
+
+    if (njt_http_dyn_bwlist_ban_key(r->connection->sockaddr, addr, &len) != NJT_OK) {
+        return NJT_OK;
+    }
+
+    now = njt_current_msec;
+
+    slot = njt_http_dyn_bwlist_ban_slot(bmcf->sh, njt_http_dyn_bwlist_ban_id(addr, len), addr, len, now);
+    if (slot == NULL) {
+        return NJT_OK;
+    }
+
+    slot->last = now;
+
+    start = slot->window_start;
+    if (start + blcf->window <= now && njt_atomic_cmp_set(&slot->window_start, start, now)) {
+        slot->strikes = 0;
+    }
+
+    if (njt_atomic_fetch_add(&slot->strikes, 1) + 1 < blcf->threshold) {
+        return NJT_OK;
+    }
+
+    // only the worker winning the ban reports and propagates it
+    old = slot->ban_until;
+    if (old > now || !njt_atomic_cmp_set(&slot->ban_until, old, now + blcf->ban_time)) {
+        return NJT_OK;
+    }
+
+    slot->strikes = 0;
+    (void) njt_atomic_fetch_add(&bmcf->sh->banned, 1);
+
+    njt_log_error(NJT_LOG_WARN, r->connection->log, 0,
+        "client %V banned for %M ms by dyn_bwlist after %ui rejections",
+        &r->connection->addr_text, blcf->ban_time, blcf->threshold);
+
+    if (bmcf->sync && bmcf->node_name) {
+        njt_memcpy(ban.addr, addr, len);
+        ban.len = len;
+        ban.ttl = blcf->ban_time;
+        njt_http_dyn_bwlist_ban_send(bmcf, &ban, 1, &target, &target_pid);
+    }
+
+    return NJT_OK;
+}
+
+/*
+ *  bans are sent to the siblings as soon as they are set:
+ *  { "node": node, "ver": 1, "b": [ addr, ttl, ... ] }
+ */
+static void njt_http_dyn_bwlist_ban_send(njt_http_dyn_bwlist_main_conf_t *bmcf, njt_http_dyn_bwlist_ban_t *bans,
+    njt_uint_t n, njt_str_t *target, njt_str_t *target_pid)
+{
+    char *buf, *tail, *end, *replace_cnt;
+    size_t buf_size;
+    njt_uint_t i, cnt;
+
+    for (i = 0; i < n; /* void */) {
+        buf_size = 0;
+        buf = njt_gossip_app_get_msg_buf(GOSSIP_APP_DYN_BWLIST, *target, *target_pid, &buf_size);
+        if (buf == NULL || buf_size == 0) {
+            njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " dyn bwlist apply buffer failed");
+            return;
+        }
+
+        end = buf + buf_size;
+
+        tail = mp_encode_map(buf, 3);
+
+        tail = mp_encode_str(tail, "node", 4);
+        tail = mp_encode_bin(tail, (const char *) bmcf->node_name->data, bmcf->node_name->len);
+
+        tail = mp_encode_str(tail, "ver", 3);
+        tail = mp_encode_uint(tail, DYN_BWLIST_BAN_SYNC_VER);
+
+        tail = mp_encode_str(tail, "b", 1);
+
+        //tips: reserve an array16 header, the count is filled when the packet is full
+        replace_cnt = tail;
+        tail += 3;
+        cnt = 0;
+
+        while (i < n && end - tail >= DYN_BWLIST_BAN_PAIR_SIZE) {
+            tail = mp_encode_bin(tail, (const char *) bans[i].addr, bans[i].len);
+            tail = mp_encode_uint(tail, bans[i].ttl);
+            cnt += 2;
+            i++;
+        }
+
+        mp_store_u16(mp_store_u8(replace_cnt, 0xdc), cnt);
+        njt_gossip_app_close_msg_buf(tail);
+        njt_gossip_send_app_msg_buf();
+
+        if (cnt == 0) {
+            njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " dyn bwlist no room for bans in packet");
+            return;
+        }
+    }
+}
+
+static int njt_http_dyn_bwlist_ban_recv_data(const char *msg, void *data)
+{
+    uint32_t size, len, cnt, i;
+    uint64_t ttl;
+    njt_str_t key, node, addr;
+    const char *r = msg;
+    njt_http_dyn_bwlist_main_conf_t *bmcf = data;
+
+    size = mp_decode_map(&r);
+    if (size != 3) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " dyn bwlist decode failed, maybe not for us");
+        return NJT_ERROR;
+    }
+
+    key.data = (u_char *) mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 4 || njt_memcmp(key.data, "node", 4) != 0) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " dyn bwlist key is not node:%V", &key);
+        return NJT_ERROR;
+    }
+
+    node.data = (u_char *) mp_decode_bin(&r, &len);
+    node.len = len;
+
+    if (node.len == bmcf->node_name->len && njt_memcmp(node.data, bmcf->node_name->data, node.len) == 0) {
+        //from own, so drop it
+        return NJT_ERROR;
+    }
+
+    key.data = (u_char *) mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 3 || njt_memcmp(key.data, "ver", 3) != 0 || mp_decode_uint(&r) != DYN_BWLIST_BAN_SYNC_VER) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " dyn bwlist unknown version");
+        return NJT_ERROR;
+    }
+
+    key.data = (u_char *) mp_decode_str(&r, &len);
+    key.len = len;
+    if (key.len != 1 || key.data[0] != 'b') {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, " dyn bwlist not b:%V", &key);
+        return NJT_ERROR;
+    }
+
+    cnt = mp_decode_array(&r);
+
+    for (i = 0; i + 1 < cnt; i += 2) {
+        addr.data = (u_char *) mp_decode_bin(&r, &len);
+        addr.len = len;
+        ttl = mp_decode_uint(&r);
+
+        if (addr.len != 4 && addr.len != 16) {
+            continue;
+        }
+
+        (void) njt_http_dyn_bwlist_ban_set(bmcf, addr.data, addr.len, (njt_msec_t) ttl, ttl ? 1 : 0);
+    }
+
+    (void) njt_atomic_fetch_add(&bmcf->sh->remote, cnt / 2);
+
+    return NJT_OK;
+}
+
+// collects the active bans into an array of njt_http_dyn_bwlist_ban_t
+static njt_int_t njt_http_dyn_bwlist_ban_collect(njt_http_dyn_bwlist_main_conf_t *bmcf, njt_array_t *out)
+{
+    njt_uint_t i;
+    njt_msec_t now, until;
+    njt_http_dyn_bwlist_ban_t *ban;
+    njt_http_dyn_bwlist_ban_slot_t *slot;
+
+    now = njt_current_msec;
+
+    for (i = 0; i <= bmcf->sh->mask; i++) {
+        slot = &bmcf->sh->slots[i];
+        until = slot->ban_until;
+
+        if (slot->id == 0 || until <= now || (slot->len != 4 && slot->len != 16)) {
+            continue;
+        }
+
+        ban = njt_array_push(out);
+        if (ban == NULL) {
+            return NJT_ERROR;
+        }
+
+        ban->len = slot->len;
+        njt_memcpy(ban->addr, slot->addr, slot->len);
+        ban->ttl = until - now;
+    }
+
+    return NJT_OK;
+}
+
+// a node joining the cluster gets all bans in force
+static int njt_http_dyn_bwlist_ban_on_node_on(njt_str_t *node, njt_str_t *node_pid, void *data)
+{
+    njt_array_t bans;
+    njt_pool_t *pool;
+    njt_http_dyn_bwlist_main_conf_t *bmcf = data;
+
+    pool = njt_create_pool(njt_pagesize, njt_cycle->log);
+    if (pool == NULL) {
+        return NJT_ERROR;
+    }
+
+    if (njt_array_init(&bans, pool, 64, sizeof(njt_http_dyn_bwlist_ban_t)) == NJT_OK
+        && njt_http_dyn_bwlist_ban_collect(bmcf, &bans) == NJT_OK
+        && bans.nelts > 0)
+    {
+        njt_log_error(NJT_LOG_INFO, njt_cycle->log, 0, "node:%V online, sync %ui dyn bwlist bans", node, bans.nelts);
+        njt_http_dyn_bwlist_ban_send(bmcf, bans.elts, bans.nelts, node, node_pid);
+    }
+
+    njt_destroy_pool(pool);
+
+    return NJT_OK;
+}
+
 static njt_int_t njt_dyn_bwlist_set_rules(njt_pool_t *pool, dynbwlist_servers_item_locations_item_t *data, njt_http_conf_ctx_t *ctx, njt_rpc_result_t *rpc_result)
 {
     njt_http_access_loc_conf_t *alcf, old_cf;
@@ -124,6 +667,12 @@ static njt_int_t njt_dyn_bwlist_set_rules(njt_pool_t *pool, dynbwlist_servers_it
     }
 #endif
 
+    // compile the new lists before they replace the old ones
+    if (njt_http_access_compile(cf->pool, alcf) != NJT_OK) {
+        njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, "can't compile access rules ");
+        goto error;
+    }
+
     if (old_cf.dynamic && old_cf.rules != NULL) {
         njt_destroy_pool(old_cf.rules->pool);
         old_cf.rules = NULL;
@@ -338,6 +887,53 @@ static void njt_dyn_bwlist_dump_locs(njt_pool_t *pool, njt_queue_t *locations, d
 
 }
 
+static njt_int_t njt_dyn_bwlist_dump_bans(njt_cycle_t *cycle, njt_pool_t *pool, dynbwlist_t *dynjson_obj)
+{
+    njt_uint_t i;
+    njt_array_t bans;
+    njt_str_t addr;
+    njt_http_dyn_bwlist_ban_t *ban;
+    njt_http_dyn_bwlist_main_conf_t *bmcf;
+    dynbwlist_bans_item_t *ban_item;
+
+    bmcf = njt_http_cycle_get_module_main_conf(cycle, njt_http_dyn_bwlist_module);
+    if (bmcf == NULL || bmcf->sh == NULL) {
+        return NJT_OK;
+    }
+
+    if (njt_array_init(&bans, pool, 16, sizeof(njt_http_dyn_bwlist_ban_t)) != NJT_OK
+        || njt_http_dyn_bwlist_ban_collect(bmcf, &bans) != NJT_OK)
+    {
+        return NJT_ERROR;
+    }
+
+    set_dynbwlist_bans(dynjson_obj, create_dynbwlist_bans(pool, bans.nelts ? bans.nelts : 1));
+    if (dynjson_obj->bans == NULL) {
+        return NJT_ERROR;
+    }
+
+    ban = bans.elts;
+    for (i = 0; i < bans.nelts; i++) {
+        ban_item = create_dynbwlist_bans_item(pool);
+        if (ban_item == NULL) {
+            return NJT_ERROR;
+        }
+
+        addr.data = njt_pcalloc(pool, NJT_INET6_ADDRSTRLEN);
+        if (addr.data == NULL) {
+            return NJT_ERROR;
+        }
+        addr.len = njt_inet_ntop(ban[i].len == 4 ? AF_INET : AF_INET6, ban[i].addr, addr.data, NJT_INET6_ADDRSTRLEN);
+
+        set_dynbwlist_bans_item_addr(ban_item, &addr);
+        // the remaining time in seconds, rounded up
+        set_dynbwlist_bans_item_ttl(ban_item, (ban[i].ttl + 999) / 1000);
+        add_item_dynbwlist_bans(dynjson_obj->bans, ban_item);
+    }
+
+    return NJT_OK;
+}
+
 static njt_str_t *njt_dyn_bwlist_dump_access_conf(njt_cycle_t *cycle, njt_pool_t *pool)
 {
     njt_http_core_loc_conf_t *clcf;
@@ -397,6 +993,10 @@ static njt_str_t *njt_dyn_bwlist_dump_access_conf(njt_cycle_t *cycle, njt_pool_t
         add_item_dynbwlist_servers(dynjson_obj.servers, server_item);
     }
 
+    if (njt_dyn_bwlist_dump_bans(cycle, pool, &dynjson_obj) != NJT_OK) {
+        goto err;
+    }
+
     return to_json_dynbwlist(pool, &dynjson_obj, OMIT_NULL_ARRAY | OMIT_NULL_OBJ | OMIT_NULL_STR);
 
 err:
@@ -404,7 +1004,88 @@ err:
 
 }
 
-static njt_int_t njt_dyn_bwlist_update_access_conf(njt_pool_t *pool, dynbwlist_t *api_data, njt_rpc_result_t *rpc_result)
+/*
+ * bans are kept in the shared zone, not in the configuration of the
+ * locations; the worker serving the api call also passes them on to
+ * the cluster, the full configuration broadcast to the others is not
+ */
+static void njt_dyn_bwlist_update_bans(njt_pool_t *pool, dynbwlist_bans_t *api_bans, njt_rpc_result_t *rpc_result,
+    njt_flag_t sync)
+{
+    njt_uint_t i;
+    njt_addr_t addr;
+    njt_array_t bans;
+    njt_http_dyn_bwlist_ban_t *ban;
+    njt_http_dyn_bwlist_main_conf_t *bmcf;
+    dynbwlist_bans_item_t *ban_item;
+    u_char data_buf[1024];
+    u_char *end;
+    njt_str_t rpc_data_str;
+    njt_str_t target = njt_string("all");
+    njt_str_t target_pid = njt_string("0");
+
+    rpc_data_str.data = data_buf;
+    rpc_data_str.len = 0;
+
+    if (api_bans == NULL || api_bans->nelts == 0) {
+        return;
+    }
+
+    end = njt_snprintf(data_buf, sizeof(data_buf) - 1, "bans");
+    rpc_data_str.len = end - data_buf;
+    njt_rpc_result_set_conf_path(rpc_result, &rpc_data_str);
+
+    bmcf = njt_http_cycle_get_module_main_conf(njt_cycle, njt_http_dyn_bwlist_module);
+    if (bmcf == NULL || bmcf->sh == NULL) {
+        end = njt_snprintf(data_buf, sizeof(data_buf) - 1, " dyn_bwlist_ban_zone is not configured");
+        rpc_data_str.len = end - data_buf;
+        njt_rpc_result_add_error_data(rpc_result, &rpc_data_str);
+        return;
+    }
+
+    if (njt_array_init(&bans, pool, api_bans->nelts, sizeof(njt_http_dyn_bwlist_ban_t)) != NJT_OK) {
+        return;
+    }
+
+    for (i = 0; i < api_bans->nelts; i++) {
+        ban_item = get_dynbwlist_bans_item(api_bans, i);
+
+        ban = njt_array_push(&bans);
+        if (ban == NULL) {
+            return;
+        }
+
+        if (njt_parse_addr(pool, &addr, ban_item->addr.data, ban_item->addr.len) != NJT_OK
+            || njt_http_dyn_bwlist_ban_key(addr.sockaddr, ban->addr, &ban->len) != NJT_OK)
+        {
+            njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0, "skipping wrong ban addr: %V ", &ban_item->addr);
+            end = njt_snprintf(data_buf, sizeof(data_buf) - 1, " wrong ban addr: %V", &ban_item->addr);
+            rpc_data_str.len = end - data_buf;
+            njt_rpc_result_add_error_data(rpc_result, &rpc_data_str);
+            bans.nelts--;
+            continue;
+        }
+
+        ban->ttl = (njt_msec_t) ban_item->ttl * 1000;
+
+        if (njt_http_dyn_bwlist_ban_set(bmcf, ban->addr, ban->len, ban->ttl, 0) != NJT_OK) {
+            end = njt_snprintf(data_buf, sizeof(data_buf) - 1, " ban zone is full: %V", &ban_item->addr);
+            rpc_data_str.len = end - data_buf;
+            njt_rpc_result_add_error_data(rpc_result, &rpc_data_str);
+            bans.nelts--;
+            continue;
+        }
+
+        njt_rpc_result_add_success_count(rpc_result);
+    }
+
+    if (sync && bmcf->sync && bmcf->node_name && bans.nelts > 0) {
+        njt_http_dyn_bwlist_ban_send(bmcf, bans.elts, bans.nelts, &target, &target_pid);
+    }
+}
+
+static njt_int_t njt_dyn_bwlist_update_access_conf(njt_pool_t *pool, dynbwlist_t *api_data, njt_rpc_result_t *rpc_result,
+    njt_flag_t sync)
 {
     njt_cycle_t *cycle;
     njt_http_core_srv_conf_t *cscf;
@@ -461,6 +1142,9 @@ static njt_int_t njt_dyn_bwlist_update_access_conf(njt_pool_t *pool, dynbwlist_t
             njt_rpc_result_add_success_count(rpc_result);
         }
     }
+
+    njt_dyn_bwlist_update_bans(pool, api_data->bans, rpc_result, sync);
+
     njt_rpc_result_update_code(rpc_result);
     return NJT_OK;
 }
@@ -538,7 +1222,7 @@ static int njt_dyn_bwlist_change_handler_internal(njt_str_t *key, njt_str_t *val
         goto rpc_msg;
     }
 
-    rc = njt_dyn_bwlist_update_access_conf(pool, api_data, rpc_result);
+    rc = njt_dyn_bwlist_update_access_conf(pool, api_data, rpc_result, out_msg != NULL);
 
 rpc_msg:
     if (out_msg) {
@@ -573,6 +1257,8 @@ static njt_int_t njt_http_dyn_bwlist_module_init_process(njt_cycle_t *cycle)
 {
     njt_str_t bwlist_rpc_key = njt_string("http_dyn_bwlist");
     njt_kv_reg_handler_t h;
+    njt_http_dyn_bwlist_main_conf_t *bmcf;
+
     njt_memzero(&h, sizeof(njt_kv_reg_handler_t));
     h.key = &bwlist_rpc_key;
     h.rpc_get_handler = njt_dyn_bwlist_rpc_get_handler;
@@ -581,27 +1267,390 @@ static njt_int_t njt_http_dyn_bwlist_module_init_process(njt_cycle_t *cycle)
     h.api_type = NJT_KV_API_TYPE_DECLATIVE;
     njt_kv_reg_handler(&h);
 
+    if (njt_process != NJT_PROCESS_WORKER) {
+        return NJT_OK;
+    }
+
+    bmcf = njt_http_cycle_get_module_main_conf(cycle, njt_http_dyn_bwlist_module);
+    if (bmcf == NULL || bmcf->sh == NULL || !bmcf->sync || bmcf->node_name == NULL) {
+        return NJT_OK;
+    }
+
+    njt_gossip_reg_app_handler(njt_http_dyn_bwlist_ban_recv_data, njt_http_dyn_bwlist_ban_on_node_on,
+        GOSSIP_APP_DYN_BWLIST, bmcf);
+
+    return NJT_OK;
+}
+
+static njt_int_t njt_http_dyn_bwlist_init_zone(njt_shm_zone_t *shm_zone, void *data)
+{
+    njt_http_dyn_bwlist_main_conf_t *obmcf = data;
+    njt_http_dyn_bwlist_main_conf_t *bmcf;
+    size_t len;
+    njt_uint_t n;
+
+    bmcf = shm_zone->data;
+
+    if (obmcf) {
+        bmcf->sh = obmcf->sh;
+        bmcf->shpool = obmcf->shpool;
+
+        return NJT_OK;
+    }
+
+    bmcf->shpool = (njt_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        bmcf->sh = bmcf->shpool->data;
+
+        return NJT_OK;
+    }
+
+    bmcf->sh = njt_slab_calloc(bmcf->shpool, sizeof(njt_http_dyn_bwlist_ban_shctx_t));
+    if (bmcf->sh == NULL) {
+        return NJT_ERROR;
+    }
+
+    bmcf->shpool->data = bmcf->sh;
+
+    //tips: a power of two of slots taking at most half of the zone
+    n = shm_zone->shm.size / 2 / sizeof(njt_http_dyn_bwlist_ban_slot_t);
+    while (n & (n - 1)) {
+        n &= n - 1;
+    }
+
+    bmcf->sh->slots = njt_slab_calloc(bmcf->shpool, n * sizeof(njt_http_dyn_bwlist_ban_slot_t));
+    if (bmcf->sh->slots == NULL) {
+        return NJT_ERROR;
+    }
+
+    bmcf->sh->mask = n - 1;
+
+    len = sizeof(" in dyn_bwlist_ban_zone \"\"") + shm_zone->shm.name.len;
+
+    bmcf->shpool->log_ctx = njt_slab_alloc(bmcf->shpool, len);
+    if (bmcf->shpool->log_ctx == NULL) {
+        return NJT_ERROR;
+    }
+
+    njt_sprintf(bmcf->shpool->log_ctx, " in dyn_bwlist_ban_zone \"%V\"%Z", &shm_zone->shm.name);
+
+    return NJT_OK;
+}
+
+static char *njt_http_dyn_bwlist_ban_zone(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_dyn_bwlist_main_conf_t *bmcf = conf;
+    u_char *p;
+    ssize_t size;
+    njt_str_t *value, name, s;
+    njt_uint_t i;
+    njt_shm_zone_t *shm_zone;
+    njt_mqconf_conf_t *mqconf;
+
+#if (NJT_PTR_SIZE < 8)
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "\"%V\" requires a 64 bits platform", &cmd->name);
+    return NJT_CONF_ERROR;
+#endif
+
+    if (bmcf->shm_zone) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    p = (u_char *) njt_strchr(value[1].data, ':');
+    if (p == NULL || p == value[1].data) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid zone size \"%V\"", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    name.data = value[1].data;
+    name.len = p - value[1].data;
+
+    s.data = p + 1;
+    s.len = value[1].data + value[1].len - s.data;
+
+    size = njt_parse_size(&s);
+    if (size == NJT_ERROR) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid zone size \"%V\"", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    if (size < (ssize_t) (8 * njt_pagesize)) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "zone \"%V\" is too small", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    for (i = 2; i < cf->args->nelts; i++) {
+        if (njt_strcmp(value[i].data, "sync") == 0) {
+            bmcf->sync = 1;
+            continue;
+        }
+
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid parameter \"%V\"", &value[i]);
+        return NJT_CONF_ERROR;
+    }
+
+    if (bmcf->sync) {
+        mqconf = (njt_mqconf_conf_t *) njt_get_conf(cf->cycle->conf_ctx, njt_mqconf_module);
+        if (mqconf && mqconf->cluster_name.data && mqconf->node_name.data) {
+            bmcf->node_name = &mqconf->node_name;
+
+        } else {
+            njt_conf_log_error(NJT_LOG_WARN, cf, 0,
+                "cluster_name or node_name is not set, bans of zone \"%V\" are not synced", &name);
+        }
+    }
+
+    shm_zone = njt_shared_memory_add(cf, &name, size, &njt_http_dyn_bwlist_module);
+    if (shm_zone == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    if (shm_zone->data) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "zone \"%V\" is already used", &name);
+        return NJT_CONF_ERROR;
+    }
+
+    shm_zone->init = njt_http_dyn_bwlist_init_zone;
+    shm_zone->data = bmcf;
+    bmcf->shm_zone = shm_zone;
+
+    return NJT_CONF_OK;
+}
+
+static char *njt_http_dyn_bwlist_auto_ban(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_dyn_bwlist_loc_conf_t *blcf = conf;
+    njt_str_t *value, s;
+    njt_int_t n;
+    njt_uint_t i;
+
+    if (blcf->threshold != NJT_CONF_UNSET_UINT) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (cf->args->nelts == 2 && njt_strcmp(value[1].data, "off") == 0) {
+        blcf->threshold = 0;
+        return NJT_CONF_OK;
+    }
+
+    blcf->window = 10000;
+    blcf->ban_time = 600000;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+        if (njt_strncmp(value[i].data, "threshold=", 10) == 0) {
+            n = njt_atoi(value[i].data + 10, value[i].len - 10);
+            if (n <= 0) {
+                goto invalid;
+            }
+
+            blcf->threshold = n;
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "window=", 7) == 0) {
+            s.data = value[i].data + 7;
+            s.len = value[i].len - 7;
+
+            blcf->window = njt_parse_time(&s, 0);
+            if (blcf->window == (njt_msec_t) NJT_ERROR || blcf->window == 0) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "ban=", 4) == 0) {
+            s.data = value[i].data + 4;
+            s.len = value[i].len - 4;
+
+            blcf->ban_time = njt_parse_time(&s, 0);
+            if (blcf->ban_time == (njt_msec_t) NJT_ERROR || blcf->ban_time == 0) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    if (blcf->threshold == NJT_CONF_UNSET_UINT) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "\"threshold\" must be set");
+        return NJT_CONF_ERROR;
+    }
+
+    return NJT_CONF_OK;
+
+invalid:
+
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid parameter \"%V\"", &value[i]);
+    return NJT_CONF_ERROR;
+}
+
+static void *njt_http_dyn_bwlist_create_main_conf(njt_conf_t *cf)
+{
+    njt_http_dyn_bwlist_main_conf_t *bmcf;
+
+    bmcf = njt_pcalloc(cf->pool, sizeof(njt_http_dyn_bwlist_main_conf_t));
+    if (bmcf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by njt_pcalloc():
+     *
+     *     bmcf->sh = NULL;
+     *     bmcf->shm_zone = NULL;
+     *     bmcf->sync = 0;
+     *     bmcf->node_name = NULL;
+     */
+
+    return bmcf;
+}
+
+static void *njt_http_dyn_bwlist_create_loc_conf(njt_conf_t *cf)
+{
+    njt_http_dyn_bwlist_loc_conf_t *blcf;
+
+    blcf = njt_pcalloc(cf->pool, sizeof(njt_http_dyn_bwlist_loc_conf_t));
+    if (blcf == NULL) {
+        return NULL;
+    }
+
+    blcf->ban = NJT_CONF_UNSET;
+    blcf->ban_status = NJT_CONF_UNSET_UINT;
+    blcf->threshold = NJT_CONF_UNSET_UINT;
+    blcf->window = NJT_CONF_UNSET_MSEC;
+    blcf->ban_time = NJT_CONF_UNSET_MSEC;
+
+    return blcf;
+}
+
+static char *njt_http_dyn_bwlist_merge_loc_conf(njt_conf_t *cf, void *parent, void *child)
+{
+    njt_http_dyn_bwlist_loc_conf_t *prev = parent;
+    njt_http_dyn_bwlist_loc_conf_t *conf = child;
+    njt_http_dyn_bwlist_main_conf_t *bmcf;
+
+    njt_conf_merge_value(conf->ban, prev->ban, 0);
+    njt_conf_merge_uint_value(conf->ban_status, prev->ban_status, NJT_HTTP_FORBIDDEN);
+
+    if (conf->threshold == NJT_CONF_UNSET_UINT) {
+        conf->threshold = prev->threshold;
+        conf->window = prev->window;
+        conf->ban_time = prev->ban_time;
+    }
+
+    njt_conf_merge_uint_value(conf->threshold, prev->threshold, 0);
+    njt_conf_merge_msec_value(conf->window, prev->window, 10000);
+    njt_conf_merge_msec_value(conf->ban_time, prev->ban_time, 600000);
+
+    bmcf = njt_http_conf_get_module_main_conf(cf, njt_http_dyn_bwlist_module);
+
+    if ((conf->ban || conf->threshold) && bmcf->shm_zone == NULL) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "\"dyn_bwlist_ban_zone\" must be set");
+        return NJT_CONF_ERROR;
+    }
+
+    return NJT_CONF_OK;
+}
+
+static njt_int_t njt_http_dyn_bwlist_init(njt_conf_t *cf)
+{
+    njt_http_handler_pt *h, *hs;
+    njt_http_core_main_conf_t *cmcf;
+    njt_http_dyn_bwlist_main_conf_t *bmcf;
+    njt_array_t *handlers;
+
+    bmcf = njt_http_conf_get_module_main_conf(cf, njt_http_dyn_bwlist_module);
+    if (bmcf->shm_zone == NULL) {
+        return NJT_OK;
+    }
+
+    cmcf = njt_http_conf_get_module_main_conf(cf, njt_http_core_module);
+
+    handlers = &cmcf->phases[NJT_HTTP_POST_READ_PHASE].handlers;
+
+    h = njt_array_push(handlers);
+    if (h == NULL) {
+        return NJT_ERROR;
+    }
+
+    // the handlers of a phase run from the last one, the first one sees the address set by realip
+    hs = handlers->elts;
+    njt_memmove(&hs[1], &hs[0], (handlers->nelts - 1) * sizeof(njt_http_handler_pt));
+    hs[0] = njt_http_dyn_bwlist_ban_handler;
+
+    h = njt_array_push(&cmcf->phases[NJT_HTTP_LOG_PHASE].handlers);
+    if (h == NULL) {
+        return NJT_ERROR;
+    }
+
+    *h = njt_http_dyn_bwlist_strike_handler;
+
     return NJT_OK;
 }
 
+static njt_conf_num_bounds_t njt_http_dyn_bwlist_ban_status_bounds = {
+    njt_conf_check_num_bounds, 400, 599
+};
+
+static njt_command_t njt_http_dyn_bwlist_commands[] = {
+
+    { njt_string("dyn_bwlist_ban_zone"),
+      NJT_HTTP_MAIN_CONF|NJT_CONF_TAKE12,
+      njt_http_dyn_bwlist_ban_zone,
+      NJT_HTTP_MAIN_CONF_OFFSET,
+      0,
+      NULL },
+
+    { njt_string("dyn_bwlist_ban"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_FLAG,
+      njt_conf_set_flag_slot,
+      NJT_HTTP_LOC_CONF_OFFSET,
+      offsetof(njt_http_dyn_bwlist_loc_conf_t, ban),
+      NULL },
+
+    { njt_string("dyn_bwlist_ban_status"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE1,
+      njt_conf_set_num_slot,
+      NJT_HTTP_LOC_CONF_OFFSET,
+      offsetof(njt_http_dyn_bwlist_loc_conf_t, ban_status),
+      &njt_http_dyn_bwlist_ban_status_bounds },
+
+    { njt_string("dyn_bwlist_auto_ban"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_TAKE123,
+      njt_http_dyn_bwlist_auto_ban,
+      NJT_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+      njt_null_command
+};
+
 static njt_http_module_t njt_http_dyn_bwlist_module_ctx = {
-    NULL, /* preconfiguration */
-    NULL, /* postconfiguration */
+    NULL,                                  /* preconfiguration */
+    njt_http_dyn_bwlist_init,              /* postconfiguration */
 
-    NULL, /* create main configuration */
-    NULL, /* init main configuration */
+    njt_http_dyn_bwlist_create_main_conf,  /* create main configuration */
+    NULL,                                  /* init main configuration */
 
-    NULL, /* create server configuration */
-    NULL, /* merge server configuration */
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
 
-    NULL, /* create location configuration */
-    NULL  /* merge location configuration */
+    njt_http_dyn_bwlist_create_loc_conf,   /* create location configuration */
+    njt_http_dyn_bwlist_merge_loc_conf     /* merge location configuration */
 };
 
 njt_module_t njt_http_dyn_bwlist_module = {
     NJT_MODULE_V1,
     &njt_http_dyn_bwlist_module_ctx,         /* module context */
-    NULL,                                    /* module directives */
+    njt_http_dyn_bwlist_commands,            /* module directives */
     NJT_HTTP_MODULE,                         /* module type */
     NULL,                                    /* init master */
     NULL,                                    /* init module */
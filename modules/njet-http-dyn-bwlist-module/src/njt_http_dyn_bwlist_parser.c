@@ -1200,6 +1200,90 @@ static bool parse_dynbwlist_servers(njt_pool_t *pool, parse_state_t *parse_state
 }
 
 
+static bool parse_dynbwlist_bans_item(njt_pool_t *pool, parse_state_t *parse_state, dynbwlist_bans_item_t *out, js2c_parse_error_t *err_ret) {
+    njt_uint_t i;
+
+    js2c_check_type(JSMN_OBJECT);
+    const int object_start_token = parse_state->current_token;
+    const uint64_t n = parse_state->tokens[parse_state->current_token].size;
+    parse_state->current_token += 1;
+    for (i = 0; i < n; ++i) {
+        js2c_key_children_check_for_obj();
+        if (current_string_is(parse_state, "addr")) {
+            js2c_check_field_set(out->is_addr_set);
+            parse_state->current_token += 1;
+            const char* saved_key = parse_state->current_key;
+            parse_state->current_key = "addr";
+            js2c_null_check();
+            int token_size =  CURRENT_STRING_LENGTH(parse_state) ;
+            ((&out->addr))->data = (u_char*)njt_pcalloc(pool, (size_t)(token_size + 1));
+            js2c_malloc_check(((&out->addr))->data);
+            ((&out->addr))->len = token_size;
+            if (builtin_parse_string(pool, parse_state, (&out->addr), 0, ((&out->addr))->len, err_ret)) {
+                return true;
+            }
+            out->is_addr_set = 1;
+            parse_state->current_key = saved_key;
+        } else if (current_string_is(parse_state, "ttl")) {
+            js2c_check_field_set(out->is_ttl_set);
+            parse_state->current_token += 1;
+            const char* saved_key = parse_state->current_key;
+            parse_state->current_key = "ttl";
+            js2c_null_check();
+            int64_t int_parse_tmp;
+            if (builtin_parse_signed(pool, parse_state, true, false, 10, &int_parse_tmp, err_ret)) {
+                return true;
+            }
+            js2c_int_range_check_min(0LL);
+            *(&out->ttl) = int_parse_tmp;
+            out->is_ttl_set = 1;
+            parse_state->current_key = saved_key;
+        } else {
+            LOG_ERROR_JSON_PARSE(UNKNOWN_FIELD_ERR, parse_state->current_key, CURRENT_TOKEN(parse_state).start, "Unknown field in '%s': %.*s", parse_state->current_key, CURRENT_STRING_FOR_ERROR(parse_state));
+            return true;
+        }
+    }
+    const int saved_current_token = parse_state->current_token;
+    parse_state->current_token = object_start_token;
+    // set default
+    if (!out->is_addr_set) {
+        size_t token_size = strlen("");
+        (out->addr).data = (u_char*)njt_pcalloc(pool, token_size + 1);
+        js2c_malloc_check((out->addr).data);
+        (out->addr).len = token_size;
+        if (out->addr.len == 0) {
+            (out->addr).data[0] = 0;
+        }
+        if (token_size > 0) {
+            njt_memcpy(out->addr.data, "", token_size);
+        }
+    }
+    // set default
+    if (!out->is_ttl_set) {
+        out->ttl = 0LL;
+    }
+    parse_state->current_token = saved_current_token;
+    return false;
+}
+
+
+static bool parse_dynbwlist_bans(njt_pool_t *pool, parse_state_t *parse_state, dynbwlist_bans_t *out, js2c_parse_error_t *err_ret) {
+    int i;
+    js2c_check_type(JSMN_ARRAY);
+    const int n = parse_state->tokens[parse_state->current_token].size;
+    parse_state->current_token += 1;
+    for (i = 0; i < n; ++i) {
+        ((dynbwlist_bans_item_t**)out->elts)[i] = njt_pcalloc(pool, sizeof(dynbwlist_bans_item_t));
+        memset(((dynbwlist_bans_item_t**)out->elts)[i], 0, sizeof(dynbwlist_bans_item_t));
+        if (parse_dynbwlist_bans_item(pool, parse_state, ((dynbwlist_bans_item_t**)out->elts)[i], err_ret)) {
+            return true;
+        }
+        out->nelts ++;
+    }
+    return false;
+}
+
+
 static bool parse_dynbwlist(njt_pool_t *pool, parse_state_t *parse_state, dynbwlist_t *out, js2c_parse_error_t *err_ret) {
     njt_uint_t i;
 
@@ -1222,6 +1306,19 @@ static bool parse_dynbwlist(njt_pool_t *pool, parse_state_t *parse_state, dynbwl
             }
             out->is_servers_set = 1;
             parse_state->current_key = saved_key;
+        } else if (current_string_is(parse_state, "bans")) {
+            js2c_check_field_set(out->is_bans_set);
+            parse_state->current_token += 1;
+            const char* saved_key = parse_state->current_key;
+            parse_state->current_key = "bans";
+            out->bans = njt_array_create(pool, parse_state->tokens[parse_state->current_token].size ,sizeof(dynbwlist_bans_item_t*));
+            js2c_malloc_check(out->bans);
+
+            if (parse_dynbwlist_bans(pool, parse_state, (out->bans), err_ret)) {
+                return true;
+            }
+            out->is_bans_set = 1;
+            parse_state->current_key = saved_key;
         } else {
             LOG_ERROR_JSON_PARSE(UNKNOWN_FIELD_ERR, parse_state->current_key, CURRENT_TOKEN(parse_state).start, "Unknown field in '%s': %.*s", parse_state->current_key, CURRENT_STRING_FOR_ERROR(parse_state));
             return true;
@@ -1385,6 +1482,72 @@ static void get_json_length_dynbwlist_servers(njt_pool_t *pool, dynbwlist_server
     }
 }
 
+static void get_json_length_dynbwlist_bans_item_addr(njt_pool_t *pool, dynbwlist_bans_item_addr_t *out, size_t *length, njt_int_t flags) {
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    *length += dst->len + 2; //  "str" 
+}
+
+static void get_json_length_dynbwlist_bans_item_ttl(njt_pool_t *pool, dynbwlist_bans_item_ttl_t *out, size_t *length, njt_int_t flags) {
+    u_char str[24];
+    u_char *cur;
+    cur = njt_sprintf(str, "%L", *out);
+    *length += cur - str;
+}
+
+static void get_json_length_dynbwlist_bans_item(njt_pool_t *pool, dynbwlist_bans_item_t *out, size_t *length, njt_int_t flags) {
+    if (out == NULL) {
+        *length += 4; // null
+        return;
+    }
+    *length += 1;
+    njt_int_t omit;
+    njt_int_t count = 0;
+    omit = 0;
+    omit = out->is_addr_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->addr.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        *length += (4 + 3); // "addr": 
+        get_json_length_dynbwlist_bans_item_addr(pool, (&out->addr), length, flags);
+        *length += 1; // ","
+        count++;
+    }
+    omit = 0;
+    omit = out->is_ttl_set ? 0 : 1;
+    if (omit == 0) {
+        *length += (3 + 3); // "ttl": 
+        get_json_length_dynbwlist_bans_item_ttl(pool, (&out->ttl), length, flags);
+        *length += 1; // ","
+        count++;
+    }
+    if (count != 0) {
+        *length -= 1; // "\b"
+    }
+    *length += 1;
+}
+
+static void get_json_length_dynbwlist_bans(njt_pool_t *pool, dynbwlist_bans_t *out, size_t *length, njt_int_t flags) {
+    njt_uint_t i;
+    njt_uint_t omit;
+    njt_int_t count = 0;
+    if (out == NULL) {
+        *length += 2; // "[]"
+        return;
+    }
+    *length += 2; // "[]"
+    for (i = 0; i < out->nelts; ++i) {
+        omit = 0;
+        omit = ((flags & OMIT_NULL_OBJ) && ((dynbwlist_bans_item_t**)out->elts)[i] == NULL) ? 1 : 0;
+        if (omit == 0) {
+            get_json_length_dynbwlist_bans_item(pool, ((dynbwlist_bans_item_t**)out->elts)[i], length, flags);
+            *length += 1; // ","
+            count++; // ","
+        }
+    }
+    if (count != 0) {
+        *length -= 1; // "\b"
+    }
+}
+
 static void get_json_length_dynbwlist(njt_pool_t *pool, dynbwlist_t *out, size_t *length, njt_int_t flags) {
     if (out == NULL) {
         *length += 4; // null
@@ -1402,6 +1565,15 @@ static void get_json_length_dynbwlist(njt_pool_t *pool, dynbwlist_t *out, size_t
         *length += 1; // ","
         count++;
     }
+    omit = 0;
+    omit = out->is_bans_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_ARRAY) && (out->bans) == NULL ? 1 : omit;
+    if (omit == 0) {
+        *length += (4 + 3); // "bans": 
+        get_json_length_dynbwlist_bans(pool, (out->bans), length, flags);
+        *length += 1; // ","
+        count++;
+    }
     if (count != 0) {
         *length -= 1; // "\b"
     }
@@ -1436,9 +1608,25 @@ dynbwlist_servers_item_t* get_dynbwlist_servers_item(dynbwlist_servers_t *out, s
 
 }
 
+dynbwlist_bans_item_addr_t* get_dynbwlist_bans_item_addr(dynbwlist_bans_item_t *out) {
+    return &out->addr;
+}
+
+dynbwlist_bans_item_ttl_t get_dynbwlist_bans_item_ttl(dynbwlist_bans_item_t *out) {
+    return out->ttl;
+}
+
+dynbwlist_bans_item_t* get_dynbwlist_bans_item(dynbwlist_bans_t *out, size_t idx) {
+    return ((dynbwlist_bans_item_t**)out->elts)[idx];
+
+}
+
 dynbwlist_servers_t* get_dynbwlist_servers(dynbwlist_t *out) {
     return out->servers;
 }
+dynbwlist_bans_t* get_dynbwlist_bans(dynbwlist_t *out) {
+    return out->bans;
+}
 int add_item_dynbwlist_servers_item_listens(dynbwlist_servers_item_listens_t *src, dynbwlist_servers_item_listens_item_t* item) {
     void *new = njt_array_push(src);
     if (new == NULL) {
@@ -1507,6 +1695,37 @@ void set_dynbwlist_servers(dynbwlist_t* obj, dynbwlist_servers_t* field) {
     obj->servers = field;
     obj->is_servers_set = 1;
 }
+void set_dynbwlist_bans_item_addr(dynbwlist_bans_item_t* obj, dynbwlist_bans_item_addr_t* field) {
+    njt_memcpy(&obj->addr, field, sizeof(njt_str_t));
+    obj->is_addr_set = 1;
+}
+
+void set_dynbwlist_bans_item_ttl(dynbwlist_bans_item_t* obj, dynbwlist_bans_item_ttl_t field) {
+    obj->ttl = field;
+    obj->is_ttl_set = 1;
+}
+
+dynbwlist_bans_item_t* create_dynbwlist_bans_item(njt_pool_t *pool) {
+    dynbwlist_bans_item_t* out = njt_pcalloc(pool, sizeof(dynbwlist_bans_item_t));
+    return out;
+}
+
+int add_item_dynbwlist_bans(dynbwlist_bans_t *src, dynbwlist_bans_item_t* item) {
+    void *new = njt_array_push(src);
+    if (new == NULL) {
+        return NJT_ERROR;
+    }
+    njt_memcpy(new, &item, src->size);
+    return NJT_OK;
+}
+
+dynbwlist_bans_t* create_dynbwlist_bans(njt_pool_t *pool, size_t nelts) {
+    return njt_array_create(pool, nelts, sizeof(dynbwlist_bans_item_t*));
+}
+void set_dynbwlist_bans(dynbwlist_t* obj, dynbwlist_bans_t* field) {
+    obj->bans = field;
+    obj->is_bans_set = 1;
+}
 dynbwlist_t* create_dynbwlist(njt_pool_t *pool) {
     dynbwlist_t* out = njt_pcalloc(pool, sizeof(dynbwlist_t));
     return out;
@@ -1708,6 +1927,91 @@ static void to_oneline_json_dynbwlist_servers(njt_pool_t *pool, dynbwlist_server
     buf->len ++;
 }
 
+static void to_oneline_json_dynbwlist_bans_item_addr(njt_pool_t *pool, dynbwlist_bans_item_addr_t *out, njt_str_t *buf, njt_int_t flags) {
+    u_char* cur = buf->data + buf->len;
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    cur = njt_sprintf(cur, "\"%V\"", dst);
+    buf->len = cur - buf->data;
+}
+
+static void to_oneline_json_dynbwlist_bans_item_ttl(njt_pool_t *pool, dynbwlist_bans_item_ttl_t *out, njt_str_t* buf, njt_int_t flags) {
+    u_char* cur = buf->data + buf->len;
+    cur = njt_sprintf(cur, "%L", *out);
+    buf->len = cur - buf->data;
+}
+
+static void to_oneline_json_dynbwlist_bans_item(njt_pool_t *pool, dynbwlist_bans_item_t *out, njt_str_t* buf, njt_int_t flags) {
+    njt_int_t omit;
+    u_char* cur = buf->data + buf->len;
+    if (out == NULL) {
+        cur = njt_sprintf(cur, "null");
+        buf->len += 4;
+        return;
+    }
+    cur = njt_sprintf(cur, "{");
+    buf->len ++;
+    omit = 0;
+    omit = out->is_addr_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->addr.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        cur = njt_sprintf(cur, "\"addr\":");
+        buf->len = cur - buf->data;
+        to_oneline_json_dynbwlist_bans_item_addr(pool, (&out->addr), buf, flags);
+        cur = buf->data + buf->len;
+        cur = njt_sprintf(cur, ",");
+        buf->len ++;
+    }
+    omit = 0;
+    omit = out->is_ttl_set ? 0 : 1;
+    if (omit == 0) {
+        cur = njt_sprintf(cur, "\"ttl\":");
+        buf->len = cur - buf->data;
+        to_oneline_json_dynbwlist_bans_item_ttl(pool, (&out->ttl), buf, flags);
+        cur = buf->data + buf->len;
+        cur = njt_sprintf(cur, ",");
+        buf->len ++;
+    }
+    cur--;
+    if (cur[0] == ',') {
+        buf->len --;
+    } else {
+        cur ++;
+    }
+    cur = njt_sprintf(cur, "}");
+    buf->len ++;
+}
+
+static void to_oneline_json_dynbwlist_bans(njt_pool_t *pool, dynbwlist_bans_t *out, njt_str_t* buf, njt_int_t flags) {
+    njt_int_t omit;
+    u_char *cur = buf->data + buf->len;
+    njt_uint_t i;
+    if (out == NULL || out->nelts == 0) {
+        cur = njt_sprintf(cur, "[]");
+        buf->len += 2;
+        return;
+    }
+    cur = njt_sprintf(cur,  "[");
+    buf->len ++;
+    for (i = 0; i < out->nelts; ++i) {
+        omit = 0;
+        omit = ((flags & OMIT_NULL_OBJ) && ((dynbwlist_bans_item_t**)out->elts)[i] == NULL) ? 1 : 0;
+        if (omit == 0) {
+            to_oneline_json_dynbwlist_bans_item(pool, ((dynbwlist_bans_item_t**)out->elts)[i], buf, flags);
+            cur = buf->data + buf->len;
+            cur = njt_sprintf(cur, ",");
+            buf->len ++;
+        }
+    }
+    cur--;
+    if (cur[0] == ',') {
+        buf->len --;
+    } else {
+        cur ++;
+    }
+    cur = njt_sprintf(cur,  "]");
+    buf->len ++;
+}
+
 static void to_oneline_json_dynbwlist(njt_pool_t *pool, dynbwlist_t *out, njt_str_t* buf, njt_int_t flags) {
     njt_int_t omit;
     u_char* cur = buf->data + buf->len;
@@ -1729,6 +2033,17 @@ static void to_oneline_json_dynbwlist(njt_pool_t *pool, dynbwlist_t *out, njt_st
         cur = njt_sprintf(cur, ",");
         buf->len ++;
     }
+    omit = 0;
+    omit = out->is_bans_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_ARRAY) && (out->bans) == NULL ? 1 : omit;
+    if (omit == 0) {
+        cur = njt_sprintf(cur, "\"bans\":");
+        buf->len = cur - buf->data;
+        to_oneline_json_dynbwlist_bans(pool, (out->bans), buf, flags);
+        cur = buf->data + buf->len;
+        cur = njt_sprintf(cur, ",");
+        buf->len ++;
+    }
     cur--;
     if (cur[0] == ',') {
         buf->len --;
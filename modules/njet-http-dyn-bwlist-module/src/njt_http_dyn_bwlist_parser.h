@@ -120,9 +120,22 @@ typedef struct dynbwlist_servers_item_t_s {
 } dynbwlist_servers_item_t;
 
 typedef njt_array_t  dynbwlist_servers_t;
+typedef njt_str_t dynbwlist_bans_item_addr_t;
+
+typedef int64_t dynbwlist_bans_item_ttl_t;
+typedef struct dynbwlist_bans_item_t_s {
+    dynbwlist_bans_item_addr_t addr;
+    dynbwlist_bans_item_ttl_t ttl;
+    unsigned int is_addr_set:1;
+    unsigned int is_ttl_set:1;
+} dynbwlist_bans_item_t;
+
+typedef njt_array_t  dynbwlist_bans_t;
 typedef struct dynbwlist_t_s {
     dynbwlist_servers_t *servers;
+    dynbwlist_bans_t *bans;
     unsigned int is_servers_set:1;
+    unsigned int is_bans_set:1;
 } dynbwlist_t;
 
 dynbwlist_servers_item_listens_item_t* get_dynbwlist_servers_item_listens_item(dynbwlist_servers_item_listens_t *out, size_t idx);
@@ -137,6 +150,11 @@ dynbwlist_servers_item_locations_t* get_dynbwlist_servers_item_locations(dynbwli
 dynbwlist_servers_item_t* get_dynbwlist_servers_item(dynbwlist_servers_t *out, size_t idx);
 // CHECK ARRAY not exceeding bounds before calling this func
 dynbwlist_servers_t* get_dynbwlist_servers(dynbwlist_t *out);
+dynbwlist_bans_item_addr_t* get_dynbwlist_bans_item_addr(dynbwlist_bans_item_t *out);
+dynbwlist_bans_item_ttl_t get_dynbwlist_bans_item_ttl(dynbwlist_bans_item_t *out);
+dynbwlist_bans_item_t* get_dynbwlist_bans_item(dynbwlist_bans_t *out, size_t idx);
+// CHECK ARRAY not exceeding bounds before calling this func
+dynbwlist_bans_t* get_dynbwlist_bans(dynbwlist_t *out);
 int add_item_dynbwlist_servers_item_listens(dynbwlist_servers_item_listens_t *src, dynbwlist_servers_item_listens_item_t* items);
 dynbwlist_servers_item_listens_t* create_dynbwlist_servers_item_listens(njt_pool_t *pool, size_t nelts);
 void set_dynbwlist_servers_item_listens(dynbwlist_servers_item_t* obj, dynbwlist_servers_item_listens_t* field);
@@ -150,6 +168,12 @@ dynbwlist_servers_item_t* create_dynbwlist_servers_item(njt_pool_t *pool);
 int add_item_dynbwlist_servers(dynbwlist_servers_t *src, dynbwlist_servers_item_t* items);
 dynbwlist_servers_t* create_dynbwlist_servers(njt_pool_t *pool, size_t nelts);
 void set_dynbwlist_servers(dynbwlist_t* obj, dynbwlist_servers_t* field);
+void set_dynbwlist_bans_item_addr(dynbwlist_bans_item_t* obj, dynbwlist_bans_item_addr_t* field);
+void set_dynbwlist_bans_item_ttl(dynbwlist_bans_item_t* obj, dynbwlist_bans_item_ttl_t field);
+dynbwlist_bans_item_t* create_dynbwlist_bans_item(njt_pool_t *pool);
+int add_item_dynbwlist_bans(dynbwlist_bans_t *src, dynbwlist_bans_item_t* items);
+dynbwlist_bans_t* create_dynbwlist_bans(njt_pool_t *pool, size_t nelts);
+void set_dynbwlist_bans(dynbwlist_t* obj, dynbwlist_bans_t* field);
 dynbwlist_t* create_dynbwlist(njt_pool_t *pool);
 dynbwlist_t* json_parse_dynbwlist(njt_pool_t *pool, const njt_str_t *json_string, js2c_parse_error_t *err_ret);
 njt_str_t* to_json_dynbwlist(njt_pool_t *pool, dynbwlist_t *out, njt_int_t flags);
@@ -9,6 +9,7 @@
 #include <njt_http_dyn_module.h>
 
 #include "njt_http_dyn_limit_parser.h"
+#include "njt_http_cluster_quota_module.h"
 #include <njt_rpc_result_util.h>
 
 extern njt_module_t njt_http_limit_conn_module;
@@ -1733,6 +1734,160 @@ static void njt_dyn_limit_dump_locs_json(njt_pool_t *pool,
     }
 }
 
+static njt_http_cluster_quota_main_conf_t *njt_dyn_limit_get_quota_conf(njt_cycle_t *cycle)
+{
+    njt_uint_t                      i;
+
+    //tips: the quota module is optional, so it is looked up by name
+    for (i = 0; cycle->modules[i]; i++) {
+        if (njt_strcmp(cycle->modules[i]->name, "njt_http_cluster_quota_module") != 0) {
+            continue;
+        }
+
+        return njt_http_cycle_get_module_main_conf(cycle, (*cycle->modules[i]));
+    }
+
+    return NULL;
+}
+
+static njt_int_t njt_dyn_limit_dump_quotas(njt_cycle_t *cycle, njt_pool_t *pool, dyn_limit_t *dynjson_obj)
+{
+    njt_uint_t                              i, j;
+    njt_http_cluster_quota_ctx_t          **ctxes;
+    njt_http_cluster_quota_rule_t         **rules;
+    njt_http_cluster_quota_main_conf_t     *qmcf;
+    dyn_limit_quotas_item_t                *quota_item;
+
+    qmcf = njt_dyn_limit_get_quota_conf(cycle);
+    if(qmcf == NULL || qmcf->zones.nelts == 0){
+        return NJT_OK;
+    }
+
+    set_dyn_limit_quotas(dynjson_obj, create_dyn_limit_quotas(pool, 4));
+    if(dynjson_obj->quotas == NULL){
+        return NJT_ERROR;
+    }
+
+    ctxes = qmcf->zones.elts;
+    for(i = 0; i < qmcf->zones.nelts; ++i){
+        rules = ctxes[i]->rules->rules.elts;
+
+        //tips: a zone without rules is dumped as a bare zone item, which clears it on put
+        for(j = 0; j < ctxes[i]->rules->rules.nelts || j == 0; ++j){
+            quota_item = create_dyn_limit_quotas_item(pool);
+            if(quota_item == NULL){
+                return NJT_ERROR;
+            }
+
+            set_dyn_limit_quotas_item_zone(quota_item, &ctxes[i]->zone_name);
+
+            if(j < ctxes[i]->rules->rules.nelts){
+                set_dyn_limit_quotas_item_scope(quota_item, &rules[j]->scope);
+                set_dyn_limit_quotas_item_match(quota_item, &rules[j]->sn.str);
+                if(rules[j]->requests.len > 0){
+                    set_dyn_limit_quotas_item_requests(quota_item, &rules[j]->requests);
+                }
+                if(rules[j]->bytes.len > 0){
+                    set_dyn_limit_quotas_item_bytes(quota_item, &rules[j]->bytes);
+                }
+            }
+
+            add_item_dyn_limit_quotas(dynjson_obj->quotas, quota_item);
+        }
+    }
+
+    return NJT_OK;
+}
+
+static void njt_dyn_limit_update_quotas(njt_cycle_t *cycle, njt_pool_t *pool, dyn_limit_quotas_t *quotas,
+                njt_rpc_result_t *rpc_result)
+{
+    njt_uint_t                              i, j, n;
+    njt_http_cluster_quota_ctx_t          **ctxes, *ctx;
+    njt_http_cluster_quota_main_conf_t     *qmcf;
+    njt_http_cluster_quota_rule_spec_t     *specs;
+    dyn_limit_quotas_item_t                *item, *other;
+    u_char                                  data_buf[1024];
+    u_char                                 *end;
+    njt_str_t                               rpc_data_str;
+
+    rpc_data_str.data = data_buf;
+    rpc_data_str.len = 0;
+
+    qmcf = njt_dyn_limit_get_quota_conf(cycle);
+    if(qmcf == NULL){
+        end = njt_snprintf(data_buf, sizeof(data_buf) - 1,
+            " update quotas error, cluster quota module is not loaded");
+        rpc_data_str.len = end - data_buf;
+        njt_rpc_result_add_error_data(rpc_result, &rpc_data_str);
+        return;
+    }
+
+    specs = njt_pcalloc(pool, quotas->nelts * sizeof(njt_http_cluster_quota_rule_spec_t));
+    if(specs == NULL){
+        return;
+    }
+
+    //tips: the rules of every zone in the request replace the current rules of that zone
+    for(i = 0; i < quotas->nelts; ++i){
+        item = get_dyn_limit_quotas_item(quotas, i);
+        if(item == NULL){
+            continue;
+        }
+
+        for(j = 0; j < i; ++j){
+            other = get_dyn_limit_quotas_item(quotas, j);
+            if(other != NULL && other->zone.len == item->zone.len
+                && njt_strncmp(other->zone.data, item->zone.data, item->zone.len) == 0){
+                break;
+            }
+        }
+
+        if(j < i){
+            continue;
+        }
+
+        ctx = NULL;
+        ctxes = qmcf->zones.elts;
+        for(j = 0; j < qmcf->zones.nelts; ++j){
+            if(ctxes[j]->zone_name.len == item->zone.len
+                && njt_strncmp(ctxes[j]->zone_name.data, item->zone.data, item->zone.len) == 0){
+                ctx = ctxes[j];
+                break;
+            }
+        }
+
+        if(ctx == NULL){
+            end = njt_snprintf(data_buf, sizeof(data_buf) - 1,
+                " update quotas error, zone:%V is not exist", &item->zone);
+            rpc_data_str.len = end - data_buf;
+            njt_rpc_result_add_error_data(rpc_result, &rpc_data_str);
+            continue;
+        }
+
+        n = 0;
+        for(j = i; j < quotas->nelts; ++j){
+            other = get_dyn_limit_quotas_item(quotas, j);
+            if(other == NULL || other->scope.len == 0 || other->zone.len != item->zone.len
+                || njt_strncmp(other->zone.data, item->zone.data, item->zone.len) != 0){
+                continue;
+            }
+
+            specs[n].scope = other->scope;
+            specs[n].match = other->match;
+            specs[n].requests = other->requests;
+            specs[n].bytes = other->bytes;
+            n++;
+        }
+
+        rpc_data_str.len = sizeof(data_buf) - 1;
+        if(qmcf->update(ctx, specs, n, &rpc_data_str) != NJT_OK){
+            njt_log_error(NJT_LOG_INFO, pool->log, 0, "update quotas error, %V", &rpc_data_str);
+            njt_rpc_result_add_error_data(rpc_result, &rpc_data_str);
+        }
+    }
+}
+
 static njt_str_t *njt_dyn_limit_dump_limit_conf(njt_cycle_t *cycle, njt_pool_t *pool)
 {
     njt_http_core_loc_conf_t        *clcf;
@@ -1854,6 +2009,10 @@ static njt_str_t *njt_dyn_limit_dump_limit_conf(njt_cycle_t *cycle, njt_pool_t *
         add_item_dyn_limit_limit_rps(dynjson_obj.limit_rps, rps_item);
     }
 
+    if(njt_dyn_limit_dump_quotas(cycle, pool, &dynjson_obj) != NJT_OK){
+        goto err;
+    }
+
     return to_json_dyn_limit(pool, &dynjson_obj, OMIT_NULL_ARRAY | OMIT_NULL_OBJ | OMIT_NULL_STR);
 
 err:
@@ -1909,6 +2068,12 @@ static njt_int_t njt_dyn_limit_update_limit_conf(njt_pool_t *pool, dyn_limit_t *
         }
     }
 
+    //update quotas
+    if(api_data->is_quotas_set && api_data->quotas != NULL && api_data->quotas->nelts > 0){
+        njt_str_null(&rpc_result->conf_path);
+        njt_dyn_limit_update_quotas(cycle, pool, api_data->quotas, rpc_result);
+    }
+
     if(api_data->is_servers_set && api_data->servers != NULL){
         for (i = 0; i < api_data->servers->nelts; ++i)
         {
@@ -2018,6 +2018,184 @@ static bool parse_dyn_limit_limit_rps(njt_pool_t *pool, parse_state_t *parse_sta
 }
 
 
+static bool parse_dyn_limit_quotas_item(njt_pool_t *pool, parse_state_t *parse_state, dyn_limit_quotas_item_t *out, js2c_parse_error_t *err_ret) {
+    njt_uint_t i;
+
+    js2c_check_type(JSMN_OBJECT);
+    const int object_start_token = parse_state->current_token;
+    const uint64_t n = parse_state->tokens[parse_state->current_token].size;
+    parse_state->current_token += 1;
+    for (i = 0; i < n; ++i) {
+        js2c_key_children_check_for_obj();
+        if (current_string_is(parse_state, "zone")) {
+            js2c_check_field_set(out->is_zone_set);
+            parse_state->current_token += 1;
+            const char* saved_key = parse_state->current_key;
+            parse_state->current_key = "zone";
+            js2c_null_check();
+            int token_size =  CURRENT_STRING_LENGTH(parse_state) ;
+            ((&out->zone))->data = (u_char*)njt_pcalloc(pool, (size_t)(token_size + 1));
+            js2c_malloc_check(((&out->zone))->data);
+            ((&out->zone))->len = token_size;
+            if (builtin_parse_string(pool, parse_state, (&out->zone), 0, ((&out->zone))->len, err_ret)) {
+                return true;
+            }
+            out->is_zone_set = 1;
+            parse_state->current_key = saved_key;
+        } else if (current_string_is(parse_state, "scope")) {
+            js2c_check_field_set(out->is_scope_set);
+            parse_state->current_token += 1;
+            const char* saved_key = parse_state->current_key;
+            parse_state->current_key = "scope";
+            js2c_null_check();
+            int token_size =  CURRENT_STRING_LENGTH(parse_state) ;
+            ((&out->scope))->data = (u_char*)njt_pcalloc(pool, (size_t)(token_size + 1));
+            js2c_malloc_check(((&out->scope))->data);
+            ((&out->scope))->len = token_size;
+            if (builtin_parse_string(pool, parse_state, (&out->scope), 0, ((&out->scope))->len, err_ret)) {
+                return true;
+            }
+            out->is_scope_set = 1;
+            parse_state->current_key = saved_key;
+        } else if (current_string_is(parse_state, "match")) {
+            js2c_check_field_set(out->is_match_set);
+            parse_state->current_token += 1;
+            const char* saved_key = parse_state->current_key;
+            parse_state->current_key = "match";
+            js2c_null_check();
+            int token_size =  CURRENT_STRING_LENGTH(parse_state) ;
+            ((&out->match))->data = (u_char*)njt_pcalloc(pool, (size_t)(token_size + 1));
+            js2c_malloc_check(((&out->match))->data);
+            ((&out->match))->len = token_size;
+            if (builtin_parse_string(pool, parse_state, (&out->match), 0, ((&out->match))->len, err_ret)) {
+                return true;
+            }
+            out->is_match_set = 1;
+            parse_state->current_key = saved_key;
+        } else if (current_string_is(parse_state, "requests")) {
+            js2c_check_field_set(out->is_requests_set);
+            parse_state->current_token += 1;
+            const char* saved_key = parse_state->current_key;
+            parse_state->current_key = "requests";
+            js2c_null_check();
+            int token_size =  CURRENT_STRING_LENGTH(parse_state) ;
+            ((&out->requests))->data = (u_char*)njt_pcalloc(pool, (size_t)(token_size + 1));
+            js2c_malloc_check(((&out->requests))->data);
+            ((&out->requests))->len = token_size;
+            if (builtin_parse_string(pool, parse_state, (&out->requests), 0, ((&out->requests))->len, err_ret)) {
+                return true;
+            }
+            out->is_requests_set = 1;
+            parse_state->current_key = saved_key;
+        } else if (current_string_is(parse_state, "bytes")) {
+            js2c_check_field_set(out->is_bytes_set);
+            parse_state->current_token += 1;
+            const char* saved_key = parse_state->current_key;
+            parse_state->current_key = "bytes";
+            js2c_null_check();
+            int token_size =  CURRENT_STRING_LENGTH(parse_state) ;
+            ((&out->bytes))->data = (u_char*)njt_pcalloc(pool, (size_t)(token_size + 1));
+            js2c_malloc_check(((&out->bytes))->data);
+            ((&out->bytes))->len = token_size;
+            if (builtin_parse_string(pool, parse_state, (&out->bytes), 0, ((&out->bytes))->len, err_ret)) {
+                return true;
+            }
+            out->is_bytes_set = 1;
+            parse_state->current_key = saved_key;
+        } else {
+            LOG_ERROR_JSON_PARSE(UNKNOWN_FIELD_ERR, parse_state->current_key, CURRENT_TOKEN(parse_state).start, "Unknown field in '%s': %.*s", parse_state->current_key, CURRENT_STRING_FOR_ERROR(parse_state));
+            return true;
+        }
+    }
+    const int saved_current_token = parse_state->current_token;
+    parse_state->current_token = object_start_token;
+    // set default
+    if (!out->is_zone_set) {
+        size_t token_size = strlen("");
+        (out->zone).data = (u_char*)njt_pcalloc(pool, token_size + 1);
+        js2c_malloc_check((out->zone).data);
+        (out->zone).len = token_size;
+        if (out->zone.len == 0) {
+            (out->zone).data[0] = 0;
+        }
+        if (token_size > 0) {
+            njt_memcpy(out->zone.data, "", token_size);
+        }
+    }
+    // set default
+    if (!out->is_scope_set) {
+        size_t token_size = strlen("");
+        (out->scope).data = (u_char*)njt_pcalloc(pool, token_size + 1);
+        js2c_malloc_check((out->scope).data);
+        (out->scope).len = token_size;
+        if (out->scope.len == 0) {
+            (out->scope).data[0] = 0;
+        }
+        if (token_size > 0) {
+            njt_memcpy(out->scope.data, "", token_size);
+        }
+    }
+    // set default
+    if (!out->is_match_set) {
+        size_t token_size = strlen("");
+        (out->match).data = (u_char*)njt_pcalloc(pool, token_size + 1);
+        js2c_malloc_check((out->match).data);
+        (out->match).len = token_size;
+        if (out->match.len == 0) {
+            (out->match).data[0] = 0;
+        }
+        if (token_size > 0) {
+            njt_memcpy(out->match.data, "", token_size);
+        }
+    }
+    // set default
+    if (!out->is_requests_set) {
+        size_t token_size = strlen("");
+        (out->requests).data = (u_char*)njt_pcalloc(pool, token_size + 1);
+        js2c_malloc_check((out->requests).data);
+        (out->requests).len = token_size;
+        if (out->requests.len == 0) {
+            (out->requests).data[0] = 0;
+        }
+        if (token_size > 0) {
+            njt_memcpy(out->requests.data, "", token_size);
+        }
+    }
+    // set default
+    if (!out->is_bytes_set) {
+        size_t token_size = strlen("");
+        (out->bytes).data = (u_char*)njt_pcalloc(pool, token_size + 1);
+        js2c_malloc_check((out->bytes).data);
+        (out->bytes).len = token_size;
+        if (out->bytes.len == 0) {
+            (out->bytes).data[0] = 0;
+        }
+        if (token_size > 0) {
+            njt_memcpy(out->bytes.data, "", token_size);
+        }
+    }
+    parse_state->current_token = saved_current_token;
+    return false;
+}
+
+
+static bool parse_dyn_limit_quotas(njt_pool_t *pool, parse_state_t *parse_state, dyn_limit_quotas_t *out, js2c_parse_error_t *err_ret) {
+    int i;
+    js2c_check_type(JSMN_ARRAY);
+    const int n = parse_state->tokens[parse_state->current_token].size;
+    parse_state->current_token += 1;
+    for (i = 0; i < n; ++i) {
+        ((dyn_limit_quotas_item_t**)out->elts)[i] = njt_pcalloc(pool, sizeof(dyn_limit_quotas_item_t));
+        memset(((dyn_limit_quotas_item_t**)out->elts)[i], 0, sizeof(dyn_limit_quotas_item_t));
+        if (parse_dyn_limit_quotas_item(pool, parse_state, ((dyn_limit_quotas_item_t**)out->elts)[i], err_ret)) {
+            return true;
+        }
+        out->nelts ++;
+    }
+    return false;
+}
+
+
 static bool parse_dyn_limit(njt_pool_t *pool, parse_state_t *parse_state, dyn_limit_t *out, js2c_parse_error_t *err_ret) {
     njt_uint_t i;
 
@@ -2054,6 +2232,20 @@ static bool parse_dyn_limit(njt_pool_t *pool, parse_state_t *parse_state, dyn_li
             }
             out->is_limit_rps_set = 1;
             parse_state->current_key = saved_key;
+        } else if (current_string_is(parse_state, "quotas")) {
+            js2c_check_field_set(out->is_quotas_set);
+            parse_state->current_token += 1;
+            const char* saved_key = parse_state->current_key;
+            parse_state->current_key = "quotas";
+            js2c_null_check();
+            out->quotas = njt_array_create(pool, parse_state->tokens[parse_state->current_token].size ,sizeof(dyn_limit_quotas_item_t*));
+            js2c_malloc_check(out->quotas);
+
+            if (parse_dyn_limit_quotas(pool, parse_state, (out->quotas), err_ret)) {
+                return true;
+            }
+            out->is_quotas_set = 1;
+            parse_state->current_key = saved_key;
         } else {
             LOG_ERROR_JSON_PARSE(UNKNOWN_FIELD_ERR, parse_state->current_key, CURRENT_TOKEN(parse_state).start, "Unknown field in '%s': %.*s", parse_state->current_key, CURRENT_STRING_FOR_ERROR(parse_state));
             return true;
@@ -2069,6 +2261,10 @@ static bool parse_dyn_limit(njt_pool_t *pool, parse_state_t *parse_state, dyn_li
     if (!out->is_limit_rps_set) {
         out->limit_rps = njt_pcalloc(pool, sizeof(njt_array_t));
     }
+    // set default
+    if (!out->is_quotas_set) {
+        out->quotas = njt_pcalloc(pool, sizeof(njt_array_t));
+    }
     parse_state->current_token = saved_current_token;
     return false;
 }
@@ -2286,6 +2482,113 @@ static void get_json_length_dyn_limit_limit_rps(njt_pool_t *pool, dyn_limit_limi
     }
 }
 
+static void get_json_length_dyn_limit_quotas_item_zone(njt_pool_t *pool, dyn_limit_quotas_item_zone_t *out, size_t *length, njt_int_t flags) {
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    *length += dst->len + 2; //  "str" 
+}
+
+static void get_json_length_dyn_limit_quotas_item_scope(njt_pool_t *pool, dyn_limit_quotas_item_scope_t *out, size_t *length, njt_int_t flags) {
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    *length += dst->len + 2; //  "str" 
+}
+
+static void get_json_length_dyn_limit_quotas_item_match(njt_pool_t *pool, dyn_limit_quotas_item_match_t *out, size_t *length, njt_int_t flags) {
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    *length += dst->len + 2; //  "str" 
+}
+
+static void get_json_length_dyn_limit_quotas_item_requests(njt_pool_t *pool, dyn_limit_quotas_item_requests_t *out, size_t *length, njt_int_t flags) {
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    *length += dst->len + 2; //  "str" 
+}
+
+static void get_json_length_dyn_limit_quotas_item_bytes(njt_pool_t *pool, dyn_limit_quotas_item_bytes_t *out, size_t *length, njt_int_t flags) {
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    *length += dst->len + 2; //  "str" 
+}
+
+static void get_json_length_dyn_limit_quotas_item(njt_pool_t *pool, dyn_limit_quotas_item_t *out, size_t *length, njt_int_t flags) {
+    if (out == NULL) {
+        *length += 4; // null
+        return;
+    }
+    *length += 1;
+    njt_int_t omit;
+    njt_int_t count = 0;
+    omit = 0;
+    omit = out->is_zone_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->zone.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        *length += (4 + 3); // "zone": 
+        get_json_length_dyn_limit_quotas_item_zone(pool, (&out->zone), length, flags);
+        *length += 1; // ","
+        count++;
+    }
+    omit = 0;
+    omit = out->is_scope_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->scope.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        *length += (5 + 3); // "scope": 
+        get_json_length_dyn_limit_quotas_item_scope(pool, (&out->scope), length, flags);
+        *length += 1; // ","
+        count++;
+    }
+    omit = 0;
+    omit = out->is_match_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->match.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        *length += (5 + 3); // "match": 
+        get_json_length_dyn_limit_quotas_item_match(pool, (&out->match), length, flags);
+        *length += 1; // ","
+        count++;
+    }
+    omit = 0;
+    omit = out->is_requests_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->requests.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        *length += (8 + 3); // "requests": 
+        get_json_length_dyn_limit_quotas_item_requests(pool, (&out->requests), length, flags);
+        *length += 1; // ","
+        count++;
+    }
+    omit = 0;
+    omit = out->is_bytes_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->bytes.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        *length += (5 + 3); // "bytes": 
+        get_json_length_dyn_limit_quotas_item_bytes(pool, (&out->bytes), length, flags);
+        *length += 1; // ","
+        count++;
+    }
+    if (count != 0) {
+        *length -= 1; // "\b"
+    }
+    *length += 1;
+}
+
+static void get_json_length_dyn_limit_quotas(njt_pool_t *pool, dyn_limit_quotas_t *out, size_t *length, njt_int_t flags) {
+    njt_uint_t i;
+    njt_uint_t omit;
+    njt_int_t count = 0;
+    if (out == NULL) {
+        *length += 2; // "[]"
+        return;
+    }
+    *length += 2; // "[]"
+    for (i = 0; i < out->nelts; ++i) {
+        omit = 0;
+        omit = ((flags & OMIT_NULL_OBJ) && ((dyn_limit_quotas_item_t**)out->elts)[i] == NULL) ? 1 : 0;
+        if (omit == 0) {
+            get_json_length_dyn_limit_quotas_item(pool, ((dyn_limit_quotas_item_t**)out->elts)[i], length, flags);
+            *length += 1; // ","
+            count++; // ","
+        }
+    }
+    if (count != 0) {
+        *length -= 1; // "\b"
+    }
+}
+
 static void get_json_length_dyn_limit(njt_pool_t *pool, dyn_limit_t *out, size_t *length, njt_int_t flags) {
     if (out == NULL) {
         *length += 4; // null
@@ -2312,6 +2615,15 @@ static void get_json_length_dyn_limit(njt_pool_t *pool, dyn_limit_t *out, size_t
         *length += 1; // ","
         count++;
     }
+    omit = 0;
+    omit = out->is_quotas_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_ARRAY) && (out->quotas) == NULL ? 1 : omit;
+    if (omit == 0) {
+        *length += (6 + 3); // "quotas": 
+        get_json_length_dyn_limit_quotas(pool, (out->quotas), length, flags);
+        *length += 1; // ","
+        count++;
+    }
     if (count != 0) {
         *length -= 1; // "\b"
     }
@@ -2358,6 +2670,30 @@ dyn_limit_limit_rps_item_t* get_dyn_limit_limit_rps_item(dyn_limit_limit_rps_t *
 
 }
 
+dyn_limit_quotas_item_zone_t* get_dyn_limit_quotas_item_zone(dyn_limit_quotas_item_t *out) {
+    return &out->zone;
+}
+
+dyn_limit_quotas_item_scope_t* get_dyn_limit_quotas_item_scope(dyn_limit_quotas_item_t *out) {
+    return &out->scope;
+}
+
+dyn_limit_quotas_item_match_t* get_dyn_limit_quotas_item_match(dyn_limit_quotas_item_t *out) {
+    return &out->match;
+}
+
+dyn_limit_quotas_item_requests_t* get_dyn_limit_quotas_item_requests(dyn_limit_quotas_item_t *out) {
+    return &out->requests;
+}
+
+dyn_limit_quotas_item_bytes_t* get_dyn_limit_quotas_item_bytes(dyn_limit_quotas_item_t *out) {
+    return &out->bytes;
+}
+dyn_limit_quotas_item_t* get_dyn_limit_quotas_item(dyn_limit_quotas_t *out, size_t idx) {
+    return ((dyn_limit_quotas_item_t**)out->elts)[idx];
+
+}
+
 dyn_limit_servers_t* get_dyn_limit_servers(dyn_limit_t *out) {
     return out->servers;
 }
@@ -2365,6 +2701,10 @@ dyn_limit_servers_t* get_dyn_limit_servers(dyn_limit_t *out) {
 dyn_limit_limit_rps_t* get_dyn_limit_limit_rps(dyn_limit_t *out) {
     return out->limit_rps;
 }
+
+dyn_limit_quotas_t* get_dyn_limit_quotas(dyn_limit_t *out) {
+    return out->quotas;
+}
 int add_item_dyn_limit_servers_item_listens(dyn_limit_servers_item_listens_t *src, dyn_limit_servers_item_listens_item_t* item) {
     void *new = njt_array_push(src);
     if (new == NULL) {
@@ -2461,6 +2801,46 @@ void set_dyn_limit_limit_rps(dyn_limit_t* obj, dyn_limit_limit_rps_t* field) {
     obj->limit_rps = field;
     obj->is_limit_rps_set = 1;
 }
+void set_dyn_limit_quotas_item_zone(dyn_limit_quotas_item_t* obj, dyn_limit_quotas_item_zone_t* field) {
+    njt_memcpy(&obj->zone, field, sizeof(njt_str_t));
+    obj->is_zone_set = 1;
+}
+void set_dyn_limit_quotas_item_scope(dyn_limit_quotas_item_t* obj, dyn_limit_quotas_item_scope_t* field) {
+    njt_memcpy(&obj->scope, field, sizeof(njt_str_t));
+    obj->is_scope_set = 1;
+}
+void set_dyn_limit_quotas_item_match(dyn_limit_quotas_item_t* obj, dyn_limit_quotas_item_match_t* field) {
+    njt_memcpy(&obj->match, field, sizeof(njt_str_t));
+    obj->is_match_set = 1;
+}
+void set_dyn_limit_quotas_item_requests(dyn_limit_quotas_item_t* obj, dyn_limit_quotas_item_requests_t* field) {
+    njt_memcpy(&obj->requests, field, sizeof(njt_str_t));
+    obj->is_requests_set = 1;
+}
+void set_dyn_limit_quotas_item_bytes(dyn_limit_quotas_item_t* obj, dyn_limit_quotas_item_bytes_t* field) {
+    njt_memcpy(&obj->bytes, field, sizeof(njt_str_t));
+    obj->is_bytes_set = 1;
+}
+dyn_limit_quotas_item_t* create_dyn_limit_quotas_item(njt_pool_t *pool) {
+    dyn_limit_quotas_item_t* out = njt_pcalloc(pool, sizeof(dyn_limit_quotas_item_t));
+    return out;
+}
+int add_item_dyn_limit_quotas(dyn_limit_quotas_t *src, dyn_limit_quotas_item_t* item) {
+    void *new = njt_array_push(src);
+    if (new == NULL) {
+        return NJT_ERROR;
+    }
+    njt_memcpy(new, &item, src->size);
+    return NJT_OK;
+}
+
+dyn_limit_quotas_t* create_dyn_limit_quotas(njt_pool_t *pool, size_t nelts) {
+    return njt_array_create(pool, nelts, sizeof(dyn_limit_quotas_item_t*));
+}
+void set_dyn_limit_quotas(dyn_limit_t* obj, dyn_limit_quotas_t* field) {
+    obj->quotas = field;
+    obj->is_quotas_set = 1;
+}
 dyn_limit_t* create_dyn_limit(njt_pool_t *pool) {
     dyn_limit_t* out = njt_pcalloc(pool, sizeof(dyn_limit_t));
     return out;
@@ -2749,6 +3129,147 @@ static void to_oneline_json_dyn_limit_limit_rps(njt_pool_t *pool, dyn_limit_limi
     buf->len ++;
 }
 
+static void to_oneline_json_dyn_limit_quotas_item_zone(njt_pool_t *pool, dyn_limit_quotas_item_zone_t *out, njt_str_t *buf, njt_int_t flags) {
+    u_char* cur = buf->data + buf->len;
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    cur = njt_sprintf(cur, "\"%V\"", dst);
+    buf->len = cur - buf->data;
+}
+
+static void to_oneline_json_dyn_limit_quotas_item_scope(njt_pool_t *pool, dyn_limit_quotas_item_scope_t *out, njt_str_t *buf, njt_int_t flags) {
+    u_char* cur = buf->data + buf->len;
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    cur = njt_sprintf(cur, "\"%V\"", dst);
+    buf->len = cur - buf->data;
+}
+
+static void to_oneline_json_dyn_limit_quotas_item_match(njt_pool_t *pool, dyn_limit_quotas_item_match_t *out, njt_str_t *buf, njt_int_t flags) {
+    u_char* cur = buf->data + buf->len;
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    cur = njt_sprintf(cur, "\"%V\"", dst);
+    buf->len = cur - buf->data;
+}
+
+static void to_oneline_json_dyn_limit_quotas_item_requests(njt_pool_t *pool, dyn_limit_quotas_item_requests_t *out, njt_str_t *buf, njt_int_t flags) {
+    u_char* cur = buf->data + buf->len;
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    cur = njt_sprintf(cur, "\"%V\"", dst);
+    buf->len = cur - buf->data;
+}
+
+static void to_oneline_json_dyn_limit_quotas_item_bytes(njt_pool_t *pool, dyn_limit_quotas_item_bytes_t *out, njt_str_t *buf, njt_int_t flags) {
+    u_char* cur = buf->data + buf->len;
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    cur = njt_sprintf(cur, "\"%V\"", dst);
+    buf->len = cur - buf->data;
+}
+
+static void to_oneline_json_dyn_limit_quotas_item(njt_pool_t *pool, dyn_limit_quotas_item_t *out, njt_str_t* buf, njt_int_t flags) {
+    njt_int_t omit;
+    u_char* cur = buf->data + buf->len;
+    if (out == NULL) {
+        cur = njt_sprintf(cur, "null");
+        buf->len += 4;
+        return;
+    }
+    cur = njt_sprintf(cur, "{");
+    buf->len ++;
+    omit = 0;
+    omit = out->is_zone_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->zone.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        cur = njt_sprintf(cur, "\"zone\":");
+        buf->len = cur - buf->data;
+        to_oneline_json_dyn_limit_quotas_item_zone(pool, (&out->zone), buf, flags);
+        cur = buf->data + buf->len;
+        cur = njt_sprintf(cur, ",");
+        buf->len ++;
+    }
+    omit = 0;
+    omit = out->is_scope_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->scope.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        cur = njt_sprintf(cur, "\"scope\":");
+        buf->len = cur - buf->data;
+        to_oneline_json_dyn_limit_quotas_item_scope(pool, (&out->scope), buf, flags);
+        cur = buf->data + buf->len;
+        cur = njt_sprintf(cur, ",");
+        buf->len ++;
+    }
+    omit = 0;
+    omit = out->is_match_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->match.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        cur = njt_sprintf(cur, "\"match\":");
+        buf->len = cur - buf->data;
+        to_oneline_json_dyn_limit_quotas_item_match(pool, (&out->match), buf, flags);
+        cur = buf->data + buf->len;
+        cur = njt_sprintf(cur, ",");
+        buf->len ++;
+    }
+    omit = 0;
+    omit = out->is_requests_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->requests.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        cur = njt_sprintf(cur, "\"requests\":");
+        buf->len = cur - buf->data;
+        to_oneline_json_dyn_limit_quotas_item_requests(pool, (&out->requests), buf, flags);
+        cur = buf->data + buf->len;
+        cur = njt_sprintf(cur, ",");
+        buf->len ++;
+    }
+    omit = 0;
+    omit = out->is_bytes_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->bytes.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        cur = njt_sprintf(cur, "\"bytes\":");
+        buf->len = cur - buf->data;
+        to_oneline_json_dyn_limit_quotas_item_bytes(pool, (&out->bytes), buf, flags);
+        cur = buf->data + buf->len;
+        cur = njt_sprintf(cur, ",");
+        buf->len ++;
+    }
+    cur--;
+    if (cur[0] == ',') {
+        buf->len --;
+    } else {
+        cur ++;
+    }
+    cur = njt_sprintf(cur, "}");
+    buf->len ++;
+}
+
+static void to_oneline_json_dyn_limit_quotas(njt_pool_t *pool, dyn_limit_quotas_t *out, njt_str_t* buf, njt_int_t flags) {
+    njt_int_t omit;
+    u_char *cur = buf->data + buf->len;
+    njt_uint_t i;
+    if (out == NULL || out->nelts == 0) {
+        cur = njt_sprintf(cur, "[]");
+        buf->len += 2;
+        return;
+    }
+    cur = njt_sprintf(cur,  "[");
+    buf->len ++;
+    for (i = 0; i < out->nelts; ++i) {
+        omit = 0;
+        omit = ((flags & OMIT_NULL_OBJ) && ((dyn_limit_quotas_item_t**)out->elts)[i] == NULL) ? 1 : 0;
+        if (omit == 0) {
+            to_oneline_json_dyn_limit_quotas_item(pool, ((dyn_limit_quotas_item_t**)out->elts)[i], buf, flags);
+            cur = buf->data + buf->len;
+            cur = njt_sprintf(cur, ",");
+            buf->len ++;
+        }
+    }
+    cur--;
+    if (cur[0] == ',') {
+        buf->len --;
+    } else {
+        cur ++;
+    }
+    cur = njt_sprintf(cur,  "]");
+    buf->len ++;
+}
+
 static void to_oneline_json_dyn_limit(njt_pool_t *pool, dyn_limit_t *out, njt_str_t* buf, njt_int_t flags) {
     njt_int_t omit;
     u_char* cur = buf->data + buf->len;
@@ -2781,6 +3302,17 @@ static void to_oneline_json_dyn_limit(njt_pool_t *pool, dyn_limit_t *out, njt_st
         cur = njt_sprintf(cur, ",");
         buf->len ++;
     }
+    omit = 0;
+    omit = out->is_quotas_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_ARRAY) && (out->quotas) == NULL ? 1 : omit;
+    if (omit == 0) {
+        cur = njt_sprintf(cur, "\"quotas\":");
+        buf->len = cur - buf->data;
+        to_oneline_json_dyn_limit_quotas(pool, (out->quotas), buf, flags);
+        cur = buf->data + buf->len;
+        cur = njt_sprintf(cur, ",");
+        buf->len ++;
+    }
     cur--;
     if (cur[0] == ',') {
         buf->len --;
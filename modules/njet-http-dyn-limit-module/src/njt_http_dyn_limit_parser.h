@@ -198,11 +198,37 @@ typedef struct dyn_limit_limit_rps_item_t_s {
 } dyn_limit_limit_rps_item_t;
 
 typedef njt_array_t  dyn_limit_limit_rps_t;
+typedef njt_str_t dyn_limit_quotas_item_zone_t;
+
+typedef njt_str_t dyn_limit_quotas_item_scope_t;
+
+typedef njt_str_t dyn_limit_quotas_item_match_t;
+
+typedef njt_str_t dyn_limit_quotas_item_requests_t;
+
+typedef njt_str_t dyn_limit_quotas_item_bytes_t;
+
+typedef struct dyn_limit_quotas_item_t_s {
+    dyn_limit_quotas_item_zone_t zone;
+    dyn_limit_quotas_item_scope_t scope;
+    dyn_limit_quotas_item_match_t match;
+    dyn_limit_quotas_item_requests_t requests;
+    dyn_limit_quotas_item_bytes_t bytes;
+    unsigned int is_zone_set:1;
+    unsigned int is_scope_set:1;
+    unsigned int is_match_set:1;
+    unsigned int is_requests_set:1;
+    unsigned int is_bytes_set:1;
+} dyn_limit_quotas_item_t;
+
+typedef njt_array_t  dyn_limit_quotas_t;
 typedef struct dyn_limit_t_s {
     dyn_limit_servers_t *servers;
     dyn_limit_limit_rps_t *limit_rps;
+    dyn_limit_quotas_t *quotas;
     unsigned int is_servers_set:1;
     unsigned int is_limit_rps_set:1;
+    unsigned int is_quotas_set:1;
 } dyn_limit_t;
 
 dyn_limit_servers_item_listens_item_t* get_dyn_limit_servers_item_listens_item(dyn_limit_servers_item_listens_t *out, size_t idx);
@@ -218,10 +244,18 @@ dyn_limit_servers_item_t* get_dyn_limit_servers_item(dyn_limit_servers_t *out, s
 dyn_limit_limit_rps_item_zone_t* get_dyn_limit_limit_rps_item_zone(dyn_limit_limit_rps_item_t *out);
 dyn_limit_limit_rps_item_rate_t* get_dyn_limit_limit_rps_item_rate(dyn_limit_limit_rps_item_t *out);
 dyn_limit_limit_rps_item_t* get_dyn_limit_limit_rps_item(dyn_limit_limit_rps_t *out, size_t idx);
+dyn_limit_quotas_item_zone_t* get_dyn_limit_quotas_item_zone(dyn_limit_quotas_item_t *out);
+dyn_limit_quotas_item_scope_t* get_dyn_limit_quotas_item_scope(dyn_limit_quotas_item_t *out);
+dyn_limit_quotas_item_match_t* get_dyn_limit_quotas_item_match(dyn_limit_quotas_item_t *out);
+dyn_limit_quotas_item_requests_t* get_dyn_limit_quotas_item_requests(dyn_limit_quotas_item_t *out);
+dyn_limit_quotas_item_bytes_t* get_dyn_limit_quotas_item_bytes(dyn_limit_quotas_item_t *out);
+dyn_limit_quotas_item_t* get_dyn_limit_quotas_item(dyn_limit_quotas_t *out, size_t idx);
 // CHECK ARRAY not exceeding bounds before calling this func
 dyn_limit_servers_t* get_dyn_limit_servers(dyn_limit_t *out);
 // CHECK ARRAY not exceeding bounds before calling this func
 dyn_limit_limit_rps_t* get_dyn_limit_limit_rps(dyn_limit_t *out);
+// CHECK ARRAY not exceeding bounds before calling this func
+dyn_limit_quotas_t* get_dyn_limit_quotas(dyn_limit_t *out);
 int add_item_dyn_limit_servers_item_listens(dyn_limit_servers_item_listens_t *src, dyn_limit_servers_item_listens_item_t* items);
 dyn_limit_servers_item_listens_t* create_dyn_limit_servers_item_listens(njt_pool_t *pool, size_t nelts);
 void set_dyn_limit_servers_item_listens(dyn_limit_servers_item_t* obj, dyn_limit_servers_item_listens_t* field);
@@ -241,6 +275,15 @@ dyn_limit_limit_rps_item_t* create_dyn_limit_limit_rps_item(njt_pool_t *pool);
 int add_item_dyn_limit_limit_rps(dyn_limit_limit_rps_t *src, dyn_limit_limit_rps_item_t* items);
 dyn_limit_limit_rps_t* create_dyn_limit_limit_rps(njt_pool_t *pool, size_t nelts);
 void set_dyn_limit_limit_rps(dyn_limit_t* obj, dyn_limit_limit_rps_t* field);
+void set_dyn_limit_quotas_item_zone(dyn_limit_quotas_item_t* obj, dyn_limit_quotas_item_zone_t* field);
+void set_dyn_limit_quotas_item_scope(dyn_limit_quotas_item_t* obj, dyn_limit_quotas_item_scope_t* field);
+void set_dyn_limit_quotas_item_match(dyn_limit_quotas_item_t* obj, dyn_limit_quotas_item_match_t* field);
+void set_dyn_limit_quotas_item_requests(dyn_limit_quotas_item_t* obj, dyn_limit_quotas_item_requests_t* field);
+void set_dyn_limit_quotas_item_bytes(dyn_limit_quotas_item_t* obj, dyn_limit_quotas_item_bytes_t* field);
+dyn_limit_quotas_item_t* create_dyn_limit_quotas_item(njt_pool_t *pool);
+int add_item_dyn_limit_quotas(dyn_limit_quotas_t *src, dyn_limit_quotas_item_t* items);
+dyn_limit_quotas_t* create_dyn_limit_quotas(njt_pool_t *pool, size_t nelts);
+void set_dyn_limit_quotas(dyn_limit_t* obj, dyn_limit_quotas_t* field);
 dyn_limit_t* create_dyn_limit(njt_pool_t *pool);
 dyn_limit_t* json_parse_dyn_limit(njt_pool_t *pool, const njt_str_t *json_string, js2c_parse_error_t *err_ret);
 njt_str_t* to_json_dyn_limit(njt_pool_t *pool, dyn_limit_t *out, njt_int_t flags);
@@ -20,6 +20,7 @@ static njt_int_t njt_http_update_server_ssl(njt_pool_t *pool, dyn_ssl_api_t *api
                 njt_rpc_result_t *rpc_result){
     njt_cycle_t                     *cycle;
     njt_http_core_srv_conf_t        *cscf;
+    njt_http_core_loc_conf_t        *clcf;
     njt_http_ssl_srv_conf_t         *hsscf;
     dyn_ssl_api_cert_info_t         *cert;
     njt_str_t                        cert_sign_str;
@@ -451,6 +452,35 @@ static njt_int_t njt_http_update_server_ssl(njt_pool_t *pool, dyn_ssl_api_t *api
         return NJT_ERROR;
     }
 
+    //parsed copies of replaced files must not outlive the update, the cache
+    //may be shared with servers selecting certificates by variables
+    njt_ssl_cache_invalidate(hsscf->certificate_cache, pool, &cert->certificate);
+    njt_ssl_cache_invalidate(hsscf->certificate_cache, pool, &cert->certificateKey);
+    if(cert->cert_type == DYN_SSL_API_CERT_INFO_CERT_TYPE_NTLS){
+        njt_ssl_cache_invalidate(hsscf->certificate_cache, pool, &cert->certificateEnc);
+        njt_ssl_cache_invalidate(hsscf->certificate_cache, pool, &cert->certificateKeyEnc);
+    }
+
+    //new certs get a staple, taken from the shared stapling cache if any
+    if(hsscf->stapling){
+        clcf = cscf->ctx->loc_conf[njt_http_core_module.ctx_index];
+        cf.pool = hsscf->certificates->pool;
+
+        if(njt_ssl_stapling(&cf, &hsscf->ssl, &hsscf->stapling_file,
+                &hsscf->stapling_responder, hsscf->stapling_verify) != NJT_OK
+            || njt_ssl_stapling_resolver(&cf, &hsscf->ssl, clcf->resolver,
+                clcf->resolver_timeout) != NJT_OK
+            || njt_ssl_stapling_cache(&cf, &hsscf->ssl, hsscf->stapling_cache_zone,
+                &hsscf->stapling_cache_path) != NJT_OK)
+        {
+            njt_log_error(NJT_LOG_ERR, pool->log, 0,
+                " dyn ssl, ocsp stapling setup error, listen:%V server_name:%V",
+                port, serverName);
+        }
+
+        cf.pool = pool;
+    }
+
     //save new cert's crc32
     if(hsscf->dyn_cert_crc32 == NULL){
         hsscf->dyn_cert_crc32 = njt_array_create(hsscf->certificates->pool, 4, sizeof(uint32_t));
@@ -23,6 +23,11 @@
 
 static njt_http_output_body_filter_pt njt_http_next_body_filter;
 
+#if (NJT_THREADS)
+static njt_int_t njt_http_modsecurity_body_filter_resume(njt_http_request_t *r,
+    njt_http_modsecurity_ctx_t *ctx, njt_chain_t *in);
+#endif
+
 /* XXX: check behaviour on few body filters installed */
 njt_int_t
 njt_http_modsecurity_body_filter_init(void)
@@ -38,22 +43,26 @@ njt_http_modsecurity_body_filter(njt_http_request_t *r, njt_chain_t *in)
 {
     njt_chain_t *chain = in;
     njt_http_modsecurity_ctx_t *ctx = NULL;
-#if defined(MODSECURITY_SANITY_CHECKS) && (MODSECURITY_SANITY_CHECKS)
     njt_http_modsecurity_conf_t *mcf;
+#if defined(MODSECURITY_SANITY_CHECKS) && (MODSECURITY_SANITY_CHECKS)
     njt_list_part_t *part = &r->headers_out.headers.part;
     njt_table_elt_t *data = part->elts;
     njt_uint_t i = 0;
 #endif
 
-    if (in == NULL) {
-        return njt_http_next_body_filter(r, in);
-    }
-
     ctx = njt_http_get_module_ctx(r, njt_http_modsecurity_module);
 
     dd("body filter, recovering ctx: %p", ctx);
 
-    if (ctx == NULL) {
+#if (NJT_THREADS)
+    if (ctx != NULL && ctx->offload
+        && ctx->offload_phase == NJT_HTTP_MODSECURITY_PHASE_RESPONSE_BODY)
+    {
+        return njt_http_modsecurity_body_filter_resume(r, ctx, in);
+    }
+#endif
+
+    if (in == NULL || ctx == NULL) {
         return njt_http_next_body_filter(r, in);
     }
 
@@ -61,8 +70,9 @@ njt_http_modsecurity_body_filter(njt_http_request_t *r, njt_chain_t *in)
         return njt_http_next_body_filter(r, in);
     }
 
-#if defined(MODSECURITY_SANITY_CHECKS) && (MODSECURITY_SANITY_CHECKS)
     mcf = njt_http_get_module_loc_conf(r, njt_http_modsecurity_module);
+
+#if defined(MODSECURITY_SANITY_CHECKS) && (MODSECURITY_SANITY_CHECKS)
     if (mcf != NULL && mcf->sanity_checks_enabled != NJT_CONF_UNSET)
     {
 #if 0
@@ -143,13 +153,25 @@ njt_http_modsecurity_body_filter(njt_http_request_t *r, njt_chain_t *in)
     for (; chain != NULL; chain = chain->next)
     {
         u_char *data = chain->buf->pos;
+        size_t size = chain->buf->last - data;
         int ret;
 
-        msc_append_response_body(ctx->modsec_transaction, data, chain->buf->last - data);
-        ret = njt_http_modsecurity_process_intervention(ctx->modsec_transaction, r, 0);
-        if (ret > 0) {
-            return njt_http_filter_finalize_request(r,
-                &njt_http_modsecurity_module, ret);
+        if (mcf->body_sample
+            && ctx->response_body_sent + size > mcf->body_sample)
+        {
+            size = mcf->body_sample - ctx->response_body_sent;
+            ctx->response_sampled = 1;
+        }
+
+        if (size) {
+            msc_append_response_body(ctx->modsec_transaction, data, size);
+            ctx->response_body_sent += size;
+
+            ret = njt_http_modsecurity_process_intervention(ctx->modsec_transaction, r, 0);
+            if (ret > 0) {
+                return njt_http_filter_finalize_request(r,
+                    &njt_http_modsecurity_module, ret);
+            }
         }
 
 /* XXX: chain->buf->last_buf || chain->buf->last_in_chain */
@@ -157,11 +179,39 @@ njt_http_modsecurity_body_filter(njt_http_request_t *r, njt_chain_t *in)
 
         if (is_request_processed) {
             njt_pool_t *old_pool;
+            uint64_t start;
+
+#if (NJT_THREADS)
+            if (mcf->thread_pool
+                && ctx->response_body_sent >= mcf->thread_min_body)
+            {
+                if (njt_chain_add_copy(r->pool, &ctx->held, in) != NJT_OK) {
+                    return NJT_ERROR;
+                }
+
+                if (njt_http_modsecurity_offload(r, ctx,
+                        NJT_HTTP_MODSECURITY_PHASE_RESPONSE_BODY) != NJT_OK)
+                {
+                    return NJT_ERROR;
+                }
+
+                r->buffered |= NJT_HTTP_MODSECURITY_BUFFERED;
+
+                return NJT_AGAIN;
+            }
+#endif
+
+            start = njt_http_modsecurity_profile_start(r);
 
             old_pool = njt_http_modsecurity_pcre_malloc_init(r->pool);
             msc_process_response_body(ctx->modsec_transaction);
             njt_http_modsecurity_pcre_malloc_done(old_pool);
 
+            njt_http_modsecurity_profile_end(r,
+                NJT_HTTP_MODSECURITY_PHASE_RESPONSE_BODY, start,
+                ctx->response_body_sent,
+                ctx->response_sampled ? NJT_HTTP_MODSECURITY_SAMPLED : 0);
+
 /* XXX: I don't get how body from modsec being transferred to njet's buffer.  If so - after adjusting of njet's
    XXX: body we can proceed to adjust body size (content-length).  see xslt_body_filter() for example */
             ret = njt_http_modsecurity_process_intervention(ctx->modsec_transaction, r, 0);
@@ -183,3 +233,42 @@ njt_http_modsecurity_body_filter(njt_http_request_t *r, njt_chain_t *in)
 /* XXX: xflt_filter() -- return NJT_OK here */
     return njt_http_next_body_filter(r, in);
 }
+
+
+#if (NJT_THREADS)
+
+static njt_int_t
+njt_http_modsecurity_body_filter_resume(njt_http_request_t *r,
+    njt_http_modsecurity_ctx_t *ctx, njt_chain_t *in)
+{
+    int ret;
+    njt_chain_t *out;
+
+    if (in && njt_chain_add_copy(r->pool, &ctx->held, in) != NJT_OK) {
+        return NJT_ERROR;
+    }
+
+    if (ctx->offload_busy) {
+        dd("response body is still being inspected, holding it");
+        return NJT_AGAIN;
+    }
+
+    ctx->offload = 0;
+    r->buffered &= ~NJT_HTTP_MODSECURITY_BUFFERED;
+
+    out = ctx->held;
+    ctx->held = NULL;
+
+    ret = njt_http_modsecurity_process_intervention(ctx->modsec_transaction, r, 0);
+    if (ret > 0) {
+        return ret;
+    }
+    else if (ret < 0) {
+        return njt_http_filter_finalize_request(r,
+            &njt_http_modsecurity_module, NJT_HTTP_INTERNAL_SERVER_ERROR);
+    }
+
+    return njt_http_next_body_filter(r, out);
+}
+
+#endif
@@ -78,11 +78,55 @@ typedef struct {
 } njt_http_modsecurity_header_t;
 
 
+#define NJT_HTTP_MODSECURITY_PHASE_CONNECTION        0
+#define NJT_HTTP_MODSECURITY_PHASE_REQUEST_HEADERS   1
+#define NJT_HTTP_MODSECURITY_PHASE_REQUEST_BODY      2
+#define NJT_HTTP_MODSECURITY_PHASE_RESPONSE_HEADERS  3
+#define NJT_HTTP_MODSECURITY_PHASE_RESPONSE_BODY     4
+#define NJT_HTTP_MODSECURITY_PHASE_LOGGING           5
+#define NJT_HTTP_MODSECURITY_PHASES                  6
+
+#define NJT_HTTP_MODSECURITY_OFFLOADED               0x01
+#define NJT_HTTP_MODSECURITY_SAMPLED                 0x02
+
+/*
+ * a request level flag, like the other filters' *_BUFFERED flags:
+ * connection level bits are reserved for socket and write buffering;
+ * 0x01-0x08 are taken by ssi, sub, copy and image filters, so r->buffered
+ * is widened to 5 bits for this one
+ */
+#define NJT_HTTP_MODSECURITY_BUFFERED                0x10
+
+
+typedef struct {
+    njt_atomic_t   calls;
+    njt_atomic_t   usec;
+    njt_atomic_t   max_usec;
+    njt_atomic_t   bytes;
+    njt_atomic_t   offloaded;
+    njt_atomic_t   sampled;
+} njt_http_modsecurity_phase_stat_t;
+
+
+typedef struct {
+    njt_http_modsecurity_phase_stat_t  phases[NJT_HTTP_MODSECURITY_PHASES];
+} njt_http_modsecurity_profile_t;
+
+
 typedef struct {
     njt_http_request_t *r;
     Transaction *modsec_transaction;
     ModSecurityIntervention *delayed_intervention;
 
+#if (NJT_THREADS)
+    njt_thread_task_t *task;
+#endif
+    /* response body held back while ModSecurity inspects it in a thread */
+    njt_chain_t *held;
+
+    size_t request_body_sent;
+    size_t response_body_sent;
+
 #if defined(MODSECURITY_SANITY_CHECKS) && (MODSECURITY_SANITY_CHECKS)
     /*
      * Should be filled with the headers that were sent to ModSecurity.
@@ -100,6 +144,10 @@ typedef struct {
     unsigned processed:1;
     unsigned logged:1;
     unsigned intervention_triggered:1;
+    unsigned response_sampled:1;
+    unsigned offload:1;
+    unsigned offload_busy:1;
+    unsigned offload_phase:3;
 } njt_http_modsecurity_ctx_t;
 
 
@@ -109,6 +157,7 @@ typedef struct {
     njt_uint_t                 rules_inline;
     njt_uint_t                 rules_file;
     njt_uint_t                 rules_remote;
+    njt_shm_zone_t            *profile_zone;
 } njt_http_modsecurity_main_conf_t;
 
 
@@ -123,6 +172,13 @@ typedef struct {
 #endif
 
     njt_http_complex_value_t  *transaction_id;
+
+    size_t                     body_sample;
+#if (NJT_THREADS)
+    njt_thread_pool_t         *thread_pool;
+    size_t                     thread_min_body;
+    njt_flag_t                 thread_headers;
+#endif
 } njt_http_modsecurity_conf_t;
 
 
@@ -170,5 +226,18 @@ njt_int_t njt_http_modsecurity_pre_access_handler(njt_http_request_t *r);
 /* njt_http_modsecurity_rewrite.c */
 njt_int_t njt_http_modsecurity_rewrite_handler(njt_http_request_t *r);
 
+/* njt_http_modsecurity_offload.c */
+char *njt_http_modsecurity_thread_pool(njt_conf_t *cf, njt_command_t *cmd, void *conf);
+char *njt_http_modsecurity_profile(njt_conf_t *cf, njt_command_t *cmd, void *conf);
+uint64_t njt_http_modsecurity_profile_start(njt_http_request_t *r);
+void njt_http_modsecurity_profile_end(njt_http_request_t *r, njt_uint_t phase,
+    uint64_t start, size_t bytes, njt_uint_t flags);
+njt_int_t njt_http_modsecurity_append_file(Transaction *transaction,
+    njt_file_t *file, size_t limit, size_t *sent);
+#if (NJT_THREADS)
+njt_int_t njt_http_modsecurity_offload(njt_http_request_t *r,
+    njt_http_modsecurity_ctx_t *ctx, njt_uint_t phase);
+#endif
+
 
 #endif /* _NJT_HTTP_MODSECURITY_COMMON_H_INCLUDED_ */
@@ -417,6 +417,7 @@ njt_http_modsecurity_header_filter(njt_http_request_t *r)
     njt_uint_t status;
     char *http_response_ver;
     njt_pool_t *old_pool;
+    uint64_t start;
 
 
 /* XXX: if NOT_MODIFIED, do we need to process it at all?  see xslt_header_filter() */
@@ -524,9 +525,14 @@ njt_http_modsecurity_header_filter(njt_http_request_t *r)
     }
 #endif
 
+    start = njt_http_modsecurity_profile_start(r);
+
     old_pool = njt_http_modsecurity_pcre_malloc_init(r->pool);
     msc_process_response_headers(ctx->modsec_transaction, status, http_response_ver);
     njt_http_modsecurity_pcre_malloc_done(old_pool);
+
+    njt_http_modsecurity_profile_end(r, NJT_HTTP_MODSECURITY_PHASE_RESPONSE_HEADERS,
+                                     start, 0, 0);
     ret = njt_http_modsecurity_process_intervention(ctx->modsec_transaction, r, 0);
     if (r->error_page) {
         return njt_http_next_header_filter(r);
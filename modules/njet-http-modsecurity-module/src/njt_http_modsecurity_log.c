@@ -38,6 +38,7 @@ njt_http_modsecurity_log(void *log, const void* data)
 njt_int_t
 njt_http_modsecurity_log_handler(njt_http_request_t *r)
 {
+    uint64_t                      start;
     njt_pool_t                   *old_pool;
     njt_http_modsecurity_ctx_t   *ctx;
     njt_http_modsecurity_conf_t  *mcf;
@@ -74,9 +75,14 @@ njt_http_modsecurity_log_handler(njt_http_request_t *r)
     }
 
     dd("calling msc_process_logging for %p", ctx);
+    start = njt_http_modsecurity_profile_start(r);
+
     old_pool = njt_http_modsecurity_pcre_malloc_init(r->pool);
     msc_process_logging(ctx->modsec_transaction);
     njt_http_modsecurity_pcre_malloc_done(old_pool);
 
+    njt_http_modsecurity_profile_end(r, NJT_HTTP_MODSECURITY_PHASE_LOGGING,
+                                     start, 0, 0);
+
     return NJT_OK;
 }
@@ -456,6 +456,30 @@ static njt_command_t njt_http_modsecurity_commands[] =  {
     offsetof(njt_http_modsecurity_conf_t, enable),
     NULL
   },
+  {
+    njt_string("modsecurity_body_sample"),
+    NJT_HTTP_LOC_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_MAIN_CONF|NJT_CONF_TAKE1,
+    njt_conf_set_size_slot,
+    NJT_HTTP_LOC_CONF_OFFSET,
+    offsetof(njt_http_modsecurity_conf_t, body_sample),
+    NULL
+  },
+  {
+    njt_string("modsecurity_thread_pool"),
+    NJT_HTTP_LOC_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_MAIN_CONF|NJT_CONF_1MORE,
+    njt_http_modsecurity_thread_pool,
+    NJT_HTTP_LOC_CONF_OFFSET,
+    0,
+    NULL
+  },
+  {
+    njt_string("modsecurity_profile"),
+    NJT_HTTP_LOC_CONF|NJT_CONF_NOARGS,
+    njt_http_modsecurity_profile,
+    NJT_HTTP_LOC_CONF_OFFSET,
+    0,
+    NULL
+  },
   {
     njt_string("modsecurity_rules"),
     NJT_HTTP_LOC_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_MAIN_CONF|NJT_CONF_TAKE1,
@@ -622,6 +646,7 @@ njt_http_modsecurity_create_main_conf(njt_conf_t *cf)
      *     conf->rules_inline = 0;
      *     conf->rules_file = 0;
      *     conf->rules_remote = 0;
+     *     conf->profile_zone = NULL;
      */
 
     cln = njt_pool_cleanup_add(cf->pool, 0);
@@ -696,6 +721,12 @@ njt_http_modsecurity_create_conf(njt_conf_t *cf)
     conf->rules_set = msc_create_rules_set();
     conf->pool = cf->pool;
     conf->transaction_id = NJT_CONF_UNSET_PTR;
+    conf->body_sample = NJT_CONF_UNSET_SIZE;
+#if (NJT_THREADS)
+    conf->thread_pool = NJT_CONF_UNSET_PTR;
+    conf->thread_min_body = NJT_CONF_UNSET_SIZE;
+    conf->thread_headers = NJT_CONF_UNSET;
+#endif
 #if defined(MODSECURITY_SANITY_CHECKS) && (MODSECURITY_SANITY_CHECKS)
     conf->sanity_checks_enabled = NJT_CONF_UNSET;
 #endif
@@ -735,6 +766,18 @@ njt_http_modsecurity_merge_conf(njt_conf_t *cf, void *parent, void *child)
 
     njt_conf_merge_value(c->enable, p->enable, 0);
     njt_conf_merge_ptr_value(c->transaction_id, p->transaction_id, NULL);
+    njt_conf_merge_size_value(c->body_sample, p->body_sample, 0);
+#if (NJT_THREADS)
+    if (c->thread_pool == NJT_CONF_UNSET_PTR) {
+        c->thread_pool = p->thread_pool;
+        c->thread_min_body = p->thread_min_body;
+        c->thread_headers = p->thread_headers;
+    }
+
+    if (c->thread_pool == NJT_CONF_UNSET_PTR) {
+        c->thread_pool = NULL;
+    }
+#endif
 #if defined(MODSECURITY_SANITY_CHECKS) && (MODSECURITY_SANITY_CHECKS)
     njt_conf_merge_value(c->sanity_checks_enabled, p->sanity_checks_enabled, 0);
 #endif
@@ -0,0 +1,632 @@
+/*
+ * ModSecurity connector for njet, http://www.modsecurity.org/
+ * Copyright (c) 2015 Trustwave Holdings, Inc. (http://www.trustwave.com/)
+ * Copyright (C) 2021-2023 TMLake(Beijing) Technology Co., Ltd.
+ *
+ * You may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * If any of the files related to licensing are missing or if you have any
+ * other questions related to licensing please contact Trustwave Holdings, Inc.
+ * directly using the email address security@modsecurity.org.
+ *
+ */
+
+#ifndef MODSECURITY_DDEBUG
+#define MODSECURITY_DDEBUG 0
+#endif
+#include "ddebug.h"
+
+#include "njt_http_modsecurity_common.h"
+
+
+#define NJT_HTTP_MODSECURITY_FILE_BUF  8192
+
+
+#if (NJT_THREADS)
+
+typedef struct {
+    Transaction  *transaction;
+    njt_uint_t    phase;
+
+    /* request body: either in memory bufs or a temporary file */
+    njt_chain_t  *body;
+    njt_file_t   *file;
+    char         *file_name;
+    off_t         size;
+    size_t        limit;
+
+    size_t        sent;
+    njt_uint_t    sampled;
+    uint64_t      usec;
+} njt_http_modsecurity_task_ctx_t;
+
+
+static void njt_http_modsecurity_thread_handler(void *data, njt_log_t *log);
+static void njt_http_modsecurity_thread_event_handler(njt_event_t *ev);
+
+#endif
+
+static uint64_t njt_http_modsecurity_usec(void);
+static void njt_http_modsecurity_profile_add(njt_http_request_t *r,
+    njt_uint_t phase, uint64_t usec, size_t bytes, njt_uint_t flags);
+static njt_int_t njt_http_modsecurity_init_profile_zone(
+    njt_shm_zone_t *shm_zone, void *data);
+static njt_int_t njt_http_modsecurity_profile_handler(njt_http_request_t *r);
+
+
+static njt_str_t  njt_http_modsecurity_phase_names[] = {
+    njt_string("connection"),
+    njt_string("request_headers"),
+    njt_string("request_body"),
+    njt_string("response_headers"),
+    njt_string("response_body"),
+    njt_string("logging")
+};
+
+
+char *
+njt_http_modsecurity_thread_pool(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf)
+{
+#if (NJT_THREADS) && (NJT_PCRE2)
+    njt_http_modsecurity_conf_t *mcf = conf;
+
+    ssize_t     size;
+    njt_str_t  *value, s;
+    njt_uint_t  i;
+
+    if (mcf->thread_pool != NJT_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (njt_strcmp(value[1].data, "off") == 0) {
+        if (cf->args->nelts > 2) {
+            return "has invalid parameters with \"off\"";
+        }
+
+        mcf->thread_pool = NULL;
+        return NJT_CONF_OK;
+    }
+
+    mcf->thread_pool = njt_thread_pool_add(cf, &value[1]);
+    if (mcf->thread_pool == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    mcf->thread_min_body = 0;
+    mcf->thread_headers = 1;
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (njt_strncmp(value[i].data, "min_body=", 9) == 0) {
+            s.len = value[i].len - 9;
+            s.data = value[i].data + 9;
+
+            size = njt_parse_size(&s);
+            if (size == NJT_ERROR) {
+                njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                                   "invalid min_body \"%V\"", &value[i]);
+                return NJT_CONF_ERROR;
+            }
+
+            mcf->thread_min_body = (size_t) size;
+            continue;
+        }
+
+        if (njt_strcmp(value[i].data, "headers=on") == 0) {
+            mcf->thread_headers = 1;
+            continue;
+        }
+
+        if (njt_strcmp(value[i].data, "headers=off") == 0) {
+            mcf->thread_headers = 0;
+            continue;
+        }
+
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NJT_CONF_ERROR;
+    }
+
+    return NJT_CONF_OK;
+
+#else
+
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                       "\"modsecurity_thread_pool\" requires thread pools "
+                       "and PCRE2 support");
+    return NJT_CONF_ERROR;
+
+#endif
+}
+
+
+char *
+njt_http_modsecurity_profile(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_core_loc_conf_t          *clcf;
+    njt_http_modsecurity_main_conf_t  *mmcf;
+
+    njt_str_t  name = njt_string("modsecurity_profile");
+
+    mmcf = njt_http_conf_get_module_main_conf(cf, njt_http_modsecurity_module);
+
+    if (mmcf->profile_zone == NULL) {
+        mmcf->profile_zone = njt_shared_memory_add(cf, &name,
+                                                   8 * njt_pagesize,
+                                                   &njt_http_modsecurity_module);
+        if (mmcf->profile_zone == NULL) {
+            return NJT_CONF_ERROR;
+        }
+
+        mmcf->profile_zone->init = njt_http_modsecurity_init_profile_zone;
+    }
+
+    clcf = njt_http_conf_get_module_loc_conf(cf, njt_http_core_module);
+    clcf->handler = njt_http_modsecurity_profile_handler;
+
+    return NJT_CONF_OK;
+}
+
+
+static njt_int_t
+njt_http_modsecurity_init_profile_zone(njt_shm_zone_t *shm_zone, void *data)
+{
+    njt_slab_pool_t                 *shpool;
+    njt_http_modsecurity_profile_t  *profile;
+
+    if (data) {
+        shm_zone->data = data;
+        return NJT_OK;
+    }
+
+    shpool = (njt_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        shm_zone->data = shpool->data;
+        return NJT_OK;
+    }
+
+    profile = njt_slab_calloc(shpool, sizeof(njt_http_modsecurity_profile_t));
+    if (profile == NULL) {
+        return NJT_ERROR;
+    }
+
+    shpool->data = profile;
+    shm_zone->data = profile;
+
+    return NJT_OK;
+}
+
+
+static uint64_t
+njt_http_modsecurity_usec(void)
+{
+    struct timeval  tv;
+
+    njt_gettimeofday(&tv);
+
+    return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+
+uint64_t
+njt_http_modsecurity_profile_start(njt_http_request_t *r)
+{
+    njt_http_modsecurity_main_conf_t  *mmcf;
+
+    mmcf = njt_http_get_module_main_conf(r, njt_http_modsecurity_module);
+
+    if (mmcf->profile_zone == NULL) {
+        return 0;
+    }
+
+    return njt_http_modsecurity_usec();
+}
+
+
+void
+njt_http_modsecurity_profile_end(njt_http_request_t *r, njt_uint_t phase,
+    uint64_t start, size_t bytes, njt_uint_t flags)
+{
+    if (start == 0) {
+        return;
+    }
+
+    njt_http_modsecurity_profile_add(r, phase,
+                                     njt_http_modsecurity_usec() - start,
+                                     bytes, flags);
+}
+
+
+static void
+njt_http_modsecurity_profile_add(njt_http_request_t *r, njt_uint_t phase,
+    uint64_t usec, size_t bytes, njt_uint_t flags)
+{
+    njt_atomic_uint_t                   max;
+    njt_http_modsecurity_profile_t     *profile;
+    njt_http_modsecurity_phase_stat_t  *st;
+    njt_http_modsecurity_main_conf_t   *mmcf;
+
+    mmcf = njt_http_get_module_main_conf(r, njt_http_modsecurity_module);
+
+    if (mmcf->profile_zone == NULL || mmcf->profile_zone->data == NULL) {
+        return;
+    }
+
+    profile = mmcf->profile_zone->data;
+    st = &profile->phases[phase];
+
+    (void) njt_atomic_fetch_add(&st->calls, 1);
+    (void) njt_atomic_fetch_add(&st->usec, (njt_atomic_int_t) usec);
+    (void) njt_atomic_fetch_add(&st->bytes, (njt_atomic_int_t) bytes);
+
+    if (flags & NJT_HTTP_MODSECURITY_OFFLOADED) {
+        (void) njt_atomic_fetch_add(&st->offloaded, 1);
+    }
+
+    if (flags & NJT_HTTP_MODSECURITY_SAMPLED) {
+        (void) njt_atomic_fetch_add(&st->sampled, 1);
+    }
+
+    for ( ;; ) {
+        max = st->max_usec;
+
+        if (usec <= max || njt_atomic_cmp_set(&st->max_usec, max, usec)) {
+            break;
+        }
+    }
+}
+
+
+static njt_int_t
+njt_http_modsecurity_profile_handler(njt_http_request_t *r)
+{
+    size_t                              len;
+    u_char                             *p;
+    njt_int_t                           rc;
+    njt_buf_t                          *b;
+    njt_uint_t                          i;
+    njt_chain_t                         out;
+    njt_http_modsecurity_profile_t     *profile;
+    njt_http_modsecurity_phase_stat_t  *st;
+    njt_http_modsecurity_main_conf_t   *mmcf;
+    njt_str_t                           type = njt_string("application/json");
+
+    if (!(r->method & (NJT_HTTP_GET|NJT_HTTP_HEAD))) {
+        return NJT_HTTP_NOT_ALLOWED;
+    }
+
+    rc = njt_http_discard_request_body(r);
+    if (rc != NJT_OK) {
+        return rc;
+    }
+
+    mmcf = njt_http_get_module_main_conf(r, njt_http_modsecurity_module);
+
+    if (mmcf->profile_zone == NULL || mmcf->profile_zone->data == NULL) {
+        return NJT_HTTP_NOT_FOUND;
+    }
+
+    profile = mmcf->profile_zone->data;
+
+    len = sizeof("{\"rules\":{\"inline\":,\"file\":,\"remote\":},"
+                 "\"phases\":{}}") + 3 * NJT_INT_T_LEN;
+
+    for (i = 0; i < NJT_HTTP_MODSECURITY_PHASES; i++) {
+        len += sizeof("\"\":{\"calls\":,\"usec\":,\"avg_usec\":,"
+                      "\"max_usec\":,\"bytes\":,\"offloaded\":,"
+                      "\"sampled\":},")
+               + njt_http_modsecurity_phase_names[i].len
+               + 7 * NJT_ATOMIC_T_LEN;
+    }
+
+    b = njt_create_temp_buf(r->pool, len);
+    if (b == NULL) {
+        return NJT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    p = njt_sprintf(b->last, "{\"rules\":{\"inline\":%ui,\"file\":%ui,"
+                    "\"remote\":%ui},\"phases\":{",
+                    mmcf->rules_inline, mmcf->rules_file, mmcf->rules_remote);
+
+    for (i = 0; i < NJT_HTTP_MODSECURITY_PHASES; i++) {
+        st = &profile->phases[i];
+
+        p = njt_sprintf(p, "%s\"%V\":{\"calls\":%uA,\"usec\":%uA,"
+                        "\"avg_usec\":%uA,\"max_usec\":%uA,\"bytes\":%uA,"
+                        "\"offloaded\":%uA,\"sampled\":%uA}",
+                        i ? "," : "", &njt_http_modsecurity_phase_names[i],
+                        st->calls, st->usec,
+                        st->calls ? st->usec / st->calls : 0,
+                        st->max_usec, st->bytes, st->offloaded, st->sampled);
+    }
+
+    p = njt_sprintf(p, "}}");
+    b->last = p;
+    b->last_buf = (r == r->main) ? 1 : 0;
+    b->last_in_chain = 1;
+
+    r->headers_out.status = NJT_HTTP_OK;
+    r->headers_out.content_type_len = type.len;
+    r->headers_out.content_type = type;
+    r->headers_out.content_length_n = b->last - b->pos;
+
+    rc = njt_http_send_header(r);
+    if (rc == NJT_ERROR || rc > NJT_OK || r->header_only) {
+        return rc;
+    }
+
+    out.buf = b;
+    out.next = NULL;
+
+    return njt_http_output_filter(r, &out);
+}
+
+
+/*
+ * Feeds at most "limit" bytes of a request body temporary file to
+ * ModSecurity; used instead of msc_request_body_from_file() when
+ * body sampling is enabled.  Safe to call from a thread pool task.
+ */
+
+njt_int_t
+njt_http_modsecurity_append_file(Transaction *transaction, njt_file_t *file,
+    size_t limit, size_t *sent)
+{
+    u_char   buf[NJT_HTTP_MODSECURITY_FILE_BUF];
+    size_t   size;
+    off_t    offset;
+    ssize_t  n;
+
+    offset = 0;
+
+    while ((size_t) offset < limit) {
+        size = njt_min(sizeof(buf), limit - (size_t) offset);
+
+        n = njt_read_file(file, buf, size, offset);
+
+        if (n == NJT_ERROR) {
+            *sent = (size_t) offset;
+            return NJT_ERROR;
+        }
+
+        if (n == 0) {
+            break;
+        }
+
+        msc_append_request_body(transaction, buf, n);
+
+        offset += n;
+    }
+
+    *sent = (size_t) offset;
+
+    return NJT_OK;
+}
+
+
+#if (NJT_THREADS)
+
+njt_int_t
+njt_http_modsecurity_offload(njt_http_request_t *r,
+    njt_http_modsecurity_ctx_t *ctx, njt_uint_t phase)
+{
+    njt_chain_t                      *cl;
+    njt_thread_task_t                *task;
+    njt_http_request_body_t          *rb;
+    njt_http_modsecurity_conf_t      *mcf;
+    njt_http_modsecurity_task_ctx_t  *t;
+
+    mcf = njt_http_get_module_loc_conf(r, njt_http_modsecurity_module);
+
+    task = ctx->task;
+
+    if (task == NULL) {
+        task = njt_thread_task_alloc(r->pool,
+                                     sizeof(njt_http_modsecurity_task_ctx_t));
+        if (task == NULL) {
+            return NJT_ERROR;
+        }
+
+        task->handler = njt_http_modsecurity_thread_handler;
+
+        ctx->task = task;
+    }
+
+    t = task->ctx;
+
+    njt_memzero(t, sizeof(njt_http_modsecurity_task_ctx_t));
+
+    t->transaction = ctx->modsec_transaction;
+    t->phase = phase;
+
+    if (phase == NJT_HTTP_MODSECURITY_PHASE_REQUEST_BODY) {
+        rb = r->request_body;
+
+        for (cl = rb->bufs; cl; cl = cl->next) {
+            t->size += njt_buf_size(cl->buf);
+        }
+
+        t->limit = mcf->body_sample;
+
+        if (rb->temp_file) {
+            t->file = &rb->temp_file->file;
+
+            t->file_name = njt_str_to_char(t->file->name, r->pool);
+            if (t->file_name == (char *) -1) {
+                return NJT_ERROR;
+            }
+
+        } else {
+            t->body = rb->bufs;
+        }
+    }
+
+    task->event.data = r;
+    task->event.handler = njt_http_modsecurity_thread_event_handler;
+
+    if (njt_thread_task_post(mcf->thread_pool, task) != NJT_OK) {
+        return NJT_ERROR;
+    }
+
+    r->main->blocked++;
+    r->aio = 1;
+
+    ctx->offload = 1;
+    ctx->offload_busy = 1;
+    ctx->offload_phase = phase;
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_modsecurity_thread_handler(void *data, njt_log_t *log)
+{
+    njt_http_modsecurity_task_ctx_t *t = data;
+
+    size_t        size;
+    uint64_t      start;
+    njt_chain_t  *cl;
+
+    njt_log_debug1(NJT_LOG_DEBUG_CORE, log, 0,
+                   "modsecurity thread handler, phase: %ui", t->phase);
+
+    start = njt_http_modsecurity_usec();
+
+    switch (t->phase) {
+
+    case NJT_HTTP_MODSECURITY_PHASE_REQUEST_HEADERS:
+        msc_process_request_headers(t->transaction);
+        break;
+
+    case NJT_HTTP_MODSECURITY_PHASE_REQUEST_BODY:
+
+        if (t->file && t->limit) {
+            (void) njt_http_modsecurity_append_file(t->transaction, t->file,
+                                                    t->limit, &t->sent);
+            t->sampled = (t->size > (off_t) t->limit);
+
+        } else if (t->file) {
+            msc_request_body_from_file(t->transaction, t->file_name);
+            t->sent = (size_t) t->size;
+
+        } else {
+            for (cl = t->body; cl; cl = cl->next) {
+                size = cl->buf->last - cl->buf->pos;
+
+                if (t->limit && t->sent + size > t->limit) {
+                    size = t->limit - t->sent;
+                    t->sampled = 1;
+                }
+
+                if (size) {
+                    msc_append_request_body(t->transaction, cl->buf->pos,
+                                            size);
+                    t->sent += size;
+                }
+
+                if (cl->buf->last_buf || t->sampled) {
+                    break;
+                }
+            }
+        }
+
+        msc_process_request_body(t->transaction);
+        break;
+
+    case NJT_HTTP_MODSECURITY_PHASE_RESPONSE_BODY:
+        msc_process_response_body(t->transaction);
+        break;
+
+    default:
+        break;
+    }
+
+    t->usec = njt_http_modsecurity_usec() - start;
+}
+
+
+static void
+njt_http_modsecurity_thread_event_handler(njt_event_t *ev)
+{
+    njt_uint_t                        flags;
+    njt_connection_t                 *c;
+    njt_http_request_t               *r;
+    njt_http_modsecurity_ctx_t       *ctx;
+    njt_http_modsecurity_task_ctx_t  *t;
+
+    r = ev->data;
+    c = r->connection;
+
+    njt_http_set_log_request(c->log, r);
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "modsecurity thread: \"%V?%V\"", &r->uri, &r->args);
+
+    r->main->blocked--;
+    r->aio = 0;
+
+    ctx = njt_http_get_module_ctx(r, njt_http_modsecurity_module);
+
+    if (ctx && ctx->task) {
+        t = ctx->task->ctx;
+
+        ctx->offload_busy = 0;
+
+        flags = NJT_HTTP_MODSECURITY_OFFLOADED;
+
+        switch (t->phase) {
+
+        case NJT_HTTP_MODSECURITY_PHASE_REQUEST_BODY:
+            ctx->request_body_sent = t->sent;
+            break;
+
+        case NJT_HTTP_MODSECURITY_PHASE_RESPONSE_BODY:
+            t->sent = ctx->response_body_sent;
+            t->sampled = ctx->response_sampled;
+            break;
+        }
+
+        if (t->sampled) {
+            flags |= NJT_HTTP_MODSECURITY_SAMPLED;
+        }
+
+        njt_http_modsecurity_profile_add(r, t->phase, t->usec, t->sent, flags);
+    }
+
+#if (NJT_HTTP_V2)
+
+    if (r->stream) {
+        /*
+         * for HTTP/2, update write event to make sure processing will
+         * reach the main connection to flush the held response body
+         */
+
+        c->write->ready = 1;
+        c->write->active = 0;
+    }
+
+#endif
+
+    if (r->done) {
+        /*
+         * trigger connection event handler if the request was
+         * already finalized while ModSecurity was inspecting it
+         */
+
+        c->write->handler(c->write);
+
+    } else {
+        r->write_event_handler(r);
+        njt_http_run_posted_requests(c);
+    }
+}
+
+#endif
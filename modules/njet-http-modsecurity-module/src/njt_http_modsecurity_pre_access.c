@@ -21,6 +21,11 @@
 
 #include "njt_http_modsecurity_common.h"
 
+
+static njt_int_t njt_http_modsecurity_request_body_done(njt_http_request_t *r,
+    njt_http_modsecurity_ctx_t *ctx);
+
+
 void
 njt_http_modsecurity_request_read(njt_http_request_t *r)
 {
@@ -45,6 +50,7 @@ njt_int_t
 njt_http_modsecurity_pre_access_handler(njt_http_request_t *r)
 {
 #if 1
+    uint64_t                      start;
     njt_pool_t                   *old_pool;
     njt_http_modsecurity_ctx_t   *ctx;
     njt_http_modsecurity_conf_t  *mcf;
@@ -83,6 +89,20 @@ njt_http_modsecurity_pre_access_handler(njt_http_request_t *r)
         return NJT_DECLINED;
     }
 
+#if (NJT_THREADS)
+    if (ctx->offload
+        && ctx->offload_phase == NJT_HTTP_MODSECURITY_PHASE_REQUEST_BODY)
+    {
+        if (ctx->offload_busy) {
+            return NJT_DONE;
+        }
+
+        ctx->offload = 0;
+
+        return njt_http_modsecurity_request_body_done(r, ctx);
+    }
+#endif
+
     if (ctx->waiting_more_body == 1)
     {
         dd("waiting for more data before proceed. / count: %d",
@@ -140,6 +160,7 @@ njt_http_modsecurity_pre_access_handler(njt_http_request_t *r)
     {
         int ret = 0;
         int already_inspected = 0;
+        int sampled = 0;
 
         dd("request body is ready to be processed");
 
@@ -147,6 +168,32 @@ njt_http_modsecurity_pre_access_handler(njt_http_request_t *r)
 
         njt_chain_t *chain = r->request_body->bufs;
 
+#if (NJT_THREADS)
+        if (mcf->thread_pool) {
+            off_t size = 0;
+
+            for ( /* void */ ; chain; chain = chain->next) {
+                size += njt_buf_size(chain->buf);
+            }
+
+            if (mcf->body_sample && size > (off_t) mcf->body_sample) {
+                size = mcf->body_sample;
+            }
+
+            if (size >= (off_t) mcf->thread_min_body) {
+                if (njt_http_modsecurity_offload(r, ctx,
+                        NJT_HTTP_MODSECURITY_PHASE_REQUEST_BODY) != NJT_OK)
+                {
+                    return NJT_HTTP_INTERNAL_SERVER_ERROR;
+                }
+
+                return NJT_DONE;
+            }
+
+            chain = r->request_body->bufs;
+        }
+#endif
+
         /**
          * TODO: Speed up the analysis by sending chunk while they arrive.
          *
@@ -156,7 +203,27 @@ njt_http_modsecurity_pre_access_handler(njt_http_request_t *r)
          * function.
          */
 
-        if (r->request_body->temp_file != NULL) {
+        start = njt_http_modsecurity_profile_start(r);
+
+        if (r->request_body->temp_file != NULL && mcf->body_sample) {
+            /*
+             * Only the first modsecurity_body_sample bytes of the body
+             * are inspected, read them from the file ourselves.
+             */
+            dd("request body inspection: file sample");
+
+            if (njt_http_modsecurity_append_file(ctx->modsec_transaction,
+                    &r->request_body->temp_file->file, mcf->body_sample,
+                    &ctx->request_body_sent) != NJT_OK)
+            {
+                return NJT_HTTP_INTERNAL_SERVER_ERROR;
+            }
+
+            sampled = (r->request_body->temp_file->file.offset
+                       > (off_t) mcf->body_sample);
+            already_inspected = 1;
+
+        } else if (r->request_body->temp_file != NULL) {
             njt_str_t file_path = r->request_body->temp_file->file.name;
             const char *file_name = njt_str_to_char(file_path, r->pool);
             if (file_name == (char*)-1) {
@@ -170,6 +237,7 @@ njt_http_modsecurity_pre_access_handler(njt_http_request_t *r)
 
             msc_request_body_from_file(ctx->modsec_transaction, file_name);
 
+            ctx->request_body_sent = (size_t) r->request_body->temp_file->file.offset;
             already_inspected = 1;
         } else {
             dd("inspection request body in memory.");
@@ -178,11 +246,19 @@ njt_http_modsecurity_pre_access_handler(njt_http_request_t *r)
         while (chain && !already_inspected)
         {
             u_char *data = chain->buf->pos;
+            size_t size = chain->buf->last - data;
 
-            msc_append_request_body(ctx->modsec_transaction, data,
-                chain->buf->last - data);
+            if (mcf->body_sample
+                && ctx->request_body_sent + size > mcf->body_sample)
+            {
+                size = mcf->body_sample - ctx->request_body_sent;
+                sampled = 1;
+            }
 
-            if (chain->buf->last_buf) {
+            msc_append_request_body(ctx->modsec_transaction, data, size);
+            ctx->request_body_sent += size;
+
+            if (chain->buf->last_buf || sampled) {
                 break;
             }
             chain = chain->next;
@@ -213,13 +289,12 @@ njt_http_modsecurity_pre_access_handler(njt_http_request_t *r)
         msc_process_request_body(ctx->modsec_transaction);
         njt_http_modsecurity_pcre_malloc_done(old_pool);
 
-        ret = njt_http_modsecurity_process_intervention(ctx->modsec_transaction, r, 0);
-        if (r->error_page) {
-            return NJT_DECLINED;
-            }
-        if (ret > 0) {
-            return ret;
-        }
+        njt_http_modsecurity_profile_end(r,
+            NJT_HTTP_MODSECURITY_PHASE_REQUEST_BODY, start,
+            ctx->request_body_sent,
+            sampled ? NJT_HTTP_MODSECURITY_SAMPLED : 0);
+
+        return njt_http_modsecurity_request_body_done(r, ctx);
     }
 
     dd("Nothing to add on the body inspection, reclaiming a NJT_DECLINED");
@@ -227,3 +302,20 @@ njt_http_modsecurity_pre_access_handler(njt_http_request_t *r)
     return NJT_DECLINED;
 }
 
+
+static njt_int_t
+njt_http_modsecurity_request_body_done(njt_http_request_t *r,
+    njt_http_modsecurity_ctx_t *ctx)
+{
+    int ret;
+
+    ret = njt_http_modsecurity_process_intervention(ctx->modsec_transaction, r, 0);
+    if (r->error_page) {
+        return NJT_DECLINED;
+    }
+    if (ret > 0) {
+        return ret;
+    }
+
+    return NJT_DECLINED;
+}
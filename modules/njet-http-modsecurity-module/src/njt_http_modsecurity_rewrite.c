@@ -21,9 +21,15 @@
 
 #include "njt_http_modsecurity_common.h"
 
+
+static njt_int_t njt_http_modsecurity_request_headers_done(
+    njt_http_request_t *r, njt_http_modsecurity_ctx_t *ctx);
+
+
 njt_int_t
 njt_http_modsecurity_rewrite_handler(njt_http_request_t *r)
 {
+    uint64_t                      start;
     njt_pool_t                   *old_pool;
     njt_http_modsecurity_ctx_t   *ctx;
     njt_http_modsecurity_conf_t  *mcf;
@@ -98,6 +104,8 @@ njt_http_modsecurity_rewrite_handler(njt_http_request_t *r)
             return NJT_HTTP_INTERNAL_SERVER_ERROR;
         }
 
+        start = njt_http_modsecurity_profile_start(r);
+
         old_pool = njt_http_modsecurity_pcre_malloc_init(r->pool);
         ret = msc_process_connection(ctx->modsec_transaction,
             client_addr, client_port,
@@ -164,6 +172,9 @@ njt_http_modsecurity_rewrite_handler(njt_http_request_t *r)
         msc_process_uri(ctx->modsec_transaction, n_uri, n_method, http_version);
         njt_http_modsecurity_pcre_malloc_done(old_pool);
 
+        njt_http_modsecurity_profile_end(r, NJT_HTTP_MODSECURITY_PHASE_CONNECTION,
+                                         start, 0, 0);
+
         dd("Processing intervention with the transaction information filled in (uri, method and version)");
         ret = njt_http_modsecurity_process_intervention(ctx->modsec_transaction, r, 1);
         if (ret > 0) {
@@ -205,25 +216,69 @@ njt_http_modsecurity_rewrite_handler(njt_http_request_t *r)
                 data[i].value.len);
         }
 
+#if (NJT_THREADS)
+        if (mcf->thread_pool && mcf->thread_headers) {
+            if (njt_http_modsecurity_offload(r, ctx,
+                    NJT_HTTP_MODSECURITY_PHASE_REQUEST_HEADERS) != NJT_OK)
+            {
+                return NJT_HTTP_INTERNAL_SERVER_ERROR;
+            }
+
+            return NJT_DONE;
+        }
+#endif
+
         /**
          * Since ModSecurity already knew about all headers, i guess it is safe
          * to process this information.
          */
 
+        start = njt_http_modsecurity_profile_start(r);
+
         old_pool = njt_http_modsecurity_pcre_malloc_init(r->pool);
         msc_process_request_headers(ctx->modsec_transaction);
         njt_http_modsecurity_pcre_malloc_done(old_pool);
-        dd("Processing intervention with the request headers information filled in");
-        ret = njt_http_modsecurity_process_intervention(ctx->modsec_transaction, r, 1);
-        if (r->error_page) {
-            return NJT_DECLINED;
-            }
-        if (ret > 0) {
-            ctx->intervention_triggered = 1;
-            return ret;
+
+        njt_http_modsecurity_profile_end(r,
+                                         NJT_HTTP_MODSECURITY_PHASE_REQUEST_HEADERS,
+                                         start, 0, 0);
+
+        return njt_http_modsecurity_request_headers_done(r, ctx);
+    }
+
+#if (NJT_THREADS)
+    if (ctx->offload
+        && ctx->offload_phase == NJT_HTTP_MODSECURITY_PHASE_REQUEST_HEADERS)
+    {
+        if (ctx->offload_busy) {
+            return NJT_DONE;
         }
+
+        ctx->offload = 0;
+
+        return njt_http_modsecurity_request_headers_done(r, ctx);
     }
+#endif
+
+    return NJT_DECLINED;
+}
+
+
+static njt_int_t
+njt_http_modsecurity_request_headers_done(njt_http_request_t *r,
+    njt_http_modsecurity_ctx_t *ctx)
+{
+    int ret;
 
+    dd("Processing intervention with the request headers information filled in");
+    ret = njt_http_modsecurity_process_intervention(ctx->modsec_transaction, r, 1);
+    if (r->error_page) {
+        return NJT_DECLINED;
+    }
+    if (ret > 0) {
+        ctx->intervention_triggered = 1;
+        return ret;
+    }
 
     return NJT_DECLINED;
 }
@@ -225,6 +225,7 @@ typedef struct njt_http_upstream_api_peer_s {
 		njt_str_t    route;
 		njt_str_t    msg;
 	};
+	njt_str_t    zone_label;
 	njt_int_t   backup;
 	njt_int_t   drain;
 	njt_int_t   down;
@@ -359,6 +360,10 @@ static njt_int_t njt_http_upstream_api_create_dynamic_server(njt_http_request_t
 					njt_cpystrn(new_peer->route.data, peer->route.data, peer->route.len+1);
 				}
 			}
+			if(peer->zone_label.data != NULL) {
+				njt_http_upstream_set_peer_zone_label_locked(shpool, new_peer,
+						&peer->zone_label);
+			}
 			new_peer->next = NULL;
 			if(uclcf->peers_http->peer == NULL) {
 				uclcf->peers_http->peer = new_peer;
@@ -733,6 +738,10 @@ njt_http_upstream_api_compose_one_server_schemo(njt_http_request_t *r,
 	njt_str_copy_pool(r->pool,data,peer->route, return NULL;);
 
 	set_server_list_serverDef_route(server_one,&data);
+	if(peer->zone_label.len > 0) {
+		njt_str_copy_pool(r->pool,data,peer->zone_label, return NULL;);
+		set_server_list_serverDef_zone_label(server_one,&data);
+	}
 	set_server_list_serverDef_backup(server_one,(backup ? true : false));
 	set_server_list_serverDef_down(server_one,(peer->down == 1 ? true : false));
 	if(peer->hc_down/100 == 1) {
@@ -1255,6 +1264,12 @@ njt_http_upstream_api_json_2_peer(upstream_api_t *json_manager,
 			api_peer->route = *pdata;
 		}
 	}
+	if (json_manager->is_zone_label_set == 1) {
+		pdata = get_upstream_api_zone_label(json_manager);
+		if(pdata != NULL) {
+			api_peer->zone_label = *pdata;
+		}
+	}
 
 	rc = NJT_OK;
 
@@ -1486,6 +1501,14 @@ njt_http_upstream_api_patch(njt_http_request_t *r)
 
 
 
+	}
+	if (json_peer.zone_label.data != NULL) {
+		if (njt_http_upstream_set_peer_zone_label_locked(peers->shpool, peer,
+					&json_peer.zone_label) != NJT_OK)
+		{
+			njt_http_upstream_rr_peers_unlock(peers);
+			goto error;
+		}
 	}
 	if (json_peer.server.len  > 0 && u.naddrs > 0 ) {
 		if(peer->server.len < json_peer.server.len) {
@@ -1823,6 +1846,7 @@ njt_http_upstream_api_post(njt_http_request_t *r)
 			}
 			njt_cpystrn(new_peer.route.data, json_peer.route.data, json_peer.route.len + 1);
 		}
+		new_peer.zone_label = json_peer.zone_label;
 		njt_http_upstream_rr_peers_unlock(peers);
 
 		njt_http_upstream_api_create_dynamic_server(r,&new_peer,json_peer.backup);
@@ -1912,6 +1936,16 @@ njt_http_upstream_api_post(njt_http_request_t *r)
 		}
 		njt_cpystrn(peer->route.data, json_peer.route.data, json_peer.route.len + 1);
 
+		if (njt_http_upstream_set_peer_zone_label_locked(shpool, peer,
+					&json_peer.zone_label) != NJT_OK)
+		{
+			rc = NJT_HTTP_UPS_API_INTERNAL_ERROR;
+			njt_http_upstream_rr_peers_unlock(peers);
+			njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+					"peer zone_label allocate error.");
+			goto out;
+		}
+
 		target_peers = peers;
 
 		/*insert into the right peer list according to the backup value*/
@@ -2393,6 +2427,23 @@ out:
 
 
 
+static void
+njt_http_upstream_state_zone_label(u_char *info, size_t size, njt_str_t *label)
+{
+	size_t  len;
+
+	len = njt_strlen(info);
+
+	if (label->len == 0 || len < sizeof(";\r\n") - 1) {
+		return;
+	}
+
+	/* insert the label in front of the terminating ";\r\n" */
+	len -= sizeof(";\r\n") - 1;
+	njt_snprintf(info + len, size - 1 - len, " zone_label=%V;\r\n", label);
+}
+
+
 	static njt_int_t
 njt_http_upstream_state_save(njt_http_request_t *r,
 		void *cf)
@@ -2462,6 +2513,8 @@ njt_http_upstream_state_save(njt_http_request_t *r,
 					peer_data->max_fails, peer_data->fail_timeout,peer_data->slow_start);
 		}
 
+		njt_http_upstream_state_zone_label(server_info, 512,
+				&peer_data->zone_label);
 		len = njt_write_fd(fd, server_info, njt_strlen(server_info));
 		if (len == -1) {
 			njt_log_error(NJT_LOG_ALERT, njt_cycle->log, 0,
@@ -2500,6 +2553,8 @@ njt_http_upstream_state_save(njt_http_request_t *r,
 						peer_data->max_fails, peer_data->fail_timeout,peer_data->slow_start);
 			}
 
+			njt_http_upstream_state_zone_label(server_info, 512,
+					&peer_data->zone_label);
 			len = njt_write_fd(fd, server_info, njt_strlen(server_info));
 			if (len == -1) {
 				njt_log_error(NJT_LOG_ALERT, njt_cycle->log, 0,
@@ -2535,6 +2590,8 @@ njt_http_upstream_state_save(njt_http_request_t *r,
 					peer_data->max_fails, peer_data->fail_timeout,peer_data->slow_start,peer_data->set_backup > 0? "backup" : "");
 		}
 
+		njt_http_upstream_state_zone_label(server_info, 512,
+				&peer_data->zone_label);
 		len = njt_write_fd(fd, server_info, njt_strlen(server_info));
 		if (len == -1) {
 			njt_log_error(NJT_LOG_ALERT, njt_cycle->log, 0,
@@ -2560,6 +2617,8 @@ njt_http_upstream_state_save(njt_http_request_t *r,
 					json_peer.down ? "down" : "",
 					json_peer.max_fails, json_peer.fail_timeout,json_peer.slow_start,json_peer.backup > 0? "backup" : "");
 		}
+		njt_http_upstream_state_zone_label(server_info, 512,
+				&json_peer.zone_label);
 		len = njt_write_fd(fd, server_info, njt_strlen(server_info));
 		if (len == -1) {
 			njt_log_error(NJT_LOG_ALERT, njt_cycle->log, 0,
@@ -2588,6 +2647,579 @@ failed:
 }
 
 
+typedef struct {
+	njt_str_t                      server;
+	njt_str_t                      route;
+	njt_str_t                      zone_label;
+	njt_addr_t                    *addr;
+	njt_int_t                      weight;
+	njt_int_t                      max_conns;
+	njt_int_t                      max_fails;
+	njt_int_t                      fail_timeout;
+	njt_int_t                      slow_start;
+	njt_uint_t                     backup;
+	njt_uint_t                     down;
+	njt_flag_t                     fresh;
+	njt_http_upstream_rr_peer_t   *peer;
+} njt_http_upstream_api_put_peer_t;
+
+
+/*
+ * converts the body of PUT /upstreams/<name>/servers into the wanted peer
+ * set.  Only servers given as an address are accepted, resolved servers
+ * keep being managed by POST and DELETE.
+ */
+	static njt_int_t
+njt_http_upstream_api_put_parse(njt_http_request_t *r,
+		server_list_t *server_list, njt_array_t *set)
+{
+	u_char                            *last;
+	size_t                             i, j;
+	njt_str_t                         *pdata;
+	njt_url_t                          u;
+	njt_http_upstream_api_ctx_t       *ctx;
+	njt_http_upstream_srv_conf_t      *uscf;
+	server_list_serverDef_t           *item;
+	njt_http_upstream_api_put_peer_t  *pp, *dup;
+
+	ctx = njt_http_get_module_ctx(r, njt_http_upstream_api_module);
+
+	for (i = 0; i < server_list->nelts; i++) {
+		item = get_server_list_item(server_list, i);
+
+		pp = njt_array_push(set);
+		if (pp == NULL) {
+			return NJT_HTTP_UPS_API_INTERNAL_ERROR;
+		}
+
+		njt_memzero(pp, sizeof(njt_http_upstream_api_put_peer_t));
+		pp->weight = 1;
+		pp->max_fails = 1;
+		pp->fail_timeout = 10;
+
+		pdata = item->is_server_set ? get_server_list_serverDef_server(item)
+			: NULL;
+		if (pdata == NULL || pdata->len == 0) {
+			return NJT_HTTP_UPS_API_MISS_SRV;
+		}
+
+		pp->server = *pdata;
+
+		if (item->is_weight_set) {
+			pp->weight = get_server_list_serverDef_weight(item);
+			if (pp->weight <= 0) {
+				return NJT_HTTP_UPS_API_WEIGHT_ERROR;
+			}
+		}
+
+		if (item->is_max_conns_set) {
+			pp->max_conns = get_server_list_serverDef_max_conns(item);
+		}
+
+		if (item->is_max_fails_set) {
+			pp->max_fails = get_server_list_serverDef_max_fails(item);
+		}
+
+		if (item->is_fail_timeout_set) {
+			pp->fail_timeout = njt_parse_time(
+					get_server_list_serverDef_fail_timeout(item), 1);
+		}
+
+		if (item->is_slow_start_set) {
+			pp->slow_start = njt_parse_time(
+					get_server_list_serverDef_slow_start(item), 1);
+		}
+
+		if (pp->max_conns < 0 || pp->max_fails < 0
+				|| pp->fail_timeout == NJT_ERROR || pp->slow_start == NJT_ERROR)
+		{
+			return NJT_HTTP_UPS_API_INVALID_SRV_ARG;
+		}
+
+		if (item->is_route_set) {
+			pp->route = *get_server_list_serverDef_route(item);
+			if (pp->route.len > 32) {
+				return NJT_HTTP_UPS_API_ROUTE_INVALID_LEN;
+			}
+		}
+
+		if (item->is_zone_label_set) {
+			pp->zone_label = *get_server_list_serverDef_zone_label(item);
+		}
+
+		if (item->is_backup_set && get_server_list_serverDef_backup(item)) {
+			uscf = ctx->uscf;
+			if (!(uscf->flags & NJT_HTTP_UPSTREAM_BACKUP)) {
+				return NJT_HTTP_UPS_API_HAS_NO_BACKUP;
+			}
+			pp->backup = 1;
+		}
+
+		if (item->is_down_set && get_server_list_serverDef_down(item)) {
+			pp->down = 1;
+		}
+
+		njt_memzero(&u, sizeof(njt_url_t));
+		u.url = pp->server;
+		u.default_port = 80;
+		u.no_resolve = 1;
+
+		if (njt_parse_url(r->pool, &u) != NJT_OK || u.naddrs != 1) {
+			return NJT_HTTP_UPS_API_NOT_SUPPORTED_SRV;
+		}
+
+		pp->addr = &u.addrs[0];
+
+		last = pp->server.data + pp->server.len;
+		if (njt_strlchr(pp->server.data, last, ':') == NULL
+				|| pp->server.data[pp->server.len - 1] == ']')
+		{
+			pp->server = pp->addr->name;
+		}
+
+		for (j = 0; j < i; j++) {
+			dup = (njt_http_upstream_api_put_peer_t *) set->elts + j;
+
+			if (njt_cmp_sockaddr(dup->addr->sockaddr, dup->addr->socklen,
+						pp->addr->sockaddr, pp->addr->socklen, 1) == NJT_OK
+					&& dup->route.len == pp->route.len
+					&& njt_strncmp(dup->route.data, pp->route.data,
+						pp->route.len) == 0)
+			{
+				return NJT_HTTP_UPS_API_INVALID_SRV_ARG;
+			}
+		}
+	}
+
+	return NJT_OK;
+}
+
+
+	static njt_http_upstream_rr_peer_t *
+njt_http_upstream_api_put_alloc_peer(njt_slab_pool_t *shpool,
+		njt_http_upstream_api_put_peer_t *pp)
+{
+	njt_http_upstream_rr_peer_t  *peer;
+
+	peer = njt_slab_calloc_locked(shpool, sizeof(njt_http_upstream_rr_peer_t));
+	if (peer == NULL) {
+		return NULL;
+	}
+
+	peer->server.data = njt_slab_alloc_locked(shpool, pp->server.len);
+	peer->name.data = njt_slab_alloc_locked(shpool, pp->addr->name.len);
+	peer->sockaddr = njt_slab_alloc_locked(shpool, pp->addr->socklen);
+
+	if (peer->server.data == NULL || peer->name.data == NULL
+			|| peer->sockaddr == NULL)
+	{
+		goto failed;
+	}
+
+	if (pp->route.len) {
+		peer->route.data = njt_slab_alloc_locked(shpool, pp->route.len);
+		if (peer->route.data == NULL) {
+			goto failed;
+		}
+
+		peer->route.len = pp->route.len;
+		njt_memcpy(peer->route.data, pp->route.data, pp->route.len);
+	}
+
+	if (njt_http_upstream_set_peer_zone_label_locked(shpool, peer,
+				&pp->zone_label) != NJT_OK)
+	{
+		goto failed;
+	}
+
+	peer->server.len = pp->server.len;
+	njt_memcpy(peer->server.data, pp->server.data, pp->server.len);
+	peer->name.len = pp->addr->name.len;
+	njt_memcpy(peer->name.data, pp->addr->name.data, pp->addr->name.len);
+	peer->socklen = pp->addr->socklen;
+	njt_memcpy(peer->sockaddr, pp->addr->sockaddr, pp->addr->socklen);
+
+	return peer;
+
+failed:
+
+	njt_http_upstream_free_peer_memory(shpool, peer);
+
+	return NULL;
+}
+
+
+	static void
+njt_http_upstream_api_put_update_peer(njt_http_upstream_rr_peer_t *peer,
+		njt_http_upstream_api_put_peer_t *pp)
+{
+	if (peer->weight != pp->weight) {
+		peer->weight = pp->weight;
+		peer->effective_weight = pp->weight;
+		peer->rr_effective_weight = pp->weight * NJT_WEIGHT_POWER;
+	}
+
+	peer->max_conns = pp->max_conns;
+	peer->max_fails = pp->max_fails;
+	peer->fail_timeout = pp->fail_timeout;
+	peer->slow_start = pp->slow_start;
+	peer->down = pp->down;
+	peer->del_pending = 0;
+}
+
+
+	static void
+njt_http_upstream_api_put_count(njt_http_upstream_rr_peers_t *peers)
+{
+	njt_uint_t                    n, w, t;
+	njt_http_upstream_rr_peer_t  *peer;
+
+	n = 0;
+	w = 0;
+	t = 0;
+
+	for (peer = peers->peer; peer; peer = peer->next) {
+		n++;
+		w += peer->weight;
+
+		if (!peer->down) {
+			t++;
+		}
+	}
+
+	peers->number = n;
+	peers->total_weight = w;
+	peers->tries = t;
+	peers->weighted = (w != n);
+	peers->single = (n <= 1);
+}
+
+
+/*
+ * replaces the address servers of an upstream with the given set:
+ * servers found with the same address and route keep their statistics
+ * and health state and only get their parameters updated, new ones are
+ * appended, and missing ones are removed (or drained while they still
+ * have connections).  Everything is done under one write lock and
+ * update_id is bumped once.
+ */
+	static njt_int_t
+njt_http_upstream_api_put_apply(njt_http_request_t *r, njt_array_t *set)
+{
+	njt_int_t                          rc;
+	njt_uint_t                         i, b;
+	njt_slab_pool_t                   *shpool;
+	njt_http_upstream_rr_peer_t       *peer, **pp;
+	njt_http_upstream_rr_peers_t      *peers, *list;
+	njt_http_upstream_api_ctx_t       *ctx;
+	njt_http_upstream_api_put_peer_t  *want;
+
+	ctx = njt_http_get_module_ctx(r, njt_http_upstream_api_module);
+	peers = ctx->peers;
+	shpool = peers->shpool;
+	want = set->elts;
+
+	njt_http_upstream_rr_peers_wlock(peers);
+
+	/* match the current servers against the wanted ones */
+
+	for (b = 0; b < 2; b++) {
+		list = b ? peers->next : peers;
+		if (list == NULL) {
+			continue;
+		}
+
+		for (peer = list->peer; peer; peer = peer->next) {
+			if (peer->parent_id != -1) {
+				continue;
+			}
+
+			for (i = 0; i < set->nelts; i++) {
+				if (want[i].peer == NULL
+						&& want[i].backup == b
+						&& want[i].route.len == peer->route.len
+						&& njt_strncmp(want[i].route.data, peer->route.data,
+							peer->route.len) == 0
+						&& njt_cmp_sockaddr(want[i].addr->sockaddr,
+							want[i].addr->socklen, peer->sockaddr,
+							peer->socklen, 1) == NJT_OK)
+				{
+					want[i].peer = peer;
+					break;
+				}
+			}
+		}
+	}
+
+	/* allocate the new servers before anything is changed */
+
+	njt_shmtx_lock(&shpool->mutex);
+
+	for (i = 0; i < set->nelts; i++) {
+		if (want[i].peer) {
+			continue;
+		}
+
+		if (want[i].backup && peers->next == NULL) {
+			goto failed;
+		}
+
+		peer = njt_http_upstream_api_put_alloc_peer(shpool, &want[i]);
+		if (peer == NULL) {
+			goto failed;
+		}
+
+		peer->id = peers->next_order++;
+		peer->parent_id = -1;
+		peer->hc_down = ctx->hc_type;
+		peer->hc_upstart = njt_time();
+
+		want[i].peer = peer;
+		want[i].fresh = 1;
+		njt_http_upstream_api_put_update_peer(peer, &want[i]);
+	}
+
+	njt_shmtx_unlock(&shpool->mutex);
+
+	/* apply */
+
+	for (b = 0; b < 2; b++) {
+		list = b ? peers->next : peers;
+		if (list == NULL) {
+			continue;
+		}
+
+		for (pp = &list->peer; *pp; /* void */) {
+			peer = *pp;
+
+			if (peer->parent_id != -1) {
+				pp = &peer->next;
+				continue;
+			}
+
+			for (i = 0; i < set->nelts; i++) {
+				if (want[i].peer == peer) {
+					break;
+				}
+			}
+
+			if (i < set->nelts) {
+				njt_http_upstream_api_put_update_peer(peer, &want[i]);
+
+				njt_shmtx_lock(&shpool->mutex);
+
+				rc = njt_http_upstream_set_peer_zone_label_locked(shpool, peer,
+						&want[i].zone_label);
+
+				njt_shmtx_unlock(&shpool->mutex);
+
+				if (rc != NJT_OK) {
+					njt_log_error(NJT_LOG_WARN, njt_cycle->log, 0,
+							"upstream api: zone_label of \"%V\" not updated",
+							&peer->server);
+				}
+
+				pp = &peer->next;
+				continue;
+			}
+
+			if (peer->conns) {
+				peer->down = 1;
+				peer->del_pending = 1;
+				pp = &peer->next;
+				continue;
+			}
+
+			*pp = peer->next;
+
+			njt_shmtx_lock(&shpool->mutex);
+			njt_http_upstream_free_peer_memory(shpool, peer);
+			njt_shmtx_unlock(&shpool->mutex);
+		}
+
+		for (i = 0; i < set->nelts; i++) {
+			if (want[i].backup != b || !want[i].fresh) {
+				continue;
+			}
+
+			*pp = want[i].peer;
+			pp = &want[i].peer->next;
+		}
+
+		njt_http_upstream_api_put_count(list);
+	}
+
+	peers->single = (peers->number
+			+ (peers->next ? peers->next->number : 0) <= 1);
+	peers->update_id++;
+
+	njt_http_upstream_rr_peers_unlock(peers);
+
+	return NJT_OK;
+
+failed:
+
+	for (i = 0; i < set->nelts; i++) {
+		if (want[i].fresh) {
+			njt_http_upstream_free_peer_memory(shpool, want[i].peer);
+		}
+	}
+
+	njt_shmtx_unlock(&shpool->mutex);
+	njt_http_upstream_rr_peers_unlock(peers);
+
+	njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+			"upstream api: peer allocate error.");
+
+	return NJT_HTTP_UPS_API_INTERNAL_ERROR;
+}
+
+
+	static void
+njt_http_upstream_api_put(njt_http_request_t *r)
+{
+	njt_int_t                          rc;
+	ssize_t                            len;
+	njt_str_t                          json_str;
+	njt_str_t                         *to_json;
+	njt_chain_t                        out;
+	njt_array_t                        set;
+	server_list_t                     *server_list;
+	js2c_parse_error_t                 err_code;
+	njt_http_upstream_api_ctx_t       *ctx;
+
+	ctx = njt_http_get_module_ctx(r, njt_http_upstream_api_module);
+
+	out.next = NULL;
+	out.buf = NULL;
+
+	njt_memzero(&json_peer, sizeof(njt_http_upstream_api_peer_t));
+
+	rc = njt_http_util_read_request_body(r, &json_str,
+			MIN_UPSTREAM_API_BODY_LEN, MAX_UPSTREAM_API_BODY_LEN);
+	if (rc == NJT_ERROR) {
+		rc = NJT_HTTP_UPS_API_INVALID_JSON_PARSE;
+		goto out;
+	}
+
+	server_list = json_parse_server_list(r->pool, &json_str, &err_code);
+	if (server_list == NULL) {
+		rc = NJT_HTTP_UPS_API_INVALID_JSON_PARSE;
+		json_peer.msg = err_code.err_str;
+		goto out;
+	}
+
+	if (njt_array_init(&set, r->pool, server_list->nelts ? server_list->nelts : 1,
+				sizeof(njt_http_upstream_api_put_peer_t)) != NJT_OK)
+	{
+		rc = NJT_HTTP_UPS_API_INTERNAL_ERROR;
+		goto out;
+	}
+
+	rc = njt_http_upstream_api_put_parse(r, server_list, &set);
+	if (rc != NJT_OK) {
+		goto out;
+	}
+
+	rc = njt_http_upstream_api_put_apply(r, &set);
+	if (rc != NJT_OK) {
+		goto out;
+	}
+
+	njt_http_upstream_state_save(r, ctx->uscf);
+
+	server_list = create_server_list(r->pool, 4);
+	if (server_list == NULL) {
+		rc = NJT_HTTP_UPS_API_INTERNAL_ERROR;
+		goto out;
+	}
+
+	rc = njt_http_upstream_api_compose_all_server(r, ctx->peers, server_list);
+	if (rc != NJT_OK) {
+		rc = NJT_HTTP_UPS_API_INTERNAL_ERROR;
+		goto out;
+	}
+
+	to_json = to_json_server_list(r->pool, server_list,
+			OMIT_NULL_ARRAY | OMIT_NULL_OBJ | OMIT_NULL_STR);
+	rc = njt_http_upstream_api_packet_out(r, to_json, &out);
+	if (rc != NJT_OK) {
+		goto error;
+	}
+
+	r->headers_out.status = NJT_HTTP_OK;
+
+	goto send;
+
+out:
+
+	rc = njt_http_upstream_api_err_out(r, rc, &json_peer.msg, &out);
+	if (rc != NJT_OK) {
+		goto error;
+	}
+
+send:
+
+	r->headers_out.content_type_len = sizeof("text/plain") - 1;
+	njt_str_set(&r->headers_out.content_type, "text/plain");
+	r->headers_out.content_type_lowcase = NULL;
+
+	len = njt_http_upstream_api_out_len(&out);
+	r->headers_out.content_length_n = len;
+
+	if (r->headers_out.content_length) {
+		r->headers_out.content_length->hash = 0;
+		r->headers_out.content_length = NULL;
+	}
+
+	rc = njt_http_send_header(r);
+	if (rc == NJT_ERROR || rc > NJT_OK || r->header_only) {
+		njt_http_finalize_request(r, rc);
+		return;
+	}
+
+	rc = njt_http_output_filter(r, &out);
+	njt_http_finalize_request(r, rc);
+	return;
+
+error:
+	njt_http_finalize_request(r, NJT_HTTP_INTERNAL_SERVER_ERROR);
+	return;
+}
+
+
+	static njt_int_t
+njt_http_upstream_api_process_put(njt_http_request_t *r,
+		void *cf)
+{
+	njt_int_t                          rc;
+	njt_http_upstream_api_ctx_t       *ctx;
+	njt_http_upstream_srv_conf_t *uscf = cf;
+
+	ctx = njt_pcalloc(r->pool, sizeof(njt_http_upstream_api_ctx_t));
+	if (ctx == NULL) {
+		njt_http_discard_request_body(r);
+		njt_log_error(NJT_LOG_ERR, njt_cycle->log, 0,
+				"upstream api ctx allocate error.");
+		return NJT_HTTP_INTERNAL_SERVER_ERROR;
+	}
+
+	ctx->peers = (njt_http_upstream_rr_peers_t *)uscf->peer.data;
+	ctx->uscf  = uscf;
+	ctx->resolver = uscf->resolver;
+	ctx->keep_alive = uscf->set_keep_alive;
+	ctx->hc_type  = (uscf->hc_type == 0 ?0:2);
+	njt_http_set_ctx(r, ctx, njt_http_upstream_api_module);
+
+	rc = njt_http_read_client_request_body(r, njt_http_upstream_api_put);
+	if (rc >= NJT_HTTP_SPECIAL_RESPONSE) {
+		/* error */
+		return rc;
+	}
+	return NJT_DONE;
+}
+
+
 	static njt_int_t
 njt_upstream_api_params_check(njt_array_t *path, njt_http_request_t *r, njt_str_t *upstream,
 		njt_str_t *id, void **target_uscf, ssize_t *server_id,
@@ -2606,16 +3238,18 @@ njt_upstream_api_params_check(njt_array_t *path, njt_http_request_t *r, njt_str_
 	*target_uscf = NULL;
 	*server_id = -1;
 
-	/*upstream must have value for post patch and delete*/
-	if (r->method & (NJT_HTTP_POST | NJT_HTTP_PATCH | NJT_HTTP_DELETE)) {
+	/*upstream must have value for post put patch and delete*/
+	if (r->method & (NJT_HTTP_POST | NJT_HTTP_PUT | NJT_HTTP_PATCH
+				| NJT_HTTP_DELETE))
+	{
 		if (upstream->data == NULL || upstream->len == 0) {
 			rc = NJT_HTTP_UPS_API_METHOD_NOT_SUPPORTED;
 			return rc;
 		}
 	}
 
-	/*id must not have value for post*/
-	if (r->method == NJT_HTTP_POST) {
+	/*id must not have value for post and put*/
+	if (r->method & (NJT_HTTP_POST | NJT_HTTP_PUT)) {
 		if (id->data || id->len) {
 			rc = NJT_HTTP_UPS_API_METHOD_NOT_SUPPORTED;
 			return rc;
@@ -2749,7 +3383,7 @@ njt_upstream_api_process_request(njt_http_request_t *r, njt_array_t *path,
 		njt_http_discard_request_body(r);
 		return rc;
 	}
-	if (r->method == NJT_HTTP_POST && path->nelts < 5){
+	if ((r->method & (NJT_HTTP_POST | NJT_HTTP_PUT)) && path->nelts < 5){
 		rc = NJT_HTTP_UPS_API_PERM_NOT_ALLOWED;
 		return rc;
 
@@ -2826,6 +3460,17 @@ njt_upstream_api_process_request(njt_http_request_t *r, njt_array_t *path,
 			} 
 			break;
 
+		case NJT_HTTP_PUT:
+			if(upstream_type != 1) {
+				rc = NJT_HTTP_UPS_API_METHOD_NOT_SUPPORTED;
+				njt_http_discard_request_body(r);
+				break;
+			}
+			/* the state file is saved once the body is applied */
+			rc = njt_http_upstream_api_process_put(r, uscf);
+			*if_send = 0;
+			return rc;
+
 
 		default:
 			rc = NJT_HTTP_UPS_API_METHOD_NOT_SUPPORTED;
@@ -3202,7 +3847,7 @@ njt_http_upstream_api_handler(njt_http_request_t *r)
 	uclcf->write = 1;
 	if (uclcf->write == NJT_CONF_UNSET_UINT || uclcf->write == 0) {
 		if (r->method == NJT_HTTP_POST || r->method == NJT_HTTP_DELETE
-				|| r->method == NJT_HTTP_PATCH) {
+				|| r->method == NJT_HTTP_PATCH || r->method == NJT_HTTP_PUT) {
 			rc = NJT_HTTP_UPS_API_PERM_NOT_ALLOWED;
 			goto out;
 		}
@@ -156,6 +156,21 @@ static bool parse_upstream_api(njt_pool_t *pool, parse_state_t *parse_state, ups
             }
             out->is_route_set = 1;
             parse_state->current_key = saved_key;
+        } else if (current_string_is(parse_state, "zone_label")) {
+            js2c_check_field_set(out->is_zone_label_set);
+            parse_state->current_token += 1;
+            const char* saved_key = parse_state->current_key;
+            parse_state->current_key = "zone_label";
+            js2c_null_check();
+            int token_size =  CURRENT_STRING_LENGTH(parse_state) ;
+            ((&out->zone_label))->data = (u_char*)njt_pcalloc(pool, (size_t)(token_size + 1));
+            js2c_malloc_check(((&out->zone_label))->data);
+            ((&out->zone_label))->len = token_size;
+            if (builtin_parse_string(pool, parse_state, (&out->zone_label), 0, 32, err_ret)) {
+                return true;
+            }
+            out->is_zone_label_set = 1;
+            parse_state->current_key = saved_key;
         } else {
             LOG_ERROR_JSON_PARSE(UNKNOWN_FIELD_ERR, parse_state->current_key, CURRENT_TOKEN(parse_state).start, "Unknown field in '%s': %.*s", parse_state->current_key, CURRENT_STRING_FOR_ERROR(parse_state));
             return true;
@@ -239,6 +254,19 @@ static bool parse_upstream_api(njt_pool_t *pool, parse_state_t *parse_state, ups
             njt_memcpy(out->route.data, "", token_size);
         }
     }
+    // set default
+    if (!out->is_zone_label_set) {
+        size_t token_size = strlen("");
+        (out->zone_label).data = (u_char*)njt_pcalloc(pool, token_size + 1);
+        js2c_malloc_check((out->zone_label).data);
+        (out->zone_label).len = token_size;
+        if (out->zone_label.len == 0) {
+            (out->zone_label).data[0] = 0;
+        }
+        if (token_size > 0) {
+            njt_memcpy(out->zone_label.data, "", token_size);
+        }
+    }
     parse_state->current_token = saved_current_token;
     return false;
 }
@@ -309,6 +337,11 @@ static void get_json_length_upstream_api_route(njt_pool_t *pool, upstream_api_ro
     *length += dst->len + 2; //  "str" 
 }
 
+static void get_json_length_upstream_api_zone_label(njt_pool_t *pool, upstream_api_zone_label_t *out, size_t *length, njt_int_t flags) {
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    *length += dst->len + 2; //  "str" 
+}
+
 static void get_json_length_upstream_api(njt_pool_t *pool, upstream_api_t *out, size_t *length, njt_int_t flags) {
     if (out == NULL) {
         *length += 4; // null
@@ -401,6 +434,15 @@ static void get_json_length_upstream_api(njt_pool_t *pool, upstream_api_t *out,
         *length += 1; // ","
         count++;
     }
+    omit = 0;
+    omit = out->is_zone_label_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->zone_label.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        *length += (10 + 3); // "zone_label": 
+        get_json_length_upstream_api_zone_label(pool, (&out->zone_label), length, flags);
+        *length += 1; // ","
+        count++;
+    }
     if (count != 0) {
         *length -= 1; // "\b"
     }
@@ -446,6 +488,9 @@ upstream_api_slow_start_t* get_upstream_api_slow_start(upstream_api_t *out) {
 upstream_api_route_t* get_upstream_api_route(upstream_api_t *out) {
     return &out->route;
 }
+upstream_api_zone_label_t* get_upstream_api_zone_label(upstream_api_t *out) {
+    return &out->zone_label;
+}
 void set_upstream_api_server(upstream_api_t* obj, upstream_api_server_t* field) {
     njt_memcpy(&obj->server, field, sizeof(njt_str_t));
     obj->is_server_set = 1;
@@ -486,6 +531,10 @@ void set_upstream_api_route(upstream_api_t* obj, upstream_api_route_t* field) {
     njt_memcpy(&obj->route, field, sizeof(njt_str_t));
     obj->is_route_set = 1;
 }
+void set_upstream_api_zone_label(upstream_api_t* obj, upstream_api_zone_label_t* field) {
+    njt_memcpy(&obj->zone_label, field, sizeof(njt_str_t));
+    obj->is_zone_label_set = 1;
+}
 upstream_api_t* create_upstream_api(njt_pool_t *pool) {
     upstream_api_t* out = njt_pcalloc(pool, sizeof(upstream_api_t));
     return out;
@@ -570,6 +619,13 @@ static void to_oneline_json_upstream_api_route(njt_pool_t *pool, upstream_api_ro
     buf->len = cur - buf->data;
 }
 
+static void to_oneline_json_upstream_api_zone_label(njt_pool_t *pool, upstream_api_zone_label_t *out, njt_str_t *buf, njt_int_t flags) {
+    u_char* cur = buf->data + buf->len;
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    cur = njt_sprintf(cur, "\"%V\"", dst);
+    buf->len = cur - buf->data;
+}
+
 static void to_oneline_json_upstream_api(njt_pool_t *pool, upstream_api_t *out, njt_str_t* buf, njt_int_t flags) {
     njt_int_t omit;
     u_char* cur = buf->data + buf->len;
@@ -684,6 +740,17 @@ static void to_oneline_json_upstream_api(njt_pool_t *pool, upstream_api_t *out,
         cur = njt_sprintf(cur, ",");
         buf->len ++;
     }
+    omit = 0;
+    omit = out->is_zone_label_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->zone_label.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        cur = njt_sprintf(cur, "\"zone_label\":");
+        buf->len = cur - buf->data;
+        to_oneline_json_upstream_api_zone_label(pool, (&out->zone_label), buf, flags);
+        cur = buf->data + buf->len;
+        cur = njt_sprintf(cur, ",");
+        buf->len ++;
+    }
     cur--;
     if (cur[0] == ',') {
         buf->len --;
@@ -147,6 +147,21 @@
             }
             out->is_route_set = 1;
             parse_state->current_key = saved_key;
+        } else if (current_string_is(parse_state, "zone_label")) {
+            js2c_check_field_set(out->is_zone_label_set);
+            parse_state->current_token += 1;
+            const char* saved_key = parse_state->current_key;
+            parse_state->current_key = "zone_label";
+            js2c_null_check();
+            int token_size =  CURRENT_STRING_LENGTH(parse_state) ;
+            ((&out->zone_label))->data = (u_char*)njt_pcalloc(pool, (size_t)(token_size + 1));
+            js2c_malloc_check(((&out->zone_label))->data);
+            ((&out->zone_label))->len = token_size;
+            if (builtin_parse_string(pool, parse_state, (&out->zone_label), 0, ((&out->zone_label))->len, err_ret)) {
+                return true;
+            }
+            out->is_zone_label_set = 1;
+            parse_state->current_key = saved_key;
         } else if (current_string_is(parse_state, "backup")) {
             js2c_check_field_set(out->is_backup_set);
             parse_state->current_token += 1;
@@ -228,6 +243,19 @@
         }
     }
     // set default
+    if (!out->is_zone_label_set) {
+        size_t token_size = strlen("");
+        (out->zone_label).data = (u_char*)njt_pcalloc(pool, token_size + 1);
+        js2c_malloc_check((out->zone_label).data);
+        (out->zone_label).len = token_size;
+        if (out->zone_label.len == 0) {
+            (out->zone_label).data[0] = 0;
+        }
+        if (token_size > 0) {
+            njt_memcpy(out->zone_label.data, "", token_size);
+        }
+    }
+    // set default
     if (!out->is_parent_set) {
         out->parent = 0LL;
     }
@@ -306,6 +334,11 @@ static void get_json_length_server_list_serverDef_route(njt_pool_t *pool, server
     *length += dst->len + 2; //  "str" 
 }
 
+static void get_json_length_server_list_serverDef_zone_label(njt_pool_t *pool, server_list_serverDef_zone_label_t *out, size_t *length, njt_int_t flags) {
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    *length += dst->len + 2; //  "str" 
+}
+
 static void get_json_length_server_list_serverDef_backup(njt_pool_t *pool, server_list_serverDef_backup_t *out, size_t *length, njt_int_t flags) {
     if (*out) {
         *length += 4; // "true"
@@ -428,6 +461,15 @@ static void get_json_length_server_list_serverDef_drain(njt_pool_t *pool, server
         count++;
     }
     omit = 0;
+    omit = out->is_zone_label_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->zone_label.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        *length += (10 + 3); // "zone_label": 
+        get_json_length_server_list_serverDef_zone_label(pool, (&out->zone_label), length, flags);
+        *length += 1; // ","
+        count++;
+    }
+    omit = 0;
     omit = out->is_backup_set ? 0 : 1;
     if (omit == 0) {
         *length += (6 + 3); // "backup": 
@@ -509,6 +551,9 @@ server_list_serverDef_slow_start_t* get_server_list_serverDef_slow_start(server_
 server_list_serverDef_route_t* get_server_list_serverDef_route(server_list_serverDef_t *out) {
     return &out->route;
 }
+server_list_serverDef_zone_label_t* get_server_list_serverDef_zone_label(server_list_serverDef_t *out) {
+    return &out->zone_label;
+}
 
 server_list_serverDef_backup_t get_server_list_serverDef_backup(server_list_serverDef_t *out) {
     return out->backup;
@@ -565,6 +610,10 @@ void set_server_list_serverDef_route(server_list_serverDef_t* obj, server_list_s
     njt_memcpy(&obj->route, field, sizeof(njt_str_t));
     obj->is_route_set = 1;
 }
+void set_server_list_serverDef_zone_label(server_list_serverDef_t* obj, server_list_serverDef_zone_label_t* field) {
+    njt_memcpy(&obj->zone_label, field, sizeof(njt_str_t));
+    obj->is_zone_label_set = 1;
+}
 void set_server_list_serverDef_backup(server_list_serverDef_t* obj, server_list_serverDef_backup_t field) {
     obj->backup = field;
     obj->is_backup_set = 1;
@@ -649,6 +698,13 @@ static void to_oneline_json_server_list_serverDef_route(njt_pool_t *pool, server
     buf->len = cur - buf->data;
 }
 
+static void to_oneline_json_server_list_serverDef_zone_label(njt_pool_t *pool, server_list_serverDef_zone_label_t *out, njt_str_t *buf, njt_int_t flags) {
+    u_char* cur = buf->data + buf->len;
+    njt_str_t *dst = handle_escape_on_write(pool, out);
+    cur = njt_sprintf(cur, "\"%V\"", dst);
+    buf->len = cur - buf->data;
+}
+
 static void to_oneline_json_server_list_serverDef_backup(njt_pool_t *pool, server_list_serverDef_backup_t *out, njt_str_t *buf, njt_int_t flags) {
     u_char* cur = buf->data + buf->len;
     if (*out) {
@@ -801,6 +857,17 @@ static void to_oneline_json_server_list_serverDef_drain(njt_pool_t *pool, server
         buf->len ++;
     }
     omit = 0;
+    omit = out->is_zone_label_set ? 0 : 1;
+    omit = (flags & OMIT_NULL_STR) && (out->zone_label.data) == NULL ? 1 : omit;
+    if (omit == 0) {
+        cur = njt_sprintf(cur, "\"zone_label\":");
+        buf->len = cur - buf->data;
+        to_oneline_json_server_list_serverDef_zone_label(pool, (&out->zone_label), buf, flags);
+        cur = buf->data + buf->len;
+        cur = njt_sprintf(cur, ",");
+        buf->len ++;
+    }
+    omit = 0;
     omit = out->is_backup_set ? 0 : 1;
     if (omit == 0) {
         cur = njt_sprintf(cur, "\"backup\":");
@@ -985,7 +1052,9 @@ server_list_t* json_parse_server_list(njt_pool_t *pool, const njt_str_t *json_st
         break; // parse success
     }
     out = njt_array_create(pool, parse_state->tokens[parse_state->current_token].size ,sizeof(server_list_item_t*));;
-    memset(out, 0, sizeof(server_list_t));
+    if (out == NULL) {
+        return NULL;
+    }
     if (parse_server_list(pool, parse_state, out, err_ret)) {
         return NULL;
     }
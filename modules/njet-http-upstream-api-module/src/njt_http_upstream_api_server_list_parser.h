@@ -27,6 +27,7 @@ typedef njt_str_t server_list_serverDef_fail_timeout_t;
 typedef njt_str_t server_list_serverDef_slow_start_t;
 
 typedef njt_str_t server_list_serverDef_route_t;
+typedef njt_str_t server_list_serverDef_zone_label_t;
 
 typedef bool server_list_serverDef_backup_t;
 typedef bool server_list_serverDef_down_t;
@@ -44,6 +45,7 @@ typedef struct server_list_serverDef_t_s {
     server_list_serverDef_fail_timeout_t fail_timeout;
     server_list_serverDef_slow_start_t slow_start;
     server_list_serverDef_route_t route;
+    server_list_serverDef_zone_label_t zone_label;
     server_list_serverDef_backup_t backup;
     server_list_serverDef_down_t down;
     server_list_serverDef_parent_t parent;
@@ -58,6 +60,7 @@ typedef struct server_list_serverDef_t_s {
     unsigned int is_fail_timeout_set:1;
     unsigned int is_slow_start_set:1;
     unsigned int is_route_set:1;
+    unsigned int is_zone_label_set:1;
     unsigned int is_backup_set:1;
     unsigned int is_down_set:1;
     unsigned int is_parent_set:1;
@@ -74,6 +77,7 @@ server_list_serverDef_max_fails_t get_server_list_serverDef_max_fails(server_lis
 server_list_serverDef_fail_timeout_t* get_server_list_serverDef_fail_timeout(server_list_serverDef_t *out);
 server_list_serverDef_slow_start_t* get_server_list_serverDef_slow_start(server_list_serverDef_t *out);
 server_list_serverDef_route_t* get_server_list_serverDef_route(server_list_serverDef_t *out);
+server_list_serverDef_zone_label_t* get_server_list_serverDef_zone_label(server_list_serverDef_t *out);
 server_list_serverDef_backup_t get_server_list_serverDef_backup(server_list_serverDef_t *out);
 server_list_serverDef_down_t get_server_list_serverDef_down(server_list_serverDef_t *out);
 server_list_serverDef_parent_t get_server_list_serverDef_parent(server_list_serverDef_t *out);
@@ -88,6 +92,7 @@ void set_server_list_serverDef_max_fails(server_list_serverDef_t* obj, server_li
 void set_server_list_serverDef_fail_timeout(server_list_serverDef_t* obj, server_list_serverDef_fail_timeout_t* field);
 void set_server_list_serverDef_slow_start(server_list_serverDef_t* obj, server_list_serverDef_slow_start_t* field);
 void set_server_list_serverDef_route(server_list_serverDef_t* obj, server_list_serverDef_route_t* field);
+void set_server_list_serverDef_zone_label(server_list_serverDef_t* obj, server_list_serverDef_zone_label_t* field);
 void set_server_list_serverDef_backup(server_list_serverDef_t* obj, server_list_serverDef_backup_t field);
 void set_server_list_serverDef_down(server_list_serverDef_t* obj, server_list_serverDef_down_t field);
 void set_server_list_serverDef_parent(server_list_serverDef_t* obj, server_list_serverDef_parent_t field);
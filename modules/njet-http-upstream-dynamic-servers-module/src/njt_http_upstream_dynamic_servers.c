@@ -89,6 +89,8 @@ extern njt_int_t njt_http_upstream_init_random(njt_conf_t *cf,
 
 static char *njt_http_upstream_check(njt_conf_t *cf, njt_command_t *cmd,
                                    void *conf);
+static char *njt_http_upstream_locality(njt_conf_t *cf, njt_command_t *cmd,
+                                   void *conf);
 
 static njt_command_t njt_http_upstream_dynamic_servers_commands[] = {
     {
@@ -133,6 +135,14 @@ static njt_command_t njt_http_upstream_dynamic_servers_commands[] = {
         0,
         NULL
     },
+    {
+        njt_string("locality"),
+        NJT_HTTP_UPS_CONF | NJT_CONF_TAKE12,
+        njt_http_upstream_locality,
+        0,
+        0,
+        NULL
+    },
     njt_null_command
 };
 
@@ -625,6 +635,23 @@ static char *njt_http_upstream_dynamic_server_directive(njt_conf_t *cf,
 			}
             continue;
         }
+	if (njt_strncmp(value[i].data, "zone_label=", 11) == 0) {
+
+	     if (value[i].len <= sizeof("zone_label=") - 1) {
+                njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                                   "a value should be provided to "
+                                   "\"zone_label\" parameter.");
+                return NJT_CONF_ERROR;
+            }
+            us->zone_label.len = value[i].len - sizeof("zone_label=") + 1;
+            us->zone_label.data = value[i].data + sizeof("zone_label=") - 1;
+			if(us->zone_label.len > 32) {
+				 njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                                   "zone_label is longer than 32");
+				return NJT_CONF_ERROR;
+			}
+            continue;
+        }
     
         /* END CUSTOMIZATION */
 
@@ -911,6 +938,14 @@ static njt_int_t njt_http_upstream_dynamic_servers_cache_server(njt_cycle_t *cyc
 					
 					 njt_memcpy(us->name.data,peer->server.data,peer->server.len);
 					 njt_memcpy(us->route.data,peer->route.data,peer->route.len);
+
+					if(peer->zone_label.len > 0) {
+						us->zone_label.data = njt_pnalloc(cycle->pool,peer->zone_label.len);
+						if(us->zone_label.data == NULL)
+							continue;
+						us->zone_label.len = peer->zone_label.len;
+						njt_memcpy(us->zone_label.data,peer->zone_label.data,peer->zone_label.len);
+					}
 					 
 					
 	
@@ -1056,6 +1091,12 @@ static void njt_http_upstream_modify_dynamic_server(njt_http_upstream_srv_conf_t
 						}
 					}
 					njt_memcpy(p->parent_node->route.data, peer->route.data, peer->route.len);
+					if(peer->zone_label.data != NULL) {
+						njt_shmtx_lock(&pool->mutex);
+						njt_http_upstream_set_peer_zone_label_locked(pool,
+								p->parent_node, &peer->zone_label);
+						njt_shmtx_unlock(&pool->mutex);
+					}
 					if(peer->weight > 0)
 						p->parent_node->weight = peer->weight;
 					if(peer->max_fails != (njt_uint_t)-1)
@@ -1182,6 +1223,7 @@ static void njt_http_upstream_check_dynamic_server(njt_event_t *ev)
 	njt_http_upstream_main_conf_t                 *umcf;
 	njt_http_upstream_srv_conf_t                  **uscfp;
 	njt_http_upstream_dynamic_server_conf_t       *dynamic_server = NULL;
+	njt_slab_pool_t                               *shpool;
 	njt_http_upstream_srv_conf_t                  *uscf;
 	njt_uint_t                                    refresh_in;
 	 udsmcf = njt_http_cycle_get_module_main_conf(njt_cycle,
@@ -1258,6 +1300,16 @@ static void njt_http_upstream_check_dynamic_server(njt_event_t *ev)
 					}
 					njt_memcpy(us->name.data, peer->server.data, peer->server.len);
 					njt_memcpy(us->route.data, peer->route.data, peer->route.len);
+					us->zone_label.len = 0;
+					if(peer->zone_label.len > 0) {
+						us->zone_label.data = njt_pnalloc(njt_cycle->pool,peer->zone_label.len);
+						if(us->zone_label.data == NULL) {
+							pre = peer;
+							continue;
+						}
+						us->zone_label.len = peer->zone_label.len;
+						njt_memcpy(us->zone_label.data, peer->zone_label.data, peer->zone_label.len);
+					}
 
 					njt_memzero(&u, sizeof(njt_url_t));
 					u.url = us->name;
@@ -1289,6 +1341,12 @@ static void njt_http_upstream_check_dynamic_server(njt_event_t *ev)
 					}
 					parent_node->id = peer->parent_id;
 					parent_node->parent_id = peer->parent_id;
+					shpool = ((njt_http_upstream_rr_peers_t *)
+							upstream_conf->peer.data)->shpool;
+					njt_shmtx_lock(&shpool->mutex);
+					njt_http_upstream_set_peer_zone_label_locked(shpool,
+							parent_node, &us->zone_label);
+					njt_shmtx_unlock(&shpool->mutex);
 
 					
 					njt_memzero(dynamic_server, sizeof(njt_http_upstream_dynamic_server_conf_t));
@@ -1511,6 +1569,10 @@ static void njt_http_upstream_dynamic_server_resolve(njt_event_t *ev)
 		 } 
 		 dynamic_server->parent_node->id = us->parent_id;
 		 dynamic_server->parent_node->parent_id = us->parent_id;
+		 njt_shmtx_lock(&peers->shpool->mutex);
+		 njt_http_upstream_set_peer_zone_label_locked(peers->shpool,
+				 dynamic_server->parent_node, &us->zone_label);
+		 njt_shmtx_unlock(&peers->shpool->mutex);
 		 
 		dynamic_server->parent_node->fail_timeout = us->fail_timeout;
 		dynamic_server->parent_node->max_conns = us->max_conns;
@@ -1842,6 +1904,10 @@ skip_del:
 				if (peer == NULL) {
 					continue;
 				}
+				njt_shmtx_lock(&peers->shpool->mutex);
+				njt_http_upstream_set_peer_zone_label_locked(peers->shpool, peer,
+						&dynamic_server->parent_node->zone_label);
+				njt_shmtx_unlock(&peers->shpool->mutex);
 				peer->fail_timeout = fail_timeout;
 				peer->max_conns = max_conns;
 				peer->max_fails = max_fails;
@@ -2006,3 +2072,59 @@ static char *njt_http_upstream_check(njt_conf_t *cf, njt_command_t *cmd,
 	}
   return NJT_CONF_OK;
 }
+
+
+static char *njt_http_upstream_locality(njt_conf_t *cf, njt_command_t *cmd,
+                                   void *conf)
+{
+    njt_int_t                      n;
+    njt_str_t                     *value, s;
+    njt_http_upstream_srv_conf_t  *uscf;
+
+    uscf = njt_http_conf_get_module_srv_conf(cf, njt_http_upstream_module);
+
+    if (uscf->locality.len) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (value[1].len == 0 || value[1].len > 32) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid locality \"%V\"", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    uscf->locality = value[1];
+    uscf->locality_spill = 70;
+
+    if (cf->args->nelts == 3) {
+
+        if (njt_strncmp(value[2].data, "spill=", 6) != 0) {
+            goto invalid;
+        }
+
+        s.data = value[2].data + 6;
+        s.len = value[2].len - 6;
+
+        if (s.len && s.data[s.len - 1] == '%') {
+            s.len--;
+        }
+
+        n = njt_atoi(s.data, s.len);
+        if (n == NJT_ERROR || n == 0 || n > 100) {
+            goto invalid;
+        }
+
+        uscf->locality_spill = n;
+    }
+
+    return NJT_CONF_OK;
+
+invalid:
+
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[2]);
+
+    return NJT_CONF_ERROR;
+}
@@ -6,17 +6,83 @@
 #include <njt_config.h>
 #include <njt_core.h>
 #include <njt_http.h>
+#include <njt_sha1.h>
 
 #include <jwt.h>
-//#include <jansson.h>
+#include <jansson.h>
+#include <openssl/pem.h>
+
+#define NJT_HTTP_AUTH_JWT_DIGEST_LEN  20
+
+// A key of a JWKS key set
+typedef struct {
+  njt_str_t kid;
+  njt_uint_t kty;             // NJT_HTTP_AUTH_JWT_KTY_*
+  njt_uint_t alg;             // JWT_ALG_ANY if the key does not restrict it
+  njt_str_t key;              // Secret for "oct", public key in PEM otherwise
+} njt_http_auth_jwt_jwk_t;
+
+// JWKS key set loaded from a file or fetched from a location
+typedef struct {
+  njt_str_t path;
+  njt_str_t uri;
+  time_t refresh;
+  time_t next;                // When to check the key set again
+  time_t mtime;
+  njt_uint_t fetching;        // Subrequests in progress
+  njt_pool_t *pool;           // Holds the current keys, replaced on reload
+  njt_array_t *keys;          // Array of njt_http_auth_jwt_jwk_t
+  u_char tag[NJT_HTTP_AUTH_JWT_DIGEST_LEN];  // Digest of the current document
+} njt_http_auth_jwt_keyset_t;
+
+// Verified token cache, shared by the workers
+typedef struct {
+  u_char color;
+  u_char dummy;
+  u_short len;                // Length of the cached claims
+  njt_queue_t queue;
+  time_t expire;
+  u_char digest[NJT_HTTP_AUTH_JWT_DIGEST_LEN];
+  u_char data[1];
+} njt_http_auth_jwt_node_t;
+
+typedef struct {
+  njt_rbtree_t rbtree;
+  njt_rbtree_node_t sentinel;
+  njt_queue_t queue;
+} njt_http_auth_jwt_shctx_t;
+
+typedef struct {
+  njt_http_auth_jwt_shctx_t *sh;
+  njt_slab_pool_t *shpool;
+  time_t ttl;
+} njt_http_auth_jwt_cache_t;
+
+typedef struct {
+  njt_str_t name;             // Null terminated claim name
+} njt_http_auth_jwt_claim_t;
+
+typedef struct {
+  njt_array_t claims;         // Array of njt_http_auth_jwt_claim_t
+} njt_http_auth_jwt_main_conf_t;
 
 typedef struct {
   njt_str_t jwt_key;          // Forwarded key (with auth_jwt_key)
   njt_int_t jwt_flag;         // Function of "auth_jwt": on -> 1 | off -> 0 | $variable -> 2
   njt_int_t jwt_var_index;    // Used only if jwt_flag==2 to fetch the $variable value
   njt_uint_t jwt_algorithm;
+  njt_http_auth_jwt_keyset_t *keyset;  // auth_jwt_key_file or auth_jwt_key_request
+  njt_shm_zone_t *cache;      // auth_jwt_cache zone, NULL if off
+  u_char key_tag[NJT_HTTP_AUTH_JWT_DIGEST_LEN];  // Digest of jwt_key
 } njt_http_auth_jwt_loc_conf_t;
 
+typedef struct {
+  njt_uint_t fetching;        // Waiting for the key set subrequest
+  njt_uint_t done;
+  njt_http_auth_jwt_keyset_t *keyset;
+  njt_http_variable_value_t *claims;
+} njt_http_auth_jwt_ctx_t;
+
 #define NJT_HTTP_AUTH_JWT_OFF        0
 #define NJT_HTTP_AUTH_JWT_BEARER     1
 #define NJT_HTTP_AUTH_JWT_VARIABLE   2
@@ -25,6 +91,13 @@ typedef struct {
 #define NJT_HTTP_AUTH_JWT_ENCODING_BASE64  1
 #define NJT_HTTP_AUTH_JWT_ENCODING_UTF8    2
 
+#define NJT_HTTP_AUTH_JWT_KTY_OCT  0
+#define NJT_HTTP_AUTH_JWT_KTY_RSA  1
+#define NJT_HTTP_AUTH_JWT_KTY_EC   2
+
+// Delay before fetching a key set again after a failure
+#define NJT_HTTP_AUTH_JWT_RETRY    5
+
 #define JWT_ALG_ANY JWT_ALG_NONE
 
 /*
@@ -48,15 +121,48 @@ static njt_int_t njt_http_auth_jwt_handler(njt_http_request_t *r);
 static njt_int_t auth_jwt_get_token(u_char **token, njt_http_request_t *r, const njt_http_auth_jwt_loc_conf_t *conf);
 static char * auth_jwt_key_from_file(njt_conf_t *cf, const char *path, njt_str_t *key);
 static u_char * auth_jwt_safe_string(njt_pool_t *pool, u_char *src, size_t len);
+static njt_http_auth_jwt_ctx_t * auth_jwt_get_ctx(njt_http_request_t *r);
+
+// Key sets
+static njt_int_t auth_jwt_keyset_refresh(njt_http_request_t *r, njt_http_auth_jwt_keyset_t *ks);
+static njt_int_t auth_jwt_keyset_fetch(njt_http_request_t *r, njt_http_auth_jwt_keyset_t *ks);
+static njt_int_t auth_jwt_keyset_fetch_done(njt_http_request_t *r, void *data, njt_int_t rc);
+static void auth_jwt_keyset_fetch_cleanup(void *data);
+static njt_int_t auth_jwt_keyset_read(njt_http_auth_jwt_keyset_t *ks, njt_log_t *log);
+static njt_int_t auth_jwt_keyset_load(njt_http_auth_jwt_keyset_t *ks, u_char *data, size_t len, njt_log_t *log);
+static void auth_jwt_keyset_cleanup(void *data);
+static njt_int_t auth_jwt_jwk_parse(njt_pool_t *pool, json_t *jwk, njt_http_auth_jwt_jwk_t *key, njt_log_t *log);
+static njt_int_t auth_jwt_jwk_b64(njt_pool_t *pool, json_t *value, njt_str_t *dst);
+static njt_int_t auth_jwt_jwk_pem(njt_pool_t *pool, EVP_PKEY *pkey, njt_str_t *pem);
+static int auth_jwt_key_provider(const jwt_t *jwt, jwt_key_t *key);
+
+// Verified token cache
+static njt_int_t auth_jwt_cache_lookup(njt_http_request_t *r, njt_shm_zone_t *zone, u_char *digest);
+static void auth_jwt_cache_store(njt_http_request_t *r, njt_shm_zone_t *zone, u_char *digest, time_t exp);
+static void auth_jwt_cache_expire(njt_http_auth_jwt_cache_t *cache, time_t now);
+static void auth_jwt_cache_rbtree_insert_value(njt_rbtree_node_t *temp, njt_rbtree_node_t *node, njt_rbtree_node_t *sentinel);
+static njt_int_t auth_jwt_cache_init_zone(njt_shm_zone_t *shm_zone, void *data);
+
+// Claims
+static njt_int_t auth_jwt_set_claims(njt_http_request_t *r, jwt_t *jwt);
+static njt_int_t njt_http_auth_jwt_claim_variable(njt_http_request_t *r, njt_http_variable_value_t *v, uintptr_t data);
 
 // Configuration functions
 static njt_int_t njt_http_auth_jwt_init(njt_conf_t *cf);
+static void * njt_http_auth_jwt_create_main_conf(njt_conf_t *cf);
 static void * njt_http_auth_jwt_create_conf(njt_conf_t *cf);
 static char * njt_http_auth_jwt_merge_conf(njt_conf_t *cf, void *parent, void *child);
 
 // Declaration functions
 static char * njt_conf_set_auth_jwt_key(njt_conf_t *cf, njt_command_t *cmd, void *conf);
 static char * njt_conf_set_auth_jwt(njt_conf_t *cf, njt_command_t *cmd, void *conf);
+static char * njt_conf_set_auth_jwt_keyset(njt_conf_t *cf, njt_command_t *cmd, void *conf);
+static char * njt_conf_set_auth_jwt_cache_zone(njt_conf_t *cf, njt_command_t *cmd, void *conf);
+static char * njt_conf_set_auth_jwt_cache(njt_conf_t *cf, njt_command_t *cmd, void *conf);
+static char * njt_conf_set_auth_jwt_claim_set(njt_conf_t *cf, njt_command_t *cmd, void *conf);
+
+// Key set used by auth_jwt_key_provider() during jwt_decode_2()
+static njt_http_auth_jwt_keyset_t *auth_jwt_keyset;
 
 static njt_command_t njt_http_auth_jwt_commands[] = {
 
@@ -84,6 +190,46 @@ static njt_command_t njt_http_auth_jwt_commands[] = {
     offsetof(njt_http_auth_jwt_loc_conf_t, jwt_algorithm),
     &njt_http_auth_jwt_algorithms },
 
+  // auth_jwt_key_file path [refresh=time];
+  { njt_string("auth_jwt_key_file"),
+    NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_TAKE12,
+    njt_conf_set_auth_jwt_keyset,
+    NJT_HTTP_LOC_CONF_OFFSET,
+    0,
+    NULL },
+
+  // auth_jwt_key_request uri [refresh=time];
+  { njt_string("auth_jwt_key_request"),
+    NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_TAKE12,
+    njt_conf_set_auth_jwt_keyset,
+    NJT_HTTP_LOC_CONF_OFFSET,
+    0,
+    NULL },
+
+  // auth_jwt_cache_zone zone=name:size [ttl=time];
+  { njt_string("auth_jwt_cache_zone"),
+    NJT_HTTP_MAIN_CONF|NJT_CONF_TAKE12,
+    njt_conf_set_auth_jwt_cache_zone,
+    0,
+    0,
+    NULL },
+
+  // auth_jwt_cache name | off;
+  { njt_string("auth_jwt_cache"),
+    NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_TAKE1,
+    njt_conf_set_auth_jwt_cache,
+    NJT_HTTP_LOC_CONF_OFFSET,
+    0,
+    NULL },
+
+  // auth_jwt_claim_set $variable name;
+  { njt_string("auth_jwt_claim_set"),
+    NJT_HTTP_MAIN_CONF|NJT_CONF_TAKE2,
+    njt_conf_set_auth_jwt_claim_set,
+    NJT_HTTP_MAIN_CONF_OFFSET,
+    0,
+    NULL },
+
   njt_null_command
 };
 
@@ -92,7 +238,7 @@ static njt_http_module_t njt_http_auth_jwt_module_ctx = {
   NULL,                        /* preconfiguration */
   njt_http_auth_jwt_init,      /* postconfiguration */
 
-  NULL,                        /* create main configuration */
+  njt_http_auth_jwt_create_main_conf,        /* create main configuration */
   NULL,                        /* init main configuration */
 
   NULL,                        /* create server configuration */
@@ -122,6 +268,12 @@ njt_module_t njt_http_auth_jwt_module = {
 static njt_int_t njt_http_auth_jwt_handler(njt_http_request_t *r)
 {
   const njt_http_auth_jwt_loc_conf_t *conf;
+  njt_http_auth_jwt_keyset_t *keyset;
+  njt_http_auth_jwt_ctx_t *ctx;
+  njt_sha1_t sha1;
+  njt_int_t rc;
+  u_char digest[NJT_HTTP_AUTH_JWT_DIGEST_LEN];
+  u_char alg_tag;
   u_char *jwt_data;
   jwt_t *jwt = NULL;
 
@@ -139,6 +291,33 @@ static njt_int_t njt_http_auth_jwt_handler(njt_http_request_t *r)
     return NJT_DECLINED;
   }
 
+  // Wait for the key set subrequest started by this request
+  ctx = njt_http_get_module_ctx(r, njt_http_auth_jwt_module);
+  if (ctx != NULL && ctx->fetching)
+  {
+    if (!ctx->done)
+    {
+      return NJT_AGAIN;
+    }
+    ctx->fetching = 0;
+  }
+
+  keyset = conf->keyset;
+  if (keyset != NULL)
+  {
+    rc = auth_jwt_keyset_refresh(r, keyset);
+    if (rc != NJT_OK)
+    {
+      return rc;
+    }
+
+    if (keyset->keys == NULL)
+    {
+      njt_log_error(NJT_LOG_ERR, r->connection->log, 0, "JWT: no key set loaded");
+      return NJT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+  }
+
   // Get jwt
   if (auth_jwt_get_token(&jwt_data, r, conf) != NJT_OK)
   {
@@ -146,8 +325,41 @@ static njt_int_t njt_http_auth_jwt_handler(njt_http_request_t *r)
     return NJT_HTTP_UNAUTHORIZED;
   }
 
+  // A token verified with the same keys and algorithm is taken from the cache
+  if (conf->cache != NULL)
+  {
+    alg_tag = (u_char) conf->jwt_algorithm;
+
+    njt_sha1_init(&sha1);
+    njt_sha1_update(&sha1, keyset ? keyset->tag : conf->key_tag, NJT_HTTP_AUTH_JWT_DIGEST_LEN);
+    njt_sha1_update(&sha1, &alg_tag, 1);
+    njt_sha1_update(&sha1, jwt_data, njt_strlen(jwt_data));
+    njt_sha1_final(digest, &sha1);
+
+    rc = auth_jwt_cache_lookup(r, conf->cache, digest);
+    if (rc == NJT_OK)
+    {
+      return NJT_OK;
+    }
+    if (rc == NJT_ERROR)
+    {
+      return NJT_HTTP_INTERNAL_SERVER_ERROR;
+    }
+  }
+
   // Validate the jwt
-  if (jwt_decode(&jwt, (char *)jwt_data, conf->jwt_key.data, conf->jwt_key.len))
+  if (keyset != NULL)
+  {
+    auth_jwt_keyset = keyset;
+    rc = jwt_decode_2(&jwt, (char *)jwt_data, auth_jwt_key_provider);
+    auth_jwt_keyset = NULL;
+  }
+  else
+  {
+    rc = jwt_decode(&jwt, (char *)jwt_data, conf->jwt_key.data, conf->jwt_key.len);
+  }
+
+  if (rc)
   {
     njt_log_error(NJT_LOG_WARN, r->connection->log, 0, "JWT: failed to parse jwt");
     return NJT_HTTP_UNAUTHORIZED;
@@ -180,6 +392,16 @@ static njt_int_t njt_http_auth_jwt_handler(njt_http_request_t *r)
     return NJT_HTTP_UNAUTHORIZED;
   }
 
+  if (auth_jwt_set_claims(r, jwt) != NJT_OK)
+  {
+    return NJT_HTTP_INTERNAL_SERVER_ERROR;
+  }
+
+  if (conf->cache != NULL)
+  {
+    auth_jwt_cache_store(r, conf->cache, digest, exp);
+  }
+
   return NJT_OK;
 }
 
@@ -203,6 +425,25 @@ static njt_int_t njt_http_auth_jwt_init(njt_conf_t *cf)
 }
 
 
+static void * njt_http_auth_jwt_create_main_conf(njt_conf_t *cf)
+{
+  njt_http_auth_jwt_main_conf_t *amcf;
+
+  amcf = njt_pcalloc(cf->pool, sizeof(njt_http_auth_jwt_main_conf_t));
+  if (amcf == NULL)
+  {
+    return NULL;
+  }
+
+  if (njt_array_init(&amcf->claims, cf->pool, 4, sizeof(njt_http_auth_jwt_claim_t)) != NJT_OK)
+  {
+    return NULL;
+  }
+
+  return amcf;
+}
+
+
 static void * njt_http_auth_jwt_create_conf(njt_conf_t *cf)
 {
   njt_http_auth_jwt_loc_conf_t *conf;
@@ -219,6 +460,8 @@ static void * njt_http_auth_jwt_create_conf(njt_conf_t *cf)
   conf->jwt_flag = NJT_CONF_UNSET;
   conf->jwt_var_index = NJT_CONF_UNSET;
   conf->jwt_algorithm = NJT_CONF_UNSET_UINT;
+  conf->keyset = NJT_CONF_UNSET_PTR;
+  conf->cache = NJT_CONF_UNSET_PTR;
 
   return conf;
 }
@@ -233,6 +476,14 @@ static char * njt_http_auth_jwt_merge_conf(njt_conf_t *cf, void *parent, void *c
   njt_conf_merge_value(conf->jwt_var_index, prev->jwt_var_index, NJT_CONF_UNSET);
   njt_conf_merge_value(conf->jwt_flag, prev->jwt_flag, NJT_HTTP_AUTH_JWT_OFF);
   njt_conf_merge_uint_value(conf->jwt_algorithm, prev->jwt_algorithm, JWT_ALG_ANY);
+  njt_conf_merge_ptr_value(conf->keyset, prev->keyset, NULL);
+  njt_conf_merge_ptr_value(conf->cache, prev->cache, NULL);
+
+  // Cached tokens are bound to the key they were verified with
+  njt_sha1_t sha1;
+  njt_sha1_init(&sha1);
+  njt_sha1_update(&sha1, conf->jwt_key.data, conf->jwt_key.len);
+  njt_sha1_final(conf->key_tag, &sha1);
 
   return NJT_CONF_OK;
 }
@@ -436,6 +687,262 @@ static char * njt_conf_set_auth_jwt(njt_conf_t *cf, njt_command_t *cmd, void *co
 }
 
 
+// Parse auth_jwt_key_file and auth_jwt_key_request directives
+static char * njt_conf_set_auth_jwt_keyset(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+  njt_http_auth_jwt_loc_conf_t *ajcf = conf;
+  njt_http_auth_jwt_keyset_t *ks;
+  njt_pool_cleanup_t *cln;
+  njt_str_t *value, s;
+
+  if (ajcf->keyset != NJT_CONF_UNSET_PTR)
+  {
+    return "is duplicate";
+  }
+
+  value = cf->args->elts;
+
+  ks = njt_pcalloc(cf->pool, sizeof(njt_http_auth_jwt_keyset_t));
+  if (ks == NULL)
+  {
+    return NJT_CONF_ERROR;
+  }
+
+  if (cmd->name.data[sizeof("auth_jwt_key_") - 1] == 'f')
+  {
+    ks->path = value[1];
+    ks->refresh = 60;
+
+    if (njt_conf_full_name(cf->cycle, &ks->path, 1) != NJT_OK)
+    {
+      return NJT_CONF_ERROR;
+    }
+  }
+  else
+  {
+    if (value[1].len == 0 || value[1].data[0] != '/')
+    {
+      njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "JWT: invalid key set uri \"%V\"", &value[1]);
+      return NJT_CONF_ERROR;
+    }
+
+    ks->uri = value[1];
+    ks->refresh = 600;
+  }
+
+  if (cf->args->nelts == 3)
+  {
+    if (njt_strncmp(value[2].data, "refresh=", 8) != 0)
+    {
+      njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid parameter \"%V\"", &value[2]);
+      return NJT_CONF_ERROR;
+    }
+
+    s.data = value[2].data + 8;
+    s.len = value[2].len - 8;
+
+    ks->refresh = njt_parse_time(&s, 1);
+    if (ks->refresh == (time_t) NJT_ERROR || ks->refresh == 0)
+    {
+      njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid refresh \"%V\"", &value[2]);
+      return NJT_CONF_ERROR;
+    }
+  }
+
+  cln = njt_pool_cleanup_add(cf->pool, 0);
+  if (cln == NULL)
+  {
+    return NJT_CONF_ERROR;
+  }
+  cln->handler = auth_jwt_keyset_cleanup;
+  cln->data = ks;
+
+  // A key file must be valid at start, later reload failures keep the old keys
+  if (ks->path.len && auth_jwt_keyset_read(ks, cf->log) != NJT_OK)
+  {
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "JWT: failed to load key set from \"%V\"", &ks->path);
+    return NJT_CONF_ERROR;
+  }
+
+  ajcf->keyset = ks;
+
+  return NJT_CONF_OK;
+}
+
+
+// Parse auth_jwt_cache_zone directive
+static char * njt_conf_set_auth_jwt_cache_zone(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+  njt_http_auth_jwt_cache_t *cache;
+  njt_shm_zone_t *shm_zone;
+  njt_str_t *value, name, s;
+  ssize_t size;
+  time_t ttl;
+  njt_uint_t i;
+  u_char *p;
+
+  value = cf->args->elts;
+
+  name.len = 0;
+  size = 0;
+  ttl = 300;
+
+  for (i = 1; i < cf->args->nelts; i++)
+  {
+    if (njt_strncmp(value[i].data, "zone=", 5) == 0)
+    {
+      name.data = value[i].data + 5;
+
+      p = (u_char *) njt_strchr(name.data, ':');
+      if (p == NULL)
+      {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid zone size \"%V\"", &value[i]);
+        return NJT_CONF_ERROR;
+      }
+
+      name.len = p - name.data;
+
+      s.data = p + 1;
+      s.len = value[i].data + value[i].len - s.data;
+
+      size = njt_parse_size(&s);
+      if (size == NJT_ERROR || size < (ssize_t) (8 * njt_pagesize))
+      {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid zone size \"%V\"", &value[i]);
+        return NJT_CONF_ERROR;
+      }
+
+      continue;
+    }
+
+    if (njt_strncmp(value[i].data, "ttl=", 4) == 0)
+    {
+      s.data = value[i].data + 4;
+      s.len = value[i].len - 4;
+
+      ttl = njt_parse_time(&s, 1);
+      if (ttl == (time_t) NJT_ERROR || ttl == 0)
+      {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid ttl \"%V\"", &value[i]);
+        return NJT_CONF_ERROR;
+      }
+
+      continue;
+    }
+
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "invalid parameter \"%V\"", &value[i]);
+    return NJT_CONF_ERROR;
+  }
+
+  if (name.len == 0)
+  {
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "\"%V\" must have \"zone\" parameter", &cmd->name);
+    return NJT_CONF_ERROR;
+  }
+
+  cache = njt_pcalloc(cf->pool, sizeof(njt_http_auth_jwt_cache_t));
+  if (cache == NULL)
+  {
+    return NJT_CONF_ERROR;
+  }
+
+  cache->ttl = ttl;
+
+  shm_zone = njt_shared_memory_add(cf, &name, size, &njt_http_auth_jwt_module);
+  if (shm_zone == NULL)
+  {
+    return NJT_CONF_ERROR;
+  }
+
+  if (shm_zone->data)
+  {
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "%V \"%V\" is already defined", &cmd->name, &name);
+    return NJT_CONF_ERROR;
+  }
+
+  shm_zone->init = auth_jwt_cache_init_zone;
+  shm_zone->data = cache;
+
+  return NJT_CONF_OK;
+}
+
+
+// Parse auth_jwt_cache directive
+static char * njt_conf_set_auth_jwt_cache(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+  njt_http_auth_jwt_loc_conf_t *ajcf = conf;
+  njt_str_t *value;
+
+  if (ajcf->cache != NJT_CONF_UNSET_PTR)
+  {
+    return "is duplicate";
+  }
+
+  value = cf->args->elts;
+
+  if (value[1].len == 3 && njt_strncmp(value[1].data, "off", 3) == 0)
+  {
+    ajcf->cache = NULL;
+    return NJT_CONF_OK;
+  }
+
+  // The zone is sized by auth_jwt_cache_zone, which may come later
+  ajcf->cache = njt_shared_memory_add(cf, &value[1], 0, &njt_http_auth_jwt_module);
+  if (ajcf->cache == NULL)
+  {
+    return NJT_CONF_ERROR;
+  }
+
+  return NJT_CONF_OK;
+}
+
+
+// Parse auth_jwt_claim_set directive
+static char * njt_conf_set_auth_jwt_claim_set(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+  njt_http_auth_jwt_main_conf_t *amcf = conf;
+  njt_http_auth_jwt_claim_t *claim;
+  njt_http_variable_t *var;
+  njt_str_t *value, name;
+
+  value = cf->args->elts;
+
+  if (value[1].len < 2 || value[1].data[0] != '$')
+  {
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0, "JWT: invalid variable name \"%V\"", &value[1]);
+    return NJT_CONF_ERROR;
+  }
+
+  name.data = value[1].data + 1;
+  name.len = value[1].len - 1;
+
+  // Claims are known only after the access phase
+  var = njt_http_add_variable(cf, &name, NJT_HTTP_VAR_CHANGEABLE|NJT_HTTP_VAR_NOCACHEABLE);
+  if (var == NULL)
+  {
+    return NJT_CONF_ERROR;
+  }
+
+  var->get_handler = njt_http_auth_jwt_claim_variable;
+  var->data = amcf->claims.nelts;
+
+  claim = njt_array_push(&amcf->claims);
+  if (claim == NULL)
+  {
+    return NJT_CONF_ERROR;
+  }
+
+  claim->name.len = value[2].len;
+  claim->name.data = auth_jwt_safe_string(cf->pool, value[2].data, value[2].len);
+  if (claim->name.data == NULL)
+  {
+    return NJT_CONF_ERROR;
+  }
+
+  return NJT_CONF_OK;
+}
+
+
 // Copy a character array into a null terminated one.
 static u_char * auth_jwt_safe_string(njt_pool_t *pool, u_char *src, size_t len)
 {
@@ -510,3 +1017,1059 @@ static njt_int_t auth_jwt_get_token(u_char **token, njt_http_request_t *r, const
 
   return NJT_OK;
 }
+
+
+static njt_http_auth_jwt_ctx_t * auth_jwt_get_ctx(njt_http_request_t *r)
+{
+  njt_http_auth_jwt_ctx_t *ctx;
+
+  ctx = njt_http_get_module_ctx(r, njt_http_auth_jwt_module);
+  if (ctx != NULL)
+  {
+    return ctx;
+  }
+
+  ctx = njt_pcalloc(r->pool, sizeof(njt_http_auth_jwt_ctx_t));
+  if (ctx == NULL)
+  {
+    return NULL;
+  }
+
+  njt_http_set_ctx(r, ctx, njt_http_auth_jwt_module);
+
+  return ctx;
+}
+
+
+// Reload a changed key file, or fetch the key set when it is due
+static njt_int_t auth_jwt_keyset_refresh(njt_http_request_t *r, njt_http_auth_jwt_keyset_t *ks)
+{
+  njt_http_auth_jwt_ctx_t *ctx;
+  njt_file_info_t fi;
+  time_t now;
+
+  now = njt_time();
+
+  if (ks->keys != NULL && (now < ks->next || ks->fetching))
+  {
+    return NJT_OK;
+  }
+
+  if (ks->uri.len)
+  {
+    // Fetch once per request, even if it failed
+    ctx = njt_http_get_module_ctx(r, njt_http_auth_jwt_module);
+    if (ctx != NULL && ctx->keyset == ks)
+    {
+      return NJT_OK;
+    }
+
+    return auth_jwt_keyset_fetch(r, ks);
+  }
+
+  ks->next = now + ks->refresh;
+
+  if (njt_file_info(ks->path.data, &fi) == NJT_FILE_ERROR)
+  {
+    njt_log_error(NJT_LOG_ERR, r->connection->log, njt_errno,
+                  njt_file_info_n " \"%V\" failed", &ks->path);
+    return NJT_OK;
+  }
+
+  if (njt_file_mtime(&fi) != ks->mtime)
+  {
+    // The old keys stay in use if the new file is broken
+    (void) auth_jwt_keyset_read(ks, r->connection->log);
+  }
+
+  return NJT_OK;
+}
+
+
+// Fetch the key set with an in-memory subrequest, the request waits for it
+static njt_int_t auth_jwt_keyset_fetch(njt_http_request_t *r, njt_http_auth_jwt_keyset_t *ks)
+{
+  njt_http_auth_jwt_ctx_t *ctx;
+  njt_http_post_subrequest_t *ps;
+  njt_http_request_t *sr;
+  njt_pool_cleanup_t *cln;
+
+  ctx = auth_jwt_get_ctx(r);
+  if (ctx == NULL)
+  {
+    return NJT_ERROR;
+  }
+
+  ps = njt_palloc(r->pool, sizeof(njt_http_post_subrequest_t));
+  if (ps == NULL)
+  {
+    return NJT_ERROR;
+  }
+
+  ps->handler = auth_jwt_keyset_fetch_done;
+  ps->data = ctx;
+
+  cln = njt_pool_cleanup_add(r->pool, 0);
+  if (cln == NULL)
+  {
+    return NJT_ERROR;
+  }
+
+  if (njt_http_subrequest(r, &ks->uri, NULL, &sr, ps,
+                          NJT_HTTP_SUBREQUEST_WAITED|NJT_HTTP_SUBREQUEST_IN_MEMORY) != NJT_OK)
+  {
+    return NJT_ERROR;
+  }
+
+  ctx->fetching = 1;
+  ctx->done = 0;
+  ctx->keyset = ks;
+  ks->fetching++;
+
+  // The subrequest may never finish if the request is terminated
+  cln->handler = auth_jwt_keyset_fetch_cleanup;
+  cln->data = ctx;
+
+  return NJT_AGAIN;
+}
+
+
+static njt_int_t auth_jwt_keyset_fetch_done(njt_http_request_t *r, void *data, njt_int_t rc)
+{
+  njt_http_auth_jwt_ctx_t *ctx = data;
+  njt_http_auth_jwt_keyset_t *ks;
+  njt_buf_t *b;
+
+  if (ctx->done)
+  {
+    return rc;
+  }
+
+  ctx->done = 1;
+  ks = ctx->keyset;
+  ks->fetching--;
+
+  if (rc == NJT_OK && r->headers_out.status == NJT_HTTP_OK && r->out && r->out->buf)
+  {
+    b = r->out->buf;
+
+    if (auth_jwt_keyset_load(ks, b->pos, b->last - b->pos, r->connection->log) == NJT_OK)
+    {
+      ks->next = njt_time() + ks->refresh;
+      return rc;
+    }
+  }
+  else
+  {
+    njt_log_error(NJT_LOG_ERR, r->connection->log, 0,
+                  "JWT: key set request \"%V\" failed with status %ui",
+                  &ks->uri, r->headers_out.status);
+  }
+
+  ks->next = njt_time() + njt_min(ks->refresh, NJT_HTTP_AUTH_JWT_RETRY);
+
+  return rc;
+}
+
+
+static void auth_jwt_keyset_fetch_cleanup(void *data)
+{
+  njt_http_auth_jwt_ctx_t *ctx = data;
+
+  if (ctx->fetching && !ctx->done)
+  {
+    ctx->done = 1;
+    ctx->keyset->fetching--;
+  }
+}
+
+
+static njt_int_t auth_jwt_keyset_read(njt_http_auth_jwt_keyset_t *ks, njt_log_t *log)
+{
+  njt_file_t file;
+  njt_file_info_t fi;
+  njt_int_t rc;
+  ssize_t n;
+  size_t size;
+  u_char *buf;
+
+  njt_memzero(&file, sizeof(njt_file_t));
+  file.name = ks->path;
+  file.log = log;
+
+  file.fd = njt_open_file(ks->path.data, NJT_FILE_RDONLY, NJT_FILE_OPEN, 0);
+  if (file.fd == NJT_INVALID_FILE)
+  {
+    njt_log_error(NJT_LOG_ERR, log, njt_errno, njt_open_file_n " \"%V\" failed", &ks->path);
+    return NJT_ERROR;
+  }
+
+  rc = NJT_ERROR;
+  buf = NULL;
+
+  if (njt_fd_info(file.fd, &fi) == NJT_FILE_ERROR)
+  {
+    njt_log_error(NJT_LOG_ERR, log, njt_errno, njt_fd_info_n " \"%V\" failed", &ks->path);
+    goto done;
+  }
+
+  size = (size_t) njt_file_size(&fi);
+
+  buf = njt_alloc(size + 1, log);
+  if (buf == NULL)
+  {
+    goto done;
+  }
+
+  n = njt_read_file(&file, buf, size, 0);
+  if (n == NJT_ERROR || (size_t) n != size)
+  {
+    njt_log_error(NJT_LOG_ERR, log, 0, "JWT: failed to read \"%V\"", &ks->path);
+    goto done;
+  }
+
+  rc = auth_jwt_keyset_load(ks, buf, size, log);
+  if (rc == NJT_OK)
+  {
+    ks->mtime = njt_file_mtime(&fi);
+  }
+
+done:
+
+  if (buf)
+  {
+    njt_free(buf);
+  }
+
+  if (njt_close_file(file.fd) == NJT_FILE_ERROR)
+  {
+    njt_log_error(NJT_LOG_ALERT, log, njt_errno, njt_close_file_n " \"%V\" failed", &ks->path);
+  }
+
+  return rc;
+}
+
+
+// Parse a JWKS document and replace the current keys with its keys
+static njt_int_t auth_jwt_keyset_load(njt_http_auth_jwt_keyset_t *ks, u_char *data, size_t len, njt_log_t *log)
+{
+  njt_http_auth_jwt_jwk_t *key;
+  njt_array_t *keys;
+  njt_pool_t *pool;
+  njt_sha1_t sha1;
+  json_error_t error;
+  json_t *root, *jwks, *jwk;
+  size_t i;
+
+  root = json_loadb((const char *) data, len, 0, &error);
+  if (root == NULL)
+  {
+    njt_log_error(NJT_LOG_ERR, log, 0, "JWT: invalid key set: %s at line %d",
+                  error.text, error.line);
+    return NJT_ERROR;
+  }
+
+  pool = NULL;
+
+  jwks = json_object_get(root, "keys");
+  if (!json_is_array(jwks))
+  {
+    njt_log_error(NJT_LOG_ERR, log, 0, "JWT: invalid key set: no \"keys\" array");
+    goto failed;
+  }
+
+  pool = njt_create_pool(NJT_DEFAULT_POOL_SIZE, log);
+  if (pool == NULL)
+  {
+    goto failed;
+  }
+
+  keys = njt_array_create(pool, json_array_size(jwks) + 1, sizeof(njt_http_auth_jwt_jwk_t));
+  if (keys == NULL)
+  {
+    goto failed;
+  }
+
+  json_array_foreach(jwks, i, jwk)
+  {
+    key = njt_array_push(keys);
+    if (key == NULL)
+    {
+      goto failed;
+    }
+
+    // Keys of unknown type or use are skipped
+    if (auth_jwt_jwk_parse(pool, jwk, key, log) != NJT_OK)
+    {
+      keys->nelts--;
+    }
+  }
+
+  if (keys->nelts == 0)
+  {
+    njt_log_error(NJT_LOG_ERR, log, 0, "JWT: no usable keys in key set");
+    goto failed;
+  }
+
+  json_decref(root);
+
+  njt_sha1_init(&sha1);
+  njt_sha1_update(&sha1, data, len);
+  njt_sha1_final(ks->tag, &sha1);
+
+  if (ks->pool)
+  {
+    njt_destroy_pool(ks->pool);
+  }
+
+  ks->pool = pool;
+  ks->keys = keys;
+
+  njt_log_error(NJT_LOG_INFO, log, 0, "JWT: loaded %ui keys", keys->nelts);
+
+  return NJT_OK;
+
+failed:
+
+  if (pool)
+  {
+    njt_destroy_pool(pool);
+  }
+
+  json_decref(root);
+
+  return NJT_ERROR;
+}
+
+
+static void auth_jwt_keyset_cleanup(void *data)
+{
+  njt_http_auth_jwt_keyset_t *ks = data;
+
+  if (ks->pool)
+  {
+    njt_destroy_pool(ks->pool);
+    ks->pool = NULL;
+    ks->keys = NULL;
+  }
+}
+
+
+// Convert a JWK (RFC 7517) into a key libjwt takes
+static njt_int_t auth_jwt_jwk_parse(njt_pool_t *pool, json_t *jwk, njt_http_auth_jwt_jwk_t *key, njt_log_t *log)
+{
+  const char *kty, *use, *alg, *kid, *crv;
+  njt_str_t n, e, x, y;
+  EVP_PKEY *pkey;
+  RSA *rsa;
+  EC_KEY *ec;
+  BIGNUM *bn1, *bn2;
+  njt_int_t rc;
+  int nid;
+
+  kty = json_string_value(json_object_get(jwk, "kty"));
+  use = json_string_value(json_object_get(jwk, "use"));
+  alg = json_string_value(json_object_get(jwk, "alg"));
+  kid = json_string_value(json_object_get(jwk, "kid"));
+
+  if (kty == NULL || (use != NULL && njt_strcmp(use, "sig") != 0))
+  {
+    return NJT_DECLINED;
+  }
+
+  key->alg = JWT_ALG_ANY;
+  if (alg != NULL)
+  {
+    key->alg = jwt_str_alg(alg);
+    if (key->alg == JWT_ALG_INVAL || key->alg == JWT_ALG_NONE)
+    {
+      return NJT_DECLINED;
+    }
+  }
+
+  njt_str_null(&key->kid);
+  if (kid != NULL)
+  {
+    key->kid.len = njt_strlen(kid);
+    key->kid.data = njt_pstrdup(pool, &(njt_str_t) { key->kid.len, (u_char *) kid });
+    if (key->kid.data == NULL)
+    {
+      return NJT_ERROR;
+    }
+  }
+
+  if (njt_strcmp(kty, "oct") == 0)
+  {
+    key->kty = NJT_HTTP_AUTH_JWT_KTY_OCT;
+    return auth_jwt_jwk_b64(pool, json_object_get(jwk, "k"), &key->key);
+  }
+
+  pkey = NULL;
+  bn1 = NULL;
+  bn2 = NULL;
+  rc = NJT_DECLINED;
+
+  if (njt_strcmp(kty, "RSA") == 0)
+  {
+    key->kty = NJT_HTTP_AUTH_JWT_KTY_RSA;
+
+    if (auth_jwt_jwk_b64(pool, json_object_get(jwk, "n"), &n) != NJT_OK
+        || auth_jwt_jwk_b64(pool, json_object_get(jwk, "e"), &e) != NJT_OK)
+    {
+      return NJT_DECLINED;
+    }
+
+    bn1 = BN_bin2bn(n.data, n.len, NULL);
+    bn2 = BN_bin2bn(e.data, e.len, NULL);
+    rsa = RSA_new();
+
+    if (bn1 == NULL || bn2 == NULL || rsa == NULL || RSA_set0_key(rsa, bn1, bn2, NULL) != 1)
+    {
+      RSA_free(rsa);
+      goto done;
+    }
+
+    // Owned by the key now
+    bn1 = NULL;
+    bn2 = NULL;
+
+    pkey = EVP_PKEY_new();
+    if (pkey == NULL || EVP_PKEY_assign_RSA(pkey, rsa) != 1)
+    {
+      RSA_free(rsa);
+      goto done;
+    }
+  }
+  else if (njt_strcmp(kty, "EC") == 0)
+  {
+    key->kty = NJT_HTTP_AUTH_JWT_KTY_EC;
+
+    crv = json_string_value(json_object_get(jwk, "crv"));
+    if (crv == NULL)
+    {
+      return NJT_DECLINED;
+    }
+    else if (njt_strcmp(crv, "P-256") == 0)
+    {
+      nid = NID_X9_62_prime256v1;
+    }
+    else if (njt_strcmp(crv, "P-384") == 0)
+    {
+      nid = NID_secp384r1;
+    }
+    else if (njt_strcmp(crv, "P-521") == 0)
+    {
+      nid = NID_secp521r1;
+    }
+    else
+    {
+      return NJT_DECLINED;
+    }
+
+    if (auth_jwt_jwk_b64(pool, json_object_get(jwk, "x"), &x) != NJT_OK
+        || auth_jwt_jwk_b64(pool, json_object_get(jwk, "y"), &y) != NJT_OK)
+    {
+      return NJT_DECLINED;
+    }
+
+    bn1 = BN_bin2bn(x.data, x.len, NULL);
+    bn2 = BN_bin2bn(y.data, y.len, NULL);
+    ec = EC_KEY_new_by_curve_name(nid);
+
+    if (bn1 == NULL || bn2 == NULL || ec == NULL
+        || EC_KEY_set_public_key_affine_coordinates(ec, bn1, bn2) != 1)
+    {
+      EC_KEY_free(ec);
+      goto done;
+    }
+
+    pkey = EVP_PKEY_new();
+    if (pkey == NULL || EVP_PKEY_assign_EC_KEY(pkey, ec) != 1)
+    {
+      EC_KEY_free(ec);
+      goto done;
+    }
+  }
+  else
+  {
+    return NJT_DECLINED;
+  }
+
+  rc = auth_jwt_jwk_pem(pool, pkey, &key->key);
+
+done:
+
+  if (rc == NJT_DECLINED)
+  {
+    njt_ssl_error(NJT_LOG_ERR, log, 0, "JWT: invalid %s key \"%s\"", kty, kid ? kid : "");
+  }
+
+  if (pkey)
+  {
+    EVP_PKEY_free(pkey);
+  }
+
+  BN_free(bn1);
+  BN_free(bn2);
+
+  return rc;
+}
+
+
+// Decode a base64url JWK member
+static njt_int_t auth_jwt_jwk_b64(njt_pool_t *pool, json_t *value, njt_str_t *dst)
+{
+  njt_str_t src;
+
+  if (!json_is_string(value))
+  {
+    return NJT_DECLINED;
+  }
+
+  src.data = (u_char *) json_string_value(value);
+  src.len = json_string_length(value);
+
+  dst->data = njt_pnalloc(pool, njt_base64_decoded_length(src.len));
+  if (dst->data == NULL)
+  {
+    return NJT_ERROR;
+  }
+
+  if (njt_decode_base64url(dst, &src) != NJT_OK || dst->len == 0)
+  {
+    return NJT_DECLINED;
+  }
+
+  return NJT_OK;
+}
+
+
+static njt_int_t auth_jwt_jwk_pem(njt_pool_t *pool, EVP_PKEY *pkey, njt_str_t *pem)
+{
+  BIO *bio;
+  char *data;
+  long len;
+
+  bio = BIO_new(BIO_s_mem());
+  if (bio == NULL)
+  {
+    return NJT_ERROR;
+  }
+
+  if (PEM_write_bio_PUBKEY(bio, pkey) != 1)
+  {
+    BIO_free(bio);
+    return NJT_DECLINED;
+  }
+
+  len = BIO_get_mem_data(bio, &data);
+
+  pem->len = len;
+  pem->data = njt_pnalloc(pool, len);
+  if (pem->data == NULL)
+  {
+    BIO_free(bio);
+    return NJT_ERROR;
+  }
+
+  njt_memcpy(pem->data, data, len);
+  BIO_free(bio);
+
+  return NJT_OK;
+}
+
+
+// Pick the key named by "kid", or the first one fitting the algorithm
+static int auth_jwt_key_provider(const jwt_t *jwt, jwt_key_t *key)
+{
+  njt_http_auth_jwt_jwk_t *jwk;
+  const char *kid;
+  njt_uint_t i, kty;
+  size_t len;
+  jwt_alg_t alg;
+
+  alg = jwt_get_alg(jwt);
+
+  switch (alg)
+  {
+    case JWT_ALG_HS256:
+    case JWT_ALG_HS384:
+    case JWT_ALG_HS512:
+      kty = NJT_HTTP_AUTH_JWT_KTY_OCT;
+      break;
+    case JWT_ALG_RS256:
+    case JWT_ALG_RS384:
+    case JWT_ALG_RS512:
+      kty = NJT_HTTP_AUTH_JWT_KTY_RSA;
+      break;
+    case JWT_ALG_ES256:
+    case JWT_ALG_ES384:
+    case JWT_ALG_ES512:
+      kty = NJT_HTTP_AUTH_JWT_KTY_EC;
+      break;
+    default:
+      return EINVAL;
+  }
+
+  kid = jwt_get_header((jwt_t *) jwt, "kid");
+  len = kid ? njt_strlen(kid) : 0;
+
+  jwk = auth_jwt_keyset->keys->elts;
+  for (i = 0; i < auth_jwt_keyset->keys->nelts; i++)
+  {
+    if (jwk[i].kty != kty || (jwk[i].alg != JWT_ALG_ANY && jwk[i].alg != (njt_uint_t) alg))
+    {
+      continue;
+    }
+
+    if (kid && (jwk[i].kid.len != len || njt_strncmp(jwk[i].kid.data, kid, len) != 0))
+    {
+      continue;
+    }
+
+    key->jwt_key = jwk[i].key.data;
+    key->jwt_key_len = jwk[i].key.len;
+
+    return 0;
+  }
+
+  return ENOENT;
+}
+
+
+static njt_int_t auth_jwt_cache_lookup(njt_http_request_t *r, njt_shm_zone_t *zone, u_char *digest)
+{
+  njt_http_auth_jwt_main_conf_t *amcf;
+  njt_http_auth_jwt_cache_t *cache;
+  njt_http_auth_jwt_node_t *jn;
+  njt_http_auth_jwt_ctx_t *ctx;
+  njt_http_variable_value_t *v;
+  njt_rbtree_node_t *node, *sentinel;
+  njt_rbtree_key_t key;
+  njt_uint_t i;
+  njt_int_t rc;
+  u_short len;
+  u_char *p;
+
+  cache = zone->data;
+  amcf = njt_http_get_module_main_conf(r, njt_http_auth_jwt_module);
+
+  njt_memcpy(&key, digest, sizeof(njt_rbtree_key_t));
+
+  njt_shmtx_lock(&cache->shpool->mutex);
+
+  node = cache->sh->rbtree.root;
+  sentinel = cache->sh->rbtree.sentinel;
+  jn = NULL;
+
+  while (node != sentinel)
+  {
+    if (key != node->key)
+    {
+      node = (key < node->key) ? node->left : node->right;
+      continue;
+    }
+
+    jn = (njt_http_auth_jwt_node_t *) &node->color;
+
+    rc = njt_memcmp(digest, jn->digest, NJT_HTTP_AUTH_JWT_DIGEST_LEN);
+    if (rc == 0)
+    {
+      break;
+    }
+
+    node = (rc < 0) ? node->left : node->right;
+    jn = NULL;
+  }
+
+  if (jn == NULL)
+  {
+    njt_shmtx_unlock(&cache->shpool->mutex);
+    return NJT_DECLINED;
+  }
+
+  if (jn->expire <= njt_time())
+  {
+    njt_queue_remove(&jn->queue);
+    njt_rbtree_delete(&cache->sh->rbtree, node);
+    njt_slab_free_locked(cache->shpool, node);
+
+    njt_shmtx_unlock(&cache->shpool->mutex);
+    return NJT_DECLINED;
+  }
+
+  njt_queue_remove(&jn->queue);
+  njt_queue_insert_head(&cache->sh->queue, &jn->queue);
+
+  rc = NJT_OK;
+
+  if (amcf->claims.nelts)
+  {
+    ctx = auth_jwt_get_ctx(r);
+    v = njt_pcalloc(r->pool, amcf->claims.nelts * sizeof(njt_http_variable_value_t));
+    p = njt_pnalloc(r->pool, jn->len);
+
+    if (ctx == NULL || v == NULL || p == NULL)
+    {
+      rc = NJT_ERROR;
+      goto done;
+    }
+
+    njt_memcpy(p, jn->data, jn->len);
+
+    for (i = 0; i < amcf->claims.nelts; i++)
+    {
+      njt_memcpy(&len, p, sizeof(u_short));
+      p += sizeof(u_short);
+
+      if (len == (u_short) -1)
+      {
+        v[i].not_found = 1;
+        continue;
+      }
+
+      v[i].len = len;
+      v[i].valid = 1;
+      v[i].no_cacheable = 1;
+      v[i].data = p;
+      p += len;
+    }
+
+    ctx->claims = v;
+  }
+
+done:
+
+  njt_shmtx_unlock(&cache->shpool->mutex);
+
+  njt_log_debug1(NJT_LOG_DEBUG_HTTP, r->connection->log, 0, "JWT: cache hit, rc:%i", rc);
+
+  return rc;
+}
+
+
+static void auth_jwt_cache_store(njt_http_request_t *r, njt_shm_zone_t *zone, u_char *digest, time_t exp)
+{
+  njt_http_auth_jwt_cache_t *cache;
+  njt_http_auth_jwt_main_conf_t *amcf;
+  njt_http_auth_jwt_node_t *jn;
+  njt_http_auth_jwt_ctx_t *ctx;
+  njt_http_variable_value_t *v;
+  njt_rbtree_node_t *node;
+  njt_queue_t *q;
+  njt_uint_t i, tries;
+  size_t len, size;
+  u_short n;
+  time_t now, expire;
+  u_char *p;
+
+  cache = zone->data;
+  amcf = njt_http_get_module_main_conf(r, njt_http_auth_jwt_module);
+  ctx = njt_http_get_module_ctx(r, njt_http_auth_jwt_module);
+
+  now = njt_time();
+  expire = now + cache->ttl;
+
+  if (exp != -1 && exp < expire)
+  {
+    expire = exp;
+  }
+
+  if (expire <= now)
+  {
+    return;
+  }
+
+  len = 0;
+  v = (ctx && amcf->claims.nelts) ? ctx->claims : NULL;
+
+  for (i = 0; v && i < amcf->claims.nelts; i++)
+  {
+    if (!v[i].not_found && v[i].len >= (u_short) -1)
+    {
+      return;
+    }
+
+    len += sizeof(u_short) + (v[i].not_found ? 0 : v[i].len);
+  }
+
+  if (len >= (u_short) -1)
+  {
+    return;
+  }
+
+  size = offsetof(njt_rbtree_node_t, color) + offsetof(njt_http_auth_jwt_node_t, data) + len;
+
+  njt_shmtx_lock(&cache->shpool->mutex);
+
+  auth_jwt_cache_expire(cache, now);
+
+  node = njt_slab_alloc_locked(cache->shpool, size);
+
+  // Make room by dropping the least recently used tokens
+  for (tries = 0; node == NULL && tries < 8; tries++)
+  {
+    if (njt_queue_empty(&cache->sh->queue))
+    {
+      break;
+    }
+
+    q = njt_queue_last(&cache->sh->queue);
+    jn = njt_queue_data(q, njt_http_auth_jwt_node_t, queue);
+
+    njt_queue_remove(q);
+    njt_rbtree_delete(&cache->sh->rbtree, (njt_rbtree_node_t *) ((u_char *) jn - offsetof(njt_rbtree_node_t, color)));
+    njt_slab_free_locked(cache->shpool, (u_char *) jn - offsetof(njt_rbtree_node_t, color));
+
+    node = njt_slab_alloc_locked(cache->shpool, size);
+  }
+
+  if (node == NULL)
+  {
+    njt_shmtx_unlock(&cache->shpool->mutex);
+    njt_log_error(NJT_LOG_WARN, r->connection->log, 0, "JWT: could not allocate cache node");
+    return;
+  }
+
+  jn = (njt_http_auth_jwt_node_t *) &node->color;
+
+  njt_memcpy(&node->key, digest, sizeof(njt_rbtree_key_t));
+  njt_memcpy(jn->digest, digest, NJT_HTTP_AUTH_JWT_DIGEST_LEN);
+  jn->expire = expire;
+  jn->len = (u_short) len;
+
+  p = jn->data;
+
+  for (i = 0; v && i < amcf->claims.nelts; i++)
+  {
+    n = v[i].not_found ? (u_short) -1 : (u_short) v[i].len;
+    p = njt_cpymem(p, &n, sizeof(u_short));
+
+    if (!v[i].not_found)
+    {
+      p = njt_cpymem(p, v[i].data, v[i].len);
+    }
+  }
+
+  njt_rbtree_insert(&cache->sh->rbtree, node);
+  njt_queue_insert_head(&cache->sh->queue, &jn->queue);
+
+  njt_shmtx_unlock(&cache->shpool->mutex);
+}
+
+
+// Drop up to two expired tokens, like limit_req does with stale states
+static void auth_jwt_cache_expire(njt_http_auth_jwt_cache_t *cache, time_t now)
+{
+  njt_http_auth_jwt_node_t *jn;
+  njt_rbtree_node_t *node;
+  njt_queue_t *q;
+  njt_uint_t n;
+
+  for (n = 0; n < 2; n++)
+  {
+    if (njt_queue_empty(&cache->sh->queue))
+    {
+      return;
+    }
+
+    q = njt_queue_last(&cache->sh->queue);
+    jn = njt_queue_data(q, njt_http_auth_jwt_node_t, queue);
+
+    if (jn->expire > now)
+    {
+      return;
+    }
+
+    node = (njt_rbtree_node_t *) ((u_char *) jn - offsetof(njt_rbtree_node_t, color));
+
+    njt_queue_remove(q);
+    njt_rbtree_delete(&cache->sh->rbtree, node);
+    njt_slab_free_locked(cache->shpool, node);
+  }
+}
+
+
+static void auth_jwt_cache_rbtree_insert_value(njt_rbtree_node_t *temp, njt_rbtree_node_t *node, njt_rbtree_node_t *sentinel)
+{
+  njt_http_auth_jwt_node_t *jn, *jnt;
+  njt_rbtree_node_t **p;
+
+  for ( ;; )
+  {
+    if (node->key < temp->key)
+    {
+      p = &temp->left;
+    }
+    else if (node->key > temp->key)
+    {
+      p = &temp->right;
+    }
+    else
+    {
+      jn = (njt_http_auth_jwt_node_t *) &node->color;
+      jnt = (njt_http_auth_jwt_node_t *) &temp->color;
+
+      p = (njt_memcmp(jn->digest, jnt->digest, NJT_HTTP_AUTH_JWT_DIGEST_LEN) < 0)
+          ? &temp->left : &temp->right;
+    }
+
+    if (*p == sentinel)
+    {
+      break;
+    }
+
+    temp = *p;
+  }
+
+  *p = node;
+  node->parent = temp;
+  node->left = sentinel;
+  node->right = sentinel;
+  njt_rbt_red(node);
+}
+
+
+static njt_int_t auth_jwt_cache_init_zone(njt_shm_zone_t *shm_zone, void *data)
+{
+  njt_http_auth_jwt_cache_t *ocache = data;
+  njt_http_auth_jwt_cache_t *cache;
+  size_t len;
+
+  cache = shm_zone->data;
+
+  if (ocache)
+  {
+    cache->sh = ocache->sh;
+    cache->shpool = ocache->shpool;
+    return NJT_OK;
+  }
+
+  cache->shpool = (njt_slab_pool_t *) shm_zone->shm.addr;
+
+  if (shm_zone->shm.exists)
+  {
+    cache->sh = cache->shpool->data;
+    return NJT_OK;
+  }
+
+  cache->sh = njt_slab_alloc(cache->shpool, sizeof(njt_http_auth_jwt_shctx_t));
+  if (cache->sh == NULL)
+  {
+    return NJT_ERROR;
+  }
+
+  cache->shpool->data = cache->sh;
+
+  njt_rbtree_init(&cache->sh->rbtree, &cache->sh->sentinel, auth_jwt_cache_rbtree_insert_value);
+  njt_queue_init(&cache->sh->queue);
+
+  len = sizeof(" in auth_jwt cache zone \"\"") + shm_zone->shm.name.len;
+
+  cache->shpool->log_ctx = njt_slab_alloc(cache->shpool, len);
+  if (cache->shpool->log_ctx == NULL)
+  {
+    return NJT_ERROR;
+  }
+
+  njt_sprintf(cache->shpool->log_ctx, " in auth_jwt cache zone \"%V\"%Z", &shm_zone->shm.name);
+
+  cache->shpool->log_nomem = 0;
+
+  return NJT_OK;
+}
+
+
+// Copy the auth_jwt_claim_set claims of a verified token into the request
+static njt_int_t auth_jwt_set_claims(njt_http_request_t *r, jwt_t *jwt)
+{
+  njt_http_auth_jwt_main_conf_t *amcf;
+  njt_http_auth_jwt_claim_t *claim;
+  njt_http_auth_jwt_ctx_t *ctx;
+  njt_http_variable_value_t *v;
+  const char *str;
+  char *json;
+  njt_uint_t i;
+  size_t len;
+
+  amcf = njt_http_get_module_main_conf(r, njt_http_auth_jwt_module);
+  if (amcf->claims.nelts == 0)
+  {
+    return NJT_OK;
+  }
+
+  ctx = auth_jwt_get_ctx(r);
+  if (ctx == NULL)
+  {
+    return NJT_ERROR;
+  }
+
+  v = njt_pcalloc(r->pool, amcf->claims.nelts * sizeof(njt_http_variable_value_t));
+  if (v == NULL)
+  {
+    return NJT_ERROR;
+  }
+
+  claim = amcf->claims.elts;
+  for (i = 0; i < amcf->claims.nelts; i++)
+  {
+    json = NULL;
+
+    // Strings as they are, other values as JSON text
+    str = jwt_get_grant(jwt, (char *) claim[i].name.data);
+    if (str == NULL)
+    {
+      json = jwt_get_grants_json(jwt, (char *) claim[i].name.data);
+      str = json;
+    }
+
+    if (str == NULL)
+    {
+      v[i].not_found = 1;
+      continue;
+    }
+
+    len = njt_strlen(str);
+
+    v[i].data = njt_pnalloc(r->pool, len);
+    if (v[i].data == NULL)
+    {
+      if (json)
+      {
+        jwt_free_str(json);
+      }
+      return NJT_ERROR;
+    }
+
+    njt_memcpy(v[i].data, str, len);
+    v[i].len = len;
+    v[i].valid = 1;
+    v[i].no_cacheable = 1;
+
+    if (json)
+    {
+      jwt_free_str(json);
+    }
+  }
+
+  ctx->claims = v;
+
+  return NJT_OK;
+}
+
+
+static njt_int_t njt_http_auth_jwt_claim_variable(njt_http_request_t *r, njt_http_variable_value_t *v, uintptr_t data)
+{
+  njt_http_auth_jwt_ctx_t *ctx;
+
+  ctx = njt_http_get_module_ctx(r->main, njt_http_auth_jwt_module);
+  if (ctx == NULL || ctx->claims == NULL)
+  {
+    v->not_found = 1;
+    return NJT_OK;
+  }
+
+  *v = ctx->claims[data];
+
+  return NJT_OK;
+}
@@ -524,6 +524,32 @@ not_supported:
 }
 
 
+#if (NJT_HTTP_UPSTREAM_ADAPTIVE)
+
+size_t
+njt_http_vhost_traffic_status_display_get_adaptive_size(njt_http_request_t *r)
+{
+    size_t                          size;
+    njt_uint_t                      i;
+    njt_http_upstream_srv_conf_t  **uscfp;
+    njt_http_upstream_main_conf_t  *umcf;
+
+    umcf = njt_http_cycle_get_module_main_conf(njt_http_vtsp_cycle, njt_http_upstream_module);
+    uscfp = umcf->upstreams.elts;
+
+    size = sizeof(NJT_HTTP_VHOST_TRAFFIC_STATUS_JSON_FMT_ADAPTIVE_S);
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+        size += sizeof(NJT_HTTP_VHOST_TRAFFIC_STATUS_JSON_FMT_ADAPTIVE)
+                + uscfp[i]->host.len + 11 * NJT_ATOMIC_T_LEN;
+    }
+
+    return size;
+}
+
+#endif
+
+
 njt_int_t
 njt_http_vhost_traffic_status_display_get_size(njt_http_request_t *r,
     njt_int_t format)
@@ -563,6 +589,9 @@ njt_http_vhost_traffic_status_display_get_size(njt_http_request_t *r,
                * NJT_ATOMIC_T_LEN * un  /* values size */
                + (un * 1024)            /* names  size */
                + 4096;                  /* main   size */
+#if (NJT_HTTP_UPSTREAM_ADAPTIVE)
+        size += njt_http_vhost_traffic_status_display_get_adaptive_size(r);
+#endif
         break;
 
     case NJT_HTTP_VHOST_TRAFFIC_STATUS_FORMAT_HTML:
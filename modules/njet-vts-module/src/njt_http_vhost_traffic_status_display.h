@@ -13,6 +13,10 @@ njt_int_t njt_http_vhost_traffic_status_display_get_upstream_nelts(
     njt_http_request_t *r);
 njt_int_t njt_http_vhost_traffic_status_display_get_size(
     njt_http_request_t *r, njt_int_t format);
+#if (NJT_HTTP_UPSTREAM_ADAPTIVE)
+size_t njt_http_vhost_traffic_status_display_get_adaptive_size(
+    njt_http_request_t *r);
+#endif
 
 u_char *njt_http_vhost_traffic_status_display_get_time_queue(
     njt_http_request_t *r,
@@ -15,6 +15,10 @@
 #include "njt_http_upstream_check_module.h"
 #endif
 
+#if (NJT_HTTP_UPSTREAM_ADAPTIVE)
+#include <njt_http_upstream_adaptive_module.h>
+#endif
+
 
 u_char *
 njt_http_vhost_traffic_status_display_set_main(njt_http_request_t *r,
@@ -864,6 +868,52 @@ njt_http_vhost_traffic_status_display_set_cache(njt_http_request_t *r,
 #endif
 
 
+#if (NJT_HTTP_UPSTREAM_ADAPTIVE)
+
+u_char *
+njt_http_vhost_traffic_status_display_set_adaptive(njt_http_request_t *r,
+    u_char *buf)
+{
+    njt_uint_t                              i;
+    njt_http_upstream_srv_conf_t           *uscf, **uscfp;
+    njt_http_upstream_main_conf_t          *umcf;
+    njt_http_upstream_adaptive_shctx_t     *sh;
+    njt_http_upstream_adaptive_srv_conf_t  *acf;
+
+    umcf = njt_http_cycle_get_module_main_conf(njt_http_vtsp_cycle, njt_http_upstream_module);
+    uscfp = umcf->upstreams.elts;
+
+    for (i = 0; i < umcf->upstreams.nelts; i++) {
+
+        uscf = uscfp[i];
+
+        if (uscf->srv_conf == NULL) {
+            continue;
+        }
+
+        acf = njt_http_conf_upstream_srv_conf(uscf, njt_http_upstream_adaptive_module);
+
+        sh = acf->sh;
+        if (sh == NULL) {
+            continue;
+        }
+
+        buf = njt_sprintf(buf, NJT_HTTP_VHOST_TRAFFIC_STATUS_JSON_FMT_ADAPTIVE,
+                          &uscf->host,
+                          acf->algorithm == NJT_HTTP_UPSTREAM_ADAPTIVE_VEGAS
+                          ? "vegas" : "gradient",
+                          sh->limit, acf->min, acf->max,
+                          sh->inflight, sh->queued,
+                          sh->rtt_sample, sh->rtt_long, sh->rtt_noload,
+                          sh->admitted, sh->rejected, sh->timedout);
+    }
+
+    return buf;
+}
+
+#endif
+
+
 u_char *
 njt_http_vhost_traffic_status_display_set(njt_http_request_t *r,
     u_char *buf)
@@ -946,6 +996,26 @@ njt_http_vhost_traffic_status_display_set(njt_http_request_t *r,
         buf = njt_sprintf(buf, NJT_HTTP_VHOST_TRAFFIC_STATUS_JSON_FMT_E);
     }
 
+#if (NJT_HTTP_UPSTREAM_ADAPTIVE)
+    /* adaptiveZones */
+    o = buf;
+
+    buf = njt_sprintf(buf, NJT_HTTP_VHOST_TRAFFIC_STATUS_JSON_FMT_NEXT);
+    buf = njt_sprintf(buf, NJT_HTTP_VHOST_TRAFFIC_STATUS_JSON_FMT_ADAPTIVE_S);
+
+    s = buf;
+
+    buf = njt_http_vhost_traffic_status_display_set_adaptive(r, buf);
+
+    if (s == buf) {
+        buf = o;
+
+    } else {
+        buf--;
+        buf = njt_sprintf(buf, NJT_HTTP_VHOST_TRAFFIC_STATUS_JSON_FMT_E);
+    }
+#endif
+
 #if (NJT_HTTP_CACHE)
     /* cacheZones */
     o = buf;
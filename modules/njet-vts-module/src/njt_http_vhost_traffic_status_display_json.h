@@ -225,6 +225,24 @@
     "},"
 #endif
 
+#if (NJT_HTTP_UPSTREAM_ADAPTIVE)
+#define NJT_HTTP_VHOST_TRAFFIC_STATUS_JSON_FMT_ADAPTIVE_S "\"adaptiveZones\":{"
+#define NJT_HTTP_VHOST_TRAFFIC_STATUS_JSON_FMT_ADAPTIVE "\"%V\":{"             \
+    "\"algorithm\":\"%s\","                                                    \
+    "\"limit\":%uA,"                                                           \
+    "\"minLimit\":%ui,"                                                        \
+    "\"maxLimit\":%ui,"                                                        \
+    "\"inFlight\":%uA,"                                                        \
+    "\"queued\":%uA,"                                                          \
+    "\"rttUsec\":%uA,"                                                         \
+    "\"rttLongUsec\":%uA,"                                                     \
+    "\"rttNoLoadUsec\":%uA,"                                                   \
+    "\"admitted\":%uA,"                                                        \
+    "\"rejected\":%uA,"                                                        \
+    "\"timedOut\":%uA"                                                         \
+    "},"
+#endif
+
 
 u_char *njt_http_vhost_traffic_status_display_set_main(
     njt_http_request_t *r, u_char *buf);
@@ -264,6 +282,11 @@ u_char *njt_http_vhost_traffic_status_display_set_cache(
     njt_rbtree_node_t *node);
 #endif
 
+#if (NJT_HTTP_UPSTREAM_ADAPTIVE)
+u_char *njt_http_vhost_traffic_status_display_set_adaptive(
+    njt_http_request_t *r, u_char *buf);
+#endif
+
 u_char *njt_http_vhost_traffic_status_display_set(njt_http_request_t *r,
     u_char *buf);
 
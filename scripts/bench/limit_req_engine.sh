@@ -0,0 +1,124 @@
+#!/bin/sh
+#
+# Compare the rbtree and gcra engines of limit_req_zone.
+#
+# Every run starts njet with the given count of workers, all requests go
+# through one limit_req zone and are spread over KEYS keys, wrk drives the
+# load.  RATE is high enough by default that nothing is rejected, so the
+# cost of the zone itself (and the contention on it) is measured.
+#
+# usage: limit_req_engine.sh [path to njet]
+#
+#   WORKERS    worker counts to test          "1 2 4 8 16 32 64"
+#   ENGINES    engines to test                "rbtree gcra"
+#   KEYS       distinct keys                  10000
+#   RATE       rate of the zone               1000000r/s
+#   CONNS      wrk connections                256
+#   THREADS    wrk threads                    8
+#   DURATION   seconds of every run           10
+#   PORT       listen port                    18480
+#   WRK        wrk binary                     wrk
+#
+
+NJET=${1:-objs/njet}
+WORKERS=${WORKERS:-"1 2 4 8 16 32 64"}
+ENGINES=${ENGINES:-"rbtree gcra"}
+KEYS=${KEYS:-10000}
+RATE=${RATE:-1000000r/s}
+CONNS=${CONNS:-256}
+THREADS=${THREADS:-8}
+DURATION=${DURATION:-10}
+PORT=${PORT:-18480}
+WRK=${WRK:-wrk}
+
+if [ ! -x "$NJET" ]; then
+    echo "njet binary \"$NJET\" not found" >&2
+    exit 1
+fi
+
+if ! command -v "$WRK" > /dev/null 2>&1; then
+    echo "wrk binary \"$WRK\" not found" >&2
+    exit 1
+fi
+
+PREFIX=$(mktemp -d /tmp/limit_req_bench.XXXXXX)
+mkdir -p $PREFIX/conf $PREFIX/logs $PREFIX/data
+
+# workers write their own logs and data in the prefix
+USER_DIRECTIVE=
+if [ "$(id -u)" = 0 ]; then
+    USER_DIRECTIVE="user root;"
+fi
+
+trap 'stop; rm -rf $PREFIX' EXIT INT TERM
+
+cat > $PREFIX/keys.lua << END
+math.randomseed(os.time())
+request = function()
+    return wrk.format("GET", "/?k=" .. math.random($KEYS))
+end
+END
+
+stop() {
+    if [ -f $PREFIX/logs/njet.pid ]; then
+        kill $(cat $PREFIX/logs/njet.pid) 2> /dev/null
+        sleep 1
+        rm -f $PREFIX/logs/njet.pid
+    fi
+}
+
+start() {
+    engine=$1
+    workers=$2
+
+    cat > $PREFIX/conf/njet.conf << END
+$USER_DIRECTIVE
+worker_processes $workers;
+pid logs/njet.pid;
+error_log logs/error.log warn;
+
+events {
+    worker_connections 4096;
+}
+
+http {
+    access_log off;
+
+    limit_req_zone \$arg_k zone=bench:64m rate=$RATE engine=$engine;
+
+    server {
+        listen 127.0.0.1:$PORT;
+
+        location / {
+            limit_req zone=bench burst=1000 nodelay;
+            empty_gif;
+        }
+    }
+}
+END
+
+    "$NJET" -p $PREFIX -c conf/njet.conf || exit 1
+    sleep 1
+}
+
+printf "%-8s %8s %12s %10s %10s %10s\n" \
+       engine workers requests/s p50 p99 non-2xx
+
+for workers in $WORKERS; do
+    for engine in $ENGINES; do
+        start $engine $workers
+
+        out=$("$WRK" -t$THREADS -c$CONNS -d${DURATION}s --latency \
+                     -s $PREFIX/keys.lua http://127.0.0.1:$PORT/)
+
+        stop
+
+        rps=$(echo "$out" | awk '/^Requests\/sec/ { print $2 }')
+        p50=$(echo "$out" | awk '$1 == "50%" { print $2 }')
+        p99=$(echo "$out" | awk '$1 == "99%" { print $2 }')
+        bad=$(echo "$out" | awk '/Non-2xx/ { print $NF }')
+
+        printf "%-8s %8s %12s %10s %10s %10s\n" \
+               $engine $workers ${rps:--} ${p50:--} ${p99:--} ${bad:-0}
+    done
+done
@@ -0,0 +1,149 @@
+#!/bin/sh
+#
+# Measure quic_sendmmsg with many concurrent small-response connections.
+#
+# Every run starts njet with the given count of workers and a location
+# returning a few bytes, so each request costs a handful of datagrams and
+# the per-datagram system calls dominate.  h2load (built with HTTP/3
+# support) keeps CONNS QUIC connections busy; besides the request rate,
+# the CPU time the workers spent per request is shown.
+#
+# usage: quic_sendmmsg.sh [path to njet]
+#
+#   MODES      quic_sendmmsg values           "off on"
+#   GSO        quic_gso values                "off on"
+#   WORKERS    worker counts to test          "1 4"
+#   CONNS      h2load connections             1000
+#   STREAMS    concurrent streams per conn    1
+#   THREADS    h2load threads                 4
+#   DURATION   seconds of every run           10
+#   PORT       listen port                    18500
+#   H2LOAD     h2load binary                  h2load
+#   OPENSSL    openssl binary                 openssl
+#
+
+NJET=${1:-objs/njet}
+MODES=${MODES:-"off on"}
+GSO=${GSO:-"off on"}
+WORKERS=${WORKERS:-"1 4"}
+CONNS=${CONNS:-1000}
+STREAMS=${STREAMS:-1}
+THREADS=${THREADS:-4}
+DURATION=${DURATION:-10}
+PORT=${PORT:-18500}
+H2LOAD=${H2LOAD:-h2load}
+OPENSSL=${OPENSSL:-openssl}
+
+if [ ! -x "$NJET" ]; then
+    echo "njet binary \"$NJET\" not found" >&2
+    exit 1
+fi
+
+for bin in "$H2LOAD" "$OPENSSL"; do
+    if ! command -v "$bin" > /dev/null 2>&1; then
+        echo "binary \"$bin\" not found" >&2
+        exit 1
+    fi
+done
+
+PREFIX=$(mktemp -d /tmp/quic_sendmmsg_bench.XXXXXX)
+mkdir -p $PREFIX/conf $PREFIX/logs $PREFIX/data
+
+# workers write their own logs and data in the prefix
+USER_DIRECTIVE=
+if [ "$(id -u)" = 0 ]; then
+    USER_DIRECTIVE="user root;"
+fi
+
+trap 'stop; rm -rf $PREFIX' EXIT INT TERM
+
+"$OPENSSL" req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 \
+           -nodes -days 1 -subj /CN=localhost \
+           -keyout $PREFIX/conf/bench.key -out $PREFIX/conf/bench.crt \
+           2> /dev/null || exit 1
+
+TICKS=$(getconf CLK_TCK)
+
+stop() {
+    if [ -f $PREFIX/logs/njet.pid ]; then
+        kill $(cat $PREFIX/logs/njet.pid) 2> /dev/null
+        sleep 1
+        rm -f $PREFIX/logs/njet.pid
+    fi
+}
+
+start() {
+    mode=$1
+    gso=$2
+    workers=$3
+
+    cat > $PREFIX/conf/njet.conf << END
+$USER_DIRECTIVE
+worker_processes $workers;
+pid logs/njet.pid;
+error_log logs/error.log warn;
+
+events {
+    worker_connections 16384;
+}
+
+http {
+    access_log off;
+
+    server {
+        listen 127.0.0.1:$PORT quic reuseport;
+
+        http3 on;
+
+        ssl_certificate bench.crt;
+        ssl_certificate_key bench.key;
+
+        quic_sendmmsg $mode;
+        quic_gso $gso;
+
+        location / {
+            return 200 "ok\n";
+        }
+    }
+}
+END
+
+    "$NJET" -p $PREFIX -c conf/njet.conf || exit 1
+    sleep 1
+}
+
+# user and system time of all workers, in clock ticks
+cpu() {
+    for pid in $(ps -o pid= --ppid $(cat $PREFIX/logs/njet.pid)); do
+        cat /proc/$pid/stat 2> /dev/null
+    done | awk '{ n += $14 + $15 } END { print n + 0 }'
+}
+
+printf "%-5s %-5s %8s %12s %14s\n" \
+       mode gso workers requests/s cpu-us/request
+
+for workers in $WORKERS; do
+    for gso in $GSO; do
+        for mode in $MODES; do
+            start $mode $gso $workers
+
+            before=$(cpu)
+
+            out=$("$H2LOAD" --alpn-list=h3 -t$THREADS -c$CONNS -m$STREAMS \
+                            -D $DURATION https://127.0.0.1:$PORT/)
+
+            after=$(cpu)
+
+            stop
+
+            rps=$(echo "$out" | awk '/^finished in/ { print $4 }')
+            reqs=$(echo "$out" | awk '/^requests:/ { print $8 }')
+
+            us=$(awk -v t=$((after - before)) -v hz=$TICKS -v n=${reqs:-0} \
+                     'BEGIN { if (n > 0) printf "%.1f", t * 1000000 / hz / n }')
+
+            printf "%-5s %-5s %8s %12s %14s\n" \
+                   $mode $gso $workers ${rps:--} ${us:--}
+        done
+    done
+done
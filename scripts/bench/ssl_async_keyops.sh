@@ -0,0 +1,158 @@
+#!/bin/sh
+#
+# Measure ssl_async_keyops during a full handshake storm.
+#
+# Every run starts njet with the given count of workers and a certificate
+# with an expensive key.  CLIENTS "openssl s_time -new" processes make
+# full handshakes as fast as they can, while wrk sends requests over
+# already established keepalive connections: its latency shows how long
+# the event loop is blocked by private key operations.
+#
+# usage: ssl_async_keyops.sh [path to njet]
+#
+#   MODES      ssl_async_keyops values        "off on"
+#   WORKERS    worker counts to test          "1 4"
+#   KEY        key type for openssl req       rsa:4096
+#   POOL       threads of the default pool    32
+#   CLIENTS    concurrent handshake clients   64
+#   CONNS      wrk connections                32
+#   THREADS    wrk threads                    4
+#   DURATION   seconds of every run           10
+#   PORT       listen port                    18490
+#   WRK        wrk binary                     wrk
+#   OPENSSL    openssl binary                 openssl
+#
+
+NJET=${1:-objs/njet}
+MODES=${MODES:-"off on"}
+WORKERS=${WORKERS:-"1 4"}
+KEY=${KEY:-rsa:4096}
+POOL=${POOL:-32}
+CLIENTS=${CLIENTS:-64}
+CONNS=${CONNS:-32}
+THREADS=${THREADS:-4}
+DURATION=${DURATION:-10}
+PORT=${PORT:-18490}
+WRK=${WRK:-wrk}
+OPENSSL=${OPENSSL:-openssl}
+
+if [ ! -x "$NJET" ]; then
+    echo "njet binary \"$NJET\" not found" >&2
+    exit 1
+fi
+
+for bin in "$WRK" "$OPENSSL"; do
+    if ! command -v "$bin" > /dev/null 2>&1; then
+        echo "binary \"$bin\" not found" >&2
+        exit 1
+    fi
+done
+
+PREFIX=$(mktemp -d /tmp/ssl_async_keyops_bench.XXXXXX)
+mkdir -p $PREFIX/conf $PREFIX/logs $PREFIX/data
+
+# workers write their own logs and data in the prefix
+USER_DIRECTIVE=
+if [ "$(id -u)" = 0 ]; then
+    USER_DIRECTIVE="user root;"
+fi
+
+trap 'stop; rm -rf $PREFIX' EXIT INT TERM
+
+case $KEY in
+    ec*)  KEYOPT="-newkey ec -pkeyopt ec_paramgen_curve:${KEY#ec:}" ;;
+    *)    KEYOPT="-newkey $KEY" ;;
+esac
+
+"$OPENSSL" req -x509 $KEYOPT -nodes -days 1 -subj /CN=localhost \
+           -keyout $PREFIX/conf/bench.key -out $PREFIX/conf/bench.crt \
+           2> /dev/null || exit 1
+
+stop() {
+    if [ -f $PREFIX/logs/njet.pid ]; then
+        kill $(cat $PREFIX/logs/njet.pid) 2> /dev/null
+        sleep 1
+        rm -f $PREFIX/logs/njet.pid
+    fi
+}
+
+start() {
+    mode=$1
+    workers=$2
+
+    cat > $PREFIX/conf/njet.conf << END
+$USER_DIRECTIVE
+worker_processes $workers;
+pid logs/njet.pid;
+error_log logs/error.log warn;
+
+thread_pool default threads=$POOL;
+
+events {
+    worker_connections 4096;
+}
+
+http {
+    access_log off;
+
+    server {
+        listen 127.0.0.1:$PORT ssl;
+
+        ssl_certificate bench.crt;
+        ssl_certificate_key bench.key;
+        ssl_session_cache off;
+        ssl_session_tickets off;
+
+        ssl_async_keyops $mode;
+
+        keepalive_requests 1000000;
+
+        location / {
+            empty_gif;
+        }
+    }
+}
+END
+
+    "$NJET" -p $PREFIX -c conf/njet.conf || exit 1
+    sleep 1
+}
+
+storm() {
+    n=0
+
+    while [ $n -lt $CLIENTS ]; do
+        "$OPENSSL" s_time -connect 127.0.0.1:$PORT -new -time $DURATION \
+                   > $PREFIX/s_time.$n 2>&1 &
+        n=$((n + 1))
+    done
+}
+
+printf "%-6s %8s %14s %10s %10s %10s\n" \
+       mode workers handshakes/s p50 p99 max
+
+for workers in $WORKERS; do
+    for mode in $MODES; do
+        start $mode $workers
+
+        rm -f $PREFIX/s_time.*
+        storm
+
+        out=$("$WRK" -t$THREADS -c$CONNS -d${DURATION}s --latency \
+                     https://127.0.0.1:$PORT/)
+
+        wait
+
+        stop
+
+        hps=$(cat $PREFIX/s_time.* | awk '/real seconds/ {
+                  if ($4 > 0) { n += $1 / $4 } } END { printf "%d", n }')
+
+        p50=$(echo "$out" | awk '$1 == "50%" { print $2 }')
+        p99=$(echo "$out" | awk '$1 == "99%" { print $2 }')
+        max=$(echo "$out" | awk '$1 == "Latency" { print $4 }')
+
+        printf "%-6s %8s %14s %10s %10s %10s\n" \
+               $mode $workers ${hps:--} ${p50:--} ${p99:--} ${max:--}
+    done
+done
@@ -0,0 +1,744 @@
+
+/*
+ * Copyright (C) Roman Arutyunyan
+ * Copyright (C) Nginx, Inc.
+ * Copyright (C) 2021-2023  TMLake(Beijing) Technology Co., Ltd.
+ */
+
+
+#include <njt_config.h>
+#include <njt_core.h>
+
+
+#define NJT_CHASH_POOL_SIZE   1024
+#define NJT_CHASH_REHASH      16
+
+
+static njt_int_t njt_chash_ketama_build(njt_chash_table_t *table,
+    njt_chash_table_t *prev);
+static njt_uint_t njt_chash_ketama_points(njt_chash_node_t *node,
+    njt_chash_point_t *point);
+static njt_int_t njt_chash_maglev_build(njt_chash_table_t *table);
+static njt_int_t njt_chash_jump_build(njt_chash_table_t *table,
+    njt_chash_table_t *prev);
+static njt_chash_node_t *njt_chash_find_node(njt_chash_node_t **sorted,
+    njt_uint_t n, njt_str_t *name);
+static int njt_libc_cdecl njt_chash_cmp_nodes(const void *one,
+    const void *two);
+static int njt_libc_cdecl njt_chash_cmp_node_refs(const void *one,
+    const void *two);
+static int njt_libc_cdecl njt_chash_cmp_points(const void *one,
+    const void *two);
+
+
+njt_chash_table_t *
+njt_chash_table_create(njt_uint_t method, njt_uint_t n, njt_pool_t *parent,
+    njt_log_t *log)
+{
+    njt_pool_t         *pool;
+    njt_chash_table_t  *table;
+
+    pool = njt_create_pool(NJT_CHASH_POOL_SIZE, log);
+    if (pool == NULL) {
+        return NULL;
+    }
+
+#if (NJT_DYNAMIC_POOL)
+    if (parent && njt_sub_pool(parent, pool) != NJT_OK) {
+        njt_destroy_pool(pool);
+        return NULL;
+    }
+#endif
+
+    table = njt_pcalloc(pool, sizeof(njt_chash_table_t));
+    if (table == NULL) {
+        njt_destroy_pool(pool);
+        return NULL;
+    }
+
+    table->node = njt_pcalloc(pool, sizeof(njt_chash_node_t) * (n ? n : 1));
+    if (table->node == NULL) {
+        njt_destroy_pool(pool);
+        return NULL;
+    }
+
+    table->pool = pool;
+    table->method = method;
+    table->nnodes = n;
+
+    return table;
+}
+
+
+/*
+ * the nodes are set by the caller with names of the peers, the names
+ * are copied to the pool of the table; the previous table is freed
+ */
+
+njt_int_t
+njt_chash_table_build(njt_chash_table_t *table, njt_chash_table_t *prev)
+{
+    u_char             *p;
+    njt_int_t           rc;
+    njt_uint_t          i;
+    njt_chash_node_t   *node;
+    njt_chash_table_t  *same;
+
+    node = table->node;
+    same = (prev && prev->method == table->method) ? prev : NULL;
+
+    for (i = 0; i < table->nnodes; i++) {
+        p = njt_pnalloc(table->pool, node[i].name.len);
+        if (p == NULL) {
+            rc = NJT_ERROR;
+            goto done;
+        }
+
+        njt_memcpy(p, node[i].name.data, node[i].name.len);
+        node[i].name.data = p;
+    }
+
+    switch (table->method) {
+
+    case NJT_CHASH_KETAMA:
+        rc = njt_chash_ketama_build(table, same);
+        break;
+
+    case NJT_CHASH_MAGLEV:
+        rc = njt_chash_maglev_build(table);
+        break;
+
+    default: /* NJT_CHASH_JUMP */
+        rc = njt_chash_jump_build(table, same);
+    }
+
+done:
+
+    if (prev) {
+        njt_chash_table_free(prev);
+    }
+
+    njt_log_debug4(NJT_LOG_DEBUG_CORE, table->pool->log, 0,
+                   "chash table built, method:%ui nodes:%ui "
+                   "number:%ui removed:%ui",
+                   table->method, table->nnodes, table->number,
+                   table->removed);
+
+    return rc;
+}
+
+
+void
+njt_chash_table_free(njt_chash_table_t *table)
+{
+    njt_destroy_pool(table->pool);
+}
+
+
+static njt_int_t
+njt_chash_ketama_build(njt_chash_table_t *table, njt_chash_table_t *prev)
+{
+    int                  rc;
+    u_char              *fresh;
+    njt_uint_t           i, j, n, kept, added;
+    njt_chash_node_t    *node, **map;
+    njt_chash_point_t   *point, *add, *old, *last;
+
+    node = table->node;
+
+    /* peers of one server share the points, the largest weight is used */
+
+    njt_qsort(node, table->nnodes, sizeof(njt_chash_node_t),
+              njt_chash_cmp_nodes);
+
+    for (i = 0, j = 1; j < table->nnodes; j++) {
+
+        if (njt_chash_cmp_nodes(&node[i], &node[j]) == 0) {
+            node[i].weight = njt_max(node[i].weight, node[j].weight);
+            continue;
+        }
+
+        node[++i] = node[j];
+    }
+
+    if (table->nnodes) {
+        table->nnodes = i + 1;
+    }
+
+    fresh = njt_palloc(table->pool, table->nnodes + 1);
+    if (fresh == NULL) {
+        return NJT_ERROR;
+    }
+
+    njt_memset(fresh, 1, table->nnodes);
+
+    /* the points of the servers with unchanged weight are kept */
+
+    map = NULL;
+
+    if (prev && prev->nnodes) {
+        map = njt_pcalloc(table->pool,
+                          sizeof(njt_chash_node_t *) * prev->nnodes);
+        if (map == NULL) {
+            return NJT_ERROR;
+        }
+
+        i = 0;
+        j = 0;
+
+        while (i < prev->nnodes && j < table->nnodes) {
+            rc = njt_chash_cmp_nodes(&prev->node[i], &node[j]);
+
+            if (rc < 0) {
+                i++;
+                continue;
+            }
+
+            if (rc > 0) {
+                j++;
+                continue;
+            }
+
+            if (prev->node[i].weight == node[j].weight) {
+                map[i] = &node[j];
+                fresh[j] = 0;
+            }
+
+            i++;
+            j++;
+        }
+    }
+
+    kept = 0;
+
+    if (map) {
+        for (i = 0; i < prev->number; i++) {
+            if (map[prev->point[i].node - prev->node]) {
+                kept++;
+            }
+        }
+    }
+
+    added = 0;
+
+    for (j = 0; j < table->nnodes; j++) {
+        if (fresh[j]) {
+            added += node[j].weight * 160;
+        }
+    }
+
+    point = njt_palloc(table->pool,
+                       sizeof(njt_chash_point_t) * (kept + added + 1));
+    if (point == NULL) {
+        return NJT_ERROR;
+    }
+
+    add = njt_palloc(table->pool, sizeof(njt_chash_point_t) * (added + 1));
+    if (add == NULL) {
+        return NJT_ERROR;
+    }
+
+    /* only the points of new and reweighted servers are sorted */
+
+    added = 0;
+
+    for (j = 0; j < table->nnodes; j++) {
+        if (fresh[j]) {
+            added += njt_chash_ketama_points(&node[j], &add[added]);
+        }
+    }
+
+    njt_qsort(add, added, sizeof(njt_chash_point_t), njt_chash_cmp_points);
+
+    /* merge with the points kept, a hash taken by two servers goes once */
+
+    n = 0;
+    i = 0;
+    j = 0;
+    last = NULL;
+
+    for ( ;; ) {
+
+        while (map && i < prev->number
+               && map[prev->point[i].node - prev->node] == NULL)
+        {
+            i++;
+        }
+
+        old = (map && i < prev->number) ? &prev->point[i] : NULL;
+
+        if (old == NULL && j == added) {
+            break;
+        }
+
+        if (old && (j == added || old->hash <= add[j].hash)) {
+            if (last == NULL || last->hash != old->hash) {
+                point[n].hash = old->hash;
+                point[n].node = map[old->node - prev->node];
+                last = &point[n++];
+            }
+
+            i++;
+
+        } else {
+            if (last == NULL || last->hash != add[j].hash) {
+                point[n] = add[j];
+                last = &point[n++];
+            }
+
+            j++;
+        }
+    }
+
+    njt_pfree(table->pool, add);
+
+    table->point = point;
+    table->number = n;
+
+    return NJT_OK;
+}
+
+
+static njt_uint_t
+njt_chash_ketama_points(njt_chash_node_t *node, njt_chash_point_t *point)
+{
+    u_char      *host, *port, c;
+    size_t       host_len, port_len;
+    uint32_t     hash, base_hash;
+    njt_str_t   *server;
+    njt_uint_t   npoints, j;
+    union {
+        uint32_t  value;
+        u_char    byte[4];
+    } prev_hash;
+
+    server = &node->name;
+
+    /*
+     * Hash expression is compatible with Cache::Memcached::Fast:
+     * crc32(HOST \0 PORT PREV_HASH).
+     */
+
+    if (server->len >= 5
+        && njt_strncasecmp(server->data, (u_char *) "unix:", 5) == 0)
+    {
+        host = server->data + 5;
+        host_len = server->len - 5;
+        port = NULL;
+        port_len = 0;
+        goto done;
+    }
+
+    for (j = 0; j < server->len; j++) {
+        c = server->data[server->len - j - 1];
+
+        if (c == ':') {
+            host = server->data;
+            host_len = server->len - j - 1;
+            port = server->data + server->len - j;
+            port_len = j;
+            goto done;
+        }
+
+        if (c < '0' || c > '9') {
+            break;
+        }
+    }
+
+    host = server->data;
+    host_len = server->len;
+    port = NULL;
+    port_len = 0;
+
+done:
+
+    njt_crc32_init(base_hash);
+    njt_crc32_update(&base_hash, host, host_len);
+    njt_crc32_update(&base_hash, (u_char *) "", 1);
+    njt_crc32_update(&base_hash, port, port_len);
+
+    prev_hash.value = 0;
+    npoints = node->weight * 160;
+
+    for (j = 0; j < npoints; j++) {
+        hash = base_hash;
+
+        njt_crc32_update(&hash, prev_hash.byte, 4);
+        njt_crc32_final(hash);
+
+        point[j].hash = hash;
+        point[j].node = node;
+
+#if (NJT_HAVE_LITTLE_ENDIAN)
+        prev_hash.value = hash;
+#else
+        prev_hash.byte[0] = (u_char) (hash & 0xff);
+        prev_hash.byte[1] = (u_char) ((hash >> 8) & 0xff);
+        prev_hash.byte[2] = (u_char) ((hash >> 16) & 0xff);
+        prev_hash.byte[3] = (u_char) ((hash >> 24) & 0xff);
+#endif
+    }
+
+    return npoints;
+}
+
+
+njt_uint_t
+njt_chash_find_point(njt_chash_table_t *table, uint32_t hash)
+{
+    njt_uint_t          i, j, k;
+    njt_chash_point_t  *point;
+
+    /* find first point >= hash */
+
+    point = table->point;
+
+    i = 0;
+    j = table->number;
+
+    while (i < j) {
+        k = (i + j) / 2;
+
+        if (hash > point[k].hash) {
+            i = k + 1;
+
+        } else if (hash < point[k].hash) {
+            j = k;
+
+        } else {
+            return k;
+        }
+    }
+
+    return i;
+}
+
+
+static njt_int_t
+njt_chash_maglev_build(njt_chash_table_t *table)
+{
+    uint32_t          *offset, *skip, *next, c;
+    njt_str_t         *name;
+    njt_uint_t         i, w, n, filled;
+    njt_chash_node_t  *node;
+
+    static njt_uint_t  sizes[] = {
+        5003, 10007, 20011, 40009, 65537, 131071, 262139, 524287
+    };
+
+    node = table->node;
+    n = table->nnodes;
+
+    for (i = 0, w = 0; i < n; i++) {
+        w += node[i].weight;
+    }
+
+    if (w == 0) {
+        return NJT_OK;
+    }
+
+    /* a prime table size of at least 100 entries per weight unit */
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]) - 1; i++) {
+        if (sizes[i] >= w * 100) {
+            break;
+        }
+    }
+
+    table->number = sizes[i];
+
+    if (table->number < w) {
+        return NJT_ERROR;
+    }
+
+    table->entry = njt_palloc(table->pool, sizeof(uint32_t) * table->number);
+    if (table->entry == NULL) {
+        return NJT_ERROR;
+    }
+
+    offset = njt_palloc(table->pool, sizeof(uint32_t) * 3 * n);
+    if (offset == NULL) {
+        return NJT_ERROR;
+    }
+
+    /*
+     * Maglev: each peer walks its own permutation of the table,
+     * (offset + j * skip) mod M, and takes turns claiming free entries,
+     * "weight" entries per turn
+     */
+
+    skip = offset + n;
+    next = offset + 2 * n;
+
+    for (i = 0; i < n; i++) {
+        name = &node[i].name;
+
+        offset[i] = njt_crc32_long(name->data, name->len) % table->number;
+        skip[i] = njt_murmur_hash2(name->data, name->len)
+                  % (table->number - 1) + 1;
+        next[i] = 0;
+    }
+
+    for (i = 0; i < table->number; i++) {
+        table->entry[i] = NJT_CHASH_NONE;
+    }
+
+    filled = 0;
+
+    for ( ;; ) {
+        for (i = 0; i < n; i++) {
+            for (w = 0; w < node[i].weight; w++) {
+
+                do {
+                    c = (uint32_t) (((uint64_t) next[i] * skip[i] + offset[i])
+                                    % table->number);
+                    next[i]++;
+
+                } while (table->entry[c] != NJT_CHASH_NONE);
+
+                table->entry[c] = i;
+
+                if (++filled == table->number) {
+                    njt_pfree(table->pool, offset);
+                    return NJT_OK;
+                }
+            }
+        }
+    }
+}
+
+
+/*
+ * Jump hash buckets, a peer takes as many buckets as its weight.  Jump
+ * hash only moves keys from the buckets removed at the end, so buckets
+ * of removed peers stay as tombstones and a key of such a bucket is
+ * rehashed: the keys of the remaining peers are not moved.  Buckets of
+ * new peers replace tombstones first and are appended then.
+ */
+
+static njt_int_t
+njt_chash_jump_build(njt_chash_table_t *table, njt_chash_table_t *prev)
+{
+    uint32_t           *entry;
+    njt_uint_t          i, b, n, w, number, *used;
+    njt_chash_node_t   *node, *found, **sorted;
+
+    node = table->node;
+    n = table->nnodes;
+
+    for (i = 0, w = 0; i < n; i++) {
+        w += node[i].weight;
+    }
+
+    number = prev ? prev->number : 0;
+
+    entry = njt_palloc(table->pool, sizeof(uint32_t) * (number + w + 1));
+    used = njt_pcalloc(table->pool, sizeof(njt_uint_t) * (n + 1));
+    sorted = njt_palloc(table->pool, sizeof(njt_chash_node_t *) * (n + 1));
+
+    if (entry == NULL || used == NULL || sorted == NULL) {
+        return NJT_ERROR;
+    }
+
+    for (i = 0; i < n; i++) {
+        sorted[i] = &node[i];
+    }
+
+    njt_qsort(sorted, n, sizeof(njt_chash_node_t *), njt_chash_cmp_node_refs);
+
+    /* the buckets keep their peers, buckets of removed peers are emptied */
+
+    for (b = 0; b < number; b++) {
+        entry[b] = NJT_CHASH_NONE;
+
+        if (prev->entry[b] == NJT_CHASH_NONE) {
+            continue;
+        }
+
+        found = njt_chash_find_node(sorted, n,
+                                    &prev->node[prev->entry[b]].name);
+        if (found == NULL) {
+            continue;
+        }
+
+        i = found - node;
+
+        if (used[i] < node[i].weight) {
+            entry[b] = i;
+            used[i]++;
+        }
+    }
+
+    for (i = 0, b = 0; i < n; i++) {
+        while (used[i] < node[i].weight) {
+
+            while (b < number && entry[b] != NJT_CHASH_NONE) {
+                b++;
+            }
+
+            if (b == number) {
+                number++;
+            }
+
+            entry[b] = i;
+            used[i]++;
+        }
+    }
+
+    /* jump hash does not move other keys when the last buckets go */
+
+    while (number && entry[number - 1] == NJT_CHASH_NONE) {
+        number--;
+    }
+
+    table->removed = 0;
+
+    for (b = 0; b < number; b++) {
+        if (entry[b] == NJT_CHASH_NONE) {
+            table->removed++;
+        }
+    }
+
+    if (table->removed > number / 2) {
+
+        /* most keys would be rehashed, the buckets are reassigned */
+
+        for (i = 0, number = 0; i < n; i++) {
+            for (w = 0; w < node[i].weight; w++) {
+                entry[number++] = i;
+            }
+        }
+
+        table->removed = 0;
+    }
+
+    njt_pfree(table->pool, used);
+    njt_pfree(table->pool, sorted);
+
+    table->entry = entry;
+    table->number = number;
+
+    return NJT_OK;
+}
+
+
+njt_uint_t
+njt_chash_lookup(njt_chash_table_t *table, uint32_t hash)
+{
+    uint32_t    p;
+    uint64_t    key;
+    njt_uint_t  i;
+
+    if (table->method == NJT_CHASH_MAGLEV) {
+        return table->entry[hash % table->number];
+    }
+
+    key = hash;
+
+    for (i = 0; i < NJT_CHASH_REHASH; i++) {
+        p = table->entry[njt_jump_hash(key, table->number)];
+
+        if (p != NJT_CHASH_NONE) {
+            return p;
+        }
+
+        /* a bucket of a removed peer */
+
+        key = (key + i + 1) * 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+    }
+
+    /* the last bucket is never removed */
+
+    return table->entry[table->number - 1];
+}
+
+
+njt_uint_t
+njt_jump_hash(uint64_t key, njt_uint_t buckets)
+{
+    int64_t  b, j;
+
+    /* Lamping, Veach, "A Fast, Minimal Memory, Consistent Hash Algorithm" */
+
+    b = -1;
+    j = 0;
+
+    while (j < (int64_t) buckets) {
+        b = j;
+        key = key * 2862933555777941757ULL + 1;
+        j = (int64_t) ((b + 1) * ((double) (1LL << 31)
+                                  / (double) ((key >> 33) + 1)));
+    }
+
+    return (njt_uint_t) b;
+}
+
+
+static njt_chash_node_t *
+njt_chash_find_node(njt_chash_node_t **sorted, njt_uint_t n, njt_str_t *name)
+{
+    njt_int_t   rc;
+    njt_uint_t  i, j, k;
+
+    i = 0;
+    j = n;
+
+    while (i < j) {
+        k = (i + j) / 2;
+
+        rc = njt_memn2cmp(name->data, sorted[k]->name.data,
+                          name->len, sorted[k]->name.len);
+
+        if (rc > 0) {
+            i = k + 1;
+
+        } else if (rc < 0) {
+            j = k;
+
+        } else {
+            return sorted[k];
+        }
+    }
+
+    return NULL;
+}
+
+
+static int njt_libc_cdecl
+njt_chash_cmp_nodes(const void *one, const void *two)
+{
+    njt_chash_node_t *first = (njt_chash_node_t *) one;
+    njt_chash_node_t *second = (njt_chash_node_t *) two;
+
+    return njt_memn2cmp(first->name.data, second->name.data,
+                        first->name.len, second->name.len);
+}
+
+
+static int njt_libc_cdecl
+njt_chash_cmp_node_refs(const void *one, const void *two)
+{
+    njt_chash_node_t **first = (njt_chash_node_t **) one;
+    njt_chash_node_t **second = (njt_chash_node_t **) two;
+
+    return njt_chash_cmp_nodes(*first, *second);
+}
+
+
+static int njt_libc_cdecl
+njt_chash_cmp_points(const void *one, const void *two)
+{
+    njt_chash_point_t *first = (njt_chash_point_t *) one;
+    njt_chash_point_t *second = (njt_chash_point_t *) two;
+
+    if (first->hash < second->hash) {
+        return -1;
+
+    } else if (first->hash > second->hash) {
+        return 1;
+
+    } else {
+        return 0;
+    }
+}
@@ -0,0 +1,68 @@
+
+/*
+ * Copyright (C) 2021-2023  TMLake(Beijing) Technology Co., Ltd.
+ */
+
+
+#ifndef _NJT_CHASH_H_INCLUDED_
+#define _NJT_CHASH_H_INCLUDED_
+
+
+#include <njt_config.h>
+#include <njt_core.h>
+
+
+#define NJT_CHASH_KETAMA      1
+#define NJT_CHASH_MAGLEV      2
+#define NJT_CHASH_JUMP        3
+
+#define NJT_CHASH_NONE        0xffffffff
+
+
+typedef struct {
+    njt_str_t                 name;
+    njt_uint_t                weight;
+} njt_chash_node_t;
+
+
+typedef struct {
+    uint32_t                  hash;
+    njt_chash_node_t         *node;
+} njt_chash_point_t;
+
+
+/*
+ * Consistent hash table of upstream peers, built by each worker from
+ * the peer list.  The table is allocated from its own pool, which is
+ * a sub pool of the upstream, and is rebuilt from the previous table:
+ * keys of the peers not changed stay put.
+ *
+ * Ketama points keep the nodes sorted by name, several peers of one
+ * server share a node.  Maglev entries and jump hash buckets keep the
+ * nodes in the order of the peer list and map to node indexes.
+ */
+
+typedef struct {
+    njt_pool_t               *pool;
+    njt_uint_t                method;
+    njt_uint_t                number;      /* points, entries or buckets */
+    njt_uint_t                nnodes;
+    njt_chash_node_t         *node;
+    njt_chash_point_t        *point;
+    uint32_t                 *entry;
+    njt_uint_t                removed;     /* jump hash buckets removed */
+} njt_chash_table_t;
+
+
+njt_chash_table_t *njt_chash_table_create(njt_uint_t method, njt_uint_t n,
+    njt_pool_t *parent, njt_log_t *log);
+njt_int_t njt_chash_table_build(njt_chash_table_t *table,
+    njt_chash_table_t *prev);
+void njt_chash_table_free(njt_chash_table_t *table);
+
+njt_uint_t njt_chash_find_point(njt_chash_table_t *table, uint32_t hash);
+njt_uint_t njt_chash_lookup(njt_chash_table_t *table, uint32_t hash);
+njt_uint_t njt_jump_hash(uint64_t key, njt_uint_t buckets);
+
+
+#endif /* _NJT_CHASH_H_INCLUDED_ */
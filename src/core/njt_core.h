@@ -26,6 +26,7 @@ typedef struct njt_event_s           njt_event_t;
 typedef struct njt_event_aio_s       njt_event_aio_t;
 typedef struct njt_connection_s      njt_connection_t;
 typedef struct njt_thread_task_s     njt_thread_task_t;
+typedef struct njt_thread_pool_s     njt_thread_pool_t;
 typedef struct njt_ssl_s             njt_ssl_t;
 typedef struct njt_proxy_protocol_s  njt_proxy_protocol_t;
 typedef struct njt_quic_stream_s     njt_quic_stream_t;
@@ -73,6 +74,7 @@ typedef void (*njt_connection_handler_pt)(njt_connection_t *c);
 #include <njt_crc.h>
 #include <njt_crc32.h>
 #include <njt_murmurhash.h>
+#include <njt_chash.h>
 #if (NJT_PCRE)
 #include <njt_regex.h>
 #endif
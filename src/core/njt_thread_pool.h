@@ -24,9 +24,6 @@ struct njt_thread_task_s {
 };
 
 
-typedef struct njt_thread_pool_s  njt_thread_pool_t;
-
-
 njt_thread_pool_t *njt_thread_pool_add(njt_conf_t *cf, njt_str_t *name);
 njt_thread_pool_t *njt_thread_pool_get(njt_cycle_t *cycle, njt_str_t *name);
 
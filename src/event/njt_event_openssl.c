@@ -9,18 +9,94 @@
 #include <njt_config.h>
 #include <njt_core.h>
 #include <njt_event.h>
+#include <njt_md5.h>
+
+#if (NJT_THREADS)
+#include <njt_thread_pool.h>
+#endif
 
 #define NJT_SSL_PASSWORD_BUFFER_SIZE  4096
 
+#define NJT_SSL_CACHE_CERT            0
+#define NJT_SSL_CACHE_PKEY            1
+
+#define NJT_SSL_CACHE_KEY_LEN         (NJT_MAX_PATH + 2)
+
 typedef struct {
     njt_uint_t  engine;   /* unsigned  engine:1; */
 } njt_openssl_conf_t;
 
 
+typedef struct {
+    njt_str_node_t              sn;
+    njt_queue_t                 queue;
+
+    X509                       *x509;
+    STACK_OF(X509)             *chain;
+    EVP_PKEY                   *pkey;
+
+    njt_file_uniq_t             uniq;
+    time_t                      mtime;
+    time_t                      validated;
+    time_t                      accessed;
+} njt_ssl_cache_node_t;
+
+
+struct njt_ssl_cache_s {
+    njt_rbtree_t                rbtree;
+    njt_rbtree_node_t           sentinel;
+    njt_queue_t                 expire_queue;
+
+    njt_uint_t                  current;
+    njt_uint_t                  max;
+    time_t                      valid;
+    time_t                      inactive;
+};
+
+
+#if (NJT_SSL_ASYNC_KEYOPS)
+
+typedef int (*njt_ssl_pkey_sign_pt)(EVP_PKEY_CTX *ctx, unsigned char *sig,
+    size_t *siglen, const unsigned char *tbs, size_t tbslen);
+
+
+typedef struct {
+    njt_connection_t           *connection;
+
+    njt_ssl_pkey_sign_pt        sign;
+    EVP_PKEY_CTX               *pkey_ctx;
+    u_char                     *sig;
+    size_t                      siglen;
+    const u_char               *tbs;
+    size_t                      tbslen;
+
+    int                         rc;
+    unsigned long               error;
+
+    unsigned                    done:1;
+} njt_ssl_keyop_t;
+
+#endif
+
+
 static X509 *njt_ssl_load_certificate(njt_pool_t *pool, char **err,
     njt_str_t *cert, STACK_OF(X509) **chain);
 static EVP_PKEY *njt_ssl_load_certificate_key(njt_pool_t *pool, char **err,
     njt_str_t *key, njt_array_t *passwords);
+static X509 *njt_ssl_cache_certificate(njt_ssl_cache_t *cache,
+    njt_pool_t *pool, char **err, njt_str_t *cert, STACK_OF(X509) **chain);
+static EVP_PKEY *njt_ssl_cache_certificate_key(njt_ssl_cache_t *cache,
+    njt_pool_t *pool, char **err, njt_str_t *key, njt_array_t *passwords);
+static njt_ssl_cache_node_t *njt_ssl_cache_fetch(njt_ssl_cache_t *cache,
+    njt_pool_t *pool, njt_uint_t type, njt_str_t *value);
+static njt_int_t njt_ssl_cache_key(njt_pool_t *pool, njt_uint_t type,
+    njt_str_t *value, njt_str_t *key, njt_str_t *file);
+static njt_ssl_cache_node_t *njt_ssl_cache_lookup(njt_ssl_cache_t *cache,
+    njt_str_t *key);
+static void njt_ssl_cache_expire(njt_ssl_cache_t *cache, time_t now);
+static void njt_ssl_cache_node_free(njt_ssl_cache_t *cache,
+    njt_ssl_cache_node_t *node);
+static void njt_ssl_cache_cleanup(void *data);
 static int njt_ssl_password_callback(char *buf, int size, int rwflag,
     void *userdata);
 static int njt_ssl_verify_callback(int ok, X509_STORE_CTX *x509_store);
@@ -33,6 +109,13 @@ static int njt_ssl_new_client_session(njt_ssl_conn_t *ssl_conn,
 static njt_int_t njt_ssl_try_early_data(njt_connection_t *c);
 #endif
 static void njt_ssl_handshake_handler(njt_event_t *ev);
+#if (NJT_SSL_ASYNC_KEYOPS)
+static int njt_ssl_async_sign(EVP_PKEY_CTX *ctx, unsigned char *sig,
+    size_t *siglen, const unsigned char *tbs, size_t tbslen);
+static void njt_ssl_async_sign_thread(void *data, njt_log_t *log);
+static void njt_ssl_async_sign_done(njt_event_t *ev);
+static void njt_ssl_async_busy_handler(njt_event_t *ev);
+#endif
 #ifdef SSL_READ_EARLY_DATA_SUCCESS
 static ssize_t njt_ssl_recv_early(njt_connection_t *c, u_char *buf,
     size_t size);
@@ -137,6 +220,27 @@ int  njt_ssl_next_certificate_index;
 int  njt_ssl_certificate_name_index;
 int  njt_ssl_stapling_index;
 
+njt_ssl_session_export_pt  njt_ssl_session_export;
+
+#if (NJT_SSL_ASYNC_KEYOPS)
+int  njt_ssl_thread_pool_index;
+
+
+static int  njt_ssl_async_pkey_ids[] = {
+    EVP_PKEY_RSA,
+    EVP_PKEY_EC,
+#ifdef EVP_PKEY_SM2
+    EVP_PKEY_SM2,
+#endif
+};
+
+static njt_ssl_pkey_sign_pt  njt_ssl_async_pkey_sign[
+                                 sizeof(njt_ssl_async_pkey_ids) / sizeof(int)];
+
+static njt_uint_t         njt_ssl_async_installed;
+static njt_connection_t  *njt_ssl_async_connection;
+#endif
+
 
 njt_int_t
 njt_ssl_init(njt_log_t *log)
@@ -270,6 +374,18 @@ njt_ssl_init(njt_log_t *log)
         return NJT_ERROR;
     }
 
+#if (NJT_SSL_ASYNC_KEYOPS)
+
+    njt_ssl_thread_pool_index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL,
+                                                         NULL);
+    if (njt_ssl_thread_pool_index == -1) {
+        njt_ssl_error(NJT_LOG_ALERT, log, 0,
+                      "SSL_CTX_get_ex_new_index() failed");
+        return NJT_ERROR;
+    }
+
+#endif
+
     return NJT_OK;
 }
 
@@ -747,7 +863,8 @@ njt_ssl_ntls_prefix_strip(njt_str_t *s)
 
 njt_int_t
 njt_ssl_connection_certificate(njt_connection_t *c, njt_pool_t *pool,
-    njt_str_t *cert, njt_str_t *key, njt_array_t *passwords)
+    njt_str_t *cert, njt_str_t *key, njt_ssl_cache_t *cache,
+    njt_array_t *passwords)
 {
     char            *err;
     X509            *x509;
@@ -757,7 +874,7 @@ njt_ssl_connection_certificate(njt_connection_t *c, njt_pool_t *pool,
     njt_uint_t       type;
 #endif
 
-    x509 = njt_ssl_load_certificate(pool, &err, cert, &chain);
+    x509 = njt_ssl_cache_certificate(cache, pool, &err, cert, &chain);
     if (x509 == NULL) {
         if (err != NULL) {
             njt_ssl_error(NJT_LOG_ERR, c->log, 0,
@@ -824,7 +941,7 @@ njt_ssl_connection_certificate(njt_connection_t *c, njt_pool_t *pool,
 
 #endif
 
-    pkey = njt_ssl_load_certificate_key(pool, &err, key, passwords);
+    pkey = njt_ssl_cache_certificate_key(cache, pool, &err, key, passwords);
     if (pkey == NULL) {
         if (err != NULL) {
             njt_ssl_error(NJT_LOG_ERR, c->log, 0,
@@ -1096,6 +1213,381 @@ njt_ssl_load_certificate_key(njt_pool_t *pool, char **err,
 }
 
 
+njt_ssl_cache_t *
+njt_ssl_cache_init(njt_pool_t *pool, njt_uint_t max, time_t valid,
+    time_t inactive)
+{
+    njt_ssl_cache_t     *cache;
+    njt_pool_cleanup_t  *cln;
+
+    cache = njt_pcalloc(pool, sizeof(njt_ssl_cache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    njt_rbtree_init(&cache->rbtree, &cache->sentinel,
+                    njt_str_rbtree_insert_value);
+
+    njt_queue_init(&cache->expire_queue);
+
+    cache->max = max;
+    cache->valid = valid;
+    cache->inactive = inactive;
+
+    cln = njt_pool_cleanup_add(pool, 0);
+    if (cln == NULL) {
+        return NULL;
+    }
+
+    cln->handler = njt_ssl_cache_cleanup;
+    cln->data = cache;
+
+    return cache;
+}
+
+
+void
+njt_ssl_cache_invalidate(njt_ssl_cache_t *cache, njt_pool_t *pool,
+    njt_str_t *value)
+{
+    u_char                 key_buf[NJT_SSL_CACHE_KEY_LEN];
+    njt_str_t              key, file;
+    njt_uint_t             type;
+    njt_ssl_cache_node_t  *node;
+
+    if (cache == NULL || value->len == 0) {
+        return;
+    }
+
+    for (type = NJT_SSL_CACHE_CERT; type <= NJT_SSL_CACHE_PKEY; type++) {
+
+        key.data = key_buf;
+
+        if (njt_ssl_cache_key(pool, type, value, &key, &file) != NJT_OK) {
+            continue;
+        }
+
+        node = njt_ssl_cache_lookup(cache, &key);
+
+        if (node) {
+            njt_ssl_cache_node_free(cache, node);
+        }
+    }
+}
+
+
+static X509 *
+njt_ssl_cache_certificate(njt_ssl_cache_t *cache, njt_pool_t *pool,
+    char **err, njt_str_t *cert, STACK_OF(X509) **chain)
+{
+    X509                  *x509;
+    njt_ssl_cache_node_t  *node;
+
+    node = njt_ssl_cache_fetch(cache, pool, NJT_SSL_CACHE_CERT, cert);
+
+    if (node == NULL) {
+        return njt_ssl_load_certificate(pool, err, cert, chain);
+    }
+
+    if (node->x509 == NULL) {
+        node->x509 = njt_ssl_load_certificate(pool, err, cert, &node->chain);
+
+        if (node->x509 == NULL) {
+            njt_ssl_cache_node_free(cache, node);
+            return NULL;
+        }
+    }
+
+    *chain = X509_chain_up_ref(node->chain);
+    if (*chain == NULL) {
+        *err = "X509_chain_up_ref() failed";
+        return NULL;
+    }
+
+    x509 = node->x509;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100001L
+    X509_up_ref(x509);
+#else
+    CRYPTO_add(&x509->references, 1, CRYPTO_LOCK_X509);
+#endif
+
+    return x509;
+}
+
+
+static EVP_PKEY *
+njt_ssl_cache_certificate_key(njt_ssl_cache_t *cache, njt_pool_t *pool,
+    char **err, njt_str_t *key, njt_array_t *passwords)
+{
+    EVP_PKEY              *pkey;
+    njt_ssl_cache_node_t  *node;
+
+    node = njt_ssl_cache_fetch(cache, pool, NJT_SSL_CACHE_PKEY, key);
+
+    if (node == NULL) {
+        return njt_ssl_load_certificate_key(pool, err, key, passwords);
+    }
+
+    if (node->pkey == NULL) {
+        node->pkey = njt_ssl_load_certificate_key(pool, err, key, passwords);
+
+        if (node->pkey == NULL) {
+            njt_ssl_cache_node_free(cache, node);
+            return NULL;
+        }
+    }
+
+    pkey = node->pkey;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100001L
+    EVP_PKEY_up_ref(pkey);
+#else
+    CRYPTO_add(&pkey->references, 1, CRYPTO_LOCK_EVP_PKEY);
+#endif
+
+    return pkey;
+}
+
+
+static njt_ssl_cache_node_t *
+njt_ssl_cache_fetch(njt_ssl_cache_t *cache, njt_pool_t *pool,
+    njt_uint_t type, njt_str_t *value)
+{
+    time_t                 now;
+    u_char                 key_buf[NJT_SSL_CACHE_KEY_LEN];
+    njt_str_t              key, name;
+    njt_file_info_t        fi;
+    njt_ssl_cache_node_t  *node;
+
+    /*
+     * returns a cached node, or a new empty node to be filled in
+     * by the caller; NULL means the value is loaded without the cache
+     */
+
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    key.data = key_buf;
+
+    if (njt_ssl_cache_key(pool, type, value, &key, &name) != NJT_OK) {
+        return NULL;
+    }
+
+    now = njt_time();
+
+    node = njt_ssl_cache_lookup(cache, &key);
+
+    if (node) {
+
+        if (name.len == 0 || now - node->validated < cache->valid) {
+            node->accessed = now;
+
+            njt_queue_remove(&node->queue);
+            njt_queue_insert_head(&cache->expire_queue, &node->queue);
+
+            return node;
+        }
+
+        /* revalidate the file */
+
+        if (njt_file_info(name.data, &fi) != NJT_FILE_ERROR
+            && njt_file_uniq(&fi) == node->uniq
+            && njt_file_mtime(&fi) == node->mtime)
+        {
+            node->validated = now;
+            node->accessed = now;
+
+            njt_queue_remove(&node->queue);
+            njt_queue_insert_head(&cache->expire_queue, &node->queue);
+
+            return node;
+        }
+
+        njt_log_debug1(NJT_LOG_DEBUG_EVENT, njt_cycle->log, 0,
+                       "ssl cache stale \"%s\"", name.data);
+
+        njt_ssl_cache_node_free(cache, node);
+    }
+
+    if (name.len) {
+        if (njt_file_info(name.data, &fi) == NJT_FILE_ERROR) {
+            /* reported by the loader */
+            return NULL;
+        }
+    }
+
+    njt_ssl_cache_expire(cache, now);
+
+    if (cache->current >= cache->max) {
+        njt_ssl_cache_node_free(cache,
+                                njt_queue_data(njt_queue_last(
+                                                   &cache->expire_queue),
+                                               njt_ssl_cache_node_t, queue));
+    }
+
+    node = njt_alloc(sizeof(njt_ssl_cache_node_t) + key.len, njt_cycle->log);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    njt_memzero(node, sizeof(njt_ssl_cache_node_t));
+
+    node->sn.str.len = key.len;
+    node->sn.str.data = (u_char *) node + sizeof(njt_ssl_cache_node_t);
+    njt_memcpy(node->sn.str.data, key.data, key.len);
+    node->sn.node.key = njt_crc32_short(key.data, key.len);
+
+    if (name.len) {
+        node->uniq = njt_file_uniq(&fi);
+        node->mtime = njt_file_mtime(&fi);
+    }
+
+    node->validated = now;
+    node->accessed = now;
+
+    njt_rbtree_insert(&cache->rbtree, &node->sn.node);
+    njt_queue_insert_head(&cache->expire_queue, &node->queue);
+
+    cache->current++;
+
+    return node;
+}
+
+
+static njt_int_t
+njt_ssl_cache_key(njt_pool_t *pool, njt_uint_t type, njt_str_t *value,
+    njt_str_t *key, njt_str_t *file)
+{
+    u_char     *p;
+    njt_md5_t   md5;
+
+    /* file is set to the full name, or is empty for inline PEM */
+
+    *file = *value;
+
+#if (NJT_HAVE_NTLS)
+    njt_ssl_ntls_prefix_strip(file);
+#endif
+
+    p = key->data;
+    *p++ = (u_char) type;
+
+    if (njt_strncmp(file->data, "data:", sizeof("data:") - 1) == 0) {
+
+        /* from variables or the dynamic ssl api, keyed by the contents */
+
+        *p++ = 'd';
+
+        njt_md5_init(&md5);
+        njt_md5_update(&md5, file->data, file->len);
+        njt_md5_final(p, &md5);
+
+        key->len = 2 + 16;
+        file->len = 0;
+
+        return NJT_OK;
+    }
+
+    if (njt_strncmp(file->data, "engine:", sizeof("engine:") - 1) == 0) {
+        return NJT_DECLINED;
+    }
+
+    if (njt_get_full_name(pool, (njt_str_t *) &njt_cycle->conf_prefix, file)
+        != NJT_OK)
+    {
+        return NJT_ERROR;
+    }
+
+    if (file->len > NJT_SSL_CACHE_KEY_LEN - 2) {
+        return NJT_DECLINED;
+    }
+
+    *p++ = 'f';
+    njt_memcpy(p, file->data, file->len);
+
+    key->len = 2 + file->len;
+
+    return NJT_OK;
+}
+
+
+static njt_ssl_cache_node_t *
+njt_ssl_cache_lookup(njt_ssl_cache_t *cache, njt_str_t *key)
+{
+    return (njt_ssl_cache_node_t *)
+               njt_str_rbtree_lookup(&cache->rbtree, key,
+                                     njt_crc32_short(key->data, key->len));
+}
+
+
+static void
+njt_ssl_cache_expire(njt_ssl_cache_t *cache, time_t now)
+{
+    njt_uint_t             n;
+    njt_queue_t           *q;
+    njt_ssl_cache_node_t  *node;
+
+    /* two inactive entries at most, as with the open file cache */
+
+    for (n = 0; n < 2; n++) {
+
+        if (njt_queue_empty(&cache->expire_queue)) {
+            return;
+        }
+
+        q = njt_queue_last(&cache->expire_queue);
+        node = njt_queue_data(q, njt_ssl_cache_node_t, queue);
+
+        if (now - node->accessed <= cache->inactive) {
+            return;
+        }
+
+        njt_ssl_cache_node_free(cache, node);
+    }
+}
+
+
+static void
+njt_ssl_cache_node_free(njt_ssl_cache_t *cache, njt_ssl_cache_node_t *node)
+{
+    njt_rbtree_delete(&cache->rbtree, &node->sn.node);
+    njt_queue_remove(&node->queue);
+
+    if (node->x509) {
+        X509_free(node->x509);
+    }
+
+    if (node->chain) {
+        sk_X509_pop_free(node->chain, X509_free);
+    }
+
+    if (node->pkey) {
+        EVP_PKEY_free(node->pkey);
+    }
+
+    njt_free(node);
+
+    cache->current--;
+}
+
+
+static void
+njt_ssl_cache_cleanup(void *data)
+{
+    njt_ssl_cache_t  *cache = data;
+
+    njt_queue_t  *q;
+
+    while (!njt_queue_empty(&cache->expire_queue)) {
+        q = njt_queue_head(&cache->expire_queue);
+        njt_ssl_cache_node_free(cache,
+                                njt_queue_data(q, njt_ssl_cache_node_t, queue));
+    }
+}
+
+
 static int
 njt_ssl_password_callback(char *buf, int size, int rwflag, void *userdata)
 {
@@ -1907,6 +2399,104 @@ njt_ssl_conf_commands(njt_conf_t *cf, njt_ssl_t *ssl, njt_array_t *commands)
 }
 
 
+#if (NJT_SSL_ASYNC_KEYOPS)
+
+njt_int_t
+njt_ssl_async_keyops(njt_conf_t *cf, njt_ssl_t *ssl, njt_thread_pool_t *tp)
+{
+    int                    flags;
+    njt_uint_t             i;
+    EVP_PKEY_METHOD       *meth;
+    const EVP_PKEY_METHOD *orig;
+    int                  (*init)(EVP_PKEY_CTX *ctx);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    int                  (*check)(EVP_PKEY *pkey);
+    int                  (*digest_custom)(EVP_PKEY_CTX *ctx,
+                                          EVP_MD_CTX *mctx);
+#endif
+
+    if (!ASYNC_is_capable()) {
+        njt_log_error(NJT_LOG_WARN, ssl->log, 0,
+                      "\"ssl_async_keyops\" is ignored, async jobs "
+                      "are not supported by OpenSSL on this platform");
+        return NJT_OK;
+    }
+
+    if (!njt_ssl_async_installed) {
+
+        /*
+         * signing methods are replaced process-wide; signatures
+         * outside of an async handshake job are made in place
+         */
+
+        for (i = 0; i < sizeof(njt_ssl_async_pkey_ids) / sizeof(int); i++) {
+
+            orig = EVP_PKEY_meth_find(njt_ssl_async_pkey_ids[i]);
+            if (orig == NULL) {
+                continue;
+            }
+
+            EVP_PKEY_meth_get0_info(NULL, &flags, orig);
+
+            meth = EVP_PKEY_meth_new(njt_ssl_async_pkey_ids[i], flags);
+            if (meth == NULL) {
+                njt_ssl_error(NJT_LOG_EMERG, ssl->log, 0,
+                              "EVP_PKEY_meth_new() failed");
+                return NJT_ERROR;
+            }
+
+            EVP_PKEY_meth_copy(meth, orig);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+
+            /* not copied by EVP_PKEY_meth_copy(), needed for SM2 */
+
+            EVP_PKEY_meth_get_digest_custom((EVP_PKEY_METHOD *) orig,
+                                            &digest_custom);
+            EVP_PKEY_meth_set_digest_custom(meth, digest_custom);
+
+            EVP_PKEY_meth_get_public_check(orig, &check);
+            EVP_PKEY_meth_set_public_check(meth, check);
+
+            EVP_PKEY_meth_get_param_check(orig, &check);
+            EVP_PKEY_meth_set_param_check(meth, check);
+#endif
+
+            EVP_PKEY_meth_get_sign((EVP_PKEY_METHOD *) orig, &init,
+                                   &njt_ssl_async_pkey_sign[i]);
+
+            if (njt_ssl_async_pkey_sign[i] == NULL) {
+                EVP_PKEY_meth_free(meth);
+                continue;
+            }
+
+            EVP_PKEY_meth_set_sign(meth, init, njt_ssl_async_sign);
+
+            if (EVP_PKEY_meth_add0(meth) == 0) {
+                njt_ssl_error(NJT_LOG_EMERG, ssl->log, 0,
+                              "EVP_PKEY_meth_add0() failed");
+                EVP_PKEY_meth_free(meth);
+                return NJT_ERROR;
+            }
+        }
+
+        njt_ssl_async_installed = 1;
+    }
+
+    if (SSL_CTX_set_ex_data(ssl->ctx, njt_ssl_thread_pool_index, tp) == 0) {
+        njt_ssl_error(NJT_LOG_EMERG, ssl->log, 0,
+                      "SSL_CTX_set_ex_data() failed");
+        return NJT_ERROR;
+    }
+
+    SSL_CTX_set_mode(ssl->ctx, SSL_MODE_ASYNC);
+
+    return NJT_OK;
+}
+
+#endif
+
+
 njt_int_t
 njt_ssl_client_session_cache(njt_conf_t *cf, njt_ssl_t *ssl, njt_uint_t enable)
 {
@@ -2056,12 +2646,25 @@ njt_ssl_handshake(njt_connection_t *c)
 
     njt_ssl_clear_error(c->log);
 
+#if (NJT_SSL_ASYNC_KEYOPS)
+    njt_ssl_async_connection = c;
+#endif
+
     n = SSL_do_handshake(c->ssl->connection);
 
+#if (NJT_SSL_ASYNC_KEYOPS)
+    njt_ssl_async_connection = NULL;
+#endif
+
     njt_log_debug1(NJT_LOG_DEBUG_EVENT, c->log, 0, "SSL_do_handshake: %d", n);
 
     if (n == 1) {
 
+#if (NJT_SSL_ASYNC_KEYOPS)
+        /* no private key operations after the handshake */
+        SSL_clear_mode(c->ssl->connection, SSL_MODE_ASYNC);
+#endif
+
         if (njt_handle_read_event(c->read, 0) != NJT_OK) {
             return NJT_ERROR;
         }
@@ -2158,6 +2761,23 @@ njt_ssl_handshake(njt_connection_t *c)
         return NJT_AGAIN;
     }
 
+#if (NJT_SSL_ASYNC_KEYOPS)
+
+    if (sslerr == SSL_ERROR_WANT_ASYNC) {
+
+        /*
+         * a private key operation runs in a thread, the connection
+         * must not be touched until njt_ssl_async_sign_done()
+         */
+
+        c->read->handler = njt_ssl_async_busy_handler;
+        c->write->handler = njt_ssl_async_busy_handler;
+
+        return NJT_AGAIN;
+    }
+
+#endif
+
 // openresty patch
 #if OPENSSL_VERSION_NUMBER >= 0x10002000L
     if (sslerr == SSL_ERROR_WANT_X509_LOOKUP
@@ -2485,6 +3105,175 @@ njt_ssl_handshake_handler(njt_event_t *ev)
 }
 
 
+#if (NJT_SSL_ASYNC_KEYOPS)
+
+static int
+njt_ssl_async_sign(EVP_PKEY_CTX *ctx, unsigned char *sig, size_t *siglen,
+    const unsigned char *tbs, size_t tbslen)
+{
+    int                    id;
+    njt_uint_t             i;
+    njt_connection_t      *c;
+    njt_ssl_keyop_t       *op;
+    njt_thread_pool_t     *tp;
+    njt_thread_task_t     *task;
+    njt_ssl_pkey_sign_pt   sign;
+
+    id = EVP_PKEY_id(EVP_PKEY_CTX_get0_pkey(ctx));
+
+    sign = NULL;
+
+    for (i = 0; i < sizeof(njt_ssl_async_pkey_ids) / sizeof(int); i++) {
+        if (njt_ssl_async_pkey_ids[i] == id) {
+            sign = njt_ssl_async_pkey_sign[i];
+            break;
+        }
+    }
+
+    if (sign == NULL) {
+        return -2;
+    }
+
+    /*
+     * only signatures made by njt_ssl_handshake() inside an async job
+     * are offloaded, everything else is signed in place
+     */
+
+    c = njt_ssl_async_connection;
+
+    if (sig == NULL || c == NULL || ASYNC_get_current_job() == NULL) {
+        return sign(ctx, sig, siglen, tbs, tbslen);
+    }
+
+    tp = SSL_CTX_get_ex_data(SSL_get_SSL_CTX(c->ssl->connection),
+                             njt_ssl_thread_pool_index);
+    if (tp == NULL) {
+        return sign(ctx, sig, siglen, tbs, tbslen);
+    }
+
+    task = c->ssl->keyop;
+
+    if (task == NULL) {
+        task = njt_thread_task_alloc(c->pool, sizeof(njt_ssl_keyop_t));
+        if (task == NULL) {
+            return sign(ctx, sig, siglen, tbs, tbslen);
+        }
+
+        task->handler = njt_ssl_async_sign_thread;
+        task->event.handler = njt_ssl_async_sign_done;
+        task->event.data = task->ctx;
+        task->event.log = c->log;
+
+        c->ssl->keyop = task;
+    }
+
+    op = task->ctx;
+
+    op->connection = c;
+    op->sign = sign;
+    op->pkey_ctx = ctx;
+    op->sig = sig;
+    op->siglen = *siglen;
+    op->tbs = tbs;
+    op->tbslen = tbslen;
+    op->rc = 0;
+    op->error = 0;
+    op->done = 0;
+
+    if (njt_thread_task_post(tp, task) != NJT_OK) {
+        return sign(ctx, sig, siglen, tbs, tbslen);
+    }
+
+    njt_log_debug1(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                   "SSL async sign posted: %uz", tbslen);
+
+    /* the job is resumed by njt_ssl_handshake() once the task is done */
+
+    while (!op->done) {
+        if (ASYNC_pause_job() == 0) {
+            njt_log_error(NJT_LOG_ALERT, c->log, 0,
+                          "ASYNC_pause_job() failed");
+        }
+    }
+
+    if (op->rc <= 0 && op->error) {
+        ERR_put_error(ERR_GET_LIB(op->error), ERR_GET_FUNC(op->error),
+                      ERR_GET_REASON(op->error), OPENSSL_FILE, OPENSSL_LINE);
+    }
+
+    *siglen = op->siglen;
+
+    return op->rc;
+}
+
+
+static void
+njt_ssl_async_sign_thread(void *data, njt_log_t *log)
+{
+    njt_ssl_keyop_t  *op = data;
+
+    op->rc = op->sign(op->pkey_ctx, op->sig, &op->siglen, op->tbs,
+                      op->tbslen);
+
+    if (op->rc <= 0) {
+        op->error = ERR_peek_last_error();
+    }
+
+    /* the error queue is per thread */
+
+    ERR_clear_error();
+}
+
+
+static void
+njt_ssl_async_sign_done(njt_event_t *ev)
+{
+    njt_ssl_keyop_t   *op;
+    njt_connection_t  *c;
+
+    op = ev->data;
+    c = op->connection;
+
+    njt_log_debug1(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                   "SSL async sign done: %d", op->rc);
+
+    op->done = 1;
+
+    c->read->handler = njt_ssl_handshake_handler;
+    c->write->handler = njt_ssl_handshake_handler;
+
+    /*
+     * the paused job is resumed even if the handshake has timed out
+     * meanwhile, so that SSL_shutdown() does not pick it up later
+     */
+
+    if (njt_ssl_handshake(c) == NJT_AGAIN
+        && !c->read->timedout && !c->write->timedout)
+    {
+        return;
+    }
+
+    c->ssl->handler(c);
+}
+
+
+static void
+njt_ssl_async_busy_handler(njt_event_t *ev)
+{
+    njt_log_debug1(NJT_LOG_DEBUG_EVENT, ev->log, 0,
+                   "SSL async busy handler: %d", ev->write);
+
+    /* timeouts are handled by njt_ssl_async_sign_done() */
+
+    if ((njt_event_flags & NJT_USE_LEVEL_EVENT) && ev->active) {
+        (void) njt_del_event(ev, ev->write ? NJT_WRITE_EVENT : NJT_READ_EVENT,
+                             0);
+    }
+}
+
+#endif
+
+
 ssize_t
 njt_ssl_recv_chain(njt_connection_t *c, njt_chain_t *cl, off_t limit)
 {
@@ -4296,15 +5085,11 @@ njt_ssl_new_session(njt_ssl_conn_t *ssl_conn, njt_ssl_session_t *sess)
 {
     int                       len;
     u_char                   *p, *session_id;
-    size_t                    n;
-    uint32_t                  hash;
+    time_t                    timeout;
     SSL_CTX                  *ssl_ctx;
     unsigned int              session_id_length;
     njt_shm_zone_t           *shm_zone;
     njt_connection_t         *c;
-    njt_slab_pool_t          *shpool;
-    njt_ssl_sess_id_t        *sess_id;
-    njt_ssl_session_cache_t  *cache;
     u_char                    buf[NJT_SSL_MAX_SESSION_SIZE];
 
 #ifdef TLS1_3_VERSION
@@ -4348,6 +5133,35 @@ njt_ssl_new_session(njt_ssl_conn_t *ssl_conn, njt_ssl_session_t *sess)
     ssl_ctx = c->ssl->session_ctx;
     shm_zone = SSL_CTX_get_ex_data(ssl_ctx, njt_ssl_session_cache_index);
 
+    timeout = SSL_CTX_get_timeout(ssl_ctx);
+
+    if (njt_ssl_session_cache_add(shm_zone, session_id, session_id_length,
+                                  buf, len, njt_time() + timeout, c->log)
+        == NJT_OK
+        && njt_ssl_session_export)
+    {
+        njt_ssl_session_export(shm_zone, session_id, session_id_length,
+                               buf, len, timeout);
+    }
+
+    return 0;
+}
+
+
+njt_int_t
+njt_ssl_session_cache_add(njt_shm_zone_t *shm_zone, u_char *id,
+    size_t id_len, u_char *buf, size_t len, time_t expire, njt_log_t *log)
+{
+    size_t                    n;
+    uint32_t                  hash;
+    njt_slab_pool_t          *shpool;
+    njt_ssl_sess_id_t        *sess_id;
+    njt_ssl_session_cache_t  *cache;
+
+    if (len > NJT_SSL_MAX_SESSION_SIZE || id_len > 32) {
+        return NJT_DECLINED;
+    }
+
     cache = shm_zone->data;
     shpool = (njt_slab_pool_t *) shm_zone->shm.addr;
 
@@ -4397,19 +5211,19 @@ njt_ssl_new_session(njt_ssl_conn_t *ssl_conn, njt_ssl_session_t *sess)
 #endif
 
     njt_memcpy(sess_id->session, buf, len);
-    njt_memcpy(sess_id->id, session_id, session_id_length);
+    njt_memcpy(sess_id->id, id, id_len);
 
-    hash = njt_crc32_short(session_id, session_id_length);
+    hash = njt_crc32_short(id, id_len);
 
-    njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
-                   "ssl new session: %08XD:%ud:%d",
-                   hash, session_id_length, len);
+    njt_log_debug3(NJT_LOG_DEBUG_EVENT, log, 0,
+                   "ssl new session: %08XD:%uz:%uz",
+                   hash, id_len, len);
 
     sess_id->node.key = hash;
-    sess_id->node.data = (u_char) session_id_length;
+    sess_id->node.data = (u_char) id_len;
     sess_id->len = len;
 
-    sess_id->expire = njt_time() + SSL_CTX_get_timeout(ssl_ctx);
+    sess_id->expire = expire;
 
     njt_queue_insert_head(&cache->expire_queue, &sess_id->queue);
 
@@ -4417,7 +5231,7 @@ njt_ssl_new_session(njt_ssl_conn_t *ssl_conn, njt_ssl_session_t *sess)
 
     njt_shmtx_unlock(&shpool->mutex);
 
-    return 0;
+    return NJT_OK;
 
 failed:
 
@@ -4429,11 +5243,11 @@ failed:
 
     if (cache->fail_time != njt_time()) {
         cache->fail_time = njt_time();
-        njt_log_error(NJT_LOG_WARN, c->log, 0,
+        njt_log_error(NJT_LOG_WARN, log, 0,
                       "could not allocate new session%s", shpool->log_ctx);
     }
 
-    return 0;
+    return NJT_ERROR;
 }
 
 
@@ -4871,6 +5685,38 @@ failed:
 }
 
 
+/*
+ * keys are owned and updated in place by the caller: key[0] encrypts,
+ * all of them decrypt; they are never rotated through shared memory
+ */
+
+njt_int_t
+njt_ssl_session_ticket_keys_set(njt_ssl_t *ssl, njt_array_t *keys)
+{
+    njt_ssl_ticket_key_t  *key;
+
+    key = keys->elts;
+
+    if (keys->nelts == 0 || key[0].shared) {
+        return NJT_ERROR;
+    }
+
+    if (SSL_CTX_set_ex_data(ssl->ctx, njt_ssl_ticket_keys_index, keys) == 0) {
+        njt_ssl_error(NJT_LOG_EMERG, ssl->log, 0,
+                      "SSL_CTX_set_ex_data() failed");
+        return NJT_ERROR;
+    }
+
+    if (SSL_CTX_set_tlsext_ticket_key_cb(ssl->ctx, njt_ssl_ticket_key_callback)
+        == 0)
+    {
+        return NJT_DECLINED;
+    }
+
+    return NJT_OK;
+}
+
+
 static int
 njt_ssl_ticket_key_callback(njt_ssl_conn_t *ssl_conn,
     unsigned char *name, unsigned char *iv, EVP_CIPHER_CTX *ectx,
@@ -5162,6 +6008,13 @@ njt_ssl_session_ticket_keys(njt_conf_t *cf, njt_ssl_t *ssl, njt_array_t *paths)
     return NJT_OK;
 }
 
+
+njt_int_t
+njt_ssl_session_ticket_keys_set(njt_ssl_t *ssl, njt_array_t *keys)
+{
+    return NJT_DECLINED;
+}
+
 #endif
 
 
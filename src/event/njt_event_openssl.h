@@ -42,6 +42,12 @@
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
 
+#if (NJT_THREADS && defined OPENSSL_THREADS && defined SSL_MODE_ASYNC         \
+     && !defined OPENSSL_NO_ASYNC && OPENSSL_VERSION_NUMBER < 0x30000000L)
+#include <openssl/async.h>
+#define NJT_SSL_ASYNC_KEYOPS  1
+#endif
+
 #define NJT_SSL_NAME     "OpenSSL"
 
 
@@ -86,6 +92,7 @@
 
 
 typedef struct njt_ssl_ocsp_s  njt_ssl_ocsp_t;
+typedef struct njt_ssl_cache_s  njt_ssl_cache_t;
 
 
 struct njt_ssl_s {
@@ -113,6 +120,10 @@ struct njt_ssl_connection_s {
 
     njt_ssl_ocsp_t             *ocsp;
 
+#if (NJT_SSL_ASYNC_KEYOPS)
+    njt_thread_task_t          *keyop;
+#endif
+
     u_char                      early_buf;
 
     unsigned                    handshaked:1;
@@ -176,6 +187,11 @@ typedef struct {
 } njt_ssl_session_cache_t;
 
 
+/* called for every session stored in a shared session cache */
+typedef void (*njt_ssl_session_export_pt)(njt_shm_zone_t *shm_zone,
+    u_char *id, size_t id_len, u_char *buf, size_t len, time_t timeout);
+
+
 #define NJT_SSL_SSLv2    0x0002
 #define NJT_SSL_SSLv3    0x0004
 #define NJT_SSL_TLSv1    0x0008
@@ -213,7 +229,12 @@ njt_int_t njt_ssl_certificates(njt_conf_t *cf, njt_ssl_t *ssl,
 njt_int_t njt_ssl_certificate(njt_conf_t *cf, njt_ssl_t *ssl,
     njt_str_t *cert, njt_str_t *key, njt_array_t *passwords);
 njt_int_t njt_ssl_connection_certificate(njt_connection_t *c, njt_pool_t *pool,
-    njt_str_t *cert, njt_str_t *key, njt_array_t *passwords);
+    njt_str_t *cert, njt_str_t *key, njt_ssl_cache_t *cache,
+    njt_array_t *passwords);
+njt_ssl_cache_t *njt_ssl_cache_init(njt_pool_t *pool, njt_uint_t max,
+    time_t valid, time_t inactive);
+void njt_ssl_cache_invalidate(njt_ssl_cache_t *cache, njt_pool_t *pool,
+    njt_str_t *value);
 #if (NJT_HAVE_NTLS)
 void njt_ssl_ntls_prefix_strip(njt_str_t *s);
 njt_uint_t njt_ssl_ntls_type(njt_str_t *s);
@@ -230,6 +251,10 @@ njt_int_t njt_ssl_stapling(njt_conf_t *cf, njt_ssl_t *ssl,
     njt_str_t *file, njt_str_t *responder, njt_uint_t verify);
 njt_int_t njt_ssl_stapling_resolver(njt_conf_t *cf, njt_ssl_t *ssl,
     njt_resolver_t *resolver, njt_msec_t resolver_timeout);
+njt_int_t njt_ssl_stapling_cache(njt_conf_t *cf, njt_ssl_t *ssl,
+    njt_shm_zone_t *shm_zone, njt_str_t *path);
+njt_int_t njt_ssl_stapling_cache_init(njt_shm_zone_t *shm_zone, void *data);
+njt_int_t njt_ssl_stapling_init_process(njt_cycle_t *cycle);
 njt_int_t njt_ssl_ocsp(njt_conf_t *cf, njt_ssl_t *ssl, njt_str_t *responder,
     njt_uint_t depth, njt_shm_zone_t *shm_zone);
 njt_int_t njt_ssl_ocsp_resolver(njt_conf_t *cf, njt_ssl_t *ssl,
@@ -249,6 +274,10 @@ njt_int_t njt_ssl_early_data(njt_conf_t *cf, njt_ssl_t *ssl,
     njt_uint_t enable);
 njt_int_t njt_ssl_conf_commands(njt_conf_t *cf, njt_ssl_t *ssl,
     njt_array_t *commands);
+#if (NJT_SSL_ASYNC_KEYOPS)
+njt_int_t njt_ssl_async_keyops(njt_conf_t *cf, njt_ssl_t *ssl,
+    njt_thread_pool_t *tp);
+#endif
 
 njt_int_t njt_ssl_client_session_cache(njt_conf_t *cf, njt_ssl_t *ssl,
     njt_uint_t enable);
@@ -257,7 +286,10 @@ njt_int_t njt_ssl_session_cache(njt_ssl_t *ssl, njt_str_t *sess_ctx,
     njt_shm_zone_t *shm_zone, time_t timeout);
 njt_int_t njt_ssl_session_ticket_keys(njt_conf_t *cf, njt_ssl_t *ssl,
     njt_array_t *paths);
+njt_int_t njt_ssl_session_ticket_keys_set(njt_ssl_t *ssl, njt_array_t *keys);
 njt_int_t njt_ssl_session_cache_init(njt_shm_zone_t *shm_zone, void *data);
+njt_int_t njt_ssl_session_cache_add(njt_shm_zone_t *shm_zone, u_char *id,
+    size_t id_len, u_char *buf, size_t len, time_t expire, njt_log_t *log);
 
 njt_int_t njt_ssl_create_connection(njt_ssl_t *ssl, njt_connection_t *c,
     njt_uint_t flags);
@@ -359,6 +391,11 @@ extern int  njt_ssl_certificate_index;
 extern int  njt_ssl_next_certificate_index;
 extern int  njt_ssl_certificate_name_index;
 extern int  njt_ssl_stapling_index;
+#if (NJT_SSL_ASYNC_KEYOPS)
+extern int  njt_ssl_thread_pool_index;
+#endif
+
+extern njt_ssl_session_export_pt  njt_ssl_session_export;
 
 
 #endif /* _NJT_EVENT_OPENSSL_H_INCLUDED_ */
@@ -15,6 +15,10 @@
 #if (!defined OPENSSL_NO_OCSP && defined SSL_CTRL_SET_TLSEXT_STATUS_REQ_CB)
 
 
+#define NJT_SSL_OCSP_KEY_LEN         60
+#define NJT_SSL_STAPLING_REFRESH     10000
+
+
 typedef struct {
     njt_str_t                    staple;
     njt_msec_t                   timeout;
@@ -39,11 +43,39 @@ typedef struct {
     time_t                       valid;
     time_t                       refresh;
 
+    njt_shm_zone_t              *shm_zone;
+    njt_cycle_t                 *cycle;
+    njt_queue_t                  queue;
+    njt_str_t                    key;
+    njt_str_t                    path;
+    njt_uint_t                   version;
+    time_t                       checked;
+
     unsigned                     verify:1;
     unsigned                     loading:1;
 } njt_ssl_stapling_t;
 
 
+typedef struct {
+    njt_rbtree_t                 rbtree;
+    njt_rbtree_node_t            sentinel;
+    njt_queue_t                  expire_queue;
+    njt_uint_t                   version;
+} njt_ssl_stapling_cache_t;
+
+
+typedef struct {
+    njt_str_node_t               node;
+    njt_queue_t                  queue;
+    njt_str_t                    staple;
+    time_t                       valid;
+    time_t                       refresh;
+    /* a process is querying the responder until this time */
+    time_t                       claimed;
+    njt_uint_t                   version;
+} njt_ssl_stapling_cache_node_t;
+
+
 typedef struct {
     njt_addr_t                  *addrs;
     njt_uint_t                   naddrs;
@@ -162,6 +194,23 @@ static time_t njt_ssl_stapling_time(ASN1_GENERALIZEDTIME *asn1time);
 
 static void njt_ssl_stapling_cleanup(void *data);
 
+static njt_int_t njt_ssl_stapling_cache_expire(njt_ssl_stapling_cache_t *cache,
+    njt_slab_pool_t *shpool, njt_ssl_stapling_cache_node_t *keep);
+static void njt_ssl_stapling_cache_load(njt_conf_t *cf,
+    njt_ssl_stapling_t *staple);
+static void njt_ssl_stapling_cache_save(njt_ssl_stapling_t *staple,
+    njt_log_t *log);
+static njt_ssl_stapling_cache_node_t *njt_ssl_stapling_cache_node(
+    njt_ssl_stapling_t *staple, njt_uint_t create);
+static void njt_ssl_stapling_cache_copy(njt_ssl_stapling_t *staple,
+    njt_ssl_stapling_cache_node_t *node);
+static void njt_ssl_stapling_cache_sync(njt_ssl_stapling_t *staple);
+static njt_int_t njt_ssl_stapling_cache_claim(njt_ssl_stapling_t *staple);
+static void njt_ssl_stapling_cache_store(njt_ssl_stapling_t *staple,
+    njt_log_t *log);
+static void njt_ssl_stapling_cache_release(njt_ssl_stapling_t *staple);
+static void njt_ssl_stapling_refresh_handler(njt_event_t *ev);
+
 static void njt_ssl_ocsp_validate_next(njt_connection_t *c);
 static void njt_ssl_ocsp_handler(njt_ssl_ocsp_ctx_t *ctx);
 static njt_int_t njt_ssl_ocsp_responder(njt_connection_t *c,
@@ -188,10 +237,19 @@ static njt_int_t njt_ssl_ocsp_verify(njt_ssl_ocsp_ctx_t *ctx);
 static njt_int_t njt_ssl_ocsp_cache_lookup(njt_ssl_ocsp_ctx_t *ctx);
 static njt_int_t njt_ssl_ocsp_cache_store(njt_ssl_ocsp_ctx_t *ctx);
 static njt_int_t njt_ssl_ocsp_create_key(njt_ssl_ocsp_ctx_t *ctx);
+static njt_int_t njt_ssl_ocsp_key(X509 *cert, X509 *issuer, u_char *p);
 
 static u_char *njt_ssl_ocsp_log_error(njt_log_t *log, u_char *buf, size_t len);
 
 
+/* staples attached to a shared cache, refreshed in the background */
+static njt_queue_t  njt_ssl_stapling_queue = {
+    &njt_ssl_stapling_queue, &njt_ssl_stapling_queue
+};
+
+static njt_event_t  njt_ssl_stapling_event;
+
+
 njt_int_t
 njt_ssl_stapling(njt_conf_t *cf, njt_ssl_t *ssl, njt_str_t *file,
     njt_str_t *responder, njt_uint_t verify)
@@ -202,6 +260,11 @@ njt_ssl_stapling(njt_conf_t *cf, njt_ssl_t *ssl, njt_str_t *file,
          cert;
          cert = X509_get_ex_data(cert, njt_ssl_next_certificate_index))
     {
+        if (X509_get_ex_data(cert, njt_ssl_stapling_index)) {
+            /* already set up, certificates added at runtime */
+            continue;
+        }
+
         if (njt_ssl_stapling_certificate(cf, ssl, cert, file, responder, verify)
             != NJT_OK)
         {
@@ -590,6 +653,8 @@ njt_ssl_certificate_status_callback(njt_ssl_conn_t *ssl_conn, void *data)
         return rc;
     }
 
+    njt_ssl_stapling_cache_sync(staple);
+
     if (staple->staple.len
         && staple->valid >= njt_time())
     {
@@ -625,6 +690,10 @@ njt_ssl_stapling_update(njt_ssl_stapling_t *staple)
         return;
     }
 
+    if (staple->shm_zone && njt_ssl_stapling_cache_claim(staple) != NJT_OK) {
+        return;
+    }
+
     staple->loading = 1;
 
     ctx = njt_ssl_ocsp_start(njt_cycle->log);
@@ -705,6 +774,10 @@ njt_ssl_stapling_ocsp_handler(njt_ssl_ocsp_ctx_t *ctx)
     staple->loading = 0;
     staple->refresh = njt_max(njt_min(ctx->valid - 300, now + 3600), now + 300);
 
+    if (staple->shm_zone) {
+        njt_ssl_stapling_cache_store(staple, ctx->log);
+    }
+
     njt_ssl_ocsp_done(ctx);
     return;
 
@@ -713,6 +786,10 @@ error:
     staple->loading = 0;
     staple->refresh = now + 300;
 
+    if (staple->shm_zone) {
+        njt_ssl_stapling_cache_release(staple);
+    }
+
     njt_ssl_ocsp_done(ctx);
 }
 
@@ -756,6 +833,10 @@ njt_ssl_stapling_cleanup(void *data)
 {
     njt_ssl_stapling_t  *staple = data;
 
+    if (staple->shm_zone) {
+        njt_queue_remove(&staple->queue);
+    }
+
     if (staple->issuer) {
         X509_free(staple->issuer);
     }
@@ -766,6 +847,622 @@ njt_ssl_stapling_cleanup(void *data)
 }
 
 
+njt_int_t
+njt_ssl_stapling_cache(njt_conf_t *cf, njt_ssl_t *ssl,
+    njt_shm_zone_t *shm_zone, njt_str_t *path)
+{
+    u_char              *p;
+    X509                *cert;
+    njt_ssl_stapling_t  *staple;
+
+    if (shm_zone == NULL) {
+        return NJT_OK;
+    }
+
+    for (cert = SSL_CTX_get_ex_data(ssl->ctx, njt_ssl_certificate_index);
+         cert;
+         cert = X509_get_ex_data(cert, njt_ssl_next_certificate_index))
+    {
+        staple = X509_get_ex_data(cert, njt_ssl_stapling_index);
+
+        if (staple == NULL || staple->shm_zone
+            || staple->issuer == NULL || staple->host.len == 0)
+        {
+            /* stapling ignored or the response is taken from a file */
+            continue;
+        }
+
+        staple->key.data = njt_pnalloc(cf->pool, NJT_SSL_OCSP_KEY_LEN);
+        if (staple->key.data == NULL) {
+            return NJT_ERROR;
+        }
+
+        staple->key.len = NJT_SSL_OCSP_KEY_LEN;
+
+        if (njt_ssl_ocsp_key(staple->cert, staple->issuer, staple->key.data)
+            != NJT_OK)
+        {
+            njt_log_error(NJT_LOG_WARN, ssl->log, 0,
+                          "\"ssl_stapling_cache\" ignored, "
+                          "no cache key for the certificate \"%s\"",
+                          staple->name);
+            continue;
+        }
+
+        if (path->len) {
+            staple->path.len = path->len + 1 + 2 * NJT_SSL_OCSP_KEY_LEN
+                               + sizeof(".der") - 1;
+
+            staple->path.data = njt_pnalloc(cf->pool, staple->path.len + 1);
+            if (staple->path.data == NULL) {
+                return NJT_ERROR;
+            }
+
+            p = njt_cpymem(staple->path.data, path->data, path->len);
+            *p++ = '/';
+            p = njt_hex_dump(p, staple->key.data, staple->key.len);
+            p = njt_cpymem(p, ".der", sizeof(".der") - 1);
+            *p = '\0';
+
+            njt_ssl_stapling_cache_load(cf, staple);
+        }
+
+        staple->shm_zone = shm_zone;
+        staple->cycle = cf->cycle;
+
+        njt_queue_insert_tail(&njt_ssl_stapling_queue, &staple->queue);
+    }
+
+    if (njt_ssl_stapling_event.handler
+        && !njt_ssl_stapling_event.timer_set
+        && !njt_queue_empty(&njt_ssl_stapling_queue))
+    {
+        /* certificates added at runtime */
+        njt_add_timer(&njt_ssl_stapling_event, 1);
+    }
+
+    return NJT_OK;
+}
+
+
+njt_int_t
+njt_ssl_stapling_cache_init(njt_shm_zone_t *shm_zone, void *data)
+{
+    size_t                     len;
+    njt_slab_pool_t           *shpool;
+    njt_ssl_stapling_cache_t  *cache;
+
+    if (data) {
+        shm_zone->data = data;
+        return NJT_OK;
+    }
+
+    shpool = (njt_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        shm_zone->data = shpool->data;
+        return NJT_OK;
+    }
+
+    cache = njt_slab_calloc(shpool, sizeof(njt_ssl_stapling_cache_t));
+    if (cache == NULL) {
+        return NJT_ERROR;
+    }
+
+    shpool->data = cache;
+    shm_zone->data = cache;
+
+    njt_rbtree_init(&cache->rbtree, &cache->sentinel,
+                    njt_str_rbtree_insert_value);
+
+    njt_queue_init(&cache->expire_queue);
+
+    len = sizeof(" in OCSP stapling cache \"\"") + shm_zone->shm.name.len;
+
+    shpool->log_ctx = njt_slab_alloc(shpool, len);
+    if (shpool->log_ctx == NULL) {
+        return NJT_ERROR;
+    }
+
+    njt_sprintf(shpool->log_ctx, " in OCSP stapling cache \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    shpool->log_nomem = 0;
+
+    return NJT_OK;
+}
+
+
+njt_int_t
+njt_ssl_stapling_init_process(njt_cycle_t *cycle)
+{
+    if (njt_process != NJT_PROCESS_WORKER
+        && njt_process != NJT_PROCESS_SINGLE)
+    {
+        return NJT_OK;
+    }
+
+    njt_ssl_stapling_event.handler = njt_ssl_stapling_refresh_handler;
+    njt_ssl_stapling_event.log = cycle->log;
+    njt_ssl_stapling_event.cancelable = 1;
+
+    if (!njt_queue_empty(&njt_ssl_stapling_queue)) {
+        njt_add_timer(&njt_ssl_stapling_event, 1);
+    }
+
+    return NJT_OK;
+}
+
+
+static void
+njt_ssl_stapling_refresh_handler(njt_event_t *ev)
+{
+    njt_queue_t         *q;
+    njt_ssl_stapling_t  *staple;
+
+    for (q = njt_queue_head(&njt_ssl_stapling_queue);
+         q != njt_queue_sentinel(&njt_ssl_stapling_queue);
+         q = njt_queue_next(q))
+    {
+        staple = njt_queue_data(q, njt_ssl_stapling_t, queue);
+
+        if (staple->cycle != (njt_cycle_t *) njt_cycle) {
+            /* inherited from a previous configuration */
+            continue;
+        }
+
+        njt_ssl_stapling_cache_sync(staple);
+        njt_ssl_stapling_update(staple);
+    }
+
+    njt_add_timer(ev, NJT_SSL_STAPLING_REFRESH);
+}
+
+
+static void
+njt_ssl_stapling_cache_load(njt_conf_t *cf, njt_ssl_stapling_t *staple)
+{
+    off_t                size;
+    time_t               now;
+    njt_fd_t             fd;
+    njt_str_t            response;
+    njt_file_info_t      fi;
+    njt_ssl_ocsp_ctx_t  *ctx;
+
+    fd = njt_open_file(staple->path.data, NJT_FILE_RDONLY, NJT_FILE_OPEN, 0);
+
+    if (fd == NJT_INVALID_FILE) {
+        if (njt_errno != NJT_ENOENT) {
+            njt_log_error(NJT_LOG_WARN, cf->log, njt_errno,
+                          njt_open_file_n " \"%s\" failed", staple->path.data);
+        }
+
+        return;
+    }
+
+    ctx = NULL;
+
+    if (njt_fd_info(fd, &fi) == NJT_FILE_ERROR) {
+        njt_log_error(NJT_LOG_WARN, cf->log, njt_errno,
+                      njt_fd_info_n " \"%s\" failed", staple->path.data);
+        goto done;
+    }
+
+    size = njt_file_size(&fi);
+
+    if (size == 0 || size > 65536) {
+        goto done;
+    }
+
+    ctx = njt_ssl_ocsp_start(cf->log);
+    if (ctx == NULL) {
+        goto done;
+    }
+
+    ctx->response = njt_create_temp_buf(ctx->pool, (size_t) size);
+    if (ctx->response == NULL) {
+        goto done;
+    }
+
+    if (njt_read_fd(fd, ctx->response->last, (size_t) size) != size) {
+        njt_log_error(NJT_LOG_WARN, cf->log, njt_errno,
+                      njt_read_fd_n " \"%s\" failed", staple->path.data);
+        goto done;
+    }
+
+    ctx->response->last += size;
+
+    ctx->log->action = "loading cached certificate status";
+
+    ctx->ssl_ctx = staple->ssl_ctx;
+    ctx->cert = staple->cert;
+    ctx->issuer = staple->issuer;
+    ctx->chain = staple->chain;
+    ctx->name = staple->name;
+    ctx->host = staple->host;
+    ctx->flags = (staple->verify ? OCSP_TRUSTOTHER : OCSP_NOVERIFY);
+    ctx->code = 200;
+
+    if (njt_ssl_ocsp_verify(ctx) != NJT_OK
+        || ctx->status != V_OCSP_CERTSTATUS_GOOD)
+    {
+        njt_log_error(NJT_LOG_NOTICE, cf->log, 0,
+                      "ignoring cached OCSP response \"%s\"",
+                      staple->path.data);
+        goto done;
+    }
+
+    response.len = (size_t) size;
+    response.data = njt_alloc(response.len, cf->log);
+
+    if (response.data == NULL) {
+        goto done;
+    }
+
+    njt_memcpy(response.data, ctx->response->pos, response.len);
+
+    now = njt_time();
+
+    staple->staple = response;
+    staple->valid = ctx->valid;
+    staple->refresh = njt_max(njt_min(ctx->valid - 300, now + 3600), now + 300);
+
+    njt_log_debug1(NJT_LOG_DEBUG_EVENT, cf->log, 0,
+                   "ssl stapling cache loaded \"%s\"", staple->path.data);
+
+done:
+
+    if (ctx) {
+        njt_ssl_ocsp_done(ctx);
+    }
+
+    if (njt_close_file(fd) == NJT_FILE_ERROR) {
+        njt_log_error(NJT_LOG_ALERT, cf->log, njt_errno,
+                      njt_close_file_n " \"%s\" failed", staple->path.data);
+    }
+}
+
+
+static void
+njt_ssl_stapling_cache_save(njt_ssl_stapling_t *staple, njt_log_t *log)
+{
+    u_char    *p, temp[NJT_MAX_PATH];
+    ssize_t    n;
+    njt_fd_t   fd;
+
+    /* written to a temporary file first, the old response stays usable */
+
+    p = njt_snprintf(temp, NJT_MAX_PATH - 1, "%V.%P", &staple->path, njt_pid);
+    *p = '\0';
+
+    fd = njt_open_file(temp, NJT_FILE_WRONLY, NJT_FILE_TRUNCATE,
+                       NJT_FILE_DEFAULT_ACCESS);
+
+    if (fd == NJT_INVALID_FILE) {
+        njt_log_error(NJT_LOG_ERR, log, njt_errno,
+                      njt_open_file_n " \"%s\" failed", temp);
+        return;
+    }
+
+    n = njt_write_fd(fd, staple->staple.data, staple->staple.len);
+
+    if (n != (ssize_t) staple->staple.len) {
+        njt_log_error(NJT_LOG_ERR, log, njt_errno,
+                      njt_write_fd_n " \"%s\" failed", temp);
+    }
+
+    if (njt_close_file(fd) == NJT_FILE_ERROR) {
+        njt_log_error(NJT_LOG_ALERT, log, njt_errno,
+                      njt_close_file_n " \"%s\" failed", temp);
+    }
+
+    if (n == (ssize_t) staple->staple.len) {
+
+        if (njt_rename_file(temp, staple->path.data) != NJT_FILE_ERROR) {
+            return;
+        }
+
+        njt_log_error(NJT_LOG_ERR, log, njt_errno,
+                      njt_rename_file_n " \"%s\" to \"%s\" failed",
+                      temp, staple->path.data);
+    }
+
+    if (njt_delete_file(temp) == NJT_FILE_ERROR) {
+        njt_log_error(NJT_LOG_CRIT, log, njt_errno,
+                      njt_delete_file_n " \"%s\" failed", temp);
+    }
+}
+
+
+static njt_int_t
+njt_ssl_stapling_cache_expire(njt_ssl_stapling_cache_t *cache,
+    njt_slab_pool_t *shpool, njt_ssl_stapling_cache_node_t *keep)
+{
+    njt_queue_t                    *q;
+    njt_ssl_stapling_cache_node_t  *node;
+
+    /* drop the least recently used response */
+
+    if (njt_queue_empty(&cache->expire_queue)) {
+        return NJT_DECLINED;
+    }
+
+    q = njt_queue_last(&cache->expire_queue);
+    node = njt_queue_data(q, njt_ssl_stapling_cache_node_t, queue);
+
+    if (node == keep) {
+        return NJT_DECLINED;
+    }
+
+    njt_rbtree_delete(&cache->rbtree, &node->node.node);
+    njt_queue_remove(q);
+
+    if (node->staple.data) {
+        njt_slab_free_locked(shpool, node->staple.data);
+    }
+
+    njt_slab_free_locked(shpool, node);
+
+    return NJT_OK;
+}
+
+
+static njt_ssl_stapling_cache_node_t *
+njt_ssl_stapling_cache_node(njt_ssl_stapling_t *staple, njt_uint_t create)
+{
+    size_t                          size;
+    uint32_t                        hash;
+    njt_slab_pool_t                *shpool;
+    njt_ssl_stapling_cache_t       *cache;
+    njt_ssl_stapling_cache_node_t  *node;
+
+    /* called with the zone locked */
+
+    cache = staple->shm_zone->data;
+    shpool = (njt_slab_pool_t *) staple->shm_zone->shm.addr;
+    hash = njt_hash_key(staple->key.data, staple->key.len);
+
+    node = (njt_ssl_stapling_cache_node_t *)
+               njt_str_rbtree_lookup(&cache->rbtree, &staple->key, hash);
+
+    if (node) {
+        njt_queue_remove(&node->queue);
+        njt_queue_insert_head(&cache->expire_queue, &node->queue);
+        return node;
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    size = sizeof(njt_ssl_stapling_cache_node_t) + staple->key.len;
+
+    node = njt_slab_calloc_locked(shpool, size);
+
+    if (node == NULL
+        && njt_ssl_stapling_cache_expire(cache, shpool, NULL) == NJT_OK)
+    {
+        node = njt_slab_calloc_locked(shpool, size);
+    }
+
+    if (node == NULL) {
+        njt_log_error(NJT_LOG_ALERT, njt_cycle->log, 0,
+                      "could not allocate new entry%s", shpool->log_ctx);
+        return NULL;
+    }
+
+    node->node.str.len = staple->key.len;
+    node->node.str.data = (u_char *) node
+                          + sizeof(njt_ssl_stapling_cache_node_t);
+    njt_memcpy(node->node.str.data, staple->key.data, staple->key.len);
+    node->node.node.key = hash;
+
+    njt_rbtree_insert(&cache->rbtree, &node->node.node);
+    njt_queue_insert_head(&cache->expire_queue, &node->queue);
+
+    return node;
+}
+
+
+static void
+njt_ssl_stapling_cache_copy(njt_ssl_stapling_t *staple,
+    njt_ssl_stapling_cache_node_t *node)
+{
+    u_char  *p;
+
+    if (node->version == staple->version
+        || node->staple.len == 0
+        || node->valid < njt_time())
+    {
+        return;
+    }
+
+    p = njt_alloc(node->staple.len, njt_cycle->log);
+    if (p == NULL) {
+        return;
+    }
+
+    njt_memcpy(p, node->staple.data, node->staple.len);
+
+    if (staple->staple.data) {
+        njt_free(staple->staple.data);
+    }
+
+    staple->staple.data = p;
+    staple->staple.len = node->staple.len;
+    staple->valid = node->valid;
+    staple->refresh = node->refresh;
+    staple->version = node->version;
+
+    njt_log_debug2(NJT_LOG_DEBUG_EVENT, njt_cycle->log, 0,
+                   "ssl stapling cache update, version:%ui, valid:%T",
+                   node->version, node->valid);
+}
+
+
+static void
+njt_ssl_stapling_cache_sync(njt_ssl_stapling_t *staple)
+{
+    time_t                          now;
+    njt_slab_pool_t                *shpool;
+    njt_ssl_stapling_cache_node_t  *node;
+
+    if (staple->shm_zone == NULL) {
+        return;
+    }
+
+    now = njt_time();
+
+    if (staple->checked == now) {
+        return;
+    }
+
+    staple->checked = now;
+
+    shpool = (njt_slab_pool_t *) staple->shm_zone->shm.addr;
+
+    njt_shmtx_lock(&shpool->mutex);
+
+    node = njt_ssl_stapling_cache_node(staple, 0);
+
+    if (node) {
+        njt_ssl_stapling_cache_copy(staple, node);
+    }
+
+    njt_shmtx_unlock(&shpool->mutex);
+}
+
+
+static njt_int_t
+njt_ssl_stapling_cache_claim(njt_ssl_stapling_t *staple)
+{
+    time_t                          now;
+    njt_slab_pool_t                *shpool;
+    njt_ssl_stapling_cache_node_t  *node;
+
+    now = njt_time();
+    shpool = (njt_slab_pool_t *) staple->shm_zone->shm.addr;
+
+    njt_shmtx_lock(&shpool->mutex);
+
+    node = njt_ssl_stapling_cache_node(staple, 1);
+
+    if (node == NULL) {
+        /* query the responder without the cache */
+        njt_shmtx_unlock(&shpool->mutex);
+        return NJT_OK;
+    }
+
+    njt_ssl_stapling_cache_copy(staple, node);
+
+    if (node->refresh >= now) {
+        staple->refresh = node->refresh;
+        njt_shmtx_unlock(&shpool->mutex);
+        return NJT_DECLINED;
+    }
+
+    if (node->claimed > now) {
+        /* another process is querying the responder */
+        staple->refresh = node->claimed;
+        njt_shmtx_unlock(&shpool->mutex);
+        return NJT_DECLINED;
+    }
+
+    node->claimed = now + 1
+                    + (time_t) ((staple->timeout + staple->resolver_timeout)
+                                / 1000);
+
+    njt_shmtx_unlock(&shpool->mutex);
+
+    njt_log_debug1(NJT_LOG_DEBUG_EVENT, njt_cycle->log, 0,
+                   "ssl stapling cache claimed, pid:%P", njt_pid);
+
+    return NJT_OK;
+}
+
+
+static void
+njt_ssl_stapling_cache_store(njt_ssl_stapling_t *staple, njt_log_t *log)
+{
+    u_char                         *p;
+    njt_slab_pool_t                *shpool;
+    njt_ssl_stapling_cache_t       *cache;
+    njt_ssl_stapling_cache_node_t  *node;
+
+    cache = staple->shm_zone->data;
+    shpool = (njt_slab_pool_t *) staple->shm_zone->shm.addr;
+
+    njt_shmtx_lock(&shpool->mutex);
+
+    node = njt_ssl_stapling_cache_node(staple, 1);
+
+    if (node) {
+        if (node->staple.data) {
+            njt_slab_free_locked(shpool, node->staple.data);
+            njt_str_null(&node->staple);
+        }
+
+        p = njt_slab_alloc_locked(shpool, staple->staple.len);
+
+        while (p == NULL
+               && njt_ssl_stapling_cache_expire(cache, shpool, node) == NJT_OK)
+        {
+            p = njt_slab_alloc_locked(shpool, staple->staple.len);
+        }
+
+        if (p == NULL) {
+            njt_log_error(NJT_LOG_ALERT, log, 0,
+                          "could not allocate OCSP response%s",
+                          shpool->log_ctx);
+
+            /* other processes query the responder themselves */
+
+            node->claimed = 0;
+
+        } else {
+            njt_memcpy(p, staple->staple.data, staple->staple.len);
+
+            node->staple.data = p;
+            node->staple.len = staple->staple.len;
+            node->valid = staple->valid;
+            node->refresh = staple->refresh;
+            node->claimed = 0;
+            node->version = ++cache->version;
+
+            staple->version = node->version;
+        }
+    }
+
+    njt_shmtx_unlock(&shpool->mutex);
+
+    if (staple->path.len) {
+        njt_ssl_stapling_cache_save(staple, log);
+    }
+}
+
+
+static void
+njt_ssl_stapling_cache_release(njt_ssl_stapling_t *staple)
+{
+    njt_slab_pool_t                *shpool;
+    njt_ssl_stapling_cache_node_t  *node;
+
+    shpool = (njt_slab_pool_t *) staple->shm_zone->shm.addr;
+
+    njt_shmtx_lock(&shpool->mutex);
+
+    node = njt_ssl_stapling_cache_node(staple, 0);
+
+    if (node) {
+        /* other processes retry no earlier than this one */
+        node->refresh = staple->refresh;
+        node->claimed = 0;
+    }
+
+    njt_shmtx_unlock(&shpool->mutex);
+}
+
+
 njt_int_t
 njt_ssl_ocsp(njt_conf_t *cf, njt_ssl_t *ssl, njt_str_t *responder,
     njt_uint_t depth, njt_shm_zone_t *shm_zone)
@@ -2630,32 +3327,47 @@ njt_ssl_ocsp_cache_store(njt_ssl_ocsp_ctx_t *ctx)
 static njt_int_t
 njt_ssl_ocsp_create_key(njt_ssl_ocsp_ctx_t *ctx)
 {
-    u_char        *p;
-    X509_NAME     *name;
-    ASN1_INTEGER  *serial;
+    u_char  *p;
 
-    p = njt_pnalloc(ctx->pool, 60);
+    p = njt_pnalloc(ctx->pool, NJT_SSL_OCSP_KEY_LEN);
     if (p == NULL) {
         return NJT_ERROR;
     }
 
     ctx->key.data = p;
-    ctx->key.len = 60;
+    ctx->key.len = NJT_SSL_OCSP_KEY_LEN;
+
+    if (njt_ssl_ocsp_key(ctx->cert, ctx->issuer, p) != NJT_OK) {
+        return NJT_ERROR;
+    }
+
+    njt_log_debug1(NJT_LOG_DEBUG_EVENT, ctx->log, 0,
+                   "ssl ocsp key %xV", &ctx->key);
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_ssl_ocsp_key(X509 *cert, X509 *issuer, u_char *p)
+{
+    X509_NAME     *name;
+    ASN1_INTEGER  *serial;
 
-    name = X509_get_subject_name(ctx->issuer);
+    name = X509_get_subject_name(issuer);
     if (X509_NAME_digest(name, EVP_sha1(), p, NULL) == 0) {
         return NJT_ERROR;
     }
 
     p += 20;
 
-    if (X509_pubkey_digest(ctx->issuer, EVP_sha1(), p, NULL) == 0) {
+    if (X509_pubkey_digest(issuer, EVP_sha1(), p, NULL) == 0) {
         return NJT_ERROR;
     }
 
     p += 20;
 
-    serial = X509_get_serialNumber(ctx->cert);
+    serial = X509_get_serialNumber(cert);
     if (serial->length > 20) {
         return NJT_ERROR;
     }
@@ -2663,9 +3375,6 @@ njt_ssl_ocsp_create_key(njt_ssl_ocsp_ctx_t *ctx)
     p = njt_cpymem(p, serial->data, serial->length);
     njt_memzero(p, 20 - serial->length);
 
-    njt_log_debug1(NJT_LOG_DEBUG_EVENT, ctx->log, 0,
-                   "ssl ocsp key %xV", &ctx->key);
-
     return NJT_OK;
 }
 
@@ -2730,6 +3439,28 @@ njt_ssl_stapling_resolver(njt_conf_t *cf, njt_ssl_t *ssl,
 }
 
 
+njt_int_t
+njt_ssl_stapling_cache(njt_conf_t *cf, njt_ssl_t *ssl,
+    njt_shm_zone_t *shm_zone, njt_str_t *path)
+{
+    return NJT_OK;
+}
+
+
+njt_int_t
+njt_ssl_stapling_cache_init(njt_shm_zone_t *shm_zone, void *data)
+{
+    return NJT_OK;
+}
+
+
+njt_int_t
+njt_ssl_stapling_init_process(njt_cycle_t *cycle)
+{
+    return NJT_OK;
+}
+
+
 njt_int_t
 njt_ssl_ocsp(njt_conf_t *cf, njt_ssl_t *ssl, njt_str_t *responder,
     njt_uint_t depth, njt_shm_zone_t *shm_zone)
@@ -9,8 +9,8 @@
 #include <bpf/bpf_helpers.h>
 
 
-#if !defined(sec)
-#define SEC(NAME)  __attribute__((section(NMAE, used)))
+#if !defined(SEC)
+#define SEC(NAME)  __attribute__((section(NAME), used))
 #endif
 
 
@@ -42,6 +42,7 @@ char _license[] SEC("license") = LICENSE;
 
 #define NJT_QUIC_PKT_LONG        0x80  /* header form */
 #define NJT_QUIC_SERVER_CID_LEN  20
+#define NJT_QUIC_BPF_SLOTS       1024  /* see njt_event_quic_bpf.c */
 
 
 #define advance_data(nbytes)                                                  \
@@ -69,11 +70,18 @@ char _license[] SEC("license") = LICENSE;
  */
 struct bpf_map_def SEC("maps") njt_quic_sockmap;
 
+/*
+ * sockets of the current worker processes, indexed by slot;
+ * packets with unknown keys (new connections) are spread over them
+ */
+struct bpf_map_def SEC("maps") njt_quic_slots;
+
 
 SEC(PROGNAME)
 int njt_quic_select_socket_by_dcid(struct sk_reuseport_md *ctx)
 {
     int             rc;
+    __u32           slot;
     __u64           key;
     size_t          len, offset;
     unsigned char  *start, *end, *data, *dcid;
@@ -120,9 +128,7 @@ int njt_quic_select_socket_by_dcid(struct sk_reuseport_md *ctx)
 
     /* kernel returns positive error numbers, errno.h defines positive */
     case -ENOENT:
-        debugmsg("njet quic default route for key 0x%llx", key);
-        /* let the default reuseport logic decide which socket to choose */
-        return SK_PASS;
+        break;
 
     default:
         debugmsg("njet quic bpf_sk_select_reuseport err: %d key 0x%llx",
@@ -130,6 +136,25 @@ int njt_quic_select_socket_by_dcid(struct sk_reuseport_md *ctx)
         goto failed;
     }
 
+    /*
+     * the key does not belong to any socket: this is either a new connection
+     * or a connection of an exited worker; pass it to one of current workers
+     */
+
+    slot = (__u32) (key ^ (key >> 32)) & (NJT_QUIC_BPF_SLOTS - 1);
+
+    rc = bpf_sk_select_reuseport(ctx, &njt_quic_slots, &slot, 0);
+
+    if (rc == 0) {
+        debugmsg("njet quic socket selected by slot %u", slot);
+        return SK_PASS;
+    }
+
+    debugmsg("njet quic default route for key 0x%llx", key);
+
+    /* let the default reuseport logic decide which socket to choose */
+    return SK_PASS;
+
 failed:
     /*
      * SK_DROP will generate ICMP, but we may want to process "invalid" packet
@@ -306,12 +306,6 @@ njt_quic_new_connection(njt_connection_t *c, njt_quic_conf_t *conf,
     qc->streams.client_max_streams_uni = qc->tp.initial_max_streams_uni;
     qc->streams.client_max_streams_bidi = qc->tp.initial_max_streams_bidi;
 
-    qc->congestion.window = njt_min(10 * qc->tp.max_udp_payload_size,
-                                    njt_max(2 * qc->tp.max_udp_payload_size,
-                                            14720));
-    qc->congestion.ssthresh = (size_t) -1;
-    qc->congestion.recovery_start = njt_current_msec;
-
     if (pkt->validated && pkt->retried) {
         qc->tp.retry_scid.len = pkt->dcid.len;
         qc->tp.retry_scid.data = njt_pstrdup(c->pool, &pkt->dcid);
@@ -333,6 +327,8 @@ njt_quic_new_connection(njt_connection_t *c, njt_quic_conf_t *conf,
         return NULL;
     }
 
+    njt_quic_congestion_init(c);
+
     c->idle = 1;
     njt_reusable_connection(c, 1);
 
@@ -28,6 +28,13 @@
 #define NJT_QUIC_STREAM_SERVER_INITIATED     0x01
 #define NJT_QUIC_STREAM_UNIDIRECTIONAL       0x02
 
+#define NJT_QUIC_STREAM_URGENCY_LEVELS       8
+#define NJT_QUIC_STREAM_URGENCY_DEFAULT      3
+
+#define NJT_QUIC_CC_NEWRENO                  0
+#define NJT_QUIC_CC_CUBIC                    1
+#define NJT_QUIC_CC_BBR                      2
+
 
 typedef njt_int_t (*njt_quic_init_pt)(njt_connection_t *c);
 typedef void (*njt_quic_shutdown_pt)(njt_connection_t *c);
@@ -67,7 +74,10 @@ typedef struct {
 
     njt_flag_t                     retry;
     njt_flag_t                     gso_enabled;
+    njt_flag_t                     sendmmsg_enabled;
     njt_flag_t                     disable_active_migration;
+    njt_flag_t                     pacing;
+    njt_uint_t                     congestion_control;
     njt_msec_t                     handshake_timeout;
     njt_msec_t                     idle_timeout;
     njt_str_t                      host_key;
@@ -87,6 +97,18 @@ typedef struct {
 } njt_quic_conf_t;
 
 
+typedef struct {
+    size_t                         cwnd;
+    size_t                         in_flight;
+    njt_msec_t                     rtt;
+    njt_msec_t                     rttvar;
+    njt_msec_t                     min_rtt;
+    uint64_t                       sent;
+    uint64_t                       lost;
+    uint64_t                       pacing_rate;
+} njt_quic_congestion_stats_t;
+
+
 struct njt_quic_stream_s {
     njt_rbtree_node_t              node;
     njt_queue_t                    queue;
@@ -107,6 +129,9 @@ struct njt_quic_stream_s {
     njt_quic_buffer_t              recv;
     njt_quic_stream_send_state_e   send_state;
     njt_quic_stream_recv_state_e   recv_state;
+    uint64_t                       vtime;
+    unsigned                       urgency:3;
+    unsigned                       incremental:1;
     unsigned                       cancelable:1;
     unsigned                       fin_acked:1;
 };
@@ -122,9 +147,17 @@ void njt_quic_shutdown_connection(njt_connection_t *c, njt_uint_t err,
 njt_int_t njt_quic_reset_stream(njt_connection_t *c, njt_uint_t err);
 njt_int_t njt_quic_shutdown_stream(njt_connection_t *c, int how);
 void njt_quic_cancelable_stream(njt_connection_t *c);
+void njt_quic_set_stream_priority(njt_connection_t *c, uint64_t id,
+    njt_uint_t urgency, njt_uint_t incremental);
 njt_int_t njt_quic_get_packet_dcid(njt_log_t *log, u_char *data, size_t len,
     njt_str_t *dcid);
 njt_int_t njt_quic_derive_key(njt_log_t *log, const char *label,
     njt_str_t *secret, njt_str_t *salt, u_char *out, size_t len);
+void njt_quic_congestion_stats(njt_connection_t *c,
+    njt_quic_congestion_stats_t *st);
+
+#if (NJT_QUIC_BPF)
+njt_int_t njt_quic_bpf_update_workers(njt_cycle_t *cycle, njt_uint_t n);
+#endif
 
 #endif /* _NJT_EVENT_QUIC_H_INCLUDED_ */
@@ -315,7 +315,6 @@ void
 njt_quic_congestion_ack(njt_connection_t *c, njt_quic_frame_t *f)
 {
     njt_uint_t              blocked;
-    njt_msec_t              timer;
     njt_quic_congestion_t  *cg;
     njt_quic_connection_t  *qc;
 
@@ -334,40 +333,10 @@ njt_quic_congestion_ack(njt_connection_t *c, njt_quic_frame_t *f)
 
     cg->in_flight -= f->plen;
 
-    timer = f->send_time - cg->recovery_start;
+    cg->delivered += f->plen;
+    cg->delivered_time = njt_current_msec;
 
-    if ((njt_msec_int_t) timer <= 0) {
-        njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
-                       "quic congestion ack recovery win:%uz ss:%z if:%uz",
-                       cg->window, cg->ssthresh, cg->in_flight);
-
-        goto done;
-    }
-
-    if (cg->window < cg->ssthresh) {
-        cg->window += f->plen;
-
-        njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
-                       "quic congestion slow start win:%uz ss:%z if:%uz",
-                       cg->window, cg->ssthresh, cg->in_flight);
-
-    } else {
-        cg->window += qc->tp.max_udp_payload_size * f->plen / cg->window;
-
-        njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
-                       "quic congestion avoidance win:%uz ss:%z if:%uz",
-                       cg->window, cg->ssthresh, cg->in_flight);
-    }
-
-    /* prevent recovery_start from wrapping */
-
-    timer = cg->recovery_start - njt_current_msec + qc->tp.max_idle_timeout * 2;
-
-    if ((njt_msec_int_t) timer < 0) {
-        cg->recovery_start = njt_current_msec - qc->tp.max_idle_timeout * 2;
-    }
-
-done:
+    cg->ops->ack(c, f);
 
     if (blocked && cg->in_flight < cg->window) {
         njt_post_event(&qc->push, &njt_posted_events);
@@ -548,8 +517,7 @@ njt_quic_persistent_congestion(njt_connection_t *c)
     qc = njt_quic_get_connection(c);
     cg = &qc->congestion;
 
-    cg->recovery_start = njt_current_msec;
-    cg->window = qc->tp.max_udp_payload_size * 2;
+    cg->ops->persistent(c);
 
     njt_log_debug1(NJT_LOG_DEBUG_EVENT, c->log, 0,
                    "quic persistent congestion win:%uz", cg->window);
@@ -641,7 +609,8 @@ njt_quic_resend_frames(njt_connection_t *c, njt_quic_send_ctx_t *ctx)
                 }
             }
 
-            /* fall through */
+            njt_quic_insert_frame(ctx, f);
+            break;
 
         default:
             njt_queue_insert_tail(&ctx->frames, &f->queue);
@@ -661,7 +630,6 @@ static void
 njt_quic_congestion_lost(njt_connection_t *c, njt_quic_frame_t *f)
 {
     njt_uint_t              blocked;
-    njt_msec_t              timer;
     njt_quic_congestion_t  *cg;
     njt_quic_connection_t  *qc;
 
@@ -679,32 +647,11 @@ njt_quic_congestion_lost(njt_connection_t *c, njt_quic_frame_t *f)
     blocked = (cg->in_flight >= cg->window) ? 1 : 0;
 
     cg->in_flight -= f->plen;
-    f->plen = 0;
-
-    timer = f->send_time - cg->recovery_start;
-
-    if ((njt_msec_int_t) timer <= 0) {
-        njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
-                       "quic congestion lost recovery win:%uz ss:%z if:%uz",
-                       cg->window, cg->ssthresh, cg->in_flight);
-
-        goto done;
-    }
-
-    cg->recovery_start = njt_current_msec;
-    cg->window /= 2;
-
-    if (cg->window < qc->tp.max_udp_payload_size * 2) {
-        cg->window = qc->tp.max_udp_payload_size * 2;
-    }
-
-    cg->ssthresh = cg->window;
+    cg->lost++;
 
-    njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
-                   "quic congestion lost win:%uz ss:%z if:%uz",
-                   cg->window, cg->ssthresh, cg->in_flight);
+    cg->ops->lost(c, f);
 
-done:
+    f->plen = 0;
 
     if (blocked && cg->in_flight < cg->window) {
         njt_post_event(&qc->push, &njt_posted_events);
@@ -0,0 +1,445 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ * Copyright (C) 2021-2023  TMLake(Beijing) Technology Co., Ltd.
+ */
+
+
+#include <njt_config.h>
+#include <njt_core.h>
+#include <njt_event.h>
+#include <njt_event_quic_connection.h>
+
+
+#if (NJT_HAVE_SENDMMSG)
+
+/*
+ * Datagrams of all connections of a worker are collected here and sent
+ * by a single posted event with sendmmsg(), a message per destination;
+ * packets to the same destination are coalesced with UDP_SEGMENT.
+ * Messages not sent as the socket is not ready stay queued and are
+ * retried by a timer; if the batch is still full, the sender gets
+ * NJT_AGAIN and reverts its packets, as with njt_quic_send().
+ */
+
+#define NJT_QUIC_BATCH_MSGS        64
+#define NJT_QUIC_BATCH_BUF_SIZE    (4 * NJT_QUIC_MAX_UDP_SEGMENT_BUF)
+#define NJT_QUIC_BATCH_RETRY_DELAY 10 /* ms, for EAGAIN on sendmmsg() */
+
+
+#if (NJT_HAVE_ADDRINFO_CMSG)
+#define NJT_QUIC_BATCH_CONTROL     (CMSG_SPACE(sizeof(uint16_t))              \
+                                    + CMSG_SPACE(sizeof(njt_addrinfo_t)))
+#else
+#define NJT_QUIC_BATCH_CONTROL     CMSG_SPACE(sizeof(uint16_t))
+#endif
+
+
+typedef struct {
+    njt_socket_t              fd;
+    u_char                   *data;
+    size_t                    len;
+    size_t                    segment;
+    njt_uint_t                nseg;
+    socklen_t                 socklen;
+    socklen_t                 local_socklen;
+    njt_sockaddr_t            sockaddr;
+    njt_sockaddr_t            local_sockaddr;
+} njt_quic_batch_msg_t;
+
+
+static njt_uint_t njt_quic_batch_coalesce(njt_quic_batch_msg_t *m,
+    njt_socket_t fd, size_t len, njt_uint_t nseg, size_t segment,
+    struct sockaddr *sockaddr, socklen_t socklen,
+    struct sockaddr *local_sockaddr, socklen_t local_socklen);
+static void njt_quic_batch_init_msghdr(njt_quic_batch_msg_t *m,
+    struct msghdr *msg, struct iovec *iov, char *control);
+static njt_uint_t njt_quic_batch_sendmmsg(njt_quic_batch_msg_t *msgs,
+    struct mmsghdr *hdrs, njt_uint_t n);
+static void njt_quic_batch_handler(njt_event_t *ev);
+
+
+static njt_quic_batch_msg_t  njt_quic_batch_msgs[NJT_QUIC_BATCH_MSGS];
+static njt_uint_t            njt_quic_batch_nmsgs;
+static u_char                njt_quic_batch_buf[NJT_QUIC_BATCH_BUF_SIZE];
+static size_t                njt_quic_batch_used;
+static njt_event_t           njt_quic_batch_event;
+
+
+ssize_t
+njt_quic_batch_send(njt_connection_t *c, u_char *buf, size_t len,
+    struct sockaddr *sockaddr, socklen_t socklen, size_t segment)
+{
+    socklen_t              local_socklen;
+    njt_uint_t             nseg;
+    njt_socket_t           fd;
+    struct sockaddr       *local_sockaddr;
+    njt_quic_batch_msg_t  *m;
+
+    if (c->udp && c->udp->real_sock != (njt_socket_t) -1) {
+        fd = c->udp->real_sock;
+
+    } else {
+        fd = c->fd;
+    }
+
+    local_sockaddr = NULL;
+    local_socklen = 0;
+
+#if (NJT_HAVE_ADDRINFO_CMSG)
+    if (c->listening && c->listening->wildcard && c->local_sockaddr) {
+        local_sockaddr = c->local_sockaddr;
+        local_socklen = c->local_socklen;
+    }
+#endif
+
+    nseg = (segment && len > segment) ? (len + segment - 1) / segment : 1;
+
+    if (njt_quic_batch_used + len > NJT_QUIC_BATCH_BUF_SIZE) {
+        njt_quic_batch_flush();
+
+        if (njt_quic_batch_used + len > NJT_QUIC_BATCH_BUF_SIZE) {
+            return NJT_AGAIN;
+        }
+    }
+
+    if (njt_quic_batch_nmsgs) {
+        m = &njt_quic_batch_msgs[njt_quic_batch_nmsgs - 1];
+
+        if (njt_quic_batch_coalesce(m, fd, len, nseg, segment,
+                                    sockaddr, socklen,
+                                    local_sockaddr, local_socklen))
+        {
+            /* the last message ends at the end of the used buffer */
+
+            njt_memcpy(m->data + m->len, buf, len);
+
+            m->len += len;
+            m->nseg += nseg;
+
+            goto done;
+        }
+    }
+
+    if (njt_quic_batch_nmsgs == NJT_QUIC_BATCH_MSGS) {
+        njt_quic_batch_flush();
+
+        if (njt_quic_batch_nmsgs == NJT_QUIC_BATCH_MSGS) {
+            return NJT_AGAIN;
+        }
+    }
+
+    m = &njt_quic_batch_msgs[njt_quic_batch_nmsgs++];
+
+    m->fd = fd;
+    m->data = njt_quic_batch_buf + njt_quic_batch_used;
+    m->len = len;
+    m->nseg = nseg;
+    m->segment = (nseg > 1) ? segment : (segment ? len : 0);
+
+    njt_memcpy(&m->sockaddr, sockaddr, socklen);
+    m->socklen = socklen;
+
+    if (local_sockaddr) {
+        njt_memcpy(&m->local_sockaddr, local_sockaddr, local_socklen);
+    }
+
+    m->local_socklen = local_socklen;
+
+    njt_memcpy(m->data, buf, len);
+
+done:
+
+    njt_quic_batch_used += len;
+
+    c->sent += len;
+
+    njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic batch len:%uz msgs:%ui segments:%ui",
+                   len, njt_quic_batch_nmsgs, m->nseg);
+
+    if (!njt_quic_batch_event.posted) {
+        njt_quic_batch_event.handler = njt_quic_batch_handler;
+        njt_quic_batch_event.log = njt_cycle->log;
+
+        njt_post_event(&njt_quic_batch_event, &njt_posted_events);
+    }
+
+    return len;
+}
+
+
+static njt_uint_t
+njt_quic_batch_coalesce(njt_quic_batch_msg_t *m, njt_socket_t fd, size_t len,
+    njt_uint_t nseg, size_t segment, struct sockaddr *sockaddr,
+    socklen_t socklen, struct sockaddr *local_sockaddr,
+    socklen_t local_socklen)
+{
+#if (NJT_HAVE_UDP_SEGMENT && NJT_HAVE_MSGHDR_MSG_CONTROL)
+
+    if (m->fd != fd || m->segment == 0 || segment == 0) {
+        return 0;
+    }
+
+    /* only the last segment may be shorter */
+
+    if (m->len % m->segment) {
+        return 0;
+    }
+
+    if (nseg > 1 ? segment != m->segment : len > m->segment) {
+        return 0;
+    }
+
+    if (m->nseg + nseg > NJT_QUIC_MAX_SEGMENTS
+        || m->len + len > NJT_QUIC_MAX_UDP_SEGMENT_BUF)
+    {
+        return 0;
+    }
+
+    if (njt_cmp_sockaddr(&m->sockaddr.sockaddr, m->socklen,
+                         sockaddr, socklen, 1)
+        != NJT_OK)
+    {
+        return 0;
+    }
+
+    if (m->local_socklen != local_socklen) {
+        return 0;
+    }
+
+    if (local_sockaddr
+        && njt_cmp_sockaddr(&m->local_sockaddr.sockaddr, m->local_socklen,
+                            local_sockaddr, local_socklen, 0)
+           != NJT_OK)
+    {
+        return 0;
+    }
+
+    return 1;
+
+#else
+
+    return 0;
+
+#endif
+}
+
+
+void
+njt_quic_batch_flush(void)
+{
+    size_t                 used;
+    njt_uint_t             i, j, k, n, sent;
+    njt_quic_batch_msg_t  *msgs;
+
+    static struct mmsghdr  hdrs[NJT_QUIC_BATCH_MSGS];
+    static struct iovec    iovs[NJT_QUIC_BATCH_MSGS];
+    static char            control[NJT_QUIC_BATCH_MSGS]
+                                  [NJT_QUIC_BATCH_CONTROL];
+
+    if (njt_quic_batch_nmsgs == 0) {
+        return;
+    }
+
+    njt_log_debug2(NJT_LOG_DEBUG_EVENT, njt_cycle->log, 0,
+                   "quic batch flush msgs:%ui bytes:%uz",
+                   njt_quic_batch_nmsgs, njt_quic_batch_used);
+
+    msgs = njt_quic_batch_msgs;
+
+    for (i = 0; i < njt_quic_batch_nmsgs; i++) {
+        njt_quic_batch_init_msghdr(&msgs[i], &hdrs[i].msg_hdr, &iovs[i],
+                                   control[i]);
+    }
+
+    /* sendmmsg() works on a single socket */
+
+    n = 0;
+    used = 0;
+
+    for (i = 0; i < njt_quic_batch_nmsgs; i = j) {
+
+        for (j = i + 1; j < njt_quic_batch_nmsgs; j++) {
+            if (msgs[j].fd != msgs[i].fd) {
+                break;
+            }
+        }
+
+        sent = njt_quic_batch_sendmmsg(&msgs[i], &hdrs[i], j - i);
+
+        /*
+         * keep the unsent tail of the socket at the start of the batch,
+         * moving messages and data only backwards over the ones sent,
+         * headers of the following sockets are not affected
+         */
+
+        for (k = i + sent; k < j; k++) {
+            njt_memmove(njt_quic_batch_buf + used, msgs[k].data, msgs[k].len);
+
+            msgs[n] = msgs[k];
+            msgs[n].data = njt_quic_batch_buf + used;
+
+            used += msgs[k].len;
+            n++;
+        }
+    }
+
+    njt_quic_batch_nmsgs = n;
+    njt_quic_batch_used = used;
+
+    if (n == 0) {
+        if (njt_quic_batch_event.timer_set) {
+            njt_del_timer(&njt_quic_batch_event);
+        }
+
+        return;
+    }
+
+    njt_log_debug2(NJT_LOG_DEBUG_EVENT, njt_cycle->log, 0,
+                   "quic batch kept msgs:%ui bytes:%uz", n, used);
+
+    if (!njt_quic_batch_event.timer_set) {
+        njt_quic_batch_event.handler = njt_quic_batch_handler;
+        njt_quic_batch_event.log = njt_cycle->log;
+        njt_quic_batch_event.cancelable = 1;
+
+        njt_add_timer(&njt_quic_batch_event, NJT_QUIC_BATCH_RETRY_DELAY);
+    }
+}
+
+
+static void
+njt_quic_batch_init_msghdr(njt_quic_batch_msg_t *m, struct msghdr *msg,
+    struct iovec *iov, char *control)
+{
+    size_t           clen;
+    struct cmsghdr  *cmsg;
+#if (NJT_HAVE_UDP_SEGMENT && NJT_HAVE_MSGHDR_MSG_CONTROL)
+    uint16_t        *valp;
+#endif
+
+    njt_memzero(msg, sizeof(struct msghdr));
+    njt_memzero(control, NJT_QUIC_BATCH_CONTROL);
+
+    iov->iov_base = m->data;
+    iov->iov_len = m->len;
+
+    msg->msg_iov = iov;
+    msg->msg_iovlen = 1;
+
+    msg->msg_name = &m->sockaddr.sockaddr;
+    msg->msg_namelen = m->socklen;
+
+    msg->msg_control = control;
+    msg->msg_controllen = NJT_QUIC_BATCH_CONTROL;
+
+    cmsg = CMSG_FIRSTHDR(msg);
+    clen = 0;
+
+#if (NJT_HAVE_UDP_SEGMENT && NJT_HAVE_MSGHDR_MSG_CONTROL)
+
+    if (m->nseg > 1) {
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+
+        valp = (void *) CMSG_DATA(cmsg);
+        *valp = m->segment;
+
+        clen += CMSG_SPACE(sizeof(uint16_t));
+
+        cmsg = CMSG_NXTHDR(msg, cmsg);
+    }
+
+#endif
+
+#if (NJT_HAVE_ADDRINFO_CMSG)
+
+    if (m->local_socklen) {
+        clen += njt_set_srcaddr_cmsg(cmsg, &m->local_sockaddr.sockaddr);
+    }
+
+#endif
+
+    msg->msg_controllen = clen;
+
+    if (clen == 0) {
+        msg->msg_control = NULL;
+    }
+}
+
+
+static njt_uint_t
+njt_quic_batch_sendmmsg(njt_quic_batch_msg_t *msgs, struct mmsghdr *hdrs,
+    njt_uint_t n)
+{
+    int          rc;
+    u_char       text[NJT_SOCKADDR_STRLEN];
+    size_t       len;
+    njt_err_t    err;
+    njt_uint_t   sent, level;
+
+    sent = 0;
+
+    while (sent < n) {
+
+        rc = sendmmsg(msgs[sent].fd, &hdrs[sent], n - sent, 0);
+
+        if (rc != -1) {
+            njt_log_debug2(NJT_LOG_DEBUG_EVENT, njt_cycle->log, 0,
+                           "sendmmsg: %d of %ui", rc, n - sent);
+
+            sent += rc;
+            continue;
+        }
+
+        err = njt_socket_errno;
+
+        if (err == NJT_EINTR) {
+            continue;
+        }
+
+        if (err == NJT_EAGAIN) {
+            njt_log_debug1(NJT_LOG_DEBUG_EVENT, njt_cycle->log, err,
+                           "sendmmsg() not ready, %ui messages kept",
+                           n - sent);
+            return sent;
+        }
+
+        /* the first message failed, the others are not sent yet */
+
+        switch (err) {
+        case NJT_ECONNREFUSED:
+        case NJT_ENETDOWN:
+        case NJT_ENETUNREACH:
+        case NJT_EHOSTDOWN:
+        case NJT_EHOSTUNREACH:
+            level = NJT_LOG_INFO;
+            break;
+
+        default:
+            level = NJT_LOG_ALERT;
+        }
+
+        len = njt_sock_ntop(&msgs[sent].sockaddr.sockaddr, msgs[sent].socklen,
+                            text, NJT_SOCKADDR_STRLEN, 1);
+
+        njt_log_error(level, njt_cycle->log, err,
+                      "sendmmsg() of %uz bytes to %*s failed",
+                      msgs[sent].len, len, text);
+
+        sent++;
+    }
+
+    return sent;
+}
+
+
+static void
+njt_quic_batch_handler(njt_event_t *ev)
+{
+    njt_quic_batch_flush();
+}
+
+#endif
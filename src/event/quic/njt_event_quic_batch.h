@@ -0,0 +1,24 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ * Copyright (C) 2021-2023  TMLake(Beijing) Technology Co., Ltd.
+ */
+
+
+#ifndef _NJT_EVENT_QUIC_BATCH_H_INCLUDED_
+#define _NJT_EVENT_QUIC_BATCH_H_INCLUDED_
+
+
+#include <njt_config.h>
+#include <njt_core.h>
+
+
+#if (NJT_HAVE_SENDMMSG)
+
+ssize_t njt_quic_batch_send(njt_connection_t *c, u_char *buf, size_t len,
+    struct sockaddr *sockaddr, socklen_t socklen, size_t segment);
+void njt_quic_batch_flush(void);
+
+#endif
+
+#endif /* _NJT_EVENT_QUIC_BATCH_H_INCLUDED_ */
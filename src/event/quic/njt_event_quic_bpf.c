@@ -12,6 +12,10 @@
 #define NJT_QUIC_BPF_VARNAME  "NJET_BPF_MAPS"
 #define NJT_QUIC_BPF_VARSEP    ';'
 #define NJT_QUIC_BPF_ADDRSEP   '#'
+#define NJT_QUIC_BPF_FDSEP     ','
+
+/* must match the slot mask in bpf/njt_quic_reuseport_helper.c */
+#define NJT_QUIC_BPF_SLOTS     1024
 
 
 #define njt_quic_bpf_get_conf(cycle)                                          \
@@ -28,6 +32,7 @@
 typedef struct {
     njt_queue_t           queue;
     int                   map_fd;
+    int                   slots_fd;
 
     struct sockaddr      *sockaddr;
     socklen_t             socklen;
@@ -55,11 +60,21 @@ static njt_quic_sock_group_t *njt_quic_bpf_alloc_group(njt_cycle_t *cycle,
     struct sockaddr *sa, socklen_t socklen);
 static njt_quic_sock_group_t *njt_quic_bpf_create_group(njt_cycle_t *cycle,
     njt_listening_t *ls);
+static int njt_quic_bpf_create_map(njt_cycle_t *cycle, enum bpf_map_type type,
+    int key_size, njt_uint_t size);
+static njt_int_t njt_quic_bpf_attach_program(njt_cycle_t *cycle,
+    njt_quic_sock_group_t *grp, njt_listening_t *ls);
 static njt_quic_sock_group_t *njt_quic_bpf_get_group(njt_cycle_t *cycle,
     njt_listening_t *ls);
 static njt_int_t njt_quic_bpf_group_add_socket(njt_cycle_t *cycle,
     njt_listening_t *ls);
 static uint64_t njt_quic_bpf_socket_key(njt_fd_t fd, njt_log_t *log);
+static njt_listening_t *njt_quic_bpf_find_socket(njt_cycle_t *cycle,
+    njt_quic_sock_group_t *grp, njt_uint_t worker);
+static njt_int_t njt_quic_bpf_add_worker_sockets(njt_cycle_t *cycle,
+    njt_quic_sock_group_t *grp, njt_uint_t n);
+static njt_int_t njt_quic_bpf_set_slots(njt_cycle_t *cycle,
+    njt_quic_sock_group_t *grp, njt_uint_t n);
 
 static njt_int_t njt_quic_bpf_export_maps(njt_cycle_t *cycle);
 static njt_int_t njt_quic_bpf_import_maps(njt_cycle_t *cycle);
@@ -125,11 +140,13 @@ njt_quic_bpf_create_conf(njt_cycle_t *cycle)
 static njt_int_t
 njt_quic_bpf_module_init(njt_cycle_t *cycle)
 {
-    njt_uint_t            i;
-    njt_listening_t      *ls;
-    njt_core_conf_t      *ccf;
-    njt_pool_cleanup_t   *cln;
-    njt_quic_bpf_conf_t  *bcf;
+    njt_uint_t              i;
+    njt_queue_t            *q;
+    njt_listening_t        *ls;
+    njt_core_conf_t        *ccf;
+    njt_pool_cleanup_t     *cln;
+    njt_quic_bpf_conf_t    *bcf;
+    njt_quic_sock_group_t  *grp;
 
     if (njt_test_config) {
         /*
@@ -144,7 +161,12 @@ njt_quic_bpf_module_init(njt_cycle_t *cycle)
 
     njt_conf_init_value(bcf->enabled, 0);
 
-    bcf->map_size = ccf->worker_processes * 4;
+    /*
+     * the map is inherited on reload and cannot be resized, so it is sized
+     * for sockets of all possible processes: workers of the current cycle,
+     * draining workers of previous cycles, and workers added at runtime
+     */
+    bcf->map_size = NJT_MAX_PROCESSES;
 
     cln = njt_pool_cleanup_add(cycle->pool, 0);
     if (cln == NULL) {
@@ -174,6 +196,25 @@ njt_quic_bpf_module_init(njt_cycle_t *cycle)
         goto failed;
     }
 
+    /*
+     * new connections are passed to sockets of this cycle only, while
+     * sockets of previous cycles stay in the sockmap and keep receiving
+     * packets of existing connections until their workers exit
+     */
+
+    for (q = njt_queue_head(&bcf->groups);
+         q != njt_queue_sentinel(&bcf->groups);
+         q = njt_queue_next(q))
+    {
+        grp = njt_queue_data(q, njt_quic_sock_group_t, queue);
+
+        if (njt_quic_bpf_set_slots(cycle, grp, ccf->worker_processes)
+            != NJT_OK)
+        {
+            goto failed;
+        }
+    }
+
     return NJT_OK;
 
 failed:
@@ -219,6 +260,10 @@ njt_quic_bpf_cleanup(void *data)
         grp = njt_queue_data(q, njt_quic_sock_group_t, queue);
 
         njt_quic_bpf_close(njt_cycle->log, grp->map_fd, "map");
+
+        if (grp->slots_fd != -1) {
+            njt_quic_bpf_close(njt_cycle->log, grp->slots_fd, "slots map");
+        }
     }
 }
 
@@ -280,6 +325,9 @@ njt_quic_bpf_alloc_group(njt_cycle_t *cycle, struct sockaddr *sa,
     }
     njt_memcpy(grp->sockaddr, sa, socklen);
 
+    grp->map_fd = -1;
+    grp->slots_fd = -1;
+
     njt_queue_insert_tail(&bcf->groups, &grp->queue);
 
     return grp;
@@ -289,7 +337,6 @@ njt_quic_bpf_alloc_group(njt_cycle_t *cycle, struct sockaddr *sa,
 static njt_quic_sock_group_t *
 njt_quic_bpf_create_group(njt_cycle_t *cycle, njt_listening_t *ls)
 {
-    int                     progfd, failed, flags, rc;
     njt_quic_bpf_conf_t    *bcf;
     njt_quic_sock_group_t  *grp;
 
@@ -304,14 +351,46 @@ njt_quic_bpf_create_group(njt_cycle_t *cycle, njt_listening_t *ls)
         return NULL;
     }
 
-    grp->map_fd = njt_bpf_map_create(cycle->log, BPF_MAP_TYPE_SOCKHASH,
-                                     sizeof(uint64_t), sizeof(uint64_t),
-                                     bcf->map_size, 0);
+    grp->map_fd = njt_quic_bpf_create_map(cycle, BPF_MAP_TYPE_SOCKHASH,
+                                          sizeof(uint64_t), bcf->map_size);
     if (grp->map_fd == -1) {
         goto failed;
     }
 
-    flags = fcntl(grp->map_fd, F_GETFD);
+    if (njt_quic_bpf_attach_program(cycle, grp, ls) != NJT_OK) {
+        goto failed;
+    }
+
+    njt_log_debug2(NJT_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "quic bpf sockmap created fd:%d slots fd:%d",
+                   grp->map_fd, grp->slots_fd);
+    return grp;
+
+failed:
+
+    if (grp->map_fd != -1) {
+        njt_quic_bpf_close(cycle->log, grp->map_fd, "map");
+    }
+
+    njt_queue_remove(&grp->queue);
+
+    return NULL;
+}
+
+
+static int
+njt_quic_bpf_create_map(njt_cycle_t *cycle, enum bpf_map_type type,
+    int key_size, njt_uint_t size)
+{
+    int  fd, flags;
+
+    fd = njt_bpf_map_create(cycle->log, type, key_size, sizeof(uint64_t),
+                            size, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    flags = fcntl(fd, F_GETFD);
     if (flags == -1) {
         njt_log_error(NJT_LOG_EMERG, cycle->log, errno,
                       "quic bpf getfd failed");
@@ -321,15 +400,45 @@ njt_quic_bpf_create_group(njt_cycle_t *cycle, njt_listening_t *ls)
     /* need to inherit map during binary upgrade after exec */
     flags &= ~FD_CLOEXEC;
 
-    rc = fcntl(grp->map_fd, F_SETFD, flags);
-    if (rc == -1) {
+    if (fcntl(fd, F_SETFD, flags) == -1) {
         njt_log_error(NJT_LOG_EMERG, cycle->log, errno,
                       "quic bpf setfd failed");
         goto failed;
     }
 
+    return fd;
+
+failed:
+
+    njt_quic_bpf_close(cycle->log, fd, "map");
+
+    return -1;
+}
+
+
+static njt_int_t
+njt_quic_bpf_attach_program(njt_cycle_t *cycle, njt_quic_sock_group_t *grp,
+    njt_listening_t *ls)
+{
+    int  progfd, failed;
+
+    /*
+     * the slots map is created along with the program: a group inherited
+     * from a binary without it gets both, the sockmap is kept as is
+     */
+
+    grp->slots_fd = njt_quic_bpf_create_map(cycle,
+                                            BPF_MAP_TYPE_SOCKMAP,
+                                            sizeof(uint32_t),
+                                            NJT_QUIC_BPF_SLOTS);
+    if (grp->slots_fd == -1) {
+        return NJT_ERROR;
+    }
+
     njt_bpf_program_link(&njt_quic_reuseport_helper,
                          "njt_quic_sockmap", grp->map_fd);
+    njt_bpf_program_link(&njt_quic_reuseport_helper,
+                         "njt_quic_slots", grp->slots_fd);
 
     progfd = njt_bpf_load_program(cycle->log, &njt_quic_reuseport_helper);
     if (progfd < 0) {
@@ -353,19 +462,14 @@ njt_quic_bpf_create_group(njt_cycle_t *cycle, njt_listening_t *ls)
         goto failed;
     }
 
-    njt_log_debug1(NJT_LOG_DEBUG_EVENT, cycle->log, 0,
-                   "quic bpf sockmap created fd:%d", grp->map_fd);
-    return grp;
+    return NJT_OK;
 
 failed:
 
-    if (grp->map_fd != -1) {
-        njt_quic_bpf_close(cycle->log, grp->map_fd, "map");
-    }
-
-    njt_queue_remove(&grp->queue);
+    njt_quic_bpf_close(cycle->log, grp->slots_fd, "slots map");
+    grp->slots_fd = -1;
 
-    return NULL;
+    return NJT_ERROR;
 }
 
 
@@ -379,6 +483,15 @@ njt_quic_bpf_get_group(njt_cycle_t *cycle, njt_listening_t *ls)
 
     grp = njt_quic_bpf_find_group(bcf, ls);
     if (grp) {
+
+        if (grp->slots_fd == -1 && bcf->enabled) {
+            /* the map is inherited from a binary without slots support */
+
+            if (njt_quic_bpf_attach_program(cycle, grp, ls) != NJT_OK) {
+                return NULL;
+            }
+        }
+
         return grp;
     }
 
@@ -412,14 +525,37 @@ njt_quic_bpf_get_group(njt_cycle_t *cycle, njt_listening_t *ls)
                    "quic bpf sockmap fd duplicated old:%d new:%d",
                    ogrp->map_fd, grp->map_fd);
 
+    if (ogrp->slots_fd == -1) {
+        if (njt_quic_bpf_attach_program(cycle, grp, ls) != NJT_OK) {
+            goto failed;
+        }
+
+        return grp;
+    }
+
+    grp->slots_fd = dup(ogrp->slots_fd);
+    if (grp->slots_fd == -1) {
+        njt_log_error(NJT_LOG_EMERG, cycle->log, njt_errno,
+                      "quic bpf failed to duplicate bpf map descriptor");
+        goto failed;
+    }
+
     return grp;
+
+failed:
+
+    njt_quic_bpf_close(cycle->log, grp->map_fd, "map");
+
+    njt_queue_remove(&grp->queue);
+
+    return NULL;
 }
 
 
 static njt_int_t
 njt_quic_bpf_group_add_socket(njt_cycle_t *cycle,  njt_listening_t *ls)
 {
-    uint64_t                cookie;
+    uint64_t                cookie, fd;
     njt_quic_bpf_conf_t    *bcf;
     njt_quic_sock_group_t  *grp;
 
@@ -442,8 +578,10 @@ njt_quic_bpf_group_add_socket(njt_cycle_t *cycle,  njt_listening_t *ls)
         return NJT_ERROR;
     }
 
+    fd = ls->fd;
+
     /* map[cookie] = socket; for use in kernel helper */
-    if (njt_bpf_map_update(grp->map_fd, &cookie, &ls->fd, BPF_ANY) == -1) {
+    if (njt_bpf_map_update(grp->map_fd, &cookie, &fd, BPF_ANY) == -1) {
         njt_log_error(NJT_LOG_EMERG, cycle->log, njt_errno,
                       "quic bpf failed to update socket map key=%xL", cookie);
         return NJT_ERROR;
@@ -479,6 +617,204 @@ njt_quic_bpf_socket_key(njt_fd_t fd, njt_log_t *log)
 }
 
 
+njt_int_t
+njt_quic_bpf_update_workers(njt_cycle_t *cycle, njt_uint_t n)
+{
+    njt_int_t               rc;
+    njt_queue_t            *q;
+    njt_quic_bpf_conf_t    *bcf;
+    njt_quic_sock_group_t  *grp;
+
+    bcf = njt_quic_bpf_get_conf(cycle);
+
+    if (!bcf->enabled) {
+        return NJT_OK;
+    }
+
+    rc = NJT_OK;
+
+    for (q = njt_queue_head(&bcf->groups);
+         q != njt_queue_sentinel(&bcf->groups);
+         q = njt_queue_next(q))
+    {
+        grp = njt_queue_data(q, njt_quic_sock_group_t, queue);
+
+        /*
+         * workers that fail to get a socket still can serve other
+         * listening sockets, so slots are updated anyway
+         */
+
+        if (njt_quic_bpf_add_worker_sockets(cycle, grp, n) != NJT_OK) {
+            rc = NJT_ERROR;
+        }
+
+        if (njt_quic_bpf_set_slots(cycle, grp, n) != NJT_OK) {
+            rc = NJT_ERROR;
+        }
+    }
+
+    return rc;
+}
+
+
+static njt_listening_t *
+njt_quic_bpf_find_socket(njt_cycle_t *cycle, njt_quic_sock_group_t *grp,
+    njt_uint_t worker)
+{
+    njt_uint_t        i;
+    njt_listening_t  *ls;
+
+    ls = cycle->listening.elts;
+
+    for (i = 0; i < cycle->listening.nelts; i++) {
+
+        if (!ls[i].quic || !ls[i].reuseport || ls[i].worker != worker
+            || ls[i].fd == (njt_socket_t) -1)
+        {
+            continue;
+        }
+
+        if (njt_cmp_sockaddr(ls[i].sockaddr, ls[i].socklen,
+                             grp->sockaddr, grp->socklen, 1)
+            == NJT_OK)
+        {
+            return &ls[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+static njt_int_t
+njt_quic_bpf_add_worker_sockets(njt_cycle_t *cycle,
+    njt_quic_sock_group_t *grp, njt_uint_t n)
+{
+    njt_uint_t        worker;
+    njt_cycle_t       tmp;
+    njt_listening_t  *ls, ols;
+
+    /*
+     * sockets are cloned for the configured number of workers only;
+     * workers added at runtime get their sockets here, before they are
+     * spawned, and keep them until the next reload
+     */
+
+    ls = njt_quic_bpf_find_socket(cycle, grp, 0);
+    if (ls == NULL) {
+        return NJT_OK;
+    }
+
+    ols = *ls;
+
+    for (worker = 1; worker < n; worker++) {
+
+        if (njt_quic_bpf_find_socket(cycle, grp, worker)) {
+            continue;
+        }
+
+        ls = njt_array_push(&cycle->listening);
+        if (ls == NULL) {
+            return NJT_ERROR;
+        }
+
+        *ls = ols;
+
+        ls->fd = (njt_socket_t) -1;
+        ls->worker = worker;
+        ls->ignore = 0;
+        ls->inherited = 0;
+        ls->add_reuseport = 0;
+        ls->previous = NULL;
+        ls->connection = NULL;
+
+        /* open and configure just this socket */
+
+        tmp = *cycle;
+        tmp.listening.elts = ls;
+        tmp.listening.nelts = 1;
+
+        if (njt_open_listening_sockets(&tmp) != NJT_OK) {
+            cycle->listening.nelts--;
+            return NJT_ERROR;
+        }
+
+        njt_configure_listening_sockets(&tmp);
+
+        if (njt_quic_bpf_group_add_socket(cycle, ls) != NJT_OK) {
+            return NJT_ERROR;
+        }
+
+        njt_log_error(NJT_LOG_NOTICE, cycle->log, 0,
+                      "quic bpf opened socket %V for worker %ui",
+                      &ls->addr_text, worker);
+    }
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_quic_bpf_set_slots(njt_cycle_t *cycle, njt_quic_sock_group_t *grp,
+    njt_uint_t n)
+{
+    uint32_t          slot;
+    uint64_t          fd;
+    njt_uint_t        i, nfds;
+    njt_socket_t     *fds;
+    njt_listening_t  *ls;
+
+    if (grp->slots_fd == -1) {
+        return NJT_OK;
+    }
+
+    fds = njt_alloc(n * sizeof(njt_socket_t), cycle->log);
+    if (fds == NULL) {
+        return NJT_ERROR;
+    }
+
+    nfds = 0;
+
+    for (i = 0; i < n; i++) {
+        ls = njt_quic_bpf_find_socket(cycle, grp, i);
+
+        if (ls) {
+            fds[nfds++] = ls->fd;
+        }
+    }
+
+    if (nfds == 0) {
+        njt_free(fds);
+        return NJT_OK;
+    }
+
+    /*
+     * every slot is overwritten, so sockets of exited or exiting workers
+     * no longer get new connections; each worker gets an equal share
+     */
+
+    for (slot = 0; slot < NJT_QUIC_BPF_SLOTS; slot++) {
+        fd = fds[slot % nfds];
+
+        if (njt_bpf_map_update(grp->slots_fd, &slot, &fd, BPF_ANY) == -1) {
+            njt_log_error(NJT_LOG_EMERG, cycle->log, njt_errno,
+                          "quic bpf failed to update slots map slot=%uD",
+                          slot);
+            njt_free(fds);
+            return NJT_ERROR;
+        }
+    }
+
+    njt_log_debug3(NJT_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "quic bpf slots fd:%d spread over %ui of %ui workers",
+                   grp->slots_fd, nfds, n);
+
+    njt_free(fds);
+
+    return NJT_OK;
+}
+
+
 static njt_int_t
 njt_quic_bpf_export_maps(njt_cycle_t *cycle)
 {
@@ -511,12 +847,17 @@ njt_quic_bpf_export_maps(njt_cycle_t *cycle)
              */
 
             njt_quic_bpf_close(cycle->log, grp->map_fd, "map");
+
+            if (grp->slots_fd != -1) {
+                njt_quic_bpf_close(cycle->log, grp->slots_fd, "slots map");
+            }
+
             njt_queue_remove(&grp->queue);
 
             continue;
         }
 
-        len += NJT_INT32_LEN + 1 + NJT_SOCKADDR_STRLEN + 1;
+        len += 2 * (NJT_INT32_LEN + 1) + NJT_SOCKADDR_STRLEN + 1;
     }
 
     len++;
@@ -535,7 +876,8 @@ njt_quic_bpf_export_maps(njt_cycle_t *cycle)
     {
         grp = njt_queue_data(q, njt_quic_sock_group_t, queue);
 
-        p = njt_sprintf(p, "%ud", grp->map_fd);
+        p = njt_sprintf(p, "%ud%c%ud", grp->map_fd, NJT_QUIC_BPF_FDSEP,
+                        grp->slots_fd);
 
         *p++ = NJT_QUIC_BPF_ADDRSEP;
 
@@ -562,8 +904,8 @@ njt_quic_bpf_export_maps(njt_cycle_t *cycle)
 static njt_int_t
 njt_quic_bpf_import_maps(njt_cycle_t *cycle)
 {
-    int                     s;
-    u_char                 *inherited, *p, *v;
+    int                     s, slots;
+    u_char                 *inherited, *p, *v, *fdsep;
     njt_uint_t              in_fd;
     njt_addr_t              tmp;
     njt_quic_bpf_conf_t    *bcf;
@@ -579,6 +921,7 @@ njt_quic_bpf_import_maps(njt_cycle_t *cycle)
 
 #if (NJT_SUPPRESS_WARN)
     s = -1;
+    slots = -1;
 #endif
 
     in_fd = 1;
@@ -596,8 +939,20 @@ njt_quic_bpf_import_maps(njt_cycle_t *cycle)
             }
             in_fd = 0;
 
-            s = njt_atoi(v, p - v);
-            if (s == NJT_ERROR) {
+            /* "map,slots" or just "map" if exported by an older binary */
+
+            fdsep = njt_strlchr(v, p, NJT_QUIC_BPF_FDSEP);
+
+            if (fdsep) {
+                s = njt_atoi(v, fdsep - v);
+                slots = njt_atoi(fdsep + 1, p - fdsep - 1);
+
+            } else {
+                s = njt_atoi(v, p - v);
+                slots = -1;
+            }
+
+            if (s == NJT_ERROR || (fdsep && slots == NJT_ERROR)) {
                 njt_log_error(NJT_LOG_EMERG, cycle->log, 0,
                               "quic bpf failed to parse inherited map fd");
                 return NJT_ERROR;
@@ -622,6 +977,7 @@ njt_quic_bpf_import_maps(njt_cycle_t *cycle)
             }
 
             grp->map_fd = s;
+            grp->slots_fd = slots;
 
             if (njt_parse_addr_port(cycle->pool, &tmp, v, p - v)
                 != NJT_OK)
@@ -632,6 +988,11 @@ njt_quic_bpf_import_maps(njt_cycle_t *cycle)
 
                 njt_quic_bpf_close(cycle->log, s, "inherited map");
 
+                if (slots != -1) {
+                    njt_quic_bpf_close(cycle->log, slots,
+                                       "inherited slots map");
+                }
+
                 return NJT_ERROR;
             }
 
@@ -642,10 +1003,10 @@ njt_quic_bpf_import_maps(njt_cycle_t *cycle)
 
             njt_queue_insert_tail(&bcf->groups, &grp->queue);
 
-            njt_log_debug3(NJT_LOG_DEBUG_EVENT, cycle->log, 0,
+            njt_log_debug4(NJT_LOG_DEBUG_EVENT, cycle->log, 0,
                            "quic bpf sockmap inherited with "
-                           "fd:%d address:%*s",
-                           grp->map_fd, p - v, v);
+                           "fd:%d slots fd:%d address:%*s",
+                           grp->map_fd, grp->slots_fd, p - v, v);
             v = p + 1;
             break;
 
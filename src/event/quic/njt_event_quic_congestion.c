@@ -0,0 +1,980 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ * Copyright (C) 2021-2023  TMLake(Beijing) Technology Co., Ltd.
+ */
+
+
+#include <njt_config.h>
+#include <njt_core.h>
+#include <njt_event.h>
+#include <njt_event_quic_connection.h>
+
+
+/* RFC 9002, 7.2. Initial and Minimum Congestion Window */
+#define NJT_QUIC_INITIAL_WINDOW(mss)                                          \
+    njt_min(10 * (mss), njt_max(2 * (mss), 14720))
+#define NJT_QUIC_MIN_WINDOW(mss)             (2 * (mss))
+
+/* RFC 9002, 7.7. Pacing: N, in percents */
+#define NJT_QUIC_PACING_GAIN_SS              200
+#define NJT_QUIC_PACING_GAIN_CA              125
+
+#define NJT_QUIC_PACING_QUANTUM              2    /* ms of data in a burst */
+#define NJT_QUIC_PACING_MIN_BURST            10   /* packets */
+
+/* RFC 9438, 4.6, 5.1: beta_cubic and C, in percents */
+#define NJT_QUIC_CUBIC_BETA                  70
+#define NJT_QUIC_CUBIC_C                     40
+#define NJT_QUIC_CUBIC_ALPHA                 53   /* 3 * (1 - b) / (1 + b) */
+#define NJT_QUIC_CUBIC_MAX_T                 65535 /* ms */
+
+#define NJT_QUIC_BBR_STARTUP                 0
+#define NJT_QUIC_BBR_DRAIN                   1
+#define NJT_QUIC_BBR_PROBE_BW                2
+#define NJT_QUIC_BBR_PROBE_RTT               3
+
+/* gains are in percents */
+#define NJT_QUIC_BBR_STARTUP_GAIN            277  /* 2 / ln(2) */
+#define NJT_QUIC_BBR_DRAIN_GAIN              36   /* 1 / startup gain */
+#define NJT_QUIC_BBR_CWND_GAIN               200
+#define NJT_QUIC_BBR_BETA                    70
+#define NJT_QUIC_BBR_LOSS_THRESH             2
+#define NJT_QUIC_BBR_LOSS_EVENTS             3
+#define NJT_QUIC_BBR_FULL_BW_THRESH          125
+#define NJT_QUIC_BBR_FULL_BW_COUNT           3
+#define NJT_QUIC_BBR_BW_ROUNDS               5
+#define NJT_QUIC_BBR_MIN_RTT_INTERVAL        5000 /* ms */
+#define NJT_QUIC_BBR_PROBE_RTT_TIME          200  /* ms */
+#define NJT_QUIC_BBR_MIN_PACKETS             4
+#define NJT_QUIC_BBR_CYCLE_LEN               8
+
+
+static void njt_quic_set_pacing_rate(njt_connection_t *c, njt_uint_t gain);
+
+static void njt_quic_newreno_init(njt_connection_t *c);
+static void njt_quic_newreno_ack(njt_connection_t *c, njt_quic_frame_t *f);
+static void njt_quic_newreno_lost(njt_connection_t *c, njt_quic_frame_t *f);
+static void njt_quic_newreno_persistent(njt_connection_t *c);
+
+static void njt_quic_cubic_init(njt_connection_t *c);
+static void njt_quic_cubic_ack(njt_connection_t *c, njt_quic_frame_t *f);
+static void njt_quic_cubic_lost(njt_connection_t *c, njt_quic_frame_t *f);
+static void njt_quic_cubic_persistent(njt_connection_t *c);
+static uint64_t njt_quic_cbrt(uint64_t n);
+
+static void njt_quic_bbr_init(njt_connection_t *c);
+static void njt_quic_bbr_ack(njt_connection_t *c, njt_quic_frame_t *f);
+static void njt_quic_bbr_lost(njt_connection_t *c, njt_quic_frame_t *f);
+static void njt_quic_bbr_persistent(njt_connection_t *c);
+static void njt_quic_bbr_update_model(njt_connection_t *c,
+    njt_quic_frame_t *f, njt_uint_t round_start);
+static void njt_quic_bbr_update_state(njt_connection_t *c);
+static void njt_quic_bbr_set_window(njt_connection_t *c, njt_quic_frame_t *f);
+static uint64_t njt_quic_bbr_max_bw(njt_quic_bbr_t *bbr);
+static size_t njt_quic_bbr_bdp(njt_quic_connection_t *qc,
+    njt_quic_bbr_t *bbr, njt_uint_t gain);
+
+
+static njt_quic_congestion_ops_t  njt_quic_newreno = {
+    njt_string("newreno"),
+    njt_quic_newreno_init,
+    njt_quic_newreno_ack,
+    njt_quic_newreno_lost,
+    njt_quic_newreno_persistent
+};
+
+
+static njt_quic_congestion_ops_t  njt_quic_cubic = {
+    njt_string("cubic"),
+    njt_quic_cubic_init,
+    njt_quic_cubic_ack,
+    njt_quic_cubic_lost,
+    njt_quic_cubic_persistent
+};
+
+
+static njt_quic_congestion_ops_t  njt_quic_bbr = {
+    njt_string("bbr"),
+    njt_quic_bbr_init,
+    njt_quic_bbr_ack,
+    njt_quic_bbr_lost,
+    njt_quic_bbr_persistent
+};
+
+
+static njt_quic_congestion_ops_t  *njt_quic_congestion_ops[] = {
+    &njt_quic_newreno,                     /* NJT_QUIC_CC_NEWRENO */
+    &njt_quic_cubic,                       /* NJT_QUIC_CC_CUBIC */
+    &njt_quic_bbr                          /* NJT_QUIC_CC_BBR */
+};
+
+
+/* PROBE_BW gain cycle: probe up, drain the queue, then cruise */
+static njt_uint_t  njt_quic_bbr_cycle_gain[NJT_QUIC_BBR_CYCLE_LEN] = {
+    125, 75, 100, 100, 100, 100, 100, 100
+};
+
+
+void
+njt_quic_congestion_init(njt_connection_t *c)
+{
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    /* counters survive a reset on a new path */
+
+    cg->in_flight = 0;
+    cg->window = NJT_QUIC_INITIAL_WINDOW(qc->path->mtu);
+    cg->ssthresh = (size_t) -1;
+    cg->recovery_start = njt_current_msec;
+
+    cg->delivered = 0;
+    cg->delivered_time = njt_current_msec;
+    cg->app_limited = 0;
+
+    njt_memzero(&cg->u, sizeof(cg->u));
+
+    cg->ops = njt_quic_congestion_ops[qc->conf->congestion_control];
+    cg->ops->init(c);
+
+    /* the initial window is sent at once */
+    cg->pacing_budget = cg->window;
+    cg->pacing_time = njt_current_msec;
+
+    njt_log_debug2(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic congestion %V init win:%uz",
+                   &cg->ops->name, cg->window);
+}
+
+
+void
+njt_quic_congestion_sent(njt_connection_t *c, njt_quic_frame_t *f)
+{
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    if (f->plen == 0) {
+        return;
+    }
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    cg->in_flight += f->plen;
+    cg->sent++;
+
+    /* delivery state for rate samples, taken when the packet is acked */
+    f->delivered = cg->delivered;
+    f->delivered_time = cg->delivered_time;
+    f->app_limited = cg->app_limited;
+
+    cg->pacing_budget -= njt_min(cg->pacing_budget, f->plen);
+}
+
+
+void
+njt_quic_congestion_stats(njt_connection_t *c, njt_quic_congestion_stats_t *st)
+{
+    njt_connection_t       *pc;
+    njt_quic_connection_t  *qc;
+
+    pc = c->quic ? c->quic->parent : c;
+    qc = njt_quic_get_connection(pc);
+
+    st->cwnd = qc->congestion.window;
+    st->in_flight = qc->congestion.in_flight;
+    st->rtt = qc->avg_rtt;
+    st->rttvar = qc->rttvar;
+    st->min_rtt = (qc->min_rtt == NJT_TIMER_INFINITE) ? 0 : qc->min_rtt;
+    st->sent = qc->congestion.sent;
+    st->lost = qc->congestion.lost;
+    st->pacing_rate = qc->conf->pacing ? qc->congestion.pacing_rate : 0;
+}
+
+
+void
+njt_quic_pacing_refill(njt_connection_t *c)
+{
+    size_t                  burst;
+    uint64_t                budget;
+    njt_msec_t              elapsed;
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    if (!qc->conf->pacing || cg->pacing_rate == 0) {
+        cg->pacing_budget = NJT_MAX_SIZE_T_VALUE;
+        return;
+    }
+
+    elapsed = njt_current_msec - cg->pacing_time;
+
+    if (elapsed == 0) {
+        return;
+    }
+
+    cg->pacing_time = njt_current_msec;
+
+    /* a burst fits into a few GSO segments, but never exceeds ~2ms of data */
+
+    burst = njt_max(cg->pacing_rate * NJT_QUIC_PACING_QUANTUM / 1000,
+                    NJT_QUIC_PACING_MIN_BURST * qc->path->mtu);
+
+    if (elapsed >= 1000) {
+        cg->pacing_budget = burst;
+        return;
+    }
+
+    budget = cg->pacing_budget + cg->pacing_rate * elapsed / 1000;
+
+    cg->pacing_budget = njt_min(budget, burst);
+}
+
+
+void
+njt_quic_pacing_schedule(njt_connection_t *c)
+{
+    njt_msec_t              delay;
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    if (cg->pacing_budget || cg->in_flight >= cg->window) {
+        return;
+    }
+
+    /* wake up when the next full packet may be sent */
+
+    delay = qc->path->mtu * 1000 / cg->pacing_rate;
+    delay = njt_max(delay, 1);
+
+    if (qc->push.timer_set
+        && (njt_msec_int_t) (qc->push.timer.key - njt_current_msec - delay)
+           <= 0)
+    {
+        return;
+    }
+
+    njt_log_debug2(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic pacing delay:%M rate:%uL", delay, cg->pacing_rate);
+
+    njt_add_timer(&qc->push, delay);
+}
+
+
+static void
+njt_quic_set_pacing_rate(njt_connection_t *c, njt_uint_t gain)
+{
+    njt_msec_t              rtt;
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    rtt = njt_max(qc->avg_rtt, 1);
+
+    cg->pacing_rate = (uint64_t) cg->window * gain * 10 / rtt;
+}
+
+
+static void
+njt_quic_newreno_init(njt_connection_t *c)
+{
+    njt_quic_set_pacing_rate(c, NJT_QUIC_PACING_GAIN_SS);
+}
+
+
+static void
+njt_quic_newreno_ack(njt_connection_t *c, njt_quic_frame_t *f)
+{
+    njt_msec_t              timer;
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    timer = f->send_time - cg->recovery_start;
+
+    if ((njt_msec_int_t) timer <= 0) {
+        njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic congestion ack recovery win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+
+        return;
+    }
+
+    if (cg->window < cg->ssthresh) {
+        cg->window += f->plen;
+
+        njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic congestion slow start win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+
+        njt_quic_set_pacing_rate(c, NJT_QUIC_PACING_GAIN_SS);
+
+    } else {
+        cg->window += qc->path->mtu * f->plen / cg->window;
+
+        njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic congestion avoidance win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+
+        njt_quic_set_pacing_rate(c, NJT_QUIC_PACING_GAIN_CA);
+    }
+
+    /* prevent recovery_start from wrapping */
+
+    timer = cg->recovery_start - njt_current_msec + qc->tp.max_idle_timeout * 2;
+
+    if ((njt_msec_int_t) timer < 0) {
+        cg->recovery_start = njt_current_msec - qc->tp.max_idle_timeout * 2;
+    }
+}
+
+
+static void
+njt_quic_newreno_lost(njt_connection_t *c, njt_quic_frame_t *f)
+{
+    njt_msec_t              timer;
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    timer = f->send_time - cg->recovery_start;
+
+    if ((njt_msec_int_t) timer <= 0) {
+        njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic congestion lost recovery win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+
+        return;
+    }
+
+    cg->recovery_start = njt_current_msec;
+    cg->window /= 2;
+
+    if (cg->window < NJT_QUIC_MIN_WINDOW(qc->path->mtu)) {
+        cg->window = NJT_QUIC_MIN_WINDOW(qc->path->mtu);
+    }
+
+    cg->ssthresh = cg->window;
+
+    njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic congestion lost win:%uz ss:%z if:%uz",
+                   cg->window, cg->ssthresh, cg->in_flight);
+
+    njt_quic_set_pacing_rate(c, NJT_QUIC_PACING_GAIN_CA);
+}
+
+
+static void
+njt_quic_newreno_persistent(njt_connection_t *c)
+{
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    cg->recovery_start = njt_current_msec;
+    cg->window = NJT_QUIC_MIN_WINDOW(qc->path->mtu);
+
+    njt_quic_set_pacing_rate(c, NJT_QUIC_PACING_GAIN_CA);
+}
+
+
+static void
+njt_quic_cubic_init(njt_connection_t *c)
+{
+    njt_quic_set_pacing_rate(c, NJT_QUIC_PACING_GAIN_SS);
+}
+
+
+static void
+njt_quic_cubic_ack(njt_connection_t *c, njt_quic_frame_t *f)
+{
+    size_t                  mss, target;
+    uint64_t                d, delta;
+    njt_msec_t              timer, t;
+    njt_quic_cubic_t       *cubic;
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+    cubic = &cg->u.cubic;
+
+    timer = f->send_time - cg->recovery_start;
+
+    if ((njt_msec_int_t) timer <= 0) {
+        njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic cubic ack recovery win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+
+        return;
+    }
+
+    mss = qc->path->mtu;
+
+    if (cg->window < cg->ssthresh) {
+        cg->window += f->plen;
+
+        njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic cubic slow start win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+
+        njt_quic_set_pacing_rate(c, NJT_QUIC_PACING_GAIN_SS);
+
+        goto done;
+    }
+
+    if (!cubic->epoch) {
+        cubic->epoch = 1;
+        cubic->epoch_start = njt_current_msec;
+        cubic->w_est = cg->window;
+
+        if (cg->window < cubic->w_max) {
+            /* K = cbrt((W_max - cwnd_epoch) / C), in ms */
+            cubic->k = njt_quic_cbrt((uint64_t) (cubic->w_max - cg->window)
+                                     * 1000000000 / mss
+                                     * 100 / NJT_QUIC_CUBIC_C);
+        } else {
+            cubic->k = 0;
+            cubic->w_max = cg->window;
+        }
+    }
+
+    /* W_cubic(t + RTT) = C * (t + RTT - K)^3 + W_max */
+
+    t = njt_current_msec - cubic->epoch_start + qc->avg_rtt;
+
+    d = (t > cubic->k) ? t - cubic->k : cubic->k - t;
+    d = njt_min(d, NJT_QUIC_CUBIC_MAX_T);
+
+    delta = d * d * d / 1000 * mss * NJT_QUIC_CUBIC_C / 100 / 1000000;
+
+    if (t > cubic->k) {
+        target = cubic->w_max + delta;
+
+    } else {
+        target = (cubic->w_max > delta) ? cubic->w_max - delta : 0;
+    }
+
+    target = njt_max(target, cg->window);
+    target = njt_min(target, cg->window + cg->window / 2);
+
+    /* RFC 9438, 4.3. Reno-Friendly Region */
+
+    cubic->w_est += (uint64_t) mss * f->plen * NJT_QUIC_CUBIC_ALPHA / 100
+                    / cg->window;
+
+    if (cubic->w_est > target) {
+        cg->window = cubic->w_est;
+
+    } else {
+        cg->window += (uint64_t) (target - cg->window) * f->plen / cg->window;
+    }
+
+    njt_log_debug4(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic cubic avoidance win:%uz target:%uz wmax:%uz if:%uz",
+                   cg->window, target, cubic->w_max, cg->in_flight);
+
+    njt_quic_set_pacing_rate(c, NJT_QUIC_PACING_GAIN_CA);
+
+done:
+
+    /* prevent recovery_start from wrapping */
+
+    timer = cg->recovery_start - njt_current_msec + qc->tp.max_idle_timeout * 2;
+
+    if ((njt_msec_int_t) timer < 0) {
+        cg->recovery_start = njt_current_msec - qc->tp.max_idle_timeout * 2;
+    }
+}
+
+
+static void
+njt_quic_cubic_lost(njt_connection_t *c, njt_quic_frame_t *f)
+{
+    njt_msec_t              timer;
+    njt_quic_cubic_t       *cubic;
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+    cubic = &cg->u.cubic;
+
+    timer = f->send_time - cg->recovery_start;
+
+    if ((njt_msec_int_t) timer <= 0) {
+        njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                       "quic cubic lost recovery win:%uz ss:%z if:%uz",
+                       cg->window, cg->ssthresh, cg->in_flight);
+
+        return;
+    }
+
+    cg->recovery_start = njt_current_msec;
+    cubic->epoch = 0;
+
+    /* RFC 9438, 4.7. Fast Convergence */
+
+    if (cg->window < cubic->w_max) {
+        cubic->w_max = cg->window * (100 + NJT_QUIC_CUBIC_BETA) / 200;
+
+    } else {
+        cubic->w_max = cg->window;
+    }
+
+    cg->window = cg->window * NJT_QUIC_CUBIC_BETA / 100;
+
+    if (cg->window < NJT_QUIC_MIN_WINDOW(qc->path->mtu)) {
+        cg->window = NJT_QUIC_MIN_WINDOW(qc->path->mtu);
+    }
+
+    cg->ssthresh = cg->window;
+
+    njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic cubic lost win:%uz wmax:%uz if:%uz",
+                   cg->window, cubic->w_max, cg->in_flight);
+
+    njt_quic_set_pacing_rate(c, NJT_QUIC_PACING_GAIN_CA);
+}
+
+
+static void
+njt_quic_cubic_persistent(njt_connection_t *c)
+{
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    cg->recovery_start = njt_current_msec;
+    cg->window = NJT_QUIC_MIN_WINDOW(qc->path->mtu);
+    cg->u.cubic.epoch = 0;
+
+    njt_quic_set_pacing_rate(c, NJT_QUIC_PACING_GAIN_CA);
+}
+
+
+static uint64_t
+njt_quic_cbrt(uint64_t n)
+{
+    int       s;
+    uint64_t  r, b;
+
+    r = 0;
+
+    for (s = 63; s >= 0; s -= 3) {
+        r <<= 1;
+        b = 3 * r * (r + 1) + 1;
+
+        if ((n >> s) >= b) {
+            n -= b << s;
+            r++;
+        }
+    }
+
+    return r;
+}
+
+
+/*
+ * BBR with the loss response of BBRv2: the bandwidth and min RTT model
+ * drives the pacing rate and the window, while a round with too many
+ * losses exits STARTUP and caps the window with inflight_hi.
+ */
+
+static void
+njt_quic_bbr_init(njt_connection_t *c)
+{
+    njt_quic_bbr_t         *bbr;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    bbr = &qc->congestion.u.bbr;
+
+    bbr->state = NJT_QUIC_BBR_STARTUP;
+    bbr->min_rtt = NJT_TIMER_INFINITE;
+    bbr->min_rtt_stamp = njt_current_msec;
+    bbr->inflight_hi = (size_t) -1;
+
+    njt_quic_set_pacing_rate(c, NJT_QUIC_BBR_STARTUP_GAIN);
+}
+
+
+static void
+njt_quic_bbr_ack(njt_connection_t *c, njt_quic_frame_t *f)
+{
+    njt_uint_t              round_start;
+    njt_quic_bbr_t         *bbr;
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+    bbr = &cg->u.bbr;
+
+    round_start = 0;
+
+    if (f->delivered >= bbr->round_delivered) {
+        bbr->round_delivered = cg->delivered;
+        bbr->round_count++;
+        round_start = 1;
+    }
+
+    bbr->round_acked += f->plen;
+
+    njt_quic_bbr_update_model(c, f, round_start);
+    njt_quic_bbr_update_state(c);
+    njt_quic_bbr_set_window(c, f);
+
+    njt_log_debug5(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic bbr ack state:%ui win:%uz bw:%uL rtt:%M if:%uz",
+                   bbr->state, cg->window, njt_quic_bbr_max_bw(bbr),
+                   bbr->min_rtt, cg->in_flight);
+}
+
+
+static void
+njt_quic_bbr_update_model(njt_connection_t *c, njt_quic_frame_t *f,
+    njt_uint_t round_start)
+{
+    uint64_t                bw, max_bw;
+    njt_msec_t              rtt, interval;
+    njt_uint_t              expired;
+    njt_quic_bbr_t         *bbr;
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+    bbr = &cg->u.bbr;
+
+    /* delivery rate sample */
+
+    if (round_start
+        && bbr->round_count - bbr->bw_round >= NJT_QUIC_BBR_BW_ROUNDS)
+    {
+        bbr->bw[1] = bbr->bw[0];
+        bbr->bw[0] = 0;
+        bbr->bw_round = bbr->round_count;
+    }
+
+    /*
+     * with millisecond timestamps an interval shorter than min RTT
+     * is mostly an artifact of ack compression and overestimates
+     */
+
+    interval = njt_current_msec - f->delivered_time;
+
+    if (bbr->min_rtt != NJT_TIMER_INFINITE) {
+        interval = njt_max(interval, bbr->min_rtt);
+    }
+
+    interval = njt_max(interval, 1);
+
+    bw = (cg->delivered - f->delivered) * 1000 / interval;
+    max_bw = njt_quic_bbr_max_bw(bbr);
+
+    if (!f->app_limited || bw >= max_bw) {
+        bbr->bw[0] = njt_max(bbr->bw[0], bw);
+    }
+
+    /* min RTT, refreshed at least every NJT_QUIC_BBR_MIN_RTT_INTERVAL */
+
+    rtt = njt_max(njt_current_msec - f->send_time, 1);
+
+    expired = (njt_msec_int_t) (njt_current_msec - bbr->min_rtt_stamp)
+              > NJT_QUIC_BBR_MIN_RTT_INTERVAL;
+
+    if (rtt <= bbr->min_rtt || expired) {
+        bbr->min_rtt = rtt;
+        bbr->min_rtt_stamp = njt_current_msec;
+    }
+
+    if (expired && bbr->state != NJT_QUIC_BBR_PROBE_RTT) {
+        bbr->state = NJT_QUIC_BBR_PROBE_RTT;
+        bbr->prior_window = cg->window;
+        bbr->probe_rtt_done = 0;
+        bbr->probe_rtt_round = 0;
+    }
+
+    if (!round_start) {
+        return;
+    }
+
+    /* BBRv2: too many losses in a round bound the inflight volume */
+
+    /*
+     * a few random losses in a small round are not congestion,
+     * and the bound never goes below the estimated BDP
+     */
+
+    if (bbr->round_loss_events >= NJT_QUIC_BBR_LOSS_EVENTS
+        && bbr->round_lost * 100
+           > (bbr->round_lost + bbr->round_acked) * NJT_QUIC_BBR_LOSS_THRESH)
+    {
+        bbr->full_bw_reached = 1;
+        bbr->inflight_hi = njt_max(cg->window * NJT_QUIC_BBR_BETA / 100,
+                                   njt_quic_bbr_bdp(qc, bbr, 100));
+        bbr->inflight_hi = njt_max(bbr->inflight_hi,
+                                   NJT_QUIC_BBR_MIN_PACKETS * qc->path->mtu);
+
+    } else if (bbr->inflight_hi != (size_t) -1
+               && bbr->state == NJT_QUIC_BBR_PROBE_BW
+               && njt_quic_bbr_cycle_gain[bbr->cycle] > 100)
+    {
+        /* no losses while probing up, let inflight grow */
+
+        bbr->inflight_hi += bbr->inflight_hi / 4;
+
+        if (bbr->inflight_hi > 2 * njt_quic_bbr_bdp(qc, bbr, 100)) {
+            bbr->inflight_hi = (size_t) -1;
+        }
+    }
+
+    bbr->round_lost = 0;
+    bbr->round_acked = 0;
+    bbr->round_loss_events = 0;
+
+    bbr->probe_rtt_round = 1;
+
+    /* STARTUP is over when the bandwidth stops growing */
+
+    if (bbr->full_bw_reached || f->app_limited) {
+        return;
+    }
+
+    max_bw = njt_quic_bbr_max_bw(bbr);
+
+    if (max_bw >= bbr->full_bw * NJT_QUIC_BBR_FULL_BW_THRESH / 100) {
+        bbr->full_bw = max_bw;
+        bbr->full_bw_count = 0;
+        return;
+    }
+
+    if (++bbr->full_bw_count >= NJT_QUIC_BBR_FULL_BW_COUNT) {
+        bbr->full_bw_reached = 1;
+    }
+}
+
+
+static void
+njt_quic_bbr_update_state(njt_connection_t *c)
+{
+    size_t                  min_window;
+    njt_uint_t              gain;
+    njt_quic_bbr_t         *bbr;
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+    bbr = &cg->u.bbr;
+
+    switch (bbr->state) {
+
+    case NJT_QUIC_BBR_STARTUP:
+
+        if (bbr->full_bw_reached) {
+            bbr->state = NJT_QUIC_BBR_DRAIN;
+        }
+
+        break;
+
+    case NJT_QUIC_BBR_DRAIN:
+
+        if (cg->in_flight <= njt_quic_bbr_bdp(qc, bbr, 100)) {
+            bbr->state = NJT_QUIC_BBR_PROBE_BW;
+            bbr->cycle = 2;
+            bbr->cycle_start = njt_current_msec;
+        }
+
+        break;
+
+    case NJT_QUIC_BBR_PROBE_BW:
+
+        if ((njt_msec_int_t) (njt_current_msec - bbr->cycle_start)
+            > (njt_msec_int_t) bbr->min_rtt
+            || (njt_quic_bbr_cycle_gain[bbr->cycle] < 100
+                && cg->in_flight <= njt_quic_bbr_bdp(qc, bbr, 100)))
+        {
+            bbr->cycle = (bbr->cycle + 1) % NJT_QUIC_BBR_CYCLE_LEN;
+            bbr->cycle_start = njt_current_msec;
+        }
+
+        break;
+
+    case NJT_QUIC_BBR_PROBE_RTT:
+
+        min_window = NJT_QUIC_BBR_MIN_PACKETS * qc->path->mtu;
+
+        if (bbr->probe_rtt_done == 0) {
+
+            if (cg->in_flight <= min_window) {
+                bbr->probe_rtt_done = njt_current_msec
+                                      + NJT_QUIC_BBR_PROBE_RTT_TIME;
+                bbr->probe_rtt_round = 0;
+            }
+
+            break;
+        }
+
+        if (bbr->probe_rtt_round
+            && (njt_msec_int_t) (njt_current_msec - bbr->probe_rtt_done) >= 0)
+        {
+            bbr->min_rtt_stamp = njt_current_msec;
+            cg->window = njt_max(cg->window, bbr->prior_window);
+
+            if (bbr->full_bw_reached) {
+                bbr->state = NJT_QUIC_BBR_PROBE_BW;
+                bbr->cycle = 2;
+                bbr->cycle_start = njt_current_msec;
+
+            } else {
+                bbr->state = NJT_QUIC_BBR_STARTUP;
+            }
+        }
+
+        break;
+    }
+
+    switch (bbr->state) {
+
+    case NJT_QUIC_BBR_STARTUP:
+        gain = NJT_QUIC_BBR_STARTUP_GAIN;
+        break;
+
+    case NJT_QUIC_BBR_DRAIN:
+        gain = NJT_QUIC_BBR_DRAIN_GAIN;
+        break;
+
+    case NJT_QUIC_BBR_PROBE_BW:
+        gain = njt_quic_bbr_cycle_gain[bbr->cycle];
+        break;
+
+    default: /* NJT_QUIC_BBR_PROBE_RTT */
+        gain = 100;
+    }
+
+    if (njt_quic_bbr_max_bw(bbr) == 0) {
+        njt_quic_set_pacing_rate(c, gain);
+        return;
+    }
+
+    cg->pacing_rate = njt_quic_bbr_max_bw(bbr) * gain / 100;
+}
+
+
+static void
+njt_quic_bbr_set_window(njt_connection_t *c, njt_quic_frame_t *f)
+{
+    size_t                  target, min_window;
+    njt_quic_bbr_t         *bbr;
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+    bbr = &cg->u.bbr;
+
+    min_window = NJT_QUIC_BBR_MIN_PACKETS * qc->path->mtu;
+
+    if (bbr->state == NJT_QUIC_BBR_PROBE_RTT) {
+        cg->window = njt_min(cg->window, min_window);
+        return;
+    }
+
+    if (njt_quic_bbr_max_bw(bbr) == 0) {
+        /* no model yet, grow as in slow start */
+        cg->window += f->plen;
+        return;
+    }
+
+    /* some extra room absorbs ack aggregation */
+
+    target = njt_quic_bbr_bdp(qc, bbr, NJT_QUIC_BBR_CWND_GAIN)
+             + 3 * qc->path->mtu;
+
+    target = njt_min(target, bbr->inflight_hi);
+    target = njt_max(target, min_window);
+
+    if (bbr->full_bw_reached) {
+        cg->window = njt_min(cg->window + f->plen, target);
+
+    } else if (cg->window < target) {
+        cg->window += f->plen;
+    }
+
+    cg->window = njt_max(cg->window, min_window);
+}
+
+
+static void
+njt_quic_bbr_lost(njt_connection_t *c, njt_quic_frame_t *f)
+{
+    njt_quic_bbr_t         *bbr;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    bbr = &qc->congestion.u.bbr;
+
+    bbr->round_lost += f->plen;
+    bbr->round_loss_events++;
+
+    njt_log_debug2(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic bbr lost:%uz win:%uz",
+                   bbr->round_lost, qc->congestion.window);
+}
+
+
+static void
+njt_quic_bbr_persistent(njt_connection_t *c)
+{
+    njt_quic_congestion_t  *cg;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c);
+    cg = &qc->congestion;
+
+    /* the model is kept, the window grows back to its target on acks */
+
+    cg->recovery_start = njt_current_msec;
+    cg->window = NJT_QUIC_MIN_WINDOW(qc->path->mtu);
+}
+
+
+static uint64_t
+njt_quic_bbr_max_bw(njt_quic_bbr_t *bbr)
+{
+    return njt_max(bbr->bw[0], bbr->bw[1]);
+}
+
+
+static size_t
+njt_quic_bbr_bdp(njt_quic_connection_t *qc, njt_quic_bbr_t *bbr,
+    njt_uint_t gain)
+{
+    njt_msec_t  rtt;
+
+    rtt = (bbr->min_rtt == NJT_TIMER_INFINITE) ? NJT_QUIC_INITIAL_RTT
+                                               : bbr->min_rtt;
+
+    return njt_quic_bbr_max_bw(bbr) * rtt / 1000 * gain / 100;
+}
@@ -0,0 +1,70 @@
+
+/*
+ * Copyright (C) Nginx, Inc.
+ * Copyright (C) 2021-2023  TMLake(Beijing) Technology Co., Ltd.
+ */
+
+
+#ifndef _NJT_EVENT_QUIC_CONGESTION_H_INCLUDED_
+#define _NJT_EVENT_QUIC_CONGESTION_H_INCLUDED_
+
+
+#include <njt_config.h>
+#include <njt_core.h>
+
+
+typedef struct {
+    njt_str_t                         name;
+    void                            (*init)(njt_connection_t *c);
+    void                            (*ack)(njt_connection_t *c,
+                                           njt_quic_frame_t *f);
+    void                            (*lost)(njt_connection_t *c,
+                                            njt_quic_frame_t *f);
+    void                            (*persistent)(njt_connection_t *c);
+} njt_quic_congestion_ops_t;
+
+
+/* RFC 9438 */
+typedef struct {
+    size_t                            w_max;
+    size_t                            w_est;
+    njt_msec_t                        epoch_start;
+    njt_msec_t                        k;
+    njt_uint_t                        epoch;
+} njt_quic_cubic_t;
+
+
+typedef struct {
+    njt_uint_t                        state;
+    njt_uint_t                        cycle;
+    njt_msec_t                        cycle_start;
+
+    uint64_t                          bw[2];       /* bytes per second */
+    njt_uint_t                        bw_round;
+    uint64_t                          full_bw;
+    njt_uint_t                        full_bw_count;
+
+    uint64_t                          round_delivered;
+    njt_uint_t                        round_count;
+    size_t                            round_acked;
+    size_t                            round_lost;
+    njt_uint_t                        round_loss_events;
+
+    njt_msec_t                        min_rtt;
+    njt_msec_t                        min_rtt_stamp;
+    njt_msec_t                        probe_rtt_done;
+
+    size_t                            inflight_hi;
+    size_t                            prior_window;
+
+    unsigned                          full_bw_reached:1;
+    unsigned                          probe_rtt_round:1;
+} njt_quic_bbr_t;
+
+
+void njt_quic_congestion_init(njt_connection_t *c);
+void njt_quic_congestion_sent(njt_connection_t *c, njt_quic_frame_t *f);
+void njt_quic_pacing_refill(njt_connection_t *c);
+void njt_quic_pacing_schedule(njt_connection_t *c);
+
+#endif /* _NJT_EVENT_QUIC_CONGESTION_H_INCLUDED_ */
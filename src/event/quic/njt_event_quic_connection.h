@@ -38,7 +38,9 @@ typedef struct njt_quic_keys_s        njt_quic_keys_t;
 #include <njt_event_quic_ssl.h>
 #include <njt_event_quic_tokens.h>
 #include <njt_event_quic_ack.h>
+#include <njt_event_quic_congestion.h>
 #include <njt_event_quic_output.h>
+#include <njt_event_quic_batch.h>
 #include <njt_event_quic_socket.h>
 
 
@@ -149,6 +151,9 @@ typedef struct {
     uint64_t                          send_offset;
     uint64_t                          send_max_data;
 
+    /* virtual time of incremental streams, per urgency */
+    uint64_t                          vtime[NJT_QUIC_STREAM_URGENCY_LEVELS];
+
     uint64_t                          server_max_streams_uni;
     uint64_t                          server_max_streams_bidi;
     uint64_t                          server_streams_uni;
@@ -169,6 +174,25 @@ typedef struct {
     size_t                            window;
     size_t                            ssthresh;
     njt_msec_t                        recovery_start;
+
+    njt_quic_congestion_ops_t        *ops;
+
+    uint64_t                          delivered;   /* bytes acked */
+    njt_msec_t                        delivered_time;
+
+    uint64_t                          pacing_rate; /* bytes per second */
+    size_t                            pacing_budget;
+    njt_msec_t                        pacing_time;
+
+    uint64_t                          sent;        /* ack-eliciting packets */
+    uint64_t                          lost;
+
+    union {
+        njt_quic_cubic_t              cubic;
+        njt_quic_bbr_t                bbr;
+    } u;
+
+    unsigned                          app_limited:1;
 } njt_quic_congestion_t;
 
 
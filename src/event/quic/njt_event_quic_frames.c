@@ -302,7 +302,7 @@ njt_quic_queue_frame(njt_quic_connection_t *qc, njt_quic_frame_t *frame)
 
     ctx = njt_quic_get_send_ctx(qc, frame->level);
 
-    njt_queue_insert_tail(&ctx->frames, &frame->queue);
+    njt_quic_insert_frame(ctx, frame);
 
     frame->len = njt_quic_create_frame(NULL, frame);
     /* always succeeds */
@@ -315,6 +315,34 @@ njt_quic_queue_frame(njt_quic_connection_t *qc, njt_quic_frame_t *frame)
 }
 
 
+void
+njt_quic_insert_frame(njt_quic_send_ctx_t *ctx, njt_quic_frame_t *frame)
+{
+    njt_queue_t       *q;
+    njt_quic_frame_t  *f;
+
+    if (frame->type != NJT_QUIC_FT_STREAM) {
+        njt_queue_insert_tail(&ctx->frames, &frame->queue);
+        return;
+    }
+
+    /* ahead of queued stream frames with a lower priority */
+
+    for (q = njt_queue_last(&ctx->frames);
+         q != njt_queue_sentinel(&ctx->frames);
+         q = njt_queue_prev(q))
+    {
+        f = njt_queue_data(q, njt_quic_frame_t, queue);
+
+        if (f->type != NJT_QUIC_FT_STREAM || f->priority <= frame->priority) {
+            break;
+        }
+    }
+
+    njt_queue_insert_after(q, &frame->queue);
+}
+
+
 njt_int_t
 njt_quic_split_frame(njt_connection_t *c, njt_quic_frame_t *f, size_t len)
 {
@@ -13,6 +13,11 @@
 #include <njt_core.h>
 
 
+/* the sort key of STREAM frames, see njt_quic_stream_priority() */
+#define NJT_QUIC_PRIORITY_INCREMENTAL  ((uint64_t) 1 << 60)
+#define NJT_QUIC_PRIORITY_ORDER        (NJT_QUIC_PRIORITY_INCREMENTAL - 1)
+
+
 typedef njt_int_t (*njt_quic_frame_handler_pt)(njt_connection_t *c,
     njt_quic_frame_t *frame, void *data);
 
@@ -21,6 +26,7 @@ njt_quic_frame_t *njt_quic_alloc_frame(njt_connection_t *c);
 void njt_quic_free_frame(njt_connection_t *c, njt_quic_frame_t *frame);
 void njt_quic_free_frames(njt_connection_t *c, njt_queue_t *frames);
 void njt_quic_queue_frame(njt_quic_connection_t *qc, njt_quic_frame_t *frame);
+void njt_quic_insert_frame(njt_quic_send_ctx_t *ctx, njt_quic_frame_t *frame);
 njt_int_t njt_quic_split_frame(njt_connection_t *c, njt_quic_frame_t *f,
     size_t len);
 
@@ -181,15 +181,9 @@ valid:
         ctx = njt_quic_get_send_ctx(qc, ssl_encryption_application);
         qc->rst_pnum = ctx->pnum;
 
-        njt_memzero(&qc->congestion, sizeof(njt_quic_congestion_t));
-
-        qc->congestion.window = njt_min(10 * qc->tp.max_udp_payload_size,
-                                   njt_max(2 * qc->tp.max_udp_payload_size,
-                                           14720));
-        qc->congestion.ssthresh = (size_t) -1;
-        qc->congestion.recovery_start = njt_current_msec;
-
         njt_quic_init_rtt(qc);
+
+        njt_quic_congestion_init(c);
     }
 
     path->validated = 1;
@@ -919,6 +913,7 @@ njt_quic_send_path_mtu_probe(njt_connection_t *c, njt_quic_path_t *path)
 
     frame->level = ssl_encryption_application;
     frame->type = NJT_QUIC_FT_PING;
+    frame->ignore_congestion = 1;
 
     qc = njt_quic_get_connection(c);
     ctx = njt_quic_get_send_ctx(qc, ssl_encryption_application);
@@ -11,9 +11,6 @@
 #include <njt_event_quic_connection.h>
 
 
-#define NJT_QUIC_MAX_UDP_SEGMENT_BUF  65487 /* 65K - IPv6 header */
-#define NJT_QUIC_MAX_SEGMENTS            64 /* UDP_MAX_SEGMENTS */
-
 #define NJT_QUIC_RETRY_TOKEN_LIFETIME     3 /* seconds */
 #define NJT_QUIC_NEW_TOKEN_LIFETIME     600 /* seconds */
 #define NJT_QUIC_RETRY_BUFFER_SIZE      256
@@ -81,6 +78,8 @@ njt_quic_output(njt_connection_t *c)
 
     in_flight = cg->in_flight;
 
+    njt_quic_pacing_refill(c);
+
 #if ((NJT_HAVE_UDP_SEGMENT) && (NJT_HAVE_MSGHDR_MSG_CONTROL))
     if (njt_quic_allow_segmentation(c)) {
         rc = njt_quic_create_segments(c);
@@ -94,6 +93,13 @@ njt_quic_output(njt_connection_t *c)
         return NJT_ERROR;
     }
 
+    /* neither the window nor the pacer stopped sending */
+    cg->app_limited = (cg->in_flight < cg->window && cg->pacing_budget);
+
+    if (!qc->closing) {
+        njt_quic_pacing_schedule(c);
+    }
+
     if (in_flight == cg->in_flight || qc->closing) {
         /* no ack-eliciting data was sent or we are done */
         return NJT_OK;
@@ -128,7 +134,7 @@ njt_quic_create_datagrams(njt_connection_t *c)
     cg = &qc->congestion;
     path = qc->path;
 
-    while (cg->in_flight < cg->window) {
+    while (cg->in_flight < cg->window && cg->pacing_budget) {
 
         p = dst;
 
@@ -174,7 +180,17 @@ njt_quic_create_datagrams(njt_connection_t *c)
             break;
         }
 
-        n = njt_quic_send(c, dst, len, path->sockaddr, path->socklen);
+#if (NJT_HAVE_SENDMMSG)
+        if (qc->conf->sendmmsg_enabled) {
+            /* full datagrams may be coalesced into GSO segments */
+            n = njt_quic_batch_send(c, dst, len, path->sockaddr, path->socklen,
+                                    (qc->conf->gso_enabled && path->validated)
+                                    ? len : 0);
+        } else
+#endif
+        {
+            n = njt_quic_send(c, dst, len, path->sockaddr, path->socklen);
+        }
 
         if (n == NJT_ERROR) {
             return NJT_ERROR;
@@ -205,13 +221,10 @@ njt_quic_commit_send(njt_connection_t *c, njt_quic_send_ctx_t *ctx)
 {
     njt_queue_t            *q;
     njt_quic_frame_t       *f;
-    njt_quic_congestion_t  *cg;
     njt_quic_connection_t  *qc;
 
     qc = njt_quic_get_connection(c);
 
-    cg = &qc->congestion;
-
     while (!njt_queue_empty(&ctx->sending)) {
 
         q = njt_queue_head(&ctx->sending);
@@ -222,7 +235,7 @@ njt_quic_commit_send(njt_connection_t *c, njt_quic_send_ctx_t *ctx)
         if (f->pkt_need_ack && !qc->closing) {
             njt_queue_insert_tail(&ctx->sent, q);
 
-            cg->in_flight += f->plen;
+            njt_quic_congestion_sent(c, f);
 
         } else {
             njt_quic_free_frame(c, f);
@@ -230,7 +243,7 @@ njt_quic_commit_send(njt_connection_t *c, njt_quic_send_ctx_t *ctx)
     }
 
     njt_log_debug1(NJT_LOG_DEBUG_EVENT, c->log, 0,
-                   "quic congestion send if:%uz", cg->in_flight);
+                   "quic congestion send if:%uz", qc->congestion.in_flight);
 }
 
 
@@ -342,7 +355,10 @@ njt_quic_create_segments(njt_connection_t *c)
 
         len = njt_min(segsize, (size_t) (end - p));
 
-        if (len && cg->in_flight + (p - dst) < cg->window) {
+        if (len
+            && cg->in_flight + (p - dst) < cg->window
+            && (size_t) (p - dst) < cg->pacing_budget)
+        {
 
             n = njt_quic_output_packet(c, ctx, p, len, len);
             if (n == NJT_ERROR) {
@@ -363,8 +379,17 @@ njt_quic_create_segments(njt_connection_t *c)
         }
 
         if (n == 0 || nseg == NJT_QUIC_MAX_SEGMENTS) {
-            n = njt_quic_send_segments(c, dst, p - dst, path->sockaddr,
-                                       path->socklen, segsize);
+#if (NJT_HAVE_SENDMMSG)
+            if (qc->conf->sendmmsg_enabled) {
+                n = njt_quic_batch_send(c, dst, p - dst, path->sockaddr,
+                                        path->socklen, segsize);
+            } else
+#endif
+            {
+                n = njt_quic_send_segments(c, dst, p - dst, path->sockaddr,
+                                           path->socklen, segsize);
+            }
+
             if (n == NJT_ERROR) {
                 return NJT_ERROR;
             }
@@ -507,9 +532,10 @@ njt_quic_output_packet(njt_connection_t *c, njt_quic_send_ctx_t *ctx,
     size_t                  len, pad, min_payload, max_payload;
     u_char                 *p;
     ssize_t                 flen;
+    uint64_t                order;
     njt_str_t               res;
     njt_int_t               rc;
-    njt_uint_t              nframes;
+    njt_uint_t              nframes, urgency;
     njt_msec_t              now;
     njt_queue_t            *q;
     njt_quic_frame_t       *f;
@@ -590,6 +616,19 @@ njt_quic_output_packet(njt_connection_t *c, njt_quic_send_ctx_t *ctx,
         f->send_time = now;
         f->plen = 0;
 
+        if (f->type == NJT_QUIC_FT_STREAM
+            && (f->priority & NJT_QUIC_PRIORITY_INCREMENTAL))
+        {
+            /* the virtual time of the urgency follows sent data */
+
+            urgency = f->priority >> 61;
+            order = f->priority & NJT_QUIC_PRIORITY_ORDER;
+
+            if (qc->streams.vtime[urgency] < order) {
+                qc->streams.vtime[urgency] = order;
+            }
+        }
+
         njt_quic_log_frame(c->log, f, 1);
 
         flen = njt_quic_create_frame(p, f);
@@ -1270,6 +1309,13 @@ njt_quic_frame_sendto(njt_connection_t *c, njt_quic_frame_t *frame,
 
     ctx->pnum++;
 
+#if (NJT_HAVE_SENDMMSG)
+    if (qc->conf->sendmmsg_enabled) {
+        /* packets queued by njt_quic_output() go first */
+        njt_quic_batch_flush();
+    }
+#endif
+
     sent = njt_quic_send(c, res.data, res.len, path->sockaddr, path->socklen);
     if (sent < 0) {
         njt_quic_free_frame(c, frame);
@@ -1281,7 +1327,7 @@ njt_quic_frame_sendto(njt_connection_t *c, njt_quic_frame_t *frame,
     if (frame->need_ack && !qc->closing) {
         njt_queue_insert_tail(&ctx->sent, &frame->queue);
 
-        cg->in_flight += frame->plen;
+        njt_quic_congestion_sent(c, frame);
 
     } else {
         njt_quic_free_frame(c, frame);
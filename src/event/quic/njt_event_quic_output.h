@@ -13,6 +13,10 @@
 #include <njt_core.h>
 
 
+#define NJT_QUIC_MAX_UDP_SEGMENT_BUF  65487 /* 65K - IPv6 header */
+#define NJT_QUIC_MAX_SEGMENTS            64 /* UDP_MAX_SEGMENTS */
+
+
 njt_int_t njt_quic_output(njt_connection_t *c);
 
 njt_int_t njt_quic_negotiate_version(njt_connection_t *c,
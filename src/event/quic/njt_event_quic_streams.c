@@ -13,6 +13,9 @@
 
 #define NJT_QUIC_STREAM_GONE     (void *) -1
 
+/* stream data is queued in frames of this size for round-robin */
+#define NJT_QUIC_STREAM_CHUNK    16384
+
 
 static njt_int_t njt_quic_do_reset_stream(njt_quic_stream_t *qs,
     njt_uint_t err);
@@ -33,6 +36,8 @@ static ssize_t njt_quic_stream_send(njt_connection_t *c, u_char *buf,
 static njt_chain_t *njt_quic_stream_send_chain(njt_connection_t *c,
     njt_chain_t *in, off_t limit);
 static njt_int_t njt_quic_stream_flush(njt_quic_stream_t *qs);
+static void njt_quic_stream_priority(njt_quic_connection_t *qc,
+    njt_quic_stream_t *qs, njt_quic_frame_t *frame);
 static void njt_quic_stream_cleanup_handler(void *data);
 static njt_int_t njt_quic_close_stream(njt_quic_stream_t *qs);
 static njt_int_t njt_quic_can_shutdown(njt_connection_t *c);
@@ -682,6 +687,8 @@ njt_quic_create_stream(njt_connection_t *c, uint64_t id)
     qs->id = id;
     qs->send_final_size = (uint64_t) -1;
     qs->recv_final_size = (uint64_t) -1;
+    qs->urgency = NJT_QUIC_STREAM_URGENCY_DEFAULT;
+    qs->incremental = 1;
 
     pool = njt_create_pool(NJT_DEFAULT_POOL_SIZE, c->log);
     if (pool == NULL) {
@@ -836,6 +843,29 @@ njt_quic_cancelable_stream(njt_connection_t *c)
 }
 
 
+void
+njt_quic_set_stream_priority(njt_connection_t *c, uint64_t id,
+    njt_uint_t urgency, njt_uint_t incremental)
+{
+    njt_quic_stream_t      *qs;
+    njt_quic_connection_t  *qc;
+
+    qc = njt_quic_get_connection(c->quic->parent);
+
+    qs = njt_quic_find_stream(&qc->streams.tree, id);
+    if (qs == NULL || qs->connection == NULL) {
+        return;
+    }
+
+    njt_log_debug3(NJT_LOG_DEBUG_EVENT, c->log, 0,
+                   "quic stream id:0x%xL priority u:%ui i:%ui",
+                   id, urgency, incremental);
+
+    qs->urgency = urgency;
+    qs->incremental = incremental;
+}
+
+
 static void
 njt_quic_empty_handler(njt_event_t *ev)
 {
@@ -1007,7 +1037,7 @@ static njt_int_t
 njt_quic_stream_flush(njt_quic_stream_t *qs)
 {
     off_t                   limit, len;
-    njt_uint_t              last;
+    njt_uint_t              last, n;
     njt_chain_t            *out;
     njt_quic_frame_t       *frame;
     njt_connection_t       *pc;
@@ -1030,54 +1060,65 @@ njt_quic_stream_flush(njt_quic_stream_t *qs)
     njt_log_debug2(NJT_LOG_DEBUG_EVENT, pc->log, 0,
                    "quic stream id:0x%xL flush limit:%O", qs->id, limit);
 
-    len = qs->send.offset;
+    n = 0;
 
-    out = njt_quic_read_buffer(pc, &qs->send, limit);
-    if (out == NJT_CHAIN_ERROR) {
-        return NJT_ERROR;
-    }
+    do {
+        len = qs->send.offset;
 
-    len = qs->send.offset - len;
-    last = 0;
+        out = njt_quic_read_buffer(pc, &qs->send,
+                                   njt_min(limit, NJT_QUIC_STREAM_CHUNK));
+        if (out == NJT_CHAIN_ERROR) {
+            return NJT_ERROR;
+        }
 
-    if (qs->send_final_size != (uint64_t) -1
-        && qs->send_final_size == qs->send.offset)
-    {
-        qs->send_state = NJT_QUIC_STREAM_SEND_DATA_SENT;
-        last = 1;
-    }
+        len = qs->send.offset - len;
+        last = 0;
 
-    if (len == 0 && !last) {
-        return NJT_OK;
-    }
+        if (qs->send_final_size != (uint64_t) -1
+            && qs->send_final_size == qs->send.offset)
+        {
+            qs->send_state = NJT_QUIC_STREAM_SEND_DATA_SENT;
+            last = 1;
+        }
 
-    frame = njt_quic_alloc_frame(pc);
-    if (frame == NULL) {
-        return NJT_ERROR;
-    }
+        if (len == 0 && !last) {
+            break;
+        }
 
-    frame->level = ssl_encryption_application;
-    frame->type = NJT_QUIC_FT_STREAM;
-    frame->data = out;
+        frame = njt_quic_alloc_frame(pc);
+        if (frame == NULL) {
+            return NJT_ERROR;
+        }
 
-    frame->u.stream.off = 1;
-    frame->u.stream.len = 1;
-    frame->u.stream.fin = last;
+        frame->level = ssl_encryption_application;
+        frame->type = NJT_QUIC_FT_STREAM;
+        frame->data = out;
 
-    frame->u.stream.stream_id = qs->id;
-    frame->u.stream.offset = qs->send_offset;
-    frame->u.stream.length = len;
+        frame->u.stream.off = 1;
+        frame->u.stream.len = 1;
+        frame->u.stream.fin = last;
 
-    njt_quic_queue_frame(qc, frame);
+        frame->u.stream.stream_id = qs->id;
+        frame->u.stream.offset = qs->send_offset;
+        frame->u.stream.length = len;
+
+        njt_quic_stream_priority(qc, qs, frame);
 
-    qs->send_offset += len;
-    qc->streams.send_offset += len;
+        njt_quic_queue_frame(qc, frame);
 
-    njt_log_debug3(NJT_LOG_DEBUG_EVENT, pc->log, 0,
-                   "quic stream id:0x%xL flush len:%O last:%ui",
-                   qs->id, len, last);
+        qs->send_offset += len;
+        qc->streams.send_offset += len;
 
-    if (qs->connection == NULL) {
+        limit -= len;
+        n++;
+
+        njt_log_debug3(NJT_LOG_DEBUG_EVENT, pc->log, 0,
+                       "quic stream id:0x%xL flush len:%O last:%ui",
+                       qs->id, len, last);
+
+    } while (!last && len == NJT_QUIC_STREAM_CHUNK && limit);
+
+    if (n && qs->connection == NULL) {
         return njt_quic_close_stream(qs);
     }
 
@@ -1085,6 +1126,32 @@ njt_quic_stream_flush(njt_quic_stream_t *qs)
 }
 
 
+/*
+ * the key is the urgency, the incremental flag and then either the stream
+ * number, so that non-incremental streams are sent one by one, or the
+ * virtual time of the data, which interleaves incremental streams
+ */
+
+static void
+njt_quic_stream_priority(njt_quic_connection_t *qc, njt_quic_stream_t *qs,
+    njt_quic_frame_t *frame)
+{
+    uint64_t  order;
+
+    if (qs->incremental) {
+        order = njt_max(qs->vtime, qc->streams.vtime[qs->urgency]);
+        qs->vtime = order + frame->u.stream.length;
+
+    } else {
+        order = qs->id >> 2;
+    }
+
+    frame->priority = ((uint64_t) qs->urgency << 61)
+                      | (qs->incremental ? NJT_QUIC_PRIORITY_INCREMENTAL : 0)
+                      | (order & NJT_QUIC_PRIORITY_ORDER);
+}
+
+
 static void
 njt_quic_stream_cleanup_handler(void *data)
 {
@@ -268,10 +268,14 @@ struct njt_quic_frame_s {
     uint64_t                                    pnum;
     size_t                                      plen;
     njt_msec_t                                  send_time;
+    uint64_t                                    delivered;
+    njt_msec_t                                  delivered_time;
     ssize_t                                     len;
+    uint64_t                                    priority;
     unsigned                                    need_ack:1;
     unsigned                                    pkt_need_ack:1;
     unsigned                                    ignore_congestion:1;
+    unsigned                                    app_limited:1;
 
     njt_chain_t                                *data;
     union {
@@ -11,6 +11,26 @@
 #include <njt_http.h>
 #include <njt_http_dyn_module.h>
 
+
+/* shorter rule lists are scanned, they are cheaper than a search */
+#define NJT_HTTP_ACCESS_CIDR_MIN  8
+
+
+typedef struct {
+    uint32_t                  lo[4];
+    uint32_t                  hi[4];
+    njt_uint_t                index;
+    njt_uint_t                deny;
+} njt_http_access_range_t;
+
+
+typedef struct {
+    njt_http_access_range_t  *range;
+    njt_uint_t                index;
+    njt_uint_t                deny;
+} njt_http_access_open_t;
+
+
 static njt_int_t njt_http_access_handler(njt_http_request_t *r);
 static njt_int_t njt_http_access_inet(njt_http_request_t *r,
     njt_http_access_loc_conf_t *alcf, in_addr_t addr);
@@ -23,6 +43,17 @@ static njt_int_t njt_http_access_unix(njt_http_request_t *r,
     njt_http_access_loc_conf_t *alcf);
 #endif
 static njt_int_t njt_http_access_found(njt_http_request_t *r, njt_uint_t deny);
+static njt_int_t njt_http_access_cidr_find(njt_http_request_t *r,
+    njt_http_access_cidr_t *cidr, uint32_t *addr);
+static njt_int_t njt_http_access_cmp(uint32_t *a, uint32_t *b,
+    njt_uint_t words);
+static int njt_http_access_range_cmp(const void *one, const void *two);
+static njt_int_t njt_http_access_range(njt_http_access_range_t *range,
+    uint32_t *addr, uint32_t *mask, njt_uint_t words);
+static njt_http_access_cidr_t *njt_http_access_build(njt_pool_t *pool,
+    njt_http_access_range_t *ranges, njt_uint_t n, njt_uint_t words);
+static void njt_http_access_append(njt_http_access_cidr_t *cidr,
+    uint32_t *pos, njt_uint_t value);
 static char *njt_http_access_rule(njt_conf_t *cf, njt_command_t *cmd,
     void *conf);
 static void *njt_http_access_create_loc_conf(njt_conf_t *cf);
@@ -149,9 +180,15 @@ static njt_int_t
 njt_http_access_inet(njt_http_request_t *r, njt_http_access_loc_conf_t *alcf,
     in_addr_t addr)
 {
+    uint32_t                 key;
     njt_uint_t               i;
     njt_http_access_rule_t  *rule;
 
+    if (alcf->cidr) {
+        key = ntohl(addr);
+        return njt_http_access_cidr_find(r, alcf->cidr, &key);
+    }
+
     rule = alcf->rules->elts;
     for (i = 0; i < alcf->rules->nelts; i++) {
 
@@ -174,10 +211,20 @@ static njt_int_t
 njt_http_access_inet6(njt_http_request_t *r, njt_http_access_loc_conf_t *alcf,
     u_char *p)
 {
+    uint32_t                  key[4];
     njt_uint_t                n;
     njt_uint_t                i;
     njt_http_access_rule6_t  *rule6;
 
+    if (alcf->cidr6) {
+        for (n = 0; n < 4; n++) {
+            key[n] = (uint32_t) p[4 * n] << 24 | p[4 * n + 1] << 16
+                     | p[4 * n + 2] << 8 | p[4 * n + 3];
+        }
+
+        return njt_http_access_cidr_find(r, alcf->cidr6, key);
+    }
+
     rule6 = alcf->rules6->elts;
     for (i = 0; i < alcf->rules6->nelts; i++) {
 
@@ -258,6 +305,403 @@ njt_http_access_found(njt_http_request_t *r, njt_uint_t deny)
 }
 
 
+static njt_int_t
+njt_http_access_cidr_find(njt_http_request_t *r, njt_http_access_cidr_t *cidr,
+    uint32_t *addr)
+{
+    njt_uint_t  lo, hi, mid, w;
+
+    w = cidr->words;
+
+    /* start[0] is the lowest address, the last range starting at or below */
+
+    lo = 0;
+    hi = cidr->nranges;
+
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo) / 2;
+
+        if (njt_http_access_cmp(&cidr->start[mid * w], addr, w) <= 0) {
+            lo = mid;
+
+        } else {
+            hi = mid;
+        }
+    }
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "access: range %ui of %ui", lo, cidr->nranges);
+
+    if (cidr->result[lo] == NJT_HTTP_ACCESS_NONE) {
+        return NJT_DECLINED;
+    }
+
+    return njt_http_access_found(r, cidr->result[lo]);
+}
+
+
+static njt_int_t
+njt_http_access_cmp(uint32_t *a, uint32_t *b, njt_uint_t words)
+{
+    njt_uint_t  i;
+
+    for (i = 0; i < words; i++) {
+        if (a[i] != b[i]) {
+            return (a[i] < b[i]) ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+njt_http_access_range_cmp(const void *one, const void *two)
+{
+    int                       rc;
+    njt_http_access_range_t  *a, *b;
+
+    a = (njt_http_access_range_t *) one;
+    b = (njt_http_access_range_t *) two;
+
+    /* by start, enclosing ranges first, then in the rules order */
+
+    rc = njt_http_access_cmp(a->lo, b->lo, 4);
+    if (rc) {
+        return rc;
+    }
+
+    rc = njt_http_access_cmp(b->hi, a->hi, 4);
+    if (rc) {
+        return rc;
+    }
+
+    return (a->index < b->index) ? -1 : 1;
+}
+
+
+static njt_int_t
+njt_http_access_range(njt_http_access_range_t *range, uint32_t *addr,
+    uint32_t *mask, njt_uint_t words)
+{
+    uint32_t    m;
+    njt_uint_t  i, tail;
+
+    njt_memzero(range->lo, sizeof(range->lo));
+    njt_memzero(range->hi, sizeof(range->hi));
+
+    tail = 0;
+
+    for (i = 0; i < words; i++) {
+        m = mask[i];
+
+        /* a non-contiguous mask does not describe a range */
+
+        if (tail) {
+            if (m) {
+                return NJT_DECLINED;
+            }
+
+        } else if (m != 0xffffffff) {
+            if (~m & (~m + 1)) {
+                return NJT_DECLINED;
+            }
+
+            tail = 1;
+        }
+
+        range->lo[i] = addr[i];
+        range->hi[i] = addr[i] | ~m;
+    }
+
+    return NJT_OK;
+}
+
+
+njt_int_t
+njt_http_access_compile(njt_pool_t *pool, njt_http_access_loc_conf_t *alcf)
+{
+    uint32_t                  addr[4], mask[4];
+    njt_int_t                 rc;
+    njt_uint_t                i, n, k;
+    njt_http_access_rule_t   *rule;
+    njt_http_access_range_t  *ranges;
+#if (NJT_HAVE_INET6)
+    u_char                   *a, *m;
+    njt_http_access_rule6_t  *rule6;
+#endif
+
+    alcf->cidr = NULL;
+#if (NJT_HAVE_INET6)
+    alcf->cidr6 = NULL;
+#endif
+
+    if (alcf->rules && alcf->rules->nelts >= NJT_HTTP_ACCESS_CIDR_MIN) {
+
+        ranges = njt_alloc(alcf->rules->nelts
+                           * sizeof(njt_http_access_range_t), pool->log);
+        if (ranges == NULL) {
+            return NJT_ERROR;
+        }
+
+        rule = alcf->rules->elts;
+        n = 0;
+
+        for (i = 0; i < alcf->rules->nelts; i++) {
+
+            /* a rule with host bits set never matches */
+
+            if (rule[i].addr & ~rule[i].mask) {
+                continue;
+            }
+
+            addr[0] = ntohl(rule[i].addr);
+            mask[0] = ntohl(rule[i].mask);
+
+            rc = njt_http_access_range(&ranges[n], addr, mask, 1);
+            if (rc == NJT_DECLINED) {
+                break;
+            }
+
+            ranges[n].index = i;
+            ranges[n].deny = rule[i].deny;
+            n++;
+        }
+
+        if (i == alcf->rules->nelts) {
+            alcf->cidr = njt_http_access_build(pool, ranges, n, 1);
+            if (alcf->cidr == NULL) {
+                njt_free(ranges);
+                return NJT_ERROR;
+            }
+        }
+
+        njt_free(ranges);
+    }
+
+#if (NJT_HAVE_INET6)
+
+    if (alcf->rules6 && alcf->rules6->nelts >= NJT_HTTP_ACCESS_CIDR_MIN) {
+
+        ranges = njt_alloc(alcf->rules6->nelts
+                           * sizeof(njt_http_access_range_t), pool->log);
+        if (ranges == NULL) {
+            return NJT_ERROR;
+        }
+
+        rule6 = alcf->rules6->elts;
+        n = 0;
+
+        for (i = 0; i < alcf->rules6->nelts; i++) {
+            a = rule6[i].addr.s6_addr;
+            m = rule6[i].mask.s6_addr;
+
+            for (k = 0; k < 16; k++) {
+                if (a[k] & ~m[k]) {
+                    break;
+                }
+            }
+
+            if (k < 16) {
+                continue;
+            }
+
+            for (k = 0; k < 4; k++) {
+                addr[k] = (uint32_t) a[4 * k] << 24 | a[4 * k + 1] << 16
+                          | a[4 * k + 2] << 8 | a[4 * k + 3];
+                mask[k] = (uint32_t) m[4 * k] << 24 | m[4 * k + 1] << 16
+                          | m[4 * k + 2] << 8 | m[4 * k + 3];
+            }
+
+            rc = njt_http_access_range(&ranges[n], addr, mask, 4);
+            if (rc == NJT_DECLINED) {
+                break;
+            }
+
+            ranges[n].index = i;
+            ranges[n].deny = rule6[i].deny;
+            n++;
+        }
+
+        if (i == alcf->rules6->nelts) {
+            alcf->cidr6 = njt_http_access_build(pool, ranges, n, 4);
+            if (alcf->cidr6 == NULL) {
+                njt_free(ranges);
+                return NJT_ERROR;
+            }
+        }
+
+        njt_free(ranges);
+    }
+
+#endif
+
+    return NJT_OK;
+}
+
+
+/*
+ * CIDR prefixes either nest or do not intersect, so after sorting by start
+ * (enclosing first) a single sweep with a stack of the open prefixes finds
+ * the first matching rule of every address; each change of the result
+ * starts a new range
+ */
+
+static njt_http_access_cidr_t *
+njt_http_access_build(njt_pool_t *pool, njt_http_access_range_t *ranges,
+    njt_uint_t n, njt_uint_t words)
+{
+    uint32_t                 pos[4];
+    njt_uint_t               i, k, top, max;
+    njt_http_access_cidr_t   tmp, *cidr;
+    njt_http_access_open_t  *open, *o;
+    njt_http_access_range_t *r;
+
+    njt_qsort(ranges, n, sizeof(njt_http_access_range_t),
+              njt_http_access_range_cmp);
+
+    cidr = NULL;
+
+    tmp.nranges = 0;
+    tmp.words = words;
+    tmp.start = njt_alloc((2 * n + 1) * words * sizeof(uint32_t), pool->log);
+    tmp.result = njt_alloc(2 * n + 1, pool->log);
+    open = njt_alloc((n + 1) * sizeof(njt_http_access_open_t), pool->log);
+
+    if (tmp.start == NULL || tmp.result == NULL || open == NULL) {
+        goto done;
+    }
+
+    njt_memzero(pos, sizeof(pos));
+    njt_http_access_append(&tmp, pos, NJT_HTTP_ACCESS_NONE);
+
+    top = 0;
+
+    for (i = 0; i <= n; i++) {
+        r = (i < n) ? &ranges[i] : NULL;
+
+        /* close the prefixes ending before this one */
+
+        while (top) {
+            o = &open[top - 1];
+
+            if (r && njt_http_access_cmp(o->range->hi, r->lo, words) >= 0) {
+                break;
+            }
+
+            max = 1;
+
+            for (k = 0; k < words; k++) {
+                if (o->range->hi[k] != 0xffffffff) {
+                    max = 0;
+                }
+            }
+
+            if (max) {
+                /* all the remaining ones end at the last address as well */
+                top = 0;
+                break;
+            }
+
+            njt_memcpy(pos, o->range->hi, words * sizeof(uint32_t));
+
+            for (k = words; k-- > 0; ) {
+                if (++pos[k] != 0) {
+                    break;
+                }
+            }
+
+            top--;
+
+            njt_http_access_append(&tmp, pos, top ? open[top - 1].deny
+                                                  : NJT_HTTP_ACCESS_NONE);
+        }
+
+        if (r == NULL) {
+            break;
+        }
+
+        o = &open[top];
+        o->range = r;
+        o->index = r->index;
+        o->deny = r->deny;
+
+        if (top && open[top - 1].index < r->index) {
+            o->index = open[top - 1].index;
+            o->deny = open[top - 1].deny;
+        }
+
+        top++;
+
+        njt_http_access_append(&tmp, r->lo, o->deny);
+    }
+
+    cidr = njt_palloc(pool, sizeof(njt_http_access_cidr_t));
+    if (cidr == NULL) {
+        goto done;
+    }
+
+    cidr->nranges = tmp.nranges;
+    cidr->words = words;
+    cidr->start = njt_palloc(pool, tmp.nranges * words * sizeof(uint32_t));
+    cidr->result = njt_pnalloc(pool, tmp.nranges);
+
+    if (cidr->start == NULL || cidr->result == NULL) {
+        cidr = NULL;
+        goto done;
+    }
+
+    njt_memcpy(cidr->start, tmp.start, tmp.nranges * words * sizeof(uint32_t));
+    njt_memcpy(cidr->result, tmp.result, tmp.nranges);
+
+    njt_log_debug3(NJT_LOG_DEBUG_HTTP, pool->log, 0,
+                   "access: %ui rules compiled into %ui ranges of %ui words",
+                   n, cidr->nranges, words);
+
+done:
+
+    if (tmp.start) {
+        njt_free(tmp.start);
+    }
+
+    if (tmp.result) {
+        njt_free(tmp.result);
+    }
+
+    if (open) {
+        njt_free(open);
+    }
+
+    return cidr;
+}
+
+
+static void
+njt_http_access_append(njt_http_access_cidr_t *cidr, uint32_t *pos,
+    njt_uint_t value)
+{
+    njt_uint_t  n, w;
+
+    n = cidr->nranges;
+    w = cidr->words;
+
+    /* a later boundary at the same address overrides the previous one */
+
+    if (n && njt_http_access_cmp(&cidr->start[(n - 1) * w], pos, w) == 0) {
+        n--;
+    }
+
+    if (n && cidr->result[n - 1] == value) {
+        cidr->nranges = n;
+        return;
+    }
+
+    njt_memcpy(&cidr->start[n * w], pos, w * sizeof(uint32_t));
+    cidr->result[n] = (u_char) value;
+    cidr->nranges = n + 1;
+}
+
+
 static char *
 njt_http_access_rule(njt_conf_t *cf, njt_command_t *cmd, void *conf)
 {
@@ -404,6 +848,21 @@ njt_http_access_merge_loc_conf(njt_conf_t *cf, void *parent, void *child)
 #if (NJT_HAVE_UNIX_DOMAIN)
         conf->rules_un = prev->rules_un;
 #endif
+        conf->cidr = prev->cidr;
+#if (NJT_HAVE_INET6)
+        conf->cidr6 = prev->cidr6;
+#endif
+    }
+
+    if (conf->cidr == NULL
+#if (NJT_HAVE_INET6)
+        && conf->cidr6 == NULL
+#endif
+       )
+    {
+        if (njt_http_access_compile(cf->pool, conf) != NJT_OK) {
+            return NJT_CONF_ERROR;
+        }
     }
 
     return NJT_CONF_OK;
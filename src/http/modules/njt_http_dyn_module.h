@@ -24,10 +24,26 @@
 
 #define NJT_HTTP_DYN_LOG 1
 
+typedef struct {
+    /* 64-bit fingerprint of the key, 0 means the slot is empty */
+    njt_atomic_t                 id;
+    /* theoretical arrival time in usec, updated by cas only */
+    njt_atomic_t                 tat;
+} njt_http_limit_req_slot_t;
+
+typedef struct {
+    njt_uint_t                   nstripes;
+    /* power of 2 */
+    njt_uint_t                   stripe_size;
+    njt_atomic_t                *locks;
+    njt_http_limit_req_slot_t   *slots;
+} njt_http_limit_req_gcra_t;
+
 typedef struct {
     njt_rbtree_t                  rbtree;
     njt_rbtree_node_t             sentinel;
     njt_queue_t                   queue;
+    njt_http_limit_req_gcra_t    *gcra;
 } njt_http_limit_req_shctx_t;
 
 typedef struct {
@@ -53,6 +69,11 @@ typedef struct {
 #endif
     njt_http_complex_value_t     key;
     njt_http_limit_req_node_t *node;
+    /* engine=gcra, 0 means the rbtree engine */
+    njt_uint_t                   stripes;
+    njt_http_limit_req_gcra_t   *gcra;
+    njt_http_limit_req_slot_t   *slot;
+    njt_atomic_uint_t            slot_id;
 } njt_http_limit_req_ctx_t;
 
 typedef struct {
@@ -156,6 +177,21 @@ typedef struct {
 
 #endif
 
+#define NJT_HTTP_ACCESS_NONE  2
+
+/*
+ * rules compiled into disjoint address ranges: range i covers
+ * [start[i], start[i + 1]) and result[i] is the deny flag of the first
+ * rule matching it, or NJT_HTTP_ACCESS_NONE; an address is "words"
+ * host order 32-bit words, 1 for IPv4 and 4 for IPv6
+ */
+typedef struct {
+    njt_uint_t       nranges;
+    njt_uint_t       words;
+    uint32_t        *start;
+    u_char          *result;
+} njt_http_access_cidr_t;
+
 typedef struct {
     njt_array_t *rules;     /* array of njt_http_access_rule_t */
 #if (NJT_HAVE_INET6)
@@ -165,8 +201,15 @@ typedef struct {
     njt_array_t *rules_un;  /* array of njt_http_access_rule_un_t */
 #endif
     njt_int_t        dynamic;
+    njt_http_access_cidr_t  *cidr;
+#if (NJT_HAVE_INET6)
+    njt_http_access_cidr_t  *cidr6;
+#endif
 } njt_http_access_loc_conf_t;
 
+njt_int_t njt_http_access_compile(njt_pool_t *pool,
+    njt_http_access_loc_conf_t *alcf);
+
 
 typedef struct njt_http_dyn_access_api_loc_s njt_http_dyn_access_api_loc_t;
 
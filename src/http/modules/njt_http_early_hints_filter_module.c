@@ -0,0 +1,948 @@
+
+/*
+ * Copyright (C) 2021-2023  TMLake(Beijing) Technology Co., Ltd.
+ */
+
+
+#include <njt_config.h>
+#include <njt_core.h>
+#include <njt_http.h>
+
+
+/* the links learned for a single key, separated by LF */
+#define NJT_HTTP_EARLY_HINTS_MAX_SIZE  2048
+
+
+typedef struct {
+    u_char                       color;
+    u_char                       dummy;
+    u_short                      len;
+    u_short                      size;
+    njt_queue_t                  queue;
+    u_char                       data[1];
+} njt_http_early_hints_node_t;
+
+
+typedef struct {
+    njt_rbtree_t                 rbtree;
+    njt_rbtree_node_t            sentinel;
+    njt_queue_t                  queue;
+} njt_http_early_hints_shctx_t;
+
+
+typedef struct {
+    njt_http_early_hints_shctx_t  *sh;
+    njt_slab_pool_t              *shpool;
+} njt_http_early_hints_ctx_t;
+
+
+typedef struct {
+    njt_array_t                 *predicates;
+    njt_array_t                 *links;        /* njt_http_complex_value_t */
+    njt_shm_zone_t              *shm_zone;
+    njt_http_complex_value_t    *key;
+} njt_http_early_hints_conf_t;
+
+
+static njt_int_t njt_http_early_hints_handler(njt_http_request_t *r);
+static njt_int_t njt_http_early_hints_header_filter(njt_http_request_t *r);
+static njt_int_t njt_http_early_hints_key(njt_http_request_t *r,
+    njt_http_early_hints_conf_t *ehcf, njt_str_t *key);
+static njt_int_t njt_http_early_hints_lookup(njt_http_request_t *r,
+    njt_shm_zone_t *shm_zone, njt_str_t *key, njt_list_t *headers);
+static void njt_http_early_hints_learn(njt_http_request_t *r,
+    njt_shm_zone_t *shm_zone, njt_str_t *key, njt_str_t *links);
+static njt_http_early_hints_node_t *njt_http_early_hints_find(
+    njt_http_early_hints_ctx_t *ctx, njt_str_t *key, uint32_t hash);
+static void njt_http_early_hints_expire(njt_http_early_hints_ctx_t *ctx);
+static void njt_http_early_hints_rbtree_insert_value(njt_rbtree_node_t *temp,
+    njt_rbtree_node_t *node, njt_rbtree_node_t *sentinel);
+static njt_int_t njt_http_early_hints_init_zone(njt_shm_zone_t *shm_zone,
+    void *data);
+static void *njt_http_early_hints_create_conf(njt_conf_t *cf);
+static char *njt_http_early_hints_merge_conf(njt_conf_t *cf, void *parent,
+    void *child);
+static char *njt_http_early_hints_link(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf);
+static char *njt_http_early_hints_zone(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf);
+static char *njt_http_early_hints_learn_conf(njt_conf_t *cf,
+    njt_command_t *cmd, void *conf);
+static njt_int_t njt_http_early_hints_init(njt_conf_t *cf);
+
+
+static njt_command_t  njt_http_early_hints_commands[] = {
+
+    { njt_string("early_hints"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_1MORE,
+      njt_http_set_predicate_slot,
+      NJT_HTTP_LOC_CONF_OFFSET,
+      offsetof(njt_http_early_hints_conf_t, predicates),
+      NULL },
+
+    { njt_string("early_hints_link"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_TAKE1,
+      njt_http_early_hints_link,
+      NJT_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+    { njt_string("early_hints_zone"),
+      NJT_HTTP_MAIN_CONF|NJT_CONF_TAKE1,
+      njt_http_early_hints_zone,
+      0,
+      0,
+      NULL },
+
+    { njt_string("early_hints_learn"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_TAKE12,
+      njt_http_early_hints_learn_conf,
+      NJT_HTTP_LOC_CONF_OFFSET,
+      0,
+      NULL },
+
+      njt_null_command
+};
+
+
+static njt_http_module_t  njt_http_early_hints_filter_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    njt_http_early_hints_init,             /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    njt_http_early_hints_create_conf,      /* create location configuration */
+    njt_http_early_hints_merge_conf        /* merge location configuration */
+};
+
+
+njt_module_t  njt_http_early_hints_filter_module = {
+    NJT_MODULE_V1,
+    &njt_http_early_hints_filter_module_ctx, /* module context */
+    njt_http_early_hints_commands,         /* module directives */
+    NJT_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NJT_MODULE_V1_PADDING
+};
+
+
+static njt_http_output_header_filter_pt  njt_http_next_header_filter;
+
+
+static njt_int_t
+njt_http_early_hints_handler(njt_http_request_t *r)
+{
+    njt_int_t                     rc;
+    njt_str_t                     key, value;
+    njt_uint_t                    i;
+    njt_list_t                    headers;
+    njt_table_elt_t              *h;
+    njt_http_complex_value_t     *cv;
+    njt_http_early_hints_conf_t  *ehcf;
+
+    if (r != r->main || r->early_hints_sent) {
+        return NJT_DECLINED;
+    }
+
+    if (!(r->method & (NJT_HTTP_GET|NJT_HTTP_HEAD))) {
+        return NJT_DECLINED;
+    }
+
+    ehcf = njt_http_get_module_loc_conf(r, njt_http_early_hints_filter_module);
+
+    if (ehcf->links == NULL && ehcf->shm_zone == NULL) {
+        return NJT_DECLINED;
+    }
+
+    if (ehcf->predicates
+        && njt_http_test_predicates(r, ehcf->predicates) != NJT_DECLINED)
+    {
+        return NJT_DECLINED;
+    }
+
+    if (njt_list_init(&headers, r->pool, 4, sizeof(njt_table_elt_t))
+        != NJT_OK)
+    {
+        return NJT_ERROR;
+    }
+
+    if (ehcf->links) {
+        cv = ehcf->links->elts;
+
+        for (i = 0; i < ehcf->links->nelts; i++) {
+
+            if (njt_http_complex_value(r, &cv[i], &value) != NJT_OK) {
+                return NJT_ERROR;
+            }
+
+            if (value.len == 0) {
+                continue;
+            }
+
+            h = njt_list_push(&headers);
+            if (h == NULL) {
+                return NJT_ERROR;
+            }
+
+            h->hash = 1;
+            njt_str_set(&h->key, "Link");
+            h->value = value;
+            h->next = NULL;
+        }
+    }
+
+    if (ehcf->shm_zone) {
+
+        if (njt_http_early_hints_key(r, ehcf, &key) != NJT_OK) {
+            return NJT_ERROR;
+        }
+
+        if (njt_http_early_hints_lookup(r, ehcf->shm_zone, &key, &headers)
+            != NJT_OK)
+        {
+            return NJT_ERROR;
+        }
+    }
+
+    if (headers.part.nelts == 0) {
+        return NJT_DECLINED;
+    }
+
+    rc = njt_http_send_early_hints(r, &headers);
+
+    njt_log_debug1(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "early hints: %i", rc);
+
+    if (rc == NJT_ERROR) {
+        return NJT_ERROR;
+    }
+
+    return NJT_DECLINED;
+}
+
+
+static njt_int_t
+njt_http_early_hints_header_filter(njt_http_request_t *r)
+{
+    u_char                       *p, *last;
+    njt_str_t                     key, links;
+    njt_uint_t                    i;
+    njt_list_part_t              *part;
+    njt_table_elt_t              *header;
+    njt_http_early_hints_conf_t  *ehcf;
+
+    if (r != r->main
+        || r->headers_out.status != NJT_HTTP_OK
+        || !(r->method & (NJT_HTTP_GET|NJT_HTTP_HEAD)))
+    {
+        return njt_http_next_header_filter(r);
+    }
+
+    ehcf = njt_http_get_module_loc_conf(r, njt_http_early_hints_filter_module);
+
+    if (ehcf->shm_zone == NULL) {
+        return njt_http_next_header_filter(r);
+    }
+
+    p = njt_pnalloc(r->pool, NJT_HTTP_EARLY_HINTS_MAX_SIZE);
+    if (p == NULL) {
+        return NJT_ERROR;
+    }
+
+    links.data = p;
+    last = p + NJT_HTTP_EARLY_HINTS_MAX_SIZE;
+
+    part = &r->headers_out.headers.part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0
+            || header[i].key.len != sizeof("Link") - 1
+            || njt_strncasecmp(header[i].key.data, (u_char *) "Link",
+                               sizeof("Link") - 1)
+               != 0)
+        {
+            continue;
+        }
+
+        /* "preload" also matches "modulepreload" */
+
+        if (njt_strlcasestrn(header[i].value.data,
+                             header[i].value.data + header[i].value.len,
+                             (u_char *) "preload", sizeof("preload") - 2)
+            == NULL
+            && njt_strlcasestrn(header[i].value.data,
+                                header[i].value.data + header[i].value.len,
+                                (u_char *) "preconnect",
+                                sizeof("preconnect") - 2)
+               == NULL)
+        {
+            continue;
+        }
+
+        if (njt_strlchr(header[i].value.data,
+                        header[i].value.data + header[i].value.len, LF)
+            != NULL)
+        {
+            continue;
+        }
+
+        if ((size_t) (last - p) < header[i].value.len + 1) {
+            njt_log_error(NJT_LOG_WARN, r->connection->log, 0,
+                          "early hints for this response exceed %d bytes, "
+                          "the rest are not learned",
+                          NJT_HTTP_EARLY_HINTS_MAX_SIZE);
+            break;
+        }
+
+        if (p != links.data) {
+            *p++ = LF;
+        }
+
+        p = njt_cpymem(p, header[i].value.data, header[i].value.len);
+    }
+
+    links.len = p - links.data;
+
+    if (njt_http_early_hints_key(r, ehcf, &key) != NJT_OK) {
+        return NJT_ERROR;
+    }
+
+    njt_http_early_hints_learn(r, ehcf->shm_zone, &key, &links);
+
+    return njt_http_next_header_filter(r);
+}
+
+
+static njt_int_t
+njt_http_early_hints_key(njt_http_request_t *r,
+    njt_http_early_hints_conf_t *ehcf, njt_str_t *key)
+{
+    u_char                    *p;
+    njt_http_core_loc_conf_t  *clcf;
+    njt_http_core_srv_conf_t  *cscf;
+
+    if (ehcf->key) {
+        if (njt_http_complex_value(r, ehcf->key, key) != NJT_OK) {
+            return NJT_ERROR;
+        }
+
+    } else {
+
+        /* the server name and the location the response came from */
+
+        cscf = njt_http_get_module_srv_conf(r, njt_http_core_module);
+        clcf = njt_http_get_module_loc_conf(r, njt_http_core_module);
+
+        key->len = cscf->server_name.len + 1 + clcf->name.len;
+
+        key->data = njt_pnalloc(r->pool, key->len);
+        if (key->data == NULL) {
+            return NJT_ERROR;
+        }
+
+        p = njt_cpymem(key->data, cscf->server_name.data,
+                       cscf->server_name.len);
+        *p++ = ' ';
+        njt_memcpy(p, clcf->name.data, clcf->name.len);
+    }
+
+    if (key->len > 65535) {
+        key->len = 65535;
+    }
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_early_hints_lookup(njt_http_request_t *r, njt_shm_zone_t *shm_zone,
+    njt_str_t *key, njt_list_t *headers)
+{
+    u_char                       *p, *last, *lf;
+    njt_str_t                     links;
+    njt_table_elt_t              *h;
+    njt_http_early_hints_ctx_t   *ctx;
+    njt_http_early_hints_node_t  *ehn;
+
+    ctx = shm_zone->data;
+
+    links.len = 0;
+    links.data = njt_pnalloc(r->pool, NJT_HTTP_EARLY_HINTS_MAX_SIZE);
+    if (links.data == NULL) {
+        return NJT_ERROR;
+    }
+
+    njt_shmtx_lock(&ctx->shpool->mutex);
+
+    ehn = njt_http_early_hints_find(ctx, key, njt_crc32_short(key->data,
+                                                              key->len));
+
+    if (ehn) {
+        njt_queue_remove(&ehn->queue);
+        njt_queue_insert_head(&ctx->sh->queue, &ehn->queue);
+
+        links.len = ehn->size;
+        njt_memcpy(links.data, ehn->data + ehn->len, links.len);
+    }
+
+    njt_shmtx_unlock(&ctx->shpool->mutex);
+
+    if (links.len == 0) {
+        return NJT_OK;
+    }
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "early hints learned for \"%V\": \"%V\"", key, &links);
+
+    p = links.data;
+    last = links.data + links.len;
+
+    while (p < last) {
+        lf = njt_strlchr(p, last, LF);
+
+        if (lf == NULL) {
+            lf = last;
+        }
+
+        h = njt_list_push(headers);
+        if (h == NULL) {
+            return NJT_ERROR;
+        }
+
+        h->hash = 1;
+        njt_str_set(&h->key, "Link");
+        h->value.len = lf - p;
+        h->value.data = p;
+        h->next = NULL;
+
+        p = lf + 1;
+    }
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_early_hints_learn(njt_http_request_t *r, njt_shm_zone_t *shm_zone,
+    njt_str_t *key, njt_str_t *links)
+{
+    size_t                        n;
+    uint32_t                      hash;
+    njt_rbtree_node_t            *node;
+    njt_http_early_hints_ctx_t   *ctx;
+    njt_http_early_hints_node_t  *ehn;
+
+    ctx = shm_zone->data;
+    hash = njt_crc32_short(key->data, key->len);
+
+    njt_shmtx_lock(&ctx->shpool->mutex);
+
+    ehn = njt_http_early_hints_find(ctx, key, hash);
+
+    if (ehn) {
+        if (ehn->size == links->len
+            && njt_memcmp(ehn->data + ehn->len, links->data, links->len) == 0)
+        {
+            njt_queue_remove(&ehn->queue);
+            njt_queue_insert_head(&ctx->sh->queue, &ehn->queue);
+
+            njt_shmtx_unlock(&ctx->shpool->mutex);
+            return;
+        }
+
+        /* the links have changed or are gone */
+
+        node = (njt_rbtree_node_t *)
+                   ((u_char *) ehn - offsetof(njt_rbtree_node_t, color));
+
+        njt_queue_remove(&ehn->queue);
+        njt_rbtree_delete(&ctx->sh->rbtree, node);
+        njt_slab_free_locked(ctx->shpool, node);
+    }
+
+    if (links->len == 0) {
+        njt_shmtx_unlock(&ctx->shpool->mutex);
+        return;
+    }
+
+    n = offsetof(njt_rbtree_node_t, color)
+        + offsetof(njt_http_early_hints_node_t, data)
+        + key->len + links->len;
+
+    node = njt_slab_alloc_locked(ctx->shpool, n);
+
+    while (node == NULL && !njt_queue_empty(&ctx->sh->queue)) {
+        njt_http_early_hints_expire(ctx);
+        node = njt_slab_alloc_locked(ctx->shpool, n);
+    }
+
+    if (node == NULL) {
+        njt_shmtx_unlock(&ctx->shpool->mutex);
+
+        njt_log_error(NJT_LOG_ALERT, r->connection->log, 0,
+                      "could not allocate node%s", ctx->shpool->log_ctx);
+        return;
+    }
+
+    node->key = hash;
+
+    ehn = (njt_http_early_hints_node_t *) &node->color;
+
+    ehn->len = (u_short) key->len;
+    ehn->size = (u_short) links->len;
+
+    njt_memcpy(ehn->data, key->data, key->len);
+    njt_memcpy(ehn->data + key->len, links->data, links->len);
+
+    njt_rbtree_insert(&ctx->sh->rbtree, node);
+    njt_queue_insert_head(&ctx->sh->queue, &ehn->queue);
+
+    njt_shmtx_unlock(&ctx->shpool->mutex);
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "early hints learned for \"%V\": \"%V\"", key, links);
+}
+
+
+static njt_http_early_hints_node_t *
+njt_http_early_hints_find(njt_http_early_hints_ctx_t *ctx, njt_str_t *key,
+    uint32_t hash)
+{
+    njt_int_t                     rc;
+    njt_rbtree_node_t            *node, *sentinel;
+    njt_http_early_hints_node_t  *ehn;
+
+    node = ctx->sh->rbtree.root;
+    sentinel = ctx->sh->rbtree.sentinel;
+
+    while (node != sentinel) {
+
+        if (hash < node->key) {
+            node = node->left;
+            continue;
+        }
+
+        if (hash > node->key) {
+            node = node->right;
+            continue;
+        }
+
+        /* hash == node->key */
+
+        ehn = (njt_http_early_hints_node_t *) &node->color;
+
+        rc = njt_memn2cmp(key->data, ehn->data, key->len, (size_t) ehn->len);
+
+        if (rc == 0) {
+            return ehn;
+        }
+
+        node = (rc < 0) ? node->left : node->right;
+    }
+
+    return NULL;
+}
+
+
+static void
+njt_http_early_hints_expire(njt_http_early_hints_ctx_t *ctx)
+{
+    njt_queue_t                  *q;
+    njt_rbtree_node_t            *node;
+    njt_http_early_hints_node_t  *ehn;
+
+    /* the least recently used key goes first */
+
+    q = njt_queue_last(&ctx->sh->queue);
+
+    ehn = njt_queue_data(q, njt_http_early_hints_node_t, queue);
+
+    njt_queue_remove(q);
+
+    node = (njt_rbtree_node_t *)
+               ((u_char *) ehn - offsetof(njt_rbtree_node_t, color));
+
+    njt_rbtree_delete(&ctx->sh->rbtree, node);
+
+    njt_slab_free_locked(ctx->shpool, node);
+}
+
+
+static void
+njt_http_early_hints_rbtree_insert_value(njt_rbtree_node_t *temp,
+    njt_rbtree_node_t *node, njt_rbtree_node_t *sentinel)
+{
+    njt_rbtree_node_t            **p;
+    njt_http_early_hints_node_t   *ehn, *ehnt;
+
+    for ( ;; ) {
+
+        if (node->key < temp->key) {
+
+            p = &temp->left;
+
+        } else if (node->key > temp->key) {
+
+            p = &temp->right;
+
+        } else { /* node->key == temp->key */
+
+            ehn = (njt_http_early_hints_node_t *) &node->color;
+            ehnt = (njt_http_early_hints_node_t *) &temp->color;
+
+            p = (njt_memn2cmp(ehn->data, ehnt->data, ehn->len, ehnt->len) < 0)
+                ? &temp->left : &temp->right;
+        }
+
+        if (*p == sentinel) {
+            break;
+        }
+
+        temp = *p;
+    }
+
+    *p = node;
+    node->parent = temp;
+    node->left = sentinel;
+    node->right = sentinel;
+    njt_rbt_red(node);
+}
+
+
+static njt_int_t
+njt_http_early_hints_init_zone(njt_shm_zone_t *shm_zone, void *data)
+{
+    njt_http_early_hints_ctx_t  *octx = data;
+
+    size_t                       len;
+    njt_http_early_hints_ctx_t  *ctx;
+
+    ctx = shm_zone->data;
+
+    if (octx) {
+        ctx->sh = octx->sh;
+        ctx->shpool = octx->shpool;
+
+        return NJT_OK;
+    }
+
+    ctx->shpool = (njt_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        ctx->sh = ctx->shpool->data;
+
+        return NJT_OK;
+    }
+
+    ctx->sh = njt_slab_alloc(ctx->shpool,
+                             sizeof(njt_http_early_hints_shctx_t));
+    if (ctx->sh == NULL) {
+        return NJT_ERROR;
+    }
+
+    ctx->shpool->data = ctx->sh;
+
+    njt_rbtree_init(&ctx->sh->rbtree, &ctx->sh->sentinel,
+                    njt_http_early_hints_rbtree_insert_value);
+
+    njt_queue_init(&ctx->sh->queue);
+
+    len = sizeof(" in early_hints zone \"\"") + shm_zone->shm.name.len;
+
+    ctx->shpool->log_ctx = njt_slab_alloc(ctx->shpool, len);
+    if (ctx->shpool->log_ctx == NULL) {
+        return NJT_ERROR;
+    }
+
+    njt_sprintf(ctx->shpool->log_ctx, " in early_hints zone \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    ctx->shpool->log_nomem = 0;
+
+    return NJT_OK;
+}
+
+
+static void *
+njt_http_early_hints_create_conf(njt_conf_t *cf)
+{
+    njt_http_early_hints_conf_t  *conf;
+
+    conf = njt_pcalloc(cf->pool, sizeof(njt_http_early_hints_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by njt_pcalloc():
+     *
+     *     conf->links = NULL;
+     *     conf->key = NULL;
+     */
+
+    conf->predicates = NJT_CONF_UNSET_PTR;
+    conf->shm_zone = NJT_CONF_UNSET_PTR;
+
+    return conf;
+}
+
+
+static char *
+njt_http_early_hints_merge_conf(njt_conf_t *cf, void *parent, void *child)
+{
+    njt_http_early_hints_conf_t *prev = parent;
+    njt_http_early_hints_conf_t *conf = child;
+
+    njt_conf_merge_ptr_value(conf->predicates, prev->predicates, NULL);
+
+    if (conf->links == NULL) {
+        conf->links = prev->links;
+    }
+
+    if (conf->shm_zone == NJT_CONF_UNSET_PTR) {
+        conf->shm_zone = prev->shm_zone;
+        conf->key = prev->key;
+    }
+
+    if (conf->shm_zone == NJT_CONF_UNSET_PTR) {
+        conf->shm_zone = NULL;
+    }
+
+    return NJT_CONF_OK;
+}
+
+
+static char *
+njt_http_early_hints_link(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_early_hints_conf_t *ehcf = conf;
+
+    njt_str_t                         *value;
+    njt_http_complex_value_t          *cv;
+    njt_http_compile_complex_value_t   ccv;
+
+    value = cf->args->elts;
+
+    if (ehcf->links == NULL) {
+        ehcf->links = njt_array_create(cf->pool, 4,
+                                       sizeof(njt_http_complex_value_t));
+        if (ehcf->links == NULL) {
+            return NJT_CONF_ERROR;
+        }
+    }
+
+    if (njt_strlchr(value[1].data, value[1].data + value[1].len, LF) != NULL) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid link \"%V\"", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    cv = njt_array_push(ehcf->links);
+    if (cv == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    njt_memzero(&ccv, sizeof(njt_http_compile_complex_value_t));
+
+    ccv.cf = cf;
+    ccv.value = &value[1];
+    ccv.complex_value = cv;
+
+    if (njt_http_compile_complex_value(&ccv) != NJT_OK) {
+        return NJT_CONF_ERROR;
+    }
+
+    return NJT_CONF_OK;
+}
+
+
+static char *
+njt_http_early_hints_zone(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    u_char                      *p;
+    ssize_t                      size;
+    njt_str_t                   *value, name, s;
+    njt_shm_zone_t              *shm_zone;
+    njt_http_early_hints_ctx_t  *ctx;
+
+    value = cf->args->elts;
+
+    if (njt_strncmp(value[1].data, "zone=", 5) != 0) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    name.data = value[1].data + 5;
+
+    p = (u_char *) njt_strchr(name.data, ':');
+
+    if (p == NULL) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    name.len = p - name.data;
+
+    s.data = p + 1;
+    s.len = value[1].data + value[1].len - s.data;
+
+    size = njt_parse_size(&s);
+
+    if (size == NJT_ERROR) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid zone size \"%V\"", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    if (size < (ssize_t) (8 * njt_pagesize)) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "zone \"%V\" is too small", &value[1]);
+        return NJT_CONF_ERROR;
+    }
+
+    ctx = njt_pcalloc(cf->pool, sizeof(njt_http_early_hints_ctx_t));
+    if (ctx == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    shm_zone = njt_shared_memory_add(cf, &name, size,
+                                     &njt_http_early_hints_filter_module);
+    if (shm_zone == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    if (shm_zone->data) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "duplicate zone \"%V\"", &name);
+        return NJT_CONF_ERROR;
+    }
+
+    shm_zone->init = njt_http_early_hints_init_zone;
+    shm_zone->data = ctx;
+
+    return NJT_CONF_OK;
+}
+
+
+static char *
+njt_http_early_hints_learn_conf(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf)
+{
+    njt_http_early_hints_conf_t *ehcf = conf;
+
+    njt_str_t                         *value, s;
+    njt_uint_t                         i;
+    njt_http_compile_complex_value_t   ccv;
+
+    if (ehcf->shm_zone != NJT_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (cf->args->nelts == 2 && njt_strcmp(value[1].data, "off") == 0) {
+        ehcf->shm_zone = NULL;
+        return NJT_CONF_OK;
+    }
+
+    ehcf->shm_zone = NULL;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (njt_strncmp(value[i].data, "zone=", 5) == 0) {
+
+            s.len = value[i].len - 5;
+            s.data = value[i].data + 5;
+
+            ehcf->shm_zone = njt_shared_memory_add(cf, &s, 0,
+                                          &njt_http_early_hints_filter_module);
+            if (ehcf->shm_zone == NULL) {
+                return NJT_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "key=", 4) == 0) {
+
+            s.len = value[i].len - 4;
+            s.data = value[i].data + 4;
+
+            ehcf->key = njt_palloc(cf->pool, sizeof(njt_http_complex_value_t));
+            if (ehcf->key == NULL) {
+                return NJT_CONF_ERROR;
+            }
+
+            njt_memzero(&ccv, sizeof(njt_http_compile_complex_value_t));
+
+            ccv.cf = cf;
+            ccv.value = &s;
+            ccv.complex_value = ehcf->key;
+
+            if (njt_http_compile_complex_value(&ccv) != NJT_OK) {
+                return NJT_CONF_ERROR;
+            }
+
+            continue;
+        }
+
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NJT_CONF_ERROR;
+    }
+
+    if (ehcf->shm_zone == NULL) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "\"%V\" must have \"zone\" parameter",
+                           &cmd->name);
+        return NJT_CONF_ERROR;
+    }
+
+    return NJT_CONF_OK;
+}
+
+
+static njt_int_t
+njt_http_early_hints_init(njt_conf_t *cf)
+{
+    njt_http_handler_pt        *h;
+    njt_http_core_main_conf_t  *cmcf;
+
+    cmcf = njt_http_conf_get_module_main_conf(cf, njt_http_core_module);
+
+    h = njt_array_push(&cmcf->phases[NJT_HTTP_PRECONTENT_PHASE].handlers);
+    if (h == NULL) {
+        return NJT_ERROR;
+    }
+
+    *h = njt_http_early_hints_handler;
+
+    njt_http_next_header_filter = njt_http_top_header_filter;
+    njt_http_top_header_filter = njt_http_early_hints_header_filter;
+
+    return NJT_OK;
+}
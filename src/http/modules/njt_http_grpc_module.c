@@ -9,14 +9,7 @@
 #include <njt_config.h>
 #include <njt_core.h>
 #include <njt_http.h>
-
-
-typedef struct {
-    njt_array_t               *flushes;
-    njt_array_t               *lengths;
-    njt_array_t               *values;
-    njt_hash_t                 hash;
-} njt_http_grpc_headers_t;
+#include <njt_http_grpc_module.h>
 
 
 typedef struct {
@@ -127,6 +120,10 @@ typedef struct {
     njt_http_request_t        *request;
 
     njt_str_t                  host;
+    njt_str_t                  path;
+
+    njt_http_grpc_headers_t   *headers;
+    njt_uint_t                 host_set;
 } njt_http_grpc_ctx_t;
 
 
@@ -145,6 +142,8 @@ typedef struct {
 
 static njt_int_t njt_http_grpc_eval(njt_http_request_t *r,
     njt_http_grpc_ctx_t *ctx, njt_http_grpc_loc_conf_t *glcf);
+static void njt_http_grpc_set_handlers(njt_http_request_t *r,
+    njt_http_grpc_ctx_t *ctx);
  njt_int_t njt_http_grpc_create_request(njt_http_request_t *r);
 static njt_int_t njt_http_grpc_reinit_request(njt_http_request_t *r);
 njt_int_t njt_http_grpc_body_output_filter(void *data, njt_chain_t *in);
@@ -583,19 +582,12 @@ njt_http_grpc_handler(njt_http_request_t *r)
         }
     }
 
-    u->output.tag = (njt_buf_tag_t) &njt_http_grpc_module;
-
     u->conf = &glcf->upstream;
 
-    u->create_request = njt_http_grpc_create_request;
-    u->reinit_request = njt_http_grpc_reinit_request;
-    u->process_header = njt_http_grpc_process_header;
-    u->abort_request = njt_http_grpc_abort_request;
-    u->finalize_request = njt_http_grpc_finalize_request;
+    ctx->headers = &glcf->headers;
+    ctx->host_set = glcf->host_set;
 
-    u->input_filter_init = njt_http_grpc_filter_init;
-    u->input_filter = njt_http_grpc_filter;
-    u->input_filter_ctx = ctx;
+    njt_http_grpc_set_handlers(r, ctx);
 
     r->request_body_no_buffering = 1;
 
@@ -609,6 +601,66 @@ njt_http_grpc_handler(njt_http_request_t *r)
 }
 
 
+njt_int_t
+njt_http_grpc_v2_upstream_init(njt_http_request_t *r, njt_str_t *host,
+    njt_str_t *path, njt_http_grpc_headers_t *headers, njt_uint_t host_set)
+{
+    njt_http_upstream_t  *u;
+    njt_http_grpc_ctx_t  *ctx;
+
+    /*
+     * r->upstream is expected to be created by the caller, with
+     * u->conf, u->schema, u->ssl and u->resolved already set;
+     * u->conf must have buffering switched off
+     */
+
+    ctx = njt_pcalloc(r->pool, sizeof(njt_http_grpc_ctx_t));
+    if (ctx == NULL) {
+        return NJT_ERROR;
+    }
+
+    ctx->request = r;
+    ctx->host = *host;
+    ctx->headers = headers;
+
+    if (path) {
+        ctx->path = *path;
+    }
+    ctx->host_set = host_set;
+
+    njt_http_set_ctx(r, ctx, njt_http_grpc_module);
+
+    u = r->upstream;
+
+    njt_http_grpc_set_handlers(r, ctx);
+
+    u->buffering = 0;
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_grpc_set_handlers(njt_http_request_t *r, njt_http_grpc_ctx_t *ctx)
+{
+    njt_http_upstream_t  *u;
+
+    u = r->upstream;
+
+    u->output.tag = (njt_buf_tag_t) &njt_http_grpc_module;
+
+    u->create_request = njt_http_grpc_create_request;
+    u->reinit_request = njt_http_grpc_reinit_request;
+    u->process_header = njt_http_grpc_process_header;
+    u->abort_request = njt_http_grpc_abort_request;
+    u->finalize_request = njt_http_grpc_finalize_request;
+
+    u->input_filter_init = njt_http_grpc_filter_init;
+    u->input_filter = njt_http_grpc_filter;
+    u->input_filter_ctx = ctx;
+}
+
+
 static njt_int_t
 njt_http_grpc_eval(njt_http_request_t *r, njt_http_grpc_ctx_t *ctx,
     njt_http_grpc_loc_conf_t *glcf)
@@ -721,16 +773,16 @@ njt_http_grpc_create_request(njt_http_request_t *r)
     njt_http_upstream_t          *u;
     njt_http_grpc_frame_t        *f;
     njt_http_script_code_pt       code;
-    njt_http_grpc_loc_conf_t     *glcf;
+    njt_http_grpc_headers_t      *headers;
     njt_http_script_engine_t      e, le;
     njt_http_script_len_code_pt   lcode;
 
     u = r->upstream;
 
-    glcf = njt_http_get_module_loc_conf(r, njt_http_grpc_module);
-
     ctx = njt_http_get_module_ctx(r, njt_http_grpc_module);
 
+    headers = ctx->headers;
+
     len = sizeof(njt_http_grpc_connection_start) - 1
           + sizeof(njt_http_grpc_frame_t);             /* headers frame */
 
@@ -751,7 +803,11 @@ njt_http_grpc_create_request(njt_http_request_t *r)
 
     /* :path header */
 
-    if (r->valid_unparsed_uri) {
+    if (ctx->path.len) {
+        escape = 0;
+        uri_len = ctx->path.len;
+
+    } else if (r->valid_unparsed_uri) {
         escape = 0;
         uri_len = r->unparsed_uri.len;
 
@@ -769,7 +825,7 @@ njt_http_grpc_create_request(njt_http_request_t *r)
 
     /* :authority header */
 
-    if (!glcf->host_set) {
+    if (!ctx->host_set) {
         len += 1 + NJT_HTTP_V2_INT_OCTETS + ctx->host.len;
 
         if (tmp_len < ctx->host.len) {
@@ -779,10 +835,10 @@ njt_http_grpc_create_request(njt_http_request_t *r)
 
     /* other headers */
 
-    njt_http_script_flush_no_cacheable_variables(r, glcf->headers.flushes);
+    njt_http_script_flush_no_cacheable_variables(r, headers->flushes);
     njt_memzero(&le, sizeof(njt_http_script_engine_t));
 
-    le.ip = glcf->headers.lengths->elts;
+    le.ip = headers->lengths->elts;
     le.request = r;
     le.flushed = 1;
 
@@ -812,7 +868,7 @@ njt_http_grpc_create_request(njt_http_request_t *r)
         }
     }
 
-    if (glcf->upstream.pass_request_headers) {
+    if (u->conf->pass_request_headers) {
         part = &r->headers_in.headers.part;
         header = part->elts;
 
@@ -828,7 +884,7 @@ njt_http_grpc_create_request(njt_http_request_t *r)
                 i = 0;
             }
 
-            if (njt_hash_find(&glcf->headers.hash, header[i].hash,
+            if (njt_hash_find(&headers->hash, header[i].hash,
                               header[i].lowcase_key, header[i].key.len))
             {
                 continue;
@@ -932,7 +988,21 @@ njt_http_grpc_create_request(njt_http_request_t *r)
                        "grpc header: \":scheme: http\"");
     }
 
-    if (r->valid_unparsed_uri) {
+    if (ctx->path.len) {
+
+        if (ctx->path.len == 1 && ctx->path.data[0] == '/') {
+            *b->last++ = njt_http_v2_indexed(NJT_HTTP_V2_PATH_ROOT_INDEX);
+
+        } else {
+            *b->last++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_PATH_INDEX);
+            b->last = njt_http_v2_write_value(b->last, ctx->path.data,
+                                              ctx->path.len, tmp);
+        }
+
+        njt_log_debug1(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "grpc header: \":path: %V\"", &ctx->path);
+
+    } else if (r->valid_unparsed_uri) {
 
         if (r->unparsed_uri.len == 1 && r->unparsed_uri.data[0] == '/') {
             *b->last++ = njt_http_v2_indexed(NJT_HTTP_V2_PATH_ROOT_INDEX);
@@ -977,7 +1047,7 @@ njt_http_grpc_create_request(njt_http_request_t *r)
                        "grpc header: \":path: %V\"", &r->uri);
     }
 
-    if (!glcf->host_set) {
+    if (!ctx->host_set) {
         *b->last++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_AUTHORITY_INDEX);
         b->last = njt_http_v2_write_value(b->last, ctx->host.data,
                                           ctx->host.len, tmp);
@@ -988,11 +1058,11 @@ njt_http_grpc_create_request(njt_http_request_t *r)
 
     njt_memzero(&e, sizeof(njt_http_script_engine_t));
 
-    e.ip = glcf->headers.values->elts;
+    e.ip = headers->values->elts;
     e.request = r;
     e.flushed = 1;
 
-    le.ip = glcf->headers.lengths->elts;
+    le.ip = headers->lengths->elts;
 
     while (*(uintptr_t *) le.ip) {
 
@@ -1048,7 +1118,7 @@ njt_http_grpc_create_request(njt_http_request_t *r)
 #endif
     }
 
-    if (glcf->upstream.pass_request_headers) {
+    if (u->conf->pass_request_headers) {
         part = &r->headers_in.headers.part;
         header = part->elts;
 
@@ -1064,7 +1134,7 @@ njt_http_grpc_create_request(njt_http_request_t *r)
                 i = 0;
             }
 
-            if (njt_hash_find(&glcf->headers.hash, header[i].hash,
+            if (njt_hash_find(&headers->hash, header[i].hash,
                               header[i].lowcase_key, header[i].key.len))
             {
                 continue;
@@ -4252,6 +4322,35 @@ njt_http_grpc_get_connection_data(njt_http_request_t *r,
 }
 
 
+njt_int_t
+njt_http_grpc_connection_state(njt_connection_t *c,
+    njt_uint_t *last_stream_id, size_t *init_window, size_t *send_window,
+    size_t *recv_window)
+{
+    njt_pool_cleanup_t    *cln;
+    njt_http_grpc_conn_t  *conn;
+
+    if (c->pool == NULL) {
+        return NJT_DECLINED;
+    }
+
+    for (cln = c->pool->cleanup; cln; cln = cln->next) {
+        if (cln->handler == njt_http_grpc_cleanup) {
+            conn = cln->data;
+
+            *last_stream_id = conn->last_stream_id;
+            *init_window = conn->init_window;
+            *send_window = conn->send_window;
+            *recv_window = conn->recv_window;
+
+            return NJT_OK;
+        }
+    }
+
+    return NJT_DECLINED;
+}
+
+
 static void
 njt_http_grpc_cleanup(void *data)
 {
@@ -0,0 +1,58 @@
+
+/*
+ * Copyright (C) Maxim Dounin
+ * Copyright (C) Nginx, Inc.
+ * Copyright (C) 2021-2023  TMLake(Beijing) Technology Co., Ltd.
+ */
+
+
+#ifndef _NJT_HTTP_GRPC_H_INCLUDED_
+#define _NJT_HTTP_GRPC_H_INCLUDED_
+
+
+#include <njt_config.h>
+#include <njt_core.h>
+#include <njt_http.h>
+
+
+typedef struct {
+    njt_array_t               *flushes;
+    njt_array_t               *lengths;
+    njt_array_t               *values;
+    njt_hash_t                 hash;
+} njt_http_grpc_headers_t;
+
+
+/*
+ * sets up HTTP/2 framing on an already created r->upstream,
+ * used by proxy_pass with "proxy_http_version 2"; "path", if not NULL,
+ * is sent as ":path" instead of the client request URI
+ */
+njt_int_t njt_http_grpc_v2_upstream_init(njt_http_request_t *r,
+    njt_str_t *host, njt_str_t *path, njt_http_grpc_headers_t *headers,
+    njt_uint_t host_set);
+
+
+typedef struct {
+    njt_uint_t                 max_streams;
+    njt_msec_t                 idle_timeout;
+} njt_http_grpc_mux_conf_t;
+
+
+/*
+ * makes the request a stream on an HTTP/2 connection shared with other
+ * requests to the same upstream server, see njt_http_grpc_mux.c
+ */
+njt_int_t njt_http_grpc_mux_init(njt_http_request_t *r,
+    njt_http_grpc_mux_conf_t *conf);
+
+/*
+ * HTTP/2 state of a connection cached by the keepalive module after
+ * a request with HTTP/2 framing, NJT_DECLINED for other connections
+ */
+njt_int_t njt_http_grpc_connection_state(njt_connection_t *c,
+    njt_uint_t *last_stream_id, size_t *init_window, size_t *send_window,
+    size_t *recv_window);
+
+
+#endif /* _NJT_HTTP_GRPC_H_INCLUDED_ */
@@ -0,0 +1,2677 @@
+
+/*
+ * Copyright (C) 2021-2023  TMLake(Beijing) Technology Co., Ltd.
+ */
+
+
+#include <njt_config.h>
+#include <njt_core.h>
+#include <njt_http.h>
+#include <njt_http_grpc_module.h>
+
+
+/*
+ * Shared HTTP/2 connections to upstream servers.
+ *
+ * Each request gets a fake connection which looks to the grpc framing
+ * code like a fresh HTTP/2 connection of its own, with the request on
+ * stream 1.  Frames written by grpc are queued per stream, renumbered and
+ * interleaved on a real connection; frames received are routed back by
+ * stream identifier.  Connection level frames (settings, ping, goaway,
+ * connection window updates) are handled here.
+ *
+ * Flow control: the per-stream send window is enforced by grpc, using the
+ * window updates and settings forwarded to it; the connection send window
+ * is enforced here.  Response data is buffered here up to the stream
+ * window advertised to the server, more window is granted as grpc reads.
+ */
+
+
+#define NJT_HTTP_GRPC_MUX_STREAM_WINDOW  (256 * 1024)
+#define NJT_HTTP_GRPC_MUX_FRAME_SIZE     NJT_HTTP_V2_DEFAULT_FRAME_SIZE
+#define NJT_HTTP_GRPC_MUX_BUFFER         (64 * 1024)
+#define NJT_HTTP_GRPC_MUX_CONTROL        4096
+#define NJT_HTTP_GRPC_MUX_OUTPUT         (64 * 1024)
+#define NJT_HTTP_GRPC_MUX_FILE_BUFFER    4096
+#define NJT_HTTP_GRPC_MUX_POOL_SIZE      1024
+
+#define NJT_HTTP_GRPC_MUX_MAX_STREAM_ID  0x7fffffff
+
+#define NJT_HTTP_GRPC_MUX_CANCEL         0x8
+
+#define NJT_HTTP_GRPC_MUX_MAX_STREAMS_SETTING  0x3
+#define NJT_HTTP_GRPC_MUX_WINDOW_SETTING       0x4
+
+#define NJT_HTTP_GRPC_MUX_FRAME_LENGTH(p)                                     \
+    (((size_t) (p)[0] << 16) | ((size_t) (p)[1] << 8) | (size_t) (p)[2])
+
+#define NJT_HTTP_GRPC_MUX_UINT31(p)                                           \
+    ((((njt_uint_t) (p)[0] & 0x7f) << 24) | ((njt_uint_t) (p)[1] << 16)       \
+     | ((njt_uint_t) (p)[2] << 8) | (njt_uint_t) (p)[3])
+
+
+typedef struct njt_http_grpc_mux_conn_s  njt_http_grpc_mux_conn_t;
+
+
+typedef struct {
+    njt_connection_t               connection;   /* must be first */
+    njt_event_t                    read;
+    njt_event_t                    write;
+
+    njt_http_grpc_mux_conn_t      *mux;
+    njt_queue_t                    queue;
+
+    njt_uint_t                     id;
+
+    /* frames written by grpc, not yet sent */
+    njt_chain_t                   *out;
+    njt_chain_t                  **last_out;
+    size_t                         out_size;
+
+    /* frames received, not yet read by grpc */
+    njt_chain_t                   *in;
+    njt_chain_t                   *last_in;
+    size_t                         in_size;
+
+    njt_chain_t                   *free;
+
+    /* parser of the frames written by grpc */
+    njt_chain_t                   *frame;
+    size_t                         rest;
+    size_t                         preface;
+    u_char                         head[NJT_HTTP_V2_FRAME_HEADER_SIZE];
+    size_t                         head_len;
+
+    ssize_t                        recv_window;
+
+    /* connection send window and initial window as seen by grpc */
+    size_t                         window;
+    size_t                         init_window;
+
+    unsigned                       active:1;
+    unsigned                       in_closed:1;
+    unsigned                       out_closed:1;
+    unsigned                       error:1;
+} njt_http_grpc_mux_stream_t;
+
+
+struct njt_http_grpc_mux_conn_s {
+    njt_queue_t                    queue;
+    njt_queue_t                    streams;
+    njt_uint_t                     nstreams;
+    njt_uint_t                     processing;
+
+    njt_connection_t              *connection;
+    njt_pool_t                    *pool;
+    njt_pool_t                    *conn_pool;    /* adopted connections */
+    njt_log_t                      log;
+    njt_peer_connection_t          peer;
+
+    void                          *ssl;
+    njt_str_t                      ssl_name;
+#if (NJT_HTTP_SSL)
+    njt_str_t                      verify_name;
+    njt_flag_t                     ssl_verify;
+#endif
+
+    njt_uint_t                     peer_max_streams;
+    njt_uint_t                     next_id;
+    size_t                         init_window;
+    ssize_t                        send_window;
+    size_t                         recv_window;
+
+    njt_msec_t                     idle_timeout;
+    njt_msec_t                     send_timeout;
+
+    njt_buf_t                     *out;
+    njt_buf_t                     *control;
+    njt_http_grpc_mux_stream_t    *hdr_stream;
+
+    u_char                        *buffer;
+
+    /* parser of the frames received */
+    u_char                         head[NJT_HTTP_V2_FRAME_HEADER_SIZE];
+    size_t                         head_len;
+    njt_uint_t                     type;
+    njt_uint_t                     flags;
+    njt_uint_t                     sid;
+    size_t                         rest;
+    njt_http_grpc_mux_stream_t    *in_stream;
+    u_char                         payload[8];
+    size_t                         payload_len;
+
+    unsigned                       ready:1;
+    unsigned                       draining:1;
+    unsigned                       closed:1;
+};
+
+
+typedef struct {
+    njt_http_grpc_mux_conf_t      *conf;
+    njt_http_request_t            *request;
+    njt_http_grpc_mux_stream_t    *stream;
+
+    void                          *data;
+
+    njt_event_get_peer_pt          original_get_peer;
+    njt_event_free_peer_pt         original_free_peer;
+
+#if (NJT_HTTP_SSL)
+    njt_event_set_peer_session_pt  original_set_session;
+    njt_event_save_peer_session_pt original_save_session;
+#endif
+} njt_http_grpc_mux_peer_data_t;
+
+
+static njt_int_t njt_http_grpc_mux_init_peer(njt_http_request_t *r,
+    void *data);
+static njt_int_t njt_http_grpc_mux_get_peer(njt_peer_connection_t *pc,
+    void *data);
+static void njt_http_grpc_mux_free_peer(njt_peer_connection_t *pc,
+    void *data, njt_uint_t state);
+#if (NJT_HTTP_SSL)
+static njt_int_t njt_http_grpc_mux_set_session(njt_peer_connection_t *pc,
+    void *data);
+static void njt_http_grpc_mux_save_session(njt_peer_connection_t *pc,
+    void *data);
+#endif
+
+static njt_http_grpc_mux_conn_t *njt_http_grpc_mux_find(
+    njt_peer_connection_t *pc, njt_http_grpc_mux_peer_data_t *mp,
+    njt_str_t *name);
+static njt_http_grpc_mux_conn_t *njt_http_grpc_mux_create(
+    njt_peer_connection_t *pc, njt_http_grpc_mux_peer_data_t *mp,
+    njt_str_t *name);
+static njt_int_t njt_http_grpc_mux_connect(njt_peer_connection_t *pc,
+    njt_http_grpc_mux_peer_data_t *mp, njt_str_t *name,
+    njt_http_grpc_mux_conn_t **mcp);
+static njt_http_grpc_mux_conn_t *njt_http_grpc_mux_adopt(
+    njt_peer_connection_t *pc, njt_http_grpc_mux_peer_data_t *mp,
+    njt_str_t *name);
+static void njt_http_grpc_mux_connect_handler(njt_event_t *ev);
+#if (NJT_HTTP_SSL)
+static void njt_http_grpc_mux_ssl_handshake_handler(njt_connection_t *c);
+#endif
+static void njt_http_grpc_mux_established(njt_http_grpc_mux_conn_t *mc);
+static void njt_http_grpc_mux_idle(njt_http_grpc_mux_conn_t *mc);
+static void njt_http_grpc_mux_close(njt_http_grpc_mux_conn_t *mc);
+
+static void njt_http_grpc_mux_read_handler(njt_event_t *rev);
+static njt_int_t njt_http_grpc_mux_parse(njt_http_grpc_mux_conn_t *mc,
+    u_char *p, u_char *last);
+static njt_int_t njt_http_grpc_mux_frame_start(njt_http_grpc_mux_conn_t *mc);
+static njt_int_t njt_http_grpc_mux_frame_end(njt_http_grpc_mux_conn_t *mc);
+static njt_int_t njt_http_grpc_mux_setting(njt_http_grpc_mux_conn_t *mc);
+static void njt_http_grpc_mux_goaway(njt_http_grpc_mux_conn_t *mc);
+
+static void njt_http_grpc_mux_write_handler(njt_event_t *wev);
+static njt_int_t njt_http_grpc_mux_send(njt_http_grpc_mux_conn_t *mc);
+static void njt_http_grpc_mux_fill(njt_http_grpc_mux_conn_t *mc);
+static njt_int_t njt_http_grpc_mux_fill_stream(njt_http_grpc_mux_conn_t *mc,
+    njt_http_grpc_mux_stream_t *s);
+static njt_int_t njt_http_grpc_mux_control(njt_http_grpc_mux_conn_t *mc,
+    njt_uint_t type, njt_uint_t flags, njt_uint_t sid, u_char *data,
+    size_t len);
+static void njt_http_grpc_mux_post_write(njt_http_grpc_mux_conn_t *mc);
+
+static njt_http_grpc_mux_stream_t *njt_http_grpc_mux_stream_create(
+    njt_http_grpc_mux_conn_t *mc, njt_log_t *log);
+static njt_http_grpc_mux_stream_t *njt_http_grpc_mux_stream_find(
+    njt_http_grpc_mux_conn_t *mc, njt_uint_t sid);
+static void njt_http_grpc_mux_stream_detach(njt_http_grpc_mux_stream_t *s);
+static njt_int_t njt_http_grpc_mux_stream_sync(njt_http_grpc_mux_stream_t *s);
+static njt_int_t njt_http_grpc_mux_stream_input(njt_http_grpc_mux_stream_t *s,
+    u_char *p, size_t len);
+static void njt_http_grpc_mux_stream_window(njt_http_grpc_mux_stream_t *s);
+static void njt_http_grpc_mux_stream_done(njt_http_grpc_mux_stream_t *s);
+static void njt_http_grpc_mux_stream_wake(njt_http_grpc_mux_stream_t *s);
+static njt_chain_t *njt_http_grpc_mux_get_buf(njt_http_grpc_mux_stream_t *s);
+static void njt_http_grpc_mux_dummy_handler(njt_event_t *ev);
+
+static ssize_t njt_http_grpc_mux_recv(njt_connection_t *c, u_char *buf,
+    size_t size);
+static njt_chain_t *njt_http_grpc_mux_send_chain(njt_connection_t *c,
+    njt_chain_t *in, off_t limit);
+static ssize_t njt_http_grpc_mux_output(njt_http_grpc_mux_stream_t *s,
+    u_char *p, size_t len);
+static njt_int_t njt_http_grpc_mux_output_frame(
+    njt_http_grpc_mux_stream_t *s);
+
+static u_char *njt_http_grpc_mux_frame_head(u_char *p, size_t len,
+    njt_uint_t type, njt_uint_t flags, njt_uint_t sid);
+static u_char *njt_http_grpc_mux_uint32(u_char *p, uint32_t n);
+
+
+static u_char  njt_http_grpc_mux_preface[] =
+    "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+
+/* per-worker list of shared connections */
+static njt_queue_t  njt_http_grpc_mux_conns;
+
+
+njt_int_t
+njt_http_grpc_mux_init(njt_http_request_t *r, njt_http_grpc_mux_conf_t *conf)
+{
+    njt_http_upstream_t            *u;
+    njt_http_grpc_mux_peer_data_t  *mp;
+
+    if (conf->max_streams == 0) {
+        return NJT_OK;
+    }
+
+    /*
+     * fake connections cannot be used with level-triggered
+     * event methods, as njt_handle_read_event() deletes ready events
+     */
+
+    if (!(njt_event_flags & NJT_USE_CLEAR_EVENT)) {
+        return NJT_OK;
+    }
+
+    u = r->upstream;
+
+#if (NJT_HTTP_SSL)
+
+    /* certificates evaluated per request cannot be shared */
+
+    if (u->ssl
+        && (
+#if (NJT_HTTP_MULTICERT)
+            u->conf->ssl_certificate_values ||
+#endif
+            (u->conf->ssl_certificate
+             && u->conf->ssl_certificate->value.len
+             && (u->conf->ssl_certificate->lengths
+                 || u->conf->ssl_certificate_key->lengths))))
+    {
+        return NJT_OK;
+    }
+
+#endif
+
+    mp = njt_pcalloc(r->pool, sizeof(njt_http_grpc_mux_peer_data_t));
+    if (mp == NULL) {
+        return NJT_ERROR;
+    }
+
+    mp->conf = conf;
+    mp->request = r;
+
+    u->init_peer = njt_http_grpc_mux_init_peer;
+    u->init_peer_data = mp;
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_init_peer(njt_http_request_t *r, void *data)
+{
+    njt_http_grpc_mux_peer_data_t  *mp = data;
+
+    njt_http_upstream_t  *u;
+
+    njt_log_debug0(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "init http2 mux peer");
+
+    u = r->upstream;
+
+    mp->data = u->peer.data;
+    mp->original_get_peer = u->peer.get;
+    mp->original_free_peer = u->peer.free;
+
+    u->peer.data = mp;
+    u->peer.get = njt_http_grpc_mux_get_peer;
+    u->peer.free = njt_http_grpc_mux_free_peer;
+
+#if (NJT_HTTP_SSL)
+    mp->original_set_session = u->peer.set_session;
+    mp->original_save_session = u->peer.save_session;
+    u->peer.set_session = njt_http_grpc_mux_set_session;
+    u->peer.save_session = njt_http_grpc_mux_save_session;
+#endif
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_get_peer(njt_peer_connection_t *pc, void *data)
+{
+    njt_http_grpc_mux_peer_data_t  *mp = data;
+
+    njt_int_t                    rc;
+    njt_str_t                    name;
+    njt_connection_t            *c;
+    njt_http_request_t          *r;
+    njt_http_upstream_t         *u;
+    njt_http_grpc_mux_conn_t    *mc;
+    njt_http_grpc_mux_stream_t  *s;
+
+    njt_log_debug0(NJT_LOG_DEBUG_HTTP, pc->log, 0,
+                   "get http2 mux peer");
+
+    r = mp->request;
+    u = r->upstream;
+
+    u->multiplexed = 0;
+
+    rc = mp->original_get_peer(pc, mp->data);
+
+    if (rc != NJT_OK && rc != NJT_DONE) {
+        return rc;
+    }
+
+    njt_str_null(&name);
+
+#if (NJT_HTTP_SSL)
+
+    if (u->ssl) {
+        if (u->conf->ssl_name) {
+            if (njt_http_complex_value(r, u->conf->ssl_name, &name)
+                != NJT_OK)
+            {
+                return NJT_ERROR;
+            }
+
+        } else {
+            name = u->ssl_name;
+        }
+    }
+
+#endif
+
+    mc = NULL;
+
+    if (rc == NJT_DONE) {
+
+        /*
+         * a connection cached by the keepalive module after a request
+         * with HTTP/2 framing becomes a shared connection
+         */
+
+        c = pc->connection;
+
+        mc = njt_http_grpc_mux_adopt(pc, mp, &name);
+
+        if (mc == NULL) {
+#if (NJT_HTTP_SSL)
+            if (c->ssl) {
+                c->ssl->no_wait_shutdown = 1;
+                (void) njt_ssl_shutdown(c);
+            }
+#endif
+
+            if (c->pool) {
+                njt_destroy_pool(c->pool);
+            }
+
+            njt_close_connection(c);
+        }
+
+        pc->connection = NULL;
+        pc->cached = 0;
+
+    } else {
+        mc = njt_http_grpc_mux_find(pc, mp, &name);
+    }
+
+    if (mc == NULL) {
+        rc = njt_http_grpc_mux_connect(pc, mp, &name, &mc);
+
+        if (rc != NJT_OK) {
+            return rc;
+        }
+    }
+
+    s = njt_http_grpc_mux_stream_create(mc, pc->log);
+    if (s == NULL) {
+        njt_http_grpc_mux_idle(mc);
+        return NJT_ERROR;
+    }
+
+    mp->stream = s;
+
+    pc->connection = &s->connection;
+    pc->cached = 0;
+
+    u->multiplexed = 1;
+
+    return mc->ready ? NJT_DONE : NJT_AGAIN;
+}
+
+
+static void
+njt_http_grpc_mux_free_peer(njt_peer_connection_t *pc, void *data,
+    njt_uint_t state)
+{
+    njt_http_grpc_mux_peer_data_t  *mp = data;
+
+    njt_log_debug0(NJT_LOG_DEBUG_HTTP, pc->log, 0,
+                   "free http2 mux peer");
+
+    if (mp->stream) {
+        njt_http_grpc_mux_stream_detach(mp->stream);
+        mp->stream = NULL;
+
+        pc->connection = NULL;
+    }
+
+    mp->original_free_peer(pc, mp->data, state);
+}
+
+
+#if (NJT_HTTP_SSL)
+
+static njt_int_t
+njt_http_grpc_mux_set_session(njt_peer_connection_t *pc, void *data)
+{
+    njt_http_grpc_mux_peer_data_t  *mp = data;
+
+    return mp->original_set_session(pc, mp->data);
+}
+
+
+static void
+njt_http_grpc_mux_save_session(njt_peer_connection_t *pc, void *data)
+{
+    njt_http_grpc_mux_peer_data_t  *mp = data;
+
+    mp->original_save_session(pc, mp->data);
+}
+
+#endif
+
+
+static njt_http_grpc_mux_conn_t *
+njt_http_grpc_mux_find(njt_peer_connection_t *pc,
+    njt_http_grpc_mux_peer_data_t *mp, njt_str_t *name)
+{
+    void                      *ssl;
+    njt_uint_t                 limit;
+    njt_queue_t               *q;
+    njt_http_grpc_mux_conn_t  *mc;
+
+    if (njt_http_grpc_mux_conns.next == NULL) {
+        njt_queue_init(&njt_http_grpc_mux_conns);
+        return NULL;
+    }
+
+    ssl = NULL;
+
+#if (NJT_HTTP_SSL)
+    if (mp->request->upstream->ssl) {
+        ssl = mp->request->upstream->conf->ssl;
+    }
+#endif
+
+    for (q = njt_queue_head(&njt_http_grpc_mux_conns);
+         q != njt_queue_sentinel(&njt_http_grpc_mux_conns);
+         q = njt_queue_next(q))
+    {
+        mc = njt_queue_data(q, njt_http_grpc_mux_conn_t, queue);
+
+        if (mc->draining || mc->ssl != ssl) {
+            continue;
+        }
+
+        limit = njt_min(mp->conf->max_streams, mc->peer_max_streams);
+
+        if (mc->nstreams >= limit) {
+            continue;
+        }
+
+        if (njt_cmp_sockaddr(mc->peer.sockaddr, mc->peer.socklen,
+                             pc->sockaddr, pc->socklen, 1)
+            != NJT_OK)
+        {
+            continue;
+        }
+
+        if (mc->peer.local != pc->local
+            && (mc->peer.local == NULL || pc->local == NULL
+                || njt_cmp_sockaddr(mc->peer.local->sockaddr,
+                                    mc->peer.local->socklen,
+                                    pc->local->sockaddr,
+                                    pc->local->socklen, 1)
+                   != NJT_OK))
+        {
+            continue;
+        }
+
+        if (mc->ssl_name.len != name->len
+            || njt_strncmp(mc->ssl_name.data, name->data, name->len) != 0)
+        {
+            continue;
+        }
+
+        njt_log_debug2(NJT_LOG_DEBUG_HTTP, pc->log, 0,
+                       "http2 mux connection %p, streams: %ui",
+                       mc, mc->nstreams);
+
+        return mc;
+    }
+
+    return NULL;
+}
+
+
+static njt_http_grpc_mux_conn_t *
+njt_http_grpc_mux_create(njt_peer_connection_t *pc,
+    njt_http_grpc_mux_peer_data_t *mp, njt_str_t *name)
+{
+    njt_pool_t                *pool;
+    njt_http_upstream_t       *u;
+    njt_http_grpc_mux_conn_t  *mc;
+
+    u = mp->request->upstream;
+
+    pool = njt_create_pool(NJT_HTTP_GRPC_MUX_POOL_SIZE, njt_cycle->log);
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    mc = njt_pcalloc(pool, sizeof(njt_http_grpc_mux_conn_t));
+    if (mc == NULL) {
+        goto failed;
+    }
+
+    mc->pool = pool;
+    mc->log = *njt_cycle->log;
+
+    /* the peer may go away with the balancer data, copy it */
+
+    mc->peer.sockaddr = njt_pcalloc(pool, pc->socklen);
+    mc->peer.name = njt_palloc(pool, sizeof(njt_str_t));
+    mc->ssl_name.data = njt_pstrdup(pool, name);
+    mc->out = njt_create_temp_buf(pool, NJT_HTTP_GRPC_MUX_BUFFER);
+    mc->control = njt_create_temp_buf(pool, NJT_HTTP_GRPC_MUX_CONTROL);
+    mc->buffer = njt_palloc(pool, NJT_HTTP_GRPC_MUX_FRAME_SIZE);
+
+    if (mc->peer.sockaddr == NULL
+        || mc->peer.name == NULL
+        || (name->len && mc->ssl_name.data == NULL)
+        || mc->out == NULL
+        || mc->control == NULL
+        || mc->buffer == NULL)
+    {
+        goto failed;
+    }
+
+    /* makes njt_ssl_send_chain() write out its buffer */
+    mc->out->flush = 1;
+
+    njt_memcpy(mc->peer.sockaddr, pc->sockaddr, pc->socklen);
+    mc->peer.socklen = pc->socklen;
+    mc->ssl_name.len = name->len;
+
+    mc->peer.name->len = pc->name->len;
+    mc->peer.name->data = njt_pstrdup(pool, pc->name);
+    if (mc->peer.name->data == NULL) {
+        goto failed;
+    }
+
+    if (pc->local) {
+        mc->peer.local = njt_palloc(pool, sizeof(njt_addr_t));
+        if (mc->peer.local == NULL) {
+            goto failed;
+        }
+
+        *mc->peer.local = *pc->local;
+
+        mc->peer.local->sockaddr = njt_palloc(pool, pc->local->socklen);
+        if (mc->peer.local->sockaddr == NULL) {
+            goto failed;
+        }
+
+        njt_memcpy(mc->peer.local->sockaddr, pc->local->sockaddr,
+                   pc->local->socklen);
+    }
+
+    mc->peer.get = njt_event_get_peer;
+    mc->peer.log = &mc->log;
+    mc->peer.log_error = pc->log_error;
+    mc->peer.type = pc->type;
+    mc->peer.rcvbuf = pc->rcvbuf;
+    mc->peer.transparent = pc->transparent;
+    mc->peer.so_keepalive = pc->so_keepalive;
+
+#if (NJT_HTTP_SSL)
+    if (u->ssl) {
+        mc->ssl = u->conf->ssl;
+    }
+#endif
+
+    mc->peer_max_streams = NJT_MAX_UINT32_VALUE;
+    mc->next_id = 1;
+    mc->init_window = NJT_HTTP_V2_DEFAULT_WINDOW;
+    mc->send_window = NJT_HTTP_V2_DEFAULT_WINDOW;
+    mc->recv_window = NJT_HTTP_V2_MAX_WINDOW;
+    mc->idle_timeout = mp->conf->idle_timeout;
+    mc->send_timeout = u->send_timeout;
+
+    njt_queue_init(&mc->streams);
+
+    return mc;
+
+failed:
+
+    njt_destroy_pool(pool);
+
+    return NULL;
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_connect(njt_peer_connection_t *pc,
+    njt_http_grpc_mux_peer_data_t *mp, njt_str_t *name,
+    njt_http_grpc_mux_conn_t **mcp)
+{
+    u_char                    *p;
+    njt_int_t                  rc;
+    njt_buf_t                 *b;
+    njt_connection_t          *c;
+    njt_http_upstream_t       *u;
+    njt_http_grpc_mux_conn_t  *mc;
+
+    u = mp->request->upstream;
+
+    mc = njt_http_grpc_mux_create(pc, mp, name);
+    if (mc == NULL) {
+        return NJT_ERROR;
+    }
+
+    rc = njt_event_connect_peer(&mc->peer);
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, pc->log, 0,
+                   "http2 mux connect %V: %i", pc->name, rc);
+
+    if (rc == NJT_ERROR || rc == NJT_BUSY || rc == NJT_DECLINED) {
+        njt_destroy_pool(mc->pool);
+        return rc == NJT_ERROR ? NJT_ERROR : NJT_DECLINED;
+    }
+
+    c = mc->peer.connection;
+
+    c->data = mc;
+    c->pool = mc->pool;
+    c->log = &mc->log;
+    c->read->log = c->log;
+    c->write->log = c->log;
+    c->read->handler = njt_http_grpc_mux_connect_handler;
+    c->write->handler = njt_http_grpc_mux_connect_handler;
+
+    mc->connection = c;
+
+#if (NJT_HTTP_SSL)
+
+    if (u->ssl) {
+        if (njt_http_upstream_ssl_create_connection(mp->request, u, c)
+            != NJT_OK)
+        {
+            goto failed;
+        }
+
+        mc->verify_name.data = njt_pstrdup(mc->pool, &u->ssl_name);
+        if (mc->verify_name.data == NULL) {
+            goto failed;
+        }
+
+        mc->verify_name.len = u->ssl_name.len;
+        mc->ssl_verify = u->conf->ssl_verify;
+    }
+
+#endif
+
+    /* connection preface, settings and connection window update */
+
+    b = mc->control;
+    p = njt_cpymem(b->last, njt_http_grpc_mux_preface,
+                   sizeof(njt_http_grpc_mux_preface) - 1);
+
+    p = njt_http_grpc_mux_frame_head(p, 3 * 6, NJT_HTTP_V2_SETTINGS_FRAME,
+                                     NJT_HTTP_V2_NO_FLAG, 0);
+
+    *p++ = 0; *p++ = 0x1;                                /* header table */
+    p = njt_http_grpc_mux_uint32(p, 0);
+    *p++ = 0; *p++ = 0x2;                                /* disable push */
+    p = njt_http_grpc_mux_uint32(p, 0);
+    *p++ = 0; *p++ = NJT_HTTP_GRPC_MUX_WINDOW_SETTING;
+    p = njt_http_grpc_mux_uint32(p, NJT_HTTP_GRPC_MUX_STREAM_WINDOW);
+
+    p = njt_http_grpc_mux_frame_head(p, 4, NJT_HTTP_V2_WINDOW_UPDATE_FRAME,
+                                     NJT_HTTP_V2_NO_FLAG, 0);
+    p = njt_http_grpc_mux_uint32(p, NJT_HTTP_V2_MAX_WINDOW
+                                    - NJT_HTTP_V2_DEFAULT_WINDOW);
+    b->last = p;
+
+    njt_queue_insert_tail(&njt_http_grpc_mux_conns, &mc->queue);
+
+    njt_add_timer(c->write, u->connect_timeout);
+
+    if (rc == NJT_OK) {
+        njt_post_event(c->write, &njt_posted_events);
+    }
+
+    *mcp = mc;
+
+    return NJT_OK;
+
+#if (NJT_HTTP_SSL)
+failed:
+
+    njt_close_connection(c);
+    njt_destroy_pool(mc->pool);
+
+    return NJT_ERROR;
+#endif
+}
+
+
+static njt_http_grpc_mux_conn_t *
+njt_http_grpc_mux_adopt(njt_peer_connection_t *pc,
+    njt_http_grpc_mux_peer_data_t *mp, njt_str_t *name)
+{
+    u_char                    *p;
+    size_t                     init_window, send_window, recv_window;
+    njt_buf_t                 *b;
+    njt_uint_t                 last_stream_id;
+    njt_connection_t          *c;
+    njt_http_grpc_mux_conn_t  *mc;
+
+    c = pc->connection;
+
+    /* connections cached after HTTP/1.x requests cannot be used */
+
+    if (njt_http_grpc_connection_state(c, &last_stream_id, &init_window,
+                                       &send_window, &recv_window)
+        != NJT_OK)
+    {
+        return NULL;
+    }
+
+    if (last_stream_id >= NJT_HTTP_GRPC_MUX_MAX_STREAM_ID - 2) {
+        return NULL;
+    }
+
+    mc = njt_http_grpc_mux_create(pc, mp, name);
+    if (mc == NULL) {
+        return NULL;
+    }
+
+    njt_log_debug3(NJT_LOG_DEBUG_HTTP, pc->log, 0,
+                   "http2 mux connection %p from keepalive %p, "
+                   "last stream: %ui", mc, c, last_stream_id);
+
+    /*
+     * the connection keeps its own pool, as SSL buffers may be
+     * allocated from it
+     */
+
+    mc->conn_pool = c->pool;
+    mc->connection = c;
+
+    mc->next_id = last_stream_id + 2;
+    mc->init_window = init_window;
+    mc->send_window = send_window;
+    mc->recv_window = recv_window;
+
+    c->data = mc;
+    c->log = &mc->log;
+    c->pool->log = &mc->log;
+    c->read->log = c->log;
+    c->write->log = c->log;
+    c->read->handler = njt_http_grpc_mux_read_handler;
+    c->write->handler = njt_http_grpc_mux_write_handler;
+    c->idle = 0;
+
+    if (c->read->timer_set) {
+        njt_del_timer(c->read);
+    }
+
+    if (c->write->timer_set) {
+        njt_del_timer(c->write);
+    }
+
+    /*
+     * grpc advertised the maximum stream window,
+     * streams of the mux use a smaller one
+     */
+
+    b = mc->control;
+    p = njt_http_grpc_mux_frame_head(b->last, 6, NJT_HTTP_V2_SETTINGS_FRAME,
+                                     NJT_HTTP_V2_NO_FLAG, 0);
+    *p++ = 0; *p++ = NJT_HTTP_GRPC_MUX_WINDOW_SETTING;
+    b->last = njt_http_grpc_mux_uint32(p, NJT_HTTP_GRPC_MUX_STREAM_WINDOW);
+
+    njt_queue_insert_tail(&njt_http_grpc_mux_conns, &mc->queue);
+
+    mc->ready = 1;
+
+    njt_post_event(c->write, &njt_posted_events);
+
+    if (c->read->ready) {
+        njt_post_event(c->read, &njt_posted_events);
+    }
+
+    return mc;
+}
+
+
+static void
+njt_http_grpc_mux_connect_handler(njt_event_t *ev)
+{
+    int                        err;
+    socklen_t                  len;
+    njt_connection_t          *c;
+    njt_http_grpc_mux_conn_t  *mc;
+
+    c = ev->data;
+    mc = c->data;
+
+    if (ev->timedout) {
+        njt_log_error(NJT_LOG_ERR, c->log, NJT_ETIMEDOUT,
+                      "upstream timed out while connecting http2 "
+                      "connection to %V", mc->peer.name);
+        njt_http_grpc_mux_close(mc);
+        return;
+    }
+
+    err = 0;
+    len = sizeof(int);
+
+    if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, (void *) &err, &len) == -1) {
+        err = njt_socket_errno;
+    }
+
+    if (err) {
+        (void) njt_connection_error(c, err, "connect() failed");
+        njt_http_grpc_mux_close(mc);
+        return;
+    }
+
+#if (NJT_HTTP_SSL)
+
+    if (c->ssl) {
+        if (njt_ssl_handshake(c) == NJT_AGAIN) {
+            c->ssl->handler = njt_http_grpc_mux_ssl_handshake_handler;
+            return;
+        }
+
+        njt_http_grpc_mux_ssl_handshake_handler(c);
+        return;
+    }
+
+#endif
+
+    njt_http_grpc_mux_established(mc);
+}
+
+
+#if (NJT_HTTP_SSL)
+
+static void
+njt_http_grpc_mux_ssl_handshake_handler(njt_connection_t *c)
+{
+    long                       rc;
+    njt_http_grpc_mux_conn_t  *mc;
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+    unsigned int               len;
+    const unsigned char       *data;
+#endif
+
+    mc = c->data;
+
+    if (!c->ssl->handshaked) {
+
+        if (c->write->timedout) {
+            njt_log_error(NJT_LOG_ERR, c->log, NJT_ETIMEDOUT,
+                          "upstream timed out while SSL handshaking "
+                          "http2 connection to %V", mc->peer.name);
+        }
+
+        njt_http_grpc_mux_close(mc);
+        return;
+    }
+
+    if (mc->ssl_verify) {
+        rc = SSL_get_verify_result(c->ssl->connection);
+
+        if (rc != X509_V_OK) {
+            njt_log_error(NJT_LOG_ERR, c->log, 0,
+                          "upstream SSL certificate verify error: (%l:%s)",
+                          rc, X509_verify_cert_error_string(rc));
+            njt_http_grpc_mux_close(mc);
+            return;
+        }
+
+        if (njt_ssl_check_host(c, &mc->verify_name) != NJT_OK) {
+            njt_log_error(NJT_LOG_ERR, c->log, 0,
+                          "upstream SSL certificate does not match \"%V\"",
+                          &mc->verify_name);
+            njt_http_grpc_mux_close(mc);
+            return;
+        }
+    }
+
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+
+    SSL_get0_alpn_selected(c->ssl->connection, &data, &len);
+
+    if (len && (len != 2 || njt_strncmp(data, "h2", 2) != 0)) {
+        njt_log_error(NJT_LOG_ERR, c->log, 0,
+                      "upstream selected unexpected ALPN protocol \"%*s\"",
+                      (size_t) len, data);
+        njt_http_grpc_mux_close(mc);
+        return;
+    }
+
+#endif
+
+    njt_http_grpc_mux_established(mc);
+}
+
+#endif
+
+
+static void
+njt_http_grpc_mux_established(njt_http_grpc_mux_conn_t *mc)
+{
+    njt_queue_t                 *q;
+    njt_connection_t            *c;
+    njt_http_grpc_mux_stream_t  *s;
+
+    c = mc->connection;
+
+    njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "http2 mux connection %p established", mc);
+
+    if (c->write->timer_set) {
+        njt_del_timer(c->write);
+    }
+
+    mc->ready = 1;
+
+    c->read->handler = njt_http_grpc_mux_read_handler;
+    c->write->handler = njt_http_grpc_mux_write_handler;
+
+    for (q = njt_queue_head(&mc->streams);
+         q != njt_queue_sentinel(&mc->streams);
+         q = njt_queue_next(q))
+    {
+        s = njt_queue_data(q, njt_http_grpc_mux_stream_t, queue);
+
+        s->write.ready = 1;
+        njt_post_event(&s->write, &njt_posted_events);
+    }
+
+    if (njt_http_grpc_mux_send(mc) != NJT_OK) {
+        njt_http_grpc_mux_close(mc);
+        return;
+    }
+
+    if (c->read->ready) {
+        njt_post_event(c->read, &njt_posted_events);
+    }
+
+    njt_http_grpc_mux_idle(mc);
+}
+
+
+static void
+njt_http_grpc_mux_idle(njt_http_grpc_mux_conn_t *mc)
+{
+    njt_connection_t  *c;
+
+    if (mc->nstreams) {
+        return;
+    }
+
+    if (mc->closed) {
+        njt_destroy_pool(mc->pool);
+        return;
+    }
+
+    if (mc->draining || njt_exiting || njt_terminate) {
+        njt_http_grpc_mux_close(mc);
+        return;
+    }
+
+    if (!mc->ready) {
+        return;
+    }
+
+    c = mc->connection;
+
+    njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "http2 mux connection %p idle", mc);
+
+    c->idle = 1;
+    c->read->cancelable = 1;
+
+    njt_add_timer(c->read, mc->idle_timeout);
+}
+
+
+static void
+njt_http_grpc_mux_close(njt_http_grpc_mux_conn_t *mc)
+{
+    njt_queue_t                 *q;
+    njt_connection_t            *c;
+    njt_http_grpc_mux_stream_t  *s;
+
+    if (mc->closed) {
+        return;
+    }
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, &mc->log, 0,
+                   "close http2 mux connection %p, streams: %ui",
+                   mc, mc->nstreams);
+
+    mc->closed = 1;
+    mc->ready = 0;
+
+    njt_queue_remove(&mc->queue);
+
+    for (q = njt_queue_head(&mc->streams);
+         q != njt_queue_sentinel(&mc->streams);
+         q = njt_queue_next(q))
+    {
+        s = njt_queue_data(q, njt_http_grpc_mux_stream_t, queue);
+
+        s->error = 1;
+        njt_http_grpc_mux_stream_wake(s);
+    }
+
+    c = mc->connection;
+
+#if (NJT_HTTP_SSL)
+    if (c->ssl) {
+        c->ssl->no_wait_shutdown = 1;
+        (void) njt_ssl_shutdown(c);
+    }
+#endif
+
+    njt_close_connection(c);
+    mc->connection = NULL;
+
+    if (mc->conn_pool) {
+        njt_destroy_pool(mc->conn_pool);
+        mc->conn_pool = NULL;
+    }
+
+    if (mc->nstreams == 0) {
+        njt_destroy_pool(mc->pool);
+    }
+}
+
+
+static void
+njt_http_grpc_mux_read_handler(njt_event_t *rev)
+{
+    ssize_t                    n;
+    njt_connection_t          *c;
+    njt_http_grpc_mux_conn_t  *mc;
+
+    c = rev->data;
+    mc = c->data;
+
+    njt_log_debug0(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "http2 mux read handler");
+
+    if (c->close) {
+        njt_http_grpc_mux_close(mc);
+        return;
+    }
+
+    if (rev->timedout) {
+        rev->timedout = 0;
+
+        if (mc->nstreams == 0) {
+            njt_http_grpc_mux_close(mc);
+            return;
+        }
+    }
+
+    for ( ;; ) {
+        n = c->recv(c, mc->buffer, NJT_HTTP_GRPC_MUX_FRAME_SIZE);
+
+        if (n == NJT_AGAIN) {
+            break;
+        }
+
+        if (n == 0 || n == NJT_ERROR) {
+            njt_log_error(NJT_LOG_INFO, c->log, 0,
+                          "upstream closed http2 connection to %V",
+                          mc->peer.name);
+            njt_http_grpc_mux_close(mc);
+            return;
+        }
+
+        if (njt_http_grpc_mux_parse(mc, mc->buffer, mc->buffer + n)
+            != NJT_OK)
+        {
+            njt_http_grpc_mux_close(mc);
+            return;
+        }
+    }
+
+    if (njt_handle_read_event(rev, 0) != NJT_OK
+        || njt_http_grpc_mux_send(mc) != NJT_OK)
+    {
+        njt_http_grpc_mux_close(mc);
+        return;
+    }
+
+    if (mc->draining) {
+        njt_http_grpc_mux_idle(mc);
+    }
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_parse(njt_http_grpc_mux_conn_t *mc, u_char *p,
+    u_char *last)
+{
+    size_t  n;
+
+    while (p < last) {
+
+        if (mc->head_len < NJT_HTTP_V2_FRAME_HEADER_SIZE) {
+            n = njt_min((size_t) (last - p),
+                        NJT_HTTP_V2_FRAME_HEADER_SIZE - mc->head_len);
+
+            njt_memcpy(mc->head + mc->head_len, p, n);
+            mc->head_len += n;
+            p += n;
+
+            if (mc->head_len < NJT_HTTP_V2_FRAME_HEADER_SIZE) {
+                break;
+            }
+
+            if (njt_http_grpc_mux_frame_start(mc) != NJT_OK) {
+                return NJT_ERROR;
+            }
+
+            if (mc->rest == 0 && njt_http_grpc_mux_frame_end(mc) != NJT_OK) {
+                return NJT_ERROR;
+            }
+
+            continue;
+        }
+
+        n = njt_min((size_t) (last - p), mc->rest);
+
+        if (mc->in_stream) {
+            if (njt_http_grpc_mux_stream_input(mc->in_stream, p, n)
+                != NJT_OK)
+            {
+                return NJT_ERROR;
+            }
+
+        } else if (mc->type == NJT_HTTP_V2_SETTINGS_FRAME) {
+
+            while (n--) {
+                mc->payload[mc->payload_len++] = *p++;
+                mc->rest--;
+
+                if (mc->payload_len == 6) {
+                    if (njt_http_grpc_mux_setting(mc) != NJT_OK) {
+                        return NJT_ERROR;
+                    }
+
+                    mc->payload_len = 0;
+                }
+            }
+
+            if (mc->rest == 0 && njt_http_grpc_mux_frame_end(mc) != NJT_OK) {
+                return NJT_ERROR;
+            }
+
+            continue;
+
+        } else if (mc->payload_len < sizeof(mc->payload)) {
+            n = njt_min(n, sizeof(mc->payload) - mc->payload_len);
+            njt_memcpy(mc->payload + mc->payload_len, p, n);
+            mc->payload_len += n;
+        }
+
+        p += n;
+        mc->rest -= n;
+
+        if (mc->rest == 0 && njt_http_grpc_mux_frame_end(mc) != NJT_OK) {
+            return NJT_ERROR;
+        }
+    }
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_frame_start(njt_http_grpc_mux_conn_t *mc)
+{
+    u_char                       head[NJT_HTTP_V2_FRAME_HEADER_SIZE];
+    size_t                       len;
+    njt_log_t                   *log;
+    njt_http_grpc_mux_stream_t  *s;
+
+    log = mc->connection->log;
+
+    len = NJT_HTTP_GRPC_MUX_FRAME_LENGTH(mc->head);
+    mc->type = mc->head[3];
+    mc->flags = mc->head[4];
+    mc->sid = NJT_HTTP_GRPC_MUX_UINT31(&mc->head[5]);
+
+    njt_log_debug4(NJT_LOG_DEBUG_HTTP, log, 0,
+                   "http2 mux frame type:%ui f:%Xi l:%uz sid:%ui",
+                   mc->type, mc->flags, len, mc->sid);
+
+    if (len > NJT_HTTP_GRPC_MUX_FRAME_SIZE) {
+        njt_log_error(NJT_LOG_ERR, log, 0,
+                      "upstream sent too large http2 frame: %uz", len);
+        return NJT_ERROR;
+    }
+
+    mc->rest = len;
+    mc->payload_len = 0;
+    mc->in_stream = NULL;
+
+    s = NULL;
+
+    switch (mc->type) {
+
+    case NJT_HTTP_V2_DATA_FRAME:
+
+        if (len > mc->recv_window) {
+            njt_log_error(NJT_LOG_ERR, log, 0,
+                          "upstream violated connection flow control");
+            return NJT_ERROR;
+        }
+
+        mc->recv_window -= len;
+
+        s = njt_http_grpc_mux_stream_find(mc, mc->sid);
+
+        if (s == NULL) {
+            break;
+        }
+
+        if ((ssize_t) len > s->recv_window) {
+            njt_log_error(NJT_LOG_ERR, log, 0,
+                          "upstream violated stream flow control");
+            return NJT_ERROR;
+        }
+
+        s->recv_window -= len;
+
+        if (mc->flags & NJT_HTTP_V2_END_STREAM_FLAG) {
+            s->in_closed = 1;
+        }
+
+        break;
+
+    case NJT_HTTP_V2_HEADERS_FRAME:
+    case NJT_HTTP_V2_CONTINUATION_FRAME:
+    case NJT_HTTP_V2_RST_STREAM_FRAME:
+
+        if (mc->sid == 0) {
+            njt_log_error(NJT_LOG_ERR, log, 0,
+                          "upstream sent http2 frame %ui "
+                          "with zero stream id", mc->type);
+            return NJT_ERROR;
+        }
+
+        s = njt_http_grpc_mux_stream_find(mc, mc->sid);
+
+        if (s == NULL) {
+            break;
+        }
+
+        if (mc->type == NJT_HTTP_V2_RST_STREAM_FRAME) {
+            s->in_closed = 1;
+            s->out_closed = 1;
+
+        } else if (mc->type == NJT_HTTP_V2_HEADERS_FRAME
+                   && (mc->flags & NJT_HTTP_V2_END_STREAM_FLAG))
+        {
+            s->in_closed = 1;
+        }
+
+        break;
+
+    case NJT_HTTP_V2_WINDOW_UPDATE_FRAME:
+
+        if (len != 4) {
+            njt_log_error(NJT_LOG_ERR, log, 0,
+                          "upstream sent window update frame "
+                          "with invalid length: %uz", len);
+            return NJT_ERROR;
+        }
+
+        if (mc->sid) {
+            s = njt_http_grpc_mux_stream_find(mc, mc->sid);
+        }
+
+        break;
+
+    case NJT_HTTP_V2_SETTINGS_FRAME:
+
+        if (mc->sid
+            || ((mc->flags & NJT_HTTP_V2_ACK_FLAG) && len)
+            || len % 6)
+        {
+            njt_log_error(NJT_LOG_ERR, log, 0,
+                          "upstream sent invalid settings frame");
+            return NJT_ERROR;
+        }
+
+        break;
+
+    case NJT_HTTP_V2_PING_FRAME:
+
+        if (mc->sid || len != 8) {
+            njt_log_error(NJT_LOG_ERR, log, 0,
+                          "upstream sent invalid ping frame");
+            return NJT_ERROR;
+        }
+
+        break;
+
+    case NJT_HTTP_V2_GOAWAY_FRAME:
+
+        if (mc->sid || len < 8) {
+            njt_log_error(NJT_LOG_ERR, log, 0,
+                          "upstream sent invalid goaway frame");
+            return NJT_ERROR;
+        }
+
+        break;
+
+    case NJT_HTTP_V2_PUSH_PROMISE_FRAME:
+
+        njt_log_error(NJT_LOG_ERR, log, 0,
+                      "upstream sent push promise while push is disabled");
+        return NJT_ERROR;
+
+    default:
+        /* PRIORITY and unknown frames are ignored */
+        break;
+    }
+
+    if (s == NULL) {
+        return NJT_OK;
+    }
+
+    if (s->in_size > 4 * NJT_HTTP_GRPC_MUX_STREAM_WINDOW) {
+        njt_log_error(NJT_LOG_ERR, log, 0,
+                      "upstream sent too many http2 frames");
+        return NJT_ERROR;
+    }
+
+    /* forward the frame to grpc as a frame on stream 1 */
+
+    njt_memcpy(head, mc->head, 5);
+    (void) njt_http_grpc_mux_uint32(&head[5], 1);
+
+    if (njt_http_grpc_mux_stream_input(s, head, sizeof(head)) != NJT_OK) {
+        return NJT_ERROR;
+    }
+
+    mc->in_stream = s;
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_frame_end(njt_http_grpc_mux_conn_t *mc)
+{
+    size_t                       n;
+    njt_uint_t                   window;
+    njt_http_grpc_mux_stream_t  *s;
+
+    mc->head_len = 0;
+
+    s = mc->in_stream;
+
+    if (s) {
+        mc->in_stream = NULL;
+
+        njt_http_grpc_mux_stream_done(s);
+
+        if (njt_http_grpc_mux_stream_sync(s) != NJT_OK) {
+            return NJT_ERROR;
+        }
+
+        njt_http_grpc_mux_stream_wake(s);
+    }
+
+    switch (mc->type) {
+
+    case NJT_HTTP_V2_DATA_FRAME:
+
+        if (mc->recv_window < NJT_HTTP_V2_MAX_WINDOW / 2) {
+            n = NJT_HTTP_V2_MAX_WINDOW - mc->recv_window;
+            mc->recv_window = NJT_HTTP_V2_MAX_WINDOW;
+
+            return njt_http_grpc_mux_control(mc,
+                                             NJT_HTTP_V2_WINDOW_UPDATE_FRAME,
+                                             NJT_HTTP_V2_NO_FLAG, 0, NULL, n);
+        }
+
+        break;
+
+    case NJT_HTTP_V2_WINDOW_UPDATE_FRAME:
+
+        if (mc->sid) {
+            break;
+        }
+
+        window = NJT_HTTP_GRPC_MUX_UINT31(mc->payload);
+
+        if (window == 0
+            || window > (size_t) (NJT_HTTP_V2_MAX_WINDOW - mc->send_window))
+        {
+            njt_log_error(NJT_LOG_ERR, mc->connection->log, 0,
+                          "upstream sent invalid connection window update");
+            return NJT_ERROR;
+        }
+
+        mc->send_window += window;
+
+        break;
+
+    case NJT_HTTP_V2_SETTINGS_FRAME:
+
+        if (mc->flags & NJT_HTTP_V2_ACK_FLAG) {
+            break;
+        }
+
+        return njt_http_grpc_mux_control(mc, NJT_HTTP_V2_SETTINGS_FRAME,
+                                         NJT_HTTP_V2_ACK_FLAG, 0, NULL, 0);
+
+    case NJT_HTTP_V2_PING_FRAME:
+
+        if (mc->flags & NJT_HTTP_V2_ACK_FLAG) {
+            break;
+        }
+
+        return njt_http_grpc_mux_control(mc, NJT_HTTP_V2_PING_FRAME,
+                                         NJT_HTTP_V2_ACK_FLAG, 0,
+                                         mc->payload, 8);
+
+    case NJT_HTTP_V2_GOAWAY_FRAME:
+        njt_http_grpc_mux_goaway(mc);
+        break;
+    }
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_setting(njt_http_grpc_mux_conn_t *mc)
+{
+    njt_uint_t                   id, value;
+    njt_queue_t                 *q;
+    njt_http_grpc_mux_stream_t  *s;
+
+    id = (mc->payload[0] << 8) | mc->payload[1];
+    value = ((njt_uint_t) mc->payload[2] << 24) | (mc->payload[3] << 16)
+            | (mc->payload[4] << 8) | mc->payload[5];
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, mc->connection->log, 0,
+                   "http2 mux setting: %ui %ui", id, value);
+
+    switch (id) {
+
+    case NJT_HTTP_GRPC_MUX_MAX_STREAMS_SETTING:
+        mc->peer_max_streams = value;
+        break;
+
+    case NJT_HTTP_GRPC_MUX_WINDOW_SETTING:
+
+        if (value > NJT_HTTP_V2_MAX_WINDOW) {
+            njt_log_error(NJT_LOG_ERR, mc->connection->log, 0,
+                          "upstream sent settings frame "
+                          "with too large initial window size: %ui", value);
+            return NJT_ERROR;
+        }
+
+        if (value == mc->init_window) {
+            break;
+        }
+
+        mc->init_window = value;
+
+        /* grpc adjusts the windows of its stream */
+
+        for (q = njt_queue_head(&mc->streams);
+             q != njt_queue_sentinel(&mc->streams);
+             q = njt_queue_next(q))
+        {
+            s = njt_queue_data(q, njt_http_grpc_mux_stream_t, queue);
+
+            if (njt_http_grpc_mux_stream_sync(s) != NJT_OK) {
+                return NJT_ERROR;
+            }
+
+            njt_http_grpc_mux_stream_wake(s);
+        }
+
+        break;
+    }
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_grpc_mux_goaway(njt_http_grpc_mux_conn_t *mc)
+{
+    njt_uint_t                   last;
+    njt_queue_t                 *q;
+    njt_http_grpc_mux_stream_t  *s;
+
+    last = NJT_HTTP_GRPC_MUX_UINT31(mc->payload);
+
+    njt_log_error(NJT_LOG_INFO, mc->connection->log, 0,
+                  "upstream sent goaway with error %ui, last stream %ui",
+                  (njt_uint_t) NJT_HTTP_GRPC_MUX_UINT31(&mc->payload[4]),
+                  last);
+
+    if (!mc->draining) {
+        mc->draining = 1;
+    }
+
+    /* streams not processed by the server can be retried elsewhere */
+
+    for (q = njt_queue_head(&mc->streams);
+         q != njt_queue_sentinel(&mc->streams);
+         q = njt_queue_next(q))
+    {
+        s = njt_queue_data(q, njt_http_grpc_mux_stream_t, queue);
+
+        if (s->id == 0 || s->id > last) {
+            s->error = 1;
+            njt_http_grpc_mux_stream_wake(s);
+        }
+    }
+}
+
+
+static void
+njt_http_grpc_mux_write_handler(njt_event_t *wev)
+{
+    njt_connection_t          *c;
+    njt_http_grpc_mux_conn_t  *mc;
+
+    c = wev->data;
+    mc = c->data;
+
+    njt_log_debug0(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "http2 mux write handler");
+
+    if (wev->timedout) {
+        njt_log_error(NJT_LOG_ERR, c->log, NJT_ETIMEDOUT,
+                      "upstream timed out while sending to http2 "
+                      "connection %V", mc->peer.name);
+        njt_http_grpc_mux_close(mc);
+        return;
+    }
+
+    if (njt_http_grpc_mux_send(mc) != NJT_OK) {
+        njt_http_grpc_mux_close(mc);
+    }
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_send(njt_http_grpc_mux_conn_t *mc)
+{
+    njt_buf_t         *b;
+    njt_chain_t        out, *cl;
+    njt_connection_t  *c;
+
+    if (!mc->ready) {
+        return NJT_OK;
+    }
+
+    c = mc->connection;
+    b = mc->out;
+
+    for ( ;; ) {
+        njt_http_grpc_mux_fill(mc);
+
+        if (b->pos == b->last && !c->buffered) {
+            break;
+        }
+
+        out.buf = b;
+        out.next = NULL;
+
+        cl = c->send_chain(c, b->pos == b->last ? NULL : &out, 0);
+
+        if (cl == NJT_CHAIN_ERROR) {
+            c->error = 1;
+            return NJT_ERROR;
+        }
+
+        if (b->pos == b->last) {
+            b->pos = b->start;
+            b->last = b->start;
+        }
+
+        if (cl || c->buffered) {
+
+            if (njt_handle_write_event(c->write, 0) != NJT_OK) {
+                return NJT_ERROR;
+            }
+
+            if (!c->write->timer_set) {
+                njt_add_timer(c->write, mc->send_timeout);
+            }
+
+            return NJT_OK;
+        }
+    }
+
+    if (c->write->timer_set) {
+        njt_del_timer(c->write);
+    }
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_grpc_mux_fill(njt_http_grpc_mux_conn_t *mc)
+{
+    size_t                       n;
+    njt_buf_t                   *b, *ctl;
+    njt_uint_t                   progress;
+    njt_queue_t                 *q;
+    njt_http_grpc_mux_stream_t  *s;
+
+    b = mc->out;
+
+    if (b->pos != b->start) {
+        n = b->last - b->pos;
+        njt_memmove(b->start, b->pos, n);
+        b->pos = b->start;
+        b->last = b->start + n;
+    }
+
+    /* control frames go first */
+
+    ctl = mc->control;
+
+    n = njt_min((size_t) (ctl->last - ctl->pos), (size_t) (b->end - b->last));
+    b->last = njt_cpymem(b->last, ctl->pos, n);
+    ctl->pos += n;
+
+    if (ctl->pos != ctl->last) {
+        return;
+    }
+
+    ctl->pos = ctl->start;
+    ctl->last = ctl->start;
+
+    /* a frame from each stream in turn */
+
+    do {
+        progress = 0;
+
+        for (q = njt_queue_head(&mc->streams);
+             q != njt_queue_sentinel(&mc->streams);
+             q = njt_queue_next(q))
+        {
+            s = njt_queue_data(q, njt_http_grpc_mux_stream_t, queue);
+
+            if (mc->hdr_stream && mc->hdr_stream != s) {
+                continue;
+            }
+
+            switch (njt_http_grpc_mux_fill_stream(mc, s)) {
+
+            case NJT_OK:
+                progress = 1;
+                break;
+
+            case NJT_AGAIN:
+                progress = 0;
+                goto done;
+
+            default: /* NJT_DECLINED */
+                break;
+            }
+        }
+
+    } while (progress);
+
+done:
+
+    if (!njt_queue_empty(&mc->streams)) {
+        q = njt_queue_head(&mc->streams);
+        njt_queue_remove(q);
+        njt_queue_insert_tail(&mc->streams, q);
+    }
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_fill_stream(njt_http_grpc_mux_conn_t *mc,
+    njt_http_grpc_mux_stream_t *s)
+{
+    size_t        len, n, space;
+    njt_buf_t    *b, *f;
+    njt_uint_t    type, flags;
+    njt_chain_t  *cl;
+
+    if (s->out == NULL || (s->error && mc->hdr_stream != s)) {
+        return NJT_DECLINED;
+    }
+
+    b = mc->out;
+    cl = s->out;
+    f = cl->buf;
+
+    type = f->start[3];
+    flags = f->start[4];
+    len = f->last - f->pos;
+
+    space = b->end - b->last;
+
+    if (space <= NJT_HTTP_V2_FRAME_HEADER_SIZE) {
+        return NJT_AGAIN;
+    }
+
+    space -= NJT_HTTP_V2_FRAME_HEADER_SIZE;
+
+    if (type == NJT_HTTP_V2_DATA_FRAME) {
+        n = njt_min(len, (size_t) njt_max(mc->send_window, 0));
+
+        if (n == 0 && len) {
+            return NJT_DECLINED;
+        }
+
+        if (n > space) {
+            n = space;
+        }
+
+        if (n < len) {
+            flags &= ~NJT_HTTP_V2_END_STREAM_FLAG;
+        }
+
+    } else {
+
+        if (len > space) {
+            return NJT_AGAIN;
+        }
+
+        n = len;
+    }
+
+    if (s->id == 0) {
+
+        /* HEADERS opening the stream */
+
+        if (mc->draining || mc->processing >= mc->peer_max_streams) {
+            return NJT_DECLINED;
+        }
+
+        if (mc->next_id > NJT_HTTP_GRPC_MUX_MAX_STREAM_ID) {
+            mc->draining = 1;
+            s->error = 1;
+            njt_http_grpc_mux_stream_wake(s);
+            return NJT_DECLINED;
+        }
+
+        s->id = mc->next_id;
+        mc->next_id += 2;
+
+        s->active = 1;
+        mc->processing++;
+
+        njt_log_debug2(NJT_LOG_DEBUG_HTTP, s->connection.log, 0,
+                       "http2 mux stream %ui on %p", s->id, mc);
+    }
+
+    b->last = njt_http_grpc_mux_frame_head(b->last, n, type, flags, s->id);
+    b->last = njt_cpymem(b->last, f->pos, n);
+    f->pos += n;
+
+    if (type == NJT_HTTP_V2_DATA_FRAME) {
+        mc->send_window -= n;
+    }
+
+    if (f->pos < f->last) {
+        return NJT_OK;
+    }
+
+    /* the frame is sent */
+
+    s->out = cl->next;
+
+    if (s->out == NULL) {
+        s->last_out = &s->out;
+    }
+
+    s->out_size -= f->last - f->start;
+
+    cl->next = s->free;
+    s->free = cl;
+
+    switch (type) {
+
+    case NJT_HTTP_V2_HEADERS_FRAME:
+        mc->hdr_stream = (flags & NJT_HTTP_V2_END_HEADERS_FLAG) ? NULL : s;
+
+        if (flags & NJT_HTTP_V2_END_STREAM_FLAG) {
+            s->out_closed = 1;
+        }
+
+        break;
+
+    case NJT_HTTP_V2_CONTINUATION_FRAME:
+
+        if (flags & NJT_HTTP_V2_END_HEADERS_FLAG) {
+            mc->hdr_stream = NULL;
+        }
+
+        break;
+
+    case NJT_HTTP_V2_DATA_FRAME:
+
+        if (flags & NJT_HTTP_V2_END_STREAM_FLAG) {
+            s->out_closed = 1;
+        }
+
+        break;
+
+    case NJT_HTTP_V2_RST_STREAM_FRAME:
+        s->in_closed = 1;
+        s->out_closed = 1;
+        break;
+    }
+
+    njt_http_grpc_mux_stream_done(s);
+
+    if (!s->write.ready && s->out_size < NJT_HTTP_GRPC_MUX_OUTPUT) {
+        s->write.ready = 1;
+        njt_post_event(&s->write, &njt_posted_events);
+    }
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_control(njt_http_grpc_mux_conn_t *mc, njt_uint_t type,
+    njt_uint_t flags, njt_uint_t sid, u_char *data, size_t len)
+{
+    njt_buf_t  *b;
+
+    b = mc->control;
+
+    if ((size_t) (b->end - b->last) < NJT_HTTP_V2_FRAME_HEADER_SIZE + 8) {
+        njt_log_error(NJT_LOG_ERR, mc->connection->log, 0,
+                      "too many pending http2 control frames to upstream");
+        return NJT_ERROR;
+    }
+
+    switch (type) {
+
+    case NJT_HTTP_V2_WINDOW_UPDATE_FRAME:
+        b->last = njt_http_grpc_mux_frame_head(b->last, 4, type, flags, sid);
+        b->last = njt_http_grpc_mux_uint32(b->last, len);
+        break;
+
+    case NJT_HTTP_V2_RST_STREAM_FRAME:
+        b->last = njt_http_grpc_mux_frame_head(b->last, 4, type, flags, sid);
+        b->last = njt_http_grpc_mux_uint32(b->last, NJT_HTTP_GRPC_MUX_CANCEL);
+        break;
+
+    default:
+        b->last = njt_http_grpc_mux_frame_head(b->last, len, type, flags, sid);
+        b->last = njt_cpymem(b->last, data, len);
+    }
+
+    njt_http_grpc_mux_post_write(mc);
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_grpc_mux_post_write(njt_http_grpc_mux_conn_t *mc)
+{
+    if (mc->ready) {
+        njt_post_event(mc->connection->write, &njt_posted_events);
+    }
+}
+
+
+static njt_http_grpc_mux_stream_t *
+njt_http_grpc_mux_stream_create(njt_http_grpc_mux_conn_t *mc, njt_log_t *log)
+{
+    njt_pool_t                  *pool;
+    njt_connection_t            *c, *fc;
+    njt_http_grpc_mux_stream_t  *s;
+
+    pool = njt_create_pool(NJT_HTTP_GRPC_MUX_POOL_SIZE, log);
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    s = njt_pcalloc(pool, sizeof(njt_http_grpc_mux_stream_t));
+    if (s == NULL) {
+        njt_destroy_pool(pool);
+        return NULL;
+    }
+
+    c = mc->connection;
+    fc = &s->connection;
+
+    s->read.data = fc;
+    s->read.active = 1;
+    s->read.handler = njt_http_grpc_mux_dummy_handler;
+    s->read.log = log;
+
+    s->write = s->read;
+    s->write.write = 1;
+    s->write.ready = mc->ready;
+
+    fc->fd = (njt_socket_t) -1;
+    fc->pool = pool;
+    fc->log = log;
+    fc->read = &s->read;
+    fc->write = &s->write;
+    fc->recv = njt_http_grpc_mux_recv;
+    fc->send_chain = njt_http_grpc_mux_send_chain;
+    fc->number = c->number;
+    fc->type = SOCK_STREAM;
+    fc->sockaddr = mc->peer.sockaddr;
+    fc->socklen = mc->peer.socklen;
+    fc->start_time = njt_current_msec;
+    fc->sndlowat = 1;
+    fc->tcp_nodelay = NJT_TCP_NODELAY_DISABLED;
+    fc->tcp_nopush = NJT_TCP_NOPUSH_DISABLED;
+
+    s->mux = mc;
+    s->last_out = &s->out;
+    s->preface = sizeof(njt_http_grpc_mux_preface) - 1;
+    s->recv_window = NJT_HTTP_GRPC_MUX_STREAM_WINDOW;
+    s->window = NJT_HTTP_V2_DEFAULT_WINDOW;
+    s->init_window = NJT_HTTP_V2_DEFAULT_WINDOW;
+
+    njt_queue_insert_tail(&mc->streams, &s->queue);
+    mc->nstreams++;
+
+    c->idle = 0;
+
+    if (c->read->timer_set) {
+        njt_del_timer(c->read);
+    }
+
+    if (njt_http_grpc_mux_stream_sync(s) != NJT_OK) {
+        njt_queue_remove(&s->queue);
+        mc->nstreams--;
+        njt_destroy_pool(pool);
+        return NULL;
+    }
+
+    return s;
+}
+
+
+static njt_http_grpc_mux_stream_t *
+njt_http_grpc_mux_stream_find(njt_http_grpc_mux_conn_t *mc, njt_uint_t sid)
+{
+    njt_queue_t                 *q;
+    njt_http_grpc_mux_stream_t  *s;
+
+    for (q = njt_queue_head(&mc->streams);
+         q != njt_queue_sentinel(&mc->streams);
+         q = njt_queue_next(q))
+    {
+        s = njt_queue_data(q, njt_http_grpc_mux_stream_t, queue);
+
+        if (s->id == sid) {
+            return s;
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+njt_http_grpc_mux_stream_detach(njt_http_grpc_mux_stream_t *s)
+{
+    njt_http_grpc_mux_conn_t  *mc;
+
+    mc = s->mux;
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, s->connection.log, 0,
+                   "http2 mux stream %ui detach from %p", s->id, mc);
+
+    njt_queue_remove(&s->queue);
+
+    if (mc->in_stream == s) {
+        mc->in_stream = NULL;
+    }
+
+    if (s->active) {
+        s->active = 0;
+        mc->processing--;
+    }
+
+    if (!mc->closed) {
+
+        if (mc->hdr_stream == s) {
+
+            /* the header block cannot be completed */
+
+            mc->hdr_stream = NULL;
+            njt_http_grpc_mux_close(mc);
+
+        } else if (s->id && !(s->in_closed && s->out_closed)) {
+
+            if (njt_http_grpc_mux_control(mc, NJT_HTTP_V2_RST_STREAM_FRAME,
+                                          NJT_HTTP_V2_NO_FLAG, s->id, NULL, 0)
+                != NJT_OK)
+            {
+                njt_http_grpc_mux_close(mc);
+            }
+
+        } else {
+            njt_http_grpc_mux_post_write(mc);
+        }
+    }
+
+    if (s->read.timer_set) {
+        njt_del_timer(&s->read);
+    }
+
+    if (s->write.timer_set) {
+        njt_del_timer(&s->write);
+    }
+
+    if (s->read.posted) {
+        njt_delete_posted_event(&s->read);
+    }
+
+    if (s->write.posted) {
+        njt_delete_posted_event(&s->write);
+    }
+
+    njt_destroy_pool(s->connection.pool);
+
+    /* the connection may be freed now */
+
+    mc->nstreams--;
+    njt_http_grpc_mux_idle(mc);
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_stream_sync(njt_http_grpc_mux_stream_t *s)
+{
+    u_char                     frame[NJT_HTTP_V2_FRAME_HEADER_SIZE + 6], *p;
+    njt_http_grpc_mux_conn_t  *mc;
+
+    mc = s->mux;
+
+    if (mc->in_stream == s) {
+        /* in the middle of a frame, synced when it ends */
+        return NJT_OK;
+    }
+
+    if (s->init_window != mc->init_window) {
+        p = njt_http_grpc_mux_frame_head(frame, 6, NJT_HTTP_V2_SETTINGS_FRAME,
+                                         NJT_HTTP_V2_NO_FLAG, 0);
+        *p++ = 0;
+        *p++ = NJT_HTTP_GRPC_MUX_WINDOW_SETTING;
+        p = njt_http_grpc_mux_uint32(p, mc->init_window);
+
+        if (njt_http_grpc_mux_stream_input(s, frame, p - frame) != NJT_OK) {
+            return NJT_ERROR;
+        }
+
+        s->init_window = mc->init_window;
+        s->read.ready = 1;
+    }
+
+    if (s->window < NJT_HTTP_V2_MAX_WINDOW / 2) {
+        p = njt_http_grpc_mux_frame_head(frame, 4,
+                                         NJT_HTTP_V2_WINDOW_UPDATE_FRAME,
+                                         NJT_HTTP_V2_NO_FLAG, 0);
+        p = njt_http_grpc_mux_uint32(p, NJT_HTTP_V2_MAX_WINDOW - s->window);
+
+        if (njt_http_grpc_mux_stream_input(s, frame, p - frame) != NJT_OK) {
+            return NJT_ERROR;
+        }
+
+        s->window = NJT_HTTP_V2_MAX_WINDOW;
+        s->read.ready = 1;
+    }
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_stream_input(njt_http_grpc_mux_stream_t *s, u_char *p,
+    size_t len)
+{
+    size_t        n;
+    njt_buf_t    *b;
+    njt_chain_t  *cl;
+
+    while (len) {
+        cl = s->last_in;
+
+        if (cl == NULL || cl->buf->last == cl->buf->end) {
+            cl = njt_http_grpc_mux_get_buf(s);
+            if (cl == NULL) {
+                return NJT_ERROR;
+            }
+
+            if (s->last_in) {
+                s->last_in->next = cl;
+
+            } else {
+                s->in = cl;
+            }
+
+            s->last_in = cl;
+        }
+
+        b = cl->buf;
+
+        n = njt_min(len, (size_t) (b->end - b->last));
+        b->last = njt_cpymem(b->last, p, n);
+
+        p += n;
+        len -= n;
+        s->in_size += n;
+    }
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_grpc_mux_stream_window(njt_http_grpc_mux_stream_t *s)
+{
+    size_t                     want;
+    njt_http_grpc_mux_conn_t  *mc;
+
+    mc = s->mux;
+
+    if (s->id == 0 || s->in_closed || mc->closed) {
+        return;
+    }
+
+    want = (s->in_size < NJT_HTTP_GRPC_MUX_STREAM_WINDOW)
+           ? NJT_HTTP_GRPC_MUX_STREAM_WINDOW - s->in_size : 0;
+
+    if ((ssize_t) want <= s->recv_window
+        || want - s->recv_window < NJT_HTTP_GRPC_MUX_STREAM_WINDOW / 4)
+    {
+        return;
+    }
+
+    if (njt_http_grpc_mux_control(mc, NJT_HTTP_V2_WINDOW_UPDATE_FRAME,
+                                  NJT_HTTP_V2_NO_FLAG, s->id, NULL,
+                                  want - s->recv_window)
+        != NJT_OK)
+    {
+        njt_http_grpc_mux_close(mc);
+        return;
+    }
+
+    s->recv_window = want;
+}
+
+
+static void
+njt_http_grpc_mux_stream_done(njt_http_grpc_mux_stream_t *s)
+{
+    njt_http_grpc_mux_conn_t  *mc;
+
+    if (!s->active || !s->in_closed || !s->out_closed) {
+        return;
+    }
+
+    mc = s->mux;
+
+    s->active = 0;
+    mc->processing--;
+
+    /* a new stream may start */
+
+    njt_http_grpc_mux_post_write(mc);
+}
+
+
+static void
+njt_http_grpc_mux_stream_wake(njt_http_grpc_mux_stream_t *s)
+{
+    s->read.ready = 1;
+    njt_post_event(&s->read, &njt_posted_events);
+
+    if (s->error) {
+        s->write.ready = 1;
+        njt_post_event(&s->write, &njt_posted_events);
+    }
+}
+
+
+static njt_chain_t *
+njt_http_grpc_mux_get_buf(njt_http_grpc_mux_stream_t *s)
+{
+    u_char       *start;
+    njt_buf_t    *b;
+    njt_chain_t  *cl;
+
+    cl = s->free;
+
+    if (cl) {
+        s->free = cl->next;
+        cl->next = NULL;
+
+        b = cl->buf;
+        b->pos = b->start;
+        b->last = b->start;
+
+        return cl;
+    }
+
+    start = njt_palloc(s->connection.pool,
+                       NJT_HTTP_V2_FRAME_HEADER_SIZE
+                       + NJT_HTTP_GRPC_MUX_FRAME_SIZE);
+    if (start == NULL) {
+        return NULL;
+    }
+
+    b = njt_calloc_buf(s->connection.pool);
+    if (b == NULL) {
+        return NULL;
+    }
+
+    cl = njt_alloc_chain_link(s->connection.pool);
+    if (cl == NULL) {
+        return NULL;
+    }
+
+    b->start = start;
+    b->pos = start;
+    b->last = start;
+    b->end = start + NJT_HTTP_V2_FRAME_HEADER_SIZE
+             + NJT_HTTP_GRPC_MUX_FRAME_SIZE;
+    b->temporary = 1;
+
+    cl->buf = b;
+    cl->next = NULL;
+
+    return cl;
+}
+
+
+static void
+njt_http_grpc_mux_dummy_handler(njt_event_t *ev)
+{
+    njt_log_debug0(NJT_LOG_DEBUG_HTTP, ev->log, 0,
+                   "http2 mux dummy handler");
+}
+
+
+static ssize_t
+njt_http_grpc_mux_recv(njt_connection_t *c, u_char *buf, size_t size)
+{
+    njt_http_grpc_mux_stream_t  *s = (njt_http_grpc_mux_stream_t *) c;
+
+    size_t        n;
+    u_char       *p;
+    njt_buf_t    *b;
+    njt_chain_t  *cl;
+
+    p = buf;
+
+    while (s->in && size) {
+        cl = s->in;
+        b = cl->buf;
+
+        n = njt_min(size, (size_t) (b->last - b->pos));
+        p = njt_cpymem(p, b->pos, n);
+
+        b->pos += n;
+        size -= n;
+
+        if (b->pos == b->last && (b->last == b->end || cl != s->last_in)) {
+            s->in = cl->next;
+
+            if (s->in == NULL) {
+                s->last_in = NULL;
+            }
+
+            cl->next = s->free;
+            s->free = cl;
+        }
+
+        if (n == 0) {
+            break;
+        }
+    }
+
+    n = p - buf;
+
+    if (n) {
+        s->in_size -= n;
+
+        njt_http_grpc_mux_stream_window(s);
+
+        if (s->in_size == 0 && !s->error) {
+            c->read->ready = 0;
+        }
+
+        return n;
+    }
+
+    if (s->error) {
+        c->read->error = 1;
+        return NJT_ERROR;
+    }
+
+    c->read->ready = 0;
+
+    return NJT_AGAIN;
+}
+
+
+static njt_chain_t *
+njt_http_grpc_mux_send_chain(njt_connection_t *c, njt_chain_t *in,
+    off_t limit)
+{
+    njt_http_grpc_mux_stream_t  *s = (njt_http_grpc_mux_stream_t *) c;
+
+    u_char      buf[NJT_HTTP_GRPC_MUX_FILE_BUFFER];
+    off_t       sent;
+    size_t      size;
+    ssize_t     n, rc;
+    njt_buf_t  *b;
+
+    if (s->error || s->mux->closed) {
+        c->write->error = 1;
+        return NJT_CHAIN_ERROR;
+    }
+
+    sent = 0;
+
+    for ( /* void */ ; in; in = in->next) {
+        b = in->buf;
+
+        if (njt_buf_special(b)) {
+            continue;
+        }
+
+        if (b->in_file) {
+
+            while (b->file_pos < b->file_last) {
+                size = (size_t) njt_min(b->file_last - b->file_pos,
+                                        (off_t) sizeof(buf));
+
+                n = njt_read_file(b->file, buf, size, b->file_pos);
+
+                if (n == NJT_ERROR) {
+                    return NJT_CHAIN_ERROR;
+                }
+
+                if ((size_t) n != size) {
+                    njt_log_error(NJT_LOG_ALERT, c->log, 0,
+                                  njt_read_file_n " read only %z of %uz "
+                                  "from \"%V\"", n, size, &b->file->name);
+                    return NJT_CHAIN_ERROR;
+                }
+
+                rc = njt_http_grpc_mux_output(s, buf, n);
+
+                if (rc == NJT_ERROR) {
+                    return NJT_CHAIN_ERROR;
+                }
+
+                b->file_pos += rc;
+                sent += rc;
+
+                if (rc < n) {
+                    goto blocked;
+                }
+            }
+
+            if (njt_buf_in_memory(b)) {
+                b->pos = b->last;
+            }
+
+            continue;
+        }
+
+        rc = njt_http_grpc_mux_output(s, b->pos, b->last - b->pos);
+
+        if (rc == NJT_ERROR) {
+            return NJT_CHAIN_ERROR;
+        }
+
+        b->pos += rc;
+        sent += rc;
+
+        if (b->pos < b->last) {
+            goto blocked;
+        }
+    }
+
+    c->sent += sent;
+    njt_http_grpc_mux_post_write(s->mux);
+
+    return NULL;
+
+blocked:
+
+    njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "http2 mux stream %ui output blocked", s->id);
+
+    c->sent += sent;
+    c->write->ready = 0;
+    njt_http_grpc_mux_post_write(s->mux);
+
+    return in;
+}
+
+
+static ssize_t
+njt_http_grpc_mux_output(njt_http_grpc_mux_stream_t *s, u_char *p,
+    size_t len)
+{
+    size_t      n;
+    u_char     *start, *last;
+    njt_buf_t  *f;
+
+    start = p;
+    last = p + len;
+
+    while (p < last) {
+
+        if (s->preface) {
+            n = njt_min(s->preface, (size_t) (last - p));
+            s->preface -= n;
+            p += n;
+            continue;
+        }
+
+        if (s->head_len < NJT_HTTP_V2_FRAME_HEADER_SIZE) {
+
+            if (s->head_len == 0 && s->out_size >= NJT_HTTP_GRPC_MUX_OUTPUT) {
+                break;
+            }
+
+            n = njt_min((size_t) (last - p),
+                        NJT_HTTP_V2_FRAME_HEADER_SIZE - s->head_len);
+
+            njt_memcpy(s->head + s->head_len, p, n);
+            s->head_len += n;
+            p += n;
+
+            if (s->head_len < NJT_HTTP_V2_FRAME_HEADER_SIZE) {
+                break;
+            }
+
+            s->rest = NJT_HTTP_GRPC_MUX_FRAME_LENGTH(s->head);
+
+            if (s->rest > NJT_HTTP_GRPC_MUX_FRAME_SIZE) {
+                njt_log_error(NJT_LOG_ALERT, s->connection.log, 0,
+                              "too large http2 frame to upstream: %uz",
+                              s->rest);
+                return NJT_ERROR;
+            }
+
+            switch (s->head[3]) {
+
+            case NJT_HTTP_V2_DATA_FRAME:
+                s->window -= s->rest;
+
+                /* fall through */
+
+            case NJT_HTTP_V2_HEADERS_FRAME:
+            case NJT_HTTP_V2_CONTINUATION_FRAME:
+            case NJT_HTTP_V2_RST_STREAM_FRAME:
+
+                s->frame = njt_http_grpc_mux_get_buf(s);
+                if (s->frame == NULL) {
+                    return NJT_ERROR;
+                }
+
+                f = s->frame->buf;
+                f->last = njt_cpymem(f->start, s->head,
+                                     NJT_HTTP_V2_FRAME_HEADER_SIZE);
+                f->pos = f->last;
+
+                break;
+
+            default:
+
+                /*
+                 * the connection level frames of grpc: settings,
+                 * window updates, and acks are handled by the mux
+                 */
+
+                s->frame = NULL;
+            }
+
+            if (s->rest == 0 && njt_http_grpc_mux_output_frame(s) != NJT_OK) {
+                return NJT_ERROR;
+            }
+
+            continue;
+        }
+
+        n = njt_min((size_t) (last - p), s->rest);
+
+        if (s->frame) {
+            f = s->frame->buf;
+            f->last = njt_cpymem(f->last, p, n);
+        }
+
+        p += n;
+        s->rest -= n;
+
+        if (s->rest == 0 && njt_http_grpc_mux_output_frame(s) != NJT_OK) {
+            return NJT_ERROR;
+        }
+    }
+
+    return p - start;
+}
+
+
+static njt_int_t
+njt_http_grpc_mux_output_frame(njt_http_grpc_mux_stream_t *s)
+{
+    njt_buf_t    *f;
+    njt_chain_t  *cl;
+
+    s->head_len = 0;
+
+    cl = s->frame;
+
+    if (cl == NULL) {
+        return NJT_OK;
+    }
+
+    s->frame = NULL;
+    f = cl->buf;
+
+    if (f->start[3] == NJT_HTTP_V2_RST_STREAM_FRAME && s->id == 0) {
+
+        /* the request did not leave yet, there is nothing to reset */
+
+        *s->last_out = cl;
+        cl->next = s->free;
+        s->free = s->out;
+
+        s->out = NULL;
+        s->last_out = &s->out;
+        s->out_size = 0;
+
+        s->in_closed = 1;
+        s->out_closed = 1;
+
+        return NJT_OK;
+    }
+
+    *s->last_out = cl;
+    s->last_out = &cl->next;
+    s->out_size += f->last - f->start;
+
+    if (f->start[3] != NJT_HTTP_V2_DATA_FRAME) {
+        return NJT_OK;
+    }
+
+    if (njt_http_grpc_mux_stream_sync(s) != NJT_OK) {
+        return NJT_ERROR;
+    }
+
+    if (s->read.ready) {
+        njt_post_event(&s->read, &njt_posted_events);
+    }
+
+    return NJT_OK;
+}
+
+
+static u_char *
+njt_http_grpc_mux_frame_head(u_char *p, size_t len, njt_uint_t type,
+    njt_uint_t flags, njt_uint_t sid)
+{
+    *p++ = (u_char) ((len >> 16) & 0xff);
+    *p++ = (u_char) ((len >> 8) & 0xff);
+    *p++ = (u_char) (len & 0xff);
+    *p++ = (u_char) type;
+    *p++ = (u_char) flags;
+
+    return njt_http_grpc_mux_uint32(p, (uint32_t) sid);
+}
+
+
+static u_char *
+njt_http_grpc_mux_uint32(u_char *p, uint32_t n)
+{
+    *p++ = (u_char) ((n >> 24) & 0xff);
+    *p++ = (u_char) ((n >> 16) & 0xff);
+    *p++ = (u_char) ((n >> 8) & 0xff);
+    *p++ = (u_char) (n & 0xff);
+
+    return p;
+}
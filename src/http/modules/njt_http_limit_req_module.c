@@ -19,6 +19,14 @@
 #define NJT_HTTP_LIMIT_REQ_REJECTED_DRY_RUN  5
 
 
+#define NJT_HTTP_LIMIT_REQ_GCRA_STRIPES      64
+#define NJT_HTTP_LIMIT_REQ_GCRA_PROBES       16
+/* the slot is being reused by another key */
+#define NJT_HTTP_LIMIT_REQ_GCRA_BUSY         ((njt_atomic_uint_t) -1)
+/* usec, a key idle for the time may be replaced, as the rbtree expire */
+#define NJT_HTTP_LIMIT_REQ_GCRA_IDLE         60000000
+
+
 
 static void njt_http_limit_req_delay(njt_http_request_t *r);
 static njt_int_t njt_http_limit_req_lookup(njt_http_limit_req_limit_t *limit,
@@ -29,6 +37,14 @@ static void njt_http_limit_req_unlock(njt_http_limit_req_limit_t *limits,
     njt_uint_t n);
 static void njt_http_limit_req_expire(njt_http_limit_req_ctx_t *ctx,
     njt_uint_t n);
+#if (NJT_HAVE_ATOMIC_OPS && NJT_PTR_SIZE == 8)
+static njt_int_t njt_http_limit_req_gcra_lookup(
+    njt_http_limit_req_limit_t *limit, njt_uint_t hash, njt_str_t *key,
+    njt_uint_t *ep, njt_uint_t account);
+static njt_int_t njt_http_limit_req_gcra_account(njt_http_limit_req_ctx_t *ctx);
+static njt_int_t njt_http_limit_req_gcra_init(njt_shm_zone_t *shm_zone,
+    njt_http_limit_req_ctx_t *ctx);
+#endif
 
 static njt_int_t njt_http_limit_req_status_variable(njt_http_request_t *r,
     njt_http_variable_value_t *v, uintptr_t data);
@@ -61,7 +77,7 @@ static njt_conf_num_bounds_t  njt_http_limit_req_status_bounds = {
 static njt_command_t  njt_http_limit_req_commands[] = {
 
     { njt_string("limit_req_zone"),
-      NJT_HTTP_MAIN_CONF|NJT_CONF_TAKE3,
+      NJT_HTTP_MAIN_CONF|NJT_CONF_TAKE3|NJT_CONF_TAKE4|NJT_CONF_TAKE5,
       njt_http_limit_req_zone,
       0,
       0,
@@ -200,12 +216,21 @@ njt_http_limit_req_handler(njt_http_request_t *r)
 
         hash = njt_crc32_short(key.data, key.len);
 
-        njt_shmtx_lock(&ctx->shpool->mutex);
+#if (NJT_HAVE_ATOMIC_OPS && NJT_PTR_SIZE == 8)
+        if (ctx->gcra) {
+            rc = njt_http_limit_req_gcra_lookup(limit, hash, &key, &excess,
+                                                (n == lrcf->limits.nelts - 1));
 
-        rc = njt_http_limit_req_lookup(limit, hash, &key, &excess,
-                                       (n == lrcf->limits.nelts - 1));
+        } else
+#endif
+        {
+            njt_shmtx_lock(&ctx->shpool->mutex);
 
-        njt_shmtx_unlock(&ctx->shpool->mutex);
+            rc = njt_http_limit_req_lookup(limit, hash, &key, &excess,
+                                           (n == lrcf->limits.nelts - 1));
+
+            njt_shmtx_unlock(&ctx->shpool->mutex);
+        }
 
         njt_log_debug4(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
                        "limit_req[%ui]: %i %ui.%03ui",
@@ -238,6 +263,7 @@ njt_http_limit_req_handler(njt_http_request_t *r)
         }
 
         r->main->limit_req_status = NJT_HTTP_LIMIT_REQ_REJECTED;
+        r->main->limit_rejected = 1;
 
         return lrcf->status_code;
     }
@@ -511,40 +537,53 @@ njt_http_limit_req_account(njt_http_limit_req_limit_t *limits, njt_uint_t n,
 
     while (n--) {
         ctx = limits[n].shm_zone->data;
-        lr = ctx->node;
 
-        if (lr == NULL) {
-            continue;
-        }
+#if (NJT_HAVE_ATOMIC_OPS && NJT_PTR_SIZE == 8)
+        if (ctx->gcra) {
+            if (ctx->slot == NULL) {
+                continue;
+            }
 
-        njt_shmtx_lock(&ctx->shpool->mutex);
+            excess = njt_http_limit_req_gcra_account(ctx);
 
-        now = njt_current_msec;
-        ms = (njt_msec_int_t) (now - lr->last);
+        } else
+#endif
+        {
+            lr = ctx->node;
 
-        if (ms < -60000) {
-            ms = 1;
+            if (lr == NULL) {
+                continue;
+            }
 
-        } else if (ms < 0) {
-            ms = 0;
-        }
+            njt_shmtx_lock(&ctx->shpool->mutex);
 
-        excess = lr->excess - ctx->rate * ms / 1000 + 1000;
+            now = njt_current_msec;
+            ms = (njt_msec_int_t) (now - lr->last);
 
-        if (excess < 0) {
-            excess = 0;
-        }
+            if (ms < -60000) {
+                ms = 1;
 
-        if (ms) {
-            lr->last = now;
-        }
+            } else if (ms < 0) {
+                ms = 0;
+            }
 
-        lr->excess = excess;
-        lr->count--;
+            excess = lr->excess - ctx->rate * ms / 1000 + 1000;
 
-        njt_shmtx_unlock(&ctx->shpool->mutex);
+            if (excess < 0) {
+                excess = 0;
+            }
 
-        ctx->node = NULL;
+            if (ms) {
+                lr->last = now;
+            }
+
+            lr->excess = excess;
+            lr->count--;
+
+            njt_shmtx_unlock(&ctx->shpool->mutex);
+
+            ctx->node = NULL;
+        }
 
         if ((njt_uint_t) excess <= limits[n].delay) {
             continue;
@@ -571,6 +610,11 @@ njt_http_limit_req_unlock(njt_http_limit_req_limit_t *limits, njt_uint_t n)
     while (n--) {
         ctx = limits[n].shm_zone->data;
 
+        if (ctx->gcra) {
+            ctx->slot = NULL;
+            continue;
+        }
+
         if (ctx->node == NULL) {
             continue;
         }
@@ -652,6 +696,344 @@ njt_http_limit_req_expire(njt_http_limit_req_ctx_t *ctx, njt_uint_t n)
 }
 
 
+#if (NJT_HAVE_ATOMIC_OPS && NJT_PTR_SIZE == 8)
+
+/*
+ * The gcra engine keeps a fixed size open addressing table instead of
+ * the rbtree and the queue.  A key is stored as a 64-bit fingerprint,
+ * the state of a key is its theoretical arrival time (tat): the time
+ * when its excess drops to zero.  Lookups and updates of known keys take
+ * no lock, tat is updated by a single cas.  New keys are added under the
+ * spinlock of a stripe, a stripe is a part of the table and keys are
+ * never probed out of their stripe.
+ *
+ * A slot is never emptied, only a slot idle for the idle time is
+ * reused: keys still being limited are never evicted, and if the probe
+ * sequence has no idle slot the lookup fails, as the rbtree engine does
+ * when it cannot allocate a node.  A reused slot is marked busy by a cas
+ * on its tat first, so a concurrent update of the old key fails.  The
+ * new key starts with tat set to now, past the old tat by at least the
+ * idle time, and every update moves tat forward: tat of a slot never
+ * repeats, and a stale cas of the old key can not succeed later.
+ */
+
+static njt_inline njt_atomic_uint_t
+njt_http_limit_req_gcra_id(njt_str_t *key, njt_uint_t hash)
+{
+    njt_atomic_uint_t  id;
+
+    id = ((njt_atomic_uint_t) njt_murmur_hash2(key->data, key->len) << 32)
+         | (uint32_t) hash;
+
+    return id ? id : 1;
+}
+
+
+static njt_http_limit_req_slot_t *
+njt_http_limit_req_gcra_probe(njt_http_limit_req_gcra_t *gcra,
+    njt_atomic_uint_t id, njt_atomic_uint_t *tatp)
+{
+    njt_uint_t                  i, mask, start, tries;
+    njt_atomic_uint_t           sid, tat;
+    njt_http_limit_req_slot_t  *base, *slot;
+
+    mask = gcra->stripe_size - 1;
+    base = &gcra->slots[(id % gcra->nstripes) * gcra->stripe_size];
+    start = id >> 32;
+
+    for (i = 0; i < NJT_HTTP_LIMIT_REQ_GCRA_PROBES; i++) {
+        slot = &base[(start + i) & mask];
+
+        for (tries = 0; tries < 64; tries++) {
+            sid = slot->id;
+            tat = slot->tat;
+            njt_memory_barrier();
+
+            if (sid != slot->id) {
+                continue;
+            }
+
+            if (sid != id) {
+                break;
+            }
+
+            if (tat != NJT_HTTP_LIMIT_REQ_GCRA_BUSY && tat != 0) {
+                *tatp = tat;
+                return slot;
+            }
+
+            njt_cpu_pause();
+        }
+
+        if (sid == 0) {
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+
+static njt_http_limit_req_slot_t *
+njt_http_limit_req_gcra_insert(njt_http_limit_req_ctx_t *ctx,
+    njt_atomic_uint_t id, njt_atomic_uint_t now, njt_uint_t *newp)
+{
+    njt_uint_t                  i, mask, start, stripe, tries;
+    njt_atomic_t               *lock;
+    njt_atomic_uint_t           tat;
+    njt_http_limit_req_gcra_t  *gcra;
+    njt_http_limit_req_slot_t  *base, *slot, *victim;
+
+    gcra = ctx->gcra;
+    mask = gcra->stripe_size - 1;
+    stripe = id % gcra->nstripes;
+    base = &gcra->slots[stripe * gcra->stripe_size];
+    start = id >> 32;
+    lock = &gcra->locks[stripe];
+
+    njt_spinlock(lock, 1, 2048);
+
+    for (tries = 0; tries < 4; tries++) {
+
+        victim = NULL;
+        tat = 0;
+
+        for (i = 0; i < NJT_HTTP_LIMIT_REQ_GCRA_PROBES; i++) {
+            slot = &base[(start + i) & mask];
+
+            if (slot->id == id) {
+                njt_unlock(lock);
+                *newp = 0;
+                return slot;
+            }
+
+            if (slot->id == 0) {
+                slot->tat = now;
+                njt_memory_barrier();
+                slot->id = id;
+
+                njt_unlock(lock);
+                *newp = 1;
+                return slot;
+            }
+
+            tat = slot->tat;
+
+            if (tat != NJT_HTTP_LIMIT_REQ_GCRA_BUSY
+                && tat + NJT_HTTP_LIMIT_REQ_GCRA_IDLE < now)
+            {
+                victim = slot;
+                break;
+            }
+        }
+
+        if (victim == NULL) {
+            break;
+        }
+
+        if (!njt_atomic_cmp_set(&victim->tat, tat,
+                                NJT_HTTP_LIMIT_REQ_GCRA_BUSY))
+        {
+            /* the old key came back */
+            continue;
+        }
+
+        victim->id = id;
+        njt_memory_barrier();
+        victim->tat = now;
+
+        njt_unlock(lock);
+        *newp = 1;
+        return victim;
+    }
+
+    njt_unlock(lock);
+
+    njt_log_error(NJT_LOG_ALERT, njt_cycle->log, 0,
+                  "could not allocate slot%s", ctx->shpool->log_ctx);
+
+    return NULL;
+}
+
+
+static njt_int_t
+njt_http_limit_req_gcra_lookup(njt_http_limit_req_limit_t *limit,
+    njt_uint_t hash, njt_str_t *key, njt_uint_t *ep, njt_uint_t account)
+{
+    njt_uint_t                  excess, newp;
+    njt_atomic_uint_t           id, now, tat, base;
+    njt_http_limit_req_ctx_t   *ctx;
+    njt_http_limit_req_slot_t  *slot;
+
+    ctx = limit->shm_zone->data;
+
+    now = (njt_atomic_uint_t) njt_current_msec * 1000;
+    id = njt_http_limit_req_gcra_id(key, hash);
+
+    for ( ;; ) {
+
+        slot = njt_http_limit_req_gcra_probe(ctx->gcra, id, &tat);
+
+        if (slot == NULL) {
+            slot = njt_http_limit_req_gcra_insert(ctx, id, now, &newp);
+            if (slot == NULL) {
+                return NJT_ERROR;
+            }
+
+            if (newp) {
+                *ep = 0;
+
+                if (account) {
+                    return NJT_OK;
+                }
+
+                /* charged in njt_http_limit_req_gcra_account() */
+
+                ctx->slot = slot;
+                ctx->slot_id = id;
+
+                return NJT_AGAIN;
+            }
+
+            continue;
+        }
+
+        base = njt_max(tat, now);
+
+        excess = (base - now) * ctx->rate / 1000000 + 1000;
+
+        *ep = excess;
+
+        if (excess > limit->burst) {
+            return NJT_BUSY;
+        }
+
+        if (!account) {
+            ctx->slot = slot;
+            ctx->slot_id = id;
+
+            return NJT_AGAIN;
+        }
+
+        if (njt_atomic_cmp_set(&slot->tat, tat,
+                               now + (njt_atomic_uint_t) excess * 1000000
+                                     / ctx->rate))
+        {
+            return NJT_OK;
+        }
+
+        /* tat is updated by another request, or the slot is reused */
+    }
+}
+
+
+static njt_int_t
+njt_http_limit_req_gcra_account(njt_http_limit_req_ctx_t *ctx)
+{
+    njt_uint_t                  excess;
+    njt_atomic_uint_t           now, tat;
+    njt_http_limit_req_slot_t  *slot;
+
+    slot = ctx->slot;
+    ctx->slot = NULL;
+
+    now = (njt_atomic_uint_t) njt_current_msec * 1000;
+
+    for ( ;; ) {
+        tat = slot->tat;
+        njt_memory_barrier();
+
+        if (slot->id != ctx->slot_id) {
+            return 0;
+        }
+
+        if (tat == NJT_HTTP_LIMIT_REQ_GCRA_BUSY) {
+            njt_cpu_pause();
+            continue;
+        }
+
+        excess = (njt_max(tat, now) - now) * ctx->rate / 1000000 + 1000;
+
+        if (njt_atomic_cmp_set(&slot->tat, tat,
+                               now + (njt_atomic_uint_t) excess * 1000000
+                                     / ctx->rate))
+        {
+            return excess;
+        }
+    }
+}
+
+
+static njt_int_t
+njt_http_limit_req_gcra_init(njt_shm_zone_t *shm_zone,
+    njt_http_limit_req_ctx_t *ctx)
+{
+    size_t                      size;
+    njt_uint_t                  n;
+    njt_http_limit_req_gcra_t  *gcra;
+
+    gcra = njt_slab_calloc(ctx->shpool, sizeof(njt_http_limit_req_gcra_t));
+    if (gcra == NULL) {
+        return NJT_ERROR;
+    }
+
+    gcra->nstripes = ctx->stripes;
+
+    gcra->locks = njt_slab_calloc(ctx->shpool,
+                                  sizeof(njt_atomic_t) * gcra->nstripes);
+    if (gcra->locks == NULL) {
+        return NJT_ERROR;
+    }
+
+    /* about 3/4 of the zone, the size of a stripe is power of 2 */
+
+    n = shm_zone->shm.size / 4 * 3 / sizeof(njt_http_limit_req_slot_t)
+        / gcra->nstripes;
+
+    if (n < NJT_HTTP_LIMIT_REQ_GCRA_PROBES) {
+        njt_log_error(NJT_LOG_EMERG, shm_zone->shm.log, 0,
+                      "limit_req zone \"%V\" is too small for %ui stripes",
+                      &shm_zone->shm.name, gcra->nstripes);
+        return NJT_ERROR;
+    }
+
+    while (n & (n - 1)) {
+        n &= n - 1;
+    }
+
+    for ( ;; ) {
+        size = sizeof(njt_http_limit_req_slot_t) * n * gcra->nstripes;
+
+        gcra->slots = njt_slab_calloc(ctx->shpool, size);
+        if (gcra->slots != NULL) {
+            break;
+        }
+
+        n /= 2;
+
+        if (n < NJT_HTTP_LIMIT_REQ_GCRA_PROBES) {
+            njt_log_error(NJT_LOG_EMERG, shm_zone->shm.log, 0,
+                          "could not allocate gcra table%s",
+                          ctx->shpool->log_ctx);
+            return NJT_ERROR;
+        }
+    }
+
+    gcra->stripe_size = n;
+
+    ctx->sh->gcra = gcra;
+    ctx->gcra = gcra;
+
+    njt_log_error(NJT_LOG_INFO, shm_zone->shm.log, 0,
+                  "limit_req zone \"%V\": gcra engine, %ui stripes "
+                  "of %ui slots", &shm_zone->shm.name, gcra->nstripes, n);
+
+    return NJT_OK;
+}
+
+#endif
+
+
 static njt_int_t
 njt_http_limit_req_init_zone(njt_shm_zone_t *shm_zone, void *data)
 {
@@ -676,8 +1058,20 @@ njt_http_limit_req_init_zone(njt_shm_zone_t *shm_zone, void *data)
             return NJT_ERROR;
         }
 
+        if (ctx->stripes != octx->stripes) {
+            njt_log_error(NJT_LOG_EMERG, shm_zone->shm.log, 0,
+                          "limit_req \"%V\" uses the \"%s\" engine "
+                          "with %ui stripes while previously it used "
+                          "the \"%s\" engine with %ui stripes",
+                          &shm_zone->shm.name,
+                          ctx->stripes ? "gcra" : "rbtree", ctx->stripes,
+                          octx->stripes ? "gcra" : "rbtree", octx->stripes);
+            return NJT_ERROR;
+        }
+
         ctx->sh = octx->sh;
         ctx->shpool = octx->shpool;
+        ctx->gcra = octx->gcra;
 
         return NJT_OK;
     }
@@ -686,11 +1080,12 @@ njt_http_limit_req_init_zone(njt_shm_zone_t *shm_zone, void *data)
 
     if (shm_zone->shm.exists) {
         ctx->sh = ctx->shpool->data;
+        ctx->gcra = ctx->sh->gcra;
 
         return NJT_OK;
     }
 
-    ctx->sh = njt_slab_alloc(ctx->shpool, sizeof(njt_http_limit_req_shctx_t));
+    ctx->sh = njt_slab_calloc(ctx->shpool, sizeof(njt_http_limit_req_shctx_t));
     if (ctx->sh == NULL) {
         return NJT_ERROR;
     }
@@ -714,6 +1109,12 @@ njt_http_limit_req_init_zone(njt_shm_zone_t *shm_zone, void *data)
 
     ctx->shpool->log_nomem = 0;
 
+#if (NJT_HAVE_ATOMIC_OPS && NJT_PTR_SIZE == 8)
+    if (ctx->stripes) {
+        return njt_http_limit_req_gcra_init(shm_zone, ctx);
+    }
+#endif
+
     return NJT_OK;
 }
 
@@ -795,8 +1196,8 @@ njt_http_limit_req_zone(njt_conf_t *cf, njt_command_t *cmd, void *conf)
     size_t                             len;
     ssize_t                            size;
     njt_str_t                         *value, name, s;
-    njt_int_t                          rate, scale;
-    njt_uint_t                         i;
+    njt_int_t                          rate, scale, stripes;
+    njt_uint_t                         i, gcra;
     njt_shm_zone_t                    *shm_zone;
     njt_http_limit_req_ctx_t          *ctx;
     njt_http_compile_complex_value_t   ccv;
@@ -822,6 +1223,8 @@ njt_http_limit_req_zone(njt_conf_t *cf, njt_command_t *cmd, void *conf)
     rate = 1;
     scale = 1;
     name.len = 0;
+    gcra = 0;
+    stripes = NJT_CONF_UNSET;
 
     for (i = 2; i < cf->args->nelts; i++) {
 
@@ -883,11 +1286,51 @@ njt_http_limit_req_zone(njt_conf_t *cf, njt_command_t *cmd, void *conf)
             continue;
         }
 
+        if (njt_strcmp(value[i].data, "engine=rbtree") == 0) {
+            gcra = 0;
+            continue;
+        }
+
+        if (njt_strcmp(value[i].data, "engine=gcra") == 0) {
+#if (NJT_HAVE_ATOMIC_OPS && NJT_PTR_SIZE == 8)
+            gcra = 1;
+            continue;
+#else
+            njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                               "\"engine=gcra\" requires 64-bit atomic "
+                               "operations on this platform");
+            return NJT_CONF_ERROR;
+#endif
+        }
+
+        if (njt_strncmp(value[i].data, "stripes=", 8) == 0) {
+
+            stripes = njt_atoi(value[i].data + 8, value[i].len - 8);
+            if (stripes <= 0 || stripes > 4096) {
+                njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                                   "invalid stripes value \"%V\"", &value[i]);
+                return NJT_CONF_ERROR;
+            }
+
+            continue;
+        }
+
         njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
                            "invalid parameter \"%V\"", &value[i]);
         return NJT_CONF_ERROR;
     }
 
+    if (stripes != NJT_CONF_UNSET && !gcra) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "\"stripes\" requires \"engine=gcra\"");
+        return NJT_CONF_ERROR;
+    }
+
+    if (gcra) {
+        ctx->stripes = (stripes == NJT_CONF_UNSET)
+                       ? NJT_HTTP_LIMIT_REQ_GCRA_STRIPES : (njt_uint_t) stripes;
+    }
+
     if (name.len == 0) {
         njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
                            "\"%V\" must have \"zone\" parameter",
@@ -34,6 +34,12 @@ static njt_int_t njt_http_proxy_eval(njt_http_request_t *r,
 static njt_int_t njt_http_proxy_create_key(njt_http_request_t *r);
 #endif
  njt_int_t njt_http_proxy_create_request(njt_http_request_t *r);
+static size_t njt_http_proxy_uri_len(njt_http_request_t *r,
+    njt_http_proxy_loc_conf_t *plcf, njt_http_proxy_ctx_t *ctx,
+    size_t *loc_len, uintptr_t *escape, njt_uint_t *unparsed_uri);
+static u_char *njt_http_proxy_write_uri(njt_http_request_t *r,
+    njt_http_proxy_loc_conf_t *plcf, njt_http_proxy_ctx_t *ctx, u_char *p,
+    size_t loc_len, uintptr_t escape, njt_uint_t unparsed_uri);
 static njt_int_t njt_http_proxy_reinit_request(njt_http_request_t *r);
 static njt_int_t njt_http_proxy_body_output_filter(void *data, njt_chain_t *in);
 static njt_int_t njt_http_proxy_process_status_line(njt_http_request_t *r);
@@ -86,6 +92,10 @@ static char *njt_http_proxy_merge_loc_conf(njt_conf_t *cf,
 static njt_int_t njt_http_proxy_init_headers(njt_conf_t *cf,
     njt_http_proxy_loc_conf_t *conf, njt_http_proxy_headers_t *headers,
     njt_keyval_t *default_headers);
+#if (NJT_HTTP_GRPC)
+static njt_int_t njt_http_proxy_init_v2_headers(njt_conf_t *cf,
+    njt_http_proxy_loc_conf_t *conf);
+#endif
 
 static char *njt_http_proxy_pass(njt_conf_t *cf, njt_command_t *cmd,
     void *conf);
@@ -178,6 +188,9 @@ static njt_conf_post_t  njt_http_proxy_ssl_conf_command_post =
 static njt_conf_enum_t  njt_http_proxy_http_version[] = {
     { njt_string("1.0"), NJT_HTTP_VERSION_10 },
     { njt_string("1.1"), NJT_HTTP_VERSION_11 },
+#if (NJT_HTTP_GRPC)
+    { njt_string("2"), NJT_HTTP_VERSION_20 },
+#endif
     { njt_null_string, 0 }
 };
 
@@ -576,6 +589,24 @@ static njt_command_t  njt_http_proxy_commands[] = {
       offsetof(njt_http_proxy_loc_conf_t, http_version),
       &njt_http_proxy_http_version },
 
+#if (NJT_HTTP_GRPC)
+
+    { njt_string("proxy_http2_max_concurrent_streams"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_TAKE1,
+      njt_conf_set_num_slot,
+      NJT_HTTP_LOC_CONF_OFFSET,
+      offsetof(njt_http_proxy_loc_conf_t, mux.max_streams),
+      NULL },
+
+    { njt_string("proxy_http2_idle_timeout"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_TAKE1,
+      njt_conf_set_msec_slot,
+      NJT_HTTP_LOC_CONF_OFFSET,
+      offsetof(njt_http_proxy_loc_conf_t, mux.idle_timeout),
+      NULL },
+
+#endif
+
 #if (NJT_HTTP_SSL)
 
     { njt_string("proxy_ssl_session_reuse"),
@@ -760,6 +791,24 @@ static njt_keyval_t  njt_http_proxy_headers[] = {
 };
 
 
+#if (NJT_HTTP_GRPC)
+
+static njt_keyval_t  njt_http_proxy_v2_headers[] = {
+    { njt_string("Content-Length"), njt_string("$content_length") },
+    { njt_string("Host"), njt_string("") },
+    { njt_string("Connection"), njt_string("") },
+    { njt_string("Transfer-Encoding"), njt_string("") },
+    { njt_string("TE"), njt_string("") },
+    { njt_string("Keep-Alive"), njt_string("") },
+    { njt_string("Expect"), njt_string("") },
+    { njt_string("Upgrade"), njt_string("") },
+    { njt_string("Proxy-Connection"), njt_string("") },
+    { njt_null_string, njt_null_string }
+};
+
+#endif
+
+
 static njt_str_t  njt_http_proxy_hide_headers[] = {
     njt_string("Date"),
     njt_string("Server"),
@@ -866,6 +915,13 @@ njt_http_proxy_handler(njt_http_request_t *r)
     njt_http_upstream_t         *u;
     njt_http_proxy_ctx_t        *ctx;
     njt_http_proxy_loc_conf_t   *plcf;
+#if (NJT_HTTP_GRPC)
+    size_t                       loc_len;
+    u_char                      *p;
+    njt_str_t                    path;
+    uintptr_t                    escape;
+    njt_uint_t                   unparsed_uri;
+#endif
     // njt_http_fault_inject_conf_t *ficf;
 #if (NJT_HTTP_CACHE)
     njt_http_proxy_main_conf_t  *pmcf;
@@ -944,10 +1000,53 @@ njt_http_proxy_handler(njt_http_request_t *r)
     if (!plcf->upstream.request_buffering
         && plcf->body_values == NULL && plcf->upstream.pass_request_body
         && (!r->headers_in.chunked
-            || plcf->http_version == NJT_HTTP_VERSION_11))
+            || plcf->http_version >= NJT_HTTP_VERSION_11))
     {
         r->request_body_no_buffering = 1;
     }
+
+#if (NJT_HTTP_GRPC)
+
+    if (plcf->http_version == NJT_HTTP_VERSION_20) {
+
+        /*
+         * HTTP/2 framing, response parsing and keepalive are grpc's;
+         * the request URI is mapped here as in proxy_create_request()
+         */
+
+        path.len = njt_http_proxy_uri_len(r, plcf, ctx, &loc_len, &escape,
+                                          &unparsed_uri);
+
+        if (path.len == 0) {
+            njt_log_error(NJT_LOG_ERR, r->connection->log, 0,
+                          "zero length URI to proxy");
+            return NJT_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        path.data = njt_pnalloc(r->pool, path.len);
+        if (path.data == NULL) {
+            return NJT_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        p = njt_http_proxy_write_uri(r, plcf, ctx, path.data, loc_len, escape,
+                                     unparsed_uri);
+        path.len = p - path.data;
+
+        u->uri = path;
+
+        if (njt_http_grpc_v2_upstream_init(r, &ctx->vars.host_header, &path,
+                                           &plcf->headers_v2, plcf->host_set)
+            != NJT_OK)
+        {
+            return NJT_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        if (njt_http_grpc_mux_init(r, &plcf->mux) != NJT_OK) {
+            return NJT_HTTP_INTERNAL_SERVER_ERROR;
+        }
+    }
+
+#endif
 // rc = njt_http_read_client_request_body(r, njt_http_upstream_init);
     //add by clb
 #if (NJT_HTTP_FAULT_INJECT)
@@ -1273,6 +1372,83 @@ njt_http_proxy_create_key(njt_http_request_t *r)
 #endif
 
 
+static size_t
+njt_http_proxy_uri_len(njt_http_request_t *r, njt_http_proxy_loc_conf_t *plcf,
+    njt_http_proxy_ctx_t *ctx, size_t *loc_len, uintptr_t *escape,
+    njt_uint_t *unparsed_uri)
+{
+#if (NJT_HTTP_DYNAMIC_LOC)
+    njt_http_core_loc_conf_t  *clcf;
+#endif
+
+    *escape = 0;
+    *loc_len = 0;
+    *unparsed_uri = 0;
+
+    if (plcf->proxy_lengths && ctx->vars.uri.len) {
+        return ctx->vars.uri.len;
+    }
+
+    if (ctx->vars.uri.len == 0 && r->valid_unparsed_uri) {
+        *unparsed_uri = 1;
+        return r->unparsed_uri.len;
+    }
+
+    *loc_len = (r->valid_location && ctx->vars.uri.len) ?
+                   plcf->location.len : 0;
+#if (NJT_HTTP_DYNAMIC_LOC)
+    clcf = njt_http_get_module_loc_conf(r, njt_http_core_module);
+
+	if(clcf->if_loc == 1) {  //by zyg
+	  *loc_len = (r->valid_location && ctx->vars.uri.len) ?
+                      r->uri.len : 0;
+	}
+#endif
+    if (r->quoted_uri || r->internal) {
+        *escape = 2 * njt_escape_uri(NULL, r->uri.data + *loc_len,
+                                     r->uri.len - *loc_len, NJT_ESCAPE_URI);
+    }
+
+    return ctx->vars.uri.len + r->uri.len - *loc_len + *escape
+           + sizeof("?") - 1 + r->args.len;
+}
+
+
+static u_char *
+njt_http_proxy_write_uri(njt_http_request_t *r, njt_http_proxy_loc_conf_t *plcf,
+    njt_http_proxy_ctx_t *ctx, u_char *p, size_t loc_len, uintptr_t escape,
+    njt_uint_t unparsed_uri)
+{
+    if (plcf->proxy_lengths && ctx->vars.uri.len) {
+        return njt_copy(p, ctx->vars.uri.data, ctx->vars.uri.len);
+    }
+
+    if (unparsed_uri) {
+        return njt_copy(p, r->unparsed_uri.data, r->unparsed_uri.len);
+    }
+
+    if (r->valid_location) {
+        p = njt_copy(p, ctx->vars.uri.data, ctx->vars.uri.len);
+    }
+
+    if (escape) {
+        njt_escape_uri(p, r->uri.data + loc_len,
+                       r->uri.len - loc_len, NJT_ESCAPE_URI);
+        p += r->uri.len - loc_len + escape;
+
+    } else {
+        p = njt_copy(p, r->uri.data + loc_len, r->uri.len - loc_len);
+    }
+
+    if (r->args.len > 0) {
+        *p++ = '?';
+        p = njt_copy(p, r->args.data, r->args.len);
+    }
+
+    return p;
+}
+
+
  njt_int_t
 njt_http_proxy_create_request(njt_http_request_t *r)
 {
@@ -1292,12 +1468,10 @@ njt_http_proxy_create_request(njt_http_request_t *r)
     njt_http_script_engine_t      e, le;
     njt_http_proxy_loc_conf_t    *plcf;
     njt_http_script_len_code_pt   lcode;
-    njt_http_core_loc_conf_t    *clcf;
 
     u = r->upstream;
 
     plcf = njt_http_get_module_loc_conf(r, njt_http_proxy_module);
-    clcf = njt_http_get_module_loc_conf(r, njt_http_core_module);
 
 #if (NJT_HTTP_CACHE)
     headers = u->cacheable ? &plcf->headers_cache : &plcf->headers;
@@ -1329,34 +1503,8 @@ njt_http_proxy_create_request(njt_http_request_t *r)
     len = method.len + 1 + sizeof(njt_http_proxy_version) - 1
           + sizeof(CRLF) - 1;
 
-    escape = 0;
-    loc_len = 0;
-    unparsed_uri = 0;
-
-    if (plcf->proxy_lengths && ctx->vars.uri.len) {
-        uri_len = ctx->vars.uri.len;
-
-    } else if (ctx->vars.uri.len == 0 && r->valid_unparsed_uri) {
-        unparsed_uri = 1;
-        uri_len = r->unparsed_uri.len;
-
-    } else {
-        loc_len = (r->valid_location && ctx->vars.uri.len) ?
-                      plcf->location.len : 0;
-#if (NJT_HTTP_DYNAMIC_LOC)
-	if(clcf->if_loc == 1) {  //by zyg
-	  loc_len = (r->valid_location && ctx->vars.uri.len) ?
-                      r->uri.len : 0;
-	}
-#endif
-        if (r->quoted_uri || r->internal) {
-            escape = 2 * njt_escape_uri(NULL, r->uri.data + loc_len,
-                                        r->uri.len - loc_len, NJT_ESCAPE_URI);
-        }
-
-        uri_len = ctx->vars.uri.len + r->uri.len - loc_len + escape
-                  + sizeof("?") - 1 + r->args.len;
-    }
+    uri_len = njt_http_proxy_uri_len(r, plcf, ctx, &loc_len, &escape,
+                                     &unparsed_uri);
 
     if (uri_len == 0) {
         njt_log_error(NJT_LOG_ERR, r->connection->log, 0,
@@ -1463,32 +1611,8 @@ njt_http_proxy_create_request(njt_http_request_t *r)
 
     u->uri.data = b->last;
 
-    if (plcf->proxy_lengths && ctx->vars.uri.len) {
-        b->last = njt_copy(b->last, ctx->vars.uri.data, ctx->vars.uri.len);
-
-    } else if (unparsed_uri) {
-        b->last = njt_copy(b->last, r->unparsed_uri.data, r->unparsed_uri.len);
-
-    } else {
-        if (r->valid_location) {
-            b->last = njt_copy(b->last, ctx->vars.uri.data, ctx->vars.uri.len);
-        }
-
-        if (escape) {
-            njt_escape_uri(b->last, r->uri.data + loc_len,
-                           r->uri.len - loc_len, NJT_ESCAPE_URI);
-            b->last += r->uri.len - loc_len + escape;
-
-        } else {
-            b->last = njt_copy(b->last, r->uri.data + loc_len,
-                               r->uri.len - loc_len);
-        }
-
-        if (r->args.len > 0) {
-            *b->last++ = '?';
-            b->last = njt_copy(b->last, r->args.data, r->args.len);
-        }
-    }
+    b->last = njt_http_proxy_write_uri(r, plcf, ctx, b->last, loc_len, escape,
+                                       unparsed_uri);
 
     u->uri.len = b->last - u->uri.data;
 
@@ -3488,6 +3612,11 @@ njt_http_proxy_create_loc_conf(njt_conf_t *cf)
 
     conf->http_version = NJT_CONF_UNSET_UINT;
 
+#if (NJT_HTTP_GRPC)
+    conf->mux.max_streams = NJT_CONF_UNSET_UINT;
+    conf->mux.idle_timeout = NJT_CONF_UNSET_MSEC;
+#endif
+
     conf->headers_hash_max_size = NJT_CONF_UNSET_UINT;
     conf->headers_hash_bucket_size = NJT_CONF_UNSET_UINT;
 
@@ -3786,6 +3915,16 @@ njt_http_proxy_merge_loc_conf(njt_conf_t *cf, void *parent, void *child)
     njt_conf_merge_value(conf->upstream.intercept_errors,
                               prev->upstream.intercept_errors, 0);
 
+    njt_conf_merge_uint_value(conf->http_version, prev->http_version,
+                              NJT_HTTP_VERSION_10);
+
+#if (NJT_HTTP_GRPC)
+    njt_conf_merge_uint_value(conf->mux.max_streams,
+                              prev->mux.max_streams, 128);
+    njt_conf_merge_msec_value(conf->mux.idle_timeout,
+                              prev->mux.idle_timeout, 60000);
+#endif
+
 #if (NJT_HTTP_SSL)
 
     if (njt_http_proxy_merge_ssl(cf, conf, prev) != NJT_OK) {
@@ -3908,9 +4047,6 @@ njt_http_proxy_merge_loc_conf(njt_conf_t *cf, void *parent, void *child)
 
     njt_conf_merge_ptr_value(conf->cookie_flags, prev->cookie_flags, NULL);
 
-    njt_conf_merge_uint_value(conf->http_version, prev->http_version,
-                              NJT_HTTP_VERSION_10);
-
     njt_conf_merge_uint_value(conf->headers_hash_max_size,
                               prev->headers_hash_max_size, 512);
 
@@ -3990,6 +4126,10 @@ njt_http_proxy_merge_loc_conf(njt_conf_t *cf, void *parent, void *child)
         conf->headers = prev->headers;
 #if (NJT_HTTP_CACHE)
         conf->headers_cache = prev->headers_cache;
+#endif
+#if (NJT_HTTP_GRPC)
+        conf->headers_v2 = prev->headers_v2;
+        conf->host_set = prev->host_set;
 #endif
     }
 
@@ -4009,6 +4149,42 @@ njt_http_proxy_merge_loc_conf(njt_conf_t *cf, void *parent, void *child)
         }
     }
 
+#endif
+
+#if (NJT_HTTP_GRPC)
+
+    if (conf->http_version == NJT_HTTP_VERSION_20) {
+
+        if (conf->body_source.data || conf->method) {
+            njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                               "\"proxy_set_body\" and \"proxy_method\" "
+                               "cannot be used with \"proxy_http_version 2\"");
+            return NJT_CONF_ERROR;
+        }
+
+#if (NJT_HTTP_CACHE)
+        if (conf->upstream.cache) {
+            njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                               "\"proxy_cache\" cannot be used with "
+                               "\"proxy_http_version 2\"");
+            return NJT_CONF_ERROR;
+        }
+#endif
+
+        /*
+         * HTTP/2 responses are always passed unbuffered, and control
+         * frames may still be sent to upstream while reading the response
+         */
+
+        conf->upstream.buffering = 0;
+        conf->upstream.change_buffering = 0;
+        conf->upstream.preserve_output = 1;
+
+        if (njt_http_proxy_init_v2_headers(cf, conf) != NJT_OK) {
+            return NJT_CONF_ERROR;
+        }
+    }
+
 #endif
 
     /*
@@ -4025,6 +4201,17 @@ njt_http_proxy_merge_loc_conf(njt_conf_t *cf, void *parent, void *child)
 #endif
     }
 
+#if (NJT_HTTP_GRPC)
+
+    if (prev->headers_v2.hash.buckets == NULL
+        && conf->headers_source == prev->headers_source)
+    {
+        prev->headers_v2 = conf->headers_v2;
+        prev->host_set = conf->host_set;
+    }
+
+#endif
+
     return NJT_CONF_OK;
 }
 
@@ -4196,6 +4383,52 @@ njt_http_proxy_init_headers(njt_conf_t *cf, njt_http_proxy_loc_conf_t *conf,
 }
 
 
+#if (NJT_HTTP_GRPC)
+
+static njt_int_t
+njt_http_proxy_init_v2_headers(njt_conf_t *cf, njt_http_proxy_loc_conf_t *conf)
+{
+    njt_uint_t                 i;
+    njt_keyval_t              *src;
+    njt_http_proxy_headers_t   headers;
+
+    if (conf->headers_v2.hash.buckets) {
+        return NJT_OK;
+    }
+
+    njt_memzero(&headers, sizeof(njt_http_proxy_headers_t));
+
+    if (njt_http_proxy_init_headers(cf, conf, &headers,
+                                    njt_http_proxy_v2_headers)
+        != NJT_OK)
+    {
+        return NJT_ERROR;
+    }
+
+    conf->headers_v2.flushes = headers.flushes;
+    conf->headers_v2.lengths = headers.lengths;
+    conf->headers_v2.values = headers.values;
+    conf->headers_v2.hash = headers.hash;
+
+    if (conf->headers_source) {
+
+        src = conf->headers_source->elts;
+        for (i = 0; i < conf->headers_source->nelts; i++) {
+
+            if (src[i].key.len == 4
+                && njt_strncasecmp(src[i].key.data, (u_char *) "Host", 4) == 0)
+            {
+                conf->host_set = 1;
+            }
+        }
+    }
+
+    return NJT_OK;
+}
+
+#endif
+
+
 static char *
 njt_http_proxy_pass(njt_conf_t *cf, njt_command_t *cmd, void *conf)
 {
@@ -5067,7 +5300,8 @@ njt_http_proxy_merge_ssl(njt_conf_t *cf, njt_http_proxy_loc_conf_t *conf,
 #if (NJT_HAVE_NTLS)
         && conf->upstream.ssl_ntls == NJT_CONF_UNSET
 #endif
-        && conf->ssl_conf_commands == NJT_CONF_UNSET_PTR)
+        && conf->ssl_conf_commands == NJT_CONF_UNSET_PTR
+        && conf->http_version == prev->http_version)
     {
         if (prev->upstream.ssl) {
             conf->upstream.ssl = prev->upstream.ssl;
@@ -5280,6 +5514,19 @@ skip:
         return NJT_ERROR;
     }
     }
+#if (NJT_HTTP_GRPC)
+    else if (plcf->http_version == NJT_HTTP_VERSION_20) {
+
+        if (SSL_CTX_set_alpn_protos(plcf->upstream.ssl->ctx,
+                                    (u_char *) "\x02h2", 3)
+            != 0)
+        {
+            njt_ssl_error(NJT_LOG_EMERG, cf->log, 0,
+                          "SSL_CTX_set_alpn_protos() failed");
+            return NJT_ERROR;
+        }
+    }
+#endif
 #endif
 #endif
     return NJT_OK;
@@ -11,6 +11,9 @@
 #include <njt_config.h>
 #include <njt_core.h>
 #include <njt_http.h>
+#if (NJT_HTTP_GRPC)
+#include <njt_http_grpc_module.h>
+#endif
 
 #define NJT_HAVE_SET_ALPN  1
 
@@ -106,6 +109,12 @@ typedef struct {
 
     njt_uint_t                     http_version;
 
+#if (NJT_HTTP_GRPC)
+    njt_http_grpc_headers_t        headers_v2;
+    njt_uint_t                     host_set;
+    njt_http_grpc_mux_conf_t       mux;
+#endif
+
     njt_uint_t                     headers_hash_max_size;
     njt_uint_t                     headers_hash_bucket_size;
 
@@ -54,15 +54,22 @@ njt_http_ssl_alpn(njt_conf_t *cf, njt_command_t *cmd, void *conf);
 
 static char *njt_http_ssl_password_file(njt_conf_t *cf, njt_command_t *cmd,
     void *conf);
+static char *njt_http_ssl_certificate_cache(njt_conf_t *cf,
+    njt_command_t *cmd, void *conf);
+static char *njt_http_ssl_async_keyops(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf);
 static char *njt_http_ssl_session_cache(njt_conf_t *cf, njt_command_t *cmd,
     void *conf);
 static char *njt_http_ssl_ocsp_cache(njt_conf_t *cf, njt_command_t *cmd,
     void *conf);
+static char *njt_http_ssl_stapling_cache(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf);
 
 static char *njt_http_ssl_conf_command_check(njt_conf_t *cf, void *post,
     void *data);
 
 static njt_int_t njt_http_ssl_init(njt_conf_t *cf);
+static njt_int_t njt_http_ssl_init_process(njt_cycle_t *cycle);
 #if (NJT_QUIC_OPENSSL_COMPAT)
 static njt_int_t njt_http_ssl_quic_compat_init(njt_conf_t *cf,
     njt_http_conf_addr_t *addr);
@@ -137,6 +144,20 @@ static njt_command_t  njt_http_ssl_commands[] = {
 
 #endif
 
+    { njt_string("ssl_certificate_cache"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE123,
+      njt_http_ssl_certificate_cache,
+      NJT_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+    { njt_string("ssl_async_keyops"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE1,
+      njt_http_ssl_async_keyops,
+      NJT_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
     { njt_string("ssl_password_file"),
       NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE1,
       njt_http_ssl_password_file,
@@ -298,6 +319,13 @@ static njt_command_t  njt_http_ssl_commands[] = {
       offsetof(njt_http_ssl_srv_conf_t, stapling_verify),
       NULL },
 
+    { njt_string("ssl_stapling_cache"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE12,
+      njt_http_ssl_stapling_cache,
+      NJT_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
     { njt_string("ssl_early_data"),
       NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_FLAG,
       njt_conf_set_flag_slot,
@@ -362,7 +390,7 @@ njt_module_t  njt_http_ssl_module = {
     NJT_HTTP_MODULE,                       /* module type */
     NULL,                                  /* init master */
     NULL,                                  /* init module */
-    NULL,                                  /* init process */
+    njt_http_ssl_init_process,             /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
     NULL,                                  /* exit process */
@@ -371,6 +399,9 @@ njt_module_t  njt_http_ssl_module = {
 };
 
 
+static njt_uint_t  njt_http_ssl_stapling_cache_tag;
+
+
 static njt_http_variable_t  njt_http_ssl_vars[] = {
 
     { njt_string("ssl_protocol"), NULL, njt_http_ssl_static_variable,
@@ -663,6 +694,7 @@ njt_http_ssl_create_srv_conf(njt_conf_t *cf)
      *     sscf->ocsp_responder = { 0, NULL };
      *     sscf->stapling_file = { 0, NULL };
      *     sscf->stapling_responder = { 0, NULL };
+     *     sscf->stapling_cache_path = { 0, NULL };
      */
 
     sscf->prefer_server_ciphers = NJT_CONF_UNSET;
@@ -676,6 +708,10 @@ njt_http_ssl_create_srv_conf(njt_conf_t *cf)
     sscf->dyn_cert_crc32 = NJT_CONF_UNSET_PTR;   //add by clb
     sscf->cert_types = NJT_CONF_UNSET_PTR;   //add by clb
     sscf->passwords = NJT_CONF_UNSET_PTR;
+    sscf->certificate_cache = NJT_CONF_UNSET_PTR;
+#if (NJT_SSL_ASYNC_KEYOPS)
+    sscf->async_keyops = NJT_CONF_UNSET_PTR;
+#endif
     sscf->conf_commands = NJT_CONF_UNSET_PTR;
     sscf->builtin_session_cache = NJT_CONF_UNSET;
     sscf->session_timeout = NJT_CONF_UNSET;
@@ -685,6 +721,7 @@ njt_http_ssl_create_srv_conf(njt_conf_t *cf)
     sscf->ocsp_cache_zone = NJT_CONF_UNSET_PTR;
     sscf->stapling = NJT_CONF_UNSET;
     sscf->stapling_verify = NJT_CONF_UNSET;
+    sscf->stapling_cache_zone = NJT_CONF_UNSET_PTR;
 #if (NJT_HAVE_NTLS)
     sscf->ntls = NJT_CONF_UNSET;
 #endif
@@ -736,6 +773,12 @@ njt_http_ssl_merge_srv_conf(njt_conf_t *cf, void *parent, void *child)
 
     njt_conf_merge_ptr_value(conf->passwords, prev->passwords, NULL);
 
+    njt_conf_merge_ptr_value(conf->certificate_cache, prev->certificate_cache,
+                             NULL);
+#if (NJT_SSL_ASYNC_KEYOPS)
+    njt_conf_merge_ptr_value(conf->async_keyops, prev->async_keyops, NULL);
+#endif
+
     njt_conf_merge_str_value(conf->dhparam, prev->dhparam, "");
 
     njt_conf_merge_str_value(conf->client_certificate, prev->client_certificate,
@@ -762,6 +805,15 @@ njt_http_ssl_merge_srv_conf(njt_conf_t *cf, void *parent, void *child)
     njt_conf_merge_str_value(conf->stapling_responder,
                          prev->stapling_responder, "");
 
+    if (conf->stapling_cache_zone == NJT_CONF_UNSET_PTR) {
+        conf->stapling_cache_zone = prev->stapling_cache_zone;
+        conf->stapling_cache_path = prev->stapling_cache_path;
+    }
+
+    if (conf->stapling_cache_zone == NJT_CONF_UNSET_PTR) {
+        conf->stapling_cache_zone = NULL;
+    }
+
 #if (NJT_HAVE_NTLS)
     njt_conf_merge_value(conf->ntls, prev->ntls, 0);
 #endif
@@ -972,12 +1024,26 @@ njt_http_ssl_merge_srv_conf(njt_conf_t *cf, void *parent, void *child)
             return NJT_CONF_ERROR;
         }
 
+        if (njt_ssl_stapling_cache(cf, &conf->ssl, conf->stapling_cache_zone,
+                                   &conf->stapling_cache_path)
+            != NJT_OK)
+        {
+            return NJT_CONF_ERROR;
+        }
     }
 
     if (njt_ssl_early_data(cf, &conf->ssl, conf->early_data) != NJT_OK) {
         return NJT_CONF_ERROR;
     }
 
+#if (NJT_SSL_ASYNC_KEYOPS)
+    if (conf->async_keyops
+        && njt_ssl_async_keyops(cf, &conf->ssl, conf->async_keyops) != NJT_OK)
+    {
+        return NJT_CONF_ERROR;
+    }
+#endif
+
     if (njt_ssl_conf_commands(cf, &conf->ssl, conf->conf_commands) != NJT_OK) {
         return NJT_CONF_ERROR;
     }
@@ -1076,6 +1142,157 @@ found:
 }
 
 
+static char *
+njt_http_ssl_certificate_cache(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_ssl_srv_conf_t *sscf = conf;
+
+    time_t       inactive, valid;
+    njt_str_t   *value, s;
+    njt_int_t    max;
+    njt_uint_t   i;
+
+    if (sscf->certificate_cache != NJT_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    max = 0;
+    inactive = 10;
+    valid = 60;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (njt_strncmp(value[i].data, "max=", 4) == 0) {
+
+            max = njt_atoi(value[i].data + 4, value[i].len - 4);
+            if (max <= 0) {
+                goto failed;
+            }
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "inactive=", 9) == 0) {
+
+            s.len = value[i].len - 9;
+            s.data = value[i].data + 9;
+
+            inactive = njt_parse_time(&s, 1);
+            if (inactive == (time_t) NJT_ERROR) {
+                goto failed;
+            }
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "valid=", 6) == 0) {
+
+            s.len = value[i].len - 6;
+            s.data = value[i].data + 6;
+
+            valid = njt_parse_time(&s, 1);
+            if (valid == (time_t) NJT_ERROR) {
+                goto failed;
+            }
+
+            continue;
+        }
+
+        if (njt_strcmp(value[i].data, "off") == 0 && cf->args->nelts == 2) {
+
+            sscf->certificate_cache = NULL;
+
+            return NJT_CONF_OK;
+        }
+
+        goto failed;
+    }
+
+    if (max == 0) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "\"ssl_certificate_cache\" must have "
+                           "the \"max\" parameter");
+        return NJT_CONF_ERROR;
+    }
+
+    sscf->certificate_cache = njt_ssl_cache_init(cf->pool, max, valid,
+                                                 inactive);
+    if (sscf->certificate_cache == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    return NJT_CONF_OK;
+
+failed:
+
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+    return NJT_CONF_ERROR;
+}
+
+
+static char *
+njt_http_ssl_async_keyops(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+#if (NJT_SSL_ASYNC_KEYOPS)
+    njt_http_ssl_srv_conf_t *sscf = conf;
+
+    njt_str_t  name;
+#endif
+
+    njt_str_t  *value;
+
+    value = cf->args->elts;
+
+#if (NJT_SSL_ASYNC_KEYOPS)
+
+    if (sscf->async_keyops != NJT_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    if (njt_strcmp(value[1].data, "off") == 0) {
+        sscf->async_keyops = NULL;
+        return NJT_CONF_OK;
+    }
+
+    if (njt_strcmp(value[1].data, "on") == 0
+        || njt_strcmp(value[1].data, "threads") == 0)
+    {
+        sscf->async_keyops = njt_thread_pool_add(cf, NULL);
+
+    } else if (njt_strncmp(value[1].data, "threads=", 8) == 0) {
+        name.len = value[1].len - 8;
+        name.data = value[1].data + 8;
+
+        sscf->async_keyops = njt_thread_pool_add(cf, &name);
+
+    } else {
+        return "invalid value";
+    }
+
+    if (sscf->async_keyops == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    return NJT_CONF_OK;
+
+#else
+
+    if (njt_strcmp(value[1].data, "off") == 0) {
+        return NJT_CONF_OK;
+    }
+
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                       "\"ssl_async_keyops\" "
+                       "is unsupported on this platform");
+    return NJT_CONF_ERROR;
+
+#endif
+}
+
+
 static char *
 njt_http_ssl_password_file(njt_conf_t *cf, njt_command_t *cmd, void *conf)
 {
@@ -1290,6 +1507,111 @@ invalid:
 }
 
 
+static char *
+njt_http_ssl_stapling_cache(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_ssl_srv_conf_t *sscf = conf;
+
+    size_t       len;
+    njt_int_t    n;
+    njt_str_t   *value, name, size;
+    njt_uint_t   j;
+
+    if (sscf->stapling_cache_zone != NJT_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (njt_strcmp(value[1].data, "off") == 0) {
+
+        if (cf->args->nelts > 2) {
+            return "has invalid parameters";
+        }
+
+        sscf->stapling_cache_zone = NULL;
+        return NJT_CONF_OK;
+    }
+
+    if (value[1].len <= sizeof("shared:") - 1
+        || njt_strncmp(value[1].data, "shared:", sizeof("shared:") - 1) != 0)
+    {
+        goto invalid;
+    }
+
+    len = 0;
+
+    for (j = sizeof("shared:") - 1; j < value[1].len; j++) {
+        if (value[1].data[j] == ':') {
+            break;
+        }
+
+        len++;
+    }
+
+    if (len == 0 || j == value[1].len) {
+        goto invalid;
+    }
+
+    name.len = len;
+    name.data = value[1].data + sizeof("shared:") - 1;
+
+    size.len = value[1].len - j - 1;
+    size.data = name.data + len + 1;
+
+    n = njt_parse_size(&size);
+
+    if (n == NJT_ERROR) {
+        goto invalid;
+    }
+
+    if (n < (njt_int_t) (8 * njt_pagesize)) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "OCSP stapling cache \"%V\" is too small",
+                           &value[1]);
+
+        return NJT_CONF_ERROR;
+    }
+
+    if (cf->args->nelts == 3) {
+
+        if (njt_strncmp(value[2].data, "path=", 5) != 0
+            || value[2].len == 5)
+        {
+            njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                               "invalid parameter \"%V\"", &value[2]);
+            return NJT_CONF_ERROR;
+        }
+
+        sscf->stapling_cache_path.len = value[2].len - 5;
+        sscf->stapling_cache_path.data = value[2].data + 5;
+
+        if (njt_conf_full_name(cf->cycle, &sscf->stapling_cache_path, 0)
+            != NJT_OK)
+        {
+            return NJT_CONF_ERROR;
+        }
+    }
+
+    sscf->stapling_cache_zone = njt_shared_memory_add(cf, &name, n,
+                                              &njt_http_ssl_stapling_cache_tag);
+    if (sscf->stapling_cache_zone == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    sscf->stapling_cache_zone->init = njt_ssl_stapling_cache_init;
+
+    return NJT_CONF_OK;
+
+invalid:
+
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                       "invalid OCSP stapling cache \"%V\"", &value[1]);
+
+    return NJT_CONF_ERROR;
+}
+
+
 static char *
 njt_http_ssl_conf_command_check(njt_conf_t *cf, void *post, void *data)
 {
@@ -1301,6 +1623,13 @@ njt_http_ssl_conf_command_check(njt_conf_t *cf, void *post, void *data)
 }
 
 
+static njt_int_t
+njt_http_ssl_init_process(njt_cycle_t *cycle)
+{
+    return njt_ssl_stapling_init_process(cycle);
+}
+
+
 static njt_int_t
 njt_http_ssl_init(njt_conf_t *cf)
 {
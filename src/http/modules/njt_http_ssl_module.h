@@ -39,6 +39,12 @@ typedef struct {
     njt_array_t                    *certificate_values;
     njt_array_t                    *certificate_key_values;
 
+    njt_ssl_cache_t                *certificate_cache;
+
+#if (NJT_SSL_ASYNC_KEYOPS)
+    njt_thread_pool_t              *async_keyops;
+#endif
+
     njt_array_t                    *dyn_cert_crc32;   //add by clb
     njt_array_t                    *cert_types;        //add by clb
 
@@ -66,6 +72,8 @@ typedef struct {
     njt_flag_t                      stapling_verify;
     njt_str_t                       stapling_file;
     njt_str_t                       stapling_responder;
+    njt_shm_zone_t                 *stapling_cache_zone;
+    njt_str_t                       stapling_cache_path;
 
 #if (NJT_HAVE_NTLS)
     njt_flag_t                      ntls;
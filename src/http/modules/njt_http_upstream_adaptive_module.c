@@ -0,0 +1,1048 @@
+
+/*
+ * Copyright (C) 2021-2023  TMLake(Beijing) Technology Co., Ltd.
+ */
+
+
+#include <njt_config.h>
+#include <njt_core.h>
+#include <njt_http.h>
+#include <njt_http_upstream_adaptive_module.h>
+
+
+#define NJT_HTTP_UPSTREAM_ADAPTIVE_POLL  10
+
+
+typedef struct {
+    njt_uint_t                              priority;
+} njt_http_upstream_adaptive_loc_conf_t;
+
+
+typedef struct {
+    njt_http_upstream_adaptive_srv_conf_t  *conf;
+
+    njt_http_request_t                     *request;
+
+    void                                   *data;
+
+    njt_event_get_peer_pt                   original_get_peer;
+    njt_event_free_peer_pt                  original_free_peer;
+
+#if (NJT_HTTP_SSL)
+    njt_event_set_peer_session_pt           original_set_session;
+    njt_event_save_peer_session_pt          original_save_session;
+#endif
+
+    njt_queue_t                             queue;
+    njt_event_t                             wakeup;
+    uint64_t                                start;
+
+    unsigned                                priority:2;
+    unsigned                                acquired:1;
+    unsigned                                waiting:1;
+} njt_http_upstream_adaptive_peer_data_t;
+
+
+static njt_int_t njt_http_upstream_init_adaptive_peer(njt_http_request_t *r,
+    njt_http_upstream_srv_conf_t *us);
+static njt_int_t njt_http_upstream_get_adaptive_peer(njt_peer_connection_t *pc,
+    void *data);
+static void njt_http_upstream_free_adaptive_peer(njt_peer_connection_t *pc,
+    void *data, njt_uint_t state);
+
+#if (NJT_HTTP_SSL)
+static njt_int_t njt_http_upstream_adaptive_set_session(
+    njt_peer_connection_t *pc, void *data);
+static void njt_http_upstream_adaptive_save_session(njt_peer_connection_t *pc,
+    void *data);
+#endif
+
+static njt_int_t njt_http_upstream_adaptive_acquire(
+    njt_http_upstream_adaptive_srv_conf_t *acf, njt_uint_t priority);
+static void njt_http_upstream_adaptive_release(
+    njt_http_upstream_adaptive_srv_conf_t *acf);
+static njt_int_t njt_http_upstream_adaptive_wait(
+    njt_http_upstream_adaptive_peer_data_t *ap);
+static void njt_http_upstream_adaptive_unwait(
+    njt_http_upstream_adaptive_peer_data_t *ap);
+static void njt_http_upstream_adaptive_drain(
+    njt_http_upstream_adaptive_srv_conf_t *acf);
+static void njt_http_upstream_adaptive_wakeup_handler(njt_event_t *ev);
+static void njt_http_upstream_adaptive_poll_handler(njt_event_t *ev);
+static void njt_http_upstream_adaptive_cleanup(void *data);
+static void njt_http_upstream_adaptive_sample(
+    njt_http_upstream_adaptive_srv_conf_t *acf, uint64_t rtt,
+    njt_uint_t failed);
+static void njt_http_upstream_adaptive_update(
+    njt_http_upstream_adaptive_srv_conf_t *acf);
+
+static njt_int_t njt_http_upstream_adaptive_init_zone(njt_shm_zone_t *shm_zone,
+    void *data);
+static void *njt_http_upstream_adaptive_create_srv_conf(njt_conf_t *cf);
+static void *njt_http_upstream_adaptive_create_loc_conf(njt_conf_t *cf);
+static char *njt_http_upstream_adaptive_merge_loc_conf(njt_conf_t *cf,
+    void *parent, void *child);
+static char *njt_http_upstream_adaptive(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf);
+
+
+static njt_conf_enum_t  njt_http_upstream_adaptive_priorities[] = {
+    { njt_string("high"), NJT_HTTP_UPSTREAM_ADAPTIVE_HIGH },
+    { njt_string("normal"), NJT_HTTP_UPSTREAM_ADAPTIVE_NORMAL },
+    { njt_string("low"), NJT_HTTP_UPSTREAM_ADAPTIVE_LOW },
+    { njt_null_string, 0 }
+};
+
+
+static njt_command_t  njt_http_upstream_adaptive_commands[] = {
+
+    { njt_string("adaptive_concurrency"),
+      NJT_HTTP_UPS_CONF|NJT_CONF_ANY,
+      njt_http_upstream_adaptive,
+      NJT_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+    { njt_string("adaptive_concurrency_priority"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_HTTP_LOC_CONF|NJT_CONF_TAKE1,
+      njt_conf_set_enum_slot,
+      NJT_HTTP_LOC_CONF_OFFSET,
+      offsetof(njt_http_upstream_adaptive_loc_conf_t, priority),
+      &njt_http_upstream_adaptive_priorities },
+
+      njt_null_command
+};
+
+
+static njt_http_module_t  njt_http_upstream_adaptive_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    njt_http_upstream_adaptive_create_srv_conf, /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    njt_http_upstream_adaptive_create_loc_conf, /* create location configuration */
+    njt_http_upstream_adaptive_merge_loc_conf   /* merge location configuration */
+};
+
+
+njt_module_t  njt_http_upstream_adaptive_module = {
+    NJT_MODULE_V1,
+    &njt_http_upstream_adaptive_module_ctx, /* module context */
+    njt_http_upstream_adaptive_commands,    /* module directives */
+    NJT_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NJT_MODULE_V1_PADDING
+};
+
+
+static njt_inline uint64_t
+njt_http_upstream_adaptive_now(void)
+{
+    struct timespec  ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static njt_int_t
+njt_http_upstream_init_adaptive(njt_conf_t *cf,
+    njt_http_upstream_srv_conf_t *us)
+{
+    njt_http_upstream_adaptive_srv_conf_t  *acf;
+
+    njt_log_debug0(NJT_LOG_DEBUG_HTTP, cf->log, 0,
+                   "init adaptive concurrency");
+
+    acf = njt_http_conf_upstream_srv_conf(us,
+                                          njt_http_upstream_adaptive_module);
+
+    if (acf->original_init_upstream(cf, us) != NJT_OK) {
+        return NJT_ERROR;
+    }
+
+    acf->original_init_peer = us->peer.init;
+
+    us->peer.init = njt_http_upstream_init_adaptive_peer;
+
+    njt_queue_init(&acf->waiting[NJT_HTTP_UPSTREAM_ADAPTIVE_HIGH]);
+    njt_queue_init(&acf->waiting[NJT_HTTP_UPSTREAM_ADAPTIVE_NORMAL]);
+
+    acf->poll.handler = njt_http_upstream_adaptive_poll_handler;
+    acf->poll.data = acf;
+    acf->poll.log = cf->cycle->log;
+    acf->poll.cancelable = 1;
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_upstream_init_adaptive_peer(njt_http_request_t *r,
+    njt_http_upstream_srv_conf_t *us)
+{
+    njt_pool_cleanup_t                      *cln;
+    njt_http_upstream_adaptive_srv_conf_t   *acf;
+    njt_http_upstream_adaptive_loc_conf_t   *alcf;
+    njt_http_upstream_adaptive_peer_data_t  *ap;
+
+    njt_log_debug0(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "init adaptive concurrency peer");
+
+    acf = njt_http_conf_upstream_srv_conf(us,
+                                          njt_http_upstream_adaptive_module);
+    alcf = njt_http_get_module_loc_conf(r, njt_http_upstream_adaptive_module);
+
+    ap = njt_pcalloc(r->pool, sizeof(njt_http_upstream_adaptive_peer_data_t));
+    if (ap == NULL) {
+        return NJT_ERROR;
+    }
+
+    cln = njt_pool_cleanup_add(r->pool, 0);
+    if (cln == NULL) {
+        return NJT_ERROR;
+    }
+
+    if (acf->original_init_peer(r, us) != NJT_OK) {
+        return NJT_ERROR;
+    }
+
+    ap->conf = acf;
+    ap->request = r;
+    ap->priority = alcf->priority;
+    ap->data = r->upstream->peer.data;
+    ap->original_get_peer = r->upstream->peer.get;
+    ap->original_free_peer = r->upstream->peer.free;
+
+    r->upstream->peer.data = ap;
+    r->upstream->peer.get = njt_http_upstream_get_adaptive_peer;
+    r->upstream->peer.free = njt_http_upstream_free_adaptive_peer;
+
+#if (NJT_HTTP_SSL)
+    ap->original_set_session = r->upstream->peer.set_session;
+    ap->original_save_session = r->upstream->peer.save_session;
+    r->upstream->peer.set_session = njt_http_upstream_adaptive_set_session;
+    r->upstream->peer.save_session = njt_http_upstream_adaptive_save_session;
+#endif
+
+    cln->handler = njt_http_upstream_adaptive_cleanup;
+    cln->data = ap;
+
+    if (njt_http_upstream_adaptive_acquire(acf, ap->priority) == NJT_OK) {
+        ap->acquired = 1;
+        (void) njt_atomic_fetch_add(&acf->sh->admitted, 1);
+        return NJT_OK;
+    }
+
+    if (njt_http_upstream_adaptive_wait(ap) == NJT_OK) {
+        njt_log_debug1(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "adaptive concurrency limit %uA reached, waiting",
+                       acf->sh->limit);
+        return NJT_AGAIN;
+    }
+
+    (void) njt_atomic_fetch_add(&acf->sh->rejected, 1);
+
+    njt_log_error(NJT_LOG_WARN, r->connection->log, 0,
+                  "upstream \"%V\" reached adaptive concurrency limit %uA",
+                  &r->upstream->upstream->host, acf->sh->limit);
+
+    return NJT_HTTP_SERVICE_UNAVAILABLE;
+}
+
+
+static njt_int_t
+njt_http_upstream_get_adaptive_peer(njt_peer_connection_t *pc, void *data)
+{
+    njt_http_upstream_adaptive_peer_data_t  *ap = data;
+
+    njt_int_t  rc;
+
+    rc = ap->original_get_peer(pc, ap->data);
+
+    if (rc != NJT_OK && rc != NJT_DONE) {
+        return rc;
+    }
+
+    /* next upstream tries are admitted unconditionally */
+
+    if (!ap->acquired) {
+        (void) njt_atomic_fetch_add(&ap->conf->sh->inflight, 1);
+        ap->acquired = 1;
+    }
+
+    ap->start = njt_http_upstream_adaptive_now();
+
+    return rc;
+}
+
+
+static void
+njt_http_upstream_free_adaptive_peer(njt_peer_connection_t *pc, void *data,
+    njt_uint_t state)
+{
+    njt_http_upstream_adaptive_peer_data_t  *ap = data;
+
+    uint64_t  now;
+
+    if (ap->start) {
+        now = njt_http_upstream_adaptive_now();
+
+        njt_http_upstream_adaptive_sample(ap->conf, now - ap->start,
+                                          state & NJT_PEER_FAILED);
+        ap->start = 0;
+    }
+
+    ap->original_free_peer(pc, ap->data, state);
+
+    if (ap->acquired) {
+        ap->acquired = 0;
+        njt_http_upstream_adaptive_release(ap->conf);
+    }
+}
+
+
+#if (NJT_HTTP_SSL)
+
+static njt_int_t
+njt_http_upstream_adaptive_set_session(njt_peer_connection_t *pc, void *data)
+{
+    njt_http_upstream_adaptive_peer_data_t  *ap = data;
+
+    return ap->original_set_session(pc, ap->data);
+}
+
+
+static void
+njt_http_upstream_adaptive_save_session(njt_peer_connection_t *pc, void *data)
+{
+    njt_http_upstream_adaptive_peer_data_t  *ap = data;
+
+    ap->original_save_session(pc, ap->data);
+    return;
+}
+
+#endif
+
+
+static njt_int_t
+njt_http_upstream_adaptive_acquire(njt_http_upstream_adaptive_srv_conf_t *acf,
+    njt_uint_t priority)
+{
+    njt_atomic_uint_t                    n, limit;
+    njt_http_upstream_adaptive_shctx_t  *sh;
+
+    sh = acf->sh;
+    limit = sh->limit;
+
+    /* low priority requests leave a share of the limit to the others */
+
+    if (priority == NJT_HTTP_UPSTREAM_ADAPTIVE_LOW) {
+        limit -= limit * acf->reserve / 100;
+    }
+
+    for ( ;; ) {
+        n = sh->inflight;
+
+        if (n >= limit) {
+            return NJT_BUSY;
+        }
+
+        if (njt_atomic_cmp_set(&sh->inflight, n, n + 1)) {
+            break;
+        }
+    }
+
+    if (n + 1 > sh->peak) {
+        sh->peak = n + 1;
+    }
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_upstream_adaptive_release(njt_http_upstream_adaptive_srv_conf_t *acf)
+{
+    (void) njt_atomic_fetch_add(&acf->sh->inflight, -1);
+
+    if (acf->nwaiting) {
+        njt_http_upstream_adaptive_drain(acf);
+    }
+}
+
+
+static njt_int_t
+njt_http_upstream_adaptive_wait(njt_http_upstream_adaptive_peer_data_t *ap)
+{
+    njt_queue_t                             *q;
+    njt_http_upstream_adaptive_srv_conf_t   *acf;
+    njt_http_upstream_adaptive_peer_data_t  *victim;
+
+    acf = ap->conf;
+
+    if (acf->queue == 0 || ap->priority == NJT_HTTP_UPSTREAM_ADAPTIVE_LOW) {
+        return NJT_DECLINED;
+    }
+
+    if (acf->nwaiting >= acf->queue) {
+
+        /* a high priority request pushes out the latest normal one */
+
+        if (ap->priority != NJT_HTTP_UPSTREAM_ADAPTIVE_HIGH
+            || njt_queue_empty(&acf->waiting[NJT_HTTP_UPSTREAM_ADAPTIVE_NORMAL]))
+        {
+            return NJT_DECLINED;
+        }
+
+        q = njt_queue_last(&acf->waiting[NJT_HTTP_UPSTREAM_ADAPTIVE_NORMAL]);
+        victim = njt_queue_data(q, njt_http_upstream_adaptive_peer_data_t,
+                                queue);
+
+        njt_http_upstream_adaptive_unwait(victim);
+
+        (void) njt_atomic_fetch_add(&acf->sh->rejected, 1);
+
+        njt_post_event(&victim->wakeup, &njt_posted_events);
+    }
+
+    ap->wakeup.handler = njt_http_upstream_adaptive_wakeup_handler;
+    ap->wakeup.data = ap;
+    ap->wakeup.log = ap->request->connection->log;
+
+    njt_queue_insert_tail(&acf->waiting[ap->priority], &ap->queue);
+    ap->waiting = 1;
+    acf->nwaiting++;
+    (void) njt_atomic_fetch_add(&acf->sh->queued, 1);
+
+    njt_add_timer(&ap->wakeup, acf->queue_timeout);
+
+    /* slots freed by other workers are noticed by polling */
+
+    if (!acf->poll.timer_set) {
+        njt_add_timer(&acf->poll, NJT_HTTP_UPSTREAM_ADAPTIVE_POLL);
+    }
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_upstream_adaptive_unwait(njt_http_upstream_adaptive_peer_data_t *ap)
+{
+    njt_http_upstream_adaptive_srv_conf_t  *acf;
+
+    acf = ap->conf;
+
+    njt_queue_remove(&ap->queue);
+    ap->waiting = 0;
+    acf->nwaiting--;
+    (void) njt_atomic_fetch_add(&acf->sh->queued, -1);
+
+    if (ap->wakeup.timer_set) {
+        njt_del_timer(&ap->wakeup);
+    }
+
+    if (acf->nwaiting == 0 && acf->poll.timer_set) {
+        njt_del_timer(&acf->poll);
+    }
+}
+
+
+static void
+njt_http_upstream_adaptive_drain(njt_http_upstream_adaptive_srv_conf_t *acf)
+{
+    njt_uint_t                               i;
+    njt_queue_t                             *q;
+    njt_http_upstream_adaptive_peer_data_t  *ap;
+
+    for (i = NJT_HTTP_UPSTREAM_ADAPTIVE_HIGH;
+         i <= NJT_HTTP_UPSTREAM_ADAPTIVE_NORMAL;
+         i++)
+    {
+        while (!njt_queue_empty(&acf->waiting[i])) {
+
+            if (njt_http_upstream_adaptive_acquire(acf, i) != NJT_OK) {
+                return;
+            }
+
+            q = njt_queue_head(&acf->waiting[i]);
+            ap = njt_queue_data(q, njt_http_upstream_adaptive_peer_data_t,
+                                queue);
+
+            njt_http_upstream_adaptive_unwait(ap);
+
+            ap->acquired = 1;
+            (void) njt_atomic_fetch_add(&acf->sh->admitted, 1);
+
+            /* resumed from the posted events, not from another request */
+
+            njt_post_event(&ap->wakeup, &njt_posted_events);
+        }
+    }
+}
+
+
+static void
+njt_http_upstream_adaptive_wakeup_handler(njt_event_t *ev)
+{
+    njt_int_t                                rc;
+    njt_connection_t                        *c;
+    njt_http_request_t                      *r;
+    njt_http_upstream_adaptive_peer_data_t  *ap;
+
+    ap = ev->data;
+    r = ap->request;
+    c = r->connection;
+
+    if (ap->waiting) {
+        /* queue_timeout expired */
+
+        njt_http_upstream_adaptive_unwait(ap);
+
+        (void) njt_atomic_fetch_add(&ap->conf->sh->timedout, 1);
+
+        njt_log_error(NJT_LOG_WARN, c->log, 0,
+                      "upstream \"%V\" adaptive concurrency queue timed out",
+                      &r->upstream->upstream->host);
+    }
+
+    rc = ap->acquired ? NJT_OK : NJT_HTTP_SERVICE_UNAVAILABLE;
+
+    njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "adaptive concurrency resume: %i", rc);
+
+    njt_http_upstream_init_peer_handler(r, rc);
+
+    njt_http_run_posted_requests(c);
+}
+
+
+static void
+njt_http_upstream_adaptive_poll_handler(njt_event_t *ev)
+{
+    njt_http_upstream_adaptive_srv_conf_t  *acf;
+
+    acf = ev->data;
+
+    njt_http_upstream_adaptive_drain(acf);
+
+    if (acf->nwaiting && !acf->poll.timer_set) {
+        njt_add_timer(&acf->poll, NJT_HTTP_UPSTREAM_ADAPTIVE_POLL);
+    }
+}
+
+
+static void
+njt_http_upstream_adaptive_cleanup(void *data)
+{
+    njt_http_upstream_adaptive_peer_data_t  *ap = data;
+
+    if (ap->waiting) {
+        njt_http_upstream_adaptive_unwait(ap);
+    }
+
+    if (ap->wakeup.timer_set) {
+        njt_del_timer(&ap->wakeup);
+    }
+
+    if (ap->wakeup.posted) {
+        njt_delete_posted_event(&ap->wakeup);
+    }
+
+    if (ap->acquired) {
+        ap->acquired = 0;
+        njt_http_upstream_adaptive_release(ap->conf);
+    }
+}
+
+
+static void
+njt_http_upstream_adaptive_sample(njt_http_upstream_adaptive_srv_conf_t *acf,
+    uint64_t rtt, njt_uint_t failed)
+{
+    njt_http_upstream_adaptive_shctx_t  *sh;
+
+    sh = acf->sh;
+
+    (void) njt_atomic_fetch_add(&sh->rtt_sum, (njt_atomic_int_t) rtt);
+    (void) njt_atomic_fetch_add(&sh->samples, 1);
+
+    if (failed) {
+        (void) njt_atomic_fetch_add(&sh->drops, 1);
+    }
+
+    if ((njt_msec_int_t) (njt_current_msec - sh->window_start)
+        >= (njt_msec_int_t) acf->window)
+    {
+        njt_http_upstream_adaptive_update(acf);
+    }
+}
+
+
+static njt_uint_t
+njt_http_upstream_adaptive_log10(njt_uint_t n)
+{
+    njt_uint_t  log;
+
+    for (log = 1; n >= 100; n /= 10) {
+        log++;
+    }
+
+    return log;
+}
+
+
+static njt_uint_t
+njt_http_upstream_adaptive_sqrt(njt_uint_t n)
+{
+    njt_uint_t  root;
+
+    for (root = 1; (root + 1) * (root + 1) <= n; root++) { /* void */ }
+
+    return root;
+}
+
+
+static void
+njt_http_upstream_adaptive_update(njt_http_upstream_adaptive_srv_conf_t *acf)
+{
+    double                               limit, next, gradient;
+    njt_uint_t                           log;
+    njt_atomic_uint_t                    samples, sum, drops, peak, rtt, lrtt;
+    njt_http_upstream_adaptive_shctx_t  *sh;
+
+    sh = acf->sh;
+
+    if (!njt_atomic_cmp_set(&sh->lock, 0, njt_pid)) {
+        return;
+    }
+
+    if ((njt_msec_int_t) (njt_current_msec - sh->window_start)
+        < (njt_msec_int_t) acf->window)
+    {
+        njt_unlock(&sh->lock);
+        return;
+    }
+
+    samples = sh->samples;
+    sum = sh->rtt_sum;
+    drops = sh->drops;
+    peak = sh->peak;
+
+    (void) njt_atomic_fetch_add(&sh->samples, -(njt_atomic_int_t) samples);
+    (void) njt_atomic_fetch_add(&sh->rtt_sum, -(njt_atomic_int_t) sum);
+    (void) njt_atomic_fetch_add(&sh->drops, -(njt_atomic_int_t) drops);
+
+    sh->peak = sh->inflight;
+    sh->window_start = njt_current_msec;
+
+    if (samples == 0) {
+        njt_unlock(&sh->lock);
+        return;
+    }
+
+    sh->windows++;
+
+    rtt = sum / samples;
+    if (rtt == 0) {
+        rtt = 1;
+    }
+
+    sh->rtt_sample = rtt;
+
+    lrtt = sh->rtt_long;
+    sh->rtt_long = lrtt ? (lrtt * 95 + rtt * 5) / 100 : rtt;
+
+    /*
+     * the no load latency is the lowest latency seen, it slowly drifts
+     * up to follow the backends when they become slower for good
+     */
+
+    if (sh->rtt_noload == 0 || rtt < sh->rtt_noload) {
+        sh->rtt_noload = rtt;
+
+    } else {
+        sh->rtt_noload += sh->rtt_noload / 100 + 1;
+    }
+
+    limit = (double) sh->limit_fp / 1000;
+
+    /*
+     * the limit is not raised while less than half of it was used,
+     * the backend latency says nothing about a larger concurrency then
+     */
+
+    if (acf->algorithm == NJT_HTTP_UPSTREAM_ADAPTIVE_VEGAS) {
+
+        log = njt_http_upstream_adaptive_log10((njt_uint_t) limit);
+
+        /* requests estimated to wait in the backend queues */
+
+        next = limit * (1 - (double) sh->rtt_noload / rtt);
+
+        if (drops) {
+            next = limit - log;
+
+        } else if (peak < limit / 2) {
+            next = limit;
+
+        } else if (next <= log) {
+            next = limit + 6 * log;
+
+        } else if (next < 3 * log) {
+            next = limit + log;
+
+        } else if (next > 6 * log) {
+            next = limit - log;
+
+        } else {
+            next = limit;
+        }
+
+    } else if (drops) {
+        next = limit * 0.9;
+
+    } else {
+        gradient = (double) acf->tolerance * sh->rtt_noload / (100 * rtt);
+        gradient = njt_max(0.5, njt_min(1.0, gradient));
+
+        next = limit * gradient
+               + njt_http_upstream_adaptive_sqrt((njt_uint_t) limit);
+
+        if (next > limit && peak < limit / 2) {
+            next = limit;
+        }
+
+        next = limit * 0.8 + next * 0.2;
+    }
+
+    next = njt_max(next, (double) acf->min);
+    next = njt_min(next, (double) acf->max);
+
+    sh->limit_fp = (njt_atomic_uint_t) (next * 1000);
+    sh->limit = (njt_atomic_uint_t) next;
+
+    njt_log_debug5(NJT_LOG_DEBUG_HTTP, njt_cycle->log, 0,
+                   "adaptive concurrency: rtt:%uA samples:%uA drops:%uA "
+                   "peak:%uA limit:%uA", rtt, samples, drops, peak, sh->limit);
+
+    njt_unlock(&sh->lock);
+}
+
+
+static njt_int_t
+njt_http_upstream_adaptive_init_zone(njt_shm_zone_t *shm_zone, void *data)
+{
+    njt_http_upstream_adaptive_srv_conf_t  *oacf = data;
+
+    njt_slab_pool_t                        *shpool;
+    njt_http_upstream_adaptive_shctx_t     *sh;
+    njt_http_upstream_adaptive_srv_conf_t  *acf;
+
+    acf = shm_zone->data;
+    shpool = (njt_slab_pool_t *) shm_zone->shm.addr;
+
+    if (oacf) {
+        sh = oacf->sh;
+
+    } else if (shm_zone->shm.exists) {
+        sh = shpool->data;
+
+    } else {
+        sh = njt_slab_calloc(shpool, sizeof(njt_http_upstream_adaptive_shctx_t));
+        if (sh == NULL) {
+            return NJT_ERROR;
+        }
+
+        shpool->data = sh;
+
+        sh->limit = acf->initial;
+        sh->limit_fp = acf->initial * 1000;
+        sh->window_start = njt_current_msec;
+    }
+
+    acf->sh = sh;
+
+    /* the learned limit survives reloads, the bounds may have changed */
+
+    if (sh->limit < acf->min || sh->limit > acf->max) {
+        sh->limit = njt_max(njt_min(sh->limit, acf->max), acf->min);
+        sh->limit_fp = sh->limit * 1000;
+    }
+
+    return NJT_OK;
+}
+
+
+static void *
+njt_http_upstream_adaptive_create_srv_conf(njt_conf_t *cf)
+{
+    njt_http_upstream_adaptive_srv_conf_t  *conf;
+
+    conf = njt_pcalloc(cf->pool,
+                       sizeof(njt_http_upstream_adaptive_srv_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    /*
+     * set by njt_pcalloc():
+     *
+     *     conf->sh = NULL;
+     *     conf->shm_zone = NULL;
+     *     conf->original_init_upstream = NULL;
+     *     conf->original_init_peer = NULL;
+     *     conf->nwaiting = 0;
+     */
+
+    return conf;
+}
+
+
+static void *
+njt_http_upstream_adaptive_create_loc_conf(njt_conf_t *cf)
+{
+    njt_http_upstream_adaptive_loc_conf_t  *conf;
+
+    conf = njt_palloc(cf->pool, sizeof(njt_http_upstream_adaptive_loc_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    conf->priority = NJT_CONF_UNSET_UINT;
+
+    return conf;
+}
+
+
+static char *
+njt_http_upstream_adaptive_merge_loc_conf(njt_conf_t *cf, void *parent,
+    void *child)
+{
+    njt_http_upstream_adaptive_loc_conf_t *prev = parent;
+    njt_http_upstream_adaptive_loc_conf_t *conf = child;
+
+    njt_conf_merge_uint_value(conf->priority, prev->priority,
+                              NJT_HTTP_UPSTREAM_ADAPTIVE_NORMAL);
+
+    return NJT_CONF_OK;
+}
+
+
+static char *
+njt_http_upstream_adaptive(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+    njt_http_upstream_adaptive_srv_conf_t  *acf = conf;
+
+    u_char                        *p;
+    njt_int_t                      n;
+    njt_str_t                     *value, s, name;
+    njt_uint_t                     i;
+    njt_http_upstream_srv_conf_t  *uscf;
+
+    if (acf->shm_zone) {
+        return "is duplicate";
+    }
+
+    acf->algorithm = NJT_HTTP_UPSTREAM_ADAPTIVE_GRADIENT;
+    acf->min = 4;
+    acf->max = 1000;
+    acf->initial = 20;
+    acf->queue = 0;
+    acf->queue_timeout = 1000;
+    acf->window = 100;
+    acf->tolerance = 150;
+    acf->reserve = 10;
+
+    value = cf->args->elts;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (njt_strncmp(value[i].data, "algorithm=", 10) == 0) {
+
+            s.len = value[i].len - 10;
+            s.data = value[i].data + 10;
+
+            if (s.len == 8 && njt_strncmp(s.data, "gradient", 8) == 0) {
+                acf->algorithm = NJT_HTTP_UPSTREAM_ADAPTIVE_GRADIENT;
+
+            } else if (s.len == 5 && njt_strncmp(s.data, "vegas", 5) == 0) {
+                acf->algorithm = NJT_HTTP_UPSTREAM_ADAPTIVE_VEGAS;
+
+            } else {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "min=", 4) == 0) {
+
+            n = njt_atoi(value[i].data + 4, value[i].len - 4);
+            if (n == NJT_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            acf->min = n;
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "max=", 4) == 0) {
+
+            n = njt_atoi(value[i].data + 4, value[i].len - 4);
+            if (n == NJT_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            acf->max = n;
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "initial=", 8) == 0) {
+
+            n = njt_atoi(value[i].data + 8, value[i].len - 8);
+            if (n == NJT_ERROR || n == 0) {
+                goto invalid;
+            }
+
+            acf->initial = n;
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "queue=", 6) == 0) {
+
+            n = njt_atoi(value[i].data + 6, value[i].len - 6);
+            if (n == NJT_ERROR) {
+                goto invalid;
+            }
+
+            acf->queue = n;
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "queue_timeout=", 14) == 0) {
+
+            s.len = value[i].len - 14;
+            s.data = value[i].data + 14;
+
+            acf->queue_timeout = njt_parse_time(&s, 0);
+            if (acf->queue_timeout == (njt_msec_t) NJT_ERROR
+                || acf->queue_timeout == 0)
+            {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "window=", 7) == 0) {
+
+            s.len = value[i].len - 7;
+            s.data = value[i].data + 7;
+
+            acf->window = njt_parse_time(&s, 0);
+            if (acf->window == (njt_msec_t) NJT_ERROR || acf->window == 0) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "tolerance=", 10) == 0) {
+
+            n = njt_atofp(value[i].data + 10, value[i].len - 10, 2);
+            if (n == NJT_ERROR || n < 100) {
+                goto invalid;
+            }
+
+            acf->tolerance = n;
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "reserve=", 8) == 0) {
+
+            s.len = value[i].len - 8;
+            s.data = value[i].data + 8;
+
+            if (s.len && s.data[s.len - 1] == '%') {
+                s.len--;
+            }
+
+            n = njt_atoi(s.data, s.len);
+            if (n == NJT_ERROR || n > 90) {
+                goto invalid;
+            }
+
+            acf->reserve = n;
+
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    if (acf->min > acf->max) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "\"min\" is greater than \"max\" in \"%V\"",
+                           &cmd->name);
+        return NJT_CONF_ERROR;
+    }
+
+    acf->initial = njt_max(njt_min(acf->initial, acf->max), acf->min);
+
+    uscf = njt_http_conf_get_module_srv_conf(cf, njt_http_upstream_module);
+
+    name.len = sizeof("adaptive_concurrency:") - 1 + uscf->host.len;
+    name.data = njt_pnalloc(cf->pool, name.len);
+    if (name.data == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    p = njt_cpymem(name.data, "adaptive_concurrency:",
+                   sizeof("adaptive_concurrency:") - 1);
+    njt_memcpy(p, uscf->host.data, uscf->host.len);
+
+    acf->shm_zone = njt_shared_memory_add(cf, &name, 8 * njt_pagesize,
+                                          &njt_http_upstream_adaptive_module);
+    if (acf->shm_zone == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    acf->shm_zone->init = njt_http_upstream_adaptive_init_zone;
+    acf->shm_zone->data = acf;
+
+    /* init upstream handler */
+
+    acf->original_init_upstream = uscf->peer.init_upstream
+                                  ? uscf->peer.init_upstream
+                                  : njt_http_upstream_init_round_robin;
+
+    uscf->peer.init_upstream = njt_http_upstream_init_adaptive;
+
+    return NJT_CONF_OK;
+
+invalid:
+
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\" in \"%V\"", &value[i],
+                       &cmd->name);
+
+    return NJT_CONF_ERROR;
+}
@@ -0,0 +1,79 @@
+
+/*
+ * Copyright (C) 2021-2023  TMLake(Beijing) Technology Co., Ltd.
+ */
+
+
+#ifndef _NJT_HTTP_UPSTREAM_ADAPTIVE_H_INCLUDED_
+#define _NJT_HTTP_UPSTREAM_ADAPTIVE_H_INCLUDED_
+
+
+#include <njt_config.h>
+#include <njt_core.h>
+#include <njt_http.h>
+
+
+#define NJT_HTTP_UPSTREAM_ADAPTIVE_GRADIENT  0
+#define NJT_HTTP_UPSTREAM_ADAPTIVE_VEGAS     1
+
+#define NJT_HTTP_UPSTREAM_ADAPTIVE_HIGH      0
+#define NJT_HTTP_UPSTREAM_ADAPTIVE_NORMAL    1
+#define NJT_HTTP_UPSTREAM_ADAPTIVE_LOW       2
+
+
+/*
+ * shared by all workers of the upstream; round trip times are
+ * in microseconds, limit_fp is the limit scaled by 1000
+ */
+typedef struct {
+    njt_atomic_t                       lock;
+    njt_atomic_t                       limit;
+    njt_atomic_t                       limit_fp;
+    njt_atomic_t                       inflight;
+    njt_atomic_t                       peak;
+    njt_atomic_t                       queued;
+
+    njt_atomic_t                       window_start;
+    njt_atomic_t                       windows;
+    njt_atomic_t                       samples;
+    njt_atomic_t                       rtt_sum;
+    njt_atomic_t                       drops;
+
+    njt_atomic_t                       rtt_sample;
+    njt_atomic_t                       rtt_long;
+    njt_atomic_t                       rtt_noload;
+
+    njt_atomic_t                       admitted;
+    njt_atomic_t                       rejected;
+    njt_atomic_t                       timedout;
+} njt_http_upstream_adaptive_shctx_t;
+
+
+typedef struct {
+    njt_http_upstream_adaptive_shctx_t *sh;
+    njt_shm_zone_t                     *shm_zone;
+
+    njt_uint_t                          algorithm;
+    njt_uint_t                          min;
+    njt_uint_t                          max;
+    njt_uint_t                          initial;
+    njt_uint_t                          queue;
+    njt_msec_t                          queue_timeout;
+    njt_msec_t                          window;
+    njt_uint_t                          tolerance;
+    njt_uint_t                          reserve;
+
+    /* process local wait queues, by priority */
+    njt_queue_t                         waiting[2];
+    njt_uint_t                          nwaiting;
+    njt_event_t                         poll;
+
+    njt_http_upstream_init_pt           original_init_upstream;
+    njt_http_upstream_init_peer_pt      original_init_peer;
+} njt_http_upstream_adaptive_srv_conf_t;
+
+
+extern njt_module_t  njt_http_upstream_adaptive_module;
+
+
+#endif /* _NJT_HTTP_UPSTREAM_ADAPTIVE_H_INCLUDED_ */
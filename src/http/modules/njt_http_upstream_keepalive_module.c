@@ -194,6 +194,7 @@ static njt_int_t
 njt_http_upstream_init_keepalive_peer(njt_http_request_t *r,
     njt_http_upstream_srv_conf_t *us)
 {
+    njt_int_t                                 rc;
     njt_http_upstream_keepalive_peer_data_t  *kp;
     njt_http_upstream_keepalive_srv_conf_t   *kcf;
 
@@ -208,8 +209,12 @@ njt_http_upstream_init_keepalive_peer(njt_http_request_t *r,
         return NJT_ERROR;
     }
 
-    if (kcf->original_init_peer(r, us) != NJT_OK) {
-        return NJT_ERROR;
+    /* NJT_AGAIN: the request waits for a slot in the balancer it wraps */
+
+    rc = kcf->original_init_peer(r, us);
+
+    if (rc != NJT_OK && rc != NJT_AGAIN) {
+        return rc;
     }
 
     kp->conf = kcf;
@@ -229,7 +234,7 @@ njt_http_upstream_init_keepalive_peer(njt_http_request_t *r,
     r->upstream->peer.save_session = njt_http_upstream_keepalive_save_session;
 #endif
 
-    return NJT_OK;
+    return rc;
 }
 
 
@@ -321,6 +321,9 @@ njt_http_upstream_zone_copy_peer(njt_http_upstream_rr_peers_t *peers,
         dst->sockaddr = NULL;
         dst->name.data = NULL;
         dst->server.data = NULL;
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+        dst->zone_label.data = NULL;
+#endif
     }
 
     dst->sockaddr = njt_slab_calloc_locked(pool, sizeof(njt_sockaddr_t));
@@ -343,12 +346,31 @@ njt_http_upstream_zone_copy_peer(njt_http_upstream_rr_peers_t *peers,
         }
 
         njt_memcpy(dst->server.data, src->server.data, src->server.len);
+
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+        if (src->zone_label.len) {
+            dst->zone_label.data = njt_slab_alloc_locked(pool,
+                                                         src->zone_label.len);
+            if (dst->zone_label.data == NULL) {
+                goto failed;
+            }
+
+            njt_memcpy(dst->zone_label.data, src->zone_label.data,
+                       src->zone_label.len);
+        }
+#endif
     }
 
     return dst;
 
 failed:
 
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+    if (dst->zone_label.data) {
+        njt_slab_free_locked(pool, dst->zone_label.data);
+    }
+#endif
+
     if (dst->server.data) {
         njt_slab_free_locked(pool, dst->server.data);
     }
@@ -91,6 +91,7 @@ njt_uint_t njt_http_max_module;
 
 
 njt_http_output_header_filter_pt njt_http_top_header_filter;
+njt_http_early_hints_filter_pt njt_http_top_early_hints_filter;
 njt_http_output_body_filter_pt njt_http_top_body_filter;
 njt_http_request_body_filter_pt njt_http_top_request_body_filter;
 
@@ -133,6 +133,8 @@ void njt_http_split_args(njt_http_request_t *r, njt_str_t *uri,
     njt_str_t *args);
 njt_int_t njt_http_parse_chunked(njt_http_request_t *r, njt_buf_t *b,
     njt_http_chunked_t *ctx);
+njt_int_t njt_http_parse_priority(njt_str_t *value, njt_uint_t *urgency,
+    njt_uint_t *incremental);
 
 njt_int_t njt_http_init_new_locations(njt_conf_t *cf,
     njt_http_core_srv_conf_t *cscf, njt_http_core_loc_conf_t *pclcf);
@@ -178,6 +180,8 @@ njt_int_t njt_http_read_client_request_body(njt_http_request_t *r,
 njt_int_t njt_http_read_unbuffered_request_body(njt_http_request_t *r);
 
 njt_int_t njt_http_send_header(njt_http_request_t *r);
+njt_int_t njt_http_send_early_hints(njt_http_request_t *r,
+    njt_list_t *headers);
 njt_int_t njt_http_special_response_handler(njt_http_request_t *r,
     njt_int_t error);
 njt_int_t njt_http_filter_finalize_request(njt_http_request_t *r,
@@ -220,6 +224,7 @@ extern njt_str_t  njt_http_html_default_types[];
 
 
 extern njt_http_output_header_filter_pt  njt_http_top_header_filter;
+extern njt_http_early_hints_filter_pt    njt_http_top_early_hints_filter;
 extern njt_http_output_body_filter_pt    njt_http_top_body_filter;
 extern njt_http_request_body_filter_pt   njt_http_top_request_body_filter;
 
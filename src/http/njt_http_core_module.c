@@ -2055,6 +2055,33 @@ njt_http_send_header(njt_http_request_t *r)
 }
 
 
+njt_int_t
+njt_http_send_early_hints(njt_http_request_t *r, njt_list_t *headers)
+{
+    njt_int_t  rc;
+
+    if (r != r->main
+        || r->post_action
+        || r->header_sent
+        || r->early_hints_sent
+        || njt_http_top_early_hints_filter == NULL)
+    {
+        return NJT_DECLINED;
+    }
+
+    r->early_hints_sent = 1;
+
+    rc = njt_http_top_early_hints_filter(r, headers);
+
+    if (rc == NJT_AGAIN) {
+        /* the interim response is sent before the final one anyway */
+        return NJT_OK;
+    }
+
+    return rc;
+}
+
+
 njt_int_t
 njt_http_output_filter(njt_http_request_t *r, njt_chain_t *in)
 {
@@ -610,6 +610,8 @@ void njt_http_refresh_variables_keys();
 //end
 
 typedef njt_int_t (*njt_http_output_header_filter_pt)(njt_http_request_t *r);
+typedef njt_int_t (*njt_http_early_hints_filter_pt)
+    (njt_http_request_t *r, njt_list_t *headers);
 typedef njt_int_t (*njt_http_output_body_filter_pt)
     (njt_http_request_t *r, njt_chain_t *chain);
 typedef njt_int_t (*njt_http_request_body_filter_pt)
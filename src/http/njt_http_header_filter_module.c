@@ -14,6 +14,8 @@
 
 static njt_int_t njt_http_header_filter_init(njt_conf_t *cf);
 static njt_int_t njt_http_header_filter(njt_http_request_t *r);
+static njt_int_t njt_http_early_hints_filter(njt_http_request_t *r,
+    njt_list_t *headers);
 
 
 static njt_http_module_t  njt_http_header_filter_module_ctx = {
@@ -626,10 +628,100 @@ njt_http_header_filter(njt_http_request_t *r)
 }
 
 
+static njt_int_t
+njt_http_early_hints_filter(njt_http_request_t *r, njt_list_t *headers)
+{
+    size_t            len;
+    njt_buf_t        *b;
+    njt_uint_t        i;
+    njt_chain_t       out;
+    njt_list_part_t  *part;
+    njt_table_elt_t  *header;
+
+    if (r->http_version < NJT_HTTP_VERSION_11) {
+        return NJT_DECLINED;
+    }
+
+    len = sizeof("HTTP/1.1 103 Early Hints" CRLF) - 1
+          /* the end of the interim response */
+          + sizeof(CRLF) - 1;
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        len += header[i].key.len + sizeof(": ") - 1 + header[i].value.len
+               + sizeof(CRLF) - 1;
+    }
+
+    b = njt_create_temp_buf(r->pool, len);
+    if (b == NULL) {
+        return NJT_ERROR;
+    }
+
+    b->last = njt_cpymem(b->last, "HTTP/1.1 103 Early Hints" CRLF,
+                         sizeof("HTTP/1.1 103 Early Hints" CRLF) - 1);
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        b->last = njt_copy(b->last, header[i].key.data, header[i].key.len);
+        *b->last++ = ':'; *b->last++ = ' ';
+
+        b->last = njt_copy(b->last, header[i].value.data, header[i].value.len);
+        *b->last++ = CR; *b->last++ = LF;
+    }
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "%*s", (size_t) (b->last - b->pos), b->pos);
+
+    *b->last++ = CR; *b->last++ = LF;
+
+    b->flush = 1;
+
+    out.buf = b;
+    out.next = NULL;
+
+    return njt_http_write_filter(r, &out);
+}
+
+
 static njt_int_t
 njt_http_header_filter_init(njt_conf_t *cf)
 {
     njt_http_top_header_filter = njt_http_header_filter;
+    njt_http_top_early_hints_filter = njt_http_early_hints_filter;
 
     return NJT_OK;
 }
@@ -2530,3 +2530,150 @@ invalid:
 
     return NJT_ERROR;
 }
+
+
+/*
+ * parses an RFC 9218 Priority field value, a structured field dictionary;
+ * only the "u" and "i" members are used, the others and all parameters
+ * are skipped, as well as members with values out of range
+ */
+
+njt_int_t
+njt_http_parse_priority(njt_str_t *value, njt_uint_t *urgency,
+    njt_uint_t *incremental)
+{
+    u_char      ch, *p, *q, *end, *key, *val;
+    size_t      klen, vlen;
+    njt_uint_t  u, i, n;
+
+    u = *urgency;
+    i = *incremental;
+
+    p = value->data;
+    end = p + value->len;
+
+    for ( ;; ) {
+
+        while (p < end && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+
+        if (p == end) {
+            break;
+        }
+
+        /* key = ( lcalpha / "*" ) *( lcalpha / DIGIT / "_" / "-" / "." / "*" ) */
+
+        if ((*p < 'a' || *p > 'z') && *p != '*') {
+            return NJT_ERROR;
+        }
+
+        key = p;
+
+        while (p < end) {
+            ch = *p;
+
+            if ((ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9')
+                || ch == '_' || ch == '-' || ch == '.' || ch == '*')
+            {
+                p++;
+                continue;
+            }
+
+            break;
+        }
+
+        klen = p - key;
+
+        if (p < end && *p == '=') {
+            val = ++p;
+
+            if (p < end && *p == '"') {
+                for (p++; p < end && *p != '"'; p++) {
+                    if (*p == '\\' && p + 1 < end) {
+                        p++;
+                    }
+                }
+
+                if (p == end) {
+                    return NJT_ERROR;
+                }
+
+                p++;
+
+            } else {
+                while (p < end && *p != ';' && *p != ',' && *p != ' '
+                       && *p != '\t')
+                {
+                    p++;
+                }
+            }
+
+            vlen = p - val;
+
+            if (vlen == 0) {
+                return NJT_ERROR;
+            }
+
+        } else {
+            /* a bare key is boolean true */
+            val = (u_char *) "?1";
+            vlen = 2;
+        }
+
+        /* parameters */
+
+        while (p < end && *p == ';') {
+            while (p < end && *p != ',') {
+                p++;
+            }
+        }
+
+        if (klen == 1 && key[0] == 'u') {
+
+            /* sf-integer = ["-"] 1*15DIGIT */
+
+            n = 0;
+
+            for (q = val; q < val + vlen && vlen <= 15; q++) {
+                if (*q < '0' || *q > '9') {
+                    break;
+                }
+
+                n = n * 10 + *q - '0';
+            }
+
+            if (q == val + vlen && n < NJT_HTTP_PRIORITY_URGENCY_LEVELS) {
+                u = n;
+            }
+
+        } else if (klen == 1 && key[0] == 'i') {
+
+            if (vlen == 2 && val[0] == '?' && (val[1] == '0' || val[1] == '1'))
+            {
+                i = val[1] - '0';
+            }
+        }
+
+        while (p < end && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+
+        if (p == end) {
+            break;
+        }
+
+        if (*p++ != ',') {
+            return NJT_ERROR;
+        }
+
+        if (p == end) {
+            return NJT_ERROR;
+        }
+    }
+
+    *urgency = u;
+    *incremental = i;
+
+    return NJT_OK;
+}
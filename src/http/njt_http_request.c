@@ -131,6 +131,10 @@ njt_http_header_t  njt_http_headers_in[] = {
                  offsetof(njt_http_headers_in_t, te),
                  njt_http_process_header_line },
 
+    { njt_string("Priority"),
+                 offsetof(njt_http_headers_in_t, priority),
+                 njt_http_process_header_line },
+
     { njt_string("Expect"),
                  offsetof(njt_http_headers_in_t, expect),
                  njt_http_process_unique_header_line },
@@ -1061,6 +1065,7 @@ njt_http_ssl_certificate(njt_ssl_conn_t *ssl_conn, void *arg)
                        "ssl key: \"%s\"", key.data);
 
         if (njt_ssl_connection_certificate(c, r->pool, &cert, &key,
+                                           sscf->certificate_cache,
                                            sscf->passwords)
             != NJT_OK)
         {
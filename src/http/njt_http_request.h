@@ -21,6 +21,11 @@
 #define NJT_HTTP_LINGERING_BUFFER_SIZE     4096
 
 
+/* RFC 9218 extensible priorities */
+#define NJT_HTTP_PRIORITY_URGENCY_LEVELS   8
+#define NJT_HTTP_PRIORITY_URGENCY_DEFAULT  3
+
+
 #define NJT_HTTP_VERSION_9                 9
 #define NJT_HTTP_VERSION_10                1000
 #define NJT_HTTP_VERSION_11                1001
@@ -203,6 +208,7 @@ typedef struct {
     njt_table_elt_t                  *te;
     njt_table_elt_t                  *expect;
     njt_table_elt_t                  *upgrade;
+    njt_table_elt_t                  *priority;
 
 #if (NJT_HTTP_GZIP || NJT_HTTP_HEADERS)
     njt_table_elt_t                  *accept_encoding;
@@ -534,6 +540,8 @@ struct njt_http_request_s {
      */
     unsigned                          limit_conn_status:2;
     unsigned                          limit_req_status:3;
+    /* a limit_req or cluster_limit_req zone refused the request */
+    unsigned                          limit_rejected:1;
 
     unsigned                          limit_rate_set:1;
     unsigned                          limit_rate_after_set:1;
@@ -557,13 +565,14 @@ struct njt_http_request_s {
     unsigned                          request_complete:1;
     unsigned                          request_output:1;
     unsigned                          header_sent:1;
+    unsigned                          early_hints_sent:1;
     unsigned                          response_sent:1;
     unsigned                          expect_tested:1;
     unsigned                          root_tested:1;
     unsigned                          done:1;
     unsigned                          logged:1;
 
-    unsigned                          buffered:4;
+    unsigned                          buffered:5;
 
     unsigned                          main_filter_need_in_memory:1;
     unsigned                          filter_need_in_memory:1;
@@ -571,6 +571,7 @@ njt_http_upstream_init(njt_http_request_t *r)
 static void
 njt_http_upstream_init_request(njt_http_request_t *r)
 {
+    njt_int_t                       rc;
     njt_str_t                      *host;
     njt_uint_t                      i;
     njt_resolver_ctx_t             *ctx, temp;
@@ -595,8 +596,6 @@ njt_http_upstream_init_request(njt_http_request_t *r)
 #if (NJT_HTTP_CACHE)
 
     if (u->conf->cache) {
-        njt_int_t  rc;
-
         rc = njt_http_upstream_cache(r, u);
 
         if (rc == NJT_BUSY) {
@@ -827,9 +826,32 @@ found:
     u->ssl_name = uscf->host;
 #endif
 
-    if (uscf->peer.init(r, uscf) != NJT_OK) {
+    rc = uscf->peer.init(r, uscf);
+
+    if (rc == NJT_AGAIN) {
+        /*
+         * the request was queued by the balancer,
+         * which resumes it with njt_http_upstream_init_peer_handler()
+         */
+        return;
+    }
+
+    njt_http_upstream_init_peer_handler(r, rc);
+}
+
+
+void
+njt_http_upstream_init_peer_handler(njt_http_request_t *r, njt_int_t rc)
+{
+    njt_http_upstream_t  *u;
+
+    u = r->upstream;
+
+    if (rc != NJT_OK) {
         njt_http_upstream_finalize_request(r, u,
-                                           NJT_HTTP_INTERNAL_SERVER_ERROR);
+                                           rc >= NJT_HTTP_SPECIAL_RESPONSE
+                                           ? rc
+                                           : NJT_HTTP_INTERNAL_SERVER_ERROR);
         return;
     }
 
@@ -1639,6 +1661,19 @@ njt_http_upstream_connect(njt_http_request_t *r, njt_http_upstream_t *u)
     u->state->connect_time = (njt_msec_t) -1;
     u->state->header_time = (njt_msec_t) -1;
 
+    if (u->init_peer) {
+
+        /* the balancer is initialized, let the module wrap it */
+
+        if (u->init_peer(r, u->init_peer_data) != NJT_OK) {
+            njt_http_upstream_finalize_request(r, u,
+                                               NJT_HTTP_INTERNAL_SERVER_ERROR);
+            return;
+        }
+
+        u->init_peer = NULL;
+    }
+
     rc = njt_event_connect_peer(&u->peer);
 	
     njt_log_debug1(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
@@ -1761,7 +1796,7 @@ njt_http_upstream_connect(njt_http_request_t *r, njt_http_upstream_t *u)
 
 #if (NJT_HTTP_SSL)
 
-    if (u->ssl && c->ssl == NULL) {
+    if (u->ssl && c->ssl == NULL && !u->multiplexed) {
         njt_http_upstream_ssl_init_connection(r, u, c);
         return;
     }
@@ -1786,56 +1821,12 @@ njt_http_upstream_ssl_init_connection(njt_http_request_t *r,
         return;
     }
 
-#if (NJT_HAVE_NTLS)
-    if (u->conf->ssl_ntls) {
-
-        SSL_CTX_set_ssl_version(u->conf->ssl->ctx, NTLS_method());
-        SSL_CTX_set_cipher_list(u->conf->ssl->ctx,
-                                (char *) u->conf->ssl_ciphers.data);
-        SSL_CTX_enable_ntls(u->conf->ssl->ctx);
-    }
-#endif
-
-    if (njt_ssl_create_connection(u->conf->ssl, c,
-                                  NJT_SSL_BUFFER|NJT_SSL_CLIENT)
-        != NJT_OK)
-    {
+    if (njt_http_upstream_ssl_create_connection(r, u, c) != NJT_OK) {
         njt_http_upstream_finalize_request(r, u,
                                            NJT_HTTP_INTERNAL_SERVER_ERROR);
         return;
     }
 
-    if (u->conf->ssl_server_name || u->conf->ssl_verify) {
-        if (njt_http_upstream_ssl_name(r, u, c) != NJT_OK) {
-            njt_http_upstream_finalize_request(r, u,
-                                               NJT_HTTP_INTERNAL_SERVER_ERROR);
-            return;
-        }
-    }
-
-#if (NJT_HTTP_MULTICERT)
-    if (u->conf->ssl_certificate_values) {
-        if (njt_http_upstream_ssl_certificates(r, u, c) != NJT_OK) {
-            njt_http_upstream_finalize_request(r, u,
-                                               NJT_HTTP_INTERNAL_SERVER_ERROR);
-            return;
-        }
-
-    } else
-#endif
-
-    if (u->conf->ssl_certificate
-        && u->conf->ssl_certificate->value.len
-        && (u->conf->ssl_certificate->lengths
-            || u->conf->ssl_certificate_key->lengths))
-    {
-        if (njt_http_upstream_ssl_certificate(r, u, c) != NJT_OK) {
-            njt_http_upstream_finalize_request(r, u,
-                                               NJT_HTTP_INTERNAL_SERVER_ERROR);
-            return;
-        }
-    }
-
     if (u->conf->ssl_session_reuse) {
         c->ssl->save_session = njt_http_upstream_ssl_save_session;
 
@@ -1875,6 +1866,56 @@ njt_http_upstream_ssl_init_connection(njt_http_request_t *r,
 }
 
 
+njt_int_t
+njt_http_upstream_ssl_create_connection(njt_http_request_t *r,
+    njt_http_upstream_t *u, njt_connection_t *c)
+{
+#if (NJT_HAVE_NTLS)
+    if (u->conf->ssl_ntls) {
+
+        SSL_CTX_set_ssl_version(u->conf->ssl->ctx, NTLS_method());
+        SSL_CTX_set_cipher_list(u->conf->ssl->ctx,
+                                (char *) u->conf->ssl_ciphers.data);
+        SSL_CTX_enable_ntls(u->conf->ssl->ctx);
+    }
+#endif
+
+    if (njt_ssl_create_connection(u->conf->ssl, c,
+                                  NJT_SSL_BUFFER|NJT_SSL_CLIENT)
+        != NJT_OK)
+    {
+        return NJT_ERROR;
+    }
+
+    if (u->conf->ssl_server_name || u->conf->ssl_verify) {
+        if (njt_http_upstream_ssl_name(r, u, c) != NJT_OK) {
+            return NJT_ERROR;
+        }
+    }
+
+#if (NJT_HTTP_MULTICERT)
+    if (u->conf->ssl_certificate_values) {
+        if (njt_http_upstream_ssl_certificates(r, u, c) != NJT_OK) {
+            return NJT_ERROR;
+        }
+
+    } else
+#endif
+
+    if (u->conf->ssl_certificate
+        && u->conf->ssl_certificate->value.len
+        && (u->conf->ssl_certificate->lengths
+            || u->conf->ssl_certificate_key->lengths))
+    {
+        if (njt_http_upstream_ssl_certificate(r, u, c) != NJT_OK) {
+            return NJT_ERROR;
+        }
+    }
+
+    return NJT_OK;
+}
+
+
 static void
 njt_http_upstream_ssl_handshake_handler(njt_connection_t *c)
 {
@@ -2095,7 +2136,7 @@ njt_http_upstream_ssl_certificate(njt_http_request_t *r,
     njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
                    "http upstream ssl key: \"%s\"", key.data);
 
-    if (njt_ssl_connection_certificate(c, r->pool, &cert, &key,
+    if (njt_ssl_connection_certificate(c, r->pool, &cert, &key, NULL,
                                        u->conf->ssl_passwords)
         != NJT_OK)
     {
@@ -2156,7 +2197,7 @@ njt_http_upstream_ssl_certificates(njt_http_request_t *r,
         njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
                        "http upstream ssl key: \"%s\"", keyp->data);
 
-        if (njt_ssl_connection_certificate(c, r->pool, certp, keyp,
+        if (njt_ssl_connection_certificate(c, r->pool, certp, keyp, NULL,
                                            u->conf->ssl_passwords)
             != NJT_OK)
         {
@@ -2274,7 +2315,10 @@ njt_http_upstream_send_request(njt_http_request_t *r, njt_http_upstream_t *u,
         u->state->connect_time = njt_current_msec - u->start_time;
     }
 
-    if (!u->request_sent && njt_http_upstream_test_connect(c) != NJT_OK) {
+    if (!u->request_sent
+        && !u->multiplexed
+        && njt_http_upstream_test_connect(c) != NJT_OK)
+    {
         njt_http_upstream_next(r, u, NJT_HTTP_UPSTREAM_FT_ERROR);
         return;
     }
@@ -2511,7 +2555,7 @@ njt_http_upstream_send_request_handler(njt_http_request_t *r,
 
 #if (NJT_HTTP_SSL)
 
-    if (u->ssl && c->ssl == NULL) {
+    if (u->ssl && c->ssl == NULL && !u->multiplexed) {
         njt_http_upstream_ssl_init_connection(r, u, c);
         return;
     }
@@ -2572,7 +2616,10 @@ njt_http_upstream_process_header(njt_http_request_t *r, njt_http_upstream_t *u)
         return;
     }
 
-    if (!u->request_sent && njt_http_upstream_test_connect(c) != NJT_OK) {
+    if (!u->request_sent
+        && !u->multiplexed
+        && njt_http_upstream_test_connect(c) != NJT_OK)
+    {
         njt_http_upstream_next(r, u, NJT_HTTP_UPSTREAM_FT_ERROR);
         return;
     }
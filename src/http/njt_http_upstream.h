@@ -108,6 +108,7 @@ typedef struct {
     unsigned                         dynamic:1;
     njt_int_t                        parent_id;
     njt_str_t                        route;
+    njt_str_t                        zone_label;
 #endif
     NJT_COMPAT_BEGIN(6)
     NJT_COMPAT_END
@@ -153,6 +154,8 @@ typedef struct {
     unsigned                         reload:1;
     unsigned					     persistent:1;
     unsigned						 mandatory:1;
+    njt_str_t                        locality;
+    njt_uint_t                       locality_spill;
 #endif
 #if (NJT_HTTP_DYNAMIC_UPSTREAM)
     njt_uint_t   ref_count;
@@ -413,6 +416,11 @@ struct njt_http_upstream_s {
     njt_int_t                      (*rewrite_cookie)(njt_http_request_t *r,
                                          njt_table_elt_t *h);
 
+    /* called once before the first connect, after the balancer is set up */
+    njt_int_t                      (*init_peer)(njt_http_request_t *r,
+                                         void *data);
+    void                            *init_peer_data;
+
     njt_msec_t                       start_time;
     njt_msec_t                       req_delay;
 
@@ -445,6 +453,9 @@ struct njt_http_upstream_s {
     unsigned                         request_body_sent:1;
     unsigned                         request_body_blocked:1;
     unsigned                         header_sent:1;
+
+    /* peer.connection is a stream on a shared connection, see init_peer */
+    unsigned                         multiplexed:1;
 };
 
 
@@ -463,6 +474,7 @@ typedef struct {
 
 njt_int_t njt_http_upstream_create(njt_http_request_t *r);
 void njt_http_upstream_init(njt_http_request_t *r);
+void njt_http_upstream_init_peer_handler(njt_http_request_t *r, njt_int_t rc);
 njt_int_t njt_http_upstream_non_buffered_filter_init(void *data);
 njt_int_t njt_http_upstream_non_buffered_filter(void *data, ssize_t bytes);
 njt_http_upstream_srv_conf_t *njt_http_upstream_add(njt_conf_t *cf,
@@ -474,6 +486,10 @@ char *njt_http_upstream_param_set_slot(njt_conf_t *cf, njt_command_t *cmd,
 njt_int_t njt_http_upstream_hide_headers_hash(njt_conf_t *cf,
     njt_http_upstream_conf_t *conf, njt_http_upstream_conf_t *prev,
     njt_str_t *default_hide_headers, njt_hash_init_t *hash);
+#if (NJT_HTTP_SSL)
+njt_int_t njt_http_upstream_ssl_create_connection(njt_http_request_t *r,
+    njt_http_upstream_t *u, njt_connection_t *c);
+#endif
 
 
 #define njt_http_conf_upstream_srv_conf(uscf, module)                         \
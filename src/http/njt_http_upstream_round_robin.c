@@ -19,6 +19,10 @@ static njt_http_upstream_rr_peer_t *njt_http_upstream_get_peer(
     njt_http_upstream_rr_peer_data_t *rrp);
 static njt_int_t
 njt_http_upstream_single_pre_handle_peer(njt_http_upstream_rr_peer_t   *peer);
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+static void njt_http_upstream_rr_locality(njt_pool_t *pool,
+    njt_http_upstream_rr_peer_data_t *rrp, njt_http_upstream_srv_conf_t *us);
+#endif
 
 #if (NJT_HTTP_SSL)
 
@@ -121,6 +125,7 @@ njt_http_upstream_init_round_robin(njt_conf_t *cf,
 		peer[n].hc_upstart = now_time;
 		//zyg
 		peer[n].route = server[i].route;
+		peer[n].zone_label = server[i].zone_label;
 		peer[n].slow_start = server[i].slow_start;
 		peer[n].id = peers->next_order++;
 		peer[n].parent_id = server[i].parent_id;
@@ -204,6 +209,7 @@ njt_http_upstream_init_round_robin(njt_conf_t *cf,
 		peer[n].hc_upstart = now_time;
 		//zyg
 		peer[n].route = server[i].route;
+		peer[n].zone_label = server[i].zone_label;
 		peer[n].slow_start = server[i].slow_start;
 		peer[n].id = peers->next_order++;
 		peer[n].parent_id = server[i].parent_id;
@@ -330,6 +336,14 @@ njt_http_upstream_init_round_robin_peer(njt_http_request_t *r,
         }
     }
 
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+    rrp->zone = NULL;
+
+    if (us->locality.len) {
+        njt_http_upstream_rr_locality(r->pool, rrp, us);
+    }
+#endif
+
     r->upstream->peer.get = njt_http_upstream_get_round_robin_peer;
     r->upstream->peer.free = njt_http_upstream_free_round_robin_peer;
     r->upstream->peer.tries = njt_http_upstream_tries(rrp->peers);
@@ -344,6 +358,110 @@ njt_http_upstream_init_round_robin_peer(njt_http_request_t *r,
 }
 
 
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+
+static void
+njt_http_upstream_rr_locality(njt_pool_t *pool,
+    njt_http_upstream_rr_peer_data_t *rrp, njt_http_upstream_srv_conf_t *us)
+{
+    uintptr_t                      m;
+    njt_uint_t                     i, n, local, healthy, remote, keep_local;
+    njt_http_upstream_rr_peer_t   *peer;
+    njt_http_upstream_rr_peers_t  *peers;
+
+    peers = rrp->peers;
+
+    if (peers->single) {
+        return;
+    }
+
+    local = 0;
+    healthy = 0;
+    remote = 0;
+
+    njt_http_upstream_rr_peers_rlock(peers);
+
+    for (peer = peers->peer; peer; peer = peer->next) {
+
+        if (peer->zone_label.len == us->locality.len
+            && njt_strncmp(peer->zone_label.data, us->locality.data,
+                           us->locality.len) == 0)
+        {
+            local++;
+
+            if (njt_http_upstream_pre_handle_peer(peer) == NJT_OK) {
+                healthy++;
+            }
+
+            continue;
+        }
+
+        if (njt_http_upstream_pre_handle_peer(peer) == NJT_OK) {
+            remote++;
+        }
+    }
+
+    /*
+     * requests stay in the local zone while its healthy fraction is at
+     * least the spill threshold; below that, the local share shrinks in
+     * proportion and the rest spills over to healthy peers elsewhere
+     */
+
+    if (healthy == 0 || (local == healthy && remote == 0)) {
+        goto done;
+    }
+
+    if (healthy * 100 >= us->locality_spill * local || remote == 0) {
+        keep_local = 1;
+
+    } else {
+        keep_local = ((njt_uint_t) njt_random() % (us->locality_spill * local)
+                      < healthy * 100);
+    }
+
+    /* the peers marked are tried once the chosen ones are exhausted */
+
+    if (rrp->tried == &rrp->data) {
+        rrp->zone = &rrp->zone_data;
+        rrp->zone_data = 0;
+
+    } else {
+        n = (peers->number + (8 * sizeof(uintptr_t) - 1))
+            / (8 * sizeof(uintptr_t));
+
+        rrp->zone = njt_pcalloc(pool, n * sizeof(uintptr_t));
+        if (rrp->zone == NULL) {
+            goto done;
+        }
+    }
+
+    for (peer = peers->peer, i = 0;
+         peer && i < peers->number;
+         peer = peer->next, i++)
+    {
+        if ((peer->zone_label.len == us->locality.len
+             && njt_strncmp(peer->zone_label.data, us->locality.data,
+                            us->locality.len) == 0)
+            == keep_local)
+        {
+            continue;
+        }
+
+        n = i / (8 * sizeof(uintptr_t));
+        m = (uintptr_t) 1 << i % (8 * sizeof(uintptr_t));
+
+        rrp->tried[n] |= m;
+        rrp->zone[n] |= m;
+    }
+
+done:
+
+    njt_http_upstream_rr_peers_unlock(peers);
+}
+
+#endif
+
+
 njt_int_t
 njt_http_upstream_create_round_robin_peer(njt_http_request_t *r,
     njt_http_upstream_resolved_t *ur)
@@ -440,6 +558,9 @@ njt_http_upstream_create_round_robin_peer(njt_http_request_t *r,
     rrp->peers = peers;
     rrp->current = NULL;
     rrp->config = 0;
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+    rrp->zone = NULL;
+#endif
 
     if (rrp->peers->number <= 8 * sizeof(uintptr_t)) {
         rrp->tried = &rrp->data;
@@ -529,6 +650,28 @@ njt_http_upstream_get_round_robin_peer(njt_peer_connection_t *pc, void *data)
 
 failed:
 
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+    if (rrp->zone) {
+
+        /* the zone chosen by locality is exhausted, try the other peers */
+
+        njt_log_debug0(NJT_LOG_DEBUG_HTTP, pc->log, 0, "locality spill over");
+
+        n = (peers->number + (8 * sizeof(uintptr_t) - 1))
+                / (8 * sizeof(uintptr_t));
+
+        for (i = 0; i < n; i++) {
+            rrp->tried[i] &= ~rrp->zone[i];
+        }
+
+        rrp->zone = NULL;
+
+        njt_http_upstream_rr_peers_unlock(peers);
+
+        return njt_http_upstream_get_round_robin_peer(pc, rrp);
+    }
+#endif
+
     if (peers->next && peers->next->number > 0) { //by zyg
 
         njt_log_debug0(NJT_LOG_DEBUG_HTTP, pc->log, 0, "backup servers");
@@ -947,11 +1090,49 @@ njt_http_upstream_free_peer_memory(njt_slab_pool_t *pool, njt_http_upstream_rr_p
     if (peer->route.data) {
         njt_slab_free_locked(pool, peer->route.data);
     }
+    if (peer->zone_label.data) {
+        njt_slab_free_locked(pool, peer->zone_label.data);
+    }
     njt_slab_free_locked(pool, peer);
 
     return;
 }
 
+
+njt_int_t
+njt_http_upstream_set_peer_zone_label_locked(njt_slab_pool_t *pool,
+    njt_http_upstream_rr_peer_t *peer, njt_str_t *label)
+{
+    u_char  *p;
+
+    if (peer->zone_label.len == label->len
+        && (label->len == 0
+            || njt_memcmp(peer->zone_label.data, label->data, label->len) == 0))
+    {
+        return NJT_OK;
+    }
+
+    p = NULL;
+
+    if (label->len) {
+        p = njt_slab_alloc_locked(pool, label->len);
+        if (p == NULL) {
+            return NJT_ERROR;
+        }
+
+        njt_memcpy(p, label->data, label->len);
+    }
+
+    if (peer->zone_label.data) {
+        njt_slab_free_locked(pool, peer->zone_label.data);
+    }
+
+    peer->zone_label.len = label->len;
+    peer->zone_label.data = p;
+
+    return NJT_OK;
+}
+
 #endif
 
 njt_int_t
@@ -59,6 +59,7 @@ struct njt_http_upstream_rr_peer_s {
 
     njt_uint_t                      requests;   
     njt_str_t                       route;
+    njt_str_t                       zone_label;
     njt_int_t                       parent_id;
     njt_uint_t                      hc_checks;
     njt_uint_t                      hc_fails;
@@ -164,6 +165,10 @@ typedef struct {
     njt_http_upstream_rr_peer_t    *current;
     uintptr_t                      *tried;
     uintptr_t                       data;
+#if (NJT_HTTP_UPSTREAM_DYNAMIC_SERVER)
+    uintptr_t                      *zone;   /* tried set by locality */
+    uintptr_t                       zone_data;
+#endif
 } njt_http_upstream_rr_peer_data_t;
 
 
@@ -179,6 +184,8 @@ void njt_http_upstream_free_round_robin_peer(njt_peer_connection_t *pc,
     void *data, njt_uint_t state);
 void njt_http_upstream_free_peer_memory(njt_slab_pool_t *pool,
         njt_http_upstream_rr_peer_t *peer);
+njt_int_t njt_http_upstream_set_peer_zone_label_locked(njt_slab_pool_t *pool,
+    njt_http_upstream_rr_peer_t *peer, njt_str_t *label);
 njt_int_t
 njt_http_upstream_pre_handle_peer(njt_http_upstream_rr_peer_t   *peer);
 #if (NJT_HTTP_SSL)
@@ -35,6 +35,7 @@
 #define NJT_HTTP_V2_PING_SIZE                    8
 #define NJT_HTTP_V2_GOAWAY_SIZE                  8
 #define NJT_HTTP_V2_WINDOW_UPDATE_SIZE           4
+#define NJT_HTTP_V2_PRIORITY_UPDATE_SIZE         4
 
 #define NJT_HTTP_V2_SETTINGS_PARAM_SIZE          6
 
@@ -44,6 +45,7 @@
 #define NJT_HTTP_V2_MAX_STREAMS_SETTING          0x3
 #define NJT_HTTP_V2_INIT_WINDOW_SIZE_SETTING     0x4
 #define NJT_HTTP_V2_MAX_FRAME_SIZE_SETTING       0x5
+#define NJT_HTTP_V2_NO_RFC7540_PRIORITIES        0x9
 
 #define NJT_HTTP_V2_FRAME_BUFFER_SIZE            24
 
@@ -86,6 +88,8 @@ static u_char *njt_http_v2_handle_continuation(njt_http_v2_connection_t *h2c,
     u_char *pos, u_char *end, njt_http_v2_handler_pt handler);
 static u_char *njt_http_v2_state_priority(njt_http_v2_connection_t *h2c,
     u_char *pos, u_char *end);
+static u_char *njt_http_v2_state_priority_update(
+    njt_http_v2_connection_t *h2c, u_char *pos, u_char *end);
 static u_char *njt_http_v2_state_rst_stream(njt_http_v2_connection_t *h2c,
     u_char *pos, u_char *end);
 static u_char *njt_http_v2_state_settings(njt_http_v2_connection_t *h2c,
@@ -159,6 +163,7 @@ static njt_int_t njt_http_v2_construct_request_line(njt_http_request_t *r);
 static njt_int_t njt_http_v2_cookie(njt_http_request_t *r,
     njt_http_v2_header_t *header);
 static njt_int_t njt_http_v2_construct_cookie_header(njt_http_request_t *r);
+static void njt_http_v2_set_priority(njt_http_request_t *r);
 static void njt_http_v2_run_request(njt_http_request_t *r);
 static njt_int_t njt_http_v2_process_request_body(njt_http_request_t *r,
     u_char *pos, size_t size, njt_uint_t last, njt_uint_t flush);
@@ -203,6 +208,9 @@ static njt_http_v2_handler_pt njt_http_v2_frame_states[] = {
 void
 njt_http_v2_init(njt_event_t *rev)
 {
+#if (NJT_HAVE_NOTSENT_LOWAT)
+    int                        lowat;
+#endif
     u_char                    *p, *end;
     njt_connection_t          *c;
     njt_pool_cleanup_t        *cln;
@@ -250,12 +258,39 @@ njt_http_v2_init(njt_event_t *rev)
 
     h2c->priority_limit = njt_max(h2scf->concurrent_streams, 100);
 
+    h2c->hpack_enc.max = h2scf->hpack_table_size;
+    h2c->hpack_enc.limit = NJT_HTTP_V2_TABLE_SIZE;
+    h2c->hpack_enc.size = NJT_HTTP_V2_TABLE_SIZE;
+
     h2c->pool = njt_create_pool(h2scf->pool_size, h2c->connection->log);
     if (h2c->pool == NULL) {
         njt_http_close_connection(c);
         return;
     }
 
+#if (NJT_HAVE_NOTSENT_LOWAT)
+
+    /*
+     * keeps the unsent part of the socket buffer short, so frames wait
+     * in the output queue where they are ordered by priorities
+     */
+
+    if (h2scf->notsent_lowat
+        && c->tcp_nodelay != NJT_TCP_NODELAY_DISABLED)
+    {
+        lowat = (int) h2scf->notsent_lowat;
+
+        if (setsockopt(c->fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                       (const void *) &lowat, sizeof(int))
+            == -1)
+        {
+            njt_connection_error(c, njt_socket_errno,
+                                 "setsockopt(TCP_NOTSENT_LOWAT) failed");
+        }
+    }
+
+#endif
+
     cln = njt_pool_cleanup_add(c->pool, 0);
     if (cln == NULL) {
         njt_http_close_connection(c);
@@ -504,6 +539,8 @@ njt_int_t
 njt_http_v2_send_output_queue(njt_http_v2_connection_t *h2c)
 {
     int                        tcp_nodelay;
+    uint64_t                   priority;
+    njt_uint_t                 urgency;
     njt_chain_t               *cl;
     njt_event_t               *wev;
     njt_connection_t          *c;
@@ -571,11 +608,23 @@ njt_http_v2_send_output_queue(njt_http_v2_connection_t *h2c)
     for ( /* void */ ; out; out = fn) {
         fn = out->next;
 
+        /* the handler may free the frame */
+        priority = out->priority;
+
         if (out->handler(h2c, out) != NJT_OK) {
             out->blocked = 1;
             break;
         }
 
+        if (priority & NJT_HTTP_V2_PRIORITY_INCREMENTAL) {
+            urgency = priority >> 61;
+            priority &= NJT_HTTP_V2_PRIORITY_ORDER;
+
+            if (h2c->vtime[urgency] < priority) {
+                h2c->vtime[urgency] = priority;
+            }
+        }
+
         njt_log_debug4(NJT_LOG_DEBUG_HTTP, c->log, 0,
                        "http2 frame sent: %p sid:%ui bl:%d len:%uz",
                        out, out->stream ? out->stream->node->id : 0,
@@ -901,6 +950,10 @@ njt_http_v2_state_head(njt_http_v2_connection_t *h2c, u_char *pos, u_char *end)
                    "http2 frame type:%ui f:%Xd l:%uz sid:%ui",
                    type, h2c->state.flags, h2c->state.length, h2c->state.sid);
 
+    if (type == NJT_HTTP_V2_PRIORITY_UPDATE_FRAME) {
+        return njt_http_v2_state_priority_update(h2c, pos, end);
+    }
+
     if (type >= NJT_HTTP_V2_FRAME_STATES) {
         njt_log_error(NJT_LOG_INFO, h2c->connection->log, 0,
                       "client sent frame with unknown type %ui", type);
@@ -2048,6 +2101,87 @@ njt_http_v2_state_priority(njt_http_v2_connection_t *h2c, u_char *pos,
 }
 
 
+static u_char *
+njt_http_v2_state_priority_update(njt_http_v2_connection_t *h2c, u_char *pos,
+    u_char *end)
+{
+    njt_str_t              value;
+    njt_uint_t             sid, urgency, incremental;
+    njt_http_v2_node_t    *node;
+    njt_http_v2_stream_t  *stream;
+
+    if (h2c->state.length < NJT_HTTP_V2_PRIORITY_UPDATE_SIZE) {
+        njt_log_error(NJT_LOG_INFO, h2c->connection->log, 0,
+                      "client sent PRIORITY_UPDATE frame "
+                      "with incorrect length %uz", h2c->state.length);
+
+        return njt_http_v2_connection_error(h2c, NJT_HTTP_V2_SIZE_ERROR);
+    }
+
+    if (h2c->state.sid != 0) {
+        njt_log_error(NJT_LOG_INFO, h2c->connection->log, 0,
+                      "client sent PRIORITY_UPDATE frame "
+                      "with incorrect identifier");
+
+        return njt_http_v2_connection_error(h2c, NJT_HTTP_V2_PROTOCOL_ERROR);
+    }
+
+    if ((size_t) (end - pos) < h2c->state.length) {
+
+        if (h2c->state.length > NJT_HTTP_V2_STATE_BUFFER_SIZE) {
+            /* no priority field of interest is that long */
+            return njt_http_v2_state_skip(h2c, pos, end);
+        }
+
+        return njt_http_v2_state_save(h2c, pos, end,
+                                      njt_http_v2_state_priority_update);
+    }
+
+    if (--h2c->priority_limit == 0) {
+        njt_log_error(NJT_LOG_INFO, h2c->connection->log, 0,
+                      "client sent too many PRIORITY_UPDATE frames");
+
+        return njt_http_v2_connection_error(h2c, NJT_HTTP_V2_ENHANCE_YOUR_CALM);
+    }
+
+    sid = njt_http_v2_parse_sid(pos);
+
+    value.data = pos + NJT_HTTP_V2_PRIORITY_UPDATE_SIZE;
+    value.len = h2c->state.length - NJT_HTTP_V2_PRIORITY_UPDATE_SIZE;
+
+    pos += h2c->state.length;
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 PRIORITY_UPDATE frame sid:%ui \"%V\"",
+                   sid, &value);
+
+    if (sid == 0) {
+        njt_log_error(NJT_LOG_INFO, h2c->connection->log, 0,
+                      "client sent PRIORITY_UPDATE frame for stream 0");
+
+        return njt_http_v2_connection_error(h2c, NJT_HTTP_V2_PROTOCOL_ERROR);
+    }
+
+    /* updates of idle and closed streams are ignored */
+
+    node = njt_http_v2_get_node_by_id(h2c, sid, 0);
+
+    if (node && node->stream) {
+        stream = node->stream;
+
+        urgency = NJT_HTTP_PRIORITY_URGENCY_DEFAULT;
+        incremental = 0;
+
+        if (njt_http_parse_priority(&value, &urgency, &incremental) == NJT_OK) {
+            stream->urgency = urgency;
+            stream->incremental = incremental;
+        }
+    }
+
+    return njt_http_v2_state_complete(h2c, pos, end);
+}
+
+
 static u_char *
 njt_http_v2_state_rst_stream(njt_http_v2_connection_t *h2c, u_char *pos,
     u_char *end)
@@ -2242,6 +2376,7 @@ njt_http_v2_state_settings_params(njt_http_v2_connection_t *h2c, u_char *pos,
 
         case NJT_HTTP_V2_HEADER_TABLE_SIZE_SETTING:
 
+            h2c->hpack_enc.limit = value;
             h2c->table_update = 1;
             break;
 
@@ -2714,7 +2849,7 @@ njt_http_v2_send_settings(njt_http_v2_connection_t *h2c)
         return NJT_ERROR;
     }
 
-    len = NJT_HTTP_V2_SETTINGS_PARAM_SIZE * 3;
+    len = NJT_HTTP_V2_SETTINGS_PARAM_SIZE * 4;
 
     buf = njt_create_temp_buf(h2c->pool, NJT_HTTP_V2_FRAME_HEADER_SIZE + len);
     if (buf == NULL) {
@@ -2759,6 +2894,12 @@ njt_http_v2_send_settings(njt_http_v2_connection_t *h2c)
     buf->last = njt_http_v2_write_uint32(buf->last,
                                          NJT_HTTP_V2_MAX_FRAME_SIZE);
 
+    /* streams are scheduled by RFC 9218 priorities */
+
+    buf->last = njt_http_v2_write_uint16(buf->last,
+                                         NJT_HTTP_V2_NO_RFC7540_PRIORITIES);
+    buf->last = njt_http_v2_write_uint32(buf->last, 1);
+
     njt_http_v2_queue_blocked_frame(h2c, frame);
 
     return NJT_OK;
@@ -3090,6 +3231,10 @@ njt_http_v2_create_stream(njt_http_v2_connection_t *h2c)
     stream->send_window = h2c->init_window;
     stream->recv_window = h2scf->preread_size;
 
+    /* streams without a priority signal share the bandwidth */
+    stream->urgency = NJT_HTTP_PRIORITY_URGENCY_DEFAULT;
+    stream->incremental = 1;
+
     h2c->processing++;
 
     h2c->priority_limit += h2scf->concurrent_streams;
@@ -3730,6 +3875,34 @@ njt_http_v2_construct_cookie_header(njt_http_request_t *r)
 }
 
 
+static void
+njt_http_v2_set_priority(njt_http_request_t *r)
+{
+    njt_uint_t        urgency, incremental;
+    njt_table_elt_t  *h;
+
+    urgency = NJT_HTTP_PRIORITY_URGENCY_DEFAULT;
+    incremental = 0;
+
+    for (h = r->headers_in.priority; h; h = h->next) {
+        if (njt_http_parse_priority(&h->value, &urgency, &incremental)
+            != NJT_OK)
+        {
+            njt_log_error(NJT_LOG_INFO, r->connection->log, 0,
+                          "client sent invalid priority header: \"%V\"",
+                          &h->value);
+            return;
+        }
+    }
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http2 priority u:%ui i:%ui", urgency, incremental);
+
+    r->stream->urgency = urgency;
+    r->stream->incremental = incremental;
+}
+
+
 static void
 njt_http_v2_run_request(njt_http_request_t *r)
 {
@@ -3764,6 +3937,10 @@ njt_http_v2_run_request(njt_http_request_t *r)
         goto failed;
     }
 
+    if (r->headers_in.priority) {
+        njt_http_v2_set_priority(r);
+    }
+
     if (r->headers_in.content_length_n > 0 && r->stream->in_closed) {
         njt_log_error(NJT_LOG_INFO, r->connection->log, 0,
                       "client prematurely closed stream");
@@ -22,6 +22,7 @@
 #define NJT_HTTP_V2_MAX_FRAME_SIZE       ((1 << 24) - 1)
 
 #define NJT_HTTP_V2_INT_OCTETS           4
+#define NJT_HTTP_V2_TABLE_SIZE           4096
 #define NJT_HTTP_V2_MAX_FIELD                                                 \
     (127 + (1 << (NJT_HTTP_V2_INT_OCTETS - 1) * 7) - 1)
 
@@ -38,6 +39,7 @@
 #define NJT_HTTP_V2_GOAWAY_FRAME         0x7
 #define NJT_HTTP_V2_WINDOW_UPDATE_FRAME  0x8
 #define NJT_HTTP_V2_CONTINUATION_FRAME   0x9
+#define NJT_HTTP_V2_PRIORITY_UPDATE_FRAME  0x10
 
 /* frame flags */
 #define NJT_HTTP_V2_NO_FLAG              0x00
@@ -68,6 +70,8 @@ typedef struct {
     njt_uint_t                       concurrent_streams;
     size_t                           preread_size;
     njt_uint_t                       streams_index_mask;
+    size_t                           hpack_table_size;
+    size_t                           notsent_lowat;
 } njt_http_v2_srv_conf_t;
 
 typedef struct {
@@ -121,6 +125,42 @@ typedef struct {
 } njt_http_v2_hpack_t;
 
 
+typedef struct {
+    njt_uint_t                       hash;
+    njt_uint_t                       name_hash;
+    size_t                           name_len;
+    size_t                           value_len;
+    size_t                           offset;
+    size_t                           literal;
+    njt_uint_t                       hits;
+} njt_http_v2_hpack_entry_t;
+
+
+/*
+ * the encoder side of the dynamic table of response headers; entries
+ * are kept in insertion order, as the client evicts them, names and
+ * values are appended to the storage which is compacted when full
+ */
+
+typedef struct {
+    njt_http_v2_hpack_entry_t       *entries;
+
+    njt_uint_t                       added;
+    njt_uint_t                       deleted;
+    njt_uint_t                       allocated;
+
+    size_t                           max;
+    size_t                           limit;
+    size_t                           size;
+    size_t                           used;
+
+    u_char                          *storage;
+    size_t                           last;
+
+    off_t                            saved;
+} njt_http_v2_hpack_enc_t;
+
+
 struct njt_http_v2_connection_s {
     njt_connection_t                *connection;
     njt_http_connection_t           *http_connection;
@@ -146,6 +186,7 @@ struct njt_http_v2_connection_s {
     njt_http_v2_state_t              state;
 
     njt_http_v2_hpack_t              hpack;
+    njt_http_v2_hpack_enc_t          hpack_enc;
 
     njt_pool_t                      *pool;
 
@@ -156,6 +197,9 @@ struct njt_http_v2_connection_s {
 
     njt_http_v2_out_frame_t         *last_out;
 
+    /* virtual time of incremental streams, per urgency */
+    uint64_t                         vtime[NJT_HTTP_PRIORITY_URGENCY_LEVELS];
+
     njt_queue_t                      dependencies;
     njt_queue_t                      closed;
 
@@ -213,6 +257,12 @@ struct njt_http_v2_stream_s {
 
     njt_pool_t                      *pool;
 
+    size_t                           header_saved;
+
+    uint64_t                         vtime;
+
+    unsigned                         urgency:3;
+    unsigned                         incremental:1;
     unsigned                         waiting:1;
     unsigned                         blocked:1;
     unsigned                         exhausted:1;
@@ -234,28 +284,63 @@ struct njt_http_v2_out_frame_s {
     njt_http_v2_stream_t            *stream;
     size_t                           length;
 
+    /* urgency, incremental flag and order within the bucket */
+    uint64_t                         priority;
+
     unsigned                         blocked:1;
     unsigned                         fin:1;
 };
 
 
+#define NJT_HTTP_V2_PRIORITY_INCREMENTAL  ((uint64_t) 1 << 60)
+#define NJT_HTTP_V2_PRIORITY_ORDER        (NJT_HTTP_V2_PRIORITY_INCREMENTAL - 1)
+
+
+/*
+ * frames of streams are ordered by urgency first; within an urgency
+ * non-incremental streams go by stream id, one after another, and
+ * incremental ones round-robin by the virtual time of their data
+ */
+
+static njt_inline void
+njt_http_v2_frame_priority(njt_http_v2_connection_t *h2c,
+    njt_http_v2_out_frame_t *frame)
+{
+    uint64_t               order;
+    njt_http_v2_stream_t  *stream;
+
+    stream = frame->stream;
+
+    if (stream->incremental) {
+        order = njt_max(stream->vtime, h2c->vtime[stream->urgency]);
+        stream->vtime = order + NJT_HTTP_V2_FRAME_HEADER_SIZE + frame->length;
+
+    } else {
+        order = stream->node->id;
+    }
+
+    frame->priority = ((uint64_t) stream->urgency << 61)
+                      | (stream->incremental ? NJT_HTTP_V2_PRIORITY_INCREMENTAL
+                                             : 0)
+                      | (order & NJT_HTTP_V2_PRIORITY_ORDER);
+}
+
+
 static njt_inline void
 njt_http_v2_queue_frame(njt_http_v2_connection_t *h2c,
     njt_http_v2_out_frame_t *frame)
 {
     njt_http_v2_out_frame_t  **out;
 
+    njt_http_v2_frame_priority(h2c, frame);
+
     for (out = &h2c->last_out; *out; out = &(*out)->next) {
 
         if ((*out)->blocked || (*out)->stream == NULL) {
             break;
         }
 
-        if ((*out)->stream->node->rank < frame->stream->node->rank
-            || ((*out)->stream->node->rank == frame->stream->node->rank
-                && (*out)->stream->node->rel_weight
-                   >= frame->stream->node->rel_weight))
-        {
+        if ((*out)->priority <= frame->priority) {
             break;
         }
     }
@@ -271,6 +356,8 @@ njt_http_v2_queue_blocked_frame(njt_http_v2_connection_t *h2c,
 {
     njt_http_v2_out_frame_t  **out;
 
+    frame->priority = 0;
+
     for (out = &h2c->last_out; *out; out = &(*out)->next) {
 
         if ((*out)->blocked || (*out)->stream == NULL) {
@@ -287,6 +374,8 @@ static njt_inline void
 njt_http_v2_queue_ordered_frame(njt_http_v2_connection_t *h2c,
     njt_http_v2_out_frame_t *frame)
 {
+    frame->priority = 0;
+
     frame->next = h2c->last_out;
     h2c->last_out = frame;
 }
@@ -311,6 +400,12 @@ njt_int_t njt_http_v2_add_header(njt_http_v2_connection_t *h2c,
     njt_http_v2_header_t *header);
 njt_int_t njt_http_v2_table_size(njt_http_v2_connection_t *h2c, size_t size);
 
+u_char *njt_http_v2_hpack_table_update(njt_http_v2_connection_t *h2c,
+    u_char *pos);
+u_char *njt_http_v2_hpack_encode(njt_http_v2_connection_t *h2c, u_char *pos,
+    njt_uint_t index, njt_str_t *name, njt_str_t *value, u_char *tmp,
+    njt_uint_t flags);
+
 
 #define njt_http_v2_prefix(bits)  ((1 << (bits)) - 1)
 
@@ -377,6 +472,16 @@ njt_int_t njt_http_v2_table_size(njt_http_v2_connection_t *h2c, size_t size);
 #define NJT_HTTP_V2_ENCODE_RAW            0
 #define NJT_HTTP_V2_ENCODE_HUFF           0x80
 
+#define NJT_HTTP_V2_HPACK_INDEX           0x01
+#define NJT_HTTP_V2_HPACK_NEVER           0x02
+
+/*
+ * a table size update and literals with static names
+ * which do not fit into the 4-bit prefix
+ */
+#define njt_http_v2_hpack_reserve(h2c, n)                                     \
+    ((h2c)->hpack_enc.max ? NJT_HTTP_V2_INT_OCTETS + (n) : 0)
+
 #define NJT_HTTP_V2_AUTHORITY_INDEX       1
 
 #define NJT_HTTP_V2_METHOD_INDEX          2
@@ -404,6 +509,7 @@ njt_int_t njt_http_v2_table_size(njt_http_v2_connection_t *h2c, size_t size);
 #define NJT_HTTP_V2_LAST_MODIFIED_INDEX   44
 #define NJT_HTTP_V2_LOCATION_INDEX        46
 #define NJT_HTTP_V2_SERVER_INDEX          54
+#define NJT_HTTP_V2_SET_COOKIE_INDEX      55
 #define NJT_HTTP_V2_VARY_INDEX            59
 
 #define NJT_HTTP_V2_PREFACE_START         "PRI * HTTP/2.0\r\n"
@@ -11,6 +11,15 @@
 #include <njt_http.h>
 
 
+#define njt_http_v2_hpack_entry_size(n, v)  (32 + (n) + (v))
+
+
+static njt_int_t njt_http_v2_hpack_init(njt_http_v2_connection_t *h2c);
+static void njt_http_v2_hpack_evict(njt_http_v2_hpack_enc_t *enc,
+    size_t size);
+static void njt_http_v2_hpack_add(njt_http_v2_hpack_enc_t *enc,
+    njt_str_t *name, njt_str_t *value, njt_uint_t hash, njt_uint_t name_hash,
+    size_t literal);
 static u_char *njt_http_v2_write_int(u_char *pos, njt_uint_t prefix,
     njt_uint_t value);
 
@@ -41,6 +50,261 @@ njt_http_v2_string_encode(u_char *dst, u_char *src, size_t len, u_char *tmp,
 }
 
 
+u_char *
+njt_http_v2_hpack_table_update(njt_http_v2_connection_t *h2c, u_char *pos)
+{
+    size_t                    size;
+    njt_http_v2_hpack_enc_t  *enc;
+
+    enc = &h2c->hpack_enc;
+
+    if (enc->max == 0) {
+
+        if (h2c->table_update) {
+            njt_log_debug0(NJT_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                           "http2 table size update: 0");
+            *pos++ = (1 << 5) | 0;
+            h2c->table_update = 0;
+        }
+
+        return pos;
+    }
+
+    size = njt_min(enc->max, enc->limit);
+
+    if (!h2c->table_update && size == enc->size) {
+        return pos;
+    }
+
+    njt_log_debug1(NJT_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 table size update: %uz", size);
+
+    njt_http_v2_hpack_evict(enc, size);
+    enc->size = size;
+
+    *pos = 0x20;
+    pos = njt_http_v2_write_int(pos, njt_http_v2_prefix(5), size);
+
+    h2c->table_update = 0;
+
+    return pos;
+}
+
+
+u_char *
+njt_http_v2_hpack_encode(njt_http_v2_connection_t *h2c, u_char *pos,
+    njt_uint_t index, njt_str_t *name, njt_str_t *value, u_char *tmp,
+    njt_uint_t flags)
+{
+    u_char                     *start, *data;
+    size_t                      size, age, len;
+    njt_uint_t                  i, hash, name_hash, name_index;
+    njt_http_v2_hpack_enc_t    *enc;
+    njt_http_v2_hpack_entry_t  *entry;
+
+    enc = &h2c->hpack_enc;
+    start = pos;
+
+    size = njt_http_v2_hpack_entry_size(name->len, value->len);
+
+    /* large entries would flush the whole table on their own */
+
+    if (!(flags & NJT_HTTP_V2_HPACK_INDEX) || size > enc->size / 2) {
+        goto literal;
+    }
+
+    if (enc->entries == NULL && njt_http_v2_hpack_init(h2c) != NJT_OK) {
+        goto literal;
+    }
+
+    name_hash = 0;
+
+    for (i = 0; i < name->len; i++) {
+        name_hash = njt_hash(name_hash, njt_tolower(name->data[i]));
+    }
+
+    hash = name_hash;
+
+    for (i = 0; i < value->len; i++) {
+        hash = njt_hash(hash, value->data[i]);
+    }
+
+    name_index = index;
+    age = 0;
+    entry = NULL;
+
+    for (i = enc->added; i != enc->deleted; i--) {
+        entry = &enc->entries[(i - 1) % enc->allocated];
+
+        if (entry->name_hash == name_hash && entry->name_len == name->len) {
+            data = enc->storage + entry->offset;
+
+            if (njt_strncasecmp(data, name->data, name->len) == 0) {
+
+                if (entry->hash == hash
+                    && entry->value_len == value->len
+                    && njt_memcmp(data + name->len, value->data, value->len)
+                       == 0)
+                {
+                    break;
+                }
+
+                if (name_index == 0) {
+                    name_index = 62 + enc->added - i;
+                }
+            }
+        }
+
+        age += njt_http_v2_hpack_entry_size(entry->name_len,
+                                            entry->value_len);
+    }
+
+    if (i != enc->deleted) {
+
+        /*
+         * the table is evicted in insertion order only, so an entry that
+         * is still in use is added once again before it reaches the end
+         */
+
+        if (entry->hits++ == 0 || age + size <= enc->size / 4 * 3) {
+            *pos = 0x80;
+            pos = njt_http_v2_write_int(pos, njt_http_v2_prefix(7),
+                                        62 + enc->added - i);
+
+            len = pos - start;
+
+            if (entry->literal > len) {
+                enc->saved += entry->literal - len;
+            }
+
+            njt_log_debug2(NJT_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                           "http2 hpack indexed: %ui \"%V\"",
+                           62 + enc->added - i, name);
+
+            return pos;
+        }
+
+        if (index == 0) {
+            name_index = 62 + enc->added - i;
+        }
+    }
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 hpack add: \"%V: %V\"", name, value);
+
+    *pos = 0x40;
+    pos = njt_http_v2_write_int(pos, njt_http_v2_prefix(6), name_index);
+
+    if (name_index == 0) {
+        pos = njt_http_v2_string_encode(pos, name->data, name->len, tmp, 1);
+    }
+
+    pos = njt_http_v2_string_encode(pos, value->data, value->len, tmp, 0);
+
+    njt_http_v2_hpack_add(enc, name, value, hash, name_hash, pos - start);
+
+    return pos;
+
+literal:
+
+    *pos = (flags & NJT_HTTP_V2_HPACK_NEVER) ? 0x10 : 0;
+    pos = njt_http_v2_write_int(pos, njt_http_v2_prefix(4), index);
+
+    if (index == 0) {
+        pos = njt_http_v2_string_encode(pos, name->data, name->len, tmp, 1);
+    }
+
+    return njt_http_v2_string_encode(pos, value->data, value->len, tmp, 0);
+}
+
+
+static njt_int_t
+njt_http_v2_hpack_init(njt_http_v2_connection_t *h2c)
+{
+    njt_http_v2_hpack_enc_t  *enc;
+
+    enc = &h2c->hpack_enc;
+
+    enc->allocated = enc->max / 32;
+
+    enc->entries = njt_palloc(h2c->connection->pool,
+                              sizeof(njt_http_v2_hpack_entry_t)
+                              * enc->allocated);
+    if (enc->entries == NULL) {
+        return NJT_ERROR;
+    }
+
+    enc->storage = njt_pnalloc(h2c->connection->pool, 2 * enc->max);
+    if (enc->storage == NULL) {
+        enc->entries = NULL;
+        return NJT_ERROR;
+    }
+
+    return NJT_OK;
+}
+
+
+static void
+njt_http_v2_hpack_evict(njt_http_v2_hpack_enc_t *enc, size_t size)
+{
+    njt_http_v2_hpack_entry_t  *entry;
+
+    while (enc->used > size) {
+        entry = &enc->entries[enc->deleted++ % enc->allocated];
+        enc->used -= njt_http_v2_hpack_entry_size(entry->name_len,
+                                                  entry->value_len);
+    }
+}
+
+
+static void
+njt_http_v2_hpack_add(njt_http_v2_hpack_enc_t *enc, njt_str_t *name,
+    njt_str_t *value, njt_uint_t hash, njt_uint_t name_hash, size_t literal)
+{
+    size_t                      size, first;
+    njt_uint_t                  i;
+    njt_http_v2_hpack_entry_t  *entry;
+
+    size = njt_http_v2_hpack_entry_size(name->len, value->len);
+
+    njt_http_v2_hpack_evict(enc, enc->size - size);
+
+    if (enc->last + name->len + value->len > 2 * enc->max) {
+
+        if (enc->added == enc->deleted) {
+            first = enc->last;
+
+        } else {
+            first = enc->entries[enc->deleted % enc->allocated].offset;
+        }
+
+        njt_memmove(enc->storage, enc->storage + first, enc->last - first);
+
+        for (i = enc->deleted; i != enc->added; i++) {
+            enc->entries[i % enc->allocated].offset -= first;
+        }
+
+        enc->last -= first;
+    }
+
+    entry = &enc->entries[enc->added++ % enc->allocated];
+
+    entry->hash = hash;
+    entry->name_hash = name_hash;
+    entry->name_len = name->len;
+    entry->value_len = value->len;
+    entry->offset = enc->last;
+    entry->literal = literal;
+    entry->hits = 0;
+
+    njt_strlow(enc->storage + enc->last, name->data, name->len);
+    njt_memcpy(enc->storage + enc->last + name->len, value->data, value->len);
+
+    enc->last += name->len + value->len;
+    enc->used += size;
+}
+
+
 static u_char *
 njt_http_v2_write_int(u_char *pos, njt_uint_t prefix, njt_uint_t value)
 {
@@ -28,6 +28,8 @@
 #define NJT_HTTP_V2_NO_TRAILERS           (njt_http_v2_out_frame_t *) -1
 
 
+static njt_int_t njt_http_v2_early_hints_filter(njt_http_request_t *r,
+    njt_list_t *headers);
 static njt_http_v2_out_frame_t *njt_http_v2_create_headers_frame(
     njt_http_request_t *r, u_char *pos, u_char *end, njt_uint_t fin);
 static njt_http_v2_out_frame_t *njt_http_v2_create_trailers_frame(
@@ -96,6 +98,7 @@ njt_module_t  njt_http_v2_filter_module = {
 
 
 static njt_http_output_header_filter_pt  njt_http_next_header_filter;
+static njt_http_early_hints_filter_pt    njt_http_next_early_hints_filter;
 
 
 static njt_int_t
@@ -103,8 +106,9 @@ njt_http_v2_header_filter(njt_http_request_t *r)
 {
     u_char                     status, *pos, *start, *p, *tmp;
     size_t                     len, tmp_len;
-    njt_str_t                  host, location;
-    njt_uint_t                 i, port, fin;
+    off_t                      saved;
+    njt_str_t                  host, location, name, value;
+    njt_uint_t                 i, port, fin, flags;
     njt_list_part_t           *part;
     njt_table_elt_t           *header;
     njt_connection_t          *fc;
@@ -115,6 +119,8 @@ njt_http_v2_header_filter(njt_http_request_t *r)
     njt_http_core_loc_conf_t  *clcf;
     njt_http_core_srv_conf_t  *cscf;
     u_char                     addr[NJT_SOCKADDR_STRLEN];
+    u_char                     num[NJT_OFF_T_LEN];
+    u_char                     date[sizeof("Wed, 31 Dec 1986 18:00:00 GMT") - 1];
 
     static const u_char njet[5] = "\x84\xaa\x63\x55\xe7";
 #if (NJT_HTTP_GZIP)
@@ -214,6 +220,8 @@ njt_http_v2_header_filter(njt_http_request_t *r)
 
     len = h2c->table_update ? 1 : 0;
 
+    len += njt_http_v2_hpack_reserve(h2c, 3);
+
     len += status ? 1 : 1 + njt_http_v2_literal_size("418");
 
     clcf = njt_http_get_module_loc_conf(r, njt_http_core_module);
@@ -401,13 +409,9 @@ njt_http_v2_header_filter(njt_http_request_t *r)
     }
 
     start = pos;
+    saved = h2c->hpack_enc.saved;
 
-    if (h2c->table_update) {
-        njt_log_debug0(NJT_LOG_DEBUG_HTTP, fc->log, 0,
-                       "http2 table size update: 0");
-        *pos++ = (1 << 5) | 0;
-        h2c->table_update = 0;
-    }
+    pos = njt_http_v2_hpack_table_update(h2c, pos);
 
     njt_log_debug1(NJT_LOG_DEBUG_HTTP, fc->log, 0,
                    "http2 output header: \":status: %03ui\"",
@@ -416,6 +420,14 @@ njt_http_v2_header_filter(njt_http_request_t *r)
     if (status) {
         *pos++ = status;
 
+    } else if (h2c->hpack_enc.max) {
+        njt_str_set(&name, ":status");
+        value.len = njt_sprintf(num, "%03ui", r->headers_out.status) - num;
+        value.data = num;
+
+        pos = njt_http_v2_hpack_encode(h2c, pos, NJT_HTTP_V2_STATUS_INDEX,
+                                       &name, &value, tmp, 0);
+
     } else {
         *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_STATUS_INDEX);
         *pos++ = NJT_HTTP_V2_ENCODE_RAW | 3;
@@ -438,7 +450,26 @@ njt_http_v2_header_filter(njt_http_request_t *r)
             njt_log_debug0(NJT_LOG_DEBUG_HTTP, fc->log, 0,
                            "http2 output header: \"server: njet\"");
         }
+    }
+
+    if (r->headers_out.server == NULL && h2c->hpack_enc.max) {
+        njt_str_set(&name, "server");
+
+        if (clcf->server_tokens == NJT_HTTP_SERVER_TOKENS_ON) {
+            njt_str_set(&value, NJT_VER);
+
+        } else if (clcf->server_tokens == NJT_HTTP_SERVER_TOKENS_BUILD) {
+            njt_str_set(&value, NJT_VER_BUILD);
+
+        } else {
+            njt_str_set(&value, "njet");
+        }
 
+        pos = njt_http_v2_hpack_encode(h2c, pos, NJT_HTTP_V2_SERVER_INDEX,
+                                       &name, &value, tmp,
+                                       NJT_HTTP_V2_HPACK_INDEX);
+
+    } else if (r->headers_out.server == NULL) {
         *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_SERVER_INDEX);
 
         if (clcf->server_tokens == NJT_HTTP_SERVER_TOKENS_ON) {
@@ -470,13 +501,23 @@ njt_http_v2_header_filter(njt_http_request_t *r)
                        "http2 output header: \"date: %V\"",
                        &njt_cached_http_time);
 
-        *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_DATE_INDEX);
-        pos = njt_http_v2_write_value(pos, njt_cached_http_time.data,
-                                      njt_cached_http_time.len, tmp);
+        if (h2c->hpack_enc.max) {
+            njt_str_set(&name, "date");
+            value.len = njt_cached_http_time.len;
+            value.data = njt_cached_http_time.data;
+
+            pos = njt_http_v2_hpack_encode(h2c, pos, NJT_HTTP_V2_DATE_INDEX,
+                                           &name, &value, tmp,
+                                           NJT_HTTP_V2_HPACK_INDEX);
+
+        } else {
+            *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_DATE_INDEX);
+            pos = njt_http_v2_write_value(pos, njt_cached_http_time.data,
+                                          njt_cached_http_time.len, tmp);
+        }
     }
 
     if (r->headers_out.content_type.len) {
-        *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_CONTENT_TYPE_INDEX);
 
         if (r->headers_out.content_type_len == r->headers_out.content_type.len
             && r->headers_out.charset.len)
@@ -507,8 +548,21 @@ njt_http_v2_header_filter(njt_http_request_t *r)
                        "http2 output header: \"content-type: %V\"",
                        &r->headers_out.content_type);
 
-        pos = njt_http_v2_write_value(pos, r->headers_out.content_type.data,
-                                      r->headers_out.content_type.len, tmp);
+        if (h2c->hpack_enc.max) {
+            njt_str_set(&name, "content-type");
+
+            pos = njt_http_v2_hpack_encode(h2c, pos,
+                                           NJT_HTTP_V2_CONTENT_TYPE_INDEX,
+                                           &name, &r->headers_out.content_type,
+                                           tmp, NJT_HTTP_V2_HPACK_INDEX);
+
+        } else {
+            *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_CONTENT_TYPE_INDEX);
+            pos = njt_http_v2_write_value(pos,
+                                          r->headers_out.content_type.data,
+                                          r->headers_out.content_type.len,
+                                          tmp);
+        }
     }
 
     if (r->headers_out.content_length == NULL
@@ -518,15 +572,43 @@ njt_http_v2_header_filter(njt_http_request_t *r)
                        "http2 output header: \"content-length: %O\"",
                        r->headers_out.content_length_n);
 
-        *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_CONTENT_LENGTH_INDEX);
+        if (h2c->hpack_enc.max) {
+            njt_str_set(&name, "content-length");
+            value.len = njt_sprintf(num, "%O",
+                                    r->headers_out.content_length_n) - num;
+            value.data = num;
+
+            pos = njt_http_v2_hpack_encode(h2c, pos,
+                                           NJT_HTTP_V2_CONTENT_LENGTH_INDEX,
+                                           &name, &value, tmp, 0);
+
+        } else {
+            *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_CONTENT_LENGTH_INDEX);
 
-        p = pos;
-        pos = njt_sprintf(pos + 1, "%O", r->headers_out.content_length_n);
-        *p = NJT_HTTP_V2_ENCODE_RAW | (u_char) (pos - p - 1);
+            p = pos;
+            pos = njt_sprintf(pos + 1, "%O", r->headers_out.content_length_n);
+            *p = NJT_HTTP_V2_ENCODE_RAW | (u_char) (pos - p - 1);
+        }
     }
 
     if (r->headers_out.last_modified == NULL
-        && r->headers_out.last_modified_time != -1)
+        && r->headers_out.last_modified_time != -1
+        && h2c->hpack_enc.max)
+    {
+        njt_str_set(&name, "last-modified");
+        value.len = njt_http_time(date, r->headers_out.last_modified_time)
+                    - date;
+        value.data = date;
+
+        njt_log_debug1(NJT_LOG_DEBUG_HTTP, fc->log, 0,
+                       "http2 output header: \"last-modified: %V\"", &value);
+
+        pos = njt_http_v2_hpack_encode(h2c, pos,
+                                       NJT_HTTP_V2_LAST_MODIFIED_INDEX,
+                                       &name, &value, tmp, 0);
+
+    } else if (r->headers_out.last_modified == NULL
+               && r->headers_out.last_modified_time != -1)
     {
         *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_LAST_MODIFIED_INDEX);
 
@@ -549,9 +631,21 @@ njt_http_v2_header_filter(njt_http_request_t *r)
                        "http2 output header: \"location: %V\"",
                        &r->headers_out.location->value);
 
-        *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_LOCATION_INDEX);
-        pos = njt_http_v2_write_value(pos, r->headers_out.location->value.data,
-                                      r->headers_out.location->value.len, tmp);
+        if (h2c->hpack_enc.max) {
+            njt_str_set(&name, "location");
+
+            pos = njt_http_v2_hpack_encode(h2c, pos,
+                                           NJT_HTTP_V2_LOCATION_INDEX, &name,
+                                           &r->headers_out.location->value,
+                                           tmp, 0);
+
+        } else {
+            *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_LOCATION_INDEX);
+            pos = njt_http_v2_write_value(pos,
+                                          r->headers_out.location->value.data,
+                                          r->headers_out.location->value.len,
+                                          tmp);
+        }
     }
 
 #if (NJT_HTTP_GZIP)
@@ -559,8 +653,18 @@ njt_http_v2_header_filter(njt_http_request_t *r)
         njt_log_debug0(NJT_LOG_DEBUG_HTTP, fc->log, 0,
                        "http2 output header: \"vary: Accept-Encoding\"");
 
-        *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_VARY_INDEX);
-        pos = njt_cpymem(pos, accept_encoding, sizeof(accept_encoding));
+        if (h2c->hpack_enc.max) {
+            njt_str_set(&name, "vary");
+            njt_str_set(&value, "Accept-Encoding");
+
+            pos = njt_http_v2_hpack_encode(h2c, pos, NJT_HTTP_V2_VARY_INDEX,
+                                           &name, &value, tmp,
+                                           NJT_HTTP_V2_HPACK_INDEX);
+
+        } else {
+            *pos++ = njt_http_v2_inc_indexed(NJT_HTTP_V2_VARY_INDEX);
+            pos = njt_cpymem(pos, accept_encoding, sizeof(accept_encoding));
+        }
     }
 #endif
 
@@ -593,6 +697,27 @@ njt_http_v2_header_filter(njt_http_request_t *r)
         }
 #endif
 
+        if (h2c->hpack_enc.max) {
+            flags = NJT_HTTP_V2_HPACK_INDEX;
+
+            /* cookies are never indexed, neither by us nor by proxies */
+
+            if (header[i].key.len == sizeof("Set-Cookie") - 1
+                && njt_strncasecmp(header[i].key.data, (u_char *) "Set-Cookie",
+                                   sizeof("Set-Cookie") - 1)
+                   == 0)
+            {
+                flags = NJT_HTTP_V2_HPACK_NEVER;
+            }
+
+            pos = njt_http_v2_hpack_encode(h2c, pos,
+                                           (flags & NJT_HTTP_V2_HPACK_NEVER)
+                                           ? NJT_HTTP_V2_SET_COOKIE_INDEX : 0,
+                                           &header[i].key, &header[i].value,
+                                           tmp, flags);
+            continue;
+        }
+
         *pos++ = 0;
 
         pos = njt_http_v2_write_name(pos, header[i].key.data,
@@ -602,6 +727,8 @@ njt_http_v2_header_filter(njt_http_request_t *r)
                                       header[i].value.len, tmp);
     }
 
+    stream->header_saved = h2c->hpack_enc.saved - saved;
+
     fin = r->header_only
           || (r->headers_out.content_length_n == 0 && !r->expect_trailers);
 
@@ -612,7 +739,7 @@ njt_http_v2_header_filter(njt_http_request_t *r)
 
     njt_http_v2_queue_blocked_frame(h2c, frame);
 
-    stream->queued = 1;
+    stream->queued++;
 
     cln = njt_http_cleanup_add(r, 0);
     if (cln == NULL) {
@@ -630,6 +757,157 @@ njt_http_v2_header_filter(njt_http_request_t *r)
 }
 
 
+static njt_int_t
+njt_http_v2_early_hints_filter(njt_http_request_t *r, njt_list_t *headers)
+{
+    u_char                    *pos, *start, *tmp;
+    size_t                     len, tmp_len;
+    njt_uint_t                 i;
+    njt_list_part_t           *part;
+    njt_table_elt_t           *header;
+    njt_connection_t          *fc;
+    njt_http_v2_stream_t      *stream;
+    njt_http_v2_out_frame_t   *frame;
+    njt_http_v2_connection_t  *h2c;
+
+    stream = r->stream;
+
+    if (!stream) {
+        return njt_http_next_early_hints_filter(r, headers);
+    }
+
+    fc = r->connection;
+
+    if (fc->error) {
+        return NJT_ERROR;
+    }
+
+    h2c = stream->connection;
+
+    len = h2c->table_update ? 1 : 0;
+
+    len += njt_http_v2_hpack_reserve(h2c, 1);
+
+    len += 1 + njt_http_v2_literal_size("103");
+
+    tmp_len = 0;
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        if (header[i].key.len > NJT_HTTP_V2_MAX_FIELD
+            || header[i].value.len > NJT_HTTP_V2_MAX_FIELD)
+        {
+            njt_log_error(NJT_LOG_ERR, fc->log, 0,
+                          "too long early hint: \"%V: %V\"",
+                          &header[i].key, &header[i].value);
+            return NJT_DECLINED;
+        }
+
+        len += 1 + NJT_HTTP_V2_INT_OCTETS + header[i].key.len
+                 + NJT_HTTP_V2_INT_OCTETS + header[i].value.len;
+
+        if (header[i].key.len > tmp_len) {
+            tmp_len = header[i].key.len;
+        }
+
+        if (header[i].value.len > tmp_len) {
+            tmp_len = header[i].value.len;
+        }
+    }
+
+    tmp = njt_palloc(r->pool, tmp_len);
+    pos = njt_pnalloc(r->pool, len);
+
+    if (pos == NULL || tmp == NULL) {
+        return NJT_ERROR;
+    }
+
+    start = pos;
+
+    pos = njt_http_v2_hpack_table_update(h2c, pos);
+
+    njt_log_debug0(NJT_LOG_DEBUG_HTTP, fc->log, 0,
+                   "http2 output header: \":status: 103\"");
+
+    /* an interim status is never worth a dynamic table entry */
+
+    *pos++ = NJT_HTTP_V2_STATUS_INDEX;
+    *pos++ = NJT_HTTP_V2_ENCODE_RAW | 3;
+    pos = njt_cpymem(pos, "103", 3);
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        njt_log_debug2(NJT_LOG_DEBUG_HTTP, fc->log, 0,
+                       "http2 output header: \"%V: %V\"",
+                       &header[i].key, &header[i].value);
+
+        if (h2c->hpack_enc.max) {
+            pos = njt_http_v2_hpack_encode(h2c, pos, 0, &header[i].key,
+                                           &header[i].value, tmp,
+                                           NJT_HTTP_V2_HPACK_INDEX);
+            continue;
+        }
+
+        *pos++ = 0;
+
+        pos = njt_http_v2_write_name(pos, header[i].key.data,
+                                     header[i].key.len, tmp);
+
+        pos = njt_http_v2_write_value(pos, header[i].value.data,
+                                      header[i].value.len, tmp);
+    }
+
+    frame = njt_http_v2_create_headers_frame(r, start, pos, 0);
+    if (frame == NULL) {
+        return NJT_ERROR;
+    }
+
+    /* nothing else of the stream may follow for a while */
+
+    frame->last->buf->flush = 1;
+
+    njt_http_v2_queue_blocked_frame(h2c, frame);
+
+    stream->queued++;
+
+    return njt_http_v2_filter_send(fc, stream);
+}
+
+
 static njt_http_v2_out_frame_t *
 njt_http_v2_create_headers_frame(njt_http_request_t *r, u_char *pos,
     u_char *end, njt_uint_t fin)
@@ -1236,10 +1514,7 @@ njt_http_v2_waiting_queue(njt_http_v2_connection_t *h2c,
     {
         s = njt_queue_data(q, njt_http_v2_stream_t, queue);
 
-        if (s->node->rank < stream->node->rank
-            || (s->node->rank == stream->node->rank
-                && s->node->rel_weight >= stream->node->rel_weight))
-        {
+        if (s->urgency <= stream->urgency) {
             break;
         }
     }
@@ -1567,5 +1842,8 @@ njt_http_v2_filter_init(njt_conf_t *cf)
     njt_http_next_header_filter = njt_http_top_header_filter;
     njt_http_top_header_filter = njt_http_v2_header_filter;
 
+    njt_http_next_early_hints_filter = njt_http_top_early_hints_filter;
+    njt_http_top_early_hints_filter = njt_http_v2_early_hints_filter;
+
     return NJT_OK;
 }
@@ -16,6 +16,8 @@ static njt_int_t njt_http_v2_add_variables(njt_conf_t *cf);
 
 static njt_int_t njt_http_v2_variable(njt_http_request_t *r,
     njt_http_variable_value_t *v, uintptr_t data);
+static njt_int_t njt_http_v2_header_saved_variable(njt_http_request_t *r,
+    njt_http_variable_value_t *v, uintptr_t data);
 
 static njt_int_t njt_http_v2_module_init(njt_cycle_t *cycle);
 
@@ -34,6 +36,8 @@ static char *njt_http_v2_pool_size(njt_conf_t *cf, void *post, void *data);
 static char *njt_http_v2_preread_size(njt_conf_t *cf, void *post, void *data);
 static char *njt_http_v2_streams_index_mask(njt_conf_t *cf, void *post,
     void *data);
+static char *njt_http_v2_hpack_table_size(njt_conf_t *cf, void *post,
+    void *data);
 static char *njt_http_v2_chunk_size(njt_conf_t *cf, void *post, void *data);
 static char *njt_http_v2_obsolete(njt_conf_t *cf, njt_command_t *cmd,
     void *conf);
@@ -68,6 +72,8 @@ static njt_conf_post_t  njt_http_v2_preread_size_post =
     { njt_http_v2_preread_size };
 static njt_conf_post_t  njt_http_v2_streams_index_mask_post =
     { njt_http_v2_streams_index_mask };
+static njt_conf_post_t  njt_http_v2_hpack_table_size_post =
+    { njt_http_v2_hpack_table_size };
 static njt_conf_post_t  njt_http_v2_chunk_size_post =
     { njt_http_v2_chunk_size };
 
@@ -144,6 +150,20 @@ static njt_command_t  njt_http_v2_commands[] = {
       offsetof(njt_http_v2_srv_conf_t, streams_index_mask),
       &njt_http_v2_streams_index_mask_post },
 
+    { njt_string("http2_hpack_table_size"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE1,
+      njt_conf_set_size_slot,
+      NJT_HTTP_SRV_CONF_OFFSET,
+      offsetof(njt_http_v2_srv_conf_t, hpack_table_size),
+      &njt_http_v2_hpack_table_size_post },
+
+    { njt_string("http2_notsent_lowat"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE1,
+      njt_conf_set_size_slot,
+      NJT_HTTP_SRV_CONF_OFFSET,
+      offsetof(njt_http_v2_srv_conf_t, notsent_lowat),
+      NULL },
+
     { njt_string("http2_recv_timeout"),
       NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE1,
       njt_http_v2_obsolete,
@@ -219,6 +239,10 @@ static njt_http_variable_t  njt_http_v2_vars[] = {
     { njt_string("http2"), NULL,
       njt_http_v2_variable, 0, 0, 0, NJT_VAR_INIT_REF_COUNT },
 
+    { njt_string("http2_header_bytes_saved"), NULL,
+      njt_http_v2_header_saved_variable, 0, NJT_HTTP_VAR_NOCACHEABLE, 0,
+      NJT_VAR_INIT_REF_COUNT },
+
       njt_http_null_variable
 };
 
@@ -276,6 +300,32 @@ njt_http_v2_variable(njt_http_request_t *r,
 }
 
 
+static njt_int_t
+njt_http_v2_header_saved_variable(njt_http_request_t *r,
+    njt_http_variable_value_t *v, uintptr_t data)
+{
+    u_char  *p;
+
+    if (r->stream == NULL) {
+        *v = njt_http_variable_null_value;
+        return NJT_OK;
+    }
+
+    p = njt_pnalloc(r->pool, NJT_SIZE_T_LEN);
+    if (p == NULL) {
+        return NJT_ERROR;
+    }
+
+    v->len = njt_sprintf(p, "%uz", r->stream->header_saved) - p;
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+    v->data = p;
+
+    return NJT_OK;
+}
+
+
 static njt_int_t
 njt_http_v2_module_init(njt_cycle_t *cycle)
 {
@@ -330,6 +380,10 @@ njt_http_v2_create_srv_conf(njt_conf_t *cf)
 
     h2scf->streams_index_mask = NJT_CONF_UNSET_UINT;
 
+    h2scf->hpack_table_size = NJT_CONF_UNSET_SIZE;
+
+    h2scf->notsent_lowat = NJT_CONF_UNSET_SIZE;
+
     return h2scf;
 }
 
@@ -352,6 +406,11 @@ njt_http_v2_merge_srv_conf(njt_conf_t *cf, void *parent, void *child)
     njt_conf_merge_uint_value(conf->streams_index_mask,
                               prev->streams_index_mask, 32 - 1);
 
+    njt_conf_merge_size_value(conf->hpack_table_size,
+                              prev->hpack_table_size, 0);
+
+    njt_conf_merge_size_value(conf->notsent_lowat, prev->notsent_lowat, 0);
+
     return NJT_CONF_OK;
 }
 
@@ -458,6 +517,27 @@ njt_http_v2_streams_index_mask(njt_conf_t *cf, void *post, void *data)
 }
 
 
+static char *
+njt_http_v2_hpack_table_size(njt_conf_t *cf, void *post, void *data)
+{
+    size_t *sp = data;
+
+    if (*sp == 0) {
+        return NJT_CONF_OK;
+    }
+
+    if (*sp < 128) {
+        return "value is too small";
+    }
+
+    if (*sp > 65536) {
+        return "value is too large";
+    }
+
+    return NJT_CONF_OK;
+}
+
+
 static char *
 njt_http_v2_chunk_size(njt_conf_t *cf, void *post, void *data)
 {
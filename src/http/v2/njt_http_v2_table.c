@@ -11,7 +11,6 @@
 #include <njt_http.h>
 
 
-#define NJT_HTTP_V2_TABLE_SIZE  4096
 
 
 static njt_int_t njt_http_v2_table_account(njt_http_v2_connection_t *h2c,
@@ -18,9 +18,10 @@ static void njt_http_v3_cleanup_session(void *data);
 njt_int_t
 njt_http_v3_init_session(njt_connection_t *c)
 {
-    njt_pool_cleanup_t     *cln;
-    njt_http_connection_t  *hc;
-    njt_http_v3_session_t  *h3c;
+    njt_pool_cleanup_t      *cln;
+    njt_http_connection_t   *hc;
+    njt_http_v3_session_t   *h3c;
+    njt_http_v3_srv_conf_t  *h3scf;
 
     hc = c->data;
 
@@ -43,6 +44,10 @@ njt_http_v3_init_session(njt_connection_t *c)
     h3c->table.send_insert_count.data = c;
     h3c->table.send_insert_count.handler = njt_http_v3_inc_insert_count_handler;
 
+    h3scf = njt_http_get_module_srv_conf(hc->conf_ctx, njt_http_v3_module);
+
+    h3c->encoder.limit = h3scf->encoder_table_capacity;
+
     cln = njt_pool_cleanup_add(c->pool, 0);
     if (cln == NULL) {
         goto failed;
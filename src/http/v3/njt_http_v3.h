@@ -39,6 +39,8 @@
 #define NJT_HTTP_V3_FRAME_PUSH_PROMISE             0x05
 #define NJT_HTTP_V3_FRAME_GOAWAY                   0x07
 #define NJT_HTTP_V3_FRAME_MAX_PUSH_ID              0x0d
+#define NJT_HTTP_V3_FRAME_PRIORITY_UPDATE          0xf0700
+#define NJT_HTTP_V3_FRAME_PRIORITY_UPDATE_PUSH     0xf0701
 
 #define NJT_HTTP_V3_PARAM_MAX_TABLE_CAPACITY       0x01
 #define NJT_HTTP_V3_PARAM_MAX_FIELD_SECTION_SIZE   0x06
@@ -108,6 +110,7 @@ typedef struct {
     njt_flag_t                    enable_hq;
     size_t                        max_table_capacity;
     njt_uint_t                    max_blocked_streams;
+    size_t                        encoder_table_capacity;
     njt_uint_t                    max_concurrent_streams;
     njt_quic_conf_t               quic;
 } njt_http_v3_srv_conf_t;
@@ -125,6 +128,7 @@ struct njt_http_v3_session_s {
     njt_http_connection_t        *http_connection;
 
     njt_http_v3_dynamic_table_t   table;
+    njt_http_v3_encoder_table_t   encoder;
 
     njt_event_t                   keepalive;
     njt_uint_t                    nrequests;
@@ -303,3 +303,111 @@ njt_http_v3_encode_field_lpbi(u_char *p, njt_uint_t index, u_char *data,
 
     return (uintptr_t) p;
 }
+
+
+uintptr_t
+njt_http_v3_encode_insert_ref(u_char *p, njt_uint_t dynamic, njt_uint_t index,
+    njt_str_t *value)
+{
+    size_t   hlen;
+    u_char  *p1, *p2;
+
+    /* Insert With Name Reference */
+
+    if (p == NULL) {
+        return njt_http_v3_encode_prefix_int(NULL, index, 6)
+               + njt_http_v3_encode_prefix_int(NULL, value->len, 7)
+               + value->len;
+    }
+
+    *p = dynamic ? 0x80 : 0xc0;
+    p = (u_char *) njt_http_v3_encode_prefix_int(p, index, 6);
+
+    p1 = p;
+    *p = 0;
+    p = (u_char *) njt_http_v3_encode_prefix_int(p, value->len, 7);
+
+    p2 = p;
+    hlen = njt_http_huff_encode(value->data, value->len, p, 0);
+
+    if (hlen) {
+        p = p1;
+        *p = 0x80;
+        p = (u_char *) njt_http_v3_encode_prefix_int(p, hlen, 7);
+
+        if (p != p2) {
+            njt_memmove(p, p2, hlen);
+        }
+
+        p += hlen;
+
+    } else {
+        p = njt_cpymem(p, value->data, value->len);
+    }
+
+    return (uintptr_t) p;
+}
+
+
+uintptr_t
+njt_http_v3_encode_insert_l(u_char *p, njt_str_t *name, njt_str_t *value)
+{
+    size_t   hlen;
+    u_char  *p1, *p2;
+
+    /* Insert With Literal Name */
+
+    if (p == NULL) {
+        return njt_http_v3_encode_prefix_int(NULL, name->len, 5)
+               + name->len
+               + njt_http_v3_encode_prefix_int(NULL, value->len, 7)
+               + value->len;
+    }
+
+    p1 = p;
+    *p = 0x40;
+    p = (u_char *) njt_http_v3_encode_prefix_int(p, name->len, 5);
+
+    p2 = p;
+    hlen = njt_http_huff_encode(name->data, name->len, p, 1);
+
+    if (hlen) {
+        p = p1;
+        *p = 0x60;
+        p = (u_char *) njt_http_v3_encode_prefix_int(p, hlen, 5);
+
+        if (p != p2) {
+            njt_memmove(p, p2, hlen);
+        }
+
+        p += hlen;
+
+    } else {
+        njt_strlow(p, name->data, name->len);
+        p += name->len;
+    }
+
+    p1 = p;
+    *p = 0;
+    p = (u_char *) njt_http_v3_encode_prefix_int(p, value->len, 7);
+
+    p2 = p;
+    hlen = njt_http_huff_encode(value->data, value->len, p, 0);
+
+    if (hlen) {
+        p = p1;
+        *p = 0x80;
+        p = (u_char *) njt_http_v3_encode_prefix_int(p, hlen, 7);
+
+        if (p != p2) {
+            njt_memmove(p, p2, hlen);
+        }
+
+        p += hlen;
+
+    } else {
+        p = njt_cpymem(p, value->data, value->len);
+    }
+
+    return (uintptr_t) p;
+}
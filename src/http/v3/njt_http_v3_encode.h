@@ -31,5 +31,10 @@ uintptr_t njt_http_v3_encode_field_pbi(u_char *p, njt_uint_t index);
 uintptr_t njt_http_v3_encode_field_lpbi(u_char *p, njt_uint_t index,
     u_char *data, size_t len);
 
+uintptr_t njt_http_v3_encode_insert_ref(u_char *p, njt_uint_t dynamic,
+    njt_uint_t index, njt_str_t *value);
+uintptr_t njt_http_v3_encode_insert_l(u_char *p, njt_str_t *name,
+    njt_str_t *value);
+
 
 #endif /* _NJT_HTTP_V3_ENCODE_H_INCLUDED_ */
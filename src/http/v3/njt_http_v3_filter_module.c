@@ -21,6 +21,7 @@
 #define NJT_HTTP_V3_HEADER_METHOD_GET                17
 #define NJT_HTTP_V3_HEADER_SCHEME_HTTP               22
 #define NJT_HTTP_V3_HEADER_SCHEME_HTTPS              23
+#define NJT_HTTP_V3_HEADER_STATUS_103                24
 #define NJT_HTTP_V3_HEADER_STATUS_200                25
 #define NJT_HTTP_V3_HEADER_ACCEPT_ENCODING           31
 #define NJT_HTTP_V3_HEADER_CONTENT_TYPE_TEXT_PLAIN   53
@@ -37,6 +38,8 @@ typedef struct {
 
 
 static njt_int_t njt_http_v3_header_filter(njt_http_request_t *r);
+static njt_int_t njt_http_v3_early_hints_filter(njt_http_request_t *r,
+    njt_list_t *headers);
 static njt_int_t njt_http_v3_body_filter(njt_http_request_t *r,
     njt_chain_t *in);
 static njt_chain_t *njt_http_v3_create_trailers(njt_http_request_t *r,
@@ -77,25 +80,27 @@ njt_module_t  njt_http_v3_filter_module = {
 
 static njt_http_output_header_filter_pt  njt_http_next_header_filter;
 static njt_http_output_body_filter_pt    njt_http_next_body_filter;
+static njt_http_early_hints_filter_pt    njt_http_next_early_hints_filter;
 
 
 static njt_int_t
 njt_http_v3_header_filter(njt_http_request_t *r)
 {
-    u_char                    *p;
-    size_t                     len, n;
-    njt_buf_t                 *b;
-    njt_str_t                  host, location;
-    njt_uint_t                 i, port;
-    njt_chain_t               *out, *hl, *cl, **ll;
-    njt_list_part_t           *part;
-    njt_table_elt_t           *header;
-    njt_connection_t          *c;
-    njt_http_v3_session_t     *h3c;
-    njt_http_v3_filter_ctx_t  *ctx;
-    njt_http_core_loc_conf_t  *clcf;
-    njt_http_core_srv_conf_t  *cscf;
-    u_char                     addr[NJT_SOCKADDR_STRLEN];
+    u_char                         *p;
+    size_t                          len, n;
+    njt_buf_t                      *b;
+    njt_str_t                       host, location, name, value;
+    njt_uint_t                      i, port, flags;
+    njt_chain_t                    *out, *hl, *cl, **ll;
+    njt_list_part_t                *part;
+    njt_table_elt_t                *header;
+    njt_connection_t               *c;
+    njt_http_v3_session_t          *h3c;
+    njt_http_v3_filter_ctx_t       *ctx;
+    njt_http_core_loc_conf_t       *clcf;
+    njt_http_core_srv_conf_t       *cscf;
+    njt_http_v3_encoder_section_t  *sec;
+    u_char                          addr[NJT_SOCKADDR_STRLEN];
 
     if (r->http_version != NJT_HTTP_VERSION_30) {
         return njt_http_next_header_filter(r);
@@ -315,15 +320,29 @@ njt_http_v3_header_filter(njt_http_request_t *r)
                                           &header[i].value);
     }
 
+    /* the prefix of a section with dynamic references is written last */
+
+    sec = njt_http_v3_encode_section_start(c);
+
+    if (sec) {
+        len += 2 * NJT_HTTP_V3_PREFIX_INT_LEN;
+    }
+
     njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0, "http3 header len:%uz", len);
 
     b = njt_create_temp_buf(r->pool, len);
     if (b == NULL) {
-        return NJT_ERROR;
+        goto failed;
     }
 
-    b->last = (u_char *) njt_http_v3_encode_field_section_prefix(b->last,
-                                                                 0, 0, 0);
+    if (sec) {
+        b->pos += 2 * NJT_HTTP_V3_PREFIX_INT_LEN;
+        b->last = b->pos;
+
+    } else {
+        b->last = (u_char *) njt_http_v3_encode_field_section_prefix(b->last,
+                                                                     0, 0, 0);
+    }
 
     njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
                    "http3 output header: \":status: %03ui\"",
@@ -357,9 +376,24 @@ njt_http_v3_header_filter(njt_http_request_t *r)
         njt_log_debug2(NJT_LOG_DEBUG_HTTP, c->log, 0,
                        "http3 output header: \"server: %*s\"", n, p);
 
-        b->last = (u_char *) njt_http_v3_encode_field_lri(b->last, 0,
+        if (sec) {
+            njt_str_set(&name, "server");
+            value.len = n;
+            value.data = p;
+
+            b->last = njt_http_v3_encode_field(c, sec, b->last,
+                                               NJT_HTTP_V3_HEADER_SERVER,
+                                               &name, &value,
+                                               NJT_HTTP_V3_ENCODE_INDEX);
+            if (b->last == NULL) {
+                goto failed;
+            }
+
+        } else {
+            b->last = (u_char *) njt_http_v3_encode_field_lri(b->last, 0,
                                                      NJT_HTTP_V3_HEADER_SERVER,
                                                      p, n);
+        }
     }
 
     if (r->headers_out.date == NULL) {
@@ -367,10 +401,25 @@ njt_http_v3_header_filter(njt_http_request_t *r)
                        "http3 output header: \"date: %V\"",
                        &njt_cached_http_time);
 
-        b->last = (u_char *) njt_http_v3_encode_field_lri(b->last, 0,
+        if (sec) {
+            njt_str_set(&name, "date");
+            value.len = njt_cached_http_time.len;
+            value.data = njt_cached_http_time.data;
+
+            b->last = njt_http_v3_encode_field(c, sec, b->last,
+                                               NJT_HTTP_V3_HEADER_DATE,
+                                               &name, &value,
+                                               NJT_HTTP_V3_ENCODE_INDEX);
+            if (b->last == NULL) {
+                goto failed;
+            }
+
+        } else {
+            b->last = (u_char *) njt_http_v3_encode_field_lri(b->last, 0,
                                                      NJT_HTTP_V3_HEADER_DATE,
                                                      njt_cached_http_time.data,
                                                      njt_cached_http_time.len);
+        }
     }
 
     if (r->headers_out.content_type.len) {
@@ -382,7 +431,7 @@ njt_http_v3_header_filter(njt_http_request_t *r)
 
             p = njt_pnalloc(r->pool, n);
             if (p == NULL) {
-                return NJT_ERROR;
+                goto failed;
             }
 
             p = njt_cpymem(p, r->headers_out.content_type.data,
@@ -403,10 +452,23 @@ njt_http_v3_header_filter(njt_http_request_t *r)
                        "http3 output header: \"content-type: %V\"",
                        &r->headers_out.content_type);
 
-        b->last = (u_char *) njt_http_v3_encode_field_lri(b->last, 0,
+        if (sec) {
+            njt_str_set(&name, "content-type");
+
+            b->last = njt_http_v3_encode_field(c, sec, b->last,
+                                    NJT_HTTP_V3_HEADER_CONTENT_TYPE_TEXT_PLAIN,
+                                    &name, &r->headers_out.content_type,
+                                    NJT_HTTP_V3_ENCODE_INDEX);
+            if (b->last == NULL) {
+                goto failed;
+            }
+
+        } else {
+            b->last = (u_char *) njt_http_v3_encode_field_lri(b->last, 0,
                                     NJT_HTTP_V3_HEADER_CONTENT_TYPE_TEXT_PLAIN,
                                     r->headers_out.content_type.data,
                                     r->headers_out.content_type.len);
+        }
     }
 
     if (r->headers_out.content_length == NULL
@@ -440,7 +502,7 @@ njt_http_v3_header_filter(njt_http_request_t *r)
 
         p = njt_pnalloc(r->pool, n);
         if (p == NULL) {
-            return NJT_ERROR;
+            goto failed;
         }
 
         njt_http_time(p, r->headers_out.last_modified_time);
@@ -497,18 +559,46 @@ njt_http_v3_header_filter(njt_http_request_t *r)
                        "http3 output header: \"%V: %V\"",
                        &header[i].key, &header[i].value);
 
+        if (sec) {
+            flags = NJT_HTTP_V3_ENCODE_INDEX;
+
+            /* cookies are not worth indexing */
+
+            if (header[i].key.len == sizeof("Set-Cookie") - 1
+                && njt_strncasecmp(header[i].key.data, (u_char *) "Set-Cookie",
+                                   sizeof("Set-Cookie") - 1)
+                   == 0)
+            {
+                flags = 0;
+            }
+
+            b->last = njt_http_v3_encode_field(c, sec, b->last, -1,
+                                               &header[i].key,
+                                               &header[i].value, flags);
+            if (b->last == NULL) {
+                goto failed;
+            }
+
+            continue;
+        }
+
         b->last = (u_char *) njt_http_v3_encode_field_l(b->last,
                                                         &header[i].key,
                                                         &header[i].value);
     }
 
+    if (sec) {
+        b->pos = njt_http_v3_encode_section_end(c, sec, b->pos);
+        sec = NULL;
+    }
+
     if (r->header_only) {
         b->last_buf = 1;
     }
 
     cl = njt_alloc_chain_link(r->pool);
     if (cl == NULL) {
-        return NJT_ERROR;
+        goto failed;
     }
 
     cl->buf = b;
@@ -523,7 +613,7 @@ njt_http_v3_header_filter(njt_http_request_t *r)
 
     b = njt_create_temp_buf(r->pool, len);
     if (b == NULL) {
-        return NJT_ERROR;
+        goto failed;
     }
 
     b->last = (u_char *) njt_http_v3_encode_varlen_int(b->last,
@@ -532,7 +622,7 @@ njt_http_v3_header_filter(njt_http_request_t *r)
 
     hl = njt_alloc_chain_link(r->pool);
     if (hl == NULL) {
-        return NJT_ERROR;
+        goto failed;
     }
 
     hl->buf = b;
@@ -550,7 +640,7 @@ njt_http_v3_header_filter(njt_http_request_t *r)
 
         b = njt_create_temp_buf(r->pool, len);
         if (b == NULL) {
-            return NJT_ERROR;
+            goto failed;
         }
 
         b->last = (u_char *) njt_http_v3_encode_varlen_int(b->last,
@@ -563,7 +653,7 @@ njt_http_v3_header_filter(njt_http_request_t *r)
 
         cl = njt_alloc_chain_link(r->pool);
         if (cl == NULL) {
-            return NJT_ERROR;
+            goto failed;
         }
 
         cl->buf = b;
@@ -574,7 +664,7 @@ njt_http_v3_header_filter(njt_http_request_t *r)
     } else {
         ctx = njt_pcalloc(r->pool, sizeof(njt_http_v3_filter_ctx_t));
         if (ctx == NULL) {
-            return NJT_ERROR;
+            goto failed;
         }
 
         njt_http_set_ctx(r, ctx, njt_http_v3_filter_module);
@@ -586,6 +676,150 @@ njt_http_v3_header_filter(njt_http_request_t *r)
     }
 
     return njt_http_write_filter(r, out);
+
+failed:
+
+    /* the section will never be acknowledged, do not keep it blocking */
+
+    if (sec) {
+        njt_http_v3_encode_section_cancel(c, sec);
+
+    } else {
+        njt_http_v3_cancel_sections(c, c->quic->id);
+    }
+
+    return NJT_ERROR;
+}
+
+
+static njt_int_t
+njt_http_v3_early_hints_filter(njt_http_request_t *r, njt_list_t *headers)
+{
+    size_t                  len, n;
+    njt_buf_t              *b;
+    njt_uint_t              i;
+    njt_chain_t            *cl, *hl;
+    njt_list_part_t        *part;
+    njt_table_elt_t        *header;
+    njt_http_v3_session_t  *h3c;
+
+    if (r->http_version != NJT_HTTP_VERSION_30) {
+        return njt_http_next_early_hints_filter(r, headers);
+    }
+
+    h3c = njt_http_v3_get_session(r->connection);
+
+    /* interim responses stay off the dynamic table */
+
+    len = njt_http_v3_encode_field_section_prefix(NULL, 0, 0, 0)
+          + njt_http_v3_encode_field_ri(NULL, 0,
+                                        NJT_HTTP_V3_HEADER_STATUS_103);
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        len += njt_http_v3_encode_field_l(NULL, &header[i].key,
+                                          &header[i].value);
+    }
+
+    b = njt_create_temp_buf(r->pool, len);
+    if (b == NULL) {
+        return NJT_ERROR;
+    }
+
+    b->last = (u_char *) njt_http_v3_encode_field_section_prefix(b->last,
+                                                                 0, 0, 0);
+
+    njt_log_debug0(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http3 output header: \":status: 103\"");
+
+    b->last = (u_char *) njt_http_v3_encode_field_ri(b->last, 0,
+                                                NJT_HTTP_V3_HEADER_STATUS_103);
+
+    part = &headers->part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        njt_log_debug2(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http3 output header: \"%V: %V\"",
+                       &header[i].key, &header[i].value);
+
+        b->last = (u_char *) njt_http_v3_encode_field_l(b->last,
+                                                        &header[i].key,
+                                                        &header[i].value);
+    }
+
+    b->flush = 1;
+
+    cl = njt_alloc_chain_link(r->pool);
+    if (cl == NULL) {
+        return NJT_ERROR;
+    }
+
+    cl->buf = b;
+    cl->next = NULL;
+
+    n = b->last - b->pos;
+
+    h3c->payload_bytes += n;
+
+    len = njt_http_v3_encode_varlen_int(NULL, NJT_HTTP_V3_FRAME_HEADERS)
+          + njt_http_v3_encode_varlen_int(NULL, n);
+
+    b = njt_create_temp_buf(r->pool, len);
+    if (b == NULL) {
+        return NJT_ERROR;
+    }
+
+    b->last = (u_char *) njt_http_v3_encode_varlen_int(b->last,
+                                                    NJT_HTTP_V3_FRAME_HEADERS);
+    b->last = (u_char *) njt_http_v3_encode_varlen_int(b->last, n);
+
+    hl = njt_alloc_chain_link(r->pool);
+    if (hl == NULL) {
+        return NJT_ERROR;
+    }
+
+    hl->buf = b;
+    hl->next = cl;
+
+    for (cl = hl; cl; cl = cl->next) {
+        h3c->total_bytes += cl->buf->last - cl->buf->pos;
+        r->header_size += cl->buf->last - cl->buf->pos;
+    }
+
+    return njt_http_write_filter(r, hl);
 }
 
 
@@ -846,6 +1080,9 @@ njt_http_v3_filter_init(njt_conf_t *cf)
     njt_http_next_header_filter = njt_http_top_header_filter;
     njt_http_top_header_filter = njt_http_v3_header_filter;
 
+    njt_http_next_early_hints_filter = njt_http_top_early_hints_filter;
+    njt_http_top_early_hints_filter = njt_http_v3_early_hints_filter;
+
     njt_http_next_body_filter = njt_http_top_body_filter;
     njt_http_top_body_filter = njt_http_v3_body_filter;
 
@@ -13,14 +13,30 @@
 
 static njt_int_t njt_http_v3_variable(njt_http_request_t *r,
     njt_http_variable_value_t *v, uintptr_t data);
+static njt_int_t njt_http_v3_quic_variable(njt_http_request_t *r,
+    njt_http_variable_value_t *v, uintptr_t data);
 static njt_int_t njt_http_v3_add_variables(njt_conf_t *cf);
 static void *njt_http_v3_create_srv_conf(njt_conf_t *cf);
 static char *njt_http_v3_merge_srv_conf(njt_conf_t *cf, void *parent,
     void *child);
+static char *njt_http_v3_encoder_table_capacity(njt_conf_t *cf, void *post,
+    void *data);
 static char *njt_http_quic_host_key(njt_conf_t *cf, njt_command_t *cmd,
     void *conf);
 
 
+static njt_conf_post_t  njt_http_v3_encoder_table_capacity_post =
+    { njt_http_v3_encoder_table_capacity };
+
+
+static njt_conf_enum_t  njt_http_quic_congestion_control[] = {
+    { njt_string("newreno"), NJT_QUIC_CC_NEWRENO },
+    { njt_string("cubic"), NJT_QUIC_CC_CUBIC },
+    { njt_string("bbr"), NJT_QUIC_CC_BBR },
+    { njt_null_string, 0 }
+};
+
+
 static njt_command_t  njt_http_v3_commands[] = {
 
     { njt_string("http3"),
@@ -44,6 +60,13 @@ static njt_command_t  njt_http_v3_commands[] = {
       offsetof(njt_http_v3_srv_conf_t, max_concurrent_streams),
       NULL },
 
+    { njt_string("http3_encoder_table_capacity"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE1,
+      njt_conf_set_size_slot,
+      NJT_HTTP_SRV_CONF_OFFSET,
+      offsetof(njt_http_v3_srv_conf_t, encoder_table_capacity),
+      &njt_http_v3_encoder_table_capacity_post },
+
     { njt_string("http3_stream_buffer_size"),
       NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE1,
       njt_conf_set_size_slot,
@@ -65,6 +88,27 @@ static njt_command_t  njt_http_v3_commands[] = {
       offsetof(njt_http_v3_srv_conf_t, quic.gso_enabled),
       NULL },
 
+    { njt_string("quic_sendmmsg"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_FLAG,
+      njt_conf_set_flag_slot,
+      NJT_HTTP_SRV_CONF_OFFSET,
+      offsetof(njt_http_v3_srv_conf_t, quic.sendmmsg_enabled),
+      NULL },
+
+    { njt_string("quic_congestion_control"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE1,
+      njt_conf_set_enum_slot,
+      NJT_HTTP_SRV_CONF_OFFSET,
+      offsetof(njt_http_v3_srv_conf_t, quic.congestion_control),
+      &njt_http_quic_congestion_control },
+
+    { njt_string("quic_pacing"),
+      NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_FLAG,
+      njt_conf_set_flag_slot,
+      NJT_HTTP_SRV_CONF_OFFSET,
+      offsetof(njt_http_v3_srv_conf_t, quic.pacing),
+      NULL },
+
     { njt_string("quic_host_key"),
       NJT_HTTP_MAIN_CONF|NJT_HTTP_SRV_CONF|NJT_CONF_TAKE1,
       njt_http_quic_host_key,
@@ -119,6 +163,27 @@ static njt_http_variable_t  njt_http_v3_vars[] = {
 
     { njt_string("http3"), NULL, njt_http_v3_variable, 0, 0, 0, 0 },
 
+    { njt_string("quic_cwnd"), NULL, njt_http_v3_quic_variable,
+      0, NJT_HTTP_VAR_NOCACHEABLE, 0, 0 },
+
+    { njt_string("quic_rtt"), NULL, njt_http_v3_quic_variable,
+      1, NJT_HTTP_VAR_NOCACHEABLE, 0, 0 },
+
+    { njt_string("quic_rttvar"), NULL, njt_http_v3_quic_variable,
+      2, NJT_HTTP_VAR_NOCACHEABLE, 0, 0 },
+
+    { njt_string("quic_min_rtt"), NULL, njt_http_v3_quic_variable,
+      3, NJT_HTTP_VAR_NOCACHEABLE, 0, 0 },
+
+    { njt_string("quic_sent"), NULL, njt_http_v3_quic_variable,
+      4, NJT_HTTP_VAR_NOCACHEABLE, 0, 0 },
+
+    { njt_string("quic_lost"), NULL, njt_http_v3_quic_variable,
+      5, NJT_HTTP_VAR_NOCACHEABLE, 0, 0 },
+
+    { njt_string("quic_pacing_rate"), NULL, njt_http_v3_quic_variable,
+      6, NJT_HTTP_VAR_NOCACHEABLE, 0, 0 },
+
       njt_http_null_variable
 };
 
@@ -159,6 +224,69 @@ njt_http_v3_variable(njt_http_request_t *r,
 }
 
 
+static njt_int_t
+njt_http_v3_quic_variable(njt_http_request_t *r,
+    njt_http_variable_value_t *v, uintptr_t data)
+{
+    uint64_t                     value;
+    njt_quic_congestion_stats_t  st;
+
+    if (r->connection->quic == NULL) {
+        v->not_found = 1;
+        return NJT_OK;
+    }
+
+    njt_quic_congestion_stats(r->connection, &st);
+
+    switch (data) {
+    case 0:
+        value = st.cwnd;
+        break;
+
+    case 1:
+        value = st.rtt;
+        break;
+
+    case 2:
+        value = st.rttvar;
+        break;
+
+    case 3:
+        value = st.min_rtt;
+        break;
+
+    case 4:
+        value = st.sent;
+        break;
+
+    case 5:
+        value = st.lost;
+        break;
+
+    case 6:
+        value = st.pacing_rate;
+        break;
+
+    /* suppress warning */
+    default:
+        value = 0;
+        break;
+    }
+
+    v->data = njt_pnalloc(r->pool, NJT_INT64_LEN);
+    if (v->data == NULL) {
+        return NJT_ERROR;
+    }
+
+    v->len = njt_sprintf(v->data, "%uL", value) - v->data;
+    v->valid = 1;
+    v->no_cacheable = 0;
+    v->not_found = 0;
+
+    return NJT_OK;
+}
+
+
 static njt_int_t
 njt_http_v3_add_variables(njt_conf_t *cf)
 {
@@ -202,12 +330,16 @@ njt_http_v3_create_srv_conf(njt_conf_t *cf)
     h3scf->enable_hq = NJT_CONF_UNSET;
     h3scf->max_table_capacity = NJT_HTTP_V3_MAX_TABLE_CAPACITY;
     h3scf->max_concurrent_streams = NJT_CONF_UNSET_UINT;
+    h3scf->encoder_table_capacity = NJT_CONF_UNSET_SIZE;
 
     h3scf->quic.stream_buffer_size = NJT_CONF_UNSET_SIZE;
     h3scf->quic.max_concurrent_streams_bidi = NJT_CONF_UNSET_UINT;
     h3scf->quic.max_concurrent_streams_uni = NJT_HTTP_V3_MAX_UNI_STREAMS;
     h3scf->quic.retry = NJT_CONF_UNSET;
     h3scf->quic.gso_enabled = NJT_CONF_UNSET;
+    h3scf->quic.sendmmsg_enabled = NJT_CONF_UNSET;
+    h3scf->quic.pacing = NJT_CONF_UNSET;
+    h3scf->quic.congestion_control = NJT_CONF_UNSET_UINT;
     h3scf->quic.stream_close_code = NJT_HTTP_V3_ERR_NO_ERROR;
     h3scf->quic.stream_reject_code_bidi = NJT_HTTP_V3_ERR_REQUEST_REJECTED;
     h3scf->quic.active_connection_id_limit = NJT_CONF_UNSET_UINT;
@@ -237,6 +369,9 @@ njt_http_v3_merge_srv_conf(njt_conf_t *cf, void *parent, void *child)
 
     conf->max_blocked_streams = conf->max_concurrent_streams;
 
+    njt_conf_merge_size_value(conf->encoder_table_capacity,
+                              prev->encoder_table_capacity, 0);
+
     njt_conf_merge_size_value(conf->quic.stream_buffer_size,
                               prev->quic.stream_buffer_size,
                               65536);
@@ -245,6 +380,12 @@ njt_http_v3_merge_srv_conf(njt_conf_t *cf, void *parent, void *child)
 
     njt_conf_merge_value(conf->quic.retry, prev->quic.retry, 0);
     njt_conf_merge_value(conf->quic.gso_enabled, prev->quic.gso_enabled, 0);
+    njt_conf_merge_value(conf->quic.sendmmsg_enabled,
+                         prev->quic.sendmmsg_enabled, 0);
+    njt_conf_merge_value(conf->quic.pacing, prev->quic.pacing, 0);
+    njt_conf_merge_uint_value(conf->quic.congestion_control,
+                              prev->quic.congestion_control,
+                              NJT_QUIC_CC_NEWRENO);
 
     njt_conf_merge_str_value(conf->quic.host_key, prev->quic.host_key, "");
 
@@ -294,6 +435,27 @@ njt_http_v3_merge_srv_conf(njt_conf_t *cf, void *parent, void *child)
 }
 
 
+static char *
+njt_http_v3_encoder_table_capacity(njt_conf_t *cf, void *post, void *data)
+{
+    size_t *sp = data;
+
+    if (*sp == 0) {
+        return NJT_CONF_OK;
+    }
+
+    if (*sp < 128) {
+        return "value is too small";
+    }
+
+    if (*sp > 65536) {
+        return "value is too large";
+    }
+
+    return NJT_CONF_OK;
+}
+
+
 static char *
 njt_http_quic_host_key(njt_conf_t *cf, njt_command_t *cmd, void *conf)
 {
@@ -47,6 +47,8 @@ static njt_int_t njt_http_v3_parse_control(njt_connection_t *c,
     njt_http_v3_parse_control_t *st, njt_buf_t *b);
 static njt_int_t njt_http_v3_parse_settings(njt_connection_t *c,
     njt_http_v3_parse_settings_t *st, njt_buf_t *b);
+static njt_int_t njt_http_v3_parse_priority_update(njt_connection_t *c,
+    njt_http_v3_parse_priority_t *st, njt_buf_t *b);
 
 static njt_int_t njt_http_v3_parse_encoder(njt_connection_t *c,
     njt_http_v3_parse_encoder_t *st, njt_buf_t *b);
@@ -1163,6 +1165,7 @@ njt_http_v3_parse_control(njt_connection_t *c, njt_http_v3_parse_control_t *st,
         sw_type,
         sw_length,
         sw_settings,
+        sw_priority_update,
         sw_skip
     };
 
@@ -1230,6 +1233,21 @@ njt_http_v3_parse_control(njt_connection_t *c, njt_http_v3_parse_control_t *st,
                            "http3 parse frame len:%uL", st->vlint.value);
 
             st->length = st->vlint.value;
+
+            if (st->type == NJT_HTTP_V3_FRAME_PRIORITY_UPDATE
+                || st->type == NJT_HTTP_V3_FRAME_PRIORITY_UPDATE_PUSH)
+            {
+                if (st->length == 0) {
+                    return NJT_HTTP_V3_ERR_FRAME_ERROR;
+                }
+
+                /* no push streams are ever promised */
+
+                if (st->type == NJT_HTTP_V3_FRAME_PRIORITY_UPDATE_PUSH) {
+                    return NJT_HTTP_V3_ERR_ID_ERROR;
+                }
+            }
+
             if (st->length == 0) {
                 st->state = sw_type;
                 break;
@@ -1241,6 +1259,11 @@ njt_http_v3_parse_control(njt_connection_t *c, njt_http_v3_parse_control_t *st,
                 st->state = sw_settings;
                 break;
 
+            case NJT_HTTP_V3_FRAME_PRIORITY_UPDATE:
+                st->priority_update.length = st->length;
+                st->state = sw_priority_update;
+                break;
+
             default:
                 njt_log_debug0(NJT_LOG_DEBUG_HTTP, c->log, 0,
                                "http3 parse skip unknown frame");
@@ -1271,6 +1294,16 @@ njt_http_v3_parse_control(njt_connection_t *c, njt_http_v3_parse_control_t *st,
 
             break;
 
+        case sw_priority_update:
+
+            rc = njt_http_v3_parse_priority_update(c, &st->priority_update, b);
+            if (rc != NJT_DONE) {
+                return rc;
+            }
+
+            st->state = sw_type;
+            break;
+
         case sw_skip:
 
             rc = njt_http_v3_parse_skip(b, &st->length);
@@ -1344,6 +1377,99 @@ done:
 }
 
 
+static njt_int_t
+njt_http_v3_parse_priority_update(njt_connection_t *c,
+    njt_http_v3_parse_priority_t *st, njt_buf_t *b)
+{
+    size_t     n;
+    njt_buf_t  loc;
+    njt_str_t  value;
+    njt_int_t  rc;
+    enum {
+        sw_start = 0,
+        sw_id,
+        sw_value
+    };
+
+    for ( ;; ) {
+
+        switch (st->state) {
+
+        case sw_start:
+
+            njt_log_debug0(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                           "http3 parse priority update");
+
+            st->len = 0;
+            st->state = sw_id;
+
+            /* fall through */
+
+        case sw_id:
+
+            njt_http_v3_parse_start_local(b, &loc, st->length);
+
+            rc = njt_http_v3_parse_varlen_int(c, &st->vlint, &loc);
+
+            njt_http_v3_parse_end_local(b, &loc, &st->length);
+
+            if (st->length == 0 && rc == NJT_AGAIN) {
+                return NJT_HTTP_V3_ERR_FRAME_ERROR;
+            }
+
+            if (rc != NJT_DONE) {
+                return rc;
+            }
+
+            st->id = st->vlint.value;
+            st->state = sw_value;
+            break;
+
+        case sw_value:
+
+            n = njt_min((size_t) (b->last - b->pos), st->length);
+
+            /* no priority field of interest is that long */
+
+            if (st->len < sizeof(st->data)) {
+                njt_memcpy(st->data + st->len, b->pos,
+                           njt_min(n, sizeof(st->data) - st->len));
+            }
+
+            st->len += n;
+            st->length -= n;
+            b->pos += n;
+
+            if (st->length) {
+                return NJT_AGAIN;
+            }
+
+            goto done;
+        }
+    }
+
+done:
+
+    st->state = sw_start;
+
+    if (st->len > sizeof(st->data)) {
+        njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                       "http3 skip priority update of length %uz", st->len);
+        return NJT_DONE;
+    }
+
+    value.data = st->data;
+    value.len = st->len;
+
+    rc = njt_http_v3_priority_update(c, st->id, &value);
+    if (rc != NJT_OK) {
+        return rc;
+    }
+
+    return NJT_DONE;
+}
+
+
 static njt_int_t
 njt_http_v3_parse_encoder(njt_connection_t *c, njt_http_v3_parse_encoder_t *st,
     njt_buf_t *b)
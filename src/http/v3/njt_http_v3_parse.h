@@ -35,6 +35,18 @@ typedef struct {
 } njt_http_v3_parse_settings_t;
 
 
+#define NJT_HTTP_V3_PRIORITY_FIELD_SIZE  64
+
+typedef struct {
+    njt_uint_t                      state;
+    njt_uint_t                      length;
+    uint64_t                        id;
+    size_t                          len;
+    u_char                          data[NJT_HTTP_V3_PRIORITY_FIELD_SIZE];
+    njt_http_v3_parse_varlen_int_t  vlint;
+} njt_http_v3_parse_priority_t;
+
+
 typedef struct {
     njt_uint_t                      state;
     njt_uint_t                      insert_count;
@@ -104,6 +116,7 @@ typedef struct {
     njt_uint_t                      length;
     njt_http_v3_parse_varlen_int_t  vlint;
     njt_http_v3_parse_settings_t    settings;
+    njt_http_v3_parse_priority_t    priority_update;
 } njt_http_v3_parse_control_t;
 
 
@@ -24,6 +24,7 @@ static njt_int_t njt_http_v3_process_pseudo_header(njt_http_request_t *r,
     njt_str_t *name, njt_str_t *value);
 static njt_int_t njt_http_v3_init_pseudo_headers(njt_http_request_t *r);
 static njt_int_t njt_http_v3_process_request_header(njt_http_request_t *r);
+static void njt_http_v3_set_priority(njt_http_request_t *r);
 static njt_int_t njt_http_v3_cookie(njt_http_request_t *r, njt_str_t *value);
 static njt_int_t njt_http_v3_construct_cookie_header(njt_http_request_t *r);
 static void njt_http_v3_read_client_request_body_handler(njt_http_request_t *r);
@@ -591,6 +592,10 @@ njt_http_v3_process_request(njt_event_t *rev)
                 break;
             }
 
+            if (r->headers_in.priority) {
+                njt_http_v3_set_priority(r);
+            }
+
             njt_http_process_request(r);
             break;
         }
@@ -1096,6 +1101,37 @@ failed:
 }
 
 
+static void
+njt_http_v3_set_priority(njt_http_request_t *r)
+{
+    njt_uint_t          urgency, incremental;
+    njt_table_elt_t    *h;
+    njt_quic_stream_t  *qs;
+
+    urgency = NJT_HTTP_PRIORITY_URGENCY_DEFAULT;
+    incremental = 0;
+
+    for (h = r->headers_in.priority; h; h = h->next) {
+        if (njt_http_parse_priority(&h->value, &urgency, &incremental)
+            != NJT_OK)
+        {
+            njt_log_error(NJT_LOG_INFO, r->connection->log, 0,
+                          "client sent invalid priority header: \"%V\"",
+                          &h->value);
+            return;
+        }
+    }
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http3 priority u:%ui i:%ui", urgency, incremental);
+
+    qs = r->connection->quic;
+
+    qs->urgency = urgency;
+    qs->incremental = incremental;
+}
+
+
 static njt_int_t
 njt_http_v3_cookie(njt_http_request_t *r, njt_str_t *value)
 {
@@ -17,6 +17,14 @@
 static njt_int_t njt_http_v3_evict(njt_connection_t *c, size_t target);
 static void njt_http_v3_unblock(void *data);
 static njt_int_t njt_http_v3_new_entry(njt_connection_t *c);
+static njt_int_t njt_http_v3_encoder_init(njt_connection_t *c);
+static njt_int_t njt_http_v3_encoder_lookup(njt_http_v3_encoder_table_t *et,
+    njt_str_t *name, njt_str_t *value, njt_uint_t hash);
+static njt_int_t njt_http_v3_encoder_add(njt_http_v3_encoder_table_t *et,
+    njt_http_v3_encoder_section_t *s, njt_str_t *name, njt_str_t *value,
+    njt_uint_t hash);
+static u_char *njt_http_v3_encode_ref(njt_http_v3_encoder_table_t *et,
+    njt_http_v3_encoder_section_t *s, u_char *p, njt_uint_t index);
 
 
 typedef struct {
@@ -412,24 +420,99 @@ njt_http_v3_duplicate(njt_connection_t *c, njt_uint_t index)
 njt_int_t
 njt_http_v3_ack_section(njt_connection_t *c, njt_uint_t stream_id)
 {
+    njt_queue_t                    *q;
+    njt_http_v3_session_t          *h3c;
+    njt_http_v3_encoder_table_t    *et;
+    njt_http_v3_encoder_section_t  *s;
+
     njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
                    "http3 ack section %ui", stream_id);
 
-    /* we do not use dynamic tables */
+    h3c = njt_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    if (et->elts == NULL) {
+        return NJT_HTTP_V3_ERR_DECODER_STREAM_ERROR;
+    }
+
+    /* sections of a stream are acknowledged in order */
+
+    for (q = njt_queue_head(&et->sections);
+         q != njt_queue_sentinel(&et->sections);
+         q = njt_queue_next(q))
+    {
+        s = njt_queue_data(q, njt_http_v3_encoder_section_t, queue);
+
+        if (s->stream_id != stream_id) {
+            continue;
+        }
+
+        if (et->known_count < s->insert_count) {
+            et->known_count = s->insert_count;
+        }
+
+        njt_queue_remove(q);
+        njt_queue_insert_tail(&et->free, q);
+        et->nsections--;
+
+        return NJT_OK;
+    }
 
     return NJT_HTTP_V3_ERR_DECODER_STREAM_ERROR;
 }
 
 
+void
+njt_http_v3_cancel_sections(njt_connection_t *c, njt_uint_t stream_id)
+{
+    njt_queue_t                    *q, *next;
+    njt_http_v3_session_t          *h3c;
+    njt_http_v3_encoder_table_t    *et;
+    njt_http_v3_encoder_section_t  *s;
+
+    h3c = njt_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    if (et->elts == NULL) {
+        return;
+    }
+
+    for (q = njt_queue_head(&et->sections);
+         q != njt_queue_sentinel(&et->sections);
+         q = next)
+    {
+        next = njt_queue_next(q);
+
+        s = njt_queue_data(q, njt_http_v3_encoder_section_t, queue);
+
+        if (s->stream_id == stream_id) {
+            njt_queue_remove(q);
+            njt_queue_insert_tail(&et->free, q);
+            et->nsections--;
+        }
+    }
+}
+
+
 njt_int_t
 njt_http_v3_inc_insert_count(njt_connection_t *c, njt_uint_t inc)
 {
+    njt_http_v3_session_t        *h3c;
+    njt_http_v3_encoder_table_t  *et;
+
     njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
                    "http3 increment insert count %ui", inc);
 
-    /* we do not use dynamic tables */
+    h3c = njt_http_v3_get_session(c);
+    et = &h3c->encoder;
 
-    return NJT_HTTP_V3_ERR_DECODER_STREAM_ERROR;
+    if (inc == 0 || inc > et->insert_count - et->known_count) {
+        return NJT_HTTP_V3_ERR_DECODER_STREAM_ERROR;
+    }
+
+    et->known_count += inc;
+
+    return NJT_OK;
 }
 
 
@@ -693,6 +776,8 @@ njt_http_v3_set_param(njt_connection_t *c, uint64_t id, uint64_t value)
     case NJT_HTTP_V3_PARAM_MAX_TABLE_CAPACITY:
         njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
                        "http3 param QPACK_MAX_TABLE_CAPACITY:%uL", value);
+
+        njt_http_v3_get_session(c)->encoder.max_capacity = value;
         break;
 
     case NJT_HTTP_V3_PARAM_MAX_FIELD_SECTION_SIZE:
@@ -704,6 +789,8 @@ njt_http_v3_set_param(njt_connection_t *c, uint64_t id, uint64_t value)
     case NJT_HTTP_V3_PARAM_BLOCKED_STREAMS:
         njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
                        "http3 param QPACK_BLOCKED_STREAMS:%uL", value);
+
+        njt_http_v3_get_session(c)->encoder.max_blocked = value;
         break;
 
     default:
@@ -714,3 +801,399 @@ njt_http_v3_set_param(njt_connection_t *c, uint64_t id, uint64_t value)
 
     return NJT_OK;
 }
+
+
+njt_http_v3_encoder_section_t *
+njt_http_v3_encode_section_start(njt_connection_t *c)
+{
+    njt_queue_t                    *q;
+    njt_uint_t                      nblocked;
+    njt_http_v3_session_t          *h3c;
+    njt_http_v3_encoder_table_t    *et;
+    njt_http_v3_encoder_section_t  *s;
+
+    h3c = njt_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    if (et->elts == NULL) {
+
+        if (et->limit == 0 || et->max_capacity < 64) {
+            return NULL;
+        }
+
+        if (njt_http_v3_encoder_init(c) != NJT_OK) {
+            return NULL;
+        }
+    }
+
+    /* the number of unacknowledged sections bounds encoder memory */
+
+    if (et->nsections >= NJT_HTTP_V3_MAX_ENCODER_SECTIONS) {
+        return NULL;
+    }
+
+    nblocked = 0;
+
+    for (q = njt_queue_head(&et->sections);
+         q != njt_queue_sentinel(&et->sections);
+         q = njt_queue_next(q))
+    {
+        s = njt_queue_data(q, njt_http_v3_encoder_section_t, queue);
+
+        if (s->insert_count > et->known_count) {
+            nblocked++;
+        }
+    }
+
+    if (!njt_queue_empty(&et->free)) {
+        q = njt_queue_head(&et->free);
+        njt_queue_remove(q);
+
+        s = njt_queue_data(q, njt_http_v3_encoder_section_t, queue);
+
+    } else {
+        s = njt_palloc(c->quic ? c->quic->parent->pool : c->pool,
+                       sizeof(njt_http_v3_encoder_section_t));
+        if (s == NULL) {
+            return NULL;
+        }
+    }
+
+    s->stream_id = c->quic->id;
+    s->base = et->insert_count;
+    s->insert_count = 0;
+    s->min_ref = (njt_uint_t) -1;
+    s->blocking = (nblocked < et->max_blocked);
+
+    return s;
+}
+
+
+u_char *
+njt_http_v3_encode_field(njt_connection_t *c,
+    njt_http_v3_encoder_section_t *s, u_char *p, njt_int_t index,
+    njt_str_t *name, njt_str_t *value, njt_uint_t flags)
+{
+    size_t                        size, age;
+    njt_int_t                     found;
+    njt_uint_t                    i, hash;
+    njt_http_v3_session_t        *h3c;
+    njt_http_v3_encoder_entry_t  *entry;
+    njt_http_v3_encoder_table_t  *et;
+
+    h3c = njt_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    hash = 0;
+
+    for (i = 0; i < name->len; i++) {
+        hash = njt_hash(hash, njt_tolower(name->data[i]));
+    }
+
+    for (i = 0; i < value->len; i++) {
+        hash = njt_hash(hash, value->data[i]);
+    }
+
+    found = njt_http_v3_encoder_lookup(et, name, value, hash);
+
+    if (found >= 0) {
+
+        if ((njt_uint_t) found >= et->known_count && !s->blocking) {
+            goto literal;
+        }
+
+        p = njt_http_v3_encode_ref(et, s, p, found);
+
+        /*
+         * entries are evicted in insertion order only, so an entry
+         * which is still in use is duplicated before it is drained
+         */
+
+        age = 0;
+
+        for (i = et->deleted; i < (njt_uint_t) found; i++) {
+            entry = &et->elts[i % et->allocated];
+            age += 32 + entry->name_len + entry->value_len;
+        }
+
+        if (age < et->capacity / 4
+            && et->capacity - et->size < et->capacity / 4
+            && njt_http_v3_encoder_add(et, s, name, value, hash) == NJT_OK)
+        {
+            if (njt_http_v3_send_duplicate(c, et->insert_count - 2 - found)
+                != NJT_OK)
+            {
+                return NULL;
+            }
+        }
+
+        return p;
+    }
+
+    size = 32 + name->len + value->len;
+
+    if (!(flags & NJT_HTTP_V3_ENCODE_INDEX) || size > et->capacity / 4) {
+        goto literal;
+    }
+
+    if (njt_http_v3_encoder_add(et, s, name, value, hash) != NJT_OK) {
+        goto literal;
+    }
+
+    if (njt_http_v3_send_insert(c, index, name, value) != NJT_OK) {
+        return NULL;
+    }
+
+    if (s->blocking) {
+        return njt_http_v3_encode_ref(et, s, p, et->insert_count - 1);
+    }
+
+literal:
+
+    if (index >= 0) {
+        return (u_char *) njt_http_v3_encode_field_lri(p, 0, index,
+                                                       value->data,
+                                                       value->len);
+    }
+
+    return (u_char *) njt_http_v3_encode_field_l(p, name, value);
+}
+
+
+u_char *
+njt_http_v3_encode_section_end(njt_connection_t *c,
+    njt_http_v3_encoder_section_t *s, u_char *start)
+{
+    size_t                        n;
+    njt_uint_t                    max_entries, insert_count, sign, delta;
+    njt_http_v3_session_t        *h3c;
+    njt_http_v3_encoder_table_t  *et;
+
+    h3c = njt_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    if (s->insert_count == 0) {
+        njt_queue_insert_tail(&et->free, &s->queue);
+
+        n = njt_http_v3_encode_field_section_prefix(NULL, 0, 0, 0);
+        start -= n;
+
+        (void) njt_http_v3_encode_field_section_prefix(start, 0, 0, 0);
+
+        return start;
+    }
+
+    njt_log_debug3(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "http3 encoded section, insert count:%ui base:%ui "
+                   "known:%ui", s->insert_count, s->base, et->known_count);
+
+    max_entries = et->max_capacity / 32;
+    insert_count = s->insert_count % (2 * max_entries) + 1;
+
+    if (s->base >= s->insert_count) {
+        sign = 0;
+        delta = s->base - s->insert_count;
+
+    } else {
+        sign = 1;
+        delta = s->insert_count - s->base - 1;
+    }
+
+    n = njt_http_v3_encode_field_section_prefix(NULL, insert_count, sign,
+                                                delta);
+    start -= n;
+
+    (void) njt_http_v3_encode_field_section_prefix(start, insert_count,
+                                                   sign, delta);
+
+    njt_queue_insert_tail(&et->sections, &s->queue);
+    et->nsections++;
+
+    return start;
+}
+
+
+void
+njt_http_v3_encode_section_cancel(njt_connection_t *c,
+    njt_http_v3_encoder_section_t *s)
+{
+    njt_http_v3_session_t  *h3c;
+
+    /* a section between start and end is in neither queue */
+
+    h3c = njt_http_v3_get_session(c);
+
+    njt_queue_insert_tail(&h3c->encoder.free, &s->queue);
+}
+
+
+static njt_int_t
+njt_http_v3_encoder_init(njt_connection_t *c)
+{
+    njt_pool_t                   *pool;
+    njt_http_v3_session_t        *h3c;
+    njt_http_v3_encoder_table_t  *et;
+
+    h3c = njt_http_v3_get_session(c);
+    et = &h3c->encoder;
+
+    pool = c->quic ? c->quic->parent->pool : c->pool;
+
+    et->capacity = njt_min(et->limit, et->max_capacity);
+    et->allocated = et->capacity / 32;
+
+    et->elts = njt_palloc(pool, et->allocated
+                                * sizeof(njt_http_v3_encoder_entry_t));
+    if (et->elts == NULL) {
+        return NJT_ERROR;
+    }
+
+    et->storage = njt_pnalloc(pool, 2 * et->capacity);
+    if (et->storage == NULL) {
+        et->elts = NULL;
+        return NJT_ERROR;
+    }
+
+    njt_queue_init(&et->sections);
+    njt_queue_init(&et->free);
+
+    if (njt_http_v3_send_set_capacity(c, et->capacity) != NJT_OK) {
+        et->elts = NULL;
+        return NJT_ERROR;
+    }
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_http_v3_encoder_lookup(njt_http_v3_encoder_table_t *et, njt_str_t *name,
+    njt_str_t *value, njt_uint_t hash)
+{
+    u_char                       *data;
+    njt_uint_t                    i;
+    njt_http_v3_encoder_entry_t  *entry;
+
+    for (i = et->insert_count; i != et->deleted; i--) {
+        entry = &et->elts[(i - 1) % et->allocated];
+
+        if (entry->hash != hash
+            || entry->name_len != name->len
+            || entry->value_len != value->len)
+        {
+            continue;
+        }
+
+        data = et->storage + entry->offset;
+
+        if (njt_strncasecmp(data, name->data, name->len) == 0
+            && njt_memcmp(data + name->len, value->data, value->len) == 0)
+        {
+            return i - 1;
+        }
+    }
+
+    return NJT_ERROR;
+}
+
+
+static njt_int_t
+njt_http_v3_encoder_add(njt_http_v3_encoder_table_t *et,
+    njt_http_v3_encoder_section_t *s, njt_str_t *name, njt_str_t *value,
+    njt_uint_t hash)
+{
+    size_t                          size, avail, first;
+    njt_uint_t                      i, n, min_ref;
+    njt_queue_t                    *q;
+    njt_http_v3_encoder_entry_t    *entry;
+    njt_http_v3_encoder_section_t  *ss;
+
+    size = 32 + name->len + value->len;
+
+    /*
+     * the decoder evicts as many oldest entries as needed to fit
+     * the new one, all of them must be acknowledged and not referenced
+     * by unacknowledged sections including the current one
+     */
+
+    min_ref = njt_min(s->min_ref, et->known_count);
+
+    for (q = njt_queue_head(&et->sections);
+         q != njt_queue_sentinel(&et->sections);
+         q = njt_queue_next(q))
+    {
+        ss = njt_queue_data(q, njt_http_v3_encoder_section_t, queue);
+        min_ref = njt_min(min_ref, ss->min_ref);
+    }
+
+    avail = et->capacity - et->size;
+
+    for (n = et->deleted; avail < size; n++) {
+
+        if (n == et->insert_count || n >= min_ref) {
+            return NJT_DECLINED;
+        }
+
+        entry = &et->elts[n % et->allocated];
+        avail += 32 + entry->name_len + entry->value_len;
+    }
+
+    for ( /* void */ ; et->deleted < n; et->deleted++) {
+        entry = &et->elts[et->deleted % et->allocated];
+        et->size -= 32 + entry->name_len + entry->value_len;
+    }
+
+    if (et->last + name->len + value->len > 2 * et->capacity) {
+
+        if (et->insert_count == et->deleted) {
+            first = et->last;
+
+        } else {
+            first = et->elts[et->deleted % et->allocated].offset;
+        }
+
+        njt_memmove(et->storage, et->storage + first, et->last - first);
+
+        for (i = et->deleted; i != et->insert_count; i++) {
+            et->elts[i % et->allocated].offset -= first;
+        }
+
+        et->last -= first;
+    }
+
+    entry = &et->elts[et->insert_count++ % et->allocated];
+
+    entry->hash = hash;
+    entry->name_len = name->len;
+    entry->value_len = value->len;
+    entry->offset = et->last;
+
+    njt_strlow(et->storage + et->last, name->data, name->len);
+    njt_memcpy(et->storage + et->last + name->len, value->data, value->len);
+
+    et->last += name->len + value->len;
+    et->size += size;
+
+    return NJT_OK;
+}
+
+
+static u_char *
+njt_http_v3_encode_ref(njt_http_v3_encoder_table_t *et,
+    njt_http_v3_encoder_section_t *s, u_char *p, njt_uint_t index)
+{
+    if (s->min_ref > index) {
+        s->min_ref = index;
+    }
+
+    if (s->insert_count < index + 1) {
+        s->insert_count = index + 1;
+    }
+
+    if (index < s->base) {
+        return (u_char *) njt_http_v3_encode_field_ri(p, 1,
+                                                      s->base - 1 - index);
+    }
+
+    return (u_char *) njt_http_v3_encode_field_pbi(p, index - s->base);
+}
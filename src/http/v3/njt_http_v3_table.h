@@ -33,6 +33,53 @@ typedef struct {
 } njt_http_v3_dynamic_table_t;
 
 
+typedef struct {
+    njt_uint_t                    hash;
+    size_t                        name_len;
+    size_t                        value_len;
+    size_t                        offset;
+} njt_http_v3_encoder_entry_t;
+
+
+/*
+ * an encoded field section which references the dynamic table
+ * and is not acknowledged by the decoder yet
+ */
+
+typedef struct {
+    njt_queue_t                   queue;
+    uint64_t                      stream_id;
+    njt_uint_t                    base;
+    njt_uint_t                    insert_count;
+    njt_uint_t                    min_ref;
+    unsigned                      blocking:1;
+} njt_http_v3_encoder_section_t;
+
+
+typedef struct {
+    njt_http_v3_encoder_entry_t  *elts;
+    njt_uint_t                    allocated;
+    njt_uint_t                    deleted;
+    njt_uint_t                    insert_count;
+    njt_uint_t                    known_count;
+    size_t                        size;
+    size_t                        capacity;
+    size_t                        limit;
+    uint64_t                      max_capacity;
+    uint64_t                      max_blocked;
+    u_char                       *storage;
+    size_t                        last;
+    njt_queue_t                   sections;
+    njt_queue_t                   free;
+    njt_uint_t                    nsections;
+} njt_http_v3_encoder_table_t;
+
+
+#define NJT_HTTP_V3_MAX_ENCODER_SECTIONS  256
+
+#define NJT_HTTP_V3_ENCODE_INDEX          0x01
+
+
 void njt_http_v3_inc_insert_count_handler(njt_event_t *ev);
 void njt_http_v3_cleanup_table(njt_http_v3_session_t *h3c);
 njt_int_t njt_http_v3_ref_insert(njt_connection_t *c, njt_uint_t dynamic,
@@ -55,5 +102,16 @@ void njt_http_v3_ack_insert_count(njt_connection_t *c, uint64_t insert_count);
 njt_int_t njt_http_v3_set_param(njt_connection_t *c, uint64_t id,
     uint64_t value);
 
+njt_http_v3_encoder_section_t *njt_http_v3_encode_section_start(
+    njt_connection_t *c);
+u_char *njt_http_v3_encode_field(njt_connection_t *c,
+    njt_http_v3_encoder_section_t *s, u_char *p, njt_int_t index,
+    njt_str_t *name, njt_str_t *value, njt_uint_t flags);
+u_char *njt_http_v3_encode_section_end(njt_connection_t *c,
+    njt_http_v3_encoder_section_t *s, u_char *start);
+void njt_http_v3_encode_section_cancel(njt_connection_t *c,
+    njt_http_v3_encoder_section_t *s);
+void njt_http_v3_cancel_sections(njt_connection_t *c, njt_uint_t stream_id);
+
 
 #endif /* _NJT_HTTP_V3_TABLE_H_INCLUDED_ */
@@ -349,6 +349,11 @@ njt_http_v3_get_uni_stream(njt_connection_t *c, njt_uint_t type)
 
     njt_quic_cancelable_stream(sc);
 
+    /* control and QPACK streams go ahead of request data */
+
+    sc->quic->urgency = 0;
+    sc->quic->incremental = 0;
+
     njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
                    "http3 create uni stream, type:%ui", type);
 
@@ -615,13 +620,186 @@ failed:
 }
 
 
+njt_int_t
+njt_http_v3_send_set_capacity(njt_connection_t *c, njt_uint_t capacity)
+{
+    u_char                  buf[NJT_HTTP_V3_PREFIX_INT_LEN];
+    size_t                  n;
+    njt_connection_t       *ec;
+    njt_http_v3_session_t  *h3c;
+
+    njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "http3 send set capacity %ui", capacity);
+
+    ec = njt_http_v3_get_uni_stream(c, NJT_HTTP_V3_STREAM_ENCODER);
+    if (ec == NULL) {
+        return NJT_ERROR;
+    }
+
+    buf[0] = 0x20;
+    n = (u_char *) njt_http_v3_encode_prefix_int(buf, capacity, 5) - buf;
+
+    h3c = njt_http_v3_get_session(c);
+    h3c->total_bytes += n;
+
+    if (ec->send(ec, buf, n) != (ssize_t) n) {
+        goto failed;
+    }
+
+    return NJT_OK;
+
+failed:
+
+    njt_log_error(NJT_LOG_ERR, c->log, 0, "failed to send set capacity");
+
+    njt_http_v3_finalize_connection(c, NJT_HTTP_V3_ERR_EXCESSIVE_LOAD,
+                                    "failed to send set capacity");
+    njt_http_v3_close_uni_stream(ec);
+
+    return NJT_ERROR;
+}
+
+
+njt_int_t
+njt_http_v3_send_insert(njt_connection_t *c, njt_int_t index, njt_str_t *name,
+    njt_str_t *value)
+{
+    u_char                 *p, *buf;
+    size_t                  n;
+    njt_connection_t       *ec;
+    njt_http_v3_session_t  *h3c;
+
+    njt_log_debug3(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "http3 send insert static[%i] \"%V\":\"%V\"",
+                   index, name, value);
+
+    ec = njt_http_v3_get_uni_stream(c, NJT_HTTP_V3_STREAM_ENCODER);
+    if (ec == NULL) {
+        return NJT_ERROR;
+    }
+
+    if (index >= 0) {
+        n = njt_http_v3_encode_insert_ref(NULL, 0, index, value);
+
+    } else {
+        n = njt_http_v3_encode_insert_l(NULL, name, value);
+    }
+
+    buf = njt_pnalloc(c->pool, n);
+    if (buf == NULL) {
+        return NJT_ERROR;
+    }
+
+    if (index >= 0) {
+        p = (u_char *) njt_http_v3_encode_insert_ref(buf, 0, index, value);
+
+    } else {
+        p = (u_char *) njt_http_v3_encode_insert_l(buf, name, value);
+    }
+
+    n = p - buf;
+
+    h3c = njt_http_v3_get_session(c);
+    h3c->total_bytes += n;
+
+    if (ec->send(ec, buf, n) != (ssize_t) n) {
+        goto failed;
+    }
+
+    return NJT_OK;
+
+failed:
+
+    njt_log_error(NJT_LOG_ERR, c->log, 0, "failed to send insert");
+
+    njt_http_v3_finalize_connection(c, NJT_HTTP_V3_ERR_EXCESSIVE_LOAD,
+                                    "failed to send insert");
+    njt_http_v3_close_uni_stream(ec);
+
+    return NJT_ERROR;
+}
+
+
+njt_int_t
+njt_http_v3_send_duplicate(njt_connection_t *c, njt_uint_t index)
+{
+    u_char                  buf[NJT_HTTP_V3_PREFIX_INT_LEN];
+    size_t                  n;
+    njt_connection_t       *ec;
+    njt_http_v3_session_t  *h3c;
+
+    njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "http3 send duplicate %ui", index);
+
+    ec = njt_http_v3_get_uni_stream(c, NJT_HTTP_V3_STREAM_ENCODER);
+    if (ec == NULL) {
+        return NJT_ERROR;
+    }
+
+    buf[0] = 0;
+    n = (u_char *) njt_http_v3_encode_prefix_int(buf, index, 5) - buf;
+
+    h3c = njt_http_v3_get_session(c);
+    h3c->total_bytes += n;
+
+    if (ec->send(ec, buf, n) != (ssize_t) n) {
+        goto failed;
+    }
+
+    return NJT_OK;
+
+failed:
+
+    njt_log_error(NJT_LOG_ERR, c->log, 0, "failed to send duplicate");
+
+    njt_http_v3_finalize_connection(c, NJT_HTTP_V3_ERR_EXCESSIVE_LOAD,
+                                    "failed to send duplicate");
+    njt_http_v3_close_uni_stream(ec);
+
+    return NJT_ERROR;
+}
+
+
 njt_int_t
 njt_http_v3_cancel_stream(njt_connection_t *c, njt_uint_t stream_id)
 {
     njt_log_debug1(NJT_LOG_DEBUG_HTTP, c->log, 0,
                    "http3 cancel stream %ui", stream_id);
 
-    /* we do not use dynamic tables */
+    njt_http_v3_cancel_sections(c, stream_id);
+
+    return NJT_OK;
+}
+
+
+njt_int_t
+njt_http_v3_priority_update(njt_connection_t *c, uint64_t id,
+    njt_str_t *value)
+{
+    njt_uint_t  urgency, incremental;
+
+    njt_log_debug2(NJT_LOG_DEBUG_HTTP, c->log, 0,
+                   "http3 priority update %uL \"%V\"", id, value);
+
+    if (id & (NJT_QUIC_STREAM_UNIDIRECTIONAL
+              |NJT_QUIC_STREAM_SERVER_INITIATED))
+    {
+        return NJT_HTTP_V3_ERR_ID_ERROR;
+    }
+
+    urgency = NJT_HTTP_PRIORITY_URGENCY_DEFAULT;
+    incremental = 0;
+
+    if (njt_http_parse_priority(value, &urgency, &incremental) != NJT_OK) {
+        njt_log_error(NJT_LOG_INFO, c->log, 0,
+                      "client sent invalid PRIORITY_UPDATE frame: \"%V\"",
+                      value);
+        return NJT_OK;
+    }
+
+    /* updates of streams not opened yet or already closed are ignored */
+
+    njt_quic_set_stream_priority(c, id, urgency, incremental);
 
     return NJT_OK;
 }
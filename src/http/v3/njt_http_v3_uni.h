@@ -19,6 +19,8 @@ void njt_http_v3_init_uni_stream(njt_connection_t *c);
 njt_int_t njt_http_v3_register_uni_stream(njt_connection_t *c, uint64_t type);
 
 njt_int_t njt_http_v3_cancel_stream(njt_connection_t *c, njt_uint_t stream_id);
+njt_int_t njt_http_v3_priority_update(njt_connection_t *c, uint64_t id,
+    njt_str_t *value);
 
 njt_int_t njt_http_v3_send_settings(njt_connection_t *c);
 njt_int_t njt_http_v3_send_goaway(njt_connection_t *c, uint64_t id);
@@ -28,6 +30,11 @@ njt_int_t njt_http_v3_send_cancel_stream(njt_connection_t *c,
     njt_uint_t stream_id);
 njt_int_t njt_http_v3_send_inc_insert_count(njt_connection_t *c,
     njt_uint_t inc);
+njt_int_t njt_http_v3_send_set_capacity(njt_connection_t *c,
+    njt_uint_t capacity);
+njt_int_t njt_http_v3_send_insert(njt_connection_t *c, njt_int_t index,
+    njt_str_t *name, njt_str_t *value);
+njt_int_t njt_http_v3_send_duplicate(njt_connection_t *c, njt_uint_t index);
 
 
 #endif /* _NJT_HTTP_V3_UNI_H_INCLUDED_ */
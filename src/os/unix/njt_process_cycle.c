@@ -597,6 +597,12 @@ static void njt_update_worker_processes(njt_cycle_t *cycle, njt_core_conf_t *ccf
         return;
     }
     if (ccf->worker_processes != worker_c) {
+
+#if (NJT_QUIC_BPF)
+        /* steer new QUIC connections to the workers that remain */
+        njt_quic_bpf_update_workers(cycle, worker_c);
+#endif
+
         if (worker_c > ccf->worker_processes) {
             for (i = ccf->worker_processes; i < worker_c; i++) {
                 njt_spawn_process(cycle, njt_worker_process_cycle,
@@ -606,10 +612,16 @@ static void njt_update_worker_processes(njt_cycle_t *cycle, njt_core_conf_t *ccf
         } else {
             k=0;
             j=ccf->worker_processes-worker_c;
+            /*
+             * stop workers with the highest numbers, so the remaining
+             * ones keep their reuseport sockets and QUIC connections
+             */
             for (i= njt_last_process-1; i>=0; i--) {
                 if ( strlen(njt_processes[i].name)==strlen("worker process") 
                     && njt_strncmp(njt_processes[i].name, "worker process",14) ==0 
-                    &&  njt_processes[i].pid!=-1) {
+                    &&  njt_processes[i].pid!=-1
+                    && !njt_processes[i].exiting
+                    && (njt_int_t) (intptr_t) njt_processes[i].data >= worker_c) {
                     tmp_pid=njt_processes[i].pid;
                     njt_shrink_processes[k] = njt_processes[i];
                     k++;
@@ -1427,7 +1427,7 @@ njt_stream_proxy_ssl_certificates(njt_stream_session_t *s)
                        "stream upstream ssl key: \"%s\"", keyp->data);
 
         if (njt_ssl_connection_certificate(c, s->connection->pool, certp, keyp,
-                                           pscf->ssl_passwords)
+                                           NULL, pscf->ssl_passwords)
             != NJT_OK)
         {
             return NJT_ERROR;
@@ -1472,7 +1472,7 @@ njt_stream_proxy_ssl_certificate(njt_stream_session_t *s)
     njt_log_debug1(NJT_LOG_DEBUG_STREAM, c->log, 0,
                    "stream upstream ssl key: \"%s\"", key.data);
 
-    if (njt_ssl_connection_certificate(c, c->pool, &cert, &key,
+    if (njt_ssl_connection_certificate(c, c->pool, &cert, &key, NULL,
                                        pscf->ssl_passwords)
         != NJT_OK)
     {
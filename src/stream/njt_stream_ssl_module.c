@@ -10,6 +10,10 @@
 #include <njt_core.h>
 #include <njt_stream.h>
 
+#if (NJT_SSL_ASYNC_KEYOPS)
+#include <njt_thread_pool.h>
+#endif
+
 extern njt_module_t njt_stream_proto_module;
 typedef njt_int_t (*njt_ssl_variable_handler_pt)(njt_connection_t *c,
     njt_pool_t *pool, njt_str_t *s);
@@ -50,6 +54,10 @@ static njt_int_t njt_stream_ssl_compile_certificates(njt_conf_t *cf,
     njt_stream_ssl_conf_t *conf);
 #endif
 
+static char *njt_stream_ssl_certificate_cache(njt_conf_t *cf,
+    njt_command_t *cmd, void *conf);
+static char *njt_stream_ssl_async_keyops(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf);
 static char *njt_stream_ssl_password_file(njt_conf_t *cf, njt_command_t *cmd,
     void *conf);
 static char *njt_stream_ssl_session_cache(njt_conf_t *cf, njt_command_t *cmd,
@@ -129,6 +137,20 @@ static njt_command_t  njt_stream_ssl_commands[] = {
       NULL },
 #endif
 
+    { njt_string("ssl_certificate_cache"),
+      NJT_STREAM_MAIN_CONF|NJT_STREAM_SRV_CONF|NJT_CONF_TAKE123,
+      njt_stream_ssl_certificate_cache,
+      NJT_STREAM_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
+    { njt_string("ssl_async_keyops"),
+      NJT_STREAM_MAIN_CONF|NJT_STREAM_SRV_CONF|NJT_CONF_TAKE1,
+      njt_stream_ssl_async_keyops,
+      NJT_STREAM_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
     { njt_string("ssl_password_file"),
       NJT_STREAM_MAIN_CONF|NJT_STREAM_SRV_CONF|NJT_CONF_TAKE1,
       njt_stream_ssl_password_file,
@@ -739,6 +761,7 @@ njt_stream_ssl_certificate(njt_ssl_conn_t *ssl_conn, void *arg)
                        "ssl key: \"%s\"", key.data);
 
         if (njt_ssl_connection_certificate(c, c->pool, &cert, &key,
+                                           sslcf->certificate_cache,
                                            sslcf->passwords)
             != NJT_OK)
         {
@@ -864,6 +887,10 @@ njt_stream_ssl_create_conf(njt_conf_t *cf)
     scf->certificates = NJT_CONF_UNSET_PTR;
     scf->certificate_keys = NJT_CONF_UNSET_PTR;
     scf->passwords = NJT_CONF_UNSET_PTR;
+    scf->certificate_cache = NJT_CONF_UNSET_PTR;
+#if (NJT_SSL_ASYNC_KEYOPS)
+    scf->async_keyops = NJT_CONF_UNSET_PTR;
+#endif
     scf->conf_commands = NJT_CONF_UNSET_PTR;
     scf->prefer_server_ciphers = NJT_CONF_UNSET;
     scf->verify = NJT_CONF_UNSET_UINT;
@@ -910,6 +937,12 @@ njt_stream_ssl_merge_conf(njt_conf_t *cf, void *parent, void *child)
 
     njt_conf_merge_ptr_value(conf->passwords, prev->passwords, NULL);
 
+    njt_conf_merge_ptr_value(conf->certificate_cache, prev->certificate_cache,
+                             NULL);
+#if (NJT_SSL_ASYNC_KEYOPS)
+    njt_conf_merge_ptr_value(conf->async_keyops, prev->async_keyops, NULL);
+#endif
+
     njt_conf_merge_str_value(conf->dhparam, prev->dhparam, "");
 
     njt_conf_merge_str_value(conf->client_certificate, prev->client_certificate,
@@ -1097,6 +1130,14 @@ njt_stream_ssl_merge_conf(njt_conf_t *cf, void *parent, void *child)
         return NJT_CONF_ERROR;
     }
 
+#if (NJT_SSL_ASYNC_KEYOPS)
+    if (conf->async_keyops
+        && njt_ssl_async_keyops(cf, &conf->ssl, conf->async_keyops) != NJT_OK)
+    {
+        return NJT_CONF_ERROR;
+    }
+#endif
+
     if (njt_ssl_conf_commands(cf, &conf->ssl, conf->conf_commands) != NJT_OK) {
         return NJT_CONF_ERROR;
     }
@@ -1192,6 +1233,158 @@ found:
 }
 
 
+static char *
+njt_stream_ssl_certificate_cache(njt_conf_t *cf, njt_command_t *cmd,
+    void *conf)
+{
+    njt_stream_ssl_conf_t  *scf = conf;
+
+    time_t       inactive, valid;
+    njt_str_t   *value, s;
+    njt_int_t    max;
+    njt_uint_t   i;
+
+    if (scf->certificate_cache != NJT_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    max = 0;
+    inactive = 10;
+    valid = 60;
+
+    for (i = 1; i < cf->args->nelts; i++) {
+
+        if (njt_strncmp(value[i].data, "max=", 4) == 0) {
+
+            max = njt_atoi(value[i].data + 4, value[i].len - 4);
+            if (max <= 0) {
+                goto failed;
+            }
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "inactive=", 9) == 0) {
+
+            s.len = value[i].len - 9;
+            s.data = value[i].data + 9;
+
+            inactive = njt_parse_time(&s, 1);
+            if (inactive == (time_t) NJT_ERROR) {
+                goto failed;
+            }
+
+            continue;
+        }
+
+        if (njt_strncmp(value[i].data, "valid=", 6) == 0) {
+
+            s.len = value[i].len - 6;
+            s.data = value[i].data + 6;
+
+            valid = njt_parse_time(&s, 1);
+            if (valid == (time_t) NJT_ERROR) {
+                goto failed;
+            }
+
+            continue;
+        }
+
+        if (njt_strcmp(value[i].data, "off") == 0 && cf->args->nelts == 2) {
+
+            scf->certificate_cache = NULL;
+
+            return NJT_CONF_OK;
+        }
+
+        goto failed;
+    }
+
+    if (max == 0) {
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "\"ssl_certificate_cache\" must have "
+                           "the \"max\" parameter");
+        return NJT_CONF_ERROR;
+    }
+
+    scf->certificate_cache = njt_ssl_cache_init(cf->pool, max, valid,
+                                                inactive);
+    if (scf->certificate_cache == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    return NJT_CONF_OK;
+
+failed:
+
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+    return NJT_CONF_ERROR;
+}
+
+
+static char *
+njt_stream_ssl_async_keyops(njt_conf_t *cf, njt_command_t *cmd, void *conf)
+{
+#if (NJT_SSL_ASYNC_KEYOPS)
+    njt_stream_ssl_conf_t *scf = conf;
+
+    njt_str_t  name;
+#endif
+
+    njt_str_t  *value;
+
+    value = cf->args->elts;
+
+#if (NJT_SSL_ASYNC_KEYOPS)
+
+    if (scf->async_keyops != NJT_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    if (njt_strcmp(value[1].data, "off") == 0) {
+        scf->async_keyops = NULL;
+        return NJT_CONF_OK;
+    }
+
+    if (njt_strcmp(value[1].data, "on") == 0
+        || njt_strcmp(value[1].data, "threads") == 0)
+    {
+        scf->async_keyops = njt_thread_pool_add(cf, NULL);
+
+    } else if (njt_strncmp(value[1].data, "threads=", 8) == 0) {
+        name.len = value[1].len - 8;
+        name.data = value[1].data + 8;
+
+        scf->async_keyops = njt_thread_pool_add(cf, &name);
+
+    } else {
+        return "invalid value";
+    }
+
+    if (scf->async_keyops == NULL) {
+        return NJT_CONF_ERROR;
+    }
+
+    return NJT_CONF_OK;
+
+#else
+
+    if (njt_strcmp(value[1].data, "off") == 0) {
+        return NJT_CONF_OK;
+    }
+
+    njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                       "\"ssl_async_keyops\" "
+                       "is unsupported on this platform");
+    return NJT_CONF_ERROR;
+
+#endif
+}
+
+
 static char *
 njt_stream_ssl_password_file(njt_conf_t *cf, njt_command_t *cmd, void *conf)
 {
@@ -50,6 +50,12 @@ typedef struct {
     njt_array_t     *passwords;
     njt_array_t     *conf_commands;
 
+    njt_ssl_cache_t *certificate_cache;
+
+#if (NJT_SSL_ASYNC_KEYOPS)
+    njt_thread_pool_t *async_keyops;
+#endif
+
     njt_shm_zone_t  *shm_zone;
 
     njt_flag_t       session_tickets;
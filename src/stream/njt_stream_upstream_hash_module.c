@@ -11,21 +11,19 @@
 #include <njt_stream.h>
 
 
-typedef struct {
-    uint32_t                              hash;
-    njt_str_t                            *server;
-} njt_stream_upstream_chash_point_t;
-
-
-typedef struct {
-    njt_uint_t                            number;
-    njt_stream_upstream_chash_point_t     point[1];
-} njt_stream_upstream_chash_points_t;
+#define NJT_STREAM_UPSTREAM_HASH_MODULO   0
+#define NJT_STREAM_UPSTREAM_HASH_KETAMA   NJT_CHASH_KETAMA
+#define NJT_STREAM_UPSTREAM_HASH_MAGLEV   NJT_CHASH_MAGLEV
+#define NJT_STREAM_UPSTREAM_HASH_JUMP     NJT_CHASH_JUMP
 
 
 typedef struct {
     njt_stream_complex_value_t            key;
-    njt_stream_upstream_chash_points_t   *points;
+    njt_chash_table_t                    *table;
+    njt_stream_upstream_rr_peer_t       **peer;
+    njt_uint_t                            method;
+    njt_uint_t                            bound;
+    njt_uint_t                            update_id;
 } njt_stream_upstream_hash_srv_conf_t;
 
 
@@ -37,6 +35,7 @@ typedef struct {
     njt_uint_t                            tries;
     njt_uint_t                            rehash;
     uint32_t                              hash;
+    njt_uint_t                            update_id;
     njt_event_get_peer_pt                 get_rr_peer;
 } njt_stream_upstream_hash_peer_data_t;
 
@@ -50,15 +49,25 @@ static njt_int_t njt_stream_upstream_get_hash_peer(njt_peer_connection_t *pc,
 
 static njt_int_t njt_stream_upstream_init_chash(njt_conf_t *cf,
     njt_stream_upstream_srv_conf_t *us);
-static int njt_libc_cdecl
-    njt_stream_upstream_chash_cmp_points(const void *one, const void *two);
-static njt_uint_t njt_stream_upstream_find_chash_point(
-    njt_stream_upstream_chash_points_t *points, uint32_t hash);
 static njt_int_t njt_stream_upstream_init_chash_peer(njt_stream_session_t *s,
     njt_stream_upstream_srv_conf_t *us);
 static njt_int_t njt_stream_upstream_get_chash_peer(njt_peer_connection_t *pc,
     void *data);
 
+static njt_int_t njt_stream_upstream_init_table_hash(njt_conf_t *cf,
+    njt_stream_upstream_srv_conf_t *us);
+static njt_int_t njt_stream_upstream_update_hash_table(
+    njt_stream_upstream_srv_conf_t *us);
+static njt_int_t njt_stream_upstream_init_table_hash_peer(
+    njt_stream_session_t *s, njt_stream_upstream_srv_conf_t *us);
+static njt_int_t njt_stream_upstream_get_table_hash_peer(
+    njt_peer_connection_t *pc, void *data);
+static njt_uint_t njt_stream_upstream_hash_bound_load(
+    njt_stream_upstream_rr_peers_t *peers, njt_uint_t *weight);
+static njt_uint_t njt_stream_upstream_hash_overloaded(
+    njt_stream_upstream_hash_srv_conf_t *hcf,
+    njt_stream_upstream_rr_peer_t *peer, njt_uint_t conns, njt_uint_t weight);
+
 static void *njt_stream_upstream_hash_create_conf(njt_conf_t *cf);
 static char *njt_stream_upstream_hash(njt_conf_t *cf, njt_command_t *cmd,
     void *conf);
@@ -67,7 +76,7 @@ static char *njt_stream_upstream_hash(njt_conf_t *cf, njt_command_t *cmd,
 static njt_command_t  njt_stream_upstream_hash_commands[] = {
 
     { njt_string("hash"),
-      NJT_STREAM_UPS_CONF|NJT_CONF_TAKE12,
+      NJT_STREAM_UPS_CONF|NJT_CONF_TAKE123,
       njt_stream_upstream_hash,
       NJT_STREAM_SRV_CONF_OFFSET,
       0,
@@ -293,330 +302,30 @@ static njt_int_t
 njt_stream_upstream_init_chash(njt_conf_t *cf,
     njt_stream_upstream_srv_conf_t *us)
 {
-    u_char                               *host, *port, c;
-    size_t                                host_len, port_len, size;
-    uint32_t                              hash, base_hash;
-    njt_str_t                            *server;
-    njt_uint_t                            npoints, i, j;
-    njt_stream_upstream_rr_peer_t        *peer;
-    njt_stream_upstream_rr_peers_t       *peers;
-    njt_stream_upstream_chash_points_t   *points;
     njt_stream_upstream_hash_srv_conf_t  *hcf;
-    union {
-        uint32_t                          value;
-        u_char                            byte[4];
-    } prev_hash;
 
     if (njt_stream_upstream_init_round_robin(cf, us) != NJT_OK) {
         return NJT_ERROR;
     }
 
     us->peer.init = njt_stream_upstream_init_chash_peer;
-    us->update_id = NJT_CONF_UNSET_UINT;
-    peers = us->peer.data;
-    npoints = peers->total_weight * 160;
-
-    size = sizeof(njt_stream_upstream_chash_points_t)
-           + sizeof(njt_stream_upstream_chash_point_t) * (npoints - 1);
-
-    //by zyg points = njt_palloc(cf->pool, size);
-    points = njt_alloc(size, njt_cycle->log);
-    if (points == NULL) {
-        return NJT_ERROR;
-    }
 
-    points->number = 0;
-
-    for (peer = peers->peer; peer; peer = peer->next) {
-        server = &peer->server;
-
-        /*
-         * Hash expression is compatible with Cache::Memcached::Fast:
-         * crc32(HOST \0 PORT PREV_HASH).
-         */
-
-        if (server->len >= 5
-            && njt_strncasecmp(server->data, (u_char *) "unix:", 5) == 0)
-        {
-            host = server->data + 5;
-            host_len = server->len - 5;
-            port = NULL;
-            port_len = 0;
-            goto done;
-        }
-
-        for (j = 0; j < server->len; j++) {
-            c = server->data[server->len - j - 1];
-
-            if (c == ':') {
-                host = server->data;
-                host_len = server->len - j - 1;
-                port = server->data + server->len - j;
-                port_len = j;
-                goto done;
-            }
-
-            if (c < '0' || c > '9') {
-                break;
-            }
-        }
-
-        host = server->data;
-        host_len = server->len;
-        port = NULL;
-        port_len = 0;
-
-    done:
-
-        njt_crc32_init(base_hash);
-        njt_crc32_update(&base_hash, host, host_len);
-        njt_crc32_update(&base_hash, (u_char *) "", 1);
-        njt_crc32_update(&base_hash, port, port_len);
-
-        prev_hash.value = 0;
-        npoints = peer->weight * 160;
-
-        for (j = 0; j < npoints; j++) {
-            hash = base_hash;
-
-            njt_crc32_update(&hash, prev_hash.byte, 4);
-            njt_crc32_final(hash);
-
-            points->point[points->number].hash = hash;
-            points->point[points->number].server = server;
-            points->number++;
-
-#if (NJT_HAVE_LITTLE_ENDIAN)
-            prev_hash.value = hash;
-#else
-            prev_hash.byte[0] = (u_char) (hash & 0xff);
-            prev_hash.byte[1] = (u_char) ((hash >> 8) & 0xff);
-            prev_hash.byte[2] = (u_char) ((hash >> 16) & 0xff);
-            prev_hash.byte[3] = (u_char) ((hash >> 24) & 0xff);
-#endif
-        }
-    }
-
-    njt_qsort(points->point,
-              points->number,
-              sizeof(njt_stream_upstream_chash_point_t),
-              njt_stream_upstream_chash_cmp_points);
-
-    for (i = 0, j = 1; j < points->number; j++) {
-        if (points->point[i].hash != points->point[j].hash) {
-            points->point[++i] = points->point[j];
-        }
-    }
-
-    points->number = i + 1;
+    /* the points are built by each worker on the first session */
 
     hcf = njt_stream_conf_upstream_srv_conf(us,
                                             njt_stream_upstream_hash_module);
-    hcf->points = points;
-
-    return NJT_OK;
-}
-
-static njt_int_t
-njt_stream_upstream_update_chash( njt_stream_upstream_srv_conf_t *us)
-{
-    u_char                               *host, *port, c;
-    size_t                                host_len, port_len, size;
-    uint32_t                              hash, base_hash;
-    njt_str_t                            *server;
-    njt_uint_t                            npoints, i, j;
-    njt_stream_upstream_rr_peer_t        *peer;
-    njt_stream_upstream_rr_peers_t       *peers;
-    njt_stream_upstream_chash_points_t   *points;
-    njt_stream_upstream_hash_srv_conf_t  *hcf;
-    union {
-        uint32_t                          value;
-        u_char                            byte[4];
-    } prev_hash;
-
-
-    peers = us->peer.data;
-    if(us->update_id == peers->update_id && us->update_id != NJT_CONF_UNSET_UINT){
-	return NJT_OK;
-    } 
-    if(us->update_id == NJT_CONF_UNSET_UINT){
-	us->update_id = 0;
-    } else {
-       us->update_id = peers->update_id;
-    }
-    npoints = peers->total_weight * 160;
-
-    size = sizeof(njt_stream_upstream_chash_points_t)
-           + sizeof(njt_stream_upstream_chash_point_t) * (npoints - 1);
-
-     hcf = njt_stream_conf_upstream_srv_conf(us,
-                                            njt_stream_upstream_hash_module);
-    if(hcf != NULL && hcf->points != NULL){
-        njt_free(hcf->points);
-	hcf->points = NULL;
-    }
-    points = njt_alloc(size, njt_cycle->log);
-    if (points == NULL) {
-        return NJT_ERROR;
-    }
-    hcf->points = points;
-    points->number = 0;
-
-    if(peers->number <= 0){
-        return NJT_OK;
-    }
-    for (peer = peers->peer; peer; peer = peer->next) {
-        server = &peer->server;
-
-        /*
-         * Hash expression is compatible with Cache::Memcached::Fast:
-         * crc32(HOST \0 PORT PREV_HASH).
-         */
-
-        if (server->len >= 5
-            && njt_strncasecmp(server->data, (u_char *) "unix:", 5) == 0)
-        {
-            host = server->data + 5;
-            host_len = server->len - 5;
-            port = NULL;
-            port_len = 0;
-            goto done;
-        }
-
-        for (j = 0; j < server->len; j++) {
-            c = server->data[server->len - j - 1];
-
-            if (c == ':') {
-                host = server->data;
-                host_len = server->len - j - 1;
-                port = server->data + server->len - j;
-                port_len = j;
-                goto done;
-            }
-
-            if (c < '0' || c > '9') {
-                break;
-            }
-        }
-
-        host = server->data;
-        host_len = server->len;
-        port = NULL;
-        port_len = 0;
-
-    done:
-
-        njt_crc32_init(base_hash);
-        njt_crc32_update(&base_hash, host, host_len);
-        njt_crc32_update(&base_hash, (u_char *) "", 1);
-        njt_crc32_update(&base_hash, port, port_len);
-
-        prev_hash.value = 0;
-        npoints = peer->weight * 160;
-
-        for (j = 0; j < npoints; j++) {
-            hash = base_hash;
-
-            njt_crc32_update(&hash, prev_hash.byte, 4);
-            njt_crc32_final(hash);
-
-            points->point[points->number].hash = hash;
-            points->point[points->number].server = server;
-            points->number++;
-
-#if (NJT_HAVE_LITTLE_ENDIAN)
-            prev_hash.value = hash;
-#else
-            prev_hash.byte[0] = (u_char) (hash & 0xff);
-            prev_hash.byte[1] = (u_char) ((hash >> 8) & 0xff);
-            prev_hash.byte[2] = (u_char) ((hash >> 16) & 0xff);
-            prev_hash.byte[3] = (u_char) ((hash >> 24) & 0xff);
-#endif
-        }
-    }
-
-    njt_qsort(points->point,
-              points->number,
-              sizeof(njt_stream_upstream_chash_point_t),
-              njt_stream_upstream_chash_cmp_points);
-
-    for (i = 0, j = 1; j < points->number; j++) {
-        if (points->point[i].hash != points->point[j].hash) {
-            points->point[++i] = points->point[j];
-        }
-    }
-
-    points->number = i + 1;
-
-    //hcf = njt_stream_conf_upstream_srv_conf(us,
-      //                                      njt_stream_upstream_hash_module);
-    hcf->points = points;
+    hcf->table = NULL;
+    hcf->update_id = NJT_CONF_UNSET_UINT;
 
     return NJT_OK;
 }
 
 
-static int njt_libc_cdecl
-njt_stream_upstream_chash_cmp_points(const void *one, const void *two)
-{
-    njt_stream_upstream_chash_point_t *first =
-                                     (njt_stream_upstream_chash_point_t *) one;
-    njt_stream_upstream_chash_point_t *second =
-                                     (njt_stream_upstream_chash_point_t *) two;
-
-    if (first->hash < second->hash) {
-        return -1;
-
-    } else if (first->hash > second->hash) {
-        return 1;
-
-    } else {
-        return 0;
-    }
-}
-
-
-static njt_uint_t
-njt_stream_upstream_find_chash_point(njt_stream_upstream_chash_points_t *points,
-    uint32_t hash)
-{
-    njt_uint_t                          i, j, k;
-    njt_stream_upstream_chash_point_t  *point;
-     if(points->number == 0){
-        return 0;
-    }
-
-    /* find first point >= hash */
-
-    point = &points->point[0];
-
-    i = 0;
-    j = points->number;
-
-    while (i < j) {
-        k = (i + j) / 2;
-
-        if (hash > point[k].hash) {
-            i = k + 1;
-
-        } else if (hash < point[k].hash) {
-            j = k;
-
-        } else {
-            return k;
-        }
-    }
-
-    return i;
-}
-
-
 static njt_int_t
 njt_stream_upstream_init_chash_peer(njt_stream_session_t *s,
     njt_stream_upstream_srv_conf_t *us)
 {
     uint32_t                               hash;
-    int32_t                                rc;
     njt_stream_upstream_hash_srv_conf_t   *hcf;
     njt_stream_upstream_hash_peer_data_t  *hp;
 
@@ -627,18 +336,20 @@ njt_stream_upstream_init_chash_peer(njt_stream_session_t *s,
     s->upstream->peer.get = njt_stream_upstream_get_chash_peer;
 
     hp = s->upstream->peer.data;
-    hcf = njt_stream_conf_upstream_srv_conf(us,
-                                            njt_stream_upstream_hash_module);
+    hcf = hp->conf;
 
     hash = njt_crc32_long(hp->key.data, hp->key.len);
 
     njt_stream_upstream_rr_peers_rlock(hp->rrp.peers);
-    rc = njt_stream_upstream_update_chash(us);
-    if(rc != NJT_OK){
-        njt_log_debug0(NJT_LOG_DEBUG_HTTP, njt_cycle->log, 0,
-                   "njt_stream_upstream_init_chash_peer error!");
+
+    if (njt_stream_upstream_update_hash_table(us) != NJT_OK) {
+        njt_log_error(NJT_LOG_ERR, s->connection->log, 0,
+                      "could not build upstream hash points");
+    }
+
+    if (hcf->table) {
+        hp->hash = njt_chash_find_point(hcf->table, hash);
     }
-    hp->hash = njt_stream_upstream_find_chash_point(hcf->points, hash);
 
     njt_stream_upstream_rr_peers_unlock(hp->rrp.peers);
 
@@ -655,10 +366,9 @@ njt_stream_upstream_get_chash_peer(njt_peer_connection_t *pc, void *data)
     intptr_t                              m;
     njt_str_t                            *server;
     njt_int_t                             total;
-    njt_uint_t                            i, n, best_i;
+    njt_uint_t                            i, n, best_i, conns, weight;
+    njt_chash_table_t                    *table;
     njt_stream_upstream_rr_peer_t        *peer, *best;
-    njt_stream_upstream_chash_point_t    *point;
-    njt_stream_upstream_chash_points_t   *points;
     njt_stream_upstream_hash_srv_conf_t  *hcf;
 
     njt_log_debug1(NJT_LOG_DEBUG_STREAM, pc->log, 0,
@@ -666,7 +376,12 @@ njt_stream_upstream_get_chash_peer(njt_peer_connection_t *pc, void *data)
 
     njt_stream_upstream_rr_peers_wlock(hp->rrp.peers);
 
-    if (hp->tries > 20 || hp->rrp.peers->single || hp->key.len == 0) {
+    hcf = hp->conf;
+    table = hcf->table;
+
+    if (hp->tries > 20 || hp->rrp.peers->single || hp->key.len == 0
+        || table == NULL || table->number == 0)
+    {
         njt_stream_upstream_rr_peers_unlock(hp->rrp.peers);
         return hp->get_rr_peer(pc, &hp->rrp);
     }
@@ -674,13 +389,16 @@ njt_stream_upstream_get_chash_peer(njt_peer_connection_t *pc, void *data)
     pc->connection = NULL;
 
     now = njt_time();
-    hcf = hp->conf;
 
-    points = hcf->points;
-    point = &points->point[0];
+    conns = 0;
+    weight = 0;
+
+    if (hcf->bound) {
+        conns = njt_stream_upstream_hash_bound_load(hp->rrp.peers, &weight);
+    }
 
     for ( ;; ) {
-        server = point[hp->hash % points->number].server;
+        server = &table->point[hp->hash % table->number].node->name;
 
         njt_log_debug2(NJT_LOG_DEBUG_STREAM, pc->log, 0,
                        "consistent hash peer:%uD, server:\"%V\"",
@@ -725,6 +443,11 @@ njt_stream_upstream_get_chash_peer(njt_peer_connection_t *pc, void *data)
                 continue;
             }
 
+            if (njt_stream_upstream_hash_overloaded(hcf, peer, conns, weight))
+            {
+                continue;
+            }
+
             peer->current_weight += peer->effective_weight;
             total += peer->effective_weight;
 
@@ -775,6 +498,277 @@ njt_stream_upstream_get_chash_peer(njt_peer_connection_t *pc, void *data)
 }
 
 
+static njt_int_t
+njt_stream_upstream_init_table_hash(njt_conf_t *cf,
+    njt_stream_upstream_srv_conf_t *us)
+{
+    njt_stream_upstream_hash_srv_conf_t  *hcf;
+
+    if (njt_stream_upstream_init_round_robin(cf, us) != NJT_OK) {
+        return NJT_ERROR;
+    }
+
+    us->peer.init = njt_stream_upstream_init_table_hash_peer;
+
+    /* the table is built by each worker on the first request */
+
+    hcf = njt_stream_conf_upstream_srv_conf(us,
+                                            njt_stream_upstream_hash_module);
+    hcf->table = NULL;
+    hcf->update_id = NJT_CONF_UNSET_UINT;
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_stream_upstream_update_hash_table(njt_stream_upstream_srv_conf_t *us)
+{
+    njt_uint_t                            i, n;
+    njt_chash_table_t                    *table;
+    njt_stream_upstream_rr_peer_t        *peer;
+    njt_stream_upstream_rr_peers_t       *peers;
+    njt_stream_upstream_hash_srv_conf_t  *hcf;
+
+    peers = us->peer.data;
+    hcf = njt_stream_conf_upstream_srv_conf(us,
+                                            njt_stream_upstream_hash_module);
+
+    if (hcf->table && hcf->update_id == peers->update_id) {
+        return NJT_OK;
+    }
+
+    hcf->update_id = peers->update_id;
+
+    for (peer = peers->peer, n = 0; peer; peer = peer->next) {
+        n++;
+    }
+
+    /* the table goes with the cycle */
+
+    table = njt_chash_table_create(hcf->method, n, njt_cycle->pool,
+                                   njt_cycle->log);
+    if (table == NULL) {
+        goto failed;
+    }
+
+    hcf->peer = njt_palloc(table->pool,
+                           sizeof(njt_stream_upstream_rr_peer_t *) * (n + 1));
+    if (hcf->peer == NULL) {
+        njt_chash_table_free(table);
+        goto failed;
+    }
+
+    /* ketama points are of servers, other tables map to peers */
+
+    for (peer = peers->peer, i = 0; peer; peer = peer->next, i++) {
+        table->node[i].name = (hcf->method == NJT_STREAM_UPSTREAM_HASH_KETAMA)
+                              ? peer->server : peer->name;
+        table->node[i].weight = peer->weight;
+        hcf->peer[i] = peer;
+    }
+
+    if (njt_chash_table_build(table, hcf->table) != NJT_OK) {
+        hcf->table = NULL;
+        njt_chash_table_free(table);
+        return NJT_ERROR;
+    }
+
+    hcf->table = table;
+
+    return NJT_OK;
+
+failed:
+
+    if (hcf->table) {
+        njt_chash_table_free(hcf->table);
+        hcf->table = NULL;
+    }
+
+    return NJT_ERROR;
+}
+
+
+static njt_int_t
+njt_stream_upstream_init_table_hash_peer(njt_stream_session_t *s,
+    njt_stream_upstream_srv_conf_t *us)
+{
+    njt_stream_upstream_hash_srv_conf_t   *hcf;
+    njt_stream_upstream_hash_peer_data_t  *hp;
+
+    if (njt_stream_upstream_init_hash_peer(s, us) != NJT_OK) {
+        return NJT_ERROR;
+    }
+
+    s->upstream->peer.get = njt_stream_upstream_get_table_hash_peer;
+
+    hp = s->upstream->peer.data;
+    hcf = hp->conf;
+
+    hp->hash = njt_crc32_long(hp->key.data, hp->key.len);
+
+    njt_stream_upstream_rr_peers_rlock(hp->rrp.peers);
+
+    if (njt_stream_upstream_update_hash_table(us) != NJT_OK) {
+        njt_log_error(NJT_LOG_ERR, s->connection->log, 0,
+                      "could not build upstream hash table");
+    }
+
+    hp->update_id = hcf->update_id;
+
+    njt_stream_upstream_rr_peers_unlock(hp->rrp.peers);
+
+    return NJT_OK;
+}
+
+
+static njt_int_t
+njt_stream_upstream_get_table_hash_peer(njt_peer_connection_t *pc, void *data)
+{
+    njt_stream_upstream_hash_peer_data_t  *hp = data;
+
+    time_t                                now;
+    uintptr_t                             m;
+    njt_uint_t                            n, p, conns, weight;
+    njt_stream_upstream_rr_peer_t        *peer;
+    njt_chash_table_t                    *table;
+    njt_stream_upstream_hash_srv_conf_t  *hcf;
+
+    njt_log_debug1(NJT_LOG_DEBUG_STREAM, pc->log, 0,
+                   "get table hash peer, try: %ui", pc->tries);
+
+    njt_stream_upstream_rr_peers_rlock(hp->rrp.peers);
+
+    hcf = hp->conf;
+    table = hcf->table;
+
+    /* the table may have been rebuilt by another request since init */
+
+    if (hp->tries > 20 || hp->rrp.peers->single || hp->key.len == 0
+        || table == NULL || table->number == 0
+        || hp->update_id != hcf->update_id)
+    {
+        njt_stream_upstream_rr_peers_unlock(hp->rrp.peers);
+        return hp->get_rr_peer(pc, &hp->rrp);
+    }
+
+    now = njt_time();
+
+    pc->connection = NULL;
+
+    conns = 0;
+    weight = 0;
+
+    if (hcf->bound) {
+        conns = njt_stream_upstream_hash_bound_load(hp->rrp.peers, &weight);
+    }
+
+    for ( ;; ) {
+
+        p = njt_chash_lookup(table, hp->hash);
+        peer = hcf->peer[p];
+
+        njt_log_debug2(NJT_LOG_DEBUG_STREAM, pc->log, 0,
+                       "get table hash peer, value:%uD, peer:%ui",
+                       hp->hash, p);
+
+        n = p / (8 * sizeof(uintptr_t));
+        m = (uintptr_t) 1 << p % (8 * sizeof(uintptr_t));
+
+        if (hp->rrp.tried[n] & m) {
+            goto next;
+        }
+
+        njt_stream_upstream_rr_peer_lock(hp->rrp.peers, peer);
+
+        if (njt_stream_upstream_pre_handle_peer(peer) == NJT_ERROR
+            || njt_stream_upstream_hash_overloaded(hcf, peer, conns, weight))
+        {
+            njt_stream_upstream_rr_peer_unlock(hp->rrp.peers, peer);
+            goto next;
+        }
+
+        break;
+
+    next:
+
+        hp->hash++;
+
+        if (++hp->tries > 20) {
+            njt_stream_upstream_rr_peers_unlock(hp->rrp.peers);
+            return hp->get_rr_peer(pc, &hp->rrp);
+        }
+    }
+
+    hp->rrp.current = peer;
+
+    pc->sockaddr = peer->sockaddr;
+    pc->socklen = peer->socklen;
+    pc->name = &peer->name;
+
+    peer->conns++;
+    peer->requests++;
+    if (now - peer->checked > peer->fail_timeout) {
+        peer->checked = now;
+    }
+
+    njt_stream_upstream_rr_peer_unlock(hp->rrp.peers, peer);
+    njt_stream_upstream_rr_peers_unlock(hp->rrp.peers);
+
+    hp->rrp.tried[n] |= m;
+
+    return NJT_OK;
+}
+
+
+static njt_uint_t
+njt_stream_upstream_hash_bound_load(njt_stream_upstream_rr_peers_t *peers,
+    njt_uint_t *weight)
+{
+    njt_uint_t                      conns;
+    njt_stream_upstream_rr_peer_t  *peer;
+
+    conns = 0;
+    *weight = 0;
+
+    for (peer = peers->peer; peer; peer = peer->next) {
+
+        if (peer->down) {
+            continue;
+        }
+
+        conns += peer->conns;
+        *weight += peer->weight;
+    }
+
+    return conns;
+}
+
+
+static njt_uint_t
+njt_stream_upstream_hash_overloaded(njt_stream_upstream_hash_srv_conf_t *hcf,
+    njt_stream_upstream_rr_peer_t *peer, njt_uint_t conns, njt_uint_t weight)
+{
+    njt_uint_t  limit;
+
+    if (hcf->bound == 0 || weight == 0) {
+        return 0;
+    }
+
+    /*
+     * consistent hashing with bounded loads: a peer may not take more
+     * than ceil(c * (conns + 1)) of the in-flight connections, shared
+     * by weight; "bound" is c in hundredths
+     */
+
+    limit = (hcf->bound * (conns + 1) * (njt_uint_t) peer->weight
+             + 100 * weight - 1)
+            / (100 * weight);
+
+    return peer->conns >= limit;
+}
+
+
 static void *
 njt_stream_upstream_hash_create_conf(njt_conf_t *cf)
 {
@@ -785,7 +779,11 @@ njt_stream_upstream_hash_create_conf(njt_conf_t *cf)
         return NULL;
     }
 
-    conf->points = NULL;
+    conf->table = NULL;
+    conf->peer = NULL;
+    conf->method = NJT_STREAM_UPSTREAM_HASH_MODULO;
+    conf->bound = 0;
+    conf->update_id = NJT_CONF_UNSET_UINT;
 
     return conf;
 }
@@ -796,7 +794,9 @@ njt_stream_upstream_hash(njt_conf_t *cf, njt_command_t *cmd, void *conf)
 {
     njt_stream_upstream_hash_srv_conf_t  *hcf = conf;
 
+    njt_int_t                            bound;
     njt_str_t                           *value;
+    njt_uint_t                           i;
     njt_stream_upstream_srv_conf_t      *uscf;
     njt_stream_compile_complex_value_t   ccv;
 
@@ -828,9 +828,20 @@ njt_stream_upstream_hash(njt_conf_t *cf, njt_command_t *cmd, void *conf)
 
     if (cf->args->nelts == 2) {
         uscf->peer.init_upstream = njt_stream_upstream_init_hash;
+        hcf->method = NJT_STREAM_UPSTREAM_HASH_MODULO;
 
     } else if (njt_strcmp(value[2].data, "consistent") == 0) {
         uscf->peer.init_upstream = njt_stream_upstream_init_chash;
+        hcf->method = NJT_STREAM_UPSTREAM_HASH_KETAMA;
+
+    } else if (njt_strcmp(value[2].data, "maglev") == 0) {
+        uscf->peer.init_upstream = njt_stream_upstream_init_table_hash;
+        hcf->method = NJT_STREAM_UPSTREAM_HASH_MAGLEV;
+
+    } else if (njt_strcmp(value[2].data, "jump") == 0) {
+
+        uscf->peer.init_upstream = njt_stream_upstream_init_table_hash;
+        hcf->method = NJT_STREAM_UPSTREAM_HASH_JUMP;
 
     } else {
         njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
@@ -838,5 +849,29 @@ njt_stream_upstream_hash(njt_conf_t *cf, njt_command_t *cmd, void *conf)
         return NJT_CONF_ERROR;
     }
 
+    for (i = 3; i < cf->args->nelts; i++) {
+
+        if (njt_strncmp(value[i].data, "bounded=", 8) == 0) {
+
+            bound = njt_atofp(value[i].data + 8, value[i].len - 8, 2);
+
+            if (bound == NJT_ERROR || bound < 100) {
+                njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                                   "invalid load factor \"%V\", "
+                                   "it must be a number not less than 1",
+                                   &value[i]);
+                return NJT_CONF_ERROR;
+            }
+
+            hcf->bound = bound;
+
+            continue;
+        }
+
+        njt_conf_log_error(NJT_LOG_EMERG, cf, 0,
+                           "invalid parameter \"%V\"", &value[i]);
+        return NJT_CONF_ERROR;
+    }
+
     return NJT_CONF_OK;
 }
@@ -0,0 +1,293 @@
+# vim:set ft= ts=4 sw=4 et fdm=marker:
+
+use Test::Nginx::Socket::Lua;
+
+# streams of "proxy_http_version 2" on shared upstream connections,
+# the upstream server is an http2 server of the same instance
+# reporting the connection a request came in on
+
+repeat_each(1);
+
+plan tests => repeat_each() * (blocks() * 3);
+
+$ENV{TEST_NGINX_HTTP2_PORT} ||= 1986;
+$ENV{TEST_NGINX_HTTP2_PORT2} ||= 1987;
+
+our $http_config = <<'_EOC_';
+    upstream backend {
+        server 127.0.0.1:$TEST_NGINX_HTTP2_PORT;
+        keepalive 4;
+    }
+
+    server {
+        listen 127.0.0.1:$TEST_NGINX_HTTP2_PORT http2;
+        keepalive_requests 1000;
+
+        location /conn {
+            return 200 $connection;
+        }
+
+        location /slow {
+            content_by_lua_block {
+                njt.sleep(tonumber(njt.var.arg_t) or 0.2)
+                njt.print(njt.var.connection)
+            }
+        }
+
+        location /reset {
+            return 444;
+        }
+    }
+
+    server {
+        listen 127.0.0.1:$TEST_NGINX_HTTP2_PORT2 http2;
+        keepalive_requests 2;
+
+        location /conn {
+            return 200 $connection;
+        }
+    }
+
+    upstream backend_limited {
+        server 127.0.0.1:$TEST_NGINX_HTTP2_PORT2;
+    }
+_EOC_
+
+our $config = <<'_EOC_';
+    location /proxy/ {
+        proxy_pass http://backend/;
+        proxy_http_version 2;
+        proxy_read_timeout 1s;
+    }
+
+    location /single/ {
+        proxy_pass http://backend/;
+        proxy_http_version 2;
+        proxy_http2_max_concurrent_streams 1;
+    }
+
+    location /nomux/ {
+        proxy_pass http://backend/;
+        proxy_http_version 2;
+        proxy_http2_max_concurrent_streams 0;
+    }
+
+    location /limited/ {
+        proxy_pass http://backend_limited/;
+        proxy_http_version 2;
+    }
+
+    location /timeout/ {
+        proxy_pass http://backend/;
+        proxy_http_version 2;
+        proxy_read_timeout 100ms;
+    }
+_EOC_
+
+no_shuffle();
+no_long_string();
+
+run_tests();
+
+__DATA__
+
+=== TEST 1: concurrent streams share one upstream connection
+--- http_config eval: $::http_config
+--- config eval
+$::config . q{
+    location = /t {
+        content_by_lua_block {
+            local res = { njt.location.capture_multi{
+                { "/proxy/slow" }, { "/proxy/slow" },
+                { "/proxy/slow" }, { "/proxy/slow" },
+            } }
+
+            local conns = {}
+            local n = 0
+
+            for _, r in ipairs(res) do
+                njt.say(r.status)
+
+                if not conns[r.body] then
+                    conns[r.body] = true
+                    n = n + 1
+                end
+            end
+
+            njt.say("connections: ", n)
+        }
+    }
+}
+--- request
+GET /t
+--- response_body
+200
+200
+200
+200
+connections: 1
+--- no_error_log
+[error]
+
+
+
+=== TEST 2: a stream limit of 1 spreads requests over connections
+--- http_config eval: $::http_config
+--- config eval
+$::config . q{
+    location = /t {
+        content_by_lua_block {
+            local res = { njt.location.capture_multi{
+                { "/single/slow" }, { "/single/slow" }, { "/single/slow" },
+            } }
+
+            local conns = {}
+            local n = 0
+
+            for _, r in ipairs(res) do
+                njt.say(r.status)
+
+                if not conns[r.body] then
+                    conns[r.body] = true
+                    n = n + 1
+                end
+            end
+
+            njt.say("connections: ", n)
+        }
+    }
+}
+--- request
+GET /t
+--- response_body
+200
+200
+200
+connections: 3
+--- no_error_log
+[error]
+
+
+
+=== TEST 3: a stream reset by the proxy leaves the others running
+--- http_config eval: $::http_config
+--- config eval
+$::config . q{
+    location = /t {
+        content_by_lua_block {
+            local res = { njt.location.capture_multi{
+                { "/timeout/slow", { args = "t=1" } },
+                { "/proxy/slow" }, { "/proxy/slow" },
+            } }
+
+            for _, r in ipairs(res) do
+                njt.say(r.status)
+            end
+
+            njt.say(res[2].body == res[3].body)
+
+            local after = njt.location.capture("/proxy/conn")
+            njt.say(after.status, " ", after.body == res[2].body)
+        }
+    }
+}
+--- request
+GET /t
+--- response_body
+504
+200
+200
+true
+200 true
+--- error_log
+client canceled stream
+
+
+
+=== TEST 4: a stream reset by the upstream server fails alone
+--- http_config eval: $::http_config
+--- config eval
+$::config . q{
+    location = /t {
+        content_by_lua_block {
+            local res = { njt.location.capture_multi{
+                { "/proxy/slow" }, { "/proxy/reset" },
+            } }
+
+            njt.say(res[1].status)
+            njt.say(res[2].status)
+
+            local after = njt.location.capture("/proxy/conn")
+            njt.say(after.status, " ", after.body == res[1].body)
+        }
+    }
+}
+--- request
+GET /t
+--- response_body
+200
+502
+200 true
+--- error_log
+upstream rejected request with error
+
+
+
+=== TEST 5: a connection closed by the upstream server is replaced
+--- http_config eval: $::http_config
+--- config eval
+$::config . q{
+    location = /t {
+        content_by_lua_block {
+            local conns = {}
+            local n = 0
+
+            for i = 1, 3 do
+                local r = njt.location.capture("/limited/conn")
+                njt.say(r.status)
+
+                if not conns[r.body] then
+                    conns[r.body] = true
+                    n = n + 1
+                end
+            end
+
+            njt.say("connections: ", n)
+        }
+    }
+}
+--- request
+GET /t
+--- response_body
+200
+200
+200
+connections: 2
+--- no_error_log
+[error]
+
+
+
+=== TEST 6: a keepalive cached http2 connection is shared
+--- http_config eval: $::http_config
+--- config eval
+$::config . q{
+    location = /t {
+        content_by_lua_block {
+            local first = njt.location.capture("/nomux/conn")
+            local res = { njt.location.capture_multi{
+                { "/proxy/conn" }, { "/proxy/conn" },
+            } }
+
+            njt.say(first.status, " ", res[1].status, " ", res[2].status)
+            njt.say(res[1].body == first.body, " ", res[2].body == first.body)
+        }
+    }
+}
+--- request
+GET /t
+--- response_body
+200 200 200
+true true
+--- no_error_log
+[error]